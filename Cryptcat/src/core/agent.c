@@ -0,0 +1,884 @@
+/*
+ * Cryptcat Agent
+ * Local daemon that keeps warm authenticated sessions to peers and lends
+ * them to short-lived client processes over a Unix-domain socket
+ * Version: 1.0.0
+ * License: MIT
+ */
+
+#ifdef __linux__
+#define _GNU_SOURCE  /* struct ucred */
+#endif
+
+#include "agent.h"
+#include "network.h"
+#include "protocol.h"
+#include "file_transfer.h"
+#include "platform.h"
+#include "utils/logger.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdatomic.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+/* Agent constants */
+#define AGENT_BACKLOG 64
+#define AGENT_TICK_MS 1000          /* Longest wait between pool maintenance passes */
+#define AGENT_HOST_MAX 256
+#define STREAM_CHUNK 16384          /* Client bytes per MSG_DATA */
+#define STREAM_BUFFER 65536         /* Largest message payload */
+#define DRAIN_QUIET_MS 200          /* Peer silence that ends a finished stream */
+#define REQUEST_TIMEOUT_MS 5000     /* Wait for a client's request line */
+#define STOP_WAIT_MS 10000          /* agent_destroy() wait for running requests */
+
+/* Warm session to one peer */
+typedef struct pooled_session_s {
+    char host[AGENT_HOST_MAX];
+    int port;
+    connection_t *conn;
+    uint64_t idle_since_ms;
+    uint64_t last_sent_ms;          /* Keepalives are due from here */
+    struct pooled_session_s *next;
+} pooled_session_t;
+
+/* Agent state */
+struct agent_s {
+    char socket_path[sizeof(((struct sockaddr_un*)0)->sun_path)];
+    char *password;
+    agent_options_t options;
+    int listen_fd;
+    atomic_int stopping;
+    atomic_int active;              /* Client threads still running */
+    platform_mutex_t lock;          /* Guards idle and stats */
+    pooled_session_t *idle;
+    agent_stats_t stats;
+};
+
+/* One client request */
+typedef struct {
+    agent_t *agent;
+    int fd;
+} agent_client_t;
+
+/* Internal function prototypes */
+static void* client_thread(void *arg);
+static int client_allowed(int fd);
+static int read_line(int fd, char *line, size_t line_len, int timeout_ms);
+static int write_all(int fd, const void *data, size_t len);
+static int write_reply(int fd, const char *status, const char *detail);
+static int run_stream(agent_t *agent, int client_fd, connection_t *conn);
+static int run_send(agent_t *agent, connection_t *conn, const char *path,
+                    uint64_t *bytes_sent);
+static int drain_session(connection_t *conn, int quiet_ms);
+static pooled_session_t* checkout_session(agent_t *agent, const char *host, int port);
+static void release_session(agent_t *agent, pooled_session_t *session, int clean);
+static void close_session(pooled_session_t *session, const char *reason);
+static void maintain_pool(agent_t *agent);
+static int connect_agent(const char *socket_path, int *fd);
+static int valid_token(const char *text);
+
+/* Get the default agent socket path */
+int agent_default_socket_path(char *path, size_t path_len) {
+    const char *env;
+    int written;
+
+    if (!path || path_len == 0) {
+        return AGENT_ERROR_PARAM;
+    }
+
+    if ((env = getenv("CRYPTCAT_AGENT_SOCK")) && *env) {
+        written = snprintf(path, path_len, "%s", env);
+    } else if ((env = getenv("XDG_RUNTIME_DIR")) && *env) {
+        written = snprintf(path, path_len, "%s/cryptcat-agent.sock", env);
+    } else {
+        written = snprintf(path, path_len, "/tmp/cryptcat-agent-%lu.sock",
+                           (unsigned long)geteuid());
+    }
+
+    return written > 0 && (size_t)written < path_len ? AGENT_SUCCESS : AGENT_ERROR_PARAM;
+}
+
+/* Create an agent */
+agent_t* agent_create(const char *socket_path, const char *password,
+                      const agent_options_t *options) {
+    struct sockaddr_un addr;
+    agent_t *agent;
+    mode_t old_mask;
+    int probe_fd;
+
+    if (!socket_path || !password || strlen(socket_path) >= sizeof(addr.sun_path)) {
+        LOG_ERROR("Invalid agent parameters");
+        return NULL;
+    }
+
+    agent = calloc(1, sizeof(agent_t));
+    if (!agent) {
+        LOG_ERROR("Memory allocation failed");
+        return NULL;
+    }
+
+    strncpy(agent->socket_path, socket_path, sizeof(agent->socket_path) - 1);
+    agent->listen_fd = -1;
+    atomic_init(&agent->stopping, 0);
+    atomic_init(&agent->active, 0);
+
+    if (options) {
+        agent->options = *options;
+    }
+    if (agent->options.idle_timeout_ms <= 0) {
+        agent->options.idle_timeout_ms = AGENT_DEFAULT_IDLE_TIMEOUT_MS;
+    }
+    if (agent->options.keepalive_ms <= 0) {
+        agent->options.keepalive_ms = AGENT_DEFAULT_KEEPALIVE_MS;
+    }
+    if (agent->options.max_idle_per_peer <= 0) {
+        agent->options.max_idle_per_peer = AGENT_DEFAULT_MAX_IDLE_PER_PEER;
+    }
+
+    agent->password = strdup(password);
+    agent->lock = platform_mutex_create();
+    if (!agent->password || !agent->lock) {
+        LOG_ERROR("Memory allocation failed");
+        agent_destroy(agent);
+        return NULL;
+    }
+
+    /* A socket nobody answers on is left over from an agent that died */
+    if (connect_agent(socket_path, &probe_fd) == AGENT_SUCCESS) {
+        close(probe_fd);
+        LOG_ERROR("An agent is already listening on %s", socket_path);
+        agent->socket_path[0] = '\0';
+        agent_destroy(agent);
+        return NULL;
+    }
+    unlink(socket_path);
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, socket_path, sizeof(addr.sun_path) - 1);
+
+    agent->listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (agent->listen_fd < 0) {
+        LOG_ERROR("Failed to create agent socket: %s", strerror(errno));
+        agent_destroy(agent);
+        return NULL;
+    }
+
+    /* Owner-only from the moment the path exists */
+    old_mask = umask(0077);
+    if (bind(agent->listen_fd, (struct sockaddr*)&addr, sizeof(addr)) != 0) {
+        umask(old_mask);
+        LOG_ERROR("Failed to bind agent socket %s: %s", socket_path, strerror(errno));
+        agent->socket_path[0] = '\0';
+        agent_destroy(agent);
+        return NULL;
+    }
+    umask(old_mask);
+
+    if (listen(agent->listen_fd, AGENT_BACKLOG) != 0) {
+        LOG_ERROR("Failed to listen on agent socket: %s", strerror(errno));
+        agent_destroy(agent);
+        return NULL;
+    }
+
+    LOG_INFO("Agent listening on %s", socket_path);
+    return agent;
+}
+
+/* Serve clients until stopped */
+int agent_run(agent_t *agent) {
+    struct pollfd pfd;
+
+    if (!agent || agent->listen_fd < 0) {
+        return AGENT_ERROR_PARAM;
+    }
+
+    while (!atomic_load(&agent->stopping)) {
+        agent_client_t *client;
+        platform_thread_t thread;
+        int ready, fd;
+
+        pfd.fd = agent->listen_fd;
+        pfd.events = POLLIN;
+        pfd.revents = 0;
+
+        ready = poll(&pfd, 1, AGENT_TICK_MS);
+        maintain_pool(agent);
+
+        if (ready < 0 && errno != EINTR) {
+            LOG_ERROR("Agent poll failed: %s", strerror(errno));
+            return AGENT_ERROR_SYSTEM;
+        }
+        if (ready <= 0) {
+            continue;
+        }
+
+        fd = accept(agent->listen_fd, NULL, NULL);
+        if (fd < 0) {
+            if (errno != EINTR && errno != EAGAIN && errno != ECONNABORTED) {
+                LOG_ERROR("Agent accept failed: %s", strerror(errno));
+            }
+            continue;
+        }
+
+        if (!client_allowed(fd)) {
+            LOG_WARNING("Agent refused a client of another user");
+            close(fd);
+            continue;
+        }
+
+        client = malloc(sizeof(agent_client_t));
+        if (!client) {
+            close(fd);
+            continue;
+        }
+        client->agent = agent;
+        client->fd = fd;
+
+        atomic_fetch_add(&agent->active, 1);
+        thread = platform_thread_create(client_thread, client);
+        if (!thread) {
+            LOG_ERROR("Failed to start agent client thread");
+            atomic_fetch_sub(&agent->active, 1);
+            close(fd);
+            free(client);
+            continue;
+        }
+        platform_thread_detach(thread);
+    }
+
+    return AGENT_SUCCESS;
+}
+
+/* Ask agent_run() to return */
+void agent_stop(agent_t *agent) {
+    if (agent) {
+        atomic_store(&agent->stopping, 1);
+    }
+}
+
+/* Destroy an agent */
+void agent_destroy(agent_t *agent) {
+    pooled_session_t *session;
+    int waited = 0;
+
+    if (!agent) return;
+
+    agent_stop(agent);
+
+    /* Client threads notice stopping within one tick */
+    while (atomic_load(&agent->active) > 0 && waited < STOP_WAIT_MS) {
+        platform_sleep_ms(10);
+        waited += 10;
+    }
+    if (atomic_load(&agent->active) > 0) {
+        LOG_WARNING("Agent requests still running; leaving agent state allocated");
+        return;
+    }
+
+    if (agent->listen_fd >= 0) {
+        close(agent->listen_fd);
+    }
+    if (agent->socket_path[0]) {
+        unlink(agent->socket_path);
+    }
+
+    while ((session = agent->idle) != NULL) {
+        agent->idle = session->next;
+        close_session(session, "agent shutting down");
+    }
+
+    if (agent->lock) {
+        platform_mutex_destroy(agent->lock);
+    }
+    if (agent->password) {
+        memset(agent->password, 0, strlen(agent->password));
+        free(agent->password);
+    }
+    free(agent);
+}
+
+/* Get agent statistics */
+agent_stats_t agent_get_stats(agent_t *agent) {
+    agent_stats_t stats = {0};
+
+    if (agent) {
+        platform_mutex_lock(agent->lock);
+        stats = agent->stats;
+        platform_mutex_unlock(agent->lock);
+        stats.active_streams = (uint32_t)atomic_load(&agent->active);
+    }
+
+    return stats;
+}
+
+/* Open a stream to a peer through an agent */
+int agent_open_stream(const char *socket_path, const char *host, int port, int *fd) {
+    char line[AGENT_MAX_REQUEST];
+    int result, agent_fd;
+
+    if (!host || !fd || !valid_token(host) || port <= 0 || port > 65535) {
+        return AGENT_ERROR_PARAM;
+    }
+
+    result = connect_agent(socket_path, &agent_fd);
+    if (result != AGENT_SUCCESS) {
+        return result;
+    }
+
+    snprintf(line, sizeof(line), "STREAM %s %d\n", host, port);
+    if (write_all(agent_fd, line, strlen(line)) != 0 ||
+        read_line(agent_fd, line, sizeof(line), -1) != 0) {
+        close(agent_fd);
+        return AGENT_ERROR_PROTOCOL;
+    }
+
+    if (strcmp(line, "OK") != 0) {
+        LOG_ERROR("Agent: %s", strncmp(line, "ERR ", 4) == 0 ? line + 4 : line);
+        close(agent_fd);
+        return AGENT_ERROR_PEER;
+    }
+
+    *fd = agent_fd;
+    return AGENT_SUCCESS;
+}
+
+/* Send a file to a peer through an agent */
+int agent_send_file(const char *socket_path, const char *host, int port,
+                    const char *path, uint64_t *bytes_sent) {
+    char line[AGENT_MAX_REQUEST];
+    int result, agent_fd;
+    int written;
+
+    if (!host || !path || !valid_token(host) || path[0] != '/' ||
+        strpbrk(path, "\r\n") || port <= 0 || port > 65535) {
+        return AGENT_ERROR_PARAM;
+    }
+
+    written = snprintf(line, sizeof(line), "SEND %s %d %s\n", host, port, path);
+    if (written < 0 || (size_t)written >= sizeof(line)) {
+        return AGENT_ERROR_PARAM;
+    }
+
+    result = connect_agent(socket_path, &agent_fd);
+    if (result != AGENT_SUCCESS) {
+        return result;
+    }
+
+    /* The answer comes once the whole file has been sent */
+    if (write_all(agent_fd, line, strlen(line)) != 0 ||
+        read_line(agent_fd, line, sizeof(line), -1) != 0) {
+        close(agent_fd);
+        return AGENT_ERROR_PROTOCOL;
+    }
+    close(agent_fd);
+
+    if (strncmp(line, "OK ", 3) != 0) {
+        LOG_ERROR("Agent: %s", strncmp(line, "ERR ", 4) == 0 ? line + 4 : line);
+        return AGENT_ERROR_PEER;
+    }
+
+    if (bytes_sent) {
+        *bytes_sent = strtoull(line + 3, NULL, 10);
+    }
+    return AGENT_SUCCESS;
+}
+
+/* Take a session out of an agent */
+int agent_take_session(const char *socket_path, const char *host, int port,
+                       connection_t **conn) {
+    char line[AGENT_MAX_REQUEST];
+    int result, agent_fd;
+
+    if (!host || !conn || !valid_token(host) || port <= 0 || port > 65535) {
+        return AGENT_ERROR_PARAM;
+    }
+
+    result = connect_agent(socket_path, &agent_fd);
+    if (result != AGENT_SUCCESS) {
+        return result;
+    }
+
+    /* The reply line is read a byte at a time, so the passed connection
+     * behind it stays in the socket */
+    snprintf(line, sizeof(line), "TAKE %s %d\n", host, port);
+    if (write_all(agent_fd, line, strlen(line)) != 0 ||
+        read_line(agent_fd, line, sizeof(line), -1) != 0) {
+        close(agent_fd);
+        return AGENT_ERROR_PROTOCOL;
+    }
+
+    if (strcmp(line, "OK") != 0) {
+        LOG_ERROR("Agent: %s", strncmp(line, "ERR ", 4) == 0 ? line + 4 : line);
+        close(agent_fd);
+        return AGENT_ERROR_PEER;
+    }
+
+    *conn = accept_passed_connection(agent_fd, REQUEST_TIMEOUT_MS);
+    close(agent_fd);
+    return *conn ? AGENT_SUCCESS : AGENT_ERROR_PROTOCOL;
+}
+
+/* Internal: Serve one client request */
+static void* client_thread(void *arg) {
+    agent_client_t *client = (agent_client_t*)arg;
+    agent_t *agent = client->agent;
+    char line[AGENT_MAX_REQUEST];
+    char *command, *host, *port_str, *path = NULL, *saveptr = NULL;
+    pooled_session_t *session;
+    uint64_t bytes_sent = 0;
+    char detail[32];
+    int port, clean;
+
+    if (read_line(client->fd, line, sizeof(line), REQUEST_TIMEOUT_MS) != 0) {
+        goto done;
+    }
+
+    command = strtok_r(line, " ", &saveptr);
+    host = strtok_r(NULL, " ", &saveptr);
+    port_str = strtok_r(NULL, " ", &saveptr);
+    if (command && strcmp(command, "SEND") == 0) {
+        path = saveptr;             /* The rest of the line, spaces included */
+    }
+
+    port = port_str ? atoi(port_str) : 0;
+    if (!command || !host || port <= 0 || port > 65535 ||
+        strlen(host) >= AGENT_HOST_MAX ||
+        (strcmp(command, "STREAM") != 0 && strcmp(command, "TAKE") != 0 &&
+         !(path && *path))) {
+        write_reply(client->fd, "ERR", "malformed request");
+        goto done;
+    }
+
+    platform_mutex_lock(agent->lock);
+    agent->stats.requests++;
+    platform_mutex_unlock(agent->lock);
+
+    session = checkout_session(agent, host, port);
+    if (!session) {
+        write_reply(client->fd, "ERR", "cannot reach peer");
+        goto done;
+    }
+
+    if (path) {
+        clean = run_send(agent, session->conn, path, &bytes_sent) == FILE_TRANSFER_SUCCESS;
+        snprintf(detail, sizeof(detail), "%llu", (unsigned long long)bytes_sent);
+        write_reply(client->fd, clean ? "OK" : "ERR", clean ? detail : "transfer failed");
+        clean = clean && drain_session(session->conn, 0);
+    } else if (strcmp(command, "TAKE") == 0) {
+        if (get_connection_compression(session->conn) || get_connection_datagram(session->conn)) {
+            write_reply(client->fd, "ERR", "session cannot be passed");
+            clean = 1;
+        } else if (write_reply(client->fd, "OK", NULL) == 0 &&
+                   pass_connection(client->fd, session->conn, REQUEST_TIMEOUT_MS) == NETWORK_SUCCESS) {
+            /* The client owns the session now */
+            free(session->conn);
+            free(session);
+            platform_mutex_lock(agent->lock);
+            agent->stats.sessions_passed++;
+            platform_mutex_unlock(agent->lock);
+            goto done;
+        } else {
+            clean = 0;
+        }
+    } else {
+        clean = write_reply(client->fd, "OK", NULL) == 0 &&
+                run_stream(agent, client->fd, session->conn);
+    }
+
+    release_session(agent, session, clean);
+
+done:
+    close(client->fd);
+    free(client);
+    atomic_fetch_sub(&agent->active, 1);
+    return NULL;
+}
+
+/* Internal: Only serve processes of the agent's own user */
+static int client_allowed(int fd) {
+#ifdef __linux__
+    struct ucred cred;
+    socklen_t len = sizeof(cred);
+
+    if (getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &len) != 0) {
+        return 0;
+    }
+    return cred.uid == geteuid();
+#else
+    (void)fd;
+    return 1;                       /* The socket's mode is the only check */
+#endif
+}
+
+/* Internal: Read one '\n'-terminated line (timeout_ms < 0 waits forever) */
+static int read_line(int fd, char *line, size_t line_len, int timeout_ms) {
+    size_t used = 0;
+
+    while (used + 1 < line_len) {
+        char c;
+        ssize_t got;
+
+        if (timeout_ms >= 0) {
+            struct pollfd pfd = { .fd = fd, .events = POLLIN };
+            if (poll(&pfd, 1, timeout_ms) <= 0) {
+                return -1;
+            }
+        }
+
+        got = recv(fd, &c, 1, 0);
+        if (got < 0 && errno == EINTR) {
+            continue;
+        }
+        if (got <= 0) {
+            return -1;
+        }
+
+        if (c == '\n') {
+            line[used] = '\0';
+            return 0;
+        }
+        line[used++] = c;
+    }
+
+    return -1;
+}
+
+/* Internal: Write everything, without SIGPIPE on a departed client */
+static int write_all(int fd, const void *data, size_t len) {
+    const unsigned char *p = (const unsigned char*)data;
+
+    while (len > 0) {
+        ssize_t sent = send(fd, p, len, MSG_NOSIGNAL);
+
+        if (sent < 0 && errno == EINTR) {
+            continue;
+        }
+        if (sent <= 0) {
+            return -1;
+        }
+        p += sent;
+        len -= (size_t)sent;
+    }
+
+    return 0;
+}
+
+/* Internal: Reply "STATUS[ detail]\n" */
+static int write_reply(int fd, const char *status, const char *detail) {
+    char line[128];
+
+    snprintf(line, sizeof(line), "%s%s%s\n", status, detail ? " " : "", detail ? detail : "");
+    return write_all(fd, line, strlen(line));
+}
+
+/* Internal: Relay a client's bytes as MSG_DATA and the peer's MSG_DATA back.
+ * Returns 1 if the session is clean and can be pooled again */
+static int run_stream(agent_t *agent, int client_fd, connection_t *conn) {
+    static _Thread_local unsigned char buffer[STREAM_BUFFER];
+    int sockfd = get_connection_socket(conn);
+    int client_open = 1;            /* Still reading the client */
+    int client_gone = 0;            /* Replies go nowhere */
+
+    while (!atomic_load(&agent->stopping)) {
+        struct pollfd pfds[2];
+        int ready;
+
+        pfds[0].fd = client_fd;
+        pfds[0].events = client_open ? POLLIN : 0;
+        pfds[0].revents = 0;
+        pfds[1].fd = sockfd;
+        pfds[1].events = POLLIN;
+        pfds[1].revents = 0;
+
+        /* After the client's last byte, wait only for the peer to go quiet */
+        ready = poll(pfds, 2, client_open ? AGENT_TICK_MS : DRAIN_QUIET_MS);
+        if (ready < 0) {
+            if (errno == EINTR) continue;
+            return 0;
+        }
+        if (ready == 0) {
+            if (!client_open) {
+                return 1;
+            }
+            continue;
+        }
+
+        if (client_open && (pfds[0].revents & (POLLIN | POLLHUP | POLLERR))) {
+            ssize_t got = recv(client_fd, buffer, STREAM_CHUNK, 0);
+
+            if (got > 0) {
+                if (send_message(conn, MSG_DATA, buffer, (size_t)got) != PROTOCOL_SUCCESS) {
+                    return 0;
+                }
+            } else if (got == 0 || errno != EINTR) {
+                client_open = 0;
+                client_gone = got < 0;
+            }
+        }
+
+        if (pfds[1].revents & (POLLIN | POLLHUP | POLLERR)) {
+            message_type_t msg_type;
+            size_t len = sizeof(buffer);
+            int result = receive_message(conn, &msg_type, buffer, &len);
+
+            if (result == PROTOCOL_IN_PROGRESS) {
+                continue;
+            }
+            if (result != PROTOCOL_SUCCESS) {
+                return 0;
+            }
+            if (msg_type == MSG_DATA && !client_gone &&
+                write_all(client_fd, buffer, len) != 0) {
+                client_gone = 1;
+                client_open = 0;
+            }
+        }
+    }
+
+    return 0;
+}
+
+/* Internal: Send a file on a leased session */
+static int run_send(agent_t *agent, connection_t *conn, const char *path,
+                    uint64_t *bytes_sent) {
+    file_transfer_t *transfer;
+    int status = FILE_TRANSFER_IN_PROGRESS;
+
+    transfer = start_file_send(conn, path);
+    if (!transfer) {
+        return FILE_TRANSFER_ERROR_IO;
+    }
+
+    while (status == FILE_TRANSFER_IN_PROGRESS && !atomic_load(&agent->stopping)) {
+        status = process_file_transfer(transfer);
+    }
+
+    *bytes_sent = get_file_transfer_info(transfer).bytes_transferred;
+    cleanup_file_transfer(transfer);
+
+    return status;
+}
+
+/* Internal: Consume whatever the peer sent until it has been quiet for
+ * quiet_ms. Returns 1 if the session is still usable */
+static int drain_session(connection_t *conn, int quiet_ms) {
+    static _Thread_local unsigned char buffer[STREAM_BUFFER];
+    int sockfd = get_connection_socket(conn);
+    int ready;
+
+    if (!is_connection_ready(conn)) {
+        return 0;
+    }
+
+    while ((ready = wait_for_socket(sockfd, quiet_ms, 1, 0)) > 0) {
+        message_type_t msg_type;
+        size_t len = sizeof(buffer);
+        int result = receive_message(conn, &msg_type, buffer, &len);
+
+        if (result != PROTOCOL_SUCCESS && result != PROTOCOL_IN_PROGRESS) {
+            return 0;
+        }
+    }
+
+    return ready == 0;
+}
+
+/* Internal: Lend a warm session to host:port, or open one */
+static pooled_session_t* checkout_session(agent_t *agent, const char *host, int port) {
+    pooled_session_t *session, **link;
+
+    for (;;) {
+        platform_mutex_lock(agent->lock);
+        for (link = &agent->idle; (session = *link) != NULL; link = &session->next) {
+            if (session->port == port && strcmp(session->host, host) == 0) {
+                *link = session->next;
+                agent->stats.idle_sessions--;
+                break;
+            }
+        }
+        platform_mutex_unlock(agent->lock);
+
+        if (!session) {
+            break;
+        }
+
+        /* The peer may have closed it while it sat in the pool */
+        if (drain_session(session->conn, 0)) {
+            platform_mutex_lock(agent->lock);
+            agent->stats.sessions_reused++;
+            platform_mutex_unlock(agent->lock);
+            LOG_DEBUG("Reusing session to %s:%d", host, port);
+            return session;
+        }
+
+        close_session(session, NULL);
+        platform_mutex_lock(agent->lock);
+        agent->stats.sessions_expired++;
+        platform_mutex_unlock(agent->lock);
+    }
+
+    session = calloc(1, sizeof(pooled_session_t));
+    if (!session) {
+        LOG_ERROR("Memory allocation failed");
+        return NULL;
+    }
+    strncpy(session->host, host, sizeof(session->host) - 1);
+    session->port = port;
+
+    session->conn = connect_to_host(host, port, agent->password);
+    if (!session->conn ||
+        perform_handshake(session->conn, 0, agent->password) != PROTOCOL_SUCCESS) {
+        LOG_ERROR("Agent could not open a session to %s:%d", host, port);
+        close_session(session, NULL);
+        return NULL;
+    }
+
+    platform_mutex_lock(agent->lock);
+    agent->stats.sessions_opened++;
+    platform_mutex_unlock(agent->lock);
+    LOG_DEBUG("Opened session to %s:%d", host, port);
+
+    return session;
+}
+
+/* Internal: Return a lent session to the pool, or close it */
+static void release_session(agent_t *agent, pooled_session_t *session, int clean) {
+    pooled_session_t *other;
+    int same_peer = 0;
+
+    if (clean && !atomic_load(&agent->stopping)) {
+        platform_mutex_lock(agent->lock);
+        for (other = agent->idle; other; other = other->next) {
+            if (other->port == session->port && strcmp(other->host, session->host) == 0) {
+                same_peer++;
+            }
+        }
+
+        if (same_peer < agent->options.max_idle_per_peer) {
+            session->idle_since_ms = platform_get_time_ms();
+            session->last_sent_ms = session->idle_since_ms;
+            session->next = agent->idle;
+            agent->idle = session;
+            agent->stats.idle_sessions++;
+            platform_mutex_unlock(agent->lock);
+            return;
+        }
+        platform_mutex_unlock(agent->lock);
+    }
+
+    close_session(session, clean ? "pool full" : NULL);
+}
+
+/* Internal: Close a session (telling the peer why when it is still in sync) */
+static void close_session(pooled_session_t *session, const char *reason) {
+    if (session->conn) {
+        if (reason) {
+            send_disconnect(session->conn, reason);
+        }
+        close_connection(session->conn);
+        free(session->conn);
+    }
+    free(session);
+}
+
+/* Internal: Expire idle sessions and keep the rest alive */
+static void maintain_pool(agent_t *agent) {
+    pooled_session_t *session, **link, *expired = NULL;
+    uint64_t now = platform_get_time_ms();
+
+    platform_mutex_lock(agent->lock);
+    link = &agent->idle;
+    while ((session = *link) != NULL) {
+        int expire = now - session->idle_since_ms >= (uint64_t)agent->options.idle_timeout_ms;
+
+        if (!expire && now - session->last_sent_ms >= (uint64_t)agent->options.keepalive_ms) {
+            expire = send_keepalive(session->conn) != PROTOCOL_SUCCESS;
+            session->last_sent_ms = now;
+        }
+
+        if (expire) {
+            *link = session->next;
+            session->next = expired;
+            expired = session;
+            agent->stats.idle_sessions--;
+            agent->stats.sessions_expired++;
+        } else {
+            link = &session->next;
+        }
+    }
+    platform_mutex_unlock(agent->lock);
+
+    while ((session = expired) != NULL) {
+        expired = session->next;
+        LOG_DEBUG("Closing idle session to %s:%d", session->host, session->port);
+        close_session(session, "idle");
+    }
+}
+
+/* Internal: Connect to an agent socket */
+static int connect_agent(const char *socket_path, int *fd) {
+    char default_path[sizeof(((struct sockaddr_un*)0)->sun_path)];
+    struct sockaddr_un addr;
+
+    if (!socket_path) {
+        if (agent_default_socket_path(default_path, sizeof(default_path)) != AGENT_SUCCESS) {
+            return AGENT_ERROR_PARAM;
+        }
+        socket_path = default_path;
+    }
+
+    if (strlen(socket_path) >= sizeof(addr.sun_path)) {
+        return AGENT_ERROR_PARAM;
+    }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, socket_path, sizeof(addr.sun_path) - 1);
+
+    *fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (*fd < 0) {
+        return AGENT_ERROR_SYSTEM;
+    }
+
+    if (connect(*fd, (struct sockaddr*)&addr, sizeof(addr)) != 0) {
+        close(*fd);
+        *fd = -1;
+        return AGENT_ERROR_UNAVAILABLE;
+    }
+
+    return AGENT_SUCCESS;
+}
+
+/* Internal: A request token must not split the request line */
+static int valid_token(const char *text) {
+    return *text && !strpbrk(text, " \t\r\n") && strlen(text) < AGENT_HOST_MAX;
+}
+
+/* Get error message */
+const char* agent_strerror(int error_code) {
+    switch (error_code) {
+        case AGENT_SUCCESS:
+            return "Success";
+        case AGENT_ERROR_PARAM:
+            return "Invalid parameter";
+        case AGENT_ERROR_MEMORY:
+            return "Memory allocation failed";
+        case AGENT_ERROR_SYSTEM:
+            return "System call failed";
+        case AGENT_ERROR_UNAVAILABLE:
+            return "No agent is running";
+        case AGENT_ERROR_PEER:
+            return "Agent could not serve the request";
+        case AGENT_ERROR_PROTOCOL:
+            return "Agent connection failed";
+        default:
+            return "Unknown error";
+    }
+}
@@ -0,0 +1,534 @@
+/*
+ * Cryptcat Compression Stage
+ * Record compression applied before sealing (zlib / LZ4 / zstd)
+ * Version: 1.0.0
+ * License: MIT
+ *
+ * Codecs are enabled at build time with HAVE_ZLIB, HAVE_LZ4 and
+ * HAVE_ZSTD. Each connection keeps streaming compressor/decompressor
+ * state so back-references reach into earlier records.
+ */
+
+#include "compression.h"
+#include "utils/logger.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+#ifdef HAVE_LZ4
+#include <lz4.h>
+#endif
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+/* Compression constants */
+#define PROBE_SIZE 1024              /* Bytes sampled by the entropy probe */
+#define MIN_COMPRESS_SIZE 64         /* Smaller records are always stored */
+#define ZLIB_LEVEL 3
+#define ZSTD_LEVEL 3
+#define LZ4_ACCELERATION 1
+#define LZ4_HISTORY_SIZE 65536       /* LZ4 window */
+
+/* Per-connection compression state */
+typedef struct compression_ctx_s {
+    compression_codec_t codec;
+    size_t max_record;
+    unsigned char *scratch;          /* Encoded output (header + body) */
+    size_t scratch_size;
+    unsigned char *plain;            /* Decoded output of the last record */
+    compression_stats_t stats;
+#ifdef HAVE_ZLIB
+    z_stream deflate_stream;
+    z_stream inflate_stream;
+    int zlib_ready;
+#endif
+#ifdef HAVE_LZ4
+    LZ4_stream_t *lz4_stream;
+    unsigned char *lz4_dict;         /* Compressor history (saved dict) */
+    unsigned char *lz4_history;      /* Decompressor history */
+    size_t lz4_history_len;
+#endif
+#ifdef HAVE_ZSTD
+    ZSTD_CCtx *zstd_cctx;
+    ZSTD_DCtx *zstd_dctx;
+#endif
+} compression_ctx_t;
+
+/* Internal function prototypes */
+static int codec_init(compression_ctx_t *ctx);
+static void codec_free(compression_ctx_t *ctx);
+static int codec_compress(compression_ctx_t *ctx, const unsigned char *input,
+                         size_t input_len, unsigned char *output,
+                         size_t output_cap, size_t *output_len);
+static int codec_decompress(compression_ctx_t *ctx, const unsigned char *input,
+                           size_t input_len, unsigned char *output,
+                           size_t output_cap, size_t *output_len);
+
+/* Get bitmask of compiled-in codecs */
+uint8_t compression_supported_mask(void) {
+    uint8_t mask = 0;
+
+#ifdef HAVE_ZLIB
+    mask |= 1u << COMPRESSION_ZLIB;
+#endif
+#ifdef HAVE_LZ4
+    mask |= 1u << COMPRESSION_LZ4;
+#endif
+#ifdef HAVE_ZSTD
+    mask |= 1u << COMPRESSION_ZSTD;
+#endif
+
+    return mask;
+}
+
+/* Select preferred common codec */
+compression_codec_t compression_select(uint8_t peer_mask) {
+    static const compression_codec_t preference[] = {
+        COMPRESSION_ZSTD, COMPRESSION_LZ4, COMPRESSION_ZLIB
+    };
+    uint8_t common = peer_mask & compression_supported_mask();
+
+    for (size_t i = 0; i < sizeof(preference) / sizeof(preference[0]); i++) {
+        if (common & (1u << preference[i])) {
+            return preference[i];
+        }
+    }
+
+    return COMPRESSION_NONE;
+}
+
+/* Create compression context */
+compression_ctx_t* compression_create(compression_codec_t codec, size_t max_record) {
+    compression_ctx_t *ctx;
+
+    if (codec == COMPRESSION_NONE || max_record == 0 ||
+        !(compression_supported_mask() & (1u << codec))) {
+        LOG_ERROR("Unsupported compression codec: %d", codec);
+        return NULL;
+    }
+
+    ctx = calloc(1, sizeof(compression_ctx_t));
+    if (!ctx) {
+        LOG_ERROR("Memory allocation failed");
+        return NULL;
+    }
+
+    ctx->codec = codec;
+    ctx->max_record = max_record;
+    ctx->stats.codec = codec;
+    ctx->scratch_size = COMPRESSION_HEADER_SIZE + max_record + COMPRESSION_MAX_EXPANSION;
+    ctx->scratch = malloc(ctx->scratch_size);
+    ctx->plain = malloc(max_record);
+
+    if (!ctx->scratch || !ctx->plain || codec_init(ctx) != COMPRESSION_SUCCESS) {
+        LOG_ERROR("Failed to initialize %s compression",
+                  compression_codec_name(codec));
+        compression_destroy(ctx);
+        return NULL;
+    }
+
+    LOG_DEBUG("Compression enabled: %s", compression_codec_name(codec));
+    return ctx;
+}
+
+/* Destroy compression context */
+void compression_destroy(compression_ctx_t *ctx) {
+    if (!ctx) return;
+
+    codec_free(ctx);
+
+    if (ctx->scratch) {
+        memset(ctx->scratch, 0, ctx->scratch_size);
+        free(ctx->scratch);
+    }
+
+    if (ctx->plain) {
+        memset(ctx->plain, 0, ctx->max_record);
+        free(ctx->plain);
+    }
+
+    free(ctx);
+}
+
+/* Compress one record */
+int compression_compress_record(compression_ctx_t *ctx,
+                               const unsigned char *input, size_t input_len,
+                               const unsigned char **output, size_t *output_len) {
+    size_t body_len = 0;
+    int result;
+
+    if (!ctx || !input || !output || !output_len || input_len > ctx->max_record) {
+        return COMPRESSION_ERROR_PARAM;
+    }
+
+    ctx->stats.bytes_in += input_len;
+
+    /*
+     * Stored records bypass the codec entirely, so both stream histories
+     * stay in step. Once a record has gone through the codec it must be
+     * sent compressed even if it grew.
+     */
+    if (input_len < MIN_COMPRESS_SIZE || !compression_is_compressible(input, input_len)) {
+        ctx->scratch[0] = COMPRESSION_NONE;
+        memcpy(ctx->scratch + COMPRESSION_HEADER_SIZE, input, input_len);
+        body_len = input_len;
+        ctx->stats.records_stored++;
+    } else {
+        result = codec_compress(ctx, input, input_len,
+                                ctx->scratch + COMPRESSION_HEADER_SIZE,
+                                ctx->scratch_size - COMPRESSION_HEADER_SIZE,
+                                &body_len);
+        if (result != COMPRESSION_SUCCESS) {
+            return result;
+        }
+        ctx->scratch[0] = (unsigned char)ctx->codec;
+        ctx->stats.records_compressed++;
+    }
+
+    *output = ctx->scratch;
+    *output_len = COMPRESSION_HEADER_SIZE + body_len;
+    ctx->stats.bytes_out += *output_len;
+
+    return COMPRESSION_SUCCESS;
+}
+
+/* Decompress one record in place */
+int compression_decompress_record(compression_ctx_t *ctx, const unsigned char *record,
+                                 size_t record_len, const unsigned char **output,
+                                 size_t *output_len) {
+    size_t body_len, decoded = 0;
+    int result;
+
+    if (!ctx || !record || !output || !output_len || record_len < COMPRESSION_HEADER_SIZE) {
+        return COMPRESSION_ERROR_PARAM;
+    }
+
+    body_len = record_len - COMPRESSION_HEADER_SIZE;
+
+    if (record[0] == COMPRESSION_NONE) {
+        *output = record + COMPRESSION_HEADER_SIZE;
+        *output_len = body_len;
+        return COMPRESSION_SUCCESS;
+    }
+
+    if (record[0] != (unsigned char)ctx->codec) {
+        LOG_ERROR("Record uses codec %u, negotiated %s", record[0],
+                  compression_codec_name(ctx->codec));
+        return COMPRESSION_ERROR_CORRUPT;
+    }
+
+    result = codec_decompress(ctx, record + COMPRESSION_HEADER_SIZE, body_len,
+                              ctx->plain, ctx->max_record, &decoded);
+    if (result != COMPRESSION_SUCCESS) {
+        return result;
+    }
+
+    *output = ctx->plain;
+    *output_len = decoded;
+    return COMPRESSION_SUCCESS;
+}
+
+/*
+ * Entropy probe: estimate the collision (order-2) entropy of the first
+ * PROBE_SIZE bytes. Above ~7.5 bits/byte (sum p^2 < 2^-7.5) the data is
+ * effectively random - ciphertext, media, already-compressed archives.
+ */
+int compression_is_compressible(const unsigned char *data, size_t len) {
+    uint32_t histogram[256] = {0};
+    uint64_t collisions = 0;
+    size_t n = len < PROBE_SIZE ? len : PROBE_SIZE;
+
+    if (!data || n < 2) {
+        return 0;
+    }
+
+    for (size_t i = 0; i < n; i++) {
+        histogram[data[i]]++;
+    }
+
+    for (int i = 0; i < 256; i++) {
+        if (histogram[i] > 1) {
+            collisions += (uint64_t)histogram[i] * (histogram[i] - 1);
+        }
+    }
+
+    /* collisions / (n * (n - 1)) >= 2^-7.5 ~= 0.00552 */
+    return collisions * 100000 >= (uint64_t)n * (n - 1) * 552;
+}
+
+/* Get compression statistics */
+compression_stats_t compression_get_stats(const compression_ctx_t *ctx) {
+    compression_stats_t stats = {0};
+
+    if (ctx) {
+        stats = ctx->stats;
+    }
+
+    return stats;
+}
+
+/* Get codec name */
+const char* compression_codec_name(compression_codec_t codec) {
+    switch (codec) {
+        case COMPRESSION_NONE:
+            return "none";
+        case COMPRESSION_ZLIB:
+            return "zlib";
+        case COMPRESSION_LZ4:
+            return "lz4";
+        case COMPRESSION_ZSTD:
+            return "zstd";
+        default:
+            return "unknown";
+    }
+}
+
+/* Get compression error string */
+const char* compression_strerror(int error_code) {
+    switch (error_code) {
+        case COMPRESSION_SUCCESS:
+            return "Success";
+        case COMPRESSION_ERROR_PARAM:
+            return "Invalid parameter";
+        case COMPRESSION_ERROR_MEMORY:
+            return "Memory allocation failed";
+        case COMPRESSION_ERROR_CODEC:
+            return "Codec failure";
+        case COMPRESSION_ERROR_CORRUPT:
+            return "Corrupted compressed data";
+        case COMPRESSION_ERROR_BUFFER:
+            return "Buffer too small";
+        default:
+            return "Unknown compression error";
+    }
+}
+
+/* Internal: Initialize codec streams */
+static int codec_init(compression_ctx_t *ctx) {
+    switch (ctx->codec) {
+#ifdef HAVE_ZLIB
+        case COMPRESSION_ZLIB:
+            if (deflateInit(&ctx->deflate_stream, ZLIB_LEVEL) != Z_OK) {
+                return COMPRESSION_ERROR_CODEC;
+            }
+            if (inflateInit(&ctx->inflate_stream) != Z_OK) {
+                deflateEnd(&ctx->deflate_stream);
+                return COMPRESSION_ERROR_CODEC;
+            }
+            ctx->zlib_ready = 1;
+            return COMPRESSION_SUCCESS;
+#endif
+#ifdef HAVE_LZ4
+        case COMPRESSION_LZ4:
+            ctx->lz4_stream = LZ4_createStream();
+            ctx->lz4_dict = malloc(LZ4_HISTORY_SIZE);
+            ctx->lz4_history = malloc(LZ4_HISTORY_SIZE);
+            if (!ctx->lz4_stream || !ctx->lz4_dict || !ctx->lz4_history) {
+                return COMPRESSION_ERROR_MEMORY;
+            }
+            return COMPRESSION_SUCCESS;
+#endif
+#ifdef HAVE_ZSTD
+        case COMPRESSION_ZSTD:
+            ctx->zstd_cctx = ZSTD_createCCtx();
+            ctx->zstd_dctx = ZSTD_createDCtx();
+            if (!ctx->zstd_cctx || !ctx->zstd_dctx) {
+                return COMPRESSION_ERROR_MEMORY;
+            }
+            ZSTD_CCtx_setParameter(ctx->zstd_cctx, ZSTD_c_compressionLevel, ZSTD_LEVEL);
+            return COMPRESSION_SUCCESS;
+#endif
+        default:
+            return COMPRESSION_ERROR_CODEC;
+    }
+}
+
+/* Internal: Release codec streams */
+static void codec_free(compression_ctx_t *ctx) {
+#ifdef HAVE_ZLIB
+    if (ctx->zlib_ready) {
+        deflateEnd(&ctx->deflate_stream);
+        inflateEnd(&ctx->inflate_stream);
+        ctx->zlib_ready = 0;
+    }
+#endif
+#ifdef HAVE_LZ4
+    if (ctx->lz4_stream) LZ4_freeStream(ctx->lz4_stream);
+    if (ctx->lz4_dict) {
+        memset(ctx->lz4_dict, 0, LZ4_HISTORY_SIZE);
+        free(ctx->lz4_dict);
+    }
+    if (ctx->lz4_history) {
+        memset(ctx->lz4_history, 0, LZ4_HISTORY_SIZE);
+        free(ctx->lz4_history);
+    }
+    ctx->lz4_stream = NULL;
+    ctx->lz4_dict = NULL;
+    ctx->lz4_history = NULL;
+#endif
+#ifdef HAVE_ZSTD
+    if (ctx->zstd_cctx) ZSTD_freeCCtx(ctx->zstd_cctx);
+    if (ctx->zstd_dctx) ZSTD_freeDCtx(ctx->zstd_dctx);
+    ctx->zstd_cctx = NULL;
+    ctx->zstd_dctx = NULL;
+#endif
+    (void)ctx;
+}
+
+/* Internal: Compress through the persistent stream */
+static int codec_compress(compression_ctx_t *ctx, const unsigned char *input,
+                         size_t input_len, unsigned char *output,
+                         size_t output_cap, size_t *output_len) {
+    switch (ctx->codec) {
+#ifdef HAVE_ZLIB
+        case COMPRESSION_ZLIB: {
+            z_stream *zs = &ctx->deflate_stream;
+            zs->next_in = (Bytef*)input;
+            zs->avail_in = (uInt)input_len;
+            zs->next_out = output;
+            zs->avail_out = (uInt)output_cap;
+
+            /* Sync flush ends the record on a byte boundary, keeps the window */
+            if (deflate(zs, Z_SYNC_FLUSH) != Z_OK || zs->avail_in != 0 ||
+                zs->avail_out == 0) {
+                LOG_ERROR("deflate failed");
+                return COMPRESSION_ERROR_CODEC;
+            }
+            *output_len = output_cap - zs->avail_out;
+            return COMPRESSION_SUCCESS;
+        }
+#endif
+#ifdef HAVE_LZ4
+        case COMPRESSION_LZ4: {
+            int written = LZ4_compress_fast_continue(ctx->lz4_stream,
+                                                     (const char*)input,
+                                                     (char*)output,
+                                                     (int)input_len,
+                                                     (int)output_cap,
+                                                     LZ4_ACCELERATION);
+            if (written <= 0) {
+                LOG_ERROR("LZ4 compression failed");
+                return COMPRESSION_ERROR_CODEC;
+            }
+
+            /* Caller's buffer goes away; keep the window in our own memory */
+            LZ4_saveDict(ctx->lz4_stream, (char*)ctx->lz4_dict, LZ4_HISTORY_SIZE);
+            *output_len = (size_t)written;
+            return COMPRESSION_SUCCESS;
+        }
+#endif
+#ifdef HAVE_ZSTD
+        case COMPRESSION_ZSTD: {
+            ZSTD_inBuffer in = { input, input_len, 0 };
+            ZSTD_outBuffer out = { output, output_cap, 0 };
+            size_t remaining;
+
+            do {
+                remaining = ZSTD_compressStream2(ctx->zstd_cctx, &out, &in,
+                                                 ZSTD_e_flush);
+                if (ZSTD_isError(remaining)) {
+                    LOG_ERROR("zstd compression failed: %s",
+                              ZSTD_getErrorName(remaining));
+                    return COMPRESSION_ERROR_CODEC;
+                }
+            } while (remaining != 0 && out.pos < out.size);
+
+            if (remaining != 0) {
+                return COMPRESSION_ERROR_BUFFER;
+            }
+            *output_len = out.pos;
+            return COMPRESSION_SUCCESS;
+        }
+#endif
+        default:
+            (void)input; (void)input_len; (void)output;
+            (void)output_cap; (void)output_len;
+            return COMPRESSION_ERROR_CODEC;
+    }
+}
+
+/* Internal: Decompress through the persistent stream */
+static int codec_decompress(compression_ctx_t *ctx, const unsigned char *input,
+                           size_t input_len, unsigned char *output,
+                           size_t output_cap, size_t *output_len) {
+    switch (ctx->codec) {
+#ifdef HAVE_ZLIB
+        case COMPRESSION_ZLIB: {
+            z_stream *zs = &ctx->inflate_stream;
+            int ret;
+            zs->next_in = (Bytef*)input;
+            zs->avail_in = (uInt)input_len;
+            zs->next_out = output;
+            zs->avail_out = (uInt)output_cap;
+
+            ret = inflate(zs, Z_SYNC_FLUSH);
+            if ((ret != Z_OK && ret != Z_BUF_ERROR) || zs->avail_in != 0) {
+                LOG_ERROR("inflate failed: %d", ret);
+                return ret == Z_OK || ret == Z_BUF_ERROR ?
+                       COMPRESSION_ERROR_BUFFER : COMPRESSION_ERROR_CORRUPT;
+            }
+            *output_len = output_cap - zs->avail_out;
+            return COMPRESSION_SUCCESS;
+        }
+#endif
+#ifdef HAVE_LZ4
+        case COMPRESSION_LZ4: {
+            int decoded = LZ4_decompress_safe_usingDict((const char*)input,
+                                                        (char*)output,
+                                                        (int)input_len,
+                                                        (int)output_cap,
+                                                        (const char*)ctx->lz4_history,
+                                                        (int)ctx->lz4_history_len);
+            if (decoded < 0) {
+                LOG_ERROR("LZ4 decompression failed");
+                return COMPRESSION_ERROR_CORRUPT;
+            }
+
+            /* Slide the decoder window to mirror the compressor's dict */
+            if ((size_t)decoded >= LZ4_HISTORY_SIZE) {
+                memcpy(ctx->lz4_history, output + decoded - LZ4_HISTORY_SIZE,
+                       LZ4_HISTORY_SIZE);
+                ctx->lz4_history_len = LZ4_HISTORY_SIZE;
+            } else {
+                size_t keep = LZ4_HISTORY_SIZE - decoded;
+                if (keep > ctx->lz4_history_len) keep = ctx->lz4_history_len;
+                memmove(ctx->lz4_history,
+                        ctx->lz4_history + ctx->lz4_history_len - keep, keep);
+                memcpy(ctx->lz4_history + keep, output, decoded);
+                ctx->lz4_history_len = keep + decoded;
+            }
+
+            *output_len = (size_t)decoded;
+            return COMPRESSION_SUCCESS;
+        }
+#endif
+#ifdef HAVE_ZSTD
+        case COMPRESSION_ZSTD: {
+            ZSTD_inBuffer in = { input, input_len, 0 };
+            ZSTD_outBuffer out = { output, output_cap, 0 };
+
+            while (in.pos < in.size) {
+                size_t ret = ZSTD_decompressStream(ctx->zstd_dctx, &out, &in);
+                if (ZSTD_isError(ret)) {
+                    LOG_ERROR("zstd decompression failed: %s",
+                              ZSTD_getErrorName(ret));
+                    return COMPRESSION_ERROR_CORRUPT;
+                }
+                if (out.pos == out.size && in.pos < in.size) {
+                    return COMPRESSION_ERROR_BUFFER;
+                }
+            }
+            *output_len = out.pos;
+            return COMPRESSION_SUCCESS;
+        }
+#endif
+        default:
+            (void)input; (void)input_len; (void)output;
+            (void)output_cap; (void)output_len;
+            return COMPRESSION_ERROR_CODEC;
+    }
+}
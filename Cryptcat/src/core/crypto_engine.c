@@ -25,6 +25,9 @@
 #define MAX_PASSWORD_LEN 1024     /* Maximum password length */
 #define TAG_SIZE 16               /* Authentication tag size */
 #define BUFFER_SIZE 65536         /* Default buffer size */
+#define SECRET_SIZE (KEY_SIZE * 2) /* Exported session secret */
+#define STATE_SIZE (KEY_SIZE * 2 + (IV_SIZE + 4) * 2 + 16) /* Exported live state */
+#define EXPAND_INFO_MAX 256       /* label || nonce || counter in expand_secret() */
 
 /* Error codes */
 typedef enum {
@@ -65,6 +68,10 @@ static int verify_hmac(const unsigned char *data, size_t data_len,
                       const unsigned char *hmac_key, const unsigned char *hmac);
 static int calculate_hmac(const unsigned char *data, size_t data_len,
                          const unsigned char *hmac_key, unsigned char *hmac);
+static int expand_secret(const unsigned char *secret, const char *label,
+                        const unsigned char *nonce, size_t nonce_len,
+                        unsigned char *out, size_t out_len);
+static int init_cipher_contexts(crypto_session_t *session);
 
 /* Initialize the cryptographic subsystem */
 int crypto_global_init(void) {
@@ -177,12 +184,178 @@ error_cleanup:
     return NULL;
 }
 
+/* Create a session from an exported secret */
+crypto_session_t* crypto_session_create_from_secret(const unsigned char *secret,
+                                                    size_t secret_len,
+                                                    const unsigned char *nonce,
+                                                    size_t nonce_len) {
+    crypto_session_t *session;
+    
+    if (!secret || secret_len != SECRET_SIZE || !nonce || nonce_len == 0) {
+        return NULL;
+    }
+    
+    session = calloc(1, sizeof(crypto_session_t));
+    if (!session) {
+        fprintf(stderr, "Error: Memory allocation failed\n");
+        return NULL;
+    }
+    
+    /* Expand per-connection keys; the resumed secret itself is never used directly */
+    if (expand_secret(secret, "cryptcat resume enc", nonce, nonce_len,
+                      session->enc_key, KEY_SIZE) != CRYPTO_SUCCESS ||
+        expand_secret(secret, "cryptcat resume mac", nonce, nonce_len,
+                      session->hmac_key, KEY_SIZE) != CRYPTO_SUCCESS ||
+        expand_secret(secret, "cryptcat resume iv", nonce, nonce_len,
+                      session->iv, IV_SIZE) != CRYPTO_SUCCESS) {
+        fprintf(stderr, "Error: Key expansion failed\n");
+        memset(session, 0, sizeof(crypto_session_t));
+        free(session);
+        return NULL;
+    }
+    
+    if (init_cipher_contexts(session) != CRYPTO_SUCCESS) {
+        crypto_session_destroy(session);
+        return NULL;
+    }
+    
+    return session;
+}
+
+/* Export session secret for resumption */
+int crypto_session_export_secret(crypto_session_t *session, unsigned char *secret,
+                                 size_t secret_len) {
+    if (!session || !session->is_initialized || !secret || secret_len < SECRET_SIZE) {
+        return CRYPTO_ERROR_INVALID_PARAM;
+    }
+    
+    memcpy(secret, session->enc_key, KEY_SIZE);
+    memcpy(secret + KEY_SIZE, session->hmac_key, KEY_SIZE);
+    
+    return CRYPTO_SUCCESS;
+}
+
+/* Export live session state. Both contexts run CFB128, whose whole
+ * position is the feedback register plus the offset into it */
+int crypto_session_export_state(crypto_session_t *session, unsigned char *state,
+                                size_t state_len) {
+    EVP_CIPHER_CTX *ctxs[2];
+    unsigned char *p = state;
+    uint64_t seq_be;
+    
+    if (!session || !session->is_initialized || !state || state_len < STATE_SIZE) {
+        return CRYPTO_ERROR_INVALID_PARAM;
+    }
+    
+    ctxs[0] = session->encrypt_ctx;
+    ctxs[1] = session->decrypt_ctx;
+    
+    memcpy(p, session->enc_key, KEY_SIZE);
+    p += KEY_SIZE;
+    memcpy(p, session->hmac_key, KEY_SIZE);
+    p += KEY_SIZE;
+    
+    for (int i = 0; i < 2; i++) {
+        int num = EVP_CIPHER_CTX_get_num(ctxs[i]);
+        
+        if (num < 0 || EVP_CIPHER_CTX_get_updated_iv(ctxs[i], p, IV_SIZE) != 1) {
+            memset(state, 0, STATE_SIZE);
+            return CRYPTO_ERROR_INIT;
+        }
+        p += IV_SIZE;
+        p[0] = (unsigned char)(num >> 24);
+        p[1] = (unsigned char)(num >> 16);
+        p[2] = (unsigned char)(num >> 8);
+        p[3] = (unsigned char)num;
+        p += 4;
+    }
+    
+    seq_be = htobe64(session->seq_num_send);
+    memcpy(p, &seq_be, sizeof(seq_be));
+    p += sizeof(seq_be);
+    seq_be = htobe64(session->seq_num_recv);
+    memcpy(p, &seq_be, sizeof(seq_be));
+    
+    return CRYPTO_SUCCESS;
+}
+
+/* Recreate a session from exported state */
+crypto_session_t* crypto_session_import_state(const unsigned char *state, size_t state_len) {
+    crypto_session_t *session;
+    const unsigned char *p = state;
+    EVP_CIPHER_CTX *ctxs[2];
+    uint64_t seq_be;
+    
+    if (!state || state_len != STATE_SIZE) {
+        return NULL;
+    }
+    
+    session = calloc(1, sizeof(crypto_session_t));
+    if (!session) {
+        fprintf(stderr, "Error: Memory allocation failed\n");
+        return NULL;
+    }
+    
+    memcpy(session->enc_key, p, KEY_SIZE);
+    p += KEY_SIZE;
+    memcpy(session->hmac_key, p, KEY_SIZE);
+    p += KEY_SIZE;
+    memcpy(session->iv, p, IV_SIZE);
+    
+    if (init_cipher_contexts(session) != CRYPTO_SUCCESS) {
+        crypto_session_destroy(session);
+        return NULL;
+    }
+    
+    /* Resume each stream at its register and offset */
+    ctxs[0] = session->encrypt_ctx;
+    ctxs[1] = session->decrypt_ctx;
+    for (int i = 0; i < 2; i++) {
+        int num = (int)((uint32_t)p[IV_SIZE] << 24 | (uint32_t)p[IV_SIZE + 1] << 16 |
+                        (uint32_t)p[IV_SIZE + 2] << 8 | p[IV_SIZE + 3]);
+        int ok = i == 0 ? EVP_EncryptInit_ex(ctxs[i], NULL, NULL, NULL, p)
+                        : EVP_DecryptInit_ex(ctxs[i], NULL, NULL, NULL, p);
+        
+        if (ok != 1 || num < 0 || num >= IV_SIZE || EVP_CIPHER_CTX_set_num(ctxs[i], num) != 1) {
+            crypto_session_destroy(session);
+            return NULL;
+        }
+        p += IV_SIZE + 4;
+    }
+    
+    memcpy(&seq_be, p, sizeof(seq_be));
+    session->seq_num_send = be64toh(seq_be);
+    p += sizeof(seq_be);
+    memcpy(&seq_be, p, sizeof(seq_be));
+    session->seq_num_recv = be64toh(seq_be);
+    
+    return session;
+}
+
+/* Derive key material for another layer */
+int crypto_session_derive_key(crypto_session_t *session, const char *label,
+                              const unsigned char *nonce, size_t nonce_len,
+                              unsigned char *out, size_t out_len) {
+    unsigned char secret[SECRET_SIZE];
+    int result;
+    
+    if (!label || !nonce || !out ||
+        crypto_session_export_secret(session, secret, sizeof(secret)) != CRYPTO_SUCCESS) {
+        return CRYPTO_ERROR_INVALID_PARAM;
+    }
+    
+    result = expand_secret(secret, label, nonce, nonce_len, out, out_len);
+    
+    memset(secret, 0, sizeof(secret));
+    return result;
+}
+
 /* Encrypt data with authentication */
 int crypto_encrypt(crypto_session_t *session, const unsigned char *plaintext,
                    size_t plaintext_len, unsigned char *ciphertext,
                    size_t *ciphertext_len) {
     int out_len, final_len;
-    unsigned char encrypted_data[plaintext_len + EVP_MAX_BLOCK_LENGTH];
+    unsigned char *encrypted_data;
     unsigned char hmac[HMAC_SIZE];
     uint64_t seq_be;
     
@@ -199,7 +372,8 @@ int crypto_encrypt(crypto_session_t *session, const unsigned char *plaintext,
         return CRYPTO_ERROR_INVALID_PARAM;
     }
     
-    /* Encrypt the plaintext */
+    /* Encrypt the plaintext in place, after the sequence number */
+    encrypted_data = ciphertext + sizeof(uint64_t);
     if (EVP_EncryptUpdate(session->encrypt_ctx, encrypted_data, &out_len,
                          plaintext, plaintext_len) != 1) {
         fprintf(stderr, "Error: Encryption update failed\n");
@@ -218,9 +392,6 @@ int crypto_encrypt(crypto_session_t *session, const unsigned char *plaintext,
     seq_be = htobe64(session->seq_num_send);
     memcpy(ciphertext, &seq_be, sizeof(uint64_t));
     
-    /* Copy encrypted data */
-    memcpy(ciphertext + sizeof(uint64_t), encrypted_data, out_len);
-    
     /* Calculate HMAC over sequence number + encrypted data */
     if (calculate_hmac(ciphertext, sizeof(uint64_t) + out_len,
                       session->hmac_key, hmac) != CRYPTO_SUCCESS) {
@@ -236,10 +407,9 @@ int crypto_encrypt(crypto_session_t *session, const unsigned char *plaintext,
     /* Update session statistics */
     session->seq_num_send++;
     session->bytes_sent += *ciphertext_len;
-    session->last_activity = time(NULL);
+    session->last_activity = platform_coarse_time();
     
-    /* Securely wipe temporary buffers */
-    memset(encrypted_data, 0, plaintext_len + EVP_MAX_BLOCK_LENGTH);
+    /* Securely wipe temporary buffer */
     memset(hmac, 0, HMAC_SIZE);
     
     return CRYPTO_SUCCESS;
@@ -314,7 +484,7 @@ int crypto_decrypt(crypto_session_t *session, const unsigned char *ciphertext,
     /* Update session state */
     session->seq_num_recv = seq_received;
     session->bytes_received += ciphertext_len;
-    session->last_activity = time(NULL);
+    session->last_activity = platform_coarse_time();
     
     /* Securely wipe temporary buffer */
     memset(calculated_hmac, 0, HMAC_SIZE);
@@ -436,6 +606,59 @@ static int derive_keys(const char *password, const unsigned char *salt,
     return CRYPTO_SUCCESS;
 }
 
+/* Internal function: Expand a secret into labelled key material */
+static int expand_secret(const unsigned char *secret, const char *label,
+                        const unsigned char *nonce, size_t nonce_len,
+                        unsigned char *out, size_t out_len) {
+    unsigned char info[EXPAND_INFO_MAX];
+    unsigned char block[HMAC_SIZE];
+    unsigned int block_len;
+    size_t label_len = strlen(label);
+    int result = CRYPTO_SUCCESS;
+    
+    if (out_len > HMAC_SIZE || label_len + nonce_len + 1 > sizeof(info)) {
+        return CRYPTO_ERROR_INVALID_PARAM;
+    }
+    
+    memcpy(info, label, label_len);
+    memcpy(info + label_len, nonce, nonce_len);
+    info[label_len + nonce_len] = 0x01;
+    
+    /* Single HKDF-Expand block: HMAC(secret, label || nonce || 0x01) */
+    if (HMAC(EVP_sha256(), secret, SECRET_SIZE, info, label_len + nonce_len + 1,
+             block, &block_len) == NULL) {
+        result = CRYPTO_ERROR_KEY;
+    } else {
+        memcpy(out, block, out_len);
+    }
+    
+    memset(block, 0, sizeof(block));
+    return result;
+}
+
+/* Internal function: Set up cipher contexts for a keyed session */
+static int init_cipher_contexts(crypto_session_t *session) {
+    session->encrypt_ctx = EVP_CIPHER_CTX_new();
+    session->decrypt_ctx = EVP_CIPHER_CTX_new();
+    if (!session->encrypt_ctx || !session->decrypt_ctx) {
+        return CRYPTO_ERROR_MEMORY;
+    }
+    
+    if (EVP_EncryptInit_ex(session->encrypt_ctx, EVP_twofish_cfb128(), NULL,
+                          session->enc_key, session->iv) != 1 ||
+        EVP_DecryptInit_ex(session->decrypt_ctx, EVP_twofish_cfb128(), NULL,
+                          session->enc_key, session->iv) != 1) {
+        return CRYPTO_ERROR_INIT;
+    }
+    
+    session->created_at = time(NULL);
+    session->last_activity = session->created_at;
+    session->is_authenticated = 1;
+    session->is_initialized = 1;
+    
+    return CRYPTO_SUCCESS;
+}
+
 /* Internal function: Generate random bytes */
 static int generate_random_bytes(unsigned char *buffer, size_t length) {
     return platform_random_bytes(buffer, length);
@@ -0,0 +1,1275 @@
+/*
+ * Cryptcat Datagram Transport
+ * Sealed UDP records next to an established session, with replay
+ * protection, selective retransmission and batched, offloaded I/O
+ * Version: 1.0.0
+ * License: MIT
+ */
+
+#define _GNU_SOURCE  /* sendmmsg, recvmmsg */
+
+#include "datagram.h"
+#include "protocol.h"
+#include "crypto.h"
+#include "platform.h"
+#include "utils/logger.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <openssl/evp.h>
+
+#ifdef __linux__
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/udp.h>
+#include <arpa/inet.h>
+#define DATAGRAM_SUPPORTED
+#ifndef SOL_UDP
+#define SOL_UDP 17
+#endif
+#ifndef UDP_SEGMENT
+#define UDP_SEGMENT 103
+#endif
+#ifndef UDP_GRO
+#define UDP_GRO 104
+#endif
+#endif
+
+/* Datagram constants */
+#define DATAGRAM_VERSION 1
+#define DATAGRAM_NONCE_SIZE 32
+#define DATAGRAM_KEY_SIZE 32        /* AES-256 */
+#define DATAGRAM_IV_SIZE 12
+#define DATAGRAM_TAG_SIZE 16
+#define DATAGRAM_HEADER_SIZE 10     /* version(1) | type(1) | sequence(8) */
+#define SOCKET_BUFFER_SIZE (4 * 1024 * 1024)
+
+_Static_assert(DATAGRAM_OVERHEAD == DATAGRAM_HEADER_SIZE + DATAGRAM_TAG_SIZE,
+               "DATAGRAM_OVERHEAD must match the packet layout");
+
+/* Request: version(1) | initiator_nonce(32) */
+#define DATAGRAM_REQUEST_SIZE (1 + DATAGRAM_NONCE_SIZE)
+
+/* Response: status(1) | port(2) | responder_nonce(32) */
+#define DATAGRAM_RESPONSE_SIZE (3 + DATAGRAM_NONCE_SIZE)
+#define DATAGRAM_STATUS_ACCEPT 0
+#define DATAGRAM_STATUS_REFUSE 1
+
+/* Packet types */
+#define PACKET_DATA 1               /* Unreliable message */
+#define PACKET_RELIABLE 2           /* id(4) | message */
+#define PACKET_ACK 3                /* next_id(4) | received-after bitmap(8) */
+#define PACKET_PROBE 4              /* Empty; tells the responder our address */
+
+#define ACK_SIZE 12
+#define ACK_BITMAP_BITS 64
+
+/* Retransmission (RFC 6298 estimator, coarse-clock resolution) */
+#define INITIAL_RTO_MS 200
+#define MIN_RTO_MS 20
+#define MAX_RTO_MS 2000
+#define MAX_RETRIES 10
+#define MAX_BACKOFF_SHIFT 4
+
+/* Replay bitmap (RFC 6479): one spare word past the window */
+#define REPLAY_WORDS (DATAGRAM_REPLAY_WINDOW / 64 + 1)
+#define REPLAY_BITS (REPLAY_WORDS * 64)
+
+/* Receive batch; with GRO each buffer holds a whole coalesced train */
+#define GRO_BUFFER_SIZE 65535
+#define GRO_BATCH 4
+#define UDP_MAX_SEGMENTS 64
+
+/* Keys for one direction */
+typedef struct {
+    unsigned char key[DATAGRAM_KEY_SIZE];
+    unsigned char iv[DATAGRAM_IV_SIZE];
+} datagram_keys_t;
+
+/* A reliable message until the peer acknowledges it */
+typedef struct {
+    uint32_t id;
+    uint16_t len;
+    uint8_t in_use;
+    uint8_t retries;
+    uint64_t sent_ms;
+    uint64_t due_ms;
+    unsigned char data[DATAGRAM_MAX_PAYLOAD];
+} inflight_t;
+
+/* A reliable message until the application takes it */
+typedef struct {
+    uint16_t len;
+    uint8_t ready;
+    unsigned char data[DATAGRAM_MAX_PAYLOAD];
+} reorder_t;
+
+/* Channel state */
+struct datagram_s {
+    int fd;
+    int connected;                  /* Initiator: socket connected to the peer */
+    int have_peer;                  /* Responder: learned from an authenticated packet */
+    struct sockaddr_storage peer;
+    socklen_t peer_len;
+    int gso;                        /* Send trains with UDP_SEGMENT */
+    int gro;                        /* Kernel coalesces received trains (UDP_GRO) */
+
+    EVP_CIPHER_CTX *seal_ctx;
+    EVP_CIPHER_CTX *open_ctx;
+    unsigned char tx_iv[DATAGRAM_IV_SIZE];
+    unsigned char rx_iv[DATAGRAM_IV_SIZE];
+    uint64_t tx_seq;                /* Next sequence sent; 0 is never used */
+    uint64_t rx_top;                /* Highest sequence opened */
+    uint64_t replay[REPLAY_WORDS];
+
+    /* Sealed packets waiting for the next flush */
+    unsigned char (*tx_buf)[DATAGRAM_MAX_PACKET];
+    uint16_t tx_len[DATAGRAM_BATCH];
+    int tx_count;
+
+    /* Last receive batch and the position in it */
+    unsigned char *rx_buf;
+    size_t rx_buf_size;             /* Per slot */
+    int rx_slots;
+    uint32_t rx_len[DATAGRAM_BATCH];
+    uint32_t rx_seg[DATAGRAM_BATCH];    /* Segment size within a coalesced buffer */
+    struct sockaddr_storage rx_from[DATAGRAM_BATCH];
+    socklen_t rx_from_len[DATAGRAM_BATCH];
+    int rx_count;
+    int rx_index;
+    size_t rx_offset;
+
+    /* Reliable send window: ids tx_acked .. tx_next_id - 1 */
+    inflight_t *inflight;
+    uint32_t tx_next_id;
+    uint32_t tx_acked;              /* Oldest unacknowledged id */
+    uint32_t srtt_ms;
+    uint32_t rttvar_ms;
+    uint32_t rto_ms;
+    int have_rtt;
+
+    /* Reliable receive window: ids rx_next_id .. rx_next_id + DATAGRAM_MAX_INFLIGHT - 1 */
+    reorder_t *reorder;
+    uint32_t rx_next_id;            /* Next id handed to the application */
+    int ack_pending;
+
+    datagram_stats_t stats;
+};
+
+/* Internal function prototypes */
+static datagram_t* channel_create(int fd, const datagram_keys_t *tx, const datagram_keys_t *rx);
+static int derive_keys(connection_t *conn, const char *direction,
+                       const unsigned char *nonces, datagram_keys_t *keys);
+static int bind_responder_socket(connection_t *conn, uint16_t *port);
+static int connect_initiator_socket(connection_t *conn, uint16_t port);
+static void configure_socket(datagram_t *dg);
+static void make_nonce(const unsigned char *iv, uint64_t seq, unsigned char *nonce);
+static int queue_packet(datagram_t *dg, int type, const unsigned char *prefix, size_t prefix_len,
+                        const unsigned char *data, size_t len);
+static int open_packet(datagram_t *dg, const unsigned char *packet, size_t packet_len,
+                       unsigned char *plain, size_t *plain_len, int *type);
+static int replay_check(const datagram_t *dg, uint64_t seq);
+static void replay_update(datagram_t *dg, uint64_t seq);
+static int fill_batch(datagram_t *dg);
+static int next_packet(datagram_t *dg, const unsigned char **packet, size_t *packet_len);
+static void handle_reliable(datagram_t *dg, const unsigned char *plain, size_t plain_len);
+static void handle_ack(datagram_t *dg, const unsigned char *plain, size_t plain_len);
+static void update_rtt(datagram_t *dg, uint64_t sample_ms);
+static void send_ack(datagram_t *dg);
+static int drain(connection_t *conn, int timeout_ms);
+static int send_response(connection_t *conn, int status, uint16_t port, const unsigned char *nonce);
+
+/* Ask the peer for a datagram channel and open it on acceptance */
+int datagram_open(connection_t *conn, int timeout_ms) {
+#ifdef DATAGRAM_SUPPORTED
+    unsigned char request[DATAGRAM_REQUEST_SIZE];
+    unsigned char nonces[2 * DATAGRAM_NONCE_SIZE];
+    unsigned char response[DATAGRAM_RESPONSE_SIZE + 64];
+    datagram_keys_t tx, rx;
+    datagram_t *dg;
+    message_type_t msg_type;
+    size_t response_len;
+    uint64_t deadline;
+    uint16_t port;
+    int fd, result;
+
+    if (!conn || !get_connection_crypto(conn) || timeout_ms <= 0) {
+        return DATAGRAM_ERROR_PARAM;
+    }
+
+    if (get_connection_datagram(conn)) {
+        return DATAGRAM_SUCCESS;
+    }
+
+    request[0] = DATAGRAM_VERSION;
+    if (crypto_random_bytes(request + 1, DATAGRAM_NONCE_SIZE) != CRYPTO_SUCCESS) {
+        return DATAGRAM_ERROR_KEY;
+    }
+
+    if (send_message(conn, MSG_DGRAM_REQUEST, request, sizeof(request)) != PROTOCOL_SUCCESS ||
+        drain(conn, timeout_ms) != 0) {
+        return DATAGRAM_ERROR_SYSTEM;
+    }
+
+    /* The peer sends nothing else until it has answered */
+    deadline = platform_get_time_ms() + (uint64_t)timeout_ms;
+    for (;;) {
+        uint64_t now = platform_get_time_ms();
+
+        if (now >= deadline ||
+            wait_for_socket(get_connection_socket(conn), (int)(deadline - now), 1, 0) == 0) {
+            LOG_WARNING("No answer to datagram request, staying on the stream");
+            return DATAGRAM_ERROR_TIMEOUT;
+        }
+
+        response_len = sizeof(response);
+        result = receive_message(conn, &msg_type, response, &response_len);
+        if (result == PROTOCOL_IN_PROGRESS) {
+            continue;
+        }
+        if (result != PROTOCOL_SUCCESS) {
+            return DATAGRAM_ERROR_SYSTEM;
+        }
+        break;
+    }
+
+    if (msg_type != MSG_DGRAM_RESPONSE || response_len != DATAGRAM_RESPONSE_SIZE) {
+        LOG_ERROR("Unexpected message type 0x%02x during datagram setup", msg_type);
+        return DATAGRAM_ERROR_PROTOCOL;
+    }
+
+    if (response[0] != DATAGRAM_STATUS_ACCEPT) {
+        LOG_INFO("Peer refused a datagram channel, staying on the stream");
+        return DATAGRAM_ERROR_REJECTED;
+    }
+
+    port = (uint16_t)((response[1] << 8) | response[2]);
+    memcpy(nonces, request + 1, DATAGRAM_NONCE_SIZE);
+    memcpy(nonces + DATAGRAM_NONCE_SIZE, response + 3, DATAGRAM_NONCE_SIZE);
+
+    if (derive_keys(conn, "initiator", nonces, &tx) != 0 ||
+        derive_keys(conn, "responder", nonces, &rx) != 0) {
+        memset(&tx, 0, sizeof(tx));
+        memset(&rx, 0, sizeof(rx));
+        return DATAGRAM_ERROR_KEY;
+    }
+
+    fd = connect_initiator_socket(conn, port);
+    dg = fd >= 0 ? channel_create(fd, &tx, &rx) : NULL;
+    memset(&tx, 0, sizeof(tx));
+    memset(&rx, 0, sizeof(rx));
+    if (!dg) {
+        if (fd >= 0) {
+            close_socket(fd);
+        }
+        return DATAGRAM_ERROR_SYSTEM;
+    }
+
+    dg->connected = 1;
+    set_connection_datagram(conn, dg);
+
+    /* The responder learns where we are from the first packet it can open */
+    if (queue_packet(dg, PACKET_PROBE, NULL, 0, NULL, 0) == DATAGRAM_SUCCESS) {
+        datagram_flush(dg);
+    }
+
+    LOG_INFO("Datagram channel open to port %u%s%s", port,
+             dg->gso ? " (GSO)" : "", dg->gro ? " (GRO)" : "");
+    return DATAGRAM_SUCCESS;
+#else
+    (void)conn;
+    (void)timeout_ms;
+    return DATAGRAM_ERROR_UNSUPPORTED;
+#endif
+}
+
+/* Answer a peer's request */
+int datagram_accept(connection_t *conn, const unsigned char *request, size_t request_len) {
+    unsigned char nonces[2 * DATAGRAM_NONCE_SIZE];
+    datagram_keys_t tx, rx;
+    datagram_t *dg = NULL;
+    uint16_t port = 0;
+    int fd = -1;
+    int usable;
+
+    if (!conn) {
+        return DATAGRAM_ERROR_PARAM;
+    }
+
+    usable = request && request_len == DATAGRAM_REQUEST_SIZE &&
+             request[0] == DATAGRAM_VERSION && get_connection_crypto(conn) &&
+             !get_connection_datagram(conn);
+
+    if (usable) {
+        memcpy(nonces, request + 1, DATAGRAM_NONCE_SIZE);
+        usable = crypto_random_bytes(nonces + DATAGRAM_NONCE_SIZE, DATAGRAM_NONCE_SIZE) == CRYPTO_SUCCESS &&
+                 derive_keys(conn, "initiator", nonces, &rx) == 0 &&
+                 derive_keys(conn, "responder", nonces, &tx) == 0 &&
+                 (fd = bind_responder_socket(conn, &port)) >= 0 &&
+                 (dg = channel_create(fd, &tx, &rx)) != NULL;
+    }
+
+    memset(&tx, 0, sizeof(tx));
+    memset(&rx, 0, sizeof(rx));
+
+    if (!usable) {
+        if (fd >= 0) {
+            close_socket(fd);
+        }
+        LOG_DEBUG("Refusing datagram request");
+        return send_response(conn, DATAGRAM_STATUS_REFUSE, 0, NULL);
+    }
+
+    set_connection_datagram(conn, dg);
+
+    if (send_response(conn, DATAGRAM_STATUS_ACCEPT, port,
+                      nonces + DATAGRAM_NONCE_SIZE) != DATAGRAM_SUCCESS) {
+        LOG_ERROR("Datagram setup failed after accepting");
+        return DATAGRAM_ERROR_SYSTEM;
+    }
+
+    LOG_INFO("Datagram channel listening on port %u%s%s", port,
+             dg->gso ? " (GSO)" : "", dg->gro ? " (GRO)" : "");
+    return DATAGRAM_SUCCESS;
+}
+
+/* Seal one message */
+int datagram_send(datagram_t *dg, const unsigned char *data, size_t len, int flags) {
+    int result;
+
+    if (!dg || !data || len == 0) {
+        return DATAGRAM_ERROR_PARAM;
+    }
+
+    if (len > DATAGRAM_MAX_PAYLOAD) {
+        return DATAGRAM_ERROR_SIZE;
+    }
+
+    if (flags & DATAGRAM_SEND_RELIABLE) {
+        uint64_t now = platform_coarse_monotonic_ms();
+        unsigned char id_be[4];
+        inflight_t *slot;
+
+        if (dg->tx_next_id - dg->tx_acked >= DATAGRAM_MAX_INFLIGHT) {
+            datagram_flush(dg);
+            return DATAGRAM_IN_PROGRESS;
+        }
+
+        slot = &dg->inflight[dg->tx_next_id % DATAGRAM_MAX_INFLIGHT];
+        slot->id = dg->tx_next_id++;
+        slot->len = (uint16_t)len;
+        slot->in_use = 1;
+        slot->retries = 0;
+        slot->sent_ms = now;
+        slot->due_ms = now + dg->rto_ms;
+        memcpy(slot->data, data, len);
+
+        /* Kept until acknowledged, so a full socket only delays it */
+        id_be[0] = (unsigned char)(slot->id >> 24);
+        id_be[1] = (unsigned char)(slot->id >> 16);
+        id_be[2] = (unsigned char)(slot->id >> 8);
+        id_be[3] = (unsigned char)slot->id;
+        result = queue_packet(dg, PACKET_RELIABLE, id_be, sizeof(id_be), slot->data, len);
+        if (result == DATAGRAM_IN_PROGRESS) {
+            result = DATAGRAM_SUCCESS;
+        }
+    } else {
+        result = queue_packet(dg, PACKET_DATA, NULL, 0, data, len);
+    }
+
+    if (result != DATAGRAM_SUCCESS) {
+        return result;
+    }
+
+    if (!(flags & DATAGRAM_SEND_MORE)) {
+        result = datagram_flush(dg);
+        if (result < 0) {
+            return result;
+        }
+    }
+
+    return DATAGRAM_SUCCESS;
+}
+
+/* Write out queued packets */
+int datagram_flush(datagram_t *dg) {
+#ifdef DATAGRAM_SUPPORTED
+    struct mmsghdr msgs[DATAGRAM_BATCH];
+    struct iovec iov[DATAGRAM_BATCH];
+    union {
+        char buf[CMSG_SPACE(sizeof(uint16_t))];
+        struct cmsghdr align;
+    } control[DATAGRAM_BATCH];
+    int first[DATAGRAM_BATCH + 1];  /* Packet index each message starts at */
+    int nmsgs = 0;
+    int sent;
+
+    if (!dg) {
+        return DATAGRAM_ERROR_PARAM;
+    }
+
+    if (dg->tx_count == 0) {
+        return DATAGRAM_SUCCESS;
+    }
+
+    if (!dg->connected && !dg->have_peer) {
+        return DATAGRAM_IN_PROGRESS;
+    }
+
+    memset(msgs, 0, sizeof(msgs));
+
+    /* One message per run of equal-sized packets when the kernel can
+     * segment it (the last of a run may be shorter), else one per packet */
+    for (int i = 0; i < dg->tx_count; ) {
+        struct msghdr *hdr = &msgs[nmsgs].msg_hdr;
+        size_t seg = dg->tx_len[i];
+        int run = 1;
+
+        iov[i].iov_base = dg->tx_buf[i];
+        iov[i].iov_len = dg->tx_len[i];
+
+        while (dg->gso && i + run < dg->tx_count && run < UDP_MAX_SEGMENTS &&
+               dg->tx_len[i + run - 1] == seg && dg->tx_len[i + run] <= seg) {
+            iov[i + run].iov_base = dg->tx_buf[i + run];
+            iov[i + run].iov_len = dg->tx_len[i + run];
+            run++;
+        }
+
+        hdr->msg_iov = &iov[i];
+        hdr->msg_iovlen = (size_t)run;
+        if (!dg->connected) {
+            hdr->msg_name = &dg->peer;
+            hdr->msg_namelen = dg->peer_len;
+        }
+
+        if (run > 1) {
+            struct cmsghdr *cmsg;
+
+            hdr->msg_control = control[nmsgs].buf;
+            hdr->msg_controllen = sizeof(control[nmsgs].buf);
+            cmsg = CMSG_FIRSTHDR(hdr);
+            cmsg->cmsg_level = SOL_UDP;
+            cmsg->cmsg_type = UDP_SEGMENT;
+            cmsg->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+            memcpy(CMSG_DATA(cmsg), &(uint16_t){ (uint16_t)seg }, sizeof(uint16_t));
+        }
+
+        first[nmsgs++] = i;
+        i += run;
+    }
+    first[nmsgs] = dg->tx_count;
+
+    sent = sendmmsg(dg->fd, msgs, (unsigned int)nmsgs, MSG_DONTWAIT);
+    dg->stats.send_calls++;
+
+    if (sent < 0) {
+        if (errno == EAGAIN || errno == EWOULDBLOCK || errno == ENOBUFS) {
+            return DATAGRAM_IN_PROGRESS;
+        }
+
+        /* Segmentation needs checksum offload on the route's device */
+        if (dg->gso && (errno == EIO || errno == EINVAL)) {
+            LOG_DEBUG("UDP_SEGMENT refused (%s), sending packets singly", strerror(errno));
+            dg->gso = 0;
+            return datagram_flush(dg);
+        }
+
+        /* Datagrams may be lost; reliable ones are still held for resending */
+        LOG_DEBUG("sendmmsg failed: %s", strerror(errno));
+        dg->tx_count = 0;
+        return errno == ECONNREFUSED ? DATAGRAM_IN_PROGRESS : DATAGRAM_ERROR_SYSTEM;
+    }
+
+    for (int m = 0; m < sent; m++) {
+        if (msgs[m].msg_hdr.msg_iovlen > 1) {
+            dg->stats.gso_sends++;
+        }
+    }
+    dg->stats.packets_sent += (uint64_t)first[sent];
+
+    /* Keep what the socket did not take, in order */
+    if (first[sent] < dg->tx_count) {
+        int left = dg->tx_count - first[sent];
+
+        memmove(dg->tx_buf, dg->tx_buf[first[sent]], (size_t)left * DATAGRAM_MAX_PACKET);
+        memmove(dg->tx_len, &dg->tx_len[first[sent]], (size_t)left * sizeof(dg->tx_len[0]));
+        dg->tx_count = left;
+        return DATAGRAM_IN_PROGRESS;
+    }
+
+    dg->tx_count = 0;
+    return DATAGRAM_SUCCESS;
+#else
+    (void)dg;
+    return DATAGRAM_ERROR_UNSUPPORTED;
+#endif
+}
+
+/* Receive the next message */
+int datagram_receive(datagram_t *dg, unsigned char *buffer, size_t *len, int *flags) {
+    unsigned char plain[DATAGRAM_MAX_PACKET];
+
+    if (!dg || !buffer || !len) {
+        return DATAGRAM_ERROR_PARAM;
+    }
+
+    for (;;) {
+        reorder_t *next = &dg->reorder[dg->rx_next_id % DATAGRAM_MAX_INFLIGHT];
+        const unsigned char *packet;
+        size_t packet_len, plain_len;
+        int type, result;
+
+        /* Reliable messages go out strictly in order */
+        if (next->ready) {
+            if (next->len > *len) {
+                return DATAGRAM_ERROR_SIZE;
+            }
+            memcpy(buffer, next->data, next->len);
+            *len = next->len;
+            if (flags) *flags = DATAGRAM_SEND_RELIABLE;
+            next->ready = 0;
+            dg->rx_next_id++;
+            return DATAGRAM_SUCCESS;
+        }
+
+        if (!next_packet(dg, &packet, &packet_len)) {
+            /* Acknowledge a whole batch at once */
+            if (dg->ack_pending) {
+                send_ack(dg);
+                datagram_flush(dg);
+            }
+
+            result = fill_batch(dg);
+            if (result != DATAGRAM_SUCCESS) {
+                return result;
+            }
+            continue;
+        }
+
+        if (open_packet(dg, packet, packet_len, plain, &plain_len, &type) != DATAGRAM_SUCCESS) {
+            continue;
+        }
+
+        /* Authenticated, so the address is the peer's (and follows it
+         * across NAT rebinding) */
+        if (!dg->connected) {
+            memcpy(&dg->peer, &dg->rx_from[dg->rx_index], dg->rx_from_len[dg->rx_index]);
+            dg->peer_len = dg->rx_from_len[dg->rx_index];
+            dg->have_peer = 1;
+        }
+
+        switch (type) {
+            case PACKET_DATA:
+                if (plain_len > *len) {
+                    return DATAGRAM_ERROR_SIZE;
+                }
+                memcpy(buffer, plain, plain_len);
+                *len = plain_len;
+                if (flags) *flags = 0;
+                return DATAGRAM_SUCCESS;
+
+            case PACKET_RELIABLE:
+                handle_reliable(dg, plain, plain_len);
+                break;
+
+            case PACKET_ACK:
+                handle_ack(dg, plain, plain_len);
+                break;
+
+            default:
+                break;
+        }
+    }
+}
+
+/* Resend due messages and send pending acknowledgements */
+int datagram_service(datagram_t *dg) {
+    uint64_t now = platform_coarse_monotonic_ms();
+    int next = -1;
+
+    if (!dg) {
+        return DATAGRAM_ERROR_PARAM;
+    }
+
+    for (uint32_t id = dg->tx_acked; id != dg->tx_next_id; id++) {
+        inflight_t *slot = &dg->inflight[id % DATAGRAM_MAX_INFLIGHT];
+        int wait;
+
+        if (!slot->in_use) continue;
+
+        if (slot->due_ms <= now) {
+            unsigned char id_be[4];
+            uint64_t rto;
+
+            if (slot->retries >= MAX_RETRIES) {
+                LOG_WARNING("Datagram message %u unacknowledged after %d retries", id, MAX_RETRIES);
+                return DATAGRAM_ERROR_UNREACHABLE;
+            }
+
+            /* Resent under a fresh sequence number, so the peer's replay
+             * window never sees a repeat */
+            id_be[0] = (unsigned char)(id >> 24);
+            id_be[1] = (unsigned char)(id >> 16);
+            id_be[2] = (unsigned char)(id >> 8);
+            id_be[3] = (unsigned char)id;
+            if (queue_packet(dg, PACKET_RELIABLE, id_be, sizeof(id_be),
+                             slot->data, slot->len) == DATAGRAM_IN_PROGRESS) {
+                next = 0;
+                break;
+            }
+
+            slot->retries++;
+            rto = (uint64_t)dg->rto_ms << (slot->retries < MAX_BACKOFF_SHIFT ? slot->retries : MAX_BACKOFF_SHIFT);
+            slot->sent_ms = now;
+            slot->due_ms = now + (rto < MAX_RTO_MS ? rto : MAX_RTO_MS);
+            dg->stats.retransmits++;
+        }
+
+        wait = (int)(slot->due_ms - now);
+        if (next < 0 || wait < next) {
+            next = wait;
+        }
+    }
+
+    if (dg->ack_pending) {
+        send_ack(dg);
+    }
+
+    if (datagram_flush(dg) == DATAGRAM_IN_PROGRESS && dg->tx_count > 0) {
+        next = 0;
+    }
+
+    return next;
+}
+
+/* Get the channel's socket */
+int datagram_get_socket(datagram_t *dg) {
+    return dg ? dg->fd : -1;
+}
+
+/* Get channel statistics */
+datagram_stats_t datagram_get_stats(datagram_t *dg) {
+    datagram_stats_t stats = {0};
+
+    if (dg) {
+        stats = dg->stats;
+        stats.inflight = 0;
+        for (uint32_t id = dg->tx_acked; id != dg->tx_next_id; id++) {
+            stats.inflight += dg->inflight[id % DATAGRAM_MAX_INFLIGHT].in_use;
+        }
+        stats.rto_ms = dg->rto_ms;
+    }
+
+    return stats;
+}
+
+/* Close a channel */
+void datagram_close(datagram_t *dg) {
+    if (!dg) return;
+
+    if (dg->fd >= 0) {
+        close_socket(dg->fd);
+    }
+
+    EVP_CIPHER_CTX_free(dg->seal_ctx);
+    EVP_CIPHER_CTX_free(dg->open_ctx);
+    free(dg->tx_buf);
+    free(dg->rx_buf);
+    free(dg->inflight);
+    free(dg->reorder);
+
+    memset(dg, 0, sizeof(datagram_t));
+    free(dg);
+}
+
+/* Internal: Set up a channel on a bound socket; keys are copied */
+static datagram_t* channel_create(int fd, const datagram_keys_t *tx, const datagram_keys_t *rx) {
+    datagram_t *dg = calloc(1, sizeof(datagram_t));
+
+    if (!dg) {
+        LOG_ERROR("Memory allocation failed");
+        return NULL;
+    }
+
+    dg->fd = fd;
+    dg->tx_seq = 1;
+    dg->rto_ms = INITIAL_RTO_MS;
+    configure_socket(dg);
+
+    dg->rx_slots = dg->gro ? GRO_BATCH : DATAGRAM_BATCH;
+    dg->rx_buf_size = dg->gro ? GRO_BUFFER_SIZE : DATAGRAM_MAX_PACKET;
+    dg->tx_buf = malloc((size_t)DATAGRAM_BATCH * DATAGRAM_MAX_PACKET);
+    dg->rx_buf = malloc((size_t)dg->rx_slots * dg->rx_buf_size);
+    dg->inflight = calloc(DATAGRAM_MAX_INFLIGHT, sizeof(inflight_t));
+    dg->reorder = calloc(DATAGRAM_MAX_INFLIGHT, sizeof(reorder_t));
+    dg->seal_ctx = EVP_CIPHER_CTX_new();
+    dg->open_ctx = EVP_CIPHER_CTX_new();
+
+    if (!dg->tx_buf || !dg->rx_buf || !dg->inflight || !dg->reorder ||
+        !dg->seal_ctx || !dg->open_ctx) {
+        LOG_ERROR("Memory allocation failed");
+        dg->fd = -1;
+        datagram_close(dg);
+        return NULL;
+    }
+
+    /* Keys are set once; each packet only supplies its nonce */
+    if (EVP_EncryptInit_ex(dg->seal_ctx, EVP_aes_256_gcm(), NULL, tx->key, NULL) != 1 ||
+        EVP_DecryptInit_ex(dg->open_ctx, EVP_aes_256_gcm(), NULL, rx->key, NULL) != 1) {
+        LOG_ERROR("Datagram cipher initialization failed");
+        dg->fd = -1;
+        datagram_close(dg);
+        return NULL;
+    }
+
+    memcpy(dg->tx_iv, tx->iv, DATAGRAM_IV_SIZE);
+    memcpy(dg->rx_iv, rx->iv, DATAGRAM_IV_SIZE);
+
+    return dg;
+}
+
+/* Internal: Expand one direction's AES-GCM key and IV from the session secret */
+static int derive_keys(connection_t *conn, const char *direction,
+                       const unsigned char *nonces, datagram_keys_t *keys) {
+    crypto_session_t *session = get_connection_crypto(conn);
+    char label[64];
+
+    snprintf(label, sizeof(label), "cryptcat dgram %s key", direction);
+    if (crypto_session_derive_key(session, label, nonces, 2 * DATAGRAM_NONCE_SIZE,
+                                  keys->key, sizeof(keys->key)) != CRYPTO_SUCCESS) {
+        return -1;
+    }
+
+    snprintf(label, sizeof(label), "cryptcat dgram %s iv", direction);
+    if (crypto_session_derive_key(session, label, nonces, 2 * DATAGRAM_NONCE_SIZE,
+                                  keys->iv, sizeof(keys->iv)) != CRYPTO_SUCCESS) {
+        return -1;
+    }
+
+    return 0;
+}
+
+/* Internal: Bind a UDP socket on the stream's local address */
+static int bind_responder_socket(connection_t *conn, uint16_t *port) {
+#ifdef DATAGRAM_SUPPORTED
+    struct sockaddr_storage addr;
+    socklen_t addr_len = sizeof(addr);
+    int fd;
+
+    if (getsockname(get_connection_socket(conn), (struct sockaddr*)&addr, &addr_len) < 0) {
+        return -1;
+    }
+
+    if (addr.ss_family == AF_INET) {
+        ((struct sockaddr_in*)&addr)->sin_port = 0;
+    } else if (addr.ss_family == AF_INET6) {
+        ((struct sockaddr_in6*)&addr)->sin6_port = 0;
+    } else {
+        return -1;
+    }
+
+    fd = platform_create_socket(addr.ss_family, SOCK_DGRAM, 0);
+    if (fd < 0) {
+        return -1;
+    }
+
+    if (bind(fd, (struct sockaddr*)&addr, addr_len) < 0 ||
+        getsockname(fd, (struct sockaddr*)&addr, &addr_len) < 0 ||
+        platform_set_nonblocking(fd) != PLATFORM_SUCCESS) {
+        LOG_DEBUG("Datagram socket setup failed: %s", strerror(errno));
+        close_socket(fd);
+        return -1;
+    }
+
+    *port = ntohs(addr.ss_family == AF_INET ? ((struct sockaddr_in*)&addr)->sin_port
+                                            : ((struct sockaddr_in6*)&addr)->sin6_port);
+    return fd;
+#else
+    (void)conn;
+    (void)port;
+    return -1;
+#endif
+}
+
+/* Internal: Connect a UDP socket to the stream's peer at the given port */
+static int connect_initiator_socket(connection_t *conn, uint16_t port) {
+#ifdef DATAGRAM_SUPPORTED
+    struct sockaddr_storage addr;
+    socklen_t addr_len = sizeof(addr);
+    int fd;
+
+    if (port == 0 ||
+        getpeername(get_connection_socket(conn), (struct sockaddr*)&addr, &addr_len) < 0) {
+        return -1;
+    }
+
+    if (addr.ss_family == AF_INET) {
+        ((struct sockaddr_in*)&addr)->sin_port = htons(port);
+    } else if (addr.ss_family == AF_INET6) {
+        ((struct sockaddr_in6*)&addr)->sin6_port = htons(port);
+    } else {
+        return -1;
+    }
+
+    fd = platform_create_socket(addr.ss_family, SOCK_DGRAM, 0);
+    if (fd < 0) {
+        return -1;
+    }
+
+    if (connect(fd, (struct sockaddr*)&addr, addr_len) < 0 ||
+        platform_set_nonblocking(fd) != PLATFORM_SUCCESS) {
+        LOG_DEBUG("Datagram socket setup failed: %s", strerror(errno));
+        close_socket(fd);
+        return -1;
+    }
+
+    return fd;
+#else
+    (void)conn;
+    (void)port;
+    return -1;
+#endif
+}
+
+/* Internal: Socket buffers and segmentation offloads. Setting
+ * CRYPTCAT_UDP_OFFLOAD=off disables both offloads */
+static void configure_socket(datagram_t *dg) {
+#ifdef DATAGRAM_SUPPORTED
+    const char *forced = getenv("CRYPTCAT_UDP_OFFLOAD");
+    int size = SOCKET_BUFFER_SIZE;
+    int one = 1;
+    int value;
+    socklen_t len = sizeof(value);
+
+    setsockopt(dg->fd, SOL_SOCKET, SO_SNDBUF, &size, sizeof(size));
+    setsockopt(dg->fd, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+
+    if (forced && strcmp(forced, "off") == 0) {
+        return;
+    }
+
+    /* Readable only where the kernel knows the option (4.18+) */
+    dg->gso = getsockopt(dg->fd, SOL_UDP, UDP_SEGMENT, &value, &len) == 0;
+    dg->gro = setsockopt(dg->fd, SOL_UDP, UDP_GRO, &one, sizeof(one)) == 0;
+#else
+    (void)dg;
+#endif
+}
+
+/* Internal: Per-packet nonce, the IV with the sequence number XORed into
+ * its low 8 bytes (as in TLS 1.3) */
+static void make_nonce(const unsigned char *iv, uint64_t seq, unsigned char *nonce) {
+    memcpy(nonce, iv, DATAGRAM_IV_SIZE);
+    for (int i = 0; i < 8; i++) {
+        nonce[DATAGRAM_IV_SIZE - 1 - i] ^= (unsigned char)(seq >> (8 * i));
+    }
+}
+
+/* Internal: Seal prefix + data into the next output slot */
+static int queue_packet(datagram_t *dg, int type, const unsigned char *prefix, size_t prefix_len,
+                        const unsigned char *data, size_t len) {
+    unsigned char nonce[DATAGRAM_IV_SIZE];
+    unsigned char *packet, *out;
+    uint64_t seq;
+    int n;
+
+    if (dg->tx_count == DATAGRAM_BATCH &&
+        (datagram_flush(dg) < 0 || dg->tx_count == DATAGRAM_BATCH)) {
+        return DATAGRAM_IN_PROGRESS;
+    }
+
+    packet = dg->tx_buf[dg->tx_count];
+    seq = dg->tx_seq++;
+
+    packet[0] = DATAGRAM_VERSION;
+    packet[1] = (unsigned char)type;
+    for (int i = 0; i < 8; i++) {
+        packet[2 + i] = (unsigned char)(seq >> (56 - 8 * i));
+    }
+
+    /* The header is authenticated, not encrypted */
+    make_nonce(dg->tx_iv, seq, nonce);
+    out = packet + DATAGRAM_HEADER_SIZE;
+    if (EVP_EncryptInit_ex(dg->seal_ctx, NULL, NULL, NULL, nonce) != 1 ||
+        EVP_EncryptUpdate(dg->seal_ctx, NULL, &n, packet, DATAGRAM_HEADER_SIZE) != 1 ||
+        (prefix_len > 0 && EVP_EncryptUpdate(dg->seal_ctx, out, &n, prefix, (int)prefix_len) != 1) ||
+        (len > 0 && EVP_EncryptUpdate(dg->seal_ctx, out + prefix_len, &n, data, (int)len) != 1) ||
+        EVP_EncryptFinal_ex(dg->seal_ctx, out + prefix_len + len, &n) != 1 ||
+        EVP_CIPHER_CTX_ctrl(dg->seal_ctx, EVP_CTRL_GCM_GET_TAG, DATAGRAM_TAG_SIZE,
+                            out + prefix_len + len) != 1) {
+        LOG_ERROR("Datagram seal failed");
+        return DATAGRAM_ERROR_KEY;
+    }
+
+    dg->tx_len[dg->tx_count++] = (uint16_t)(DATAGRAM_OVERHEAD + prefix_len + len);
+    return DATAGRAM_SUCCESS;
+}
+
+/* Internal: Verify and decrypt one packet */
+static int open_packet(datagram_t *dg, const unsigned char *packet, size_t packet_len,
+                       unsigned char *plain, size_t *plain_len, int *type) {
+    unsigned char nonce[DATAGRAM_IV_SIZE];
+    size_t body_len;
+    uint64_t seq = 0;
+    int n;
+
+    if (packet_len < DATAGRAM_OVERHEAD || packet_len > DATAGRAM_MAX_PACKET ||
+        packet[0] != DATAGRAM_VERSION) {
+        dg->stats.auth_failures++;
+        return DATAGRAM_ERROR_PROTOCOL;
+    }
+
+    for (int i = 0; i < 8; i++) {
+        seq = (seq << 8) | packet[2 + i];
+    }
+
+    /* Cheap rejection first; the window only moves once the tag checks out */
+    if (!replay_check(dg, seq)) {
+        dg->stats.replays_dropped++;
+        return DATAGRAM_ERROR_PROTOCOL;
+    }
+
+    body_len = packet_len - DATAGRAM_OVERHEAD;
+    make_nonce(dg->rx_iv, seq, nonce);
+    if (EVP_DecryptInit_ex(dg->open_ctx, NULL, NULL, NULL, nonce) != 1 ||
+        EVP_DecryptUpdate(dg->open_ctx, NULL, &n, packet, DATAGRAM_HEADER_SIZE) != 1 ||
+        (body_len > 0 && EVP_DecryptUpdate(dg->open_ctx, plain, &n,
+                                           packet + DATAGRAM_HEADER_SIZE, (int)body_len) != 1) ||
+        EVP_CIPHER_CTX_ctrl(dg->open_ctx, EVP_CTRL_GCM_SET_TAG, DATAGRAM_TAG_SIZE,
+                            (void*)(packet + DATAGRAM_HEADER_SIZE + body_len)) != 1 ||
+        EVP_DecryptFinal_ex(dg->open_ctx, plain + body_len, &n) != 1) {
+        dg->stats.auth_failures++;
+        return DATAGRAM_ERROR_KEY;
+    }
+
+    replay_update(dg, seq);
+    dg->stats.packets_received++;
+    *plain_len = body_len;
+    *type = packet[1];
+    return DATAGRAM_SUCCESS;
+}
+
+/* Internal: Whether a sequence number is new and inside the window */
+static int replay_check(const datagram_t *dg, uint64_t seq) {
+    uint64_t bit;
+
+    if (seq == 0) {
+        return 0;
+    }
+    if (seq > dg->rx_top) {
+        return 1;
+    }
+    if (dg->rx_top - seq >= DATAGRAM_REPLAY_WINDOW) {
+        return 0;
+    }
+
+    bit = seq % REPLAY_BITS;
+    return !((dg->replay[bit / 64] >> (bit % 64)) & 1);
+}
+
+/* Internal: Record an opened sequence number, sliding the window forward */
+static void replay_update(datagram_t *dg, uint64_t seq) {
+    uint64_t bit;
+
+    if (seq > dg->rx_top) {
+        uint64_t word = dg->rx_top / 64;
+        uint64_t words = seq / 64 - word;
+
+        if (words > REPLAY_WORDS) {
+            words = REPLAY_WORDS;
+        }
+        for (uint64_t i = 1; i <= words; i++) {
+            dg->replay[(word + i) % REPLAY_WORDS] = 0;
+        }
+        dg->rx_top = seq;
+    }
+
+    bit = seq % REPLAY_BITS;
+    dg->replay[bit / 64] |= 1ULL << (bit % 64);
+}
+
+/* Internal: Read the next batch of packets from the socket */
+static int fill_batch(datagram_t *dg) {
+#ifdef DATAGRAM_SUPPORTED
+    struct mmsghdr msgs[DATAGRAM_BATCH];
+    struct iovec iov[DATAGRAM_BATCH];
+    union {
+        char buf[CMSG_SPACE(sizeof(int))];
+        struct cmsghdr align;
+    } control[DATAGRAM_BATCH];
+    int received;
+
+    memset(msgs, 0, sizeof(msgs));
+    for (int i = 0; i < dg->rx_slots; i++) {
+        iov[i].iov_base = dg->rx_buf + (size_t)i * dg->rx_buf_size;
+        iov[i].iov_len = dg->rx_buf_size;
+        msgs[i].msg_hdr.msg_iov = &iov[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+        msgs[i].msg_hdr.msg_name = &dg->rx_from[i];
+        msgs[i].msg_hdr.msg_namelen = sizeof(dg->rx_from[i]);
+        if (dg->gro) {
+            msgs[i].msg_hdr.msg_control = control[i].buf;
+            msgs[i].msg_hdr.msg_controllen = sizeof(control[i].buf);
+        }
+    }
+
+    received = recvmmsg(dg->fd, msgs, (unsigned int)dg->rx_slots, MSG_DONTWAIT, NULL);
+    dg->stats.recv_calls++;
+
+    if (received <= 0) {
+        /* A connected socket reports an earlier ICMP unreachable here */
+        if (received == 0 || errno == EAGAIN || errno == EWOULDBLOCK ||
+            errno == EINTR || errno == ECONNREFUSED) {
+            return DATAGRAM_IN_PROGRESS;
+        }
+        LOG_DEBUG("recvmmsg failed: %s", strerror(errno));
+        return DATAGRAM_ERROR_SYSTEM;
+    }
+
+    for (int i = 0; i < received; i++) {
+        struct msghdr *hdr = &msgs[i].msg_hdr;
+        struct cmsghdr *cmsg;
+
+        dg->rx_len[i] = (hdr->msg_flags & MSG_TRUNC) ? 0 : msgs[i].msg_len;
+        dg->rx_seg[i] = dg->rx_len[i];
+        dg->rx_from_len[i] = hdr->msg_namelen;
+
+        for (cmsg = dg->gro ? CMSG_FIRSTHDR(hdr) : NULL; cmsg; cmsg = CMSG_NXTHDR(hdr, cmsg)) {
+            if (cmsg->cmsg_level == SOL_UDP && cmsg->cmsg_type == UDP_GRO) {
+                int seg;
+
+                memcpy(&seg, CMSG_DATA(cmsg), sizeof(seg));
+                if (seg > 0 && (uint32_t)seg < dg->rx_len[i]) {
+                    dg->rx_seg[i] = (uint32_t)seg;
+                    dg->stats.gro_receives++;
+                }
+            }
+        }
+    }
+
+    dg->rx_count = received;
+    dg->rx_index = 0;
+    dg->rx_offset = 0;
+    return DATAGRAM_SUCCESS;
+#else
+    (void)dg;
+    return DATAGRAM_ERROR_UNSUPPORTED;
+#endif
+}
+
+/* Internal: Next packet of the batch, splitting coalesced buffers */
+static int next_packet(datagram_t *dg, const unsigned char **packet, size_t *packet_len) {
+    while (dg->rx_index < dg->rx_count) {
+        uint32_t total = dg->rx_len[dg->rx_index];
+
+        if (dg->rx_offset < total) {
+            size_t len = total - dg->rx_offset;
+
+            if (len > dg->rx_seg[dg->rx_index]) {
+                len = dg->rx_seg[dg->rx_index];
+            }
+            *packet = dg->rx_buf + (size_t)dg->rx_index * dg->rx_buf_size + dg->rx_offset;
+            *packet_len = len;
+            /* rx_index stays on this buffer, so rx_from still names its sender */
+            dg->rx_offset += len;
+            return 1;
+        }
+
+        dg->rx_index++;
+        dg->rx_offset = 0;
+    }
+
+    return 0;
+}
+
+/* Internal: File a reliable message in the reorder window */
+static void handle_reliable(datagram_t *dg, const unsigned char *plain, size_t plain_len) {
+    reorder_t *slot;
+    uint32_t id;
+
+    if (plain_len <= 4) {
+        return;
+    }
+
+    id = ((uint32_t)plain[0] << 24) | ((uint32_t)plain[1] << 16) |
+         ((uint32_t)plain[2] << 8) | plain[3];
+
+    /* Old ids are resends whose ack was lost; acknowledge them again.
+     * Ids past the window wait until the application catches up */
+    dg->ack_pending = 1;
+    if ((int32_t)(id - dg->rx_next_id) < 0 ||
+        id - dg->rx_next_id >= DATAGRAM_MAX_INFLIGHT) {
+        return;
+    }
+
+    slot = &dg->reorder[id % DATAGRAM_MAX_INFLIGHT];
+    if (!slot->ready) {
+        slot->len = (uint16_t)(plain_len - 4);
+        memcpy(slot->data, plain + 4, slot->len);
+        slot->ready = 1;
+    }
+}
+
+/* Internal: Release acknowledged messages */
+static void handle_ack(datagram_t *dg, const unsigned char *plain, size_t plain_len) {
+    uint64_t now = platform_coarse_monotonic_ms();
+    uint64_t bitmap = 0;
+    uint32_t next_id;
+
+    if (plain_len != ACK_SIZE) {
+        return;
+    }
+
+    next_id = ((uint32_t)plain[0] << 24) | ((uint32_t)plain[1] << 16) |
+              ((uint32_t)plain[2] << 8) | plain[3];
+    for (int i = 0; i < 8; i++) {
+        bitmap = (bitmap << 8) | plain[4 + i];
+    }
+
+    /* Ignore acks for ids never sent */
+    if ((int32_t)(dg->tx_next_id - next_id) < 0) {
+        return;
+    }
+
+    for (uint32_t id = dg->tx_acked; id != dg->tx_next_id; id++) {
+        inflight_t *slot = &dg->inflight[id % DATAGRAM_MAX_INFLIGHT];
+        uint32_t ahead = id - next_id - 1;
+        int acked = (int32_t)(id - next_id) < 0 ||
+                    ((int32_t)(id - next_id) > 0 && ahead < ACK_BITMAP_BITS &&
+                     ((bitmap >> ahead) & 1));
+
+        if (!acked || !slot->in_use) continue;
+
+        /* Karn: only first transmissions time the round trip */
+        if (slot->retries == 0) {
+            update_rtt(dg, now - slot->sent_ms);
+        }
+        slot->in_use = 0;
+    }
+
+    while (dg->tx_acked != dg->tx_next_id &&
+           !dg->inflight[dg->tx_acked % DATAGRAM_MAX_INFLIGHT].in_use) {
+        dg->tx_acked++;
+    }
+}
+
+/* Internal: RFC 6298 smoothed round trip and timeout */
+static void update_rtt(datagram_t *dg, uint64_t sample_ms) {
+    uint32_t sample = sample_ms > MAX_RTO_MS ? MAX_RTO_MS : (uint32_t)sample_ms;
+    uint32_t rto;
+
+    if (!dg->have_rtt) {
+        dg->srtt_ms = sample;
+        dg->rttvar_ms = sample / 2;
+        dg->have_rtt = 1;
+    } else {
+        uint32_t delta = dg->srtt_ms > sample ? dg->srtt_ms - sample : sample - dg->srtt_ms;
+
+        dg->rttvar_ms = (3 * dg->rttvar_ms + delta) / 4;
+        dg->srtt_ms = (7 * dg->srtt_ms + sample) / 8;
+    }
+
+    rto = dg->srtt_ms + (4 * dg->rttvar_ms > PLATFORM_COARSE_CLOCK_TICK_MS
+                             ? 4 * dg->rttvar_ms : PLATFORM_COARSE_CLOCK_TICK_MS);
+    dg->rto_ms = rto < MIN_RTO_MS ? MIN_RTO_MS : rto > MAX_RTO_MS ? MAX_RTO_MS : rto;
+}
+
+/* Internal: Acknowledge everything received contiguously, plus which of
+ * the next 64 ids arrived ahead of a gap */
+static void send_ack(datagram_t *dg) {
+    unsigned char ack[ACK_SIZE];
+    uint32_t next_id = dg->rx_next_id;
+    uint64_t bitmap = 0;
+
+    while (next_id - dg->rx_next_id < DATAGRAM_MAX_INFLIGHT &&
+           dg->reorder[next_id % DATAGRAM_MAX_INFLIGHT].ready) {
+        next_id++;
+    }
+
+    for (uint32_t i = 0; i < ACK_BITMAP_BITS; i++) {
+        uint32_t id = next_id + 1 + i;
+
+        if (id - dg->rx_next_id >= DATAGRAM_MAX_INFLIGHT) break;
+        if (dg->reorder[id % DATAGRAM_MAX_INFLIGHT].ready) {
+            bitmap |= 1ULL << i;
+        }
+    }
+
+    ack[0] = (unsigned char)(next_id >> 24);
+    ack[1] = (unsigned char)(next_id >> 16);
+    ack[2] = (unsigned char)(next_id >> 8);
+    ack[3] = (unsigned char)next_id;
+    for (int i = 0; i < 8; i++) {
+        ack[4 + i] = (unsigned char)(bitmap >> (56 - 8 * i));
+    }
+
+    if (queue_packet(dg, PACKET_ACK, NULL, 0, ack, sizeof(ack)) == DATAGRAM_SUCCESS) {
+        dg->ack_pending = 0;
+    }
+}
+
+/* Internal: Write queued stream output before waiting for the answer */
+static int drain(connection_t *conn, int timeout_ms) {
+    int pending;
+
+    while ((pending = flush_connection(conn)) > 0) {
+        if (wait_for_socket(get_connection_socket(conn), timeout_ms, 0, 1) <= 0) {
+            return -1;
+        }
+    }
+
+    return pending < 0 ? -1 : 0;
+}
+
+/* Internal: Answer a request */
+static int send_response(connection_t *conn, int status, uint16_t port, const unsigned char *nonce) {
+    unsigned char response[DATAGRAM_RESPONSE_SIZE];
+
+    response[0] = (unsigned char)status;
+    response[1] = (unsigned char)(port >> 8);
+    response[2] = (unsigned char)port;
+    if (nonce) {
+        memcpy(response + 3, nonce, DATAGRAM_NONCE_SIZE);
+    } else {
+        memset(response + 3, 0, DATAGRAM_NONCE_SIZE);
+    }
+
+    if (send_message(conn, MSG_DGRAM_RESPONSE, response, sizeof(response)) != PROTOCOL_SUCCESS) {
+        return DATAGRAM_ERROR_SYSTEM;
+    }
+
+    return DATAGRAM_SUCCESS;
+}
+
+/* Get error message */
+const char* datagram_strerror(int error_code) {
+    switch (error_code) {
+        case DATAGRAM_SUCCESS:
+            return "Success";
+        case DATAGRAM_IN_PROGRESS:
+            return "Nothing ready yet";
+        case DATAGRAM_ERROR_PARAM:
+            return "Invalid parameter";
+        case DATAGRAM_ERROR_UNSUPPORTED:
+            return "Datagram transport not supported";
+        case DATAGRAM_ERROR_REJECTED:
+            return "Peer refused a datagram channel";
+        case DATAGRAM_ERROR_TIMEOUT:
+            return "Peer did not answer";
+        case DATAGRAM_ERROR_KEY:
+            return "Key derivation or sealing failed";
+        case DATAGRAM_ERROR_PROTOCOL:
+            return "Unexpected message during setup";
+        case DATAGRAM_ERROR_SYSTEM:
+            return "System call failed";
+        case DATAGRAM_ERROR_MEMORY:
+            return "Memory allocation failed";
+        case DATAGRAM_ERROR_SIZE:
+            return "Message too large";
+        case DATAGRAM_ERROR_UNREACHABLE:
+            return "Peer stopped acknowledging";
+        default:
+            return "Unknown error";
+    }
+}
@@ -0,0 +1,1991 @@
+/*
+ * Cryptcat Event Loop
+ * Reactor driving accept, handshake, framing and application callbacks
+ * for many connections on one thread, on edge-triggered epoll or on
+ * io_uring completions
+ * Version: 1.0.0
+ * License: MIT
+ */
+
+#define _GNU_SOURCE  /* strdup, clock_gettime */
+
+#include "event_loop.h"
+#include "network.h"
+#include "protocol.h"
+#include "platform.h"
+#include "uring_io.h"
+#include "timer_wheel.h"
+#include "utils/logger.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <stdatomic.h>
+
+#ifdef __linux__
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+#if defined(__linux__) && defined(HAVE_LIBURING)
+#define EVENT_LOOP_URING 1
+#include <liburing.h>
+#include <poll.h>
+#endif
+
+/* Event loop constants */
+#define MAX_EVENTS_PER_WAIT 256
+#define HANDSHAKE_TIMEOUT_MS 10000  /* Matches the blocking handshake */
+#define TIMER_TICK_MS 10            /* Timer wheel resolution */
+#define MESSAGE_BUFFER_SIZE 65536   /* Largest message payload */
+#define INITIAL_TABLE_SIZE 1024
+
+/* io_uring backend constants */
+#define URING_ENTRIES 4096          /* Submission queue depth */
+#define URING_MAX_CHAIN 64          /* Records per linked send chain */
+#define URING_RECV_BUFFERS 512      /* Provided buffer ring (power of two) */
+#define URING_RECV_BUFFER_SIZE 16384
+#define URING_BUFFER_GROUP 0
+#define URING_DRAIN_MS 100          /* Wait for sends in flight on destroy */
+
+/* io_uring user_data: a send completion carries its queue node (8-byte
+ * aligned, so tag 0); anything else packs descriptor, generation and tag */
+#define URING_TAG_SEND 0
+#define URING_TAG_POLL 1
+#define URING_TAG_RECV 2
+#define URING_TAG_CANCEL 3
+#define URING_TAG_MASK 7
+#define URING_GENERATION_MASK 0x1FFFFFFFu
+
+#ifdef __linux__
+
+/* What a registered descriptor is */
+typedef enum {
+    ENTRY_FREE = 0,
+    ENTRY_LISTENER,
+    ENTRY_CONNECTION,
+    ENTRY_WAKE,
+    ENTRY_REAP                      /* network_reap_fd(): closed sockets' completions */
+} entry_kind_t;
+
+/* One encrypted record waiting for, or owned by, an io_uring send */
+typedef struct uring_send_s {
+    struct uring_send_s *next;
+    int fd;
+    uint32_t generation;            /* Entry generation at queue time */
+    size_t len;
+    unsigned char data[];
+} uring_send_t;
+
+/* Per-descriptor state, indexed by socket descriptor */
+typedef struct {
+    connection_t *conn;
+    handshake_t *hs;                /* Non-NULL until the handshake is done */
+    uint64_t last_rx_ms;            /* Last message delivered */
+    uint64_t last_tx_ms;            /* Last record queued */
+    int pending_index;              /* Slot in the handshake list, -1 if none */
+    int live_index;                 /* Slot in the established list, -1 if none */
+    uint32_t generation;            /* Bumped on reuse; stale completions are dropped */
+    uring_send_t *tx_head;          /* Records not yet submitted (io_uring) */
+    uring_send_t *tx_tail;
+    uint32_t tx_inflight;           /* Sends submitted and not yet completed */
+    uint8_t kind;
+    uint8_t closing;                /* Inside release_entry() */
+    uint8_t tx_dirty;               /* Listed for the next send flush */
+    uint8_t read_paused;            /* Reading held until output drains */
+    uint8_t detaching;              /* Leaving the loop: input is staged, not delivered */
+    uint8_t io_ended;               /* Backend stopped reading while detaching */
+} loop_entry_t;
+
+#ifdef EVENT_LOOP_URING
+/* Completion copied out of the CQ ring before dispatch */
+typedef struct {
+    uint64_t user_data;
+    int res;
+    unsigned flags;
+} uring_completion_t;
+#endif
+
+/* Reactor state */
+struct event_loop_s {
+    int epfd;
+    int wake_fd;                    /* eventfd used by event_loop_stop() */
+    char *password;
+    event_loop_callbacks_t callbacks;
+    int max_connections;
+    atomic_int stopping;
+    event_loop_backend_t backend;
+
+    loop_entry_t *entries;
+    int entries_cap;
+
+    int *pending;                   /* Descriptors with a running handshake */
+    int pending_count;
+    int pending_cap;
+
+    int *live;                      /* Established connections, dense for fan-out */
+    int live_count;
+    int live_cap;
+
+    timer_wheel_t *timers;          /* One timer per connection, keyed by descriptor */
+    int idle_timeout_ms;            /* 0 = never evict */
+    int keepalive_ms;               /* 0 = never send keepalives */
+    uint64_t now_ms;                /* Clock read once per wakeup */
+
+    platform_mutex_t keys_lock;     /* Guards keys_ready, filled by KDF threads */
+    int *keys_ready;                /* Descriptors whose keys came back */
+    int keys_ready_count;
+    int keys_ready_cap;
+    int keys_ready_lost;            /* A completion did not fit; scan them all */
+    int *keys_spare;                /* keys_ready's other half while servicing */
+    int keys_spare_cap;
+
+    struct epoll_event events[MAX_EVENTS_PER_WAIT];
+    unsigned char *rx_buffer;       /* Payload handed to on_message */
+    event_loop_stats_t stats;
+
+    int *tx_dirty;                  /* Descriptors with output to flush */
+    int tx_dirty_count;
+    int tx_dirty_cap;
+
+#ifdef EVENT_LOOP_URING
+    struct io_uring ring;
+    int ring_ready;
+    struct io_uring_buf_ring *buf_ring;
+    unsigned char *recv_buffers;    /* Backing store of the buffer ring */
+    uint32_t sends_in_flight;
+    uring_completion_t completions[MAX_EVENTS_PER_WAIT];
+#endif
+};
+
+/* Internal function prototypes */
+static uint64_t loop_now_ms(void);
+static int register_fd(event_loop_t *loop, int fd, entry_kind_t kind,
+                       connection_t *conn, uint32_t events);
+static void unwatch_fd(event_loop_t *loop, int fd);
+static void clear_entry(event_loop_t *loop, int fd);
+static void release_entry(event_loop_t *loop, int fd, int reason, int notify);
+static void abort_entry(event_loop_t *loop, int fd, int reason);
+static int mark_dirty(event_loop_t *loop, int fd);
+static void epoll_output_queued(void *ctx, connection_t *conn);
+static void epoll_flush_dirty(event_loop_t *loop);
+static int socket_failed(int fd);
+static int epoll_dispatch(event_loop_t *loop, int wait_ms);
+static int pending_add(event_loop_t *loop, int fd);
+static void pending_remove(event_loop_t *loop, int fd);
+static int live_reserve(event_loop_t *loop, int count);
+static void live_add(event_loop_t *loop, int fd);
+static void live_remove(event_loop_t *loop, int fd);
+static void accept_clients(event_loop_t *loop, int fd);
+static void drive_handshake(event_loop_t *loop, int fd);
+static void drain_messages(event_loop_t *loop, int fd);
+static void flush_output(event_loop_t *loop, int fd);
+static void keys_ready(void *ctx, connection_t *conn);
+static void service_handshakes(event_loop_t *loop);
+static void arm_connection_timer(event_loop_t *loop, int fd);
+static void on_timer(void *ctx, uint32_t id);
+static void establish(event_loop_t *loop, int fd);
+
+#ifdef EVENT_LOOP_URING
+static int uring_setup(event_loop_t *loop);
+static void uring_teardown(event_loop_t *loop);
+static int uring_watch(event_loop_t *loop, int fd);
+static void uring_unwatch(event_loop_t *loop, int fd);
+static int uring_queue_send(void *ctx, connection_t *conn,
+                            const unsigned char *data, size_t len);
+static void uring_flush_sends(event_loop_t *loop, int fd);
+static void uring_flush_dirty(event_loop_t *loop);
+static int uring_dispatch(event_loop_t *loop, int wait_ms);
+static void uring_complete(event_loop_t *loop, const uring_completion_t *completion);
+static int uring_detach(event_loop_t *loop, int fd, int timeout_ms);
+#endif
+
+/* Create an event loop */
+event_loop_t* event_loop_create(const char *password,
+                                const event_loop_callbacks_t *callbacks,
+                                int max_connections) {
+    return event_loop_create_backend(password, callbacks, max_connections,
+                                     EVENT_LOOP_BACKEND_AUTO);
+}
+
+/* Create an event loop on a chosen backend */
+event_loop_t* event_loop_create_backend(const char *password,
+                                        const event_loop_callbacks_t *callbacks,
+                                        int max_connections,
+                                        event_loop_backend_t backend) {
+    event_loop_t *loop;
+
+    if (!password || !callbacks || max_connections < 0) {
+        LOG_ERROR("Invalid event loop parameters");
+        return NULL;
+    }
+
+    loop = calloc(1, sizeof(event_loop_t));
+    if (!loop) {
+        LOG_ERROR("Memory allocation failed");
+        return NULL;
+    }
+
+    loop->epfd = -1;
+    loop->wake_fd = -1;
+    loop->callbacks = *callbacks;
+    loop->max_connections = max_connections ? max_connections
+                                            : EVENT_LOOP_DEFAULT_MAX_CONNECTIONS;
+    atomic_init(&loop->stopping, 0);
+
+    loop->password = strdup(password);
+    loop->rx_buffer = malloc(MESSAGE_BUFFER_SIZE);
+    loop->entries = calloc(INITIAL_TABLE_SIZE, sizeof(loop_entry_t));
+    loop->now_ms = loop_now_ms();
+    loop->timers = timer_wheel_create(TIMER_TICK_MS, loop->now_ms);
+    loop->keys_lock = platform_mutex_create();
+    if (!loop->password || !loop->rx_buffer || !loop->entries || !loop->timers ||
+        !loop->keys_lock) {
+        LOG_ERROR("Memory allocation failed");
+        event_loop_destroy(loop);
+        return NULL;
+    }
+    loop->entries_cap = INITIAL_TABLE_SIZE;
+
+    /* Explicit requests skip the CRYPTCAT_IO_BACKEND override */
+    loop->backend = EVENT_LOOP_BACKEND_EPOLL;
+#ifdef EVENT_LOOP_URING
+    if (backend == EVENT_LOOP_BACKEND_IO_URING ||
+        (backend == EVENT_LOOP_BACKEND_AUTO && uring_io_available())) {
+        if (uring_setup(loop) == EVENT_LOOP_SUCCESS) {
+            loop->backend = EVENT_LOOP_BACKEND_IO_URING;
+        } else {
+            LOG_WARNING("io_uring backend unavailable, falling back to epoll");
+        }
+    }
+#else
+    if (backend == EVENT_LOOP_BACKEND_IO_URING) {
+        LOG_WARNING("Built without io_uring support, falling back to epoll");
+    }
+#endif
+
+    if (loop->backend == EVENT_LOOP_BACKEND_EPOLL) {
+        loop->epfd = epoll_create1(EPOLL_CLOEXEC);
+        if (loop->epfd < 0) {
+            LOG_ERROR("epoll_create1 failed: %s", strerror(errno));
+            event_loop_destroy(loop);
+            return NULL;
+        }
+    }
+
+    /* Wakeup channel so other threads and signal handlers can stop the wait */
+    loop->wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (loop->wake_fd < 0 ||
+        register_fd(loop, loop->wake_fd, ENTRY_WAKE, NULL, EPOLLIN) != EVENT_LOOP_SUCCESS) {
+        LOG_ERROR("Failed to create event loop wakeup: %s", strerror(errno));
+        event_loop_destroy(loop);
+        return NULL;
+    }
+
+    /* Closed connections' pinned output is freed from here, not waited for */
+    if (network_reap_fd() >= 0 &&
+        register_fd(loop, network_reap_fd(), ENTRY_REAP, NULL, EPOLLIN) != EVENT_LOOP_SUCCESS) {
+        LOG_WARNING("Closed sockets' zerocopy output is reaped on close only");
+    }
+
+    LOG_DEBUG("Event loop created (%s, max %d connections)",
+              event_loop_backend_name(loop->backend), loop->max_connections);
+    return loop;
+}
+
+/* Destroy an event loop and everything it owns */
+void event_loop_destroy(event_loop_t *loop) {
+    if (!loop) return;
+
+    for (int fd = 0; fd < loop->entries_cap && loop->entries; fd++) {
+        if (loop->entries[fd].kind == ENTRY_LISTENER ||
+            loop->entries[fd].kind == ENTRY_CONNECTION) {
+            release_entry(loop, fd, PROTOCOL_SUCCESS, 0);
+        }
+    }
+
+#ifdef EVENT_LOOP_URING
+    uring_teardown(loop);
+#endif
+
+    if (loop->wake_fd >= 0) close(loop->wake_fd);
+    if (loop->epfd >= 0) close(loop->epfd);
+
+    if (loop->password) {
+        memset(loop->password, 0, strlen(loop->password));
+        free(loop->password);
+    }
+
+    free(loop->rx_buffer);
+    free(loop->entries);
+    free(loop->pending);
+    free(loop->live);
+    free(loop->tx_dirty);
+    timer_wheel_destroy(loop->timers);
+    free(loop->keys_ready);
+    free(loop->keys_spare);
+    if (loop->keys_lock) platform_mutex_destroy(loop->keys_lock);
+    free(loop);
+}
+
+/* Register a listener */
+int event_loop_add_listener(event_loop_t *loop, connection_t *listener) {
+    int fd = get_connection_socket(listener);
+
+    if (!loop || fd < 0 || !get_connection_info(listener).is_listening) {
+        return EVENT_LOOP_ERROR_PARAM;
+    }
+
+    /* Accepted sockets inherit nothing from the listener, but the listener
+     * itself must not block once the backlog is drained */
+    if (platform_set_nonblocking(fd) != PLATFORM_SUCCESS) {
+        return EVENT_LOOP_ERROR_SYSTEM;
+    }
+
+    return register_fd(loop, fd, ENTRY_LISTENER, listener, EPOLLIN | EPOLLET);
+}
+
+/* Register a connection and start its handshake */
+int event_loop_add_connection(event_loop_t *loop, connection_t *conn, int is_server) {
+    loop_entry_t *entry;
+    handshake_t *hs;
+    int fd = get_connection_socket(conn);
+    int result;
+
+    if (!loop || fd < 0) {
+        return EVENT_LOOP_ERROR_PARAM;
+    }
+
+    if (loop->stats.connections >= (uint32_t)loop->max_connections) {
+        return EVENT_LOOP_ERROR_LIMIT;
+    }
+
+    /* Room in the established list is taken now, so finishing the
+     * handshake cannot fail for lack of it */
+    if (live_reserve(loop, (int)loop->stats.connections + 1) != EVENT_LOOP_SUCCESS) {
+        return EVENT_LOOP_ERROR_MEMORY;
+    }
+
+    /* Edge-triggered readiness requires reads that stop at EAGAIN */
+    if (platform_set_nonblocking(fd) != PLATFORM_SUCCESS) {
+        return EVENT_LOOP_ERROR_SYSTEM;
+    }
+
+    /* A full socket queues output for EPOLLOUT instead of stalling the loop */
+    set_connection_async_send(conn, 1);
+
+    hs = handshake_begin(conn, is_server, loop->password);
+    if (!hs) {
+        return EVENT_LOOP_ERROR_MEMORY;
+    }
+    handshake_set_notify(hs, keys_ready, loop);
+
+    result = register_fd(loop, fd, ENTRY_CONNECTION, conn,
+                         EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET);
+    if (result == EVENT_LOOP_SUCCESS) {
+        result = pending_add(loop, fd);
+        if (result == EVENT_LOOP_SUCCESS &&
+            timer_wheel_schedule(loop->timers, (uint32_t)fd,
+                                 loop_now_ms() + HANDSHAKE_TIMEOUT_MS) != TIMER_WHEEL_SUCCESS) {
+            pending_remove(loop, fd);
+            result = EVENT_LOOP_ERROR_MEMORY;
+        }
+        if (result != EVENT_LOOP_SUCCESS) {
+            unwatch_fd(loop, fd);
+            clear_entry(loop, fd);
+        }
+    }
+    if (result != EVENT_LOOP_SUCCESS) {
+        set_connection_async_send(conn, 0);
+        handshake_free(hs);
+        return result;
+    }
+
+    entry = &loop->entries[fd];
+    entry->hs = hs;
+
+    /* Records sealed during one dispatch leave in one gather write */
+    if (loop->backend == EVENT_LOOP_BACKEND_EPOLL) {
+        set_connection_cork(conn, 1, epoll_output_queued, loop);
+    }
+
+    loop->stats.connections++;
+    if (loop->stats.connections > loop->stats.peak_connections) {
+        loop->stats.peak_connections = loop->stats.connections;
+    }
+
+    /* Client sends its init now; a server's init may already be queued */
+    drive_handshake(loop, fd);
+    return EVENT_LOOP_SUCCESS;
+}
+
+/* Close a connection owned by the loop */
+void event_loop_close_connection(event_loop_t *loop, connection_t *conn) {
+    int fd = get_connection_socket(conn);
+
+    if (!loop || fd < 0 || fd >= loop->entries_cap ||
+        loop->entries[fd].conn != conn || loop->entries[fd].closing) {
+        return;
+    }
+
+    release_entry(loop, fd, PROTOCOL_SUCCESS, 1);
+}
+
+/* Register a connection that is already past its handshake */
+int event_loop_adopt_connection(event_loop_t *loop, connection_t *conn) {
+    connection_info_t info = get_connection_info(conn);
+    int fd = get_connection_socket(conn);
+    int result;
+
+    if (!loop || fd < 0 || info.is_listening || info.state != STATE_READY) {
+        return EVENT_LOOP_ERROR_PARAM;
+    }
+
+    if (loop->stats.connections >= (uint32_t)loop->max_connections) {
+        return EVENT_LOOP_ERROR_LIMIT;
+    }
+
+    if (live_reserve(loop, (int)loop->stats.connections + 1) != EVENT_LOOP_SUCCESS) {
+        return EVENT_LOOP_ERROR_MEMORY;
+    }
+
+    if (platform_set_nonblocking(fd) != PLATFORM_SUCCESS) {
+        return EVENT_LOOP_ERROR_SYSTEM;
+    }
+
+    set_connection_async_send(conn, 1);
+
+    result = register_fd(loop, fd, ENTRY_CONNECTION, conn,
+                         EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET);
+    if (result != EVENT_LOOP_SUCCESS) {
+        set_connection_async_send(conn, 0);
+        return result;
+    }
+
+    if (loop->backend == EVENT_LOOP_BACKEND_EPOLL) {
+        set_connection_cork(conn, 1, epoll_output_queued, loop);
+    }
+
+    loop->stats.connections++;
+    if (loop->stats.connections > loop->stats.peak_connections) {
+        loop->stats.peak_connections = loop->stats.connections;
+    }
+    loop->stats.adopted++;
+
+    /* Carried input raises no readiness; establish() delivers it */
+    establish(loop, fd);
+    return EVENT_LOOP_SUCCESS;
+}
+
+/* Hand a listener or established connection back to the caller */
+int event_loop_detach_connection(event_loop_t *loop, connection_t *conn, int timeout_ms) {
+    int fd = get_connection_socket(conn);
+    loop_entry_t *entry;
+    int kind;
+
+    if (!loop || fd < 0 || fd >= loop->entries_cap) {
+        return EVENT_LOOP_ERROR_PARAM;
+    }
+
+    entry = &loop->entries[fd];
+    kind = entry->kind;
+    if (entry->conn != conn || entry->closing || entry->detaching || entry->hs ||
+        (kind != ENTRY_LISTENER && kind != ENTRY_CONNECTION)) {
+        return EVENT_LOOP_ERROR_PARAM;
+    }
+
+#ifdef EVENT_LOOP_URING
+    /* Sends in flight finish and the multishot read ends first */
+    if (loop->backend == EVENT_LOOP_BACKEND_IO_URING) {
+        int result = uring_detach(loop, fd, timeout_ms);
+
+        if (result != EVENT_LOOP_SUCCESS) {
+            return result;
+        }
+        entry = &loop->entries[fd];
+    } else
+#endif
+    {
+        (void)timeout_ms;
+        epoll_ctl(loop->epfd, EPOLL_CTL_DEL, fd, NULL);
+    }
+
+    live_remove(loop, fd);
+
+    if (kind == ENTRY_CONNECTION) {
+        /* Queued output stays with the connection for flush_connection() */
+        set_connection_cork(conn, 0, NULL, NULL);
+        set_connection_send_hook(conn, NULL, NULL);
+        set_connection_staged_input(conn, 0);
+        loop->stats.connections--;
+        loop->stats.detached++;
+    }
+
+    clear_entry(loop, fd);
+    return EVENT_LOOP_SUCCESS;
+}
+
+/* Get a connection's handle */
+event_loop_handle_t event_loop_get_handle(const event_loop_t *loop, connection_t *conn) {
+    int fd = get_connection_socket(conn);
+
+    if (!loop || fd < 0 || fd >= loop->entries_cap ||
+        loop->entries[fd].conn != conn || loop->entries[fd].kind != ENTRY_CONNECTION) {
+        return EVENT_LOOP_INVALID_HANDLE;
+    }
+
+    return ((uint64_t)loop->entries[fd].generation << 32) | (uint32_t)fd;
+}
+
+/* Resolve a handle */
+connection_t* event_loop_lookup(const event_loop_t *loop, event_loop_handle_t handle) {
+    int fd = (int)(uint32_t)handle;
+    const loop_entry_t *entry;
+
+    if (!loop || handle == EVENT_LOOP_INVALID_HANDLE || fd < 0 || fd >= loop->entries_cap) {
+        return NULL;
+    }
+
+    /* A reused descriptor carries a newer generation */
+    entry = &loop->entries[fd];
+    if (entry->kind != ENTRY_CONNECTION || entry->closing ||
+        entry->generation != (uint32_t)(handle >> 32)) {
+        return NULL;
+    }
+
+    return entry->conn;
+}
+
+/* Visit every established connection */
+int event_loop_for_each(event_loop_t *loop, event_loop_visit_t visit, void *ctx) {
+    int visited = 0;
+
+    if (!loop || !visit) {
+        return EVENT_LOOP_ERROR_PARAM;
+    }
+
+    /* Walk backwards: a close swaps the last slot into the current one */
+    for (int i = loop->live_count - 1; i >= 0; i--) {
+        if (i >= loop->live_count) continue;
+
+        visit(loop, loop->entries[loop->live[i]].conn, ctx);
+        visited++;
+    }
+
+    return visited;
+}
+
+/* Send one message to every established connection */
+int event_loop_broadcast(event_loop_t *loop, message_type_t type,
+                         const unsigned char *payload, size_t payload_len,
+                         connection_t *except) {
+    int sent = 0;
+
+    if (!loop || (!payload && payload_len > 0)) {
+        return EVENT_LOOP_ERROR_PARAM;
+    }
+
+    /* Each peer has its own keys, so every copy is sealed separately;
+     * the records leave with the next flush, one write per connection */
+    for (int i = loop->live_count - 1; i >= 0; i--) {
+        if (i >= loop->live_count) continue;
+
+        int fd = loop->live[i];
+        connection_t *conn = loop->entries[fd].conn;
+
+        if (conn == except) continue;
+
+        if (send_message(conn, type, payload, payload_len) != PROTOCOL_SUCCESS) {
+            abort_entry(loop, fd, PROTOCOL_ERROR_NETWORK);
+            continue;
+        }
+        sent++;
+    }
+
+    return sent;
+}
+
+/* Wait once and dispatch */
+int event_loop_run_once(event_loop_t *loop, int timeout_ms) {
+    int wait_ms = timeout_ms;
+    int timer_ms;
+    int nready;
+
+    if (!loop) {
+        return EVENT_LOOP_ERROR_PARAM;
+    }
+
+    /* Finished KDFs wake the loop themselves; otherwise sleep until the
+     * next timer is due */
+    timer_ms = timer_wheel_next_timeout(loop->timers, loop_now_ms());
+    if (timer_ms >= 0 && (wait_ms < 0 || timer_ms < wait_ms)) {
+        wait_ms = timer_ms;
+    }
+
+#ifdef EVENT_LOOP_URING
+    if (loop->backend == EVENT_LOOP_BACKEND_IO_URING) {
+        nready = uring_dispatch(loop, wait_ms);
+    } else
+#endif
+    nready = epoll_dispatch(loop, wait_ms);
+    if (nready < 0) {
+        return nready;
+    }
+
+    if (loop->pending_count > 0) {
+        service_handshakes(loop);
+    }
+
+    timer_wheel_advance(loop->timers, loop->now_ms, on_timer, loop);
+
+    return nready;
+}
+
+/* Dispatch until stopped */
+int event_loop_run(event_loop_t *loop) {
+    int result;
+
+    if (!loop) {
+        return EVENT_LOOP_ERROR_PARAM;
+    }
+
+    while (!atomic_load(&loop->stopping)) {
+        result = event_loop_run_once(loop, -1);
+        if (result < 0) {
+            return result;
+        }
+    }
+
+    atomic_store(&loop->stopping, 0);
+    return EVENT_LOOP_SUCCESS;
+}
+
+/* Ask the loop to return (async-signal-safe) */
+void event_loop_stop(event_loop_t *loop) {
+    uint64_t one = 1;
+
+    if (!loop) return;
+
+    atomic_store(&loop->stopping, 1);
+    ssize_t ignored = write(loop->wake_fd, &one, sizeof(one));
+    (void)ignored;
+}
+
+/* Set idle eviction and keepalive intervals */
+int event_loop_set_timeouts(event_loop_t *loop, int idle_timeout_ms, int keepalive_ms) {
+    if (!loop || idle_timeout_ms < 0 || keepalive_ms < 0) {
+        return EVENT_LOOP_ERROR_PARAM;
+    }
+
+    loop->idle_timeout_ms = idle_timeout_ms;
+    loop->keepalive_ms = keepalive_ms;
+
+    /* Established connections pick up the new intervals now */
+    for (int fd = 0; fd < loop->entries_cap; fd++) {
+        loop_entry_t *entry = &loop->entries[fd];
+
+        if (entry->kind == ENTRY_CONNECTION && !entry->hs && !entry->closing) {
+            arm_connection_timer(loop, fd);
+        }
+    }
+
+    return EVENT_LOOP_SUCCESS;
+}
+
+/* Get statistics */
+event_loop_stats_t event_loop_get_stats(const event_loop_t *loop) {
+    event_loop_stats_t stats = {0};
+
+    if (loop) {
+        stats = loop->stats;
+        stats.handshaking = (uint32_t)loop->pending_count;
+        stats.established = (uint32_t)loop->live_count;
+    }
+
+    return stats;
+}
+
+/* Get the backend in use */
+event_loop_backend_t event_loop_get_backend(const event_loop_t *loop) {
+    return loop ? loop->backend : EVENT_LOOP_BACKEND_EPOLL;
+}
+
+/* Internal: Monotonic clock in milliseconds */
+static uint64_t loop_now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000ULL + (uint64_t)ts.tv_nsec / 1000000ULL;
+}
+
+/* Internal: Add a descriptor to the table and the epoll set */
+static int register_fd(event_loop_t *loop, int fd, entry_kind_t kind,
+                       connection_t *conn, uint32_t events) {
+    struct epoll_event ev;
+
+    /* Descriptors are small dense integers, so the table grows by doubling */
+    if (fd >= loop->entries_cap) {
+        int new_cap = loop->entries_cap;
+        loop_entry_t *entries;
+
+        while (new_cap <= fd) new_cap *= 2;
+
+        entries = realloc(loop->entries, (size_t)new_cap * sizeof(loop_entry_t));
+        if (!entries) {
+            return EVENT_LOOP_ERROR_MEMORY;
+        }
+        memset(entries + loop->entries_cap, 0,
+               (size_t)(new_cap - loop->entries_cap) * sizeof(loop_entry_t));
+        loop->entries = entries;
+        loop->entries_cap = new_cap;
+    }
+
+    if (loop->entries[fd].kind != ENTRY_FREE) {
+        return EVENT_LOOP_ERROR_PARAM;
+    }
+
+    clear_entry(loop, fd);
+    loop->entries[fd].generation++;
+    loop->entries[fd].conn = conn;
+    loop->entries[fd].kind = (uint8_t)kind;
+
+#ifdef EVENT_LOOP_URING
+    if (loop->backend == EVENT_LOOP_BACKEND_IO_URING) {
+        if (uring_watch(loop, fd) != EVENT_LOOP_SUCCESS) {
+            clear_entry(loop, fd);
+            return EVENT_LOOP_ERROR_SYSTEM;
+        }
+        return EVENT_LOOP_SUCCESS;
+    }
+#endif
+
+    memset(&ev, 0, sizeof(ev));
+    ev.events = events;
+    ev.data.fd = fd;
+
+    if (epoll_ctl(loop->epfd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+        LOG_ERROR("epoll_ctl(ADD) failed for fd %d: %s", fd, strerror(errno));
+        clear_entry(loop, fd);
+        return EVENT_LOOP_ERROR_SYSTEM;
+    }
+
+    return EVENT_LOOP_SUCCESS;
+}
+
+/* Internal: Stop the backend watching a descriptor (before it is closed) */
+static void unwatch_fd(event_loop_t *loop, int fd) {
+#ifdef EVENT_LOOP_URING
+    if (loop->backend == EVENT_LOOP_BACKEND_IO_URING) {
+        uring_unwatch(loop, fd);
+        return;
+    }
+#endif
+    epoll_ctl(loop->epfd, EPOLL_CTL_DEL, fd, NULL);
+}
+
+/* Internal: Reset a table slot, keeping its generation */
+static void clear_entry(event_loop_t *loop, int fd) {
+    uint32_t generation = loop->entries[fd].generation;
+
+    memset(&loop->entries[fd], 0, sizeof(loop_entry_t));
+    loop->entries[fd].generation = generation;
+    loop->entries[fd].pending_index = -1;
+    loop->entries[fd].live_index = -1;
+
+    timer_wheel_cancel(loop->timers, (uint32_t)fd);
+}
+
+/* Internal: Close, unregister and free one descriptor's connection */
+static void release_entry(event_loop_t *loop, int fd, int reason, int notify) {
+    loop_entry_t *entry = &loop->entries[fd];
+    connection_t *conn = entry->conn;
+    int kind = entry->kind;
+
+    if (kind == ENTRY_FREE || entry->closing) return;
+    entry->closing = 1;
+
+    /* Out of fan-out before on_close can broadcast a farewell */
+    live_remove(loop, fd);
+
+    if (notify && kind == ENTRY_CONNECTION && loop->callbacks.on_close) {
+        loop->callbacks.on_close(loop, conn, reason, loop->callbacks.ctx);
+        entry = &loop->entries[fd];
+    }
+
+    unwatch_fd(loop, fd);
+
+    if (entry->hs) {
+        pending_remove(loop, fd);
+        handshake_free(entry->hs);
+    }
+
+    if (kind == ENTRY_CONNECTION) {
+        loop->stats.connections--;
+    }
+
+    clear_entry(loop, fd);
+
+    close_connection(conn);
+    free(conn);
+}
+
+/* Internal: Drop a connection after an I/O failure */
+static void abort_entry(event_loop_t *loop, int fd, int reason) {
+    int handshaking = loop->entries[fd].hs != NULL;
+
+    /* Handshakes were never reported to the application */
+    if (handshaking) loop->stats.handshakes_failed++;
+    release_entry(loop, fd, reason, !handshaking);
+}
+
+/* Internal: List a connection for the next output flush */
+static int mark_dirty(event_loop_t *loop, int fd) {
+    loop_entry_t *entry = &loop->entries[fd];
+
+    if (entry->tx_dirty) return 0;
+
+    if (loop->tx_dirty_count == loop->tx_dirty_cap) {
+        int new_cap = loop->tx_dirty_cap ? loop->tx_dirty_cap * 2 : 64;
+        int *dirty = realloc(loop->tx_dirty, (size_t)new_cap * sizeof(int));
+
+        if (!dirty) return -1;
+        loop->tx_dirty = dirty;
+        loop->tx_dirty_cap = new_cap;
+    }
+
+    loop->tx_dirty[loop->tx_dirty_count++] = fd;
+    entry->tx_dirty = 1;
+    return 0;
+}
+
+/* Internal: Track a running handshake */
+static int pending_add(event_loop_t *loop, int fd) {
+    if (loop->pending_count == loop->pending_cap) {
+        int new_cap = loop->pending_cap ? loop->pending_cap * 2 : 64;
+        int *pending = realloc(loop->pending, (size_t)new_cap * sizeof(int));
+
+        if (!pending) {
+            return EVENT_LOOP_ERROR_MEMORY;
+        }
+        loop->pending = pending;
+        loop->pending_cap = new_cap;
+    }
+
+    loop->entries[fd].pending_index = loop->pending_count;
+    loop->pending[loop->pending_count++] = fd;
+
+    return EVENT_LOOP_SUCCESS;
+}
+
+/* Internal: Stop tracking a handshake (swap with the last slot) */
+static void pending_remove(event_loop_t *loop, int fd) {
+    loop_entry_t *entry = &loop->entries[fd];
+    int index = entry->pending_index;
+
+    if (index < 0) return;
+
+    int last = loop->pending[--loop->pending_count];
+    loop->pending[index] = last;
+    loop->entries[last].pending_index = index;
+    entry->pending_index = -1;
+}
+
+/* Internal: Grow the established list to hold count descriptors */
+static int live_reserve(event_loop_t *loop, int count) {
+    int new_cap;
+    int *live;
+
+    if (count <= loop->live_cap) {
+        return EVENT_LOOP_SUCCESS;
+    }
+
+    new_cap = loop->live_cap ? loop->live_cap : 64;
+    while (new_cap < count) new_cap *= 2;
+
+    live = realloc(loop->live, (size_t)new_cap * sizeof(int));
+    if (!live) {
+        return EVENT_LOOP_ERROR_MEMORY;
+    }
+    loop->live = live;
+    loop->live_cap = new_cap;
+
+    return EVENT_LOOP_SUCCESS;
+}
+
+/* Internal: List an established connection (room was reserved at registration) */
+static void live_add(event_loop_t *loop, int fd) {
+    loop->entries[fd].live_index = loop->live_count;
+    loop->live[loop->live_count++] = fd;
+}
+
+/* Internal: Unlist a connection (swap with the last slot) */
+static void live_remove(event_loop_t *loop, int fd) {
+    loop_entry_t *entry = &loop->entries[fd];
+    int index = entry->live_index;
+
+    if (index < 0) return;
+
+    int last = loop->live[--loop->live_count];
+    loop->live[index] = last;
+    loop->entries[last].live_index = index;
+    entry->live_index = -1;
+}
+
+/* Internal: Accept until the backlog is empty */
+static void accept_clients(event_loop_t *loop, int fd) {
+    connection_t *listener = loop->entries[fd].conn;
+    connection_t *client;
+
+    /* accept_connection() returns NULL once the backlog is drained */
+    while ((client = accept_connection(listener)) != NULL) {
+        int result;
+
+        loop->stats.accepted++;
+
+        result = event_loop_add_connection(loop, client, 1);
+        if (result != EVENT_LOOP_SUCCESS) {
+            if (result == EVENT_LOOP_ERROR_LIMIT) {
+                loop->stats.rejected++;
+                LOG_WARNING("Connection limit (%d) reached, refusing client",
+                           loop->max_connections);
+            } else {
+                LOG_ERROR("Failed to register client: %s", event_loop_strerror(result));
+            }
+            close_connection(client);
+            free(client);
+        }
+    }
+}
+
+/* Internal: Advance a handshake without blocking */
+static void drive_handshake(event_loop_t *loop, int fd) {
+    loop_entry_t *entry = &loop->entries[fd];
+    int result;
+
+    /* A handshake waiting on its KDF is stepped again from keys_ready() */
+    result = handshake_step(entry->hs, 0);
+    if (result == PROTOCOL_IN_PROGRESS) {
+        return;
+    }
+
+    pending_remove(loop, fd);
+    handshake_free(entry->hs);
+    entry->hs = NULL;
+
+    /* Never reported to the application, so no on_close either */
+    if (result != PROTOCOL_SUCCESS) {
+        loop->stats.handshakes_failed++;
+        LOG_DEBUG("Handshake on fd %d failed: %s", fd, protocol_strerror(result));
+        release_entry(loop, fd, result, 0);
+        return;
+    }
+
+    loop->stats.handshakes_completed++;
+
+    /* 0-RTT data may have arrived along with the init */
+    establish(loop, fd);
+}
+
+/* Internal: List a connection past its handshake, report it and deliver
+ * what it has already received */
+static void establish(event_loop_t *loop, int fd) {
+    loop_entry_t *entry = &loop->entries[fd];
+    connection_t *conn = entry->conn;
+
+    live_add(loop, fd);
+
+    /* The handshake deadline gives way to idle and keepalive checks */
+    entry->last_rx_ms = entry->last_tx_ms = loop_now_ms();
+    arm_connection_timer(loop, fd);
+
+    if (loop->callbacks.on_connect) {
+        loop->callbacks.on_connect(loop, conn, loop->callbacks.ctx);
+        if (loop->entries[fd].conn != conn) return;
+    }
+
+    drain_messages(loop, fd);
+}
+
+/* Internal: Deliver messages until the socket would block */
+static void drain_messages(event_loop_t *loop, int fd) {
+    connection_t *conn = loop->entries[fd].conn;
+
+    loop->entries[fd].last_rx_ms = loop->now_ms;
+
+    for (;;) {
+        message_type_t msg_type;
+        size_t payload_len = MESSAGE_BUFFER_SIZE;
+        int result;
+
+        /* Replies are backing up: stop reading so the peer feels it;
+         * flush_output() resumes once the queue drains */
+        if (connection_send_blocked(conn)) {
+            if (!loop->entries[fd].read_paused) loop->stats.send_stalls++;
+            loop->entries[fd].read_paused = 1;
+            return;
+        }
+
+        result = receive_message(conn, &msg_type, loop->rx_buffer, &payload_len);
+        if (result == PROTOCOL_IN_PROGRESS) {
+            /* Drained; the next edge arrives with new data */
+            return;
+        }
+
+        if (result != PROTOCOL_SUCCESS) {
+            release_entry(loop, fd, result, 1);
+            return;
+        }
+
+        /* Keepalives only refresh the idle clock */
+        if (msg_type == MSG_KEEPALIVE) {
+            continue;
+        }
+
+        loop->stats.messages++;
+
+        if (loop->callbacks.on_message) {
+            loop->callbacks.on_message(loop, conn, msg_type, loop->rx_buffer,
+                                       payload_len, loop->callbacks.ctx);
+            if (loop->entries[fd].conn != conn) return;
+        }
+    }
+}
+
+/* Internal: Socket writable again; push out queued records */
+static void flush_output(event_loop_t *loop, int fd) {
+    connection_t *conn = loop->entries[fd].conn;
+    int was_blocked = connection_send_blocked(conn);
+
+    if (flush_connection(conn) < 0) {
+        abort_entry(loop, fd, PROTOCOL_ERROR_NETWORK);
+        return;
+    }
+
+    if (!was_blocked || connection_send_blocked(conn)) {
+        return;
+    }
+
+    if (loop->callbacks.on_writable) {
+        loop->callbacks.on_writable(loop, conn, loop->callbacks.ctx);
+        if (loop->entries[fd].conn != conn) return;
+    }
+
+    /* Input left unread while paused raises no new edge */
+    if (loop->entries[fd].read_paused) {
+        loop->entries[fd].read_paused = 0;
+        drain_messages(loop, fd);
+    }
+}
+
+/* Internal: Key derivation finished; runs on a KDF pool thread, so it
+ * only queues the descriptor and wakes the loop */
+static void keys_ready(void *ctx, connection_t *conn) {
+    event_loop_t *loop = (event_loop_t*)ctx;
+    uint64_t one = 1;
+
+    platform_mutex_lock(loop->keys_lock);
+    if (loop->keys_ready_count == loop->keys_ready_cap) {
+        int new_cap = loop->keys_ready_cap ? loop->keys_ready_cap * 2 : 64;
+        int *grown = realloc(loop->keys_ready, (size_t)new_cap * sizeof(int));
+
+        if (grown) {
+            loop->keys_ready = grown;
+            loop->keys_ready_cap = new_cap;
+        }
+    }
+    if (loop->keys_ready_count < loop->keys_ready_cap) {
+        loop->keys_ready[loop->keys_ready_count++] = get_connection_socket(conn);
+    } else {
+        loop->keys_ready_lost = 1;
+    }
+    platform_mutex_unlock(loop->keys_lock);
+
+    ssize_t ignored = write(loop->wake_fd, &one, sizeof(one));
+    (void)ignored;
+}
+
+/* Internal: Resume handshakes whose keys came back */
+static void service_handshakes(event_loop_t *loop) {
+    int *ready;
+    int count, cap, lost;
+
+    /* Swap the queue out: stepping a handshake may queue another KDF,
+     * and the pool calls keys_ready() with its own lock held */
+    platform_mutex_lock(loop->keys_lock);
+    ready = loop->keys_ready;
+    count = loop->keys_ready_count;
+    lost = loop->keys_ready_lost;
+    cap = loop->keys_ready_cap;
+    loop->keys_ready = loop->keys_spare;
+    loop->keys_ready_cap = loop->keys_spare_cap;
+    loop->keys_spare = ready;
+    loop->keys_spare_cap = cap;
+    loop->keys_ready_count = 0;
+    loop->keys_ready_lost = 0;
+    platform_mutex_unlock(loop->keys_lock);
+
+    if (lost) {
+        /* Walk backwards: removals swap the last slot into the current one */
+        for (int i = loop->pending_count - 1; i >= 0; i--) {
+            if (i >= loop->pending_count) continue;
+
+            int fd = loop->pending[i];
+
+            if (!handshake_waiting_for_keys(loop->entries[fd].hs)) {
+                drive_handshake(loop, fd);
+            }
+        }
+        return;
+    }
+
+    /* The descriptor may have closed, or been reused, since */
+    for (int i = 0; i < count; i++) {
+        int fd = ready[i];
+
+        if (fd >= 0 && fd < loop->entries_cap &&
+            loop->entries[fd].kind == ENTRY_CONNECTION && loop->entries[fd].hs &&
+            !loop->entries[fd].closing) {
+            drive_handshake(loop, fd);
+        }
+    }
+}
+
+/* Internal: Arm an established connection's timer for whichever of its
+ * idle deadline and keepalive comes first. Activity does not touch the
+ * wheel; the timer re-arms itself from the timestamps when it fires */
+static void arm_connection_timer(event_loop_t *loop, int fd) {
+    loop_entry_t *entry = &loop->entries[fd];
+    uint64_t due = UINT64_MAX;
+
+    if (loop->idle_timeout_ms > 0) {
+        due = entry->last_rx_ms + (uint64_t)loop->idle_timeout_ms;
+    }
+    if (loop->keepalive_ms > 0 && entry->last_tx_ms + (uint64_t)loop->keepalive_ms < due) {
+        due = entry->last_tx_ms + (uint64_t)loop->keepalive_ms;
+    }
+
+    if (due == UINT64_MAX) {
+        timer_wheel_cancel(loop->timers, (uint32_t)fd);
+    } else if (timer_wheel_schedule(loop->timers, (uint32_t)fd, due) != TIMER_WHEEL_SUCCESS) {
+        LOG_WARNING("Failed to arm timer for fd %d", fd);
+    }
+}
+
+/* Internal: Timer wheel callback; handshake deadline, idle eviction or
+ * keepalive, depending on what the connection is waiting for */
+static void on_timer(void *ctx, uint32_t id) {
+    event_loop_t *loop = (event_loop_t*)ctx;
+    int fd = (int)id;
+    loop_entry_t *entry;
+    uint64_t now = loop->now_ms;
+
+    if (fd >= loop->entries_cap) return;
+
+    entry = &loop->entries[fd];
+    if (entry->kind != ENTRY_CONNECTION || entry->closing) return;
+
+    if (entry->hs) {
+        loop->stats.handshakes_failed++;
+        LOG_WARNING("Handshake on fd %d timed out", fd);
+        release_entry(loop, fd, PROTOCOL_ERROR_TIMEOUT, 0);
+        return;
+    }
+
+    if (loop->idle_timeout_ms > 0 &&
+        now >= entry->last_rx_ms + (uint64_t)loop->idle_timeout_ms) {
+        loop->stats.idle_evictions++;
+        LOG_DEBUG("Connection on fd %d idle, closing", fd);
+        release_entry(loop, fd, PROTOCOL_ERROR_TIMEOUT, 1);
+        return;
+    }
+
+    /* Corked like any other output; the next dispatch writes it */
+    if (loop->keepalive_ms > 0 &&
+        now >= entry->last_tx_ms + (uint64_t)loop->keepalive_ms) {
+        if (send_keepalive(entry->conn) != PROTOCOL_SUCCESS) {
+            abort_entry(loop, fd, PROTOCOL_ERROR_NETWORK);
+            return;
+        }
+        loop->stats.keepalives_sent++;
+        entry->last_tx_ms = now;
+    }
+
+    arm_connection_timer(loop, fd);
+}
+
+/* Internal: Cork hook; a connection has output for the next flush */
+static void epoll_output_queued(void *ctx, connection_t *conn) {
+    event_loop_t *loop = (event_loop_t*)ctx;
+    int fd = get_connection_socket(conn);
+
+    if (fd < 0 || fd >= loop->entries_cap) return;
+    loop->entries[fd].last_tx_ms = loop->now_ms;
+
+    /* Cannot defer; write on the spot and let errors surface on EPOLLOUT */
+    if (mark_dirty(loop, fd) < 0) {
+        flush_connection(conn);
+    }
+}
+
+/* Internal: Write out every connection corked since the last flush */
+static void epoll_flush_dirty(event_loop_t *loop) {
+    /* Callbacks run by flush_output() may list more; the count is re-read */
+    for (int i = 0; i < loop->tx_dirty_count; i++) {
+        int fd = loop->tx_dirty[i];
+        loop_entry_t *entry = &loop->entries[fd];
+
+        if (!entry->tx_dirty) continue;
+        entry->tx_dirty = 0;
+
+        if (entry->kind != ENTRY_CONNECTION || entry->closing) continue;
+
+        loop->stats.send_batches++;
+        flush_output(loop, fd);
+    }
+
+    loop->tx_dirty_count = 0;
+}
+
+/* Internal: EPOLLERR also reports zerocopy completions; only a pending
+ * socket error is fatal */
+static int socket_failed(int fd) {
+    int error = 0;
+    socklen_t len = sizeof(error);
+
+    return getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &len) < 0 || error != 0;
+}
+
+/* Internal: Wait on epoll and dispatch readiness */
+static int epoll_dispatch(event_loop_t *loop, int wait_ms) {
+    int nready;
+
+    /* Output corked outside a dispatch (service_handshakes(), the
+     * application) must not wait out the timeout */
+    epoll_flush_dirty(loop);
+
+    nready = epoll_wait(loop->epfd, loop->events, MAX_EVENTS_PER_WAIT, wait_ms);
+    loop->now_ms = loop_now_ms();
+
+    if (nready < 0) {
+        if (errno != EINTR) {
+            LOG_ERROR("epoll_wait failed: %s", strerror(errno));
+            return EVENT_LOOP_ERROR_SYSTEM;
+        }
+        nready = 0;
+    }
+
+    loop->stats.wakeups++;
+    loop->stats.events += nready;
+
+    for (int i = 0; i < nready; i++) {
+        int fd = loop->events[i].data.fd;
+        uint32_t events = loop->events[i].events;
+
+        /* Closed by an earlier callback in this batch */
+        if (fd >= loop->entries_cap) continue;
+
+        switch (loop->entries[fd].kind) {
+            case ENTRY_WAKE: {
+                uint64_t count;
+                ssize_t ignored = read(fd, &count, sizeof(count));
+                (void)ignored;
+                break;
+            }
+
+            case ENTRY_LISTENER:
+                accept_clients(loop, fd);
+                break;
+
+            case ENTRY_REAP:
+                network_reap_closed();
+                break;
+
+            case ENTRY_CONNECTION: {
+                connection_t *conn = loop->entries[fd].conn;
+
+                if (!(events & EPOLLIN) &&
+                    ((events & EPOLLHUP) || ((events & EPOLLERR) && socket_failed(fd)))) {
+                    abort_entry(loop, fd, PROTOCOL_ERROR_NETWORK);
+                    break;
+                }
+
+                /* EPOLLOUT edges only follow a send that hit EAGAIN; a
+                 * benign EPOLLERR carries zerocopy completions to collect */
+                if (events & (EPOLLOUT | EPOLLERR)) {
+                    flush_output(loop, fd);
+                    if (loop->entries[fd].conn != conn) break;
+                }
+
+                if (!(events & (EPOLLIN | EPOLLRDHUP))) {
+                    break;
+                }
+
+                if (loop->entries[fd].hs) {
+                    drive_handshake(loop, fd);
+                } else {
+                    drain_messages(loop, fd);
+                }
+                break;
+            }
+
+            default:
+                break;
+        }
+    }
+
+    /* Replies sealed by callbacks leave now, one write per connection */
+    epoll_flush_dirty(loop);
+
+    return nready;
+}
+
+#ifdef EVENT_LOOP_URING
+
+/* Internal: Pack descriptor, generation and tag into user_data */
+static uint64_t uring_tag(const event_loop_t *loop, int fd, int tag) {
+    return ((uint64_t)(uint32_t)fd << 32) |
+           ((uint64_t)(loop->entries[fd].generation & URING_GENERATION_MASK) << 3) |
+           (uint64_t)tag;
+}
+
+/* Internal: Entry a tagged completion belongs to, NULL if it went stale */
+static loop_entry_t* uring_entry(event_loop_t *loop, uint64_t user_data) {
+    int fd = (int)(user_data >> 32);
+    uint32_t generation = (uint32_t)(user_data >> 3) & URING_GENERATION_MASK;
+    loop_entry_t *entry;
+
+    if (fd < 0 || fd >= loop->entries_cap) return NULL;
+
+    entry = &loop->entries[fd];
+    if (entry->kind == ENTRY_FREE || entry->closing ||
+        (entry->generation & URING_GENERATION_MASK) != generation) {
+        return NULL;
+    }
+
+    return entry;
+}
+
+/* Internal: Get an SQE, flushing a full submission queue first */
+static struct io_uring_sqe* uring_get_sqe(event_loop_t *loop) {
+    struct io_uring_sqe *sqe = io_uring_get_sqe(&loop->ring);
+
+    if (!sqe) {
+        io_uring_submit(&loop->ring);
+        sqe = io_uring_get_sqe(&loop->ring);
+    }
+
+    return sqe;
+}
+
+/* Internal: Create the ring and its provided receive buffers */
+static int uring_setup(event_loop_t *loop) {
+    int ret = io_uring_queue_init(URING_ENTRIES, &loop->ring, 0);
+
+    if (ret < 0) {
+        LOG_DEBUG("io_uring_queue_init failed: %s", strerror(-ret));
+        return EVENT_LOOP_ERROR_SYSTEM;
+    }
+    loop->ring_ready = 1;
+
+    /* Multishot recv picks a buffer per completion, so idle connections
+     * pin no receive memory */
+    loop->recv_buffers = malloc((size_t)URING_RECV_BUFFERS * URING_RECV_BUFFER_SIZE);
+    loop->buf_ring = loop->recv_buffers
+                         ? io_uring_setup_buf_ring(&loop->ring, URING_RECV_BUFFERS,
+                                                   URING_BUFFER_GROUP, 0, &ret)
+                         : NULL;
+    if (!loop->buf_ring) {
+        LOG_DEBUG("io_uring buffer ring setup failed: %s", strerror(-ret));
+        uring_teardown(loop);
+        return EVENT_LOOP_ERROR_SYSTEM;
+    }
+
+    for (int i = 0; i < URING_RECV_BUFFERS; i++) {
+        io_uring_buf_ring_add(loop->buf_ring,
+                              loop->recv_buffers + (size_t)i * URING_RECV_BUFFER_SIZE,
+                              URING_RECV_BUFFER_SIZE, (unsigned short)i,
+                              io_uring_buf_ring_mask(URING_RECV_BUFFERS), i);
+    }
+    io_uring_buf_ring_advance(loop->buf_ring, URING_RECV_BUFFERS);
+
+    return EVENT_LOOP_SUCCESS;
+}
+
+/* Internal: Release the ring once every queue node is back */
+static void uring_teardown(event_loop_t *loop) {
+    uint64_t give_up = loop_now_ms() + URING_DRAIN_MS;
+
+    if (!loop->ring_ready) return;
+
+    /* Send nodes are freed by their completions; cancellation of closed
+     * descriptors has already been submitted */
+    while (loop->sends_in_flight > 0 && loop_now_ms() < give_up) {
+        struct io_uring_cqe *cqe;
+        struct __kernel_timespec ts = { .tv_sec = 0, .tv_nsec = 10 * 1000000LL };
+
+        if (io_uring_wait_cqe_timeout(&loop->ring, &cqe, &ts) < 0) continue;
+
+        uring_completion_t completion = { cqe->user_data, cqe->res, cqe->flags };
+        io_uring_cqe_seen(&loop->ring, cqe);
+        uring_complete(loop, &completion);
+    }
+
+    if (loop->sends_in_flight > 0) {
+        LOG_DEBUG("%u io_uring sends still in flight at teardown", loop->sends_in_flight);
+    }
+
+    if (loop->buf_ring) {
+        io_uring_free_buf_ring(&loop->ring, loop->buf_ring, URING_RECV_BUFFERS,
+                               URING_BUFFER_GROUP);
+    }
+    io_uring_queue_exit(&loop->ring);
+    loop->ring_ready = 0;
+
+    free(loop->recv_buffers);
+    loop->recv_buffers = NULL;
+}
+
+/* Internal: Arm a multishot recv into the buffer ring */
+static int uring_arm_recv(event_loop_t *loop, int fd) {
+    struct io_uring_sqe *sqe = uring_get_sqe(loop);
+
+    if (!sqe) return EVENT_LOOP_ERROR_SYSTEM;
+
+    io_uring_prep_recv_multishot(sqe, fd, NULL, 0, 0);
+    sqe->flags |= IOSQE_BUFFER_SELECT;
+    sqe->buf_group = URING_BUFFER_GROUP;
+    io_uring_sqe_set_data64(sqe, uring_tag(loop, fd, URING_TAG_RECV));
+
+    return EVENT_LOOP_SUCCESS;
+}
+
+/* Internal: Arm a multishot poll (listener, wakeup and reap descriptors) */
+static int uring_arm_poll(event_loop_t *loop, int fd) {
+    struct io_uring_sqe *sqe = uring_get_sqe(loop);
+
+    if (!sqe) return EVENT_LOOP_ERROR_SYSTEM;
+
+    io_uring_prep_poll_multishot(sqe, fd, POLLIN);
+    io_uring_sqe_set_data64(sqe, uring_tag(loop, fd, URING_TAG_POLL));
+
+    return EVENT_LOOP_SUCCESS;
+}
+
+/* Internal: Start the backend's I/O on a new entry */
+static int uring_watch(event_loop_t *loop, int fd) {
+    loop_entry_t *entry = &loop->entries[fd];
+
+    if (entry->kind != ENTRY_CONNECTION) {
+        return uring_arm_poll(loop, fd);
+    }
+
+    /* The ring owns the socket: reads arrive as completions and writes
+     * leave as queued sends */
+    set_connection_staged_input(entry->conn, 1);
+    set_connection_send_hook(entry->conn, uring_queue_send, loop);
+
+    return uring_arm_recv(loop, fd);
+}
+
+/* Internal: Cancel everything outstanding on a descriptor */
+static void uring_unwatch(event_loop_t *loop, int fd) {
+    loop_entry_t *entry = &loop->entries[fd];
+    struct io_uring_sqe *sqe;
+
+    /* Records never submitted die with the connection */
+    while (entry->tx_head) {
+        uring_send_t *node = entry->tx_head;
+        entry->tx_head = node->next;
+        free(node);
+    }
+    entry->tx_tail = NULL;
+
+    if (entry->kind == ENTRY_CONNECTION) {
+        set_connection_send_hook(entry->conn, NULL, NULL);
+    }
+
+    /* Submit now: the descriptor is closed right after this returns.
+     * Kernels without fd cancellation end the recv on shutdown() instead */
+    sqe = uring_get_sqe(loop);
+    if (sqe) {
+        io_uring_prep_cancel_fd(sqe, fd, IORING_ASYNC_CANCEL_ALL);
+        io_uring_sqe_set_data64(sqe, URING_TAG_CANCEL);
+        io_uring_submit(&loop->ring);
+    }
+}
+
+/* Internal: Send hook; queue one encrypted record for the next flush */
+static int uring_queue_send(void *ctx, connection_t *conn,
+                            const unsigned char *data, size_t len) {
+    event_loop_t *loop = (event_loop_t*)ctx;
+    int fd = get_connection_socket(conn);
+    loop_entry_t *entry;
+    uring_send_t *node;
+
+    if (fd < 0 || fd >= loop->entries_cap) return -1;
+    entry = &loop->entries[fd];
+    entry->last_tx_ms = loop->now_ms;
+
+    node = malloc(sizeof(uring_send_t) + len);
+    if (!node) return -1;
+
+    node->next = NULL;
+    node->fd = fd;
+    node->generation = entry->generation;
+    node->len = len;
+    memcpy(node->data, data, len);
+
+    if (entry->tx_tail) {
+        entry->tx_tail->next = node;
+    } else {
+        entry->tx_head = node;
+    }
+    entry->tx_tail = node;
+
+    /* Cannot defer; submit on the spot */
+    if (mark_dirty(loop, fd) < 0 && entry->tx_inflight == 0) {
+        uring_flush_sends(loop, fd);
+    }
+
+    return (int)len;
+}
+
+/* Internal: Submit a connection's queued records as one linked chain */
+static void uring_flush_sends(event_loop_t *loop, int fd) {
+    loop_entry_t *entry = &loop->entries[fd];
+    unsigned count = 0;
+
+    for (uring_send_t *node = entry->tx_head; node && count < URING_MAX_CHAIN;
+         node = node->next) {
+        count++;
+    }
+    if (count == 0) return;
+
+    /* A chain split across two submissions loses its ordering */
+    if (io_uring_sq_space_left(&loop->ring) < count) {
+        io_uring_submit(&loop->ring);
+    }
+
+    for (unsigned i = 0; i < count; i++) {
+        uring_send_t *node = entry->tx_head;
+        struct io_uring_sqe *sqe = io_uring_get_sqe(&loop->ring);
+
+        entry->tx_head = node->next;
+
+        /* MSG_WAITALL makes the kernel finish short sends before the
+         * next link starts */
+        io_uring_prep_send(sqe, fd, node->data, node->len, MSG_WAITALL | MSG_NOSIGNAL);
+        io_uring_sqe_set_data(sqe, node);
+        if (i + 1 < count) {
+            sqe->flags |= IOSQE_IO_LINK;
+        }
+
+        entry->tx_inflight++;
+        loop->sends_in_flight++;
+        loop->stats.sends++;
+    }
+
+    if (!entry->tx_head) entry->tx_tail = NULL;
+    loop->stats.send_batches++;
+}
+
+/* Internal: Submit every connection whose previous chain has completed */
+static void uring_flush_dirty(event_loop_t *loop) {
+    int kept = 0;
+
+    for (int i = 0; i < loop->tx_dirty_count; i++) {
+        int fd = loop->tx_dirty[i];
+        loop_entry_t *entry = &loop->entries[fd];
+
+        if (entry->kind != ENTRY_CONNECTION || !entry->tx_head) {
+            entry->tx_dirty = 0;
+        } else if (entry->tx_inflight > 0) {
+            /* One chain at a time keeps records in order */
+            loop->tx_dirty[kept++] = fd;
+        } else {
+            uring_flush_sends(loop, fd);
+            if (entry->tx_head) {
+                loop->tx_dirty[kept++] = fd;
+            } else {
+                entry->tx_dirty = 0;
+            }
+        }
+    }
+
+    loop->tx_dirty_count = kept;
+}
+
+/* Internal: Submit, wait for completions and dispatch them */
+static int uring_dispatch(event_loop_t *loop, int wait_ms) {
+    struct io_uring_cqe *cqes[MAX_EVENTS_PER_WAIT];
+    struct io_uring_cqe *cqe;
+    struct __kernel_timespec ts;
+    unsigned count;
+    int ret;
+
+    /* Queued records, re-armed recvs and the wait share one io_uring_enter */
+    uring_flush_dirty(loop);
+
+    ts.tv_sec = wait_ms > 0 ? wait_ms / 1000 : 0;
+    ts.tv_nsec = wait_ms > 0 ? (long long)(wait_ms % 1000) * 1000000LL : 0;
+
+    ret = io_uring_submit_and_wait_timeout(&loop->ring, &cqe, 1,
+                                           wait_ms >= 0 ? &ts : NULL, NULL);
+    if (ret < 0 && ret != -ETIME && ret != -EINTR) {
+        LOG_ERROR("io_uring_submit_and_wait_timeout failed: %s", strerror(-ret));
+        return EVENT_LOOP_ERROR_SYSTEM;
+    }
+    loop->now_ms = loop_now_ms();
+
+    /* Copy the batch out before dispatch: handlers submit new work whose
+     * completions must not land in slots that are still unread */
+    count = io_uring_peek_batch_cqe(&loop->ring, cqes, MAX_EVENTS_PER_WAIT);
+    for (unsigned i = 0; i < count; i++) {
+        loop->completions[i].user_data = cqes[i]->user_data;
+        loop->completions[i].res = cqes[i]->res;
+        loop->completions[i].flags = cqes[i]->flags;
+    }
+    io_uring_cq_advance(&loop->ring, count);
+
+    loop->stats.wakeups++;
+    loop->stats.events += count;
+
+    for (unsigned i = 0; i < count; i++) {
+        uring_complete(loop, &loop->completions[i]);
+    }
+
+    /* Replies written by callbacks leave now rather than next wakeup */
+    uring_flush_dirty(loop);
+    io_uring_submit(&loop->ring);
+
+    return (int)count;
+}
+
+/* Internal: A linked send finished */
+static void uring_send_done(event_loop_t *loop, uring_send_t *node, int res) {
+    int fd = node->fd;
+    int complete = res >= 0 && (size_t)res == node->len;
+    loop_entry_t *entry = fd < loop->entries_cap ? &loop->entries[fd] : NULL;
+
+    if (entry && (entry->kind != ENTRY_CONNECTION || entry->closing ||
+                  entry->generation != node->generation)) {
+        entry = NULL;
+    }
+
+    loop->sends_in_flight--;
+    free(node);
+
+    if (!entry) return;
+    entry->tx_inflight--;
+
+    /* A failed link cancels the rest of its chain (-ECANCELED) */
+    if (!complete) {
+        LOG_DEBUG("Send on fd %d failed: %s", fd,
+                  res < 0 ? strerror(-res) : "short write");
+        abort_entry(loop, fd, PROTOCOL_ERROR_NETWORK);
+    }
+}
+
+/* Internal: Dispatch one completion */
+static void uring_complete(event_loop_t *loop, const uring_completion_t *completion) {
+    int tag = (int)(completion->user_data & URING_TAG_MASK);
+    int res = completion->res;
+    unsigned flags = completion->flags;
+    loop_entry_t *entry;
+    int fd;
+
+    if (tag == URING_TAG_SEND) {
+        uring_send_done(loop, (uring_send_t*)(uintptr_t)completion->user_data, res);
+        return;
+    }
+
+    if (tag == URING_TAG_CANCEL) return;
+
+    entry = uring_entry(loop, completion->user_data);
+    fd = (int)(completion->user_data >> 32);
+
+    if (tag == URING_TAG_POLL) {
+        if (!entry) return;
+
+        /* Leaving the loop: the cancelled poll's last completion ends it */
+        if (entry->detaching) {
+            if (!(flags & IORING_CQE_F_MORE)) entry->io_ended = 1;
+            return;
+        }
+
+        if (entry->kind == ENTRY_WAKE) {
+            uint64_t count;
+            ssize_t ignored = read(fd, &count, sizeof(count));
+            (void)ignored;
+        } else if (entry->kind == ENTRY_LISTENER) {
+            accept_clients(loop, fd);
+        } else if (entry->kind == ENTRY_REAP) {
+            network_reap_closed();
+        }
+
+        entry = uring_entry(loop, completion->user_data);
+        if (entry && !(flags & IORING_CQE_F_MORE)) uring_arm_poll(loop, fd);
+        return;
+    }
+
+    /* URING_TAG_RECV: copy out and hand the buffer straight back */
+    if (flags & IORING_CQE_F_BUFFER) {
+        unsigned short bid = (unsigned short)(flags >> IORING_CQE_BUFFER_SHIFT);
+        unsigned char *buffer = loop->recv_buffers + (size_t)bid * URING_RECV_BUFFER_SIZE;
+
+        if (entry && res > 0 &&
+            stage_connection_input(entry->conn, buffer, (size_t)res) != NETWORK_SUCCESS) {
+            res = -ENOMEM;
+        }
+
+        io_uring_buf_ring_add(loop->buf_ring, buffer, URING_RECV_BUFFER_SIZE, bid,
+                              io_uring_buf_ring_mask(URING_RECV_BUFFERS), 0);
+        io_uring_buf_ring_advance(loop->buf_ring, 1);
+    }
+
+    if (!entry) return;
+
+    /* Leaving the loop: input stays staged for whoever takes the
+     * connection, and nothing is read after the last completion */
+    if (entry->detaching) {
+        if (!(flags & IORING_CQE_F_MORE)) entry->io_ended = 1;
+        return;
+    }
+
+    if (res == -ENOBUFS || res == -ECANCELED) {
+        /* Ring ran dry, buffers return as this batch is processed; or the
+         * thread that armed the read exited (a stopped worker) and the
+         * kernel dropped it. The socket is fine either way */
+        uring_arm_recv(loop, fd);
+        return;
+    }
+
+    if (res <= 0) {
+        abort_entry(loop, fd, res == 0 ? PROTOCOL_ERROR_CLOSED : PROTOCOL_ERROR_NETWORK);
+        return;
+    }
+
+    if (entry->hs) {
+        drive_handshake(loop, fd);
+    } else {
+        drain_messages(loop, fd);
+    }
+
+    entry = uring_entry(loop, completion->user_data);
+    if (entry && !(flags & IORING_CQE_F_MORE)) uring_arm_recv(loop, fd);
+}
+
+/* Internal: Finish a descriptor's sends and end its multishot read or
+ * poll so it can leave the loop. Other descriptors' completions are
+ * dispatched as usual while waiting */
+static int uring_detach(event_loop_t *loop, int fd, int timeout_ms) {
+    connection_t *conn = loop->entries[fd].conn;
+    uint64_t give_up = loop_now_ms() + (uint64_t)(timeout_ms > 0 ? timeout_ms : 0);
+    int cancelled = 0;
+
+    loop->entries[fd].detaching = 1;
+
+    for (;;) {
+        /* Callbacks may grow the table or close the connection */
+        loop_entry_t *entry = &loop->entries[fd];
+        struct io_uring_cqe *cqe;
+        struct __kernel_timespec ts = { .tv_sec = 0, .tv_nsec = 10 * 1000000LL };
+
+        if (entry->conn != conn || !entry->detaching) {
+            return EVENT_LOOP_ERROR_SYSTEM;
+        }
+
+        /* One chain at a time keeps records in order */
+        if (entry->tx_head && entry->tx_inflight == 0) {
+            uring_flush_sends(loop, fd);
+        }
+
+        /* Output is out; now stop reading */
+        if (!entry->tx_head && entry->tx_inflight == 0) {
+            if (entry->io_ended) {
+                return EVENT_LOOP_SUCCESS;
+            }
+            if (!cancelled) {
+                struct io_uring_sqe *sqe = uring_get_sqe(loop);
+
+                if (sqe) {
+                    io_uring_prep_cancel_fd(sqe, fd, IORING_ASYNC_CANCEL_ALL);
+                    io_uring_sqe_set_data64(sqe, URING_TAG_CANCEL);
+                    cancelled = 1;
+                }
+            }
+        }
+
+        if (loop_now_ms() >= give_up) {
+            LOG_WARNING("Descriptor %d did not leave the loop in time, closing", fd);
+            release_entry(loop, fd, PROTOCOL_ERROR_TIMEOUT, 1);
+            return EVENT_LOOP_ERROR_SYSTEM;
+        }
+
+        io_uring_submit(&loop->ring);
+        if (io_uring_wait_cqe_timeout(&loop->ring, &cqe, &ts) < 0) continue;
+
+        uring_completion_t completion = { cqe->user_data, cqe->res, cqe->flags };
+        io_uring_cqe_seen(&loop->ring, cqe);
+        uring_complete(loop, &completion);
+    }
+}
+
+#endif /* EVENT_LOOP_URING */
+
+#else /* !__linux__ */
+
+/* Reactor backends other than epoll are not implemented yet */
+event_loop_t* event_loop_create(const char *password,
+                                const event_loop_callbacks_t *callbacks,
+                                int max_connections) {
+    (void)password;
+    (void)callbacks;
+    (void)max_connections;
+    LOG_WARNING("Event loop is not supported on this platform");
+    return NULL;
+}
+
+event_loop_t* event_loop_create_backend(const char *password,
+                                        const event_loop_callbacks_t *callbacks,
+                                        int max_connections,
+                                        event_loop_backend_t backend) {
+    (void)backend;
+    return event_loop_create(password, callbacks, max_connections);
+}
+
+void event_loop_destroy(event_loop_t *loop) {
+    (void)loop;
+}
+
+int event_loop_add_listener(event_loop_t *loop, connection_t *listener) {
+    (void)loop;
+    (void)listener;
+    return EVENT_LOOP_ERROR_UNSUPPORTED;
+}
+
+int event_loop_add_connection(event_loop_t *loop, connection_t *conn, int is_server) {
+    (void)loop;
+    (void)conn;
+    (void)is_server;
+    return EVENT_LOOP_ERROR_UNSUPPORTED;
+}
+
+void event_loop_close_connection(event_loop_t *loop, connection_t *conn) {
+    (void)loop;
+    (void)conn;
+}
+
+int event_loop_adopt_connection(event_loop_t *loop, connection_t *conn) {
+    (void)loop;
+    (void)conn;
+    return EVENT_LOOP_ERROR_UNSUPPORTED;
+}
+
+int event_loop_detach_connection(event_loop_t *loop, connection_t *conn, int timeout_ms) {
+    (void)loop;
+    (void)conn;
+    (void)timeout_ms;
+    return EVENT_LOOP_ERROR_UNSUPPORTED;
+}
+
+int event_loop_run_once(event_loop_t *loop, int timeout_ms) {
+    (void)loop;
+    (void)timeout_ms;
+    return EVENT_LOOP_ERROR_UNSUPPORTED;
+}
+
+int event_loop_run(event_loop_t *loop) {
+    (void)loop;
+    return EVENT_LOOP_ERROR_UNSUPPORTED;
+}
+
+void event_loop_stop(event_loop_t *loop) {
+    (void)loop;
+}
+
+int event_loop_set_timeouts(event_loop_t *loop, int idle_timeout_ms, int keepalive_ms) {
+    (void)loop;
+    (void)idle_timeout_ms;
+    (void)keepalive_ms;
+    return EVENT_LOOP_ERROR_UNSUPPORTED;
+}
+
+event_loop_handle_t event_loop_get_handle(const event_loop_t *loop, connection_t *conn) {
+    (void)loop;
+    (void)conn;
+    return EVENT_LOOP_INVALID_HANDLE;
+}
+
+connection_t* event_loop_lookup(const event_loop_t *loop, event_loop_handle_t handle) {
+    (void)loop;
+    (void)handle;
+    return NULL;
+}
+
+int event_loop_for_each(event_loop_t *loop, event_loop_visit_t visit, void *ctx) {
+    (void)loop;
+    (void)visit;
+    (void)ctx;
+    return EVENT_LOOP_ERROR_UNSUPPORTED;
+}
+
+int event_loop_broadcast(event_loop_t *loop, message_type_t type,
+                         const unsigned char *payload, size_t payload_len,
+                         connection_t *except) {
+    (void)loop;
+    (void)type;
+    (void)payload;
+    (void)payload_len;
+    (void)except;
+    return EVENT_LOOP_ERROR_UNSUPPORTED;
+}
+
+event_loop_stats_t event_loop_get_stats(const event_loop_t *loop) {
+    event_loop_stats_t stats = {0};
+    (void)loop;
+    return stats;
+}
+
+event_loop_backend_t event_loop_get_backend(const event_loop_t *loop) {
+    (void)loop;
+    return EVENT_LOOP_BACKEND_EPOLL;
+}
+
+#endif /* __linux__ */
+
+/* Get backend name */
+const char* event_loop_backend_name(event_loop_backend_t backend) {
+    switch (backend) {
+        case EVENT_LOOP_BACKEND_AUTO:
+            return "auto";
+        case EVENT_LOOP_BACKEND_EPOLL:
+            return "epoll";
+        case EVENT_LOOP_BACKEND_IO_URING:
+            return "io_uring";
+        default:
+            return "unknown";
+    }
+}
+
+/* Get error message */
+const char* event_loop_strerror(int error_code) {
+    switch (error_code) {
+        case EVENT_LOOP_SUCCESS:
+            return "Success";
+        case EVENT_LOOP_ERROR_PARAM:
+            return "Invalid parameter";
+        case EVENT_LOOP_ERROR_MEMORY:
+            return "Memory allocation failed";
+        case EVENT_LOOP_ERROR_SYSTEM:
+            return "System call failed";
+        case EVENT_LOOP_ERROR_UNSUPPORTED:
+            return "Not supported on this platform";
+        case EVENT_LOOP_ERROR_LIMIT:
+            return "Connection limit reached";
+        default:
+            return "Unknown error";
+    }
+}
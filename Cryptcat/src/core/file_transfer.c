@@ -8,19 +8,44 @@
 #include "file_transfer.h"
 #include "protocol.h"
 #include "crypto.h"
+#include "platform.h"
+#include "uring_io.h"
+#include "ktls.h"
+#include "integrity.h"
+#include "stripe.h"
 #include "utils/logger.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <errno.h>
+#include <ctype.h>
 #include <openssl/sha.h>
 
 /* File transfer constants */
 #define DEFAULT_CHUNK_SIZE 16384     /* 16KB chunks */
 #define MAX_CHUNK_SIZE 65536         /* 64KB max chunk size */
 #define MAX_FILENAME_LEN 512
-#define TRANSFER_TIMEOUT 30          /* seconds */
+#define START_INFO_LEN (MAX_FILENAME_LEN + 160) /* MSG_FILE_START text */
+#define TRANSFER_TIMEOUT_MS 30000    /* Stall limit, monotonic */
 #define MAX_RETRIES 5
+#define CONTROL_BUFFER_SIZE (MAX_CHUNK_SIZE + sizeof(uint32_t)) /* Largest message read while sending */
+#define DEFERRED_MAX_BYTES (1024 * 1024) /* Queued for the caller before reads pause */
+#define READ_AHEAD_CHUNKS 8          /* io_uring reads kept in flight */
+#define BULK_CHUNK_SIZE (128 * 1024) /* Integrity-only sendfile() chunk */
+#define TAG_NONCE_SIZE 32            /* Per-transfer integrity key nonce */
+#define TAG_KEY_LABEL "cryptcat file tag"
+#define INTEGRITY_MODE_TOKEN "integrity"
+#define STRIPED_MODE_TOKEN "striped"
+#define STRIPE_READY_TIMEOUT_MS 10000 /* Receiver's go-ahead before lanes open */
+
+/* Flow control constants */
+#define INITIAL_WINDOW (256 * 1024)  /* Credit assumed before first update */
+#define MIN_WINDOW (2 * DEFAULT_CHUNK_SIZE)
+#define MAX_WINDOW (16 * 1024 * 1024) /* Receiver credit ceiling */
+#define WINDOW_UPDATE_DIVISOR 4      /* Advertise after 1/4 window consumed */
+#define FLOW_WAIT_MS 50              /* Max wait for credit per call */
+#define RTT_SAMPLE_SLOTS (MAX_WINDOW / DEFAULT_CHUNK_SIZE)
+#define STARTUP_ROUNDS 3             /* Rate plateau rounds to leave startup */
 
 /* Transfer states */
 typedef enum {
@@ -33,19 +58,70 @@ typedef enum {
     TRANSFER_CANCELLED
 } transfer_state_t;
 
+/* Send timestamp of an in-flight chunk (for RTT sampling) */
+typedef struct {
+    uint64_t end_offset;
+    uint64_t sent_ms;
+} flow_sample_t;
+
+/* Credit-based flow control state */
+typedef struct {
+    /* Sender side */
+    uint64_t bytes_acked;           /* Bytes consumed by the receiver */
+    uint64_t credit_limit;          /* Receiver-advertised send limit */
+    uint64_t peer_window;           /* Receiver window at its last update */
+    uint64_t send_window;           /* Autotuned in-flight target (bytes) */
+    uint64_t delivery_rate;         /* Max-filtered delivery rate (bytes/s) */
+    uint64_t full_rate;             /* Rate at last startup growth */
+    uint64_t last_ack_ms;           /* Time of previous window update */
+    uint32_t srtt_ms;               /* Smoothed round-trip time */
+    int startup_rounds;             /* Rounds without rate growth */
+    int in_startup;                 /* Probing for bandwidth */
+    flow_sample_t samples[RTT_SAMPLE_SLOTS];
+    uint32_t sample_head;
+    uint32_t sample_count;
+    
+    /* Receiver side */
+    uint64_t recv_window;           /* Advertised credit beyond consumed */
+    uint64_t last_advertised;       /* Consumed offset at last update */
+    uint64_t window_epoch;          /* Consumed offset at last window growth */
+} flow_control_t;
+
+/* A message read while sending that the transfer does not consume */
+typedef struct deferred_message_s {
+    struct deferred_message_s *next;
+    message_type_t type;
+    size_t len;
+    unsigned char data[];
+} deferred_message_t;
+
 /* File transfer context */
 typedef struct {
     transfer_state_t state;
     char filename[MAX_FILENAME_LEN];
     FILE *file;
+    uring_file_reader_t *reader;    /* io_uring read-ahead (sender, optional) */
+    int use_sendfile;               /* Chunks leave with sendfile() over kernel TLS */
+    int integrity_only;             /* Clear bulk data, tag in MSG_FILE_END */
+    integrity_job_t *tag_job;       /* Sender: tagging threads */
+    stripe_t *stripe;               /* Striped: lanes carry the data */
+    stripe_lane_stats_t lane_stats[STRIPE_MAX_LANES]; /* Kept once lanes close */
+    int lane_count;
+    unsigned char tag_key[INTEGRITY_TAG_SIZE];
     uint64_t file_size;
     uint64_t bytes_transferred;
     uint32_t chunks_sent;
     uint32_t chunks_received;
     time_t start_time;
-    time_t last_activity;
+    uint64_t last_activity_ms;      /* Monotonic */
     unsigned char checksum[SHA256_DIGEST_LENGTH];
     connection_t *conn;
+    flow_control_t flow;
+    unsigned char *chunk_buffer;    /* fread() chunks, allocated on first use */
+    unsigned char *control_buffer;  /* Messages read while sending, likewise */
+    deferred_message_t *deferred;   /* Oldest message queued for the caller */
+    deferred_message_t **deferred_tail;
+    size_t deferred_bytes;
     void *user_data;
 } file_transfer_t;
 
@@ -56,6 +132,27 @@ static int receive_file_chunk_internal(file_transfer_t *transfer,
                                       const unsigned char *chunk_data,
                                       size_t chunk_size, uint32_t chunk_num);
 static void update_transfer_progress(file_transfer_t *transfer);
+static void flow_init(flow_control_t *flow);
+static uint64_t flow_send_limit(const flow_control_t *flow);
+static void flow_record_send(flow_control_t *flow, uint64_t end_offset);
+static void flow_on_update(flow_control_t *flow, uint64_t consumed,
+                          uint64_t credit_limit);
+static int receive_control(file_transfer_t *transfer, int timeout_ms,
+                           message_type_t *type, size_t *payload_len);
+static int defer_message(file_transfer_t *transfer, message_type_t type,
+                         const unsigned char *payload, size_t payload_len);
+static int drain_window_updates(file_transfer_t *transfer, int timeout_ms);
+static int advertise_window(file_transfer_t *transfer, int force);
+static int derive_tag_key(file_transfer_t *transfer, const unsigned char *nonce);
+static int complete_receive(file_transfer_t *transfer, const unsigned char *tag);
+static file_transfer_t* start_send(connection_t *conn, const char *filename,
+                                   file_transfer_mode_t mode, const char *password,
+                                   int lanes);
+static int send_striped(file_transfer_t *transfer);
+static int finish_striped_receive(file_transfer_t *transfer);
+static int wait_for_receiver(file_transfer_t *transfer, int timeout_ms);
+static void retire_stripe(file_transfer_t *transfer);
+static int hex_decode(const char *hex, unsigned char *out, size_t len);
 
 /* Initialize file transfer module */
 int file_transfer_init(void) {
@@ -65,7 +162,32 @@ int file_transfer_init(void) {
 
 /* Start sending a file */
 file_transfer_t* start_file_send(connection_t *conn, const char *filename) {
+    return start_file_send_mode(conn, filename, FILE_TRANSFER_SEALED);
+}
+
+/* Start sending a file in the given mode */
+file_transfer_t* start_file_send_mode(connection_t *conn, const char *filename,
+                                      file_transfer_mode_t mode) {
+    return start_send(conn, filename, mode, NULL, 0);
+}
+
+/* Start sending a file striped over several connections */
+file_transfer_t* start_file_send_striped(connection_t *conn, const char *filename,
+                                         const char *password, int lanes) {
+    if (lanes < 1 || lanes > STRIPE_MAX_LANES) {
+        LOG_ERROR("Invalid lane count: %d", lanes);
+        return NULL;
+    }
+    
+    return start_send(conn, filename, FILE_TRANSFER_SEALED, password, lanes);
+}
+
+/* Internal: Open a file and announce it; lanes > 0 stripes the data */
+static file_transfer_t* start_send(connection_t *conn, const char *filename,
+                                   file_transfer_mode_t mode, const char *password,
+                                   int lanes) {
     file_transfer_t *transfer = NULL;
+    unsigned char nonce[TAG_NONCE_SIZE];
     struct stat file_stat;
     
     if (!conn || !filename) {
@@ -115,32 +237,87 @@ file_transfer_t* start_file_send(connection_t *conn, const char *filename) {
     transfer->bytes_transferred = 0;
     transfer->chunks_sent = 0;
     transfer->start_time = time(NULL);
-    transfer->last_activity = transfer->start_time;
+    transfer->last_activity_ms = platform_coarse_monotonic_ms();
     transfer->conn = conn;
+    flow_init(&transfer->flow);
     
     strncpy(transfer->filename, filename, sizeof(transfer->filename) - 1);
     
-    /* Calculate file checksum */
-    if (calculate_file_checksum(filename, transfer->checksum) != 0) {
+    /* Integrity-only: the tag replaces the up-front checksum pass and is
+     * keyed per transfer, so the receiver needs only the nonce now */
+    if (mode == FILE_TRANSFER_INTEGRITY_ONLY) {
+        transfer->integrity_only = 1;
+        if (crypto_random_bytes(nonce, sizeof(nonce)) != CRYPTO_SUCCESS ||
+            derive_tag_key(transfer, nonce) != FILE_TRANSFER_SUCCESS) {
+            LOG_ERROR("Integrity-only transfer needs an established session");
+            free(transfer);
+            fclose(file);
+            return NULL;
+        }
+    } else if (calculate_file_checksum(filename, transfer->checksum) != 0) {
         LOG_ERROR("Failed to calculate checksum for '%s'", filename);
         free(transfer);
         fclose(file);
         return NULL;
     }
     
+    /* Lanes are sealed like any message; the control connection only
+     * carries the start and end of the transfer */
+    if (lanes > 0) {
+        transfer->stripe = stripe_create(fileno(file), transfer->file_size);
+        if (!transfer->stripe) {
+            free(transfer);
+            fclose(file);
+            return NULL;
+        }
+    }
+    
+    /* Offload record crypto to the kernel while the receiver is idle, so
+     * chunks go out with sendfile() from the page cache; either side may
+     * decline, and the transfer then runs on user-space crypto */
+    if (!transfer->integrity_only && !transfer->stripe && ktls_available() &&
+        !get_connection_compression(conn)) {
+        int result = ktls_enable(conn, KTLS_DEFAULT_TIMEOUT_MS);
+        
+        if (result == KTLS_SUCCESS) {
+            transfer->use_sendfile = 1;
+        } else if (result != KTLS_ERROR_UNSUPPORTED && result != KTLS_ERROR_REJECTED &&
+                   result != KTLS_ERROR_TIMEOUT) {
+            LOG_ERROR("Kernel TLS switch failed: %s", ktls_strerror(result));
+            free(transfer);
+            fclose(file);
+            return NULL;
+        }
+    }
+    
     /* Send file start message */
-    unsigned char start_data[MAX_FILENAME_LEN + 20];
+    unsigned char start_data[START_INFO_LEN];
     size_t data_len = 0;
     
-    /* Format: filename|filesize|checksum */
+    /* Format: filename|filesize|checksum, filename|filesize|nonce|integrity
+     * or filename|filesize|checksum|striped|stripe_id */
     int written = snprintf((char*)start_data, sizeof(start_data),
                           "%s|%lu|", filename, (unsigned long)transfer->file_size);
     
-    /* Append checksum as hex string */
+    /* Append checksum (or tag nonce) as hex string */
     for (int i = 0; i < SHA256_DIGEST_LENGTH; i++) {
         written += snprintf((char*)start_data + written, 
-                           sizeof(start_data) - written,
-                           "%02x", transfer->checksum[i]);
+                           sizeof(start_data) - written, "%02x",
+                           transfer->integrity_only ? nonce[i] : transfer->checksum[i]);
+    }
+    
+    if (transfer->integrity_only) {
+        written += snprintf((char*)start_data + written, sizeof(start_data) - written,
+                            "|%s", INTEGRITY_MODE_TOKEN);
+    } else if (transfer->stripe) {
+        const unsigned char *id = stripe_get_id(transfer->stripe);
+        
+        written += snprintf((char*)start_data + written, sizeof(start_data) - written,
+                            "|%s|", STRIPED_MODE_TOKEN);
+        for (int i = 0; i < STRIPE_ID_SIZE; i++) {
+            written += snprintf((char*)start_data + written,
+                               sizeof(start_data) - written, "%02x", id[i]);
+        }
     }
     
     data_len = written;
@@ -148,14 +325,55 @@ file_transfer_t* start_file_send(connection_t *conn, const char *filename) {
     if (send_message(conn, MSG_FILE_START, start_data, data_len) 
         != PROTOCOL_SUCCESS) {
         LOG_ERROR("Failed to send file start message");
+        crypto_memzero(transfer->tag_key, sizeof(transfer->tag_key));
+        stripe_destroy(transfer->stripe);
         free(transfer);
         fclose(file);
         return NULL;
     }
     
+    /* The receiver's initial credit means its stripe is registered, so
+     * lanes can join; they connect to the address conn reached */
+    if (transfer->stripe) {
+        connection_info_t peer = get_connection_info(conn);
+        int result = wait_for_receiver(transfer, STRIPE_READY_TIMEOUT_MS);
+        
+        if (result == FILE_TRANSFER_SUCCESS) {
+            result = stripe_connect(transfer->stripe, peer.remote_host, peer.remote_port,
+                                    password, lanes);
+        }
+        if (result < 0) {
+            LOG_ERROR("Failed to open lanes for '%s'", filename);
+            cleanup_file_transfer(transfer);
+            return NULL;
+        }
+    }
+    
+    /* Tag the mapped file on other cores while the data is sent */
+    if (transfer->integrity_only) {
+        transfer->tag_job = integrity_start(fileno(file), transfer->file_size,
+                                            transfer->tag_key, sizeof(transfer->tag_key), 0);
+        if (!transfer->tag_job) {
+            LOG_ERROR("Failed to start tagging '%s'", filename);
+            cleanup_file_transfer(transfer);
+            return NULL;
+        }
+    }
+    
+    /* Read ahead through io_uring where available; fread() otherwise.
+     * sendfile() never reads the file in user space at all */
+    if (!transfer->use_sendfile && !transfer->integrity_only && !transfer->stripe) {
+        transfer->reader = uring_file_reader_create(fileno(file), 0, transfer->file_size,
+                                                    DEFAULT_CHUNK_SIZE, READ_AHEAD_CHUNKS);
+    }
+    
     transfer->state = TRANSFER_SENDING;
-    LOG_INFO("Started sending file '%s' (%lu bytes)", filename, 
-             (unsigned long)transfer->file_size);
+    LOG_INFO("Started sending file '%s' (%lu bytes%s)", filename, 
+             (unsigned long)transfer->file_size,
+             transfer->stripe ? ", striped" :
+             transfer->integrity_only ? ", integrity only" :
+             transfer->use_sendfile ? ", kernel TLS sendfile" :
+             transfer->reader ? ", io_uring read-ahead" : "");
     
     return transfer;
 }
@@ -168,7 +386,11 @@ file_transfer_t* start_file_receive(connection_t *conn,
     char *filename = NULL;
     char *filesize_str = NULL;
     char *checksum_str = NULL;
+    char *mode_str = NULL;
+    char *stripe_str = NULL;
     char *saveptr = NULL;
+    unsigned char stripe_id[STRIPE_ID_SIZE];
+    int integrity, striped;
     
     if (!conn || !file_info || info_len == 0) {
         LOG_ERROR("Invalid parameters for file receive");
@@ -176,7 +398,7 @@ file_transfer_t* start_file_receive(connection_t *conn,
     }
     
     /* Parse file information */
-    char info_str[MAX_FILENAME_LEN + 100];
+    char info_str[START_INFO_LEN];
     if (info_len >= sizeof(info_str)) {
         LOG_ERROR("File info too large");
         return NULL;
@@ -185,12 +407,20 @@ file_transfer_t* start_file_receive(connection_t *conn,
     memcpy(info_str, file_info, info_len);
     info_str[info_len] = '\0';
     
-    /* Parse: filename|filesize|checksum */
+    /* Parse: filename|filesize|checksum[|mode[|stripe_id]] */
     filename = strtok_r(info_str, "|", &saveptr);
     filesize_str = strtok_r(NULL, "|", &saveptr);
     checksum_str = strtok_r(NULL, "|", &saveptr);
+    mode_str = strtok_r(NULL, "|", &saveptr);
+    stripe_str = strtok_r(NULL, "|", &saveptr);
+    
+    integrity = mode_str && strcmp(mode_str, INTEGRITY_MODE_TOKEN) == 0;
+    striped = mode_str && strcmp(mode_str, STRIPED_MODE_TOKEN) == 0;
     
-    if (!filename || !filesize_str || !checksum_str) {
+    if (!filename || !filesize_str || !checksum_str ||
+        (mode_str && !integrity && !striped) ||
+        (striped ? !stripe_str || hex_decode(stripe_str, stripe_id, STRIPE_ID_SIZE) != 0
+                 : stripe_str != NULL)) {
         LOG_ERROR("Invalid file info format");
         return NULL;
     }
@@ -204,22 +434,17 @@ file_transfer_t* start_file_receive(connection_t *conn,
     
     /* Parse checksum */
     unsigned char expected_checksum[SHA256_DIGEST_LENGTH];
-    if (strlen(checksum_str) != SHA256_DIGEST_LENGTH * 2) {
+    if (hex_decode(checksum_str, expected_checksum, SHA256_DIGEST_LENGTH) != 0) {
         LOG_ERROR("Invalid checksum length");
         return NULL;
     }
     
-    for (int i = 0; i < SHA256_DIGEST_LENGTH; i++) {
-        char hex[3] = {checksum_str[i * 2], checksum_str[i * 2 + 1], '\0'};
-        expected_checksum[i] = strtol(hex, NULL, 16);
-    }
-    
     /* Create output filename (add .part extension during transfer) */
     char output_filename[MAX_FILENAME_LEN + 10];
     snprintf(output_filename, sizeof(output_filename), "%s.part", filename);
     
-    /* Open file for writing */
-    FILE *file = fopen(output_filename, "wb");
+    /* Open file for writing (and reading, to map it for the tag check) */
+    FILE *file = fopen(output_filename, integrity ? "w+b" : "wb");
     if (!file) {
         LOG_ERROR("Failed to create file '%s': %s", output_filename, 
                  strerror(errno));
@@ -240,14 +465,45 @@ file_transfer_t* start_file_receive(connection_t *conn,
     transfer->bytes_transferred = 0;
     transfer->chunks_received = 0;
     transfer->start_time = time(NULL);
-    transfer->last_activity = transfer->start_time;
+    transfer->last_activity_ms = platform_coarse_monotonic_ms();
     transfer->conn = conn;
     
     strncpy(transfer->filename, filename, sizeof(transfer->filename) - 1);
-    memcpy(transfer->checksum, expected_checksum, SHA256_DIGEST_LENGTH);
+    flow_init(&transfer->flow);
+    
+    /* Integrity-only: the checksum field carries the tag key nonce */
+    if (integrity) {
+        transfer->integrity_only = 1;
+        if (derive_tag_key(transfer, expected_checksum) != FILE_TRANSFER_SUCCESS) {
+            LOG_ERROR("Integrity-only transfer needs an established session");
+            fclose(file);
+            remove(output_filename);
+            free(transfer);
+            return NULL;
+        }
+    } else {
+        memcpy(transfer->checksum, expected_checksum, SHA256_DIGEST_LENGTH);
+    }
+    
+    /* Lanes write at offsets from their own threads; registered before
+     * the initial credit below tells the sender to open them */
+    if (striped) {
+        transfer->stripe = stripe_expect(fileno(file), file_size, stripe_id);
+        if (!transfer->stripe) {
+            fclose(file);
+            remove(output_filename);
+            free(transfer);
+            return NULL;
+        }
+    }
+    
+    /* Grant the sender its initial credit explicitly */
+    if (advertise_window(transfer, 1) != FILE_TRANSFER_SUCCESS) {
+        LOG_WARNING("Failed to send initial window update");
+    }
     
-    LOG_INFO("Started receiving file '%s' (%lu bytes)", filename, 
-             (unsigned long)file_size);
+    LOG_INFO("Started receiving file '%s' (%lu bytes%s)", filename, 
+             (unsigned long)file_size, striped ? ", striped" : "");
     
     return transfer;
 }
@@ -258,8 +514,8 @@ int process_file_transfer(file_transfer_t *transfer) {
         return FILE_TRANSFER_ERROR_PARAM;
     }
     
-    /* Check for timeout */
-    if (time(NULL) - transfer->last_activity > TRANSFER_TIMEOUT) {
+    /* Check for a stall; wall-clock steps must not fake or hide one */
+    if (platform_coarse_monotonic_ms() - transfer->last_activity_ms > TRANSFER_TIMEOUT_MS) {
         LOG_ERROR("File transfer timeout");
         transfer->state = TRANSFER_ERROR;
         return FILE_TRANSFER_ERROR_TIMEOUT;
@@ -268,7 +524,8 @@ int process_file_transfer(file_transfer_t *transfer) {
     /* Process based on state */
     switch (transfer->state) {
         case TRANSFER_SENDING:
-            return send_file_chunk_internal(transfer);
+            return transfer->stripe ? send_striped(transfer)
+                                    : send_file_chunk_internal(transfer);
             
         case TRANSFER_RECEIVING:
             /* Receiving is handled by receive_file_chunk() */
@@ -288,68 +545,190 @@ int process_file_transfer(file_transfer_t *transfer) {
     }
 }
 
-/* Send a file chunk */
+/* Send file chunks while the receiver's credit allows */
 static int send_file_chunk_internal(file_transfer_t *transfer) {
-    unsigned char chunk_data[MAX_CHUNK_SIZE];
-    size_t bytes_read;
+    const unsigned char *chunk;
+    size_t bytes_read, want;
     uint32_t chunk_num;
+    int result;
     
     if (!transfer || !transfer->file) {
         return FILE_TRANSFER_ERROR_PARAM;
     }
     
-    /* Check if transfer is complete */
-    if (transfer->bytes_transferred >= transfer->file_size) {
-        /* Send file end message */
-        if (send_message(transfer->conn, MSG_FILE_END, transfer->checksum, 
-                        SHA256_DIGEST_LENGTH) != PROTOCOL_SUCCESS) {
-            LOG_ERROR("Failed to send file end message");
+    /* Pick up credit the receiver has advertised since the last call */
+    result = drain_window_updates(transfer, 0);
+    if (result != FILE_TRANSFER_SUCCESS) {
+        return result;
+    }
+    
+    while (transfer->bytes_transferred < transfer->file_size) {
+        want = transfer->integrity_only ? BULK_CHUNK_SIZE : DEFAULT_CHUNK_SIZE;
+        if (transfer->file_size - transfer->bytes_transferred < want) {
+            want = transfer->file_size - transfer->bytes_transferred;
+        }
+        
+        /* Bulk chunks shrink to the credit left rather than wait for more */
+        if (transfer->integrity_only && want > DEFAULT_CHUNK_SIZE &&
+            transfer->bytes_transferred + want > flow_send_limit(&transfer->flow) &&
+            flow_send_limit(&transfer->flow) >= 
+                transfer->bytes_transferred + DEFAULT_CHUNK_SIZE) {
+            want = flow_send_limit(&transfer->flow) - transfer->bytes_transferred;
+        }
+        
+        /* Window exhausted: wait briefly for credit instead of spinning */
+        if (transfer->bytes_transferred + want > flow_send_limit(&transfer->flow)) {
+            result = drain_window_updates(transfer, FLOW_WAIT_MS);
+            if (result != FILE_TRANSFER_SUCCESS) {
+                return result;
+            }
+            
+            if (transfer->bytes_transferred + want > 
+                flow_send_limit(&transfer->flow)) {
+                return FILE_TRANSFER_IN_PROGRESS;
+            }
+            continue;
+        }
+        
+        /* Kernel TLS or integrity-only: the chunk goes from the page cache
+         * to the socket */
+        if (transfer->use_sendfile || transfer->integrity_only) {
+            int status;
+            
+            chunk_num = transfer->chunks_sent;
+            if (transfer->integrity_only) {
+                status = send_file_bulk(transfer->conn, fileno(transfer->file),
+                                        transfer->bytes_transferred, want, chunk_num);
+            } else {
+                status = send_file_chunk_from_fd(transfer->conn, fileno(transfer->file),
+                                                 transfer->bytes_transferred, want, chunk_num);
+            }
+            if (status != PROTOCOL_SUCCESS) {
+                LOG_ERROR("Failed to send file chunk %u", chunk_num);
+                transfer->state = TRANSFER_ERROR;
+                return FILE_TRANSFER_ERROR_NETWORK;
+            }
+            
+            transfer->bytes_transferred += want;
+            transfer->chunks_sent++;
+            transfer->last_activity_ms = platform_coarse_monotonic_ms();
+            flow_record_send(&transfer->flow, transfer->bytes_transferred);
+            update_transfer_progress(transfer);
+            continue;
+        }
+        
+        /* Read next chunk (already in flight when reading ahead) */
+        if (transfer->reader) {
+            int status = uring_file_reader_next(transfer->reader, &chunk, &bytes_read);
+            if (status == URING_IO_EOF) {
+                /* File shrank underneath us; finish with what was sent */
+                break;
+            } else if (status != URING_IO_SUCCESS) {
+                LOG_ERROR("Error reading from file: %s", uring_io_strerror(status));
+                transfer->state = TRANSFER_ERROR;
+                return FILE_TRANSFER_ERROR_IO;
+            }
+        } else {
+            if (!transfer->chunk_buffer) {
+                transfer->chunk_buffer = malloc(MAX_CHUNK_SIZE);
+                if (!transfer->chunk_buffer) {
+                    LOG_ERROR("Memory allocation failed");
+                    transfer->state = TRANSFER_ERROR;
+                    return FILE_TRANSFER_ERROR_IO;
+                }
+            }
+            
+            bytes_read = fread(transfer->chunk_buffer, 1, want, transfer->file);
+            if (bytes_read == 0) {
+                if (feof(transfer->file)) {
+                    /* File shrank underneath us; finish with what was sent */
+                    break;
+                }
+                LOG_ERROR("Error reading from file: %s", strerror(errno));
+                transfer->state = TRANSFER_ERROR;
+                return FILE_TRANSFER_ERROR_IO;
+            }
+            chunk = transfer->chunk_buffer;
+        }
+        
+        /* Send chunk */
+        chunk_num = transfer->chunks_sent;
+        if (send_file_chunk(transfer->conn, chunk, bytes_read, chunk_num) 
+            != PROTOCOL_SUCCESS) {
+            LOG_ERROR("Failed to send file chunk %u", chunk_num);
             transfer->state = TRANSFER_ERROR;
             return FILE_TRANSFER_ERROR_NETWORK;
         }
         
-        fclose(transfer->file);
-        transfer->file = NULL;
-        transfer->state = TRANSFER_COMPLETE;
-        
-        LOG_INFO("File '%s' sent successfully (%lu bytes, %u chunks)",
-                 transfer->filename, (unsigned long)transfer->file_size,
-                 transfer->chunks_sent);
+        /* Update transfer state */
+        transfer->bytes_transferred += bytes_read;
+        transfer->chunks_sent++;
+        transfer->last_activity_ms = platform_coarse_monotonic_ms();
+        flow_record_send(&transfer->flow, transfer->bytes_transferred);
         
-        return FILE_TRANSFER_SUCCESS;
+        /* Update progress display */
+        update_transfer_progress(transfer);
     }
     
-    /* Read next chunk */
-    bytes_read = fread(chunk_data, 1, DEFAULT_CHUNK_SIZE, transfer->file);
-    if (bytes_read == 0) {
-        if (feof(transfer->file)) {
-            /* End of file reached */
-            return send_file_chunk_internal(transfer);
-        } else {
-            LOG_ERROR("Error reading from file: %s", strerror(errno));
+    /* Integrity-only: the tag is ready once the threads are done */
+    if (transfer->tag_job) {
+        int status = integrity_finish(transfer->tag_job, transfer->checksum);
+        
+        transfer->tag_job = NULL;
+        crypto_memzero(transfer->tag_key, sizeof(transfer->tag_key));
+        if (status != INTEGRITY_SUCCESS) {
+            LOG_ERROR("Failed to tag '%s': %s", transfer->filename,
+                      integrity_strerror(status));
             transfer->state = TRANSFER_ERROR;
             return FILE_TRANSFER_ERROR_IO;
         }
     }
     
-    /* Send chunk */
-    chunk_num = transfer->chunks_sent;
-    if (send_file_chunk(transfer->conn, chunk_data, bytes_read, chunk_num) 
-        != PROTOCOL_SUCCESS) {
-        LOG_ERROR("Failed to send file chunk %u", chunk_num);
+    /* All data sent: send file end message */
+    if (send_message(transfer->conn, MSG_FILE_END, transfer->checksum, 
+                    SHA256_DIGEST_LENGTH) != PROTOCOL_SUCCESS) {
+        LOG_ERROR("Failed to send file end message");
         transfer->state = TRANSFER_ERROR;
         return FILE_TRANSFER_ERROR_NETWORK;
     }
     
-    /* Update transfer state */
-    transfer->bytes_transferred += bytes_read;
-    transfer->chunks_sent++;
-    transfer->last_activity = time(NULL);
+    uring_file_reader_destroy(transfer->reader);
+    transfer->reader = NULL;
+    fclose(transfer->file);
+    transfer->file = NULL;
+    transfer->state = TRANSFER_COMPLETE;
     
-    /* Update progress display */
-    update_transfer_progress(transfer);
+    LOG_INFO("File '%s' sent successfully (%lu bytes, %u chunks)",
+             transfer->filename, (unsigned long)transfer->file_size,
+             transfer->chunks_sent);
     
-    return FILE_TRANSFER_IN_PROGRESS;
+    return FILE_TRANSFER_SUCCESS;
+}
+
+/* Handle a window update received from the peer */
+int file_transfer_window_update(file_transfer_t *transfer,
+                               const unsigned char *payload,
+                               size_t payload_len) {
+    uint64_t consumed, credit_limit;
+    
+    if (!transfer || !payload) {
+        return FILE_TRANSFER_ERROR_PARAM;
+    }
+    
+    if (parse_window_update(payload, payload_len, &consumed, &credit_limit)
+        != PROTOCOL_SUCCESS) {
+        return FILE_TRANSFER_ERROR_NETWORK;
+    }
+    
+    if (consumed > transfer->bytes_transferred) {
+        LOG_ERROR("Window update acknowledges unsent data");
+        return FILE_TRANSFER_ERROR_ORDER;
+    }
+    
+    flow_on_update(&transfer->flow, consumed, credit_limit);
+    transfer->last_activity_ms = platform_coarse_monotonic_ms();
+    
+    return FILE_TRANSFER_SUCCESS;
 }
 
 /* Receive a file chunk */
@@ -368,6 +747,11 @@ static int receive_file_chunk_internal(file_transfer_t *transfer,
         return FILE_TRANSFER_ERROR_PARAM;
     }
     
+    /* Striped data arrives on the lanes only */
+    if (transfer->stripe) {
+        return FILE_TRANSFER_ERROR_STATE;
+    }
+    
     /* Check chunk number */
     if (chunk_num != transfer->chunks_received) {
         LOG_ERROR("Out-of-order chunk: expected %u, got %u",
@@ -393,55 +777,194 @@ static int receive_file_chunk_internal(file_transfer_t *transfer,
     /* Update transfer state */
     transfer->bytes_transferred += bytes_written;
     transfer->chunks_received++;
-    transfer->last_activity = time(NULL);
+    transfer->last_activity_ms = platform_coarse_monotonic_ms();
     
     /* Update progress display */
     update_transfer_progress(transfer);
     
+    /* Return credit to the sender as data is consumed */
+    if (advertise_window(transfer, 0) != FILE_TRANSFER_SUCCESS) {
+        LOG_ERROR("Failed to send window update");
+        transfer->state = TRANSFER_ERROR;
+        return FILE_TRANSFER_ERROR_NETWORK;
+    }
+    
     /* Check if transfer is complete */
     if (transfer->bytes_transferred >= transfer->file_size) {
-        fclose(transfer->file);
-        transfer->file = NULL;
-        
-        /* Verify checksum */
-        unsigned char actual_checksum[SHA256_DIGEST_LENGTH];
-        char final_filename[MAX_FILENAME_LEN];
-        
-        /* Rename .part file to final name */
-        snprintf(final_filename, sizeof(final_filename), "%s.part", 
-                 transfer->filename);
-        
-        if (calculate_file_checksum(final_filename, actual_checksum) != 0) {
-            LOG_ERROR("Failed to calculate received file checksum");
-            transfer->state = TRANSFER_ERROR;
-            return FILE_TRANSFER_ERROR_VERIFY;
-        }
-        
-        if (memcmp(actual_checksum, transfer->checksum, SHA256_DIGEST_LENGTH) != 0) {
-            LOG_ERROR("Checksum mismatch for received file");
-            transfer->state = TRANSFER_ERROR;
-            return FILE_TRANSFER_ERROR_VERIFY;
-        }
-        
-        /* Rename to final filename */
-        if (rename(final_filename, transfer->filename) != 0) {
-            LOG_ERROR("Failed to rename file: %s", strerror(errno));
-            transfer->state = TRANSFER_ERROR;
-            return FILE_TRANSFER_ERROR_IO;
-        }
-        
-        transfer->state = TRANSFER_COMPLETE;
-        
-        LOG_INFO("File '%s' received successfully (%lu bytes, %u chunks)",
-                 transfer->filename, (unsigned long)transfer->file_size,
-                 transfer->chunks_received);
-        
-        return FILE_TRANSFER_SUCCESS;
+        return complete_receive(transfer, NULL);
+    }
+    
+    return FILE_TRANSFER_IN_PROGRESS;
+}
+
+/* Receive a bulk chunk of an integrity-only transfer */
+int receive_file_bulk(file_transfer_t *transfer,
+                      const unsigned char *payload, size_t payload_len) {
+    uint32_t chunk_num, length;
+    int status;
+    
+    if (!transfer || !transfer->file || !payload || !transfer->integrity_only) {
+        return FILE_TRANSFER_ERROR_PARAM;
+    }
+    
+    if (parse_file_bulk(payload, payload_len, &chunk_num, &length) != PROTOCOL_SUCCESS) {
+        transfer->state = TRANSFER_ERROR;
+        return FILE_TRANSFER_ERROR_NETWORK;
+    }
+    
+    /* The clear bytes follow on the stream, so any mismatch is fatal */
+    if (chunk_num != transfer->chunks_received) {
+        LOG_ERROR("Out-of-order chunk: expected %u, got %u",
+                 transfer->chunks_received, chunk_num);
+        transfer->state = TRANSFER_ERROR;
+        return FILE_TRANSFER_ERROR_ORDER;
+    }
+    
+    if (transfer->bytes_transferred + length > transfer->file_size) {
+        LOG_ERROR("Chunk exceeds file size");
+        transfer->state = TRANSFER_ERROR;
+        return FILE_TRANSFER_ERROR_SIZE;
+    }
+    
+    /* Socket to file without passing through user space */
+    status = receive_file_range_clear(transfer->conn, fileno(transfer->file),
+                                      transfer->bytes_transferred, length);
+    if (status != NETWORK_SUCCESS) {
+        LOG_ERROR("Error receiving file data: %s", network_strerror(status));
+        transfer->state = TRANSFER_ERROR;
+        return FILE_TRANSFER_ERROR_NETWORK;
+    }
+    
+    transfer->bytes_transferred += length;
+    transfer->chunks_received++;
+    transfer->last_activity_ms = platform_coarse_monotonic_ms();
+    
+    update_transfer_progress(transfer);
+    
+    if (advertise_window(transfer, 0) != FILE_TRANSFER_SUCCESS) {
+        LOG_ERROR("Failed to send window update");
+        transfer->state = TRANSFER_ERROR;
+        return FILE_TRANSFER_ERROR_NETWORK;
     }
     
+    /* Completed by receive_file_end(), which carries the tag */
     return FILE_TRANSFER_IN_PROGRESS;
 }
 
+/* Handle the end of a transfer */
+int receive_file_end(file_transfer_t *transfer,
+                     const unsigned char *payload, size_t payload_len) {
+    if (!transfer || !payload) {
+        return FILE_TRANSFER_ERROR_PARAM;
+    }
+    
+    if (transfer->stripe) {
+        return finish_striped_receive(transfer);
+    }
+    
+    if (!transfer->integrity_only) {
+        return transfer->state == TRANSFER_COMPLETE ? FILE_TRANSFER_SUCCESS
+                                                    : FILE_TRANSFER_ERROR_STATE;
+    }
+    
+    if (!transfer->file || payload_len != INTEGRITY_TAG_SIZE ||
+        transfer->bytes_transferred != transfer->file_size) {
+        LOG_ERROR("Incomplete file transfer ended");
+        transfer->state = TRANSFER_ERROR;
+        return FILE_TRANSFER_ERROR_VERIFY;
+    }
+    
+    return complete_receive(transfer, payload);
+}
+
+/* Internal: Verify a fully received file and move it into place */
+static int complete_receive(file_transfer_t *transfer, const unsigned char *tag) {
+    unsigned char actual_checksum[SHA256_DIGEST_LENGTH];
+    char final_filename[MAX_FILENAME_LEN];
+    int status = 0;
+    
+    snprintf(final_filename, sizeof(final_filename), "%s.part", 
+             transfer->filename);
+    
+    /* Integrity-only files are tagged through a mapping of the open file */
+    if (transfer->integrity_only) {
+        status = -1;
+        if (fflush(transfer->file) == 0) {
+            status = integrity_tag_file(fileno(transfer->file), transfer->file_size,
+                                        transfer->tag_key, sizeof(transfer->tag_key),
+                                        0, actual_checksum);
+        }
+        crypto_memzero(transfer->tag_key, sizeof(transfer->tag_key));
+    }
+    
+    fclose(transfer->file);
+    transfer->file = NULL;
+    
+    if (!transfer->integrity_only) {
+        status = calculate_file_checksum(final_filename, actual_checksum);
+        tag = transfer->checksum;
+    }
+    
+    if (status != 0) {
+        LOG_ERROR("Failed to calculate received file checksum");
+        transfer->state = TRANSFER_ERROR;
+        return FILE_TRANSFER_ERROR_VERIFY;
+    }
+    
+    if (crypto_memcmp(actual_checksum, tag, SHA256_DIGEST_LENGTH) != 0) {
+        LOG_ERROR("Checksum mismatch for received file");
+        transfer->state = TRANSFER_ERROR;
+        return FILE_TRANSFER_ERROR_VERIFY;
+    }
+    
+    /* Rename .part file to final name */
+    if (rename(final_filename, transfer->filename) != 0) {
+        LOG_ERROR("Failed to rename file: %s", strerror(errno));
+        transfer->state = TRANSFER_ERROR;
+        return FILE_TRANSFER_ERROR_IO;
+    }
+    
+    transfer->state = TRANSFER_COMPLETE;
+    
+    LOG_INFO("File '%s' received successfully (%lu bytes, %u chunks)",
+             transfer->filename, (unsigned long)transfer->file_size,
+             transfer->chunks_received);
+    
+    return FILE_TRANSFER_SUCCESS;
+}
+
+/* Take the next message queued while sending */
+int file_transfer_next_message(file_transfer_t *transfer, message_type_t *type,
+                               unsigned char *buffer, size_t *buffer_len) {
+    deferred_message_t *message;
+    
+    if (!transfer || !type || !buffer_len || (!buffer && *buffer_len > 0)) {
+        return FILE_TRANSFER_ERROR_PARAM;
+    }
+    
+    message = transfer->deferred;
+    if (!message) {
+        return FILE_TRANSFER_IN_PROGRESS;
+    }
+    
+    if (message->len > *buffer_len) {
+        LOG_ERROR("Buffer too small: need %zu, have %zu", message->len, *buffer_len);
+        return FILE_TRANSFER_ERROR_SIZE;
+    }
+    
+    *type = message->type;
+    *buffer_len = message->len;
+    if (message->len > 0) {
+        memcpy(buffer, message->data, message->len);
+    }
+    
+    transfer->deferred = message->next;
+    transfer->deferred_bytes -= message->len;
+    free(message);
+    
+    return FILE_TRANSFER_SUCCESS;
+}
+
 /* Cancel file transfer */
 int cancel_file_transfer(file_transfer_t *transfer) {
     if (!transfer) {
@@ -450,6 +973,19 @@ int cancel_file_transfer(file_transfer_t *transfer) {
     
     LOG_INFO("Cancelling file transfer: '%s'", transfer->filename);
     
+    uring_file_reader_destroy(transfer->reader);
+    transfer->reader = NULL;
+    
+    /* Lane threads use the file too */
+    retire_stripe(transfer);
+    
+    /* Tagging threads read the mapped file, so stop them first */
+    if (transfer->tag_job) {
+        integrity_finish(transfer->tag_job, NULL);
+        transfer->tag_job = NULL;
+    }
+    crypto_memzero(transfer->tag_key, sizeof(transfer->tag_key));
+    
     /* Close file if open */
     if (transfer->file) {
         fclose(transfer->file);
@@ -481,6 +1017,11 @@ file_transfer_info_t get_file_transfer_info(file_transfer_t *transfer) {
         info.chunks_received = transfer->chunks_received;
         info.elapsed_time = time(NULL) - transfer->start_time;
         info.transfer_rate = 0;
+        info.window_size = (uint32_t)transfer->flow.send_window;
+        info.rtt_ms = transfer->flow.srtt_ms;
+        info.bytes_in_flight = transfer->bytes_transferred - 
+                               transfer->flow.bytes_acked;
+        info.lanes = (uint32_t)get_file_transfer_lanes(transfer, NULL, STRIPE_MAX_LANES);
         
         if (info.elapsed_time > 0) {
             info.transfer_rate = transfer->bytes_transferred / info.elapsed_time;
@@ -497,6 +1038,34 @@ file_transfer_info_t get_file_transfer_info(file_transfer_t *transfer) {
     return info;
 }
 
+/* Get per-lane statistics of a striped transfer */
+int get_file_transfer_lanes(file_transfer_t *transfer, stripe_lane_stats_t *lanes,
+                            int max_lanes) {
+    stripe_lane_stats_t live[STRIPE_MAX_LANES];
+    const stripe_lane_stats_t *source = live;
+    int count;
+    
+    if (!transfer || max_lanes <= 0) {
+        return 0;
+    }
+    
+    if (transfer->stripe) {
+        count = stripe_get_lanes(transfer->stripe, live, STRIPE_MAX_LANES);
+    } else {
+        count = transfer->lane_count;
+        source = transfer->lane_stats;
+    }
+    
+    if (count > max_lanes) {
+        count = max_lanes;
+    }
+    if (lanes) {
+        memcpy(lanes, source, (size_t)count * sizeof(*lanes));
+    }
+    
+    return count;
+}
+
 /* Calculate file checksum (SHA256) */
 static int calculate_file_checksum(const char *filename, unsigned char *checksum) {
     FILE *file = fopen(filename, "rb");
@@ -520,10 +1089,433 @@ static int calculate_file_checksum(const char *filename, unsigned char *checksum
     return 0;
 }
 
+/* Initialize flow control state */
+static void flow_init(flow_control_t *flow) {
+    memset(flow, 0, sizeof(*flow));
+    flow->credit_limit = INITIAL_WINDOW;
+    flow->send_window = INITIAL_WINDOW;
+    flow->recv_window = INITIAL_WINDOW;
+    flow->in_startup = 1;
+}
+
+/* Highest offset the sender may reach: autotuned window within credit */
+static uint64_t flow_send_limit(const flow_control_t *flow) {
+    uint64_t window = flow->send_window, floor;
+    uint64_t target;
+    
+    /* The receiver only advertises again once a quarter of its window is
+     * consumed; stopping short of that (plus a chunk) stalls both ends */
+    floor = flow->peer_window / WINDOW_UPDATE_DIVISOR + BULK_CHUNK_SIZE;
+    if (window < floor) {
+        window = floor;
+    }
+    
+    target = flow->bytes_acked + window;
+    return target < flow->credit_limit ? target : flow->credit_limit;
+}
+
+/* Remember when a chunk left so its acknowledgement yields an RTT sample */
+static void flow_record_send(flow_control_t *flow, uint64_t end_offset) {
+    uint32_t slot;
+    
+    if (flow->sample_count == RTT_SAMPLE_SLOTS) {
+        flow->sample_head = (flow->sample_head + 1) % RTT_SAMPLE_SLOTS;
+        flow->sample_count--;
+    }
+    
+    slot = (flow->sample_head + flow->sample_count) % RTT_SAMPLE_SLOTS;
+    flow->samples[slot].end_offset = end_offset;
+    flow->samples[slot].sent_ms = platform_get_time_ms();
+    flow->sample_count++;
+}
+
+/* Update RTT, delivery rate and send window from a receiver update */
+static void flow_on_update(flow_control_t *flow, uint64_t consumed,
+                          uint64_t credit_limit) {
+    uint64_t now = platform_get_time_ms();
+    uint64_t rtt_ms = 0, rate, decayed, bdp, target;
+    int have_rtt = 0;
+    
+    /* Credit only ever moves forward */
+    if (credit_limit > flow->credit_limit) {
+        flow->credit_limit = credit_limit;
+    }
+    if (credit_limit > consumed) {
+        flow->peer_window = credit_limit - consumed;
+    }
+    
+    if (consumed <= flow->bytes_acked) {
+        return;
+    }
+    
+    /* RTT from the newest chunk covered by this update */
+    while (flow->sample_count > 0 &&
+           flow->samples[flow->sample_head].end_offset <= consumed) {
+        rtt_ms = now - flow->samples[flow->sample_head].sent_ms;
+        have_rtt = 1;
+        flow->sample_head = (flow->sample_head + 1) % RTT_SAMPLE_SLOTS;
+        flow->sample_count--;
+    }
+    
+    if (have_rtt) {
+        if (rtt_ms == 0) rtt_ms = 1;
+        flow->srtt_ms = flow->srtt_ms ? 
+                        (uint32_t)((7 * (uint64_t)flow->srtt_ms + rtt_ms) / 8) :
+                        (uint32_t)rtt_ms;
+    }
+    
+    /* Delivery rate since the previous update, max-filtered with decay */
+    if (flow->last_ack_ms && now > flow->last_ack_ms) {
+        rate = (consumed - flow->bytes_acked) * 1000 / (now - flow->last_ack_ms);
+        decayed = flow->delivery_rate - flow->delivery_rate / 8;
+        flow->delivery_rate = rate > decayed ? rate : decayed;
+    }
+    
+    flow->last_ack_ms = now;
+    flow->bytes_acked = consumed;
+    
+    if (flow->delivery_rate == 0 || flow->srtt_ms == 0) {
+        return;
+    }
+    
+    /* Leave startup once the rate stops growing by at least 25% */
+    if (flow->in_startup) {
+        if (flow->delivery_rate >= flow->full_rate + flow->full_rate / 4) {
+            flow->full_rate = flow->delivery_rate;
+            flow->startup_rounds = 0;
+        } else if (++flow->startup_rounds >= STARTUP_ROUNDS) {
+            flow->in_startup = 0;
+        }
+    }
+    
+    /* Keep bandwidth x RTT in flight; small headroom lets it probe upwards */
+    bdp = flow->delivery_rate * flow->srtt_ms / 1000;
+    target = flow->in_startup ? bdp * 2 : bdp + bdp / 4;
+    
+    if (target < MIN_WINDOW) target = MIN_WINDOW;
+    if (target > MAX_WINDOW) target = MAX_WINDOW;
+    flow->send_window = target;
+}
+
+/* Internal: Read one message from the peer while sending, waiting up to
+ * timeout_ms. Window updates and keepalives are returned in the control
+ * buffer; anything else is queued for file_transfer_next_message(). A
+ * disconnect or peer error ends the transfer. Returns
+ * FILE_TRANSFER_IN_PROGRESS when nothing (or only part of a message) is
+ * ready, or the queue is full */
+static int receive_control(file_transfer_t *transfer, int timeout_ms,
+                           message_type_t *type, size_t *payload_len) {
+    int result;
+    
+    if (transfer->deferred_bytes >= DEFERRED_MAX_BYTES) {
+        return FILE_TRANSFER_IN_PROGRESS;
+    }
+    
+    if (!transfer->control_buffer) {
+        transfer->control_buffer = malloc(CONTROL_BUFFER_SIZE);
+        if (!transfer->control_buffer) {
+            LOG_ERROR("Memory allocation failed");
+            transfer->state = TRANSFER_ERROR;
+            return FILE_TRANSFER_ERROR_IO;
+        }
+    }
+    
+    /* Bytes already buffered for conn do not show up on the socket, and
+     * may hold only the start of a message */
+    result = PROTOCOL_IN_PROGRESS;
+    if (connection_input_pending(transfer->conn) > 0) {
+        *payload_len = CONTROL_BUFFER_SIZE;
+        result = receive_message(transfer->conn, type, transfer->control_buffer, payload_len);
+    }
+    if (result == PROTOCOL_IN_PROGRESS) {
+        int ready = wait_for_connection(transfer->conn, timeout_ms, 1, 0);
+        
+        if (ready < 0) {
+            transfer->state = TRANSFER_ERROR;
+            return FILE_TRANSFER_ERROR_NETWORK;
+        } else if (ready == 0) {
+            return FILE_TRANSFER_IN_PROGRESS;
+        }
+        
+        *payload_len = CONTROL_BUFFER_SIZE;
+        result = receive_message(transfer->conn, type, transfer->control_buffer, payload_len);
+    }
+    
+    switch (result) {
+        case PROTOCOL_SUCCESS:
+            break;
+            
+        case PROTOCOL_IN_PROGRESS:
+            return FILE_TRANSFER_IN_PROGRESS;
+            
+        case PROTOCOL_ERROR_CLOSED:
+            LOG_ERROR("Peer disconnected during transfer of '%s'", transfer->filename);
+            transfer->state = TRANSFER_CANCELLED;
+            return FILE_TRANSFER_CANCELLED;
+            
+        default:
+            LOG_ERROR("Failed to receive during file send: %s", protocol_strerror(result));
+            transfer->state = TRANSFER_ERROR;
+            return FILE_TRANSFER_ERROR_NETWORK;
+    }
+    
+    if (*type == MSG_WINDOW_UPDATE || *type == MSG_KEEPALIVE) {
+        return FILE_TRANSFER_SUCCESS;
+    }
+    
+    result = defer_message(transfer, *type, transfer->control_buffer, *payload_len);
+    if (result != FILE_TRANSFER_SUCCESS) {
+        transfer->state = TRANSFER_ERROR;
+        return result;
+    }
+    
+    /* Consumed here; the caller only sees it through the queue */
+    *type = MSG_KEEPALIVE;
+    *payload_len = 0;
+    return FILE_TRANSFER_SUCCESS;
+}
+
+/* Internal: Queue a message for file_transfer_next_message() */
+static int defer_message(file_transfer_t *transfer, message_type_t type,
+                         const unsigned char *payload, size_t payload_len) {
+    deferred_message_t *message = malloc(sizeof(*message) + payload_len);
+    
+    if (!message) {
+        LOG_ERROR("Memory allocation failed");
+        return FILE_TRANSFER_ERROR_IO;
+    }
+    
+    message->next = NULL;
+    message->type = type;
+    message->len = payload_len;
+    if (payload_len > 0) {
+        memcpy(message->data, payload, payload_len);
+    }
+    
+    if (!transfer->deferred) {
+        transfer->deferred_tail = &transfer->deferred;
+    }
+    *transfer->deferred_tail = message;
+    transfer->deferred_tail = &message->next;
+    transfer->deferred_bytes += payload_len;
+    
+    LOG_DEBUG("Queued message type 0x%02x (%zu bytes) during file send", type, payload_len);
+    return FILE_TRANSFER_SUCCESS;
+}
+
+/* Read pending window updates; block up to timeout_ms for the first one */
+static int drain_window_updates(file_transfer_t *transfer, int timeout_ms) {
+    message_type_t msg_type;
+    size_t payload_len;
+    int result;
+    
+    while ((result = receive_control(transfer, timeout_ms, &msg_type, &payload_len))
+           == FILE_TRANSFER_SUCCESS) {
+        if (msg_type == MSG_WINDOW_UPDATE) {
+            result = file_transfer_window_update(transfer, transfer->control_buffer,
+                                                 payload_len);
+            if (result != FILE_TRANSFER_SUCCESS) {
+                transfer->state = TRANSFER_ERROR;
+                return result;
+            }
+        }
+        
+        /* Only the first wait may block */
+        timeout_ms = 0;
+    }
+    
+    return result == FILE_TRANSFER_IN_PROGRESS ? FILE_TRANSFER_SUCCESS : result;
+}
+
+/* Advertise receiver credit once enough of the window has been consumed */
+static int advertise_window(file_transfer_t *transfer, int force) {
+    flow_control_t *flow = &transfer->flow;
+    uint64_t consumed = transfer->bytes_transferred;
+    
+    /* The sender needs no further credit once everything has arrived */
+    if (consumed >= transfer->file_size) {
+        return FILE_TRANSFER_SUCCESS;
+    }
+    
+    if (!force && consumed - flow->last_advertised < 
+                  flow->recv_window / WINDOW_UPDATE_DIVISOR) {
+        return FILE_TRANSFER_SUCCESS;
+    }
+    
+    /* Grow the credit while the sender keeps using whole windows */
+    if (consumed - flow->window_epoch >= flow->recv_window &&
+        flow->recv_window < MAX_WINDOW) {
+        flow->recv_window *= 2;
+        if (flow->recv_window > MAX_WINDOW) {
+            flow->recv_window = MAX_WINDOW;
+        }
+        flow->window_epoch = consumed;
+        LOG_DEBUG("Receive window grown to %lu bytes", 
+                  (unsigned long)flow->recv_window);
+    }
+    
+    if (send_window_update(transfer->conn, consumed, consumed + flow->recv_window)
+        != PROTOCOL_SUCCESS) {
+        return FILE_TRANSFER_ERROR_NETWORK;
+    }
+    
+    flow->last_advertised = consumed;
+    return FILE_TRANSFER_SUCCESS;
+}
+
+/* Send side of a striped transfer: lanes do the work, this reports it */
+static int send_striped(file_transfer_t *transfer) {
+    uint64_t bytes = 0;
+    int status = stripe_poll(transfer->stripe, &bytes);
+    
+    if (bytes != transfer->bytes_transferred) {
+        transfer->bytes_transferred = bytes;
+        transfer->last_activity_ms = platform_coarse_monotonic_ms();
+        update_transfer_progress(transfer);
+    }
+    
+    if (status == STRIPE_IN_PROGRESS) {
+        platform_sleep_ms(FLOW_WAIT_MS);
+        return FILE_TRANSFER_IN_PROGRESS;
+    }
+    
+    retire_stripe(transfer);
+    if (status != STRIPE_SUCCESS) {
+        LOG_ERROR("Striped send of '%s' failed: %s", transfer->filename,
+                  stripe_strerror(status));
+        transfer->state = TRANSFER_ERROR;
+        return FILE_TRANSFER_ERROR_NETWORK;
+    }
+    
+    /* Every lane has ended, so the receiver can verify once its lanes drain */
+    if (send_message(transfer->conn, MSG_FILE_END, transfer->checksum, 
+                    SHA256_DIGEST_LENGTH) != PROTOCOL_SUCCESS) {
+        LOG_ERROR("Failed to send file end message");
+        transfer->state = TRANSFER_ERROR;
+        return FILE_TRANSFER_ERROR_NETWORK;
+    }
+    
+    fclose(transfer->file);
+    transfer->file = NULL;
+    transfer->state = TRANSFER_COMPLETE;
+    
+    LOG_INFO("File '%s' sent successfully (%lu bytes, %u chunks over %d lanes)",
+             transfer->filename, (unsigned long)transfer->file_size,
+             transfer->chunks_sent, transfer->lane_count);
+    
+    return FILE_TRANSFER_SUCCESS;
+}
+
+/* Receive side: wait for the lanes to drain, then verify the file */
+static int finish_striped_receive(file_transfer_t *transfer) {
+    uint64_t bytes = 0;
+    int status;
+    
+    /* The sender ends lanes before conn, but their data may still be queued */
+    status = stripe_wait(transfer->stripe, TRANSFER_TIMEOUT_MS);
+    stripe_poll(transfer->stripe, &bytes);
+    transfer->bytes_transferred = bytes;
+    retire_stripe(transfer);
+    
+    if (status != STRIPE_SUCCESS) {
+        LOG_ERROR("Striped transfer ended with %lu of %lu bytes: %s",
+                  (unsigned long)bytes, (unsigned long)transfer->file_size,
+                  stripe_strerror(status));
+        transfer->state = TRANSFER_ERROR;
+        return FILE_TRANSFER_ERROR_VERIFY;
+    }
+    
+    return complete_receive(transfer, NULL);
+}
+
+/* Wait for the receiver's initial window update on the control connection */
+static int wait_for_receiver(file_transfer_t *transfer, int timeout_ms) {
+    message_type_t msg_type;
+    size_t payload_len;
+    uint64_t deadline = platform_coarse_monotonic_ms() + (uint64_t)timeout_ms;
+    
+    for (;;) {
+        uint64_t now = platform_coarse_monotonic_ms();
+        int result;
+        
+        if (now >= deadline) {
+            LOG_ERROR("Receiver did not accept the striped transfer");
+            return FILE_TRANSFER_ERROR_TIMEOUT;
+        }
+        
+        result = receive_control(transfer, (int)(deadline - now), &msg_type, &payload_len);
+        if (result == FILE_TRANSFER_IN_PROGRESS) {
+            /* A full queue only drains once the caller has the handle */
+            if (transfer->deferred_bytes >= DEFERRED_MAX_BYTES) {
+                LOG_ERROR("Too many messages queued before the receiver accepted");
+                return FILE_TRANSFER_ERROR_SIZE;
+            }
+            continue;
+        } else if (result != FILE_TRANSFER_SUCCESS) {
+            return result;
+        }
+        
+        if (msg_type == MSG_WINDOW_UPDATE) {
+            return FILE_TRANSFER_SUCCESS;
+        }
+    }
+}
+
+/* Keep the lanes' statistics, then stop them and close their connections */
+static void retire_stripe(file_transfer_t *transfer) {
+    if (!transfer->stripe) return;
+    
+    transfer->lane_count = stripe_get_lanes(transfer->stripe, transfer->lane_stats,
+                                            STRIPE_MAX_LANES);
+    stripe_destroy(transfer->stripe);
+    transfer->stripe = NULL;
+    
+    for (int i = 0; i < transfer->lane_count; i++) {
+        transfer->lane_stats[i].active = 0;
+        if (transfer->state == TRANSFER_SENDING) {
+            transfer->chunks_sent += transfer->lane_stats[i].chunks;
+        } else {
+            transfer->chunks_received += transfer->lane_stats[i].chunks;
+        }
+    }
+}
+
+/* Decode exactly len bytes of hex */
+static int hex_decode(const char *hex, unsigned char *out, size_t len) {
+    if (strlen(hex) != len * 2) {
+        return -1;
+    }
+    
+    for (size_t i = 0; i < len; i++) {
+        char pair[3] = {hex[i * 2], hex[i * 2 + 1], '\0'};
+        
+        if (!isxdigit((unsigned char)pair[0]) || !isxdigit((unsigned char)pair[1])) {
+            return -1;
+        }
+        out[i] = (unsigned char)strtol(pair, NULL, 16);
+    }
+    
+    return 0;
+}
+
+/* Derive the per-transfer tag key from the session and a nonce */
+static int derive_tag_key(file_transfer_t *transfer, const unsigned char *nonce) {
+    crypto_session_t *session = get_connection_crypto(transfer->conn);
+    
+    if (!session ||
+        crypto_session_derive_key(session, TAG_KEY_LABEL, nonce, TAG_NONCE_SIZE,
+                                  transfer->tag_key, sizeof(transfer->tag_key))
+        != CRYPTO_SUCCESS) {
+        return FILE_TRANSFER_ERROR_STATE;
+    }
+    
+    return FILE_TRANSFER_SUCCESS;
+}
+
 /* Update transfer progress display */
 static void update_transfer_progress(file_transfer_t *transfer) {
     static time_t last_display = 0;
-    time_t now = time(NULL);
+    time_t now = platform_coarse_time();
     
     /* Update display every second */
     if (now - last_display >= 1) {
@@ -550,12 +1542,36 @@ static void update_transfer_progress(file_transfer_t *transfer) {
 void cleanup_file_transfer(file_transfer_t *transfer) {
     if (!transfer) return;
     
+    /* Reads in flight target the file, so stop them first */
+    if (transfer->reader) {
+        uring_file_reader_destroy(transfer->reader);
+        transfer->reader = NULL;
+    }
+    
+    if (transfer->tag_job) {
+        integrity_finish(transfer->tag_job, NULL);
+        transfer->tag_job = NULL;
+    }
+    
+    stripe_destroy(transfer->stripe);
+    transfer->stripe = NULL;
+    
     /* Close file if still open */
     if (transfer->file) {
         fclose(transfer->file);
         transfer->file = NULL;
     }
     
+    while (transfer->deferred) {
+        deferred_message_t *message = transfer->deferred;
+        
+        transfer->deferred = message->next;
+        free(message);
+    }
+    
     /* Free memory */
+    free(transfer->chunk_buffer);
+    free(transfer->control_buffer);
+    crypto_memzero(transfer->tag_key, sizeof(transfer->tag_key));
     free(transfer);
 }
\ No newline at end of file
@@ -0,0 +1,284 @@
+/*
+ * Cryptcat File Integrity
+ * Parallel HMAC-SHA256 tag trees over memory-mapped files
+ * Version: 1.0.0
+ * License: MIT
+ */
+
+#ifdef __linux__
+#define _GNU_SOURCE  /* madvise */
+#endif
+
+#include "integrity.h"
+#include "crypto.h"
+#include "platform.h"
+#include "utils/logger.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <arpa/inet.h>
+#include <sys/mman.h>
+#include <openssl/evp.h>
+#include <openssl/core_names.h>
+
+/* Job constants */
+#define INTEGRITY_KEY_MAX 64
+
+/* One hashing thread */
+typedef struct {
+    integrity_job_t *job;
+    uint64_t first;
+    platform_thread_t thread;
+    int result;
+} integrity_worker_t;
+
+/* Job state */
+struct integrity_job_s {
+    const unsigned char *map;       /* Whole file, read-only */
+    uint64_t file_size;
+    uint64_t leaves;
+    unsigned char *leaf_tags;       /* leaves * INTEGRITY_TAG_SIZE */
+    EVP_MAC *mac;                   /* HMAC, fetched once per job */
+    unsigned char key[INTEGRITY_KEY_MAX];
+    size_t key_len;
+    int threads;                    /* Started */
+    int stride;                     /* Planned; worker i tags leaves i, i + stride, ... */
+    integrity_worker_t workers[INTEGRITY_MAX_THREADS];
+};
+
+/* Internal function prototypes */
+static void* integrity_worker(void *arg);
+static int init_mac(EVP_MAC_CTX *ctx, const integrity_job_t *job);
+static int tag_leaf(const integrity_job_t *job, EVP_MAC_CTX *ctx, uint64_t leaf);
+static void destroy_job(integrity_job_t *job);
+
+/* Start a background tagging job */
+integrity_job_t* integrity_start(int fd, uint64_t file_size,
+                                 const unsigned char *key, size_t key_len, int threads) {
+    integrity_job_t *job;
+    void *map;
+
+    if (fd < 0 || !key || key_len == 0 || key_len > INTEGRITY_KEY_MAX) {
+        return NULL;
+    }
+
+    job = calloc(1, sizeof(integrity_job_t));
+    if (!job) {
+        LOG_ERROR("Memory allocation failed");
+        return NULL;
+    }
+
+    job->file_size = file_size;
+    job->leaves = (file_size + INTEGRITY_BLOCK_SIZE - 1) / INTEGRITY_BLOCK_SIZE;
+    job->key_len = key_len;
+    memcpy(job->key, key, key_len);
+
+    job->mac = EVP_MAC_fetch(NULL, "HMAC", NULL);
+    if (!job->mac) {
+        LOG_ERROR("HMAC unavailable");
+        destroy_job(job);
+        return NULL;
+    }
+
+    /* An empty file has no leaves; its tag covers the size alone */
+    if (job->leaves == 0) {
+        return job;
+    }
+
+    job->leaf_tags = malloc(job->leaves * INTEGRITY_TAG_SIZE);
+    map = mmap(NULL, file_size, PROT_READ, MAP_SHARED, fd, 0);
+    if (!job->leaf_tags || map == MAP_FAILED) {
+        LOG_ERROR("Cannot map file for tagging: %s", map == MAP_FAILED ? strerror(errno)
+                                                                       : "out of memory");
+        if (map != MAP_FAILED) {
+            munmap(map, file_size);
+        }
+        destroy_job(job);
+        return NULL;
+    }
+    job->map = map;
+
+    /* Each thread walks its leaves front to back */
+    madvise(map, file_size, MADV_SEQUENTIAL);
+
+    if (threads <= 0) {
+        threads = platform_get_system_info().num_cpus;
+    }
+    if (threads > INTEGRITY_MAX_THREADS) {
+        threads = INTEGRITY_MAX_THREADS;
+    }
+    if ((uint64_t)threads > job->leaves) {
+        threads = (int)job->leaves;
+    }
+    if (threads < 1) {
+        threads = 1;
+    }
+
+    job->stride = threads;
+    for (int i = 0; i < threads; i++) {
+        integrity_worker_t *worker = &job->workers[i];
+
+        worker->job = job;
+        worker->first = (uint64_t)i;
+        worker->thread = platform_thread_create(integrity_worker, worker);
+        if (!worker->thread) {
+            LOG_ERROR("Failed to start tagging thread %d", i);
+            integrity_finish(job, NULL);
+            return NULL;
+        }
+        job->threads++;
+    }
+
+    return job;
+}
+
+/* Wait for a job and combine its leaf tags */
+int integrity_finish(integrity_job_t *job, unsigned char *tag) {
+    unsigned char size_be[8];
+    size_t tag_len;
+    EVP_MAC_CTX *ctx;
+    int result = INTEGRITY_SUCCESS;
+
+    if (!job) {
+        return INTEGRITY_ERROR_PARAM;
+    }
+
+    for (int i = 0; i < job->threads; i++) {
+        platform_thread_join(job->workers[i].thread);
+        if (job->workers[i].result != INTEGRITY_SUCCESS) {
+            result = job->workers[i].result;
+        }
+    }
+
+    if (result == INTEGRITY_SUCCESS && job->threads == 0 && job->leaves > 0) {
+        result = INTEGRITY_ERROR_THREAD;
+    }
+
+    /* Root: HMAC(key, file_size(8) || leaf tags in order) */
+    if (result == INTEGRITY_SUCCESS && tag) {
+        uint32_t hi = htonl((uint32_t)(job->file_size >> 32));
+        uint32_t lo = htonl((uint32_t)job->file_size);
+
+        memcpy(size_be, &hi, 4);
+        memcpy(size_be + 4, &lo, 4);
+
+        ctx = EVP_MAC_CTX_new(job->mac);
+        if (!ctx || init_mac(ctx, job) != INTEGRITY_SUCCESS ||
+            EVP_MAC_update(ctx, size_be, sizeof(size_be)) != 1 ||
+            EVP_MAC_update(ctx, job->leaf_tags, job->leaves * INTEGRITY_TAG_SIZE) != 1 ||
+            EVP_MAC_final(ctx, tag, &tag_len, INTEGRITY_TAG_SIZE) != 1) {
+            result = INTEGRITY_ERROR_CRYPTO;
+        }
+        EVP_MAC_CTX_free(ctx);
+    }
+
+    destroy_job(job);
+    return result;
+}
+
+/* Tag a file synchronously */
+int integrity_tag_file(int fd, uint64_t file_size, const unsigned char *key,
+                       size_t key_len, int threads, unsigned char *tag) {
+    integrity_job_t *job;
+
+    if (!tag) {
+        return INTEGRITY_ERROR_PARAM;
+    }
+
+    job = integrity_start(fd, file_size, key, key_len, threads);
+    if (!job) {
+        return INTEGRITY_ERROR_IO;
+    }
+
+    return integrity_finish(job, tag);
+}
+
+/* Internal: Tagging thread */
+static void* integrity_worker(void *arg) {
+    integrity_worker_t *worker = (integrity_worker_t*)arg;
+    integrity_job_t *job = worker->job;
+    EVP_MAC_CTX *ctx = EVP_MAC_CTX_new(job->mac);
+
+    worker->result = ctx ? INTEGRITY_SUCCESS : INTEGRITY_ERROR_MEMORY;
+
+    /* Interleaved leaves keep all threads near the same part of the file,
+     * so read-ahead serves them all */
+    for (uint64_t leaf = worker->first;
+         leaf < job->leaves && worker->result == INTEGRITY_SUCCESS;
+         leaf += (uint64_t)job->stride) {
+        worker->result = tag_leaf(job, ctx, leaf);
+    }
+
+    EVP_MAC_CTX_free(ctx);
+    return NULL;
+}
+
+/* Internal: Start HMAC-SHA256 under the job's key */
+static int init_mac(EVP_MAC_CTX *ctx, const integrity_job_t *job) {
+    OSSL_PARAM params[] = {
+        OSSL_PARAM_construct_utf8_string(OSSL_MAC_PARAM_DIGEST, (char*)"SHA256", 0),
+        OSSL_PARAM_construct_end()
+    };
+
+    if (EVP_MAC_init(ctx, job->key, job->key_len, params) != 1) {
+        return INTEGRITY_ERROR_CRYPTO;
+    }
+
+    return INTEGRITY_SUCCESS;
+}
+
+/* Internal: Leaf tag = HMAC(key, leaf_index(8) || block) */
+static int tag_leaf(const integrity_job_t *job, EVP_MAC_CTX *ctx, uint64_t leaf) {
+    uint64_t offset = leaf * INTEGRITY_BLOCK_SIZE;
+    size_t len = job->file_size - offset < INTEGRITY_BLOCK_SIZE
+                     ? (size_t)(job->file_size - offset) : INTEGRITY_BLOCK_SIZE;
+    unsigned char index_be[8];
+    uint32_t hi = htonl((uint32_t)(leaf >> 32));
+    uint32_t lo = htonl((uint32_t)leaf);
+    size_t tag_len;
+
+    memcpy(index_be, &hi, 4);
+    memcpy(index_be + 4, &lo, 4);
+
+    if (init_mac(ctx, job) != INTEGRITY_SUCCESS ||
+        EVP_MAC_update(ctx, index_be, sizeof(index_be)) != 1 ||
+        EVP_MAC_update(ctx, job->map + offset, len) != 1 ||
+        EVP_MAC_final(ctx, job->leaf_tags + leaf * INTEGRITY_TAG_SIZE, &tag_len,
+                      INTEGRITY_TAG_SIZE) != 1) {
+        return INTEGRITY_ERROR_CRYPTO;
+    }
+
+    return INTEGRITY_SUCCESS;
+}
+
+/* Internal: Release a job's memory and mapping */
+static void destroy_job(integrity_job_t *job) {
+    if (job->map) {
+        munmap((void*)job->map, job->file_size);
+    }
+    free(job->leaf_tags);
+    EVP_MAC_free(job->mac);
+    crypto_memzero(job->key, sizeof(job->key));
+    free(job);
+}
+
+/* Get error message */
+const char* integrity_strerror(int error_code) {
+    switch (error_code) {
+        case INTEGRITY_SUCCESS:
+            return "Success";
+        case INTEGRITY_ERROR_PARAM:
+            return "Invalid parameter";
+        case INTEGRITY_ERROR_MEMORY:
+            return "Memory allocation failed";
+        case INTEGRITY_ERROR_IO:
+            return "Cannot map file";
+        case INTEGRITY_ERROR_CRYPTO:
+            return "HMAC computation failed";
+        case INTEGRITY_ERROR_THREAD:
+            return "Cannot start tagging threads";
+        default:
+            return "Unknown error";
+    }
+}
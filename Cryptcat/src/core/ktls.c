@@ -0,0 +1,363 @@
+/*
+ * Cryptcat Kernel TLS
+ * Switches an established session's record crypto to Linux kernel TLS
+ * Version: 1.0.0
+ * License: MIT
+ */
+
+#include "ktls.h"
+#include "protocol.h"
+#include "crypto.h"
+#include "platform.h"
+#include "utils/logger.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#ifdef __linux__
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <linux/tls.h>
+#endif
+
+#if defined(__linux__) && defined(TCP_ULP) && defined(TLS_TX) && defined(TLS_RX) && \
+    defined(TLS_CIPHER_AES_GCM_256) && defined(TLS_1_3_VERSION)
+#define KTLS_SUPPORTED
+#ifndef SOL_TLS
+#define SOL_TLS 282
+#endif
+#endif
+
+/* Kernel TLS constants */
+#define KTLS_VERSION 1
+#define KTLS_CIPHER_AES_256_GCM 1
+#define KTLS_NONCE_SIZE 32
+#define KTLS_KEY_SIZE 32            /* AES-256 */
+#define KTLS_IV_SIZE 12             /* salt(4) | iv(8) */
+#define KTLS_DRAIN_TIMEOUT_MS 5000
+
+/* Request: version(1) | cipher(1) | initiator_nonce(32) */
+#define KTLS_REQUEST_SIZE (2 + KTLS_NONCE_SIZE)
+
+/* Response: status(1) | responder_nonce(32) */
+#define KTLS_RESPONSE_SIZE (1 + KTLS_NONCE_SIZE)
+#define KTLS_STATUS_ACCEPT 0
+#define KTLS_STATUS_REFUSE 1
+
+/* Keys for one direction */
+typedef struct {
+    unsigned char key[KTLS_KEY_SIZE];
+    unsigned char iv[KTLS_IV_SIZE];
+} ktls_keys_t;
+
+/* Internal function prototypes */
+static int attach_ulp(connection_t *conn);
+static int derive_keys(connection_t *conn, const char *direction,
+                       const unsigned char *nonces, ktls_keys_t *keys);
+static int install_keys(connection_t *conn, int tx, const ktls_keys_t *keys);
+static int drain(connection_t *conn, int timeout_ms);
+static int send_response(connection_t *conn, int status, const unsigned char *nonce);
+
+/* Probe for kernel TLS support */
+int ktls_available(void) {
+#ifdef KTLS_SUPPORTED
+    static int available = -1;
+    const char *forced = getenv("CRYPTCAT_KTLS");
+
+    if (forced && strcmp(forced, "off") == 0) {
+        return 0;
+    }
+
+    if (available < 0) {
+        int fd = socket(AF_INET, SOCK_STREAM, 0);
+
+        /* The ULP only attaches to established sockets: ENOTCONN means the
+         * module is there, ENOENT that it is not */
+        available = fd >= 0 &&
+                    (setsockopt(fd, IPPROTO_TCP, TCP_ULP, "tls", sizeof("tls")) == 0 ||
+                     errno == ENOTCONN);
+        if (!available) {
+            LOG_INFO("Kernel TLS unavailable (%s), using user-space crypto", strerror(errno));
+        }
+        if (fd >= 0) {
+            close_socket(fd);
+        }
+    }
+
+    return available;
+#else
+    return 0;
+#endif
+}
+
+/* Ask the peer to switch to kernel TLS and switch on acceptance */
+int ktls_enable(connection_t *conn, int timeout_ms) {
+    unsigned char request[KTLS_REQUEST_SIZE];
+    unsigned char nonces[2 * KTLS_NONCE_SIZE];
+    unsigned char response[KTLS_RESPONSE_SIZE + 64];
+    ktls_keys_t tx, rx;
+    message_type_t msg_type;
+    size_t response_len;
+    uint64_t deadline;
+    int result;
+
+    if (!conn || !get_connection_crypto(conn) || timeout_ms <= 0) {
+        return KTLS_ERROR_PARAM;
+    }
+
+    if (connection_kernel_crypto(conn)) {
+        return KTLS_SUCCESS;
+    }
+
+    /* Attaching the ULP alone changes nothing on the wire, so a refusal
+     * here leaves the session exactly as it was */
+    if (!ktls_available() || !connection_owns_socket(conn) || attach_ulp(conn) != 0) {
+        return KTLS_ERROR_UNSUPPORTED;
+    }
+
+    request[0] = KTLS_VERSION;
+    request[1] = KTLS_CIPHER_AES_256_GCM;
+    if (crypto_random_bytes(request + 2, KTLS_NONCE_SIZE) != CRYPTO_SUCCESS) {
+        return KTLS_ERROR_KEY;
+    }
+
+    if (send_message(conn, MSG_KTLS_REQUEST, request, sizeof(request)) != PROTOCOL_SUCCESS ||
+        drain(conn, timeout_ms) != 0) {
+        return KTLS_ERROR_SYSTEM;
+    }
+
+    /* The peer sends nothing else until it has answered */
+    deadline = platform_get_time_ms() + (uint64_t)timeout_ms;
+    for (;;) {
+        uint64_t now = platform_get_time_ms();
+
+        if (now >= deadline ||
+            wait_for_socket(get_connection_socket(conn), (int)(deadline - now), 1, 0) == 0) {
+            LOG_WARNING("No answer to kernel TLS request, staying on user-space crypto");
+            return KTLS_ERROR_TIMEOUT;
+        }
+
+        response_len = sizeof(response);
+        result = receive_message(conn, &msg_type, response, &response_len);
+        if (result == PROTOCOL_IN_PROGRESS) {
+            continue;
+        }
+        if (result != PROTOCOL_SUCCESS) {
+            return KTLS_ERROR_SYSTEM;
+        }
+        break;
+    }
+
+    if (msg_type != MSG_KTLS_RESPONSE || response_len != KTLS_RESPONSE_SIZE) {
+        LOG_ERROR("Unexpected message type 0x%02x during kernel TLS switch", msg_type);
+        return KTLS_ERROR_PROTOCOL;
+    }
+
+    if (response[0] != KTLS_STATUS_ACCEPT) {
+        LOG_INFO("Peer refused kernel TLS, staying on user-space crypto");
+        return KTLS_ERROR_REJECTED;
+    }
+
+    memcpy(nonces, request + 2, KTLS_NONCE_SIZE);
+    memcpy(nonces + KTLS_NONCE_SIZE, response + 1, KTLS_NONCE_SIZE);
+
+    /* The peer has switched both directions; every byte from here on is
+     * a kernel TLS record */
+    result = derive_keys(conn, "initiator", nonces, &tx) == 0 &&
+             derive_keys(conn, "responder", nonces, &rx) == 0 ? KTLS_SUCCESS : KTLS_ERROR_KEY;
+    if (result == KTLS_SUCCESS &&
+        (install_keys(conn, 1, &tx) != 0 || install_keys(conn, 0, &rx) != 0)) {
+        result = KTLS_ERROR_SYSTEM;
+    }
+
+    memset(&tx, 0, sizeof(tx));
+    memset(&rx, 0, sizeof(rx));
+
+    if (result != KTLS_SUCCESS) {
+        LOG_ERROR("Kernel TLS switch failed after the peer accepted");
+        return result;
+    }
+
+    set_connection_kernel_crypto(conn, NETWORK_KERNEL_CRYPTO_TX | NETWORK_KERNEL_CRYPTO_RX);
+    LOG_INFO("Record crypto offloaded to kernel TLS (AES-256-GCM)");
+    return KTLS_SUCCESS;
+}
+
+/* Answer a peer's request */
+int ktls_accept(connection_t *conn, const unsigned char *request, size_t request_len) {
+    unsigned char nonces[2 * KTLS_NONCE_SIZE];
+    ktls_keys_t tx, rx;
+    int usable;
+
+    if (!conn) {
+        return KTLS_ERROR_PARAM;
+    }
+
+    usable = request && request_len == KTLS_REQUEST_SIZE &&
+             request[0] == KTLS_VERSION && request[1] == KTLS_CIPHER_AES_256_GCM &&
+             get_connection_crypto(conn) && !connection_kernel_crypto(conn) &&
+             ktls_available() && connection_owns_socket(conn);
+
+    if (usable) {
+        memcpy(nonces, request + 2, KTLS_NONCE_SIZE);
+        usable = crypto_random_bytes(nonces + KTLS_NONCE_SIZE, KTLS_NONCE_SIZE) == CRYPTO_SUCCESS &&
+                 derive_keys(conn, "initiator", nonces, &rx) == 0 &&
+                 derive_keys(conn, "responder", nonces, &tx) == 0;
+    }
+
+    /* The initiator waits for the answer, so whatever it sends next is
+     * already a kernel TLS record: receive offload goes in first */
+    if (usable) {
+        usable = attach_ulp(conn) == 0 && install_keys(conn, 0, &rx) == 0;
+    }
+
+    if (!usable) {
+        memset(&tx, 0, sizeof(tx));
+        memset(&rx, 0, sizeof(rx));
+        LOG_DEBUG("Refusing kernel TLS request");
+        return send_response(conn, KTLS_STATUS_REFUSE, NULL);
+    }
+
+    set_connection_kernel_crypto(conn, NETWORK_KERNEL_CRYPTO_RX);
+
+    /* The answer still goes out sealed in user space; only once it has
+     * left may the kernel take over sending */
+    if (send_response(conn, KTLS_STATUS_ACCEPT, nonces + KTLS_NONCE_SIZE) != KTLS_SUCCESS ||
+        drain(conn, KTLS_DRAIN_TIMEOUT_MS) != 0 ||
+        install_keys(conn, 1, &tx) != 0) {
+        memset(&tx, 0, sizeof(tx));
+        memset(&rx, 0, sizeof(rx));
+        LOG_ERROR("Kernel TLS switch failed after accepting");
+        return KTLS_ERROR_SYSTEM;
+    }
+
+    memset(&tx, 0, sizeof(tx));
+    memset(&rx, 0, sizeof(rx));
+
+    set_connection_kernel_crypto(conn, NETWORK_KERNEL_CRYPTO_TX | NETWORK_KERNEL_CRYPTO_RX);
+    LOG_INFO("Record crypto offloaded to kernel TLS (AES-256-GCM)");
+    return KTLS_SUCCESS;
+}
+
+/* Internal: Attach the kernel's TLS upper layer protocol */
+static int attach_ulp(connection_t *conn) {
+#ifdef KTLS_SUPPORTED
+    if (setsockopt(get_connection_socket(conn), IPPROTO_TCP, TCP_ULP, "tls", sizeof("tls")) < 0 &&
+        errno != EEXIST) {
+        LOG_DEBUG("TCP_ULP tls failed: %s", strerror(errno));
+        return -1;
+    }
+    return 0;
+#else
+    (void)conn;
+    return -1;
+#endif
+}
+
+/* Internal: Expand one direction's AES-GCM key and IV from the session secret */
+static int derive_keys(connection_t *conn, const char *direction,
+                       const unsigned char *nonces, ktls_keys_t *keys) {
+    crypto_session_t *session = get_connection_crypto(conn);
+    char label[64];
+
+    snprintf(label, sizeof(label), "cryptcat ktls %s key", direction);
+    if (crypto_session_derive_key(session, label, nonces, 2 * KTLS_NONCE_SIZE,
+                                  keys->key, sizeof(keys->key)) != CRYPTO_SUCCESS) {
+        return -1;
+    }
+
+    snprintf(label, sizeof(label), "cryptcat ktls %s iv", direction);
+    if (crypto_session_derive_key(session, label, nonces, 2 * KTLS_NONCE_SIZE,
+                                  keys->iv, sizeof(keys->iv)) != CRYPTO_SUCCESS) {
+        return -1;
+    }
+
+    return 0;
+}
+
+/* Internal: Hand one direction's keys to the kernel, TLS 1.3 framing */
+static int install_keys(connection_t *conn, int tx, const ktls_keys_t *keys) {
+#ifdef KTLS_SUPPORTED
+    struct tls12_crypto_info_aes_gcm_256 info;
+    int result;
+
+    memset(&info, 0, sizeof(info));
+    info.info.version = TLS_1_3_VERSION;
+    info.info.cipher_type = TLS_CIPHER_AES_GCM_256;
+    memcpy(info.key, keys->key, sizeof(info.key));
+    memcpy(info.salt, keys->iv, sizeof(info.salt));
+    memcpy(info.iv, keys->iv + sizeof(info.salt), sizeof(info.iv));
+
+    /* Record sequence numbers start at zero in both directions */
+    result = setsockopt(get_connection_socket(conn), SOL_TLS, tx ? TLS_TX : TLS_RX,
+                        &info, sizeof(info));
+    if (result < 0) {
+        LOG_DEBUG("SOL_TLS %s failed: %s", tx ? "TLS_TX" : "TLS_RX", strerror(errno));
+    }
+
+    memset(&info, 0, sizeof(info));
+    return result < 0 ? -1 : 0;
+#else
+    (void)conn;
+    (void)tx;
+    (void)keys;
+    return -1;
+#endif
+}
+
+/* Internal: Write queued output out before the sending side changes */
+static int drain(connection_t *conn, int timeout_ms) {
+    int pending;
+
+    while ((pending = flush_connection(conn)) > 0) {
+        if (wait_for_socket(get_connection_socket(conn), timeout_ms, 0, 1) <= 0) {
+            return -1;
+        }
+    }
+
+    return pending < 0 ? -1 : 0;
+}
+
+/* Internal: Answer a request */
+static int send_response(connection_t *conn, int status, const unsigned char *nonce) {
+    unsigned char response[KTLS_RESPONSE_SIZE];
+
+    response[0] = (unsigned char)status;
+    if (nonce) {
+        memcpy(response + 1, nonce, KTLS_NONCE_SIZE);
+    } else {
+        memset(response + 1, 0, KTLS_NONCE_SIZE);
+    }
+
+    if (send_message(conn, MSG_KTLS_RESPONSE, response, sizeof(response)) != PROTOCOL_SUCCESS) {
+        return KTLS_ERROR_SYSTEM;
+    }
+
+    return KTLS_SUCCESS;
+}
+
+/* Get error message */
+const char* ktls_strerror(int error_code) {
+    switch (error_code) {
+        case KTLS_SUCCESS:
+            return "Success";
+        case KTLS_ERROR_PARAM:
+            return "Invalid parameter";
+        case KTLS_ERROR_UNSUPPORTED:
+            return "Kernel TLS not supported";
+        case KTLS_ERROR_REJECTED:
+            return "Peer refused kernel TLS";
+        case KTLS_ERROR_TIMEOUT:
+            return "Peer did not answer";
+        case KTLS_ERROR_KEY:
+            return "Key derivation failed";
+        case KTLS_ERROR_PROTOCOL:
+            return "Unexpected message during switch";
+        case KTLS_ERROR_SYSTEM:
+            return "System call failed";
+        default:
+            return "Unknown error";
+    }
+}
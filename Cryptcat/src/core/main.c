@@ -5,9 +5,16 @@
  * License: MIT
  */
 
+#ifdef __linux__
+#define _GNU_SOURCE  /* struct ucred */
+#endif
+
 #include "crypto.h"
 #include "network.h"
 #include "protocol.h"
+#include "event_loop.h"
+#include "worker_pool.h"
+#include "agent.h"
 #include "file_transfer.h"
 #include "chat_mode.h"
 #include "p2p_network.h"
@@ -18,6 +25,10 @@
 #include <getopt.h>
 #include <signal.h>
 #include <time.h>
+#include <limits.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/socket.h>
 
 /* Application version */
 #define VERSION_MAJOR 1
@@ -29,6 +40,8 @@
 #define DEFAULT_PORT 4444
 #define DEFAULT_CHUNK_SIZE 16384
 #define DEFAULT_TIMEOUT 30
+#define RESTART_POLL_MS 250         /* Restart socket check while serving */
+#define RESTART_TIMEOUT_MS 10000    /* Per listener or session in a handoff */
 
 /* Application modes */
 typedef enum {
@@ -40,20 +53,37 @@ typedef enum {
     MODE_CHAT,
     MODE_P2P,
     MODE_SHELL,
-    MODE_PORT_FORWARD
+    MODE_PORT_FORWARD,
+    MODE_AGENT
 } app_mode_t;
 
 /* Global variables */
 static volatile int running = 1;
 static connection_t *current_connection = NULL;
+static worker_pool_t *current_pool = NULL;
 static file_transfer_t *current_transfer = NULL;
 static p2p_network_t *p2p_network = NULL;
+static agent_t *current_agent = NULL;
+
+/* Mode handlers */
+static int run_data_mode(connection_t *conn);
+static int run_echo_mode(connection_t *conn);
 
 /* Signal handler */
 static void signal_handler(int sig) {
     LOG_INFO("Received signal %d, shutting down...", sig);
     running = 0;
     
+    /* The listener's workers own their connections and clean up themselves */
+    if (current_pool) {
+        worker_pool_stop(current_pool);
+    }
+    
+    /* Likewise the agent's clients and pooled sessions */
+    if (current_agent) {
+        agent_stop(current_agent);
+    }
+    
     /* Cleanup */
     if (current_transfer) {
         cancel_file_transfer(current_transfer);
@@ -83,6 +113,21 @@ static void print_usage(void) {
     printf("  -e, --execute CMD      Execute command (remote shell)\n");
     printf("  -c, --chat             Encrypted chat mode\n");
     printf("  -f, --file FILE        Send/receive file\n");
+    printf("  --workers N            Listener worker threads (default: one per CPU)\n");
+    printf("  --pin-cpus             Pin workers to CPUs and steer connections to them\n");
+    printf("  --agent                Run a local agent that keeps warm sessions to peers\n");
+    printf("  --agent-socket PATH    Agent socket (default: $CRYPTCAT_AGENT_SOCK,\n");
+    printf("                         $XDG_RUNTIME_DIR/cryptcat-agent.sock)\n");
+    printf("  --via-agent            Connect or send files through the running agent\n");
+    printf("  --unix PATH            Listen or connect on a Unix-domain socket\n");
+    printf("  --seqpacket            Use SOCK_SEQPACKET with --unix (default: stream)\n");
+    printf("  --restart-socket PATH  Hand the listener and its sessions to a new process\n");
+    printf("                         that connects to PATH (zero-downtime restart)\n");
+    printf("  --takeover             Start by taking over from the listener at\n");
+    printf("                         --restart-socket\n");
+    printf("  --profile NAME         Socket tuning: default, interactive, bulk, wan\n");
+    printf("                         (default: $CRYPTCAT_SOCKET_PROFILE, else interactive\n");
+    printf("                         for chat and bulk for files)\n");
     printf("  --p2p                  Enable P2P networking\n");
     printf("  --p2p-port PORT        P2P listening port (default: 5555)\n");
     printf("  --p2p-bootstrap HOST   P2P bootstrap node\n");
@@ -92,9 +137,16 @@ static void print_usage(void) {
     printf("  -V, --version          Show version\n\n");
     printf("Examples:\n");
     printf("  cryptcat -k password -l -p 4444\n");
+    printf("  cryptcat -k password -l -p 4444 --workers 8 --pin-cpus\n");
     printf("  cryptcat -k password 192.168.1.100 4444\n");
     printf("  cryptcat -k secret -f document.pdf 192.168.1.100 5555\n");
     printf("  cryptcat -k secret -c 192.168.1.100 4444\n");
+    printf("  cryptcat -k secret --profile wan -f backup.tar far.example.org 5555\n");
+    printf("  cryptcat -k secret --agent &\n");
+    printf("  cryptcat --via-agent -f document.pdf 192.168.1.100 5555\n");
+    printf("  cryptcat -k secret -l --unix /run/cryptcat.sock\n");
+    printf("  cryptcat -k secret -l -p 4444 --restart-socket /run/cryptcat.restart\n");
+    printf("  cryptcat -k secret -l --takeover --restart-socket /run/cryptcat.restart\n");
     printf("  cryptcat --p2p --p2p-port 5555 --key password\n\n");
 }
 
@@ -111,7 +163,10 @@ static void print_version(void) {
 /* Parse command line arguments */
 static int parse_arguments(int argc, char *argv[], app_mode_t *mode,
                           char **host, int *port, char **password,
-                          char **filename, int *p2p_port, char **bootstrap_node) {
+                          char **filename, int *p2p_port, char **bootstrap_node,
+                          int *workers, int *pin_cpus, char **agent_socket,
+                          int *via_agent, int *profile, char **unix_path,
+                          int *seqpacket, char **restart_socket, int *takeover) {
     static struct option long_options[] = {
         {"listen", no_argument, 0, 'l'},
         {"port", required_argument, 0, 'p'},
@@ -122,6 +177,16 @@ static int parse_arguments(int argc, char *argv[], app_mode_t *mode,
         {"p2p", no_argument, 0, 256},
         {"p2p-port", required_argument, 0, 257},
         {"p2p-bootstrap", required_argument, 0, 258},
+        {"workers", required_argument, 0, 259},
+        {"pin-cpus", no_argument, 0, 260},
+        {"agent", no_argument, 0, 261},
+        {"agent-socket", required_argument, 0, 262},
+        {"via-agent", no_argument, 0, 263},
+        {"profile", required_argument, 0, 264},
+        {"unix", required_argument, 0, 265},
+        {"seqpacket", no_argument, 0, 266},
+        {"restart-socket", required_argument, 0, 267},
+        {"takeover", no_argument, 0, 268},
         {"verbose", no_argument, 0, 'v'},
         {"quiet", no_argument, 0, 'q'},
         {"help", no_argument, 0, 'h'},
@@ -133,6 +198,12 @@ static int parse_arguments(int argc, char *argv[], app_mode_t *mode,
     *mode = MODE_NONE;
     *port = DEFAULT_PORT;
     *p2p_port = 5555;
+    *workers = 0;
+    *pin_cpus = 0;
+    *via_agent = 0;
+    *profile = -1;
+    *seqpacket = 0;
+    *takeover = 0;
     
     while ((opt = getopt_long(argc, argv, "lp:k:e:cf:vqhV",
                              long_options, &option_index)) != -1) {
@@ -170,6 +241,47 @@ static int parse_arguments(int argc, char *argv[], app_mode_t *mode,
             case 258: /* --p2p-bootstrap */
                 *bootstrap_node = strdup(optarg);
                 break;
+            case 259: /* --workers */
+                *workers = atoi(optarg);
+                if (*workers <= 0 || *workers > WORKER_POOL_MAX_WORKERS) {
+                    fprintf(stderr, "Error: Invalid worker count\n");
+                    return -1;
+                }
+                break;
+            case 260: /* --pin-cpus */
+                *pin_cpus = 1;
+                break;
+            case 261: /* --agent */
+                *mode = MODE_AGENT;
+                break;
+            case 262: /* --agent-socket */
+                *agent_socket = strdup(optarg);
+                break;
+            case 263: /* --via-agent */
+                *via_agent = 1;
+                break;
+            case 264: { /* --profile */
+                network_profile_t parsed;
+                if (network_profile_parse(optarg, &parsed) != NETWORK_SUCCESS) {
+                    fprintf(stderr, "Error: Unknown socket profile '%s'\n", optarg);
+                    return -1;
+                }
+                *profile = (int)parsed;
+                break;
+            }
+            case 265: /* --unix */
+                *unix_path = strdup(optarg);
+                break;
+            case 266: /* --seqpacket */
+                *seqpacket = 1;
+                break;
+            case 267: /* --restart-socket */
+                *restart_socket = strdup(optarg);
+                break;
+            case 268: /* --takeover */
+                *takeover = 1;
+                *mode = MODE_LISTEN;
+                break;
             case 'v':
                 log_set_level(LOG_DEBUG);
                 break;
@@ -196,15 +308,20 @@ static int parse_arguments(int argc, char *argv[], app_mode_t *mode,
         *port = atoi(argv[optind]);
     }
     
-    /* Validate required parameters */
-    if (!*password) {
+    /* Validate required parameters (the agent holds the password) */
+    if (!*password && !*via_agent) {
         fprintf(stderr, "Error: Encryption password is required (-k option)\n");
         return -1;
     }
     
-    /* Set default mode if not specified */
+    if (*takeover && !*restart_socket) {
+        fprintf(stderr, "Error: --takeover needs --restart-socket\n");
+        return -1;
+    }
+    
+    /* Set default mode if not specified; a socket path names the peer too */
     if (*mode == MODE_NONE) {
-        *mode = *host ? MODE_CONNECT : MODE_LISTEN;
+        *mode = *host || *unix_path ? MODE_CONNECT : MODE_LISTEN;
     }
     
     return 0;
@@ -249,15 +366,24 @@ static int initialize_app(void) {
 
 /* Connect mode */
 static int run_connect_mode(const char *host, int port, const char *password,
-                           app_mode_t mode, const char *filename) {
+                           app_mode_t mode, const char *filename,
+                           const char *unix_path, int seqpacket) {
     int result;
     
-    LOG_INFO("Connecting to %s:%d...", host, port);
-    
-    current_connection = connect_to_host(host, port, password);
-    if (!current_connection) {
-        fprintf(stderr, "Failed to connect to %s:%d\n", host, port);
-        return -1;
+    if (unix_path) {
+        LOG_INFO("Connecting to %s...", unix_path);
+        current_connection = connect_to_unix(unix_path, seqpacket, password);
+        if (!current_connection) {
+            fprintf(stderr, "Failed to connect to %s\n", unix_path);
+            return -1;
+        }
+    } else {
+        LOG_INFO("Connecting to %s:%d...", host, port);
+        current_connection = connect_to_host(host, port, password);
+        if (!current_connection) {
+            fprintf(stderr, "Failed to connect to %s:%d\n", host, port);
+            return -1;
+        }
     }
     
     /* Perform handshake (client side) */
@@ -269,7 +395,11 @@ static int run_connect_mode(const char *host, int port, const char *password,
         return -1;
     }
     
-    LOG_INFO("Connected and authenticated to %s:%d", host, port);
+    if (unix_path) {
+        LOG_INFO("Connected and authenticated to %s", unix_path);
+    } else {
+        LOG_INFO("Connected and authenticated to %s:%d", host, port);
+    }
     
     /* Run selected mode */
     switch (mode) {
@@ -299,24 +429,55 @@ static int run_connect_mode(const char *host, int port, const char *password,
     }
 }
 
-/* Listen mode */
-static int run_listen_mode(int port, const char *password) {
-    int result;
-    connection_t *client;
+/* Listen mode: report a client once its handshake is done */
+static void on_client_connect(event_loop_t *loop, connection_t *conn, void *ctx) {
+    connection_info_t info = get_connection_info(conn);
     
-    LOG_INFO("Starting listener on port %d...", port);
+    (void)loop;
+    (void)ctx;
     
-    current_connection = create_listener(port, password);
-    if (!current_connection) {
-        fprintf(stderr, "Failed to create listener on port %d\n", port);
-        return -1;
+    LOG_INFO("Client connected from %s:%d", info.remote_host, info.remote_port);
+    printf("Client connected: %s:%d\n", info.remote_host, info.remote_port);
+}
+
+/* Listen mode: echo data back to the client that sent it */
+static void on_client_message(event_loop_t *loop, connection_t *conn, message_type_t type,
+                              const unsigned char *payload, size_t payload_len,
+                              void *ctx) {
+    (void)ctx;
+    
+    if (type != MSG_DATA) {
+        return;
     }
     
-    printf("Listening on port %d (encrypted with password)\n", port);
-    printf("Press Ctrl+C to stop listening\n\n");
+    if (send_message(conn, MSG_DATA, payload, payload_len) != PROTOCOL_SUCCESS) {
+        LOG_ERROR("Failed to echo data");
+        event_loop_close_connection(loop, conn);
+        return;
+    }
+    
+    /* Also print to console */
+    printf("Client: %.*s\n", (int)payload_len, payload);
+}
+
+/* Listen mode: report a departing client */
+static void on_client_close(event_loop_t *loop, connection_t *conn, int reason, void *ctx) {
+    connection_info_t info = get_connection_info(conn);
+    
+    (void)loop;
+    (void)ctx;
+    
+    printf("Client disconnected: %s:%d (%s)\n", info.remote_host, info.remote_port,
+           protocol_strerror(reason));
+}
+
+/* Listen mode without an event loop: serve one client at a time */
+static int run_sequential_listen(connection_t *listener, const char *password) {
+    int result;
+    connection_t *client;
     
     while (running) {
-        client = accept_connection(current_connection);
+        client = accept_connection(listener);
         if (!client) {
             if (running) {
                 LOG_ERROR("Failed to accept connection");
@@ -347,6 +508,237 @@ static int run_listen_mode(int port, const char *password) {
     return 0;
 }
 
+/* Listen mode on a Unix-domain socket: local clients, one at a time */
+static int run_unix_listen_mode(const char *path, int seqpacket, const char *password) {
+    connection_t *listener;
+    int result;
+    
+    listener = create_unix_listener(path, seqpacket, password);
+    if (!listener) {
+        fprintf(stderr, "Failed to listen on %s\n", path);
+        return -1;
+    }
+    
+    printf("Listening on %s (encrypted with password)\n", path);
+    printf("Press Ctrl+C to stop listening\n\n");
+    
+    current_connection = listener;
+    result = run_sequential_listen(listener, password);
+    unlink(path);
+    return result;
+}
+
+/* Listen mode: only a process of our own user may take over; the
+ * sessions' keys travel over the restart socket */
+static int successor_allowed(connection_t *conn) {
+#ifdef __linux__
+    struct ucred cred;
+    socklen_t len = sizeof(cred);
+    
+    if (getsockopt(get_connection_socket(conn), SOL_SOCKET, SO_PEERCRED, &cred, &len) != 0) {
+        return 0;
+    }
+    return cred.uid == geteuid();
+#else
+    (void)conn;
+    return 1;                       /* The socket's directory is the only check */
+#endif
+}
+
+/* Listen mode: serve until stopped or until a new process connects to
+ * the restart socket */
+static connection_t* wait_for_successor(connection_t *control) {
+    struct pollfd pfd;
+    
+    pfd.fd = get_connection_socket(control);
+    pfd.events = POLLIN;
+    
+    while (running) {
+        connection_t *successor;
+        
+        pfd.revents = 0;
+        if (poll(&pfd, 1, RESTART_POLL_MS) <= 0) {
+            continue;
+        }
+        
+        successor = accept_connection(control);
+        if (!successor) {
+            continue;
+        }
+        
+        if (!successor_allowed(successor)) {
+            LOG_WARNING("Refused a takeover by a process of another user");
+            close_connection(successor);
+            free(successor);
+            continue;
+        }
+        
+        return successor;
+    }
+    
+    return NULL;
+}
+
+/* Listen mode: build the pool from the listener at the restart socket */
+static worker_pool_t* take_over_listener(const char *restart_path, const char *password,
+                                         const event_loop_callbacks_t *callbacks,
+                                         const worker_pool_options_t *options) {
+    connection_t *channel;
+    worker_pool_t *pool;
+    
+    channel = connect_to_unix(restart_path, 0, NULL);
+    if (!channel) {
+        fprintf(stderr, "No listener to take over at %s\n", restart_path);
+        return NULL;
+    }
+    
+    pool = worker_pool_take_over(get_connection_socket(channel), password, callbacks,
+                                 options, RESTART_TIMEOUT_MS);
+    close_connection(channel);
+    free(channel);
+    
+    if (!pool) {
+        fprintf(stderr, "Failed to take over the listener at %s\n", restart_path);
+    }
+    return pool;
+}
+
+/* Listen mode */
+static int run_listen_mode(int port, const char *password, int workers, int pin_cpus,
+                           const char *restart_path, int takeover) {
+    event_loop_callbacks_t callbacks = {
+        .on_connect = on_client_connect,
+        .on_message = on_client_message,
+        .on_close = on_client_close,
+        .ctx = NULL
+    };
+    worker_pool_options_t options = {
+        .workers = workers,
+        .pin_cpus = pin_cpus,
+        .cpu_steering = pin_cpus,
+        .keepalive_ms = EVENT_LOOP_DEFAULT_KEEPALIVE_MS
+    };
+    connection_t *listener;
+    connection_t *control = NULL;
+    connection_t *successor = NULL;
+    event_loop_stats_t stats;
+    int result;
+    
+    /* Listeners and sessions come from the process being replaced */
+    if (takeover) {
+        current_pool = take_over_listener(restart_path, password, &callbacks, &options);
+        if (!current_pool) {
+            return -1;
+        }
+        
+        printf("Took over the listener with %d worker%s (%u sessions)\n",
+               worker_pool_size(current_pool), worker_pool_size(current_pool) == 1 ? "" : "s",
+               worker_pool_get_stats(current_pool).connections);
+    }
+    
+    /* One reuseport listener and event loop per worker thread */
+    if (!current_pool) {
+        LOG_INFO("Starting listener on port %d...", port);
+        current_pool = worker_pool_create(port, password, &callbacks, &options);
+    }
+    if (!current_pool) {
+        /* Fall back to one client at a time where no event loop backend
+         * is available */
+        listener = create_listener(port, password);
+        if (!listener) {
+            fprintf(stderr, "Failed to create listener on port %d\n", port);
+            return -1;
+        }
+        
+        printf("Listening on port %d (encrypted with password)\n", port);
+        printf("Press Ctrl+C to stop listening\n\n");
+        
+        if (restart_path) {
+            fprintf(stderr, "Warning: Hot restart needs the worker pool; not available\n");
+        }
+        
+        current_connection = listener;
+        return run_sequential_listen(listener, password);
+    }
+    
+    if (!takeover) {
+        printf("Listening on port %d with %d worker%s (encrypted with password)\n", port,
+               worker_pool_size(current_pool), worker_pool_size(current_pool) == 1 ? "" : "s");
+    }
+    printf("Press Ctrl+C to stop listening\n\n");
+    
+    /* A process taking over binds the path again once it has everything */
+    if (restart_path) {
+        control = create_unix_listener(restart_path, 0, NULL);
+        if (!control) {
+            fprintf(stderr, "Warning: Hot restart not available on %s\n", restart_path);
+        }
+    }
+    
+    result = worker_pool_start(current_pool);
+    if (result == WORKER_POOL_SUCCESS) {
+        if (control) {
+            successor = wait_for_successor(control);
+            close_connection(control);
+            free(control);
+            unlink(restart_path);
+            worker_pool_stop(current_pool);
+        }
+        result = worker_pool_wait(current_pool);
+    } else {
+        fprintf(stderr, "Failed to start workers: %s\n", worker_pool_strerror(result));
+        if (control) {
+            close_connection(control);
+            free(control);
+            unlink(restart_path);
+        }
+    }
+    
+    /* Workers have returned, so their loops are ours to hand over */
+    if (successor) {
+        int passed = worker_pool_hand_off(current_pool, get_connection_socket(successor),
+                                          RESTART_TIMEOUT_MS);
+        
+        if (passed >= 0) {
+            printf("Handed the listener and %d session%s to the new process\n",
+                   passed, passed == 1 ? "" : "s");
+        } else {
+            fprintf(stderr, "Handoff failed: %s\n", worker_pool_strerror(passed));
+            result = passed;
+        }
+        close_connection(successor);
+        free(successor);
+    }
+    
+    stats = worker_pool_get_stats(current_pool);
+    LOG_INFO("Listener stopped: %llu accepted, %llu handshakes (%llu failed), "
+             "peak %u connections, %llu taken over, %llu handed over",
+             (unsigned long long)stats.accepted,
+             (unsigned long long)stats.handshakes_completed,
+             (unsigned long long)stats.handshakes_failed,
+             stats.peak_connections,
+             (unsigned long long)stats.adopted,
+             (unsigned long long)stats.detached);
+    
+    for (int i = 0; i < worker_pool_size(current_pool); i++) {
+        worker_stats_t load;
+        
+        if (worker_pool_get_worker_stats(current_pool, i, &load) != WORKER_POOL_SUCCESS) {
+            continue;
+        }
+        LOG_INFO("Worker %d (cpu %d): %llu accepted, %llu messages, peak %u connections",
+                 i, load.cpu,
+                 (unsigned long long)load.loop.accepted,
+                 (unsigned long long)load.loop.messages,
+                 load.loop.peak_connections);
+    }
+    
+    worker_pool_destroy(current_pool);
+    current_pool = NULL;
+    
+    return result == WORKER_POOL_SUCCESS ? 0 : -1;
+}
+
 /* Simple data mode (stdin -> network, network -> stdout) */
 static int run_data_mode(connection_t *conn) {
     unsigned char buffer[8192];
@@ -374,8 +766,7 @@ static int run_data_mode(connection_t *conn) {
         if (FD_ISSET(STDIN_FILENO, &readfds)) {
             ssize_t read_bytes = read(STDIN_FILENO, buffer, sizeof(buffer));
             if (read_bytes > 0) {
-                int sent = send_data(conn, buffer, read_bytes);
-                if (sent < 0) {
+                if (send_message(conn, MSG_DATA, buffer, read_bytes) != PROTOCOL_SUCCESS) {
                     LOG_ERROR("Failed to send data");
                     break;
                 }
@@ -385,17 +776,21 @@ static int run_data_mode(connection_t *conn) {
             }
         }
         
-        /* Check socket */
+        /* Check socket (the listener frames and echoes every message) */
         if (FD_ISSET(conn->sockfd, &readfds)) {
-            int received = receive_data(conn, buffer, sizeof(buffer));
-            if (received > 0) {
-                fwrite(buffer, 1, received, stdout);
-                fflush(stdout);
-            } else if (received == NETWORK_ERROR_CLOSED) {
+            message_type_t msg_type;
+            size_t received = sizeof(buffer);
+            int result = receive_message(conn, &msg_type, buffer, &received);
+            if (result == PROTOCOL_SUCCESS) {
+                if (msg_type == MSG_DATA) {
+                    fwrite(buffer, 1, received, stdout);
+                    fflush(stdout);
+                }
+            } else if (result == PROTOCOL_ERROR_CLOSED) {
                 printf("\nConnection closed by peer\n");
                 break;
-            } else if (received < 0) {
-                LOG_ERROR("Failed to receive data");
+            } else if (result != PROTOCOL_IN_PROGRESS) {
+                LOG_ERROR("Failed to receive data: %s", protocol_strerror(result));
                 break;
             }
         }
@@ -407,28 +802,152 @@ static int run_data_mode(connection_t *conn) {
 /* Echo mode for server */
 static int run_echo_mode(connection_t *conn) {
     unsigned char buffer[8192];
-    int received;
+    message_type_t msg_type;
+    size_t received;
+    int result;
     
     printf("Echo mode for client %s:%d\n", 
            conn->remote_host, conn->remote_port);
     
     while (running) {
-        received = receive_data(conn, buffer, sizeof(buffer));
-        if (received > 0) {
+        int ready = wait_for_socket(conn->sockfd, 1000, 1, 0);
+        if (ready < 0) {
+            LOG_ERROR("Error in echo mode: socket failed");
+            break;
+        } else if (ready == 0) {
+            continue;
+        }
+        
+        received = sizeof(buffer);
+        result = receive_message(conn, &msg_type, buffer, &received);
+        if (result == PROTOCOL_SUCCESS && msg_type == MSG_DATA) {
             /* Echo back */
-            send_data(conn, buffer, received);
+            send_message(conn, MSG_DATA, buffer, received);
             
             /* Also print to console */
-            printf("Client: %.*s\n", received, buffer);
-        } else if (received == NETWORK_ERROR_CLOSED) {
+            printf("Client: %.*s\n", (int)received, buffer);
+        } else if (result == PROTOCOL_ERROR_CLOSED) {
             printf("Client disconnected\n");
             break;
-        } else if (received < 0) {
-            LOG_ERROR("Error in echo mode");
+        } else if (result != PROTOCOL_SUCCESS && result != PROTOCOL_IN_PROGRESS) {
+            LOG_ERROR("Error in echo mode: %s", protocol_strerror(result));
+            break;
+        }
+    }
+    
+    return 0;
+}
+
+/* Agent mode: lend warm sessions to local clients */
+static int run_agent_mode(const char *password, const char *agent_socket) {
+    char default_path[PATH_MAX];
+    agent_stats_t stats;
+    int result;
+    
+    if (!agent_socket) {
+        if (agent_default_socket_path(default_path, sizeof(default_path)) != AGENT_SUCCESS) {
+            fprintf(stderr, "Error: No usable agent socket path\n");
+            return -1;
+        }
+        agent_socket = default_path;
+    }
+    
+    current_agent = agent_create(agent_socket, password, NULL);
+    if (!current_agent) {
+        fprintf(stderr, "Failed to start agent on %s\n", agent_socket);
+        return -1;
+    }
+    
+    printf("Agent listening on %s\n", agent_socket);
+    printf("Press Ctrl+C to stop\n\n");
+    
+    result = agent_run(current_agent);
+    
+    stats = agent_get_stats(current_agent);
+    LOG_INFO("Agent stopped: %llu requests, %llu sessions opened, %llu reused, "
+             "%llu expired, %llu passed",
+             (unsigned long long)stats.requests,
+             (unsigned long long)stats.sessions_opened,
+             (unsigned long long)stats.sessions_reused,
+             (unsigned long long)stats.sessions_expired,
+             (unsigned long long)stats.sessions_passed);
+    
+    agent_destroy(current_agent);
+    current_agent = NULL;
+    
+    return result == AGENT_SUCCESS ? 0 : -1;
+}
+
+/* Connect mode through the agent: no resolve, connect or handshake here */
+static int run_agent_client_mode(const char *host, int port, app_mode_t mode,
+                                 const char *filename, const char *agent_socket) {
+    unsigned char buffer[8192];
+    char path[PATH_MAX];
+    uint64_t bytes_sent = 0;
+    int result, fd, stdin_open = 1;
+    
+    if (mode == MODE_FILE_SEND) {
+        if (!filename || !realpath(filename, path)) {
+            fprintf(stderr, "Error: Cannot resolve file '%s'\n", filename ? filename : "");
+            return -1;
+        }
+        
+        result = agent_send_file(agent_socket, host, port, path, &bytes_sent);
+        if (result != AGENT_SUCCESS) {
+            fprintf(stderr, "File transfer through agent failed: %s\n",
+                    agent_strerror(result));
+            return -1;
+        }
+        
+        printf("Sent %llu bytes to %s:%d\n", (unsigned long long)bytes_sent, host, port);
+        return 0;
+    }
+    
+    if (mode != MODE_CONNECT) {
+        fprintf(stderr, "Error: Only data and file modes can use the agent\n");
+        return -1;
+    }
+    
+    result = agent_open_stream(agent_socket, host, port, &fd);
+    if (result != AGENT_SUCCESS) {
+        fprintf(stderr, "Failed to connect through agent: %s\n", agent_strerror(result));
+        return -1;
+    }
+    
+    /* stdin -> agent -> peer, peer -> agent -> stdout; after stdin ends the
+     * agent closes the stream once the peer goes quiet */
+    while (running) {
+        fd_set readfds;
+        ssize_t got;
+        
+        FD_ZERO(&readfds);
+        if (stdin_open) FD_SET(STDIN_FILENO, &readfds);
+        FD_SET(fd, &readfds);
+        
+        if (select(fd + 1, &readfds, NULL, NULL, NULL) < 0) {
+            if (errno == EINTR) continue;
             break;
         }
+        
+        if (stdin_open && FD_ISSET(STDIN_FILENO, &readfds)) {
+            got = read(STDIN_FILENO, buffer, sizeof(buffer));
+            if (got > 0) {
+                if (send(fd, buffer, (size_t)got, MSG_NOSIGNAL) != got) break;
+            } else {
+                stdin_open = 0;
+                shutdown(fd, SHUT_WR);
+            }
+        }
+        
+        if (FD_ISSET(fd, &readfds)) {
+            got = read(fd, buffer, sizeof(buffer));
+            if (got <= 0) break;
+            fwrite(buffer, 1, (size_t)got, stdout);
+            fflush(stdout);
+        }
     }
     
+    close(fd);
     return 0;
 }
 
@@ -498,13 +1017,24 @@ int main(int argc, char *argv[]) {
     char *password = NULL;
     char *filename = NULL;
     char *bootstrap_node = NULL;
+    char *agent_socket = NULL;
+    char *unix_path = NULL;
+    char *restart_socket = NULL;
     int port = DEFAULT_PORT;
     int p2p_port = 5555;
+    int workers = 0;
+    int pin_cpus = 0;
+    int via_agent = 0;
+    int profile = -1;
+    int seqpacket = 0;
+    int takeover = 0;
     int result = 0;
     
     /* Parse command line arguments */
     if (parse_arguments(argc, argv, &mode, &host, &port, &password,
-                       &filename, &p2p_port, &bootstrap_node) != 0) {
+                       &filename, &p2p_port, &bootstrap_node,
+                       &workers, &pin_cpus, &agent_socket, &via_agent, &profile,
+                       &unix_path, &seqpacket, &restart_socket, &takeover) != 0) {
         return 1;
     }
     
@@ -513,14 +1043,49 @@ int main(int argc, char *argv[]) {
         return 1;
     }
     
+    /* Tune sockets for the mode unless told otherwise */
+    if (profile < 0 && network_get_default_profile() == NETWORK_PROFILE_DEFAULT) {
+        if (mode == MODE_CHAT) {
+            profile = NETWORK_PROFILE_INTERACTIVE;
+        } else if (mode == MODE_FILE_SEND) {
+            profile = NETWORK_PROFILE_BULK;
+        }
+    }
+    if (profile >= 0) {
+        network_set_default_profile((network_profile_t)profile);
+    }
+    
     /* Run selected mode */
+    if (via_agent) {
+        if (host) {
+            result = run_agent_client_mode(host, port, mode, filename, agent_socket);
+        } else {
+            fprintf(stderr, "Error: Host required for this mode\n");
+            result = 1;
+        }
+        mode = MODE_NONE;
+    }
+    
     switch (mode) {
+        case MODE_NONE:
+            break;
+            
         case MODE_CONNECT:
-            result = run_connect_mode(host, port, password, mode, filename);
+            result = run_connect_mode(host, port, password, mode, filename,
+                                      unix_path, seqpacket);
+            break;
+            
+        case MODE_AGENT:
+            result = run_agent_mode(password, agent_socket);
             break;
             
         case MODE_LISTEN:
-            result = run_listen_mode(port, password);
+            if (unix_path) {
+                result = run_unix_listen_mode(unix_path, seqpacket, password);
+            } else {
+                result = run_listen_mode(port, password, workers, pin_cpus,
+                                         restart_socket, takeover);
+            }
             break;
             
         case MODE_P2P:
@@ -529,12 +1094,13 @@ int main(int argc, char *argv[]) {
             
         case MODE_CHAT:
         case MODE_FILE_SEND:
-            if (!host) {
+            if (!host && !unix_path) {
                 fprintf(stderr, "Error: Host required for this mode\n");
                 result = 1;
                 break;
             }
-            result = run_connect_mode(host, port, password, mode, filename);
+            result = run_connect_mode(host, port, password, mode, filename,
+                                      unix_path, seqpacket);
             break;
             
         default:
@@ -567,6 +1133,9 @@ int main(int argc, char *argv[]) {
     }
     if (filename) free(filename);
     if (bootstrap_node) free(bootstrap_node);
+    if (agent_socket) free(agent_socket);
+    if (unix_path) free(unix_path);
+    if (restart_socket) free(restart_socket);
     
     LOG_INFO("Cryptcat shutdown complete");
     return result;
@@ -5,24 +5,95 @@
  * License: MIT
  */
 
+#ifdef __linux__
+#define _GNU_SOURCE  /* MSG_ZEROCOPY, SO_ZEROCOPY, MSG_CMSG_CLOEXEC */
+#endif
+
 #include "network.h"
 #include "crypto.h"
+#include "compression.h"
+#include "datagram.h"
 #include "platform.h"
+#include "resolver.h"
 #include "utils/logger.h"
+#include "utils/memory_utils.h"
 #include <stdio.h>
+#include <stddef.h>
 #include <stdlib.h>
 #include <string.h>
 #include <errno.h>
 #include <time.h>
 
+#ifndef _WIN32
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+#ifdef __linux__
+#include <sys/sendfile.h>
+#endif
+
+#if defined(__linux__) && defined(SO_ZEROCOPY) && defined(MSG_ZEROCOPY)
+#include <linux/errqueue.h>
+#include <sys/epoll.h>
+#define NETWORK_ZEROCOPY
+#endif
+
 /* Network constants */
 #define DEFAULT_PORT 4444
-#define MAX_CONNECTIONS 128
+#define LISTEN_BACKLOG SOMAXCONN   /* Event loop drains bursts of thousands */
 #define RECV_TIMEOUT_SEC 30
 #define SEND_TIMEOUT_SEC 30
-#define KEEPALIVE_INTERVAL 60
+#define SEND_QUEUE_LIMIT (16 * 1024 * 1024) /* Hard cap on queued output */
+#define RECORD_OVERHEAD 64          /* Worst-case growth of a sealed record */
+#define RECORD_LENGTH_SIZE 4        /* Big-endian length in front of each sealed record */
+#define TX_SEGMENT_SIZE 65536       /* Small records are sealed back to back */
+#define MAX_GATHER_SEGMENTS 64      /* iovecs per sendmsg() */
+#define ZEROCOPY_COPIED_LIMIT 8     /* Copied completions in a row before auto mode gives up */
+#define ZEROCOPY_PARKED_INITIAL 16  /* Out-of-order completion ranges; the array doubles */
+#define ZEROCOPY_LINGER_MS 10000    /* A closed socket still pinned by then is reset */
+#define REAP_EVENTS 64              /* Reap list wakeups collected per epoll_wait() */
+#define SPLICE_CHUNK (256 * 1024)   /* Bytes moved through the pipe per splice() */
+#define FILE_COPY_CHUNK 65536       /* recv()/pwrite() fallback, staged in the receive ring */
+#define RING_MIN_SIZE 4096          /* Per-connection RX/TX buffers start here, in these steps */
+#define CACHE_LINE_SIZE 64
 #define MAX_RETRIES 3
-#define BACKOFF_DELAY_MS 1000
+#define BACKOFF_BASE_MS 250         /* Retry delay cap doubles per round... */
+#define BACKOFF_MAX_MS 8000         /* ...up to this; the delay is drawn below it */
+#define CONNECT_ATTEMPT_DELAY_MS 250 /* Stagger between raced addresses (RFC 8305) */
+#define CONNECT_TIMEOUT_MS 10000    /* One round of racing */
+#define MAX_CONNECT_ATTEMPTS 16     /* Addresses raced per round */
+#define PROFILE_ENV "CRYPTCAT_SOCKET_PROFILE"
+#define SEQPACKET_READ_MAX SEQPACKET_WRITE_MAX /* Receive ring room per packet read */
+#define SEQPACKET_WRITE_MAX 16384   /* Largest packet written; fits the event loop's recv buffers */
+#define HANDOFF_MAGIC 0x43435048    /* "CCPH": a connection passed over a Unix socket */
+#define HANDOFF_VERSION 1
+#define HANDOFF_PREFIX_SIZE 12      /* magic(4) | version(1) | reserved(3) | body length(4) */
+#define HANDOFF_MAX_BODY (4 * 1024 * 1024)
+
+#ifdef MSG_CMSG_CLOEXEC
+#define HANDOFF_RECV_FLAGS MSG_CMSG_CLOEXEC /* Passed sockets stay out of exec()ed children */
+#else
+#define HANDOFF_RECV_FLAGS 0
+#endif
+
+/* Values of connection_t.rx_staged */
+#define RX_STAGED_BACKEND 1         /* An I/O backend stages what it reads */
+#define RX_STAGED_PACKETS 2         /* Sequenced packets are read whole into the ring */
+#define RX_STAGED_CARRIED 3         /* Stream input left by a backend or a handoff, read first */
+
+/* connection handoff flags */
+#define HANDOFF_ENCRYPTED 0x01
+#define HANDOFF_LISTENING 0x02
+#define HANDOFF_SEQPACKET 0x04
+#define HANDOFF_CRYPTO 0x08
 
 /* Connection states */
 typedef enum {
@@ -35,37 +106,227 @@ typedef enum {
     STATE_ERROR
 } connection_state_t;
 
-/* Complete connection structure */
+/* Zerocopy use (see set_connection_zerocopy) */
+typedef enum {
+    ZEROCOPY_AUTO = 0,              /* Large records; off once the kernel keeps copying */
+    ZEROCOPY_FORCED,                /* Large records, even if copied */
+    ZEROCOPY_OFF
+} zerocopy_mode_t;
+
+/* A run of sealed records in the output queue */
+typedef struct tx_segment_s {
+    struct tx_segment_s *next;
+    size_t len;                     /* Bytes sealed into data */
+    size_t sent;                    /* Bytes the socket has taken */
+    size_t cap;
+    uint32_t zc_id;                 /* Last zerocopy send that covered it */
+    int zerocopy;                   /* Sent with MSG_ZEROCOPY */
+    int pinned;                     /* The kernel references it until zc_id completes */
+    unsigned char data[];
+} tx_segment_t;
+
+/* Output the kernel still references after zerocopy sends, freed as
+ * its completions arrive */
+typedef struct {
+    tx_segment_t *head;             /* Written, waiting for completion */
+    tx_segment_t *tail;
+    uint32_t next;                  /* Id the kernel gives the next zerocopy send */
+    uint32_t done;                  /* Every id below this has completed */
+    uint32_t (*parked)[2];          /* Completed ranges past a gap */
+    int parked_count;
+    int parked_cap;
+} zerocopy_pins_t;
+
+/* A closed socket kept open until the kernel releases its pinned output;
+ * the completions arrive on its error queue */
+typedef struct pinned_socket_s {
+    struct pinned_socket_s *next;
+    int sockfd;
+    uint64_t deadline_ms;           /* Reset if still pinned by then */
+    zerocopy_pins_t pins;
+} pinned_socket_t;
+
+/* Per-connection byte ring. A mirrored ring maps its pages twice, so
+ * data[i] and data[i + size] alias and a record never wraps; otherwise
+ * readable bytes are moved to the front when the tail runs out */
+typedef struct {
+    unsigned char *data;            /* Cache-line aligned */
+    size_t size;
+    size_t head;                    /* Read offset */
+    size_t len;                     /* Readable bytes */
+    int mirrored;
+} byte_ring_t;
+
+/* Connection state touched only at setup, teardown, handoff and zerocopy
+ * completion. Allocated with the connection and released by
+ * close_connection(), so the struct the event path reads stays small */
+typedef struct {
+    zerocopy_pins_t zc;             /* Pinned output, waiting for completion */
+    int zc_mode;                    /* zerocopy_mode_t */
+    int zc_socket;                  /* SO_ZEROCOPY: 0 untried, 1 set, -1 refused */
+    int zc_copied_run;              /* Consecutive completions the kernel copied */
+    uint64_t zc_sends;
+    uint64_t zc_copied;
+    int rx_pipe[2];                 /* splice() pipe for clear file data */
+    datagram_t *datagram;           /* UDP channel beside the stream */
+    void (*early_release)(void *early); /* Frees early_data */
+    time_t connected_at;            /* Connection timestamp */
+    char *password;                 /* Encryption password */
+    int remote_port;                /* Remote port */
+    socklen_t addr_len;             /* Address length */
+    struct sockaddr_storage addr;   /* Remote address */
+    char remote_host[256];          /* Remote hostname */
+} connection_cold_t;
+
+/* Complete connection structure, grouped by cache line. An event on a
+ * ready connection reads the first line and a record moves through the
+ * second and third; everything else is behind cold */
 typedef struct connection_s {
+    /* Hot: descriptor, state, keys, staged input and flags */
+    _Alignas(CACHE_LINE_SIZE)
     int sockfd;                     /* Socket file descriptor */
     connection_state_t state;       /* Current connection state */
     crypto_session_t *crypto;       /* Cryptographic session */
-    struct sockaddr_storage addr;   /* Remote address */
-    socklen_t addr_len;             /* Address length */
-    char remote_host[256];          /* Remote hostname */
-    int remote_port;                /* Remote port */
-    time_t connected_at;            /* Connection timestamp */
-    time_t last_activity;           /* Last data transfer */
+    byte_ring_t rx_ring;            /* Staged input, or ciphertext being opened */
+    uint8_t rx_staged;              /* Reads come from rx_ring (RX_STAGED_*), not recv() */
+    uint8_t is_encrypted;           /* Encryption enabled flag */
+    uint8_t tx_async;               /* Leave output queued instead of waiting */
+    uint8_t tx_blocked;             /* Crossed high, not yet back below low */
+    uint8_t tx_corked;              /* Owner flushes; send_data() only queues */
+    uint8_t kernel_crypto;          /* NETWORK_KERNEL_CRYPTO_* sealed by the kernel */
+    uint8_t is_listening;           /* Listening socket flag */
+    uint8_t rx_pipe_open;
+
+    /* Per record: framing, sequencing and the output queue */
+    _Alignas(CACHE_LINE_SIZE)
+    compression_ctx_t *compression; /* Negotiated record compression */
+    platform_mutex_t send_lock;     /* Serializes message sends */
+    uint64_t send_sequence;         /* Next outgoing message sequence */
+    uint64_t recv_sequence;         /* Next expected incoming sequence */
+    tx_segment_t *tx_head;          /* Sealed records the socket has not taken */
+    tx_segment_t *tx_tail;
+    size_t tx_pending;              /* Unwritten bytes across the queue */
+    connection_send_hook_t send_hook; /* Replaces send() when set */
+    void *send_hook_ctx;
+    connection_output_hook_t tx_notify; /* Queue went from empty to non-empty */
+    void *tx_notify_ctx;
+    byte_ring_t tx_ring;            /* Message assembly and sealing (send lock held) */
+    size_t rx_frame;                /* Frame returned last, still at the head of rx_ring */
+    uint8_t rx_quickack;            /* Re-arm TCP_QUICKACK after each read */
+    uint8_t seqpacket;              /* SOCK_SEQPACKET: writes capped at SEQPACKET_WRITE_MAX */
+    void *early_data;               /* Sent before the peer took the keys (protocol layer) */
+
+    /* Counters, written per record but read rarely */
     uint64_t bytes_sent;            /* Total bytes sent */
     uint64_t bytes_received;        /* Total bytes received */
     uint32_t packets_sent;          /* Total packets sent */
     uint32_t packets_received;      /* Total packets received */
-    int is_listening;               /* Listening socket flag */
-    int is_encrypted;               /* Encryption enabled flag */
-    char *password;                 /* Encryption password */
+    time_t last_activity;           /* Last data transfer */
+    uint64_t send_calls;            /* Write syscalls */
+    size_t tx_high_watermark;       /* 0 = NETWORK_SEND_HIGH_WATERMARK */
+    size_t tx_low_watermark;        /* 0 = NETWORK_SEND_LOW_WATERMARK */
     void *user_data;                /* User-defined data */
+
+    connection_cold_t *cold;        /* NULL once closed */
 } connection_t;
 
+_Static_assert(offsetof(connection_t, compression) == CACHE_LINE_SIZE,
+               "hot connection fields must fit one cache line");
+
+/* Socket options behind a network_profile_t (0 = leave the kernel's) */
+typedef struct {
+    const char *name;
+    int nodelay;                    /* TCP_NODELAY */
+    int quickack;                   /* TCP_QUICKACK, re-armed after reads */
+    int notsent_lowat;              /* TCP_NOTSENT_LOWAT bytes */
+    int busy_poll_us;               /* SO_BUSY_POLL */
+    const char *congestion;         /* TCP_CONGESTION */
+    int buffer_hint;                /* Send/receive buffer wanted per direction */
+} socket_profile_t;
+
+static const socket_profile_t socket_profiles[] = {
+    [NETWORK_PROFILE_DEFAULT]     = { "default",     0, 0, 0,          0,  NULL,  0 },
+    [NETWORK_PROFILE_INTERACTIVE] = { "interactive", 1, 1, 16 * 1024,  50, NULL,  0 },
+    [NETWORK_PROFILE_BULK]        = { "bulk",        0, 0, 0,          0,  NULL,  4 * 1024 * 1024 },
+    [NETWORK_PROFILE_WAN]         = { "wan",         0, 0, 128 * 1024, 0,  "bbr", 32 * 1024 * 1024 }
+};
+
+#define PROFILE_COUNT ((int)(sizeof(socket_profiles) / sizeof(socket_profiles[0])))
+
+/* Buffer limits per direction (0 send, 1 receive), read once in
+ * network_init(): the autotuning ceiling (tcp_wmem/tcp_rmem max) and
+ * the most SO_SNDBUF/SO_RCVBUF may ask for (wmem_max/rmem_max) */
+static int autotune_max[2];
+static int buffer_max[2];
+static network_profile_t default_profile = NETWORK_PROFILE_DEFAULT;
+
+/* Reap list: closed sockets with pinned output, watched for completions
+ * by reap_epfd (see network_reap_closed) */
+static platform_mutex_t reap_lock;
+static pinned_socket_t *reap_list;
+static int reap_count;
+static int reap_epfd = -1;
+
 /* Internal function prototypes */
+static connection_t* alloc_connection(void);
+static void free_connection(connection_t *conn);
 static int create_socket(int domain, int type, int protocol);
-static int set_socket_options(int sockfd);
-static int connect_with_retry(const char *host, int port, int max_retries);
-static int resolve_hostname(const char *host, struct sockaddr_storage *addr);
+static int set_socket_options(int sockfd, int family);
+static void set_packet_mode(connection_t *conn);
+static int handoff_write(int channel_fd, const unsigned char *data, size_t len, int fd,
+                         int timeout_ms);
+static int handoff_read(int channel_fd, unsigned char *data, size_t len, int *fd,
+                        int timeout_ms);
+static unsigned char* put_field(unsigned char *p, uint64_t value, int bytes);
+static uint64_t get_field(const unsigned char *p, int bytes);
+static void apply_socket_profile(int sockfd, network_profile_t profile);
+static void set_buffer_hint(int sockfd, int direction, int hint);
+static void load_buffer_limits(void);
+static int connect_with_retry(const char *host, int port, int max_retries,
+                              struct sockaddr_storage *addr, socklen_t *addr_len);
+static int race_connect(const resolver_addresses_t *addresses, struct sockaddr_storage *addr,
+                        socklen_t *addr_len);
+static int order_addresses(const resolver_addresses_t *addresses,
+                           const resolver_address_t **order, int max);
+static int start_connect_attempt(const resolver_address_t *target, int *connected);
+static int backoff_delay_ms(int round);
 static void update_connection_stats(connection_t *conn, int is_send, size_t bytes);
+static int fill_input(connection_t *conn, size_t want);
+static int assemble_frame(connection_t *conn, size_t header_len, size_t length_offset,
+                          size_t max_len);
+static int open_record(connection_t *conn, size_t wire_len, unsigned char **plain,
+                       size_t *plain_len);
+static void drop_frame(connection_t *conn);
+static int input_failed(connection_t *conn, int status);
+static unsigned char* ring_reserve(byte_ring_t *ring, size_t need, int mirror);
+static void ring_consume(byte_ring_t *ring, size_t n);
+static void ring_free(byte_ring_t *ring);
+static int send_via_hook(connection_t *conn, const unsigned char *data, size_t len);
+static int seal_record(connection_t *conn, const unsigned char *data, size_t len,
+                       size_t *sealed_len);
+static int write_queue(connection_t *conn);
+static void consume_queue(connection_t *conn, size_t sent, int zerocopy);
+static int drain_output(connection_t *conn, int timeout_ms);
+static int zerocopy_usable(connection_t *conn);
+static int reap_zerocopy(connection_t *conn);
+static int reap_pins(int sockfd, zerocopy_pins_t *pins, connection_t *conn);
+static void free_pins(zerocopy_pins_t *pins);
+#ifdef NETWORK_ZEROCOPY
+static void account_zerocopy(connection_t *conn, uint32_t lo, uint32_t hi, int copied);
+static int complete_pins(zerocopy_pins_t *pins, uint32_t lo, uint32_t hi);
+#endif
+static void free_segments(tx_segment_t *seg);
+static int write_file_range(connection_t *conn, int file_fd, uint64_t offset, size_t len);
+static int splice_file_range(connection_t *conn, int file_fd, uint64_t offset, size_t len,
+                             size_t *moved);
+static int copy_file_range_in(connection_t *conn, int file_fd, uint64_t offset, size_t len);
+static int defer_close(connection_t *conn, int sockfd);
+static void reset_socket(int sockfd);
 
 /* Initialize network subsystem */
 int network_init(void) {
     static int initialized = 0;
+    const char *profile_env;
     
     if (initialized) {
         return NETWORK_SUCCESS;
@@ -85,6 +346,24 @@ int network_init(void) {
     }
 #endif
     
+    load_buffer_limits();
+    
+#ifdef NETWORK_ZEROCOPY
+    /* Without these, close resets sockets with pinned output instead */
+    reap_lock = platform_mutex_create();
+    reap_epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (!reap_lock || reap_epfd < 0) {
+        LOG_WARNING("Zerocopy reap list unavailable: %s", strerror(errno));
+    }
+#endif
+    
+    profile_env = getenv(PROFILE_ENV);
+    if (profile_env && *profile_env) {
+        if (network_profile_parse(profile_env, &default_profile) != NETWORK_SUCCESS) {
+            LOG_WARNING("Unknown %s '%s', using default", PROFILE_ENV, profile_env);
+        }
+    }
+    
     LOG_INFO("Network subsystem initialized");
     initialized = 1;
     return NETWORK_SUCCESS;
@@ -109,7 +388,7 @@ connection_t* create_listener(int port, const char *password) {
     }
     
     /* Set socket options */
-    if (set_socket_options(sockfd) != NETWORK_SUCCESS) {
+    if (set_socket_options(sockfd, AF_INET) != NETWORK_SUCCESS) {
         close_socket(sockfd);
         return NULL;
     }
@@ -145,14 +424,14 @@ connection_t* create_listener(int port, const char *password) {
     }
     
     /* Start listening */
-    if (listen(sockfd, MAX_CONNECTIONS) < 0) {
+    if (listen(sockfd, LISTEN_BACKLOG) < 0) {
         LOG_ERROR("listen failed: %s", strerror(errno));
         close_socket(sockfd);
         return NULL;
     }
     
     /* Create connection structure */
-    listener = calloc(1, sizeof(connection_t));
+    listener = alloc_connection();
     if (!listener) {
         LOG_ERROR("Memory allocation failed");
         close_socket(sockfd);
@@ -162,16 +441,16 @@ connection_t* create_listener(int port, const char *password) {
     listener->sockfd = sockfd;
     listener->state = STATE_READY;
     listener->is_listening = 1;
-    listener->remote_port = port;
-    listener->connected_at = time(NULL);
-    listener->last_activity = listener->connected_at;
+    listener->cold->remote_port = port;
+    listener->cold->connected_at = time(NULL);
+    listener->last_activity = listener->cold->connected_at;
     
     if (password) {
-        listener->password = strdup(password);
+        listener->cold->password = strdup(password);
         listener->is_encrypted = 1;
     }
     
-    strcpy(listener->remote_host, "0.0.0.0");
+    strcpy(listener->cold->remote_host, "0.0.0.0");
     
     LOG_INFO("Listening on port %d%s", port, 
              listener->is_encrypted ? " (encrypted)" : "");
@@ -184,7 +463,7 @@ connection_t* accept_connection(connection_t *listener) {
     connection_t *client = NULL;
     struct sockaddr_storage client_addr;
     socklen_t addr_len = sizeof(client_addr);
-    char ip_str[INET6_ADDRSTRLEN];
+    char ip_str[sizeof(((struct sockaddr_un*)0)->sun_path)]; /* Fits any address or path */
     int client_fd;
     
     if (!listener || !listener->is_listening) {
@@ -195,18 +474,25 @@ connection_t* accept_connection(connection_t *listener) {
     /* Accept connection */
     client_fd = accept(listener->sockfd, (struct sockaddr*)&client_addr, &addr_len);
     if (client_fd < 0) {
+        /* A non-blocking listener reports an empty backlog this way */
+        if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            return NULL;
+        }
         LOG_ERROR("accept failed: %s", strerror(errno));
         return NULL;
     }
     
     /* Set socket options for client */
-    if (set_socket_options(client_fd) != NETWORK_SUCCESS) {
+    if (set_socket_options(client_fd, client_addr.ss_family) != NETWORK_SUCCESS) {
         close_socket(client_fd);
         return NULL;
     }
     
-    /* Get client IP address */
-    if (client_addr.ss_family == AF_INET) {
+    /* Get client IP address; Unix-domain clients are named by the listener's path */
+    if (client_addr.ss_family == AF_UNIX) {
+        strncpy(ip_str, listener->cold->remote_host, sizeof(ip_str) - 1);
+        ip_str[sizeof(ip_str) - 1] = '\0';
+    } else if (client_addr.ss_family == AF_INET) {
         struct sockaddr_in *s = (struct sockaddr_in*)&client_addr;
         inet_ntop(AF_INET, &s->sin_addr, ip_str, sizeof(ip_str));
     } else {
@@ -215,50 +501,56 @@ connection_t* accept_connection(connection_t *listener) {
     }
     
     /* Create client connection structure */
-    client = calloc(1, sizeof(connection_t));
-    if (!client) {
+    client = alloc_connection();
+    if (!client || !(client->send_lock = platform_mutex_create())) {
         LOG_ERROR("Memory allocation failed");
+        free_connection(client);
         close_socket(client_fd);
         return NULL;
     }
     
     client->sockfd = client_fd;
     client->state = STATE_CONNECTED;
-    client->addr = client_addr;
-    client->addr_len = addr_len;
-    client->connected_at = time(NULL);
-    client->last_activity = client->connected_at;
+    if (client_addr.ss_family != AF_UNIX) {
+        client->rx_quickack = (uint8_t)socket_profiles[default_profile].quickack;
+    } else if (listener->seqpacket) {
+        set_packet_mode(client);
+    }
+    client->cold->addr = client_addr;
+    client->cold->addr_len = addr_len;
+    client->cold->connected_at = time(NULL);
+    client->last_activity = client->cold->connected_at;
     
-    strncpy(client->remote_host, ip_str, sizeof(client->remote_host) - 1);
+    strncpy(client->cold->remote_host, ip_str, sizeof(client->cold->remote_host) - 1);
     
     /* Get remote port */
-    if (client_addr.ss_family == AF_INET) {
+    if (client_addr.ss_family == AF_UNIX) {
+        client->cold->remote_port = 0;
+    } else if (client_addr.ss_family == AF_INET) {
         struct sockaddr_in *s = (struct sockaddr_in*)&client_addr;
-        client->remote_port = ntohs(s->sin_port);
+        client->cold->remote_port = ntohs(s->sin_port);
     } else {
         struct sockaddr_in6 *s = (struct sockaddr_in6*)&client_addr;
-        client->remote_port = ntohs(s->sin6_port);
+        client->cold->remote_port = ntohs(s->sin6_port);
     }
     
-    /* Setup encryption if listener has password */
-    if (listener->is_encrypted && listener->password) {
-        client->password = strdup(listener->password);
-        client->is_encrypted = 1;
-        
-        /* Create crypto session */
-        client->crypto = crypto_session_create(listener->password);
-        if (!client->crypto) {
-            LOG_ERROR("Failed to create crypto session for client");
-            free(client->password);
-            free(client);
+    /* Setup encryption if listener has password; keys are derived during
+     * the handshake, overlapped with the round trip or skipped on resumption */
+    if (listener->is_encrypted && listener->cold->password) {
+        client->cold->password = strdup(listener->cold->password);
+        if (!client->cold->password) {
+            LOG_ERROR("Memory allocation failed");
+            platform_mutex_destroy(client->send_lock);
+            free_connection(client);
             close_socket(client_fd);
             return NULL;
         }
         
+        client->is_encrypted = 1;
         client->state = STATE_AUTHENTICATING;
     }
     
-    LOG_INFO("Accepted connection from %s:%d%s", ip_str, client->remote_port,
+    LOG_INFO("Accepted connection from %s:%d%s", ip_str, client->cold->remote_port,
              client->is_encrypted ? " (encrypted)" : "");
     
     return client;
@@ -268,6 +560,7 @@ connection_t* accept_connection(connection_t *listener) {
 connection_t* connect_to_host(const char *host, int port, const char *password) {
     connection_t *conn = NULL;
     struct sockaddr_storage addr;
+    socklen_t addr_len = 0;
     int sockfd;
     
     if (!host || port <= 0 || port > 65535) {
@@ -275,68 +568,262 @@ connection_t* connect_to_host(const char *host, int port, const char *password)
         return NULL;
     }
     
-    /* Resolve hostname */
-    if (resolve_hostname(host, &addr) != NETWORK_SUCCESS) {
-        LOG_ERROR("Failed to resolve hostname: %s", host);
+    /* Resolve and race every address of the host */
+    sockfd = connect_with_retry(host, port, MAX_RETRIES, &addr, &addr_len);
+    if (sockfd < 0) {
+        LOG_ERROR("Failed to connect to %s:%d", host, port);
+        return NULL;
+    }
+    
+    /* Create connection structure */
+    conn = alloc_connection();
+    if (!conn || !(conn->send_lock = platform_mutex_create())) {
+        LOG_ERROR("Memory allocation failed");
+        free_connection(conn);
+        close_socket(sockfd);
+        return NULL;
+    }
+    
+    conn->sockfd = sockfd;
+    conn->state = STATE_CONNECTED;
+    conn->rx_quickack = (uint8_t)socket_profiles[default_profile].quickack;
+    conn->cold->addr = addr;
+    conn->cold->addr_len = addr_len;
+    conn->cold->connected_at = time(NULL);
+    conn->last_activity = conn->cold->connected_at;
+    conn->cold->remote_port = port;
+    
+    strncpy(conn->cold->remote_host, host, sizeof(conn->cold->remote_host) - 1);
+    
+    /* Setup encryption if password provided (keys follow in the handshake) */
+    if (password && strlen(password) > 0) {
+        conn->cold->password = strdup(password);
+        if (!conn->cold->password) {
+            LOG_ERROR("Memory allocation failed");
+            platform_mutex_destroy(conn->send_lock);
+            free_connection(conn);
+            close_socket(sockfd);
+            return NULL;
+        }
+        
+        conn->is_encrypted = 1;
+        conn->state = STATE_AUTHENTICATING;
+    }
+    
+    LOG_INFO("Connected to %s:%d%s", host, port, 
+             conn->is_encrypted ? " (encrypted)" : "");
+    
+    return conn;
+}
+
+/* Create a listening Unix-domain socket */
+connection_t* create_unix_listener(const char *path, int seqpacket, const char *password) {
+    connection_t *listener = NULL;
+    struct sockaddr_un addr;
+    struct stat st;
+    int sockfd, type = seqpacket ? SOCK_SEQPACKET : SOCK_STREAM;
+    
+    if (!path || !*path || strlen(path) >= sizeof(addr.sun_path)) {
+        LOG_ERROR("Invalid socket path: %s", path ? path : "NULL");
         return NULL;
     }
     
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+    
+    /* A socket file nobody answers on is left over from a dead listener */
+    if (lstat(path, &st) == 0 && S_ISSOCK(st.st_mode)) {
+        int probe = socket(AF_UNIX, type, 0);
+        int in_use = probe < 0 ||
+                     connect(probe, (struct sockaddr*)&addr, sizeof(addr)) == 0 ||
+                     errno != ECONNREFUSED;
+        
+        if (probe >= 0) {
+            close_socket(probe);
+        }
+        if (in_use) {
+            LOG_ERROR("Socket %s is in use", path);
+            return NULL;
+        }
+        unlink(path);
+    }
+    
     /* Create socket */
-    sockfd = create_socket(addr.ss_family, SOCK_STREAM, 0);
+    sockfd = socket(AF_UNIX, type, 0);
     if (sockfd < 0) {
-        LOG_ERROR("Failed to create socket");
+        LOG_ERROR("Failed to create socket: %s", strerror(errno));
         return NULL;
     }
     
     /* Set socket options */
-    if (set_socket_options(sockfd) != NETWORK_SUCCESS) {
+    if (set_socket_options(sockfd, AF_UNIX) != NETWORK_SUCCESS) {
         close_socket(sockfd);
         return NULL;
     }
     
-    /* Connect with retry logic */
-    sockfd = connect_with_retry(host, port, MAX_RETRIES);
-    if (sockfd < 0) {
-        LOG_ERROR("Failed to connect to %s:%d", host, port);
+    /* Bind to the path; who may connect is up to its directory's permissions */
+    if (bind(sockfd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+        LOG_ERROR("bind failed on %s: %s", path, strerror(errno));
+        close_socket(sockfd);
+        return NULL;
+    }
+    
+    /* Start listening */
+    if (listen(sockfd, LISTEN_BACKLOG) < 0) {
+        LOG_ERROR("listen failed: %s", strerror(errno));
+        close_socket(sockfd);
+        unlink(path);
         return NULL;
     }
     
     /* Create connection structure */
-    conn = calloc(1, sizeof(connection_t));
-    if (!conn) {
+    listener = alloc_connection();
+    if (!listener) {
         LOG_ERROR("Memory allocation failed");
         close_socket(sockfd);
+        unlink(path);
+        return NULL;
+    }
+    
+    listener->sockfd = sockfd;
+    listener->state = STATE_READY;
+    listener->is_listening = 1;
+    listener->seqpacket = seqpacket ? 1 : 0;
+    listener->cold->remote_port = 0;
+    listener->cold->connected_at = time(NULL);
+    listener->last_activity = listener->cold->connected_at;
+    
+    if (password) {
+        listener->cold->password = strdup(password);
+        listener->is_encrypted = 1;
+    }
+    
+    strncpy(listener->cold->remote_host, path, sizeof(listener->cold->remote_host) - 1);
+    
+    LOG_INFO("Listening on %s (%s)%s", path, seqpacket ? "seqpacket" : "stream",
+             listener->is_encrypted ? " (encrypted)" : "");
+    
+    return listener;
+}
+
+/* Connect to a Unix-domain socket */
+connection_t* connect_to_unix(const char *path, int seqpacket, const char *password) {
+    connection_t *conn;
+    struct sockaddr_un addr;
+    int sockfd;
+    
+    if (!path || !*path || strlen(path) >= sizeof(addr.sun_path)) {
+        LOG_ERROR("Invalid socket path: %s", path ? path : "NULL");
+        return NULL;
+    }
+    
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+    
+    sockfd = socket(AF_UNIX, seqpacket ? SOCK_SEQPACKET : SOCK_STREAM, 0);
+    if (sockfd < 0) {
+        LOG_ERROR("Failed to create socket: %s", strerror(errno));
+        return NULL;
+    }
+    
+    /* Local connects complete or fail at once: no retry, no racing */
+    if (connect(sockfd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+        LOG_ERROR("Failed to connect to %s: %s", path, strerror(errno));
+        close_socket(sockfd);
+        return NULL;
+    }
+    
+    conn = connection_from_socket(sockfd, password);
+    if (!conn) {
+        close_socket(sockfd);
+    }
+    
+    return conn;
+}
+
+/* Wrap an already connected socket */
+connection_t* connection_from_socket(int sockfd, const char *password) {
+    connection_t *conn = NULL;
+    struct sockaddr_storage addr;
+    socklen_t addr_len = sizeof(addr);
+    socklen_t type_len;
+    int type = 0;
+    
+    type_len = sizeof(type);
+    if (sockfd < 0 ||
+        getsockopt(sockfd, SOL_SOCKET, SO_TYPE, &type, &type_len) < 0 ||
+        (type != SOCK_STREAM && type != SOCK_SEQPACKET)) {
+        LOG_ERROR("Not a stream or seqpacket socket");
+        return NULL;
+    }
+    
+    memset(&addr, 0, sizeof(addr));
+    if (getpeername(sockfd, (struct sockaddr*)&addr, &addr_len) < 0) {
+        LOG_ERROR("Socket is not connected: %s", strerror(errno));
+        return NULL;
+    }
+    
+    /* Set socket options */
+    if (set_socket_options(sockfd, addr.ss_family) != NETWORK_SUCCESS) {
+        return NULL;
+    }
+    
+    /* Create connection structure */
+    conn = alloc_connection();
+    if (!conn || !(conn->send_lock = platform_mutex_create())) {
+        LOG_ERROR("Memory allocation failed");
+        free_connection(conn);
         return NULL;
     }
     
     conn->sockfd = sockfd;
     conn->state = STATE_CONNECTED;
-    conn->addr = addr;
-    conn->addr_len = sizeof(addr);
-    conn->connected_at = time(NULL);
-    conn->last_activity = conn->connected_at;
-    conn->remote_port = port;
-    
-    strncpy(conn->remote_host, host, sizeof(conn->remote_host) - 1);
+    conn->cold->addr = addr;
+    conn->cold->addr_len = addr_len;
+    conn->cold->connected_at = time(NULL);
+    conn->last_activity = conn->cold->connected_at;
+    
+    /* Name the peer: its address, or its path (none for socketpair ends) */
+    if (addr.ss_family == AF_UNIX) {
+        struct sockaddr_un *s = (struct sockaddr_un*)&addr;
+        
+        if (addr_len > offsetof(struct sockaddr_un, sun_path) && s->sun_path[0]) {
+            strncpy(conn->cold->remote_host, s->sun_path, sizeof(conn->cold->remote_host) - 1);
+        } else {
+            strcpy(conn->cold->remote_host, "local");
+        }
+        if (type == SOCK_SEQPACKET) {
+            set_packet_mode(conn);
+        }
+    } else if (addr.ss_family == AF_INET) {
+        struct sockaddr_in *s = (struct sockaddr_in*)&addr;
+        inet_ntop(AF_INET, &s->sin_addr, conn->cold->remote_host, sizeof(conn->cold->remote_host));
+        conn->cold->remote_port = ntohs(s->sin_port);
+        conn->rx_quickack = (uint8_t)socket_profiles[default_profile].quickack;
+    } else {
+        struct sockaddr_in6 *s = (struct sockaddr_in6*)&addr;
+        inet_ntop(AF_INET6, &s->sin6_addr, conn->cold->remote_host, sizeof(conn->cold->remote_host));
+        conn->cold->remote_port = ntohs(s->sin6_port);
+        conn->rx_quickack = (uint8_t)socket_profiles[default_profile].quickack;
+    }
     
-    /* Setup encryption if password provided */
+    /* Setup encryption if password provided (keys follow in the handshake) */
     if (password && strlen(password) > 0) {
-        conn->password = strdup(password);
-        conn->is_encrypted = 1;
-        
-        conn->crypto = crypto_session_create(password);
-        if (!conn->crypto) {
-            LOG_ERROR("Failed to create crypto session");
-            free(conn->password);
-            free(conn);
-            close_socket(sockfd);
+        conn->cold->password = strdup(password);
+        if (!conn->cold->password) {
+            LOG_ERROR("Memory allocation failed");
+            platform_mutex_destroy(conn->send_lock);
+            free_connection(conn);
             return NULL;
         }
         
+        conn->is_encrypted = 1;
         conn->state = STATE_AUTHENTICATING;
     }
     
-    LOG_INFO("Connected to %s:%d%s", host, port, 
+    LOG_INFO("Connected to %s%s", conn->cold->remote_host,
              conn->is_encrypted ? " (encrypted)" : "");
     
     return conn;
@@ -344,8 +831,8 @@ connection_t* connect_to_host(const char *host, int port, const char *password)
 
 /* Send data through connection */
 int send_data(connection_t *conn, const unsigned char *data, size_t len) {
-    ssize_t sent;
-    size_t total_sent = 0;
+    size_t sealed_len;
+    int result;
     
     if (!conn || conn->state != STATE_READY) {
         LOG_ERROR("Invalid connection or not ready");
@@ -357,56 +844,50 @@ int send_data(connection_t *conn, const unsigned char *data, size_t len) {
         return NETWORK_ERROR_PARAM;
     }
     
-    /* Encrypt data if encryption is enabled */
-    if (conn->is_encrypted && conn->crypto) {
-        unsigned char encrypted[len + 64]; /* Extra space for overhead */
-        size_t encrypted_len;
-        
-        if (crypto_encrypt(conn->crypto, data, len, encrypted, &encrypted_len) 
-            != CRYPTO_SUCCESS) {
-            LOG_ERROR("Encryption failed");
-            return NETWORK_ERROR_CRYPTO;
-        }
-        
-        data = encrypted;
-        len = encrypted_len;
+    /* An I/O backend owns the socket's write side */
+    if (conn->send_hook) {
+        result = send_via_hook(conn, data, len);
+        conn->tx_ring.len = 0;
+        return result;
+    }
+    
+    /* Seal straight into the output queue, behind anything still unsent */
+    result = seal_record(conn, data, len, &sealed_len);
+    conn->tx_ring.len = 0;
+    if (result != NETWORK_SUCCESS) {
+        return result;
     }
     
-    /* Send data */
-    while (total_sent < len) {
-        sent = send(conn->sockfd, data + total_sent, len - total_sent, 0);
+    /* Corked owners flush once for every record sealed since their last
+     * turn, so a burst of records leaves in one gather write */
+    if (!conn->tx_corked) {
+        result = flush_connection(conn);
+        if (result < 0) {
+            return result;
+        }
         
-        if (sent < 0) {
-            if (errno == EAGAIN || errno == EWOULDBLOCK) {
-                /* Would block, try again */
-                continue;
-            } else if (errno == EINTR) {
-                /* Interrupted, try again */
-                continue;
-            } else {
-                LOG_ERROR("send failed: %s", strerror(errno));
-                conn->state = STATE_ERROR;
-                return NETWORK_ERROR_IO;
+        /* Blocking callers sleep until the socket drains; event-driven
+         * ones flush on writability and watch connection_send_blocked() */
+        if (result > 0 && !conn->tx_async) {
+            result = drain_output(conn, SEND_TIMEOUT_SEC * 1000);
+            if (result != NETWORK_SUCCESS) {
+                return result;
             }
-        } else if (sent == 0) {
-            /* Connection closed */
-            LOG_WARNING("Connection closed by peer during send");
-            conn->state = STATE_CLOSING;
-            return NETWORK_ERROR_CLOSED;
         }
-        
-        total_sent += sent;
     }
     
     /* Update statistics */
-    update_connection_stats(conn, 1, total_sent);
+    update_connection_stats(conn, 1, sealed_len);
     
-    return total_sent;
+    return (int)sealed_len;
 }
 
 /* Receive data from connection */
 int receive_data(connection_t *conn, unsigned char *buffer, size_t max_len) {
+    unsigned char *record;
+    size_t record_len;
     ssize_t received;
+    int result;
     
     if (!conn || conn->state != STATE_READY) {
         LOG_ERROR("Invalid connection or not ready");
@@ -418,6 +899,50 @@ int receive_data(connection_t *conn, unsigned char *buffer, size_t max_len) {
         return NETWORK_ERROR_PARAM;
     }
     
+    drop_frame(conn);
+    
+    /* Sealed input is opened a whole record at a time in the receive
+     * ring; kernel TLS opens records itself */
+    if (conn->is_encrypted && conn->crypto &&
+        !(conn->kernel_crypto & NETWORK_KERNEL_CRYPTO_RX)) {
+        result = assemble_frame(conn, RECORD_LENGTH_SIZE, 0, max_len + RECORD_OVERHEAD);
+        if (result > 0) {
+            result = open_record(conn, (size_t)result, &record, &record_len);
+        }
+        if (result <= 0) {
+            return result;
+        }
+        
+        if (record_len > max_len) {
+            LOG_ERROR("Buffer too small: need %zu, have %zu", record_len, max_len);
+            return NETWORK_ERROR_BUFFER;
+        }
+        
+        memcpy(buffer, record, record_len);
+        return (int)record_len;
+    }
+    
+    /* Sequenced packets are read whole, since a read shorter than the
+     * packet would drop its tail */
+    if (conn->seqpacket && conn->rx_ring.len == 0) {
+        result = fill_input(conn, 1);
+        if (result < 0) {
+            return input_failed(conn, result);
+        }
+    }
+    
+    /* Staged input, and any part of a frame already read, comes before
+     * the socket */
+    if (conn->rx_staged || conn->rx_ring.len > 0) {
+        received = conn->rx_ring.len < max_len ? (ssize_t)conn->rx_ring.len : (ssize_t)max_len;
+        if (received > 0) {
+            memcpy(buffer, conn->rx_ring.data + conn->rx_ring.head, (size_t)received);
+            ring_consume(&conn->rx_ring, (size_t)received);
+            update_connection_stats(conn, 0, (size_t)received);
+        }
+        return (int)received;
+    }
+    
     /* Receive data */
     received = recv(conn->sockfd, buffer, max_len, 0);
     
@@ -430,82 +955,195 @@ int receive_data(connection_t *conn, unsigned char *buffer, size_t max_len) {
             return 0;
         } else {
             LOG_ERROR("recv failed: %s", strerror(errno));
-            conn->state = STATE_ERROR;
-            return NETWORK_ERROR_IO;
+            return input_failed(conn, NETWORK_ERROR_IO);
         }
     } else if (received == 0) {
         /* Connection closed */
-        LOG_INFO("Connection closed by peer");
-        conn->state = STATE_CLOSING;
-        return NETWORK_ERROR_CLOSED;
+        return input_failed(conn, NETWORK_ERROR_CLOSED);
     }
     
     /* Update statistics */
     update_connection_stats(conn, 0, received);
     
-    /* Decrypt data if encryption is enabled */
-    if (conn->is_encrypted && conn->crypto && received > 0) {
-        unsigned char decrypted[received];
-        size_t decrypted_len;
-        
-        if (crypto_decrypt(conn->crypto, buffer, received, decrypted, &decrypted_len)
-            != CRYPTO_SUCCESS) {
-            LOG_ERROR("Decryption failed");
-            return NETWORK_ERROR_CRYPTO;
-        }
-        
-        /* Copy decrypted data back to buffer */
-        if (decrypted_len > max_len) {
-            LOG_ERROR("Decrypted data too large for buffer");
-            return NETWORK_ERROR_BUFFER;
-        }
-        
-        memcpy(buffer, decrypted, decrypted_len);
-        received = decrypted_len;
-        
-        /* Securely wipe temporary buffer */
-        memset(decrypted, 0, received);
+#ifdef TCP_QUICKACK
+    /* The kernel drops back to delayed ACKs on its own; keep answering
+     * promptly so the peer's next small write is not held by Nagle */
+    if (conn->rx_quickack) {
+        int on = 1;
+        setsockopt(conn->sockfd, IPPROTO_TCP, TCP_QUICKACK, &on, sizeof(on));
     }
+#endif
     
     return received;
 }
 
-/* Close connection */
-void close_connection(connection_t *conn) {
-    if (!conn) return;
+/* Receive one complete frame */
+int receive_frame(connection_t *conn, size_t header_len, size_t length_offset,
+                  size_t max_len, unsigned char **frame, size_t *frame_len) {
+    int wire_len;
     
-    LOG_DEBUG("Closing connection to %s:%d", conn->remote_host, conn->remote_port);
-    
-    /* Close socket */
-    if (conn->sockfd >= 0) {
-        shutdown(conn->sockfd, SHUT_RDWR);
-        close_socket(conn->sockfd);
-        conn->sockfd = -1;
+    if (!conn || conn->state != STATE_READY) {
+        LOG_ERROR("Invalid connection or not ready");
+        return NETWORK_ERROR_STATE;
     }
     
-    /* Destroy crypto session */
-    if (conn->crypto) {
-        crypto_session_destroy(conn->crypto);
-        conn->crypto = NULL;
+    if (!frame || !frame_len || header_len < length_offset + sizeof(uint32_t) ||
+        max_len < header_len) {
+        return NETWORK_ERROR_PARAM;
     }
     
-    /* Free password */
-    if (conn->password) {
-        memset(conn->password, 0, strlen(conn->password));
-        free(conn->password);
-        conn->password = NULL;
+    drop_frame(conn);
+    
+    /* Records sealed in user space carry their length in front; clear
+     * streams, kernel TLS included, are framed by the caller's header */
+    if (conn->is_encrypted && conn->crypto &&
+        !(conn->kernel_crypto & NETWORK_KERNEL_CRYPTO_RX)) {
+        wire_len = assemble_frame(conn, RECORD_LENGTH_SIZE, 0, max_len + RECORD_OVERHEAD);
+        
+        /* An empty record ends the peer's sealed input: it could not
+         * take the keys early data went out under */
+        if (wire_len == RECORD_LENGTH_SIZE && conn->early_data) {
+            ring_consume(&conn->rx_ring, RECORD_LENGTH_SIZE);
+            return NETWORK_ERROR_REFUSED;
+        }
+        if (wire_len > 0) {
+            wire_len = open_record(conn, (size_t)wire_len, frame, frame_len);
+        }
+        if (wire_len > 0 && *frame_len > max_len) {
+            LOG_ERROR("Frame too large: %zu bytes", *frame_len);
+            return NETWORK_ERROR_BUFFER;
+        }
+        return wire_len;
     }
     
-    /* Free user data */
-    if (conn->user_data) {
-        free(conn->user_data);
-        conn->user_data = NULL;
+    wire_len = assemble_frame(conn, header_len, length_offset, max_len);
+    if (wire_len > 0) {
+        *frame = conn->rx_ring.data + conn->rx_ring.head;
+        *frame_len = (size_t)wire_len;
+        conn->rx_frame = (size_t)wire_len;
+        update_connection_stats(conn, 0, (size_t)wire_len);
+    }
+    
+    return wire_len;
+}
+
+/* End this side's sealed records with an empty one (send lock held) */
+int send_empty_record(connection_t *conn) {
+    static const unsigned char empty[RECORD_LENGTH_SIZE];
+    
+    /* Sealing would give the record a body */
+    if (!conn || conn->crypto) {
+        return NETWORK_ERROR_STATE;
+    }
+    
+    return send_data(conn, empty, sizeof(empty));
+}
+
+/* Drop sealed records up to and including the peer's empty record */
+int discard_sealed_records(connection_t *conn, size_t max_len) {
+    int wire_len;
+    
+    if (!conn || conn->state != STATE_READY) {
+        return NETWORK_ERROR_STATE;
+    }
+    
+    drop_frame(conn);
+    
+    for (;;) {
+        wire_len = assemble_frame(conn, RECORD_LENGTH_SIZE, 0, max_len + RECORD_OVERHEAD);
+        if (wire_len <= 0) {
+            return wire_len;
+        }
+        
+        update_connection_stats(conn, 0, (size_t)wire_len);
+        ring_consume(&conn->rx_ring, (size_t)wire_len);
+        if (wire_len == RECORD_LENGTH_SIZE) {
+            return 1;
+        }
+    }
+}
+
+/* Close connection */
+void close_connection(connection_t *conn) {
+    if (!conn || !conn->cold) return;
+    
+    LOG_DEBUG("Closing connection to %s:%d", conn->cold->remote_host, conn->cold->remote_port);
+    
+    /* Close socket; output the kernel still references keeps it open on
+     * the reap list rather than stalling the caller */
+    if (conn->sockfd >= 0) {
+        shutdown(conn->sockfd, SHUT_RDWR);
+        if (!defer_close(conn, conn->sockfd)) {
+            close_socket(conn->sockfd);
+        }
+        conn->sockfd = -1;
+    }
+    
+    /* Destroy crypto session */
+    if (conn->crypto) {
+        crypto_session_destroy(conn->crypto);
+        conn->crypto = NULL;
+    }
+    
+    /* Destroy compression state */
+    if (conn->compression) {
+        compression_destroy(conn->compression);
+        conn->compression = NULL;
+    }
+    
+    /* Free password */
+    if (conn->cold->password) {
+        memset(conn->cold->password, 0, strlen(conn->cold->password));
+        free(conn->cold->password);
+        conn->cold->password = NULL;
+    }
+    
+    /* The datagram channel is keyed from this session */
+    datagram_close(conn->cold->datagram);
+    conn->cold->datagram = NULL;
+    
+    /* Unsent output dies with the socket */
+    free_segments(conn->tx_head);
+    conn->tx_head = conn->tx_tail = NULL;
+    free_pins(&conn->cold->zc);
+    conn->tx_pending = 0;
+    conn->tx_blocked = 0;
+    
+    /* Close the splice pipe */
+    if (conn->rx_pipe_open) {
+        close(conn->cold->rx_pipe[0]);
+        close(conn->cold->rx_pipe[1]);
+        conn->rx_pipe_open = 0;
+    }
+    
+    /* Free the I/O rings */
+    ring_free(&conn->rx_ring);
+    ring_free(&conn->tx_ring);
+    conn->rx_frame = 0;
+    
+    /* Messages kept for a resumption the peer never answered */
+    set_connection_early_data(conn, NULL, NULL);
+    
+    /* Free user data */
+    if (conn->user_data) {
+        free(conn->user_data);
+        conn->user_data = NULL;
+    }
+    
+    /* Release send lock */
+    if (conn->send_lock) {
+        platform_mutex_destroy(conn->send_lock);
+        conn->send_lock = NULL;
     }
     
     /* Update state */
     conn->state = STATE_DISCONNECTED;
     
-    LOG_INFO("Connection to %s:%d closed", conn->remote_host, conn->remote_port);
+    LOG_INFO("Connection to %s:%d closed", conn->cold->remote_host, conn->cold->remote_port);
+    
+    /* The caller frees conn itself */
+    free(conn->cold);
+    conn->cold = NULL;
 }
 
 /* Get connection information */
@@ -520,116 +1158,2343 @@ connection_info_t get_connection_info(connection_t *conn) {
         info.bytes_received = conn->bytes_received;
         info.packets_sent = conn->packets_sent;
         info.packets_received = conn->packets_received;
-        info.connection_time = time(NULL) - conn->connected_at;
+        info.send_calls = conn->send_calls;
+        info.kernel_crypto = conn->kernel_crypto;
         info.idle_time = time(NULL) - conn->last_activity;
-        
-        strncpy(info.remote_host, conn->remote_host, sizeof(info.remote_host) - 1);
-        info.remote_port = conn->remote_port;
+    }
+    
+    /* Gone once the connection is closed */
+    if (conn && conn->cold) {
+        info.zerocopy_sends = conn->cold->zc_sends;
+        info.zerocopy_copied = conn->cold->zc_copied;
+        info.connection_time = time(NULL) - conn->cold->connected_at;
+        strncpy(info.remote_host, conn->cold->remote_host, sizeof(info.remote_host) - 1);
+        info.remote_port = conn->cold->remote_port;
     }
     
     return info;
 }
 
-/* Set socket options */
-static int set_socket_options(int sockfd) {
-    int opt;
+/* Get underlying socket descriptor */
+int get_connection_socket(connection_t *conn) {
+    return conn ? conn->sockfd : -1;
+}
+
+/* Set user data pointer (freed by close_connection()) */
+void set_connection_user_data(connection_t *conn, void *user_data) {
+    if (conn) {
+        conn->user_data = user_data;
+    }
+}
+
+/* Get user data pointer */
+void* get_connection_user_data(connection_t *conn) {
+    return conn ? conn->user_data : NULL;
+}
+
+/* Acquire the per-connection send lock */
+void lock_connection_send(connection_t *conn) {
+    if (conn && conn->send_lock) {
+        platform_mutex_lock(conn->send_lock);
+    }
+}
+
+/* Release the per-connection send lock */
+void unlock_connection_send(connection_t *conn) {
+    if (conn && conn->send_lock) {
+        platform_mutex_unlock(conn->send_lock);
+    }
+}
+
+/* Allocate the next outgoing sequence number (send lock held) */
+uint64_t next_send_sequence(connection_t *conn) {
+    return conn ? conn->send_sequence++ : 0;
+}
+
+/* Get the next outgoing sequence number without allocating it */
+uint64_t get_send_sequence(connection_t *conn) {
+    return conn ? conn->send_sequence : 0;
+}
+
+/* Restart outgoing sequence numbers (send lock held) */
+void set_send_sequence(connection_t *conn, uint64_t sequence) {
+    if (conn) {
+        conn->send_sequence = sequence;
+    }
+}
+
+/* Check an incoming sequence number against the expected one */
+int check_receive_sequence(connection_t *conn, uint64_t sequence) {
+    if (!conn || sequence != conn->recv_sequence) {
+        return 0;
+    }
     
-    /* Set non-blocking mode */
-    opt = fcntl(sockfd, F_GETFL, 0);
-    if (opt < 0) {
-        LOG_ERROR("fcntl(F_GETFL) failed: %s", strerror(errno));
-        return NETWORK_ERROR_IO;
+    conn->recv_sequence++;
+    return 1;
+}
+
+/* Install a crypto session (connection takes ownership) */
+void set_connection_crypto(connection_t *conn, crypto_session_t *session) {
+    if (!conn) return;
+    
+    if (conn->crypto && conn->crypto != session) {
+        crypto_session_destroy(conn->crypto);
+    }
+    conn->crypto = session;
+    if (session) {
+        conn->is_encrypted = 1;
     }
+}
+
+/* Get crypto session */
+crypto_session_t* get_connection_crypto(connection_t *conn) {
+    return conn ? conn->crypto : NULL;
+}
+
+/* Attach negotiated compression state (connection takes ownership) */
+void set_connection_compression(connection_t *conn, compression_ctx_t *ctx) {
+    if (!conn) return;
     
-    if (fcntl(sockfd, F_SETFL, opt | O_NONBLOCK) < 0) {
-        LOG_ERROR("fcntl(F_SETFL) failed: %s", strerror(errno));
-        return NETWORK_ERROR_IO;
+    if (conn->compression && conn->compression != ctx) {
+        compression_destroy(conn->compression);
     }
+    conn->compression = ctx;
+}
+
+/* Get negotiated compression state */
+compression_ctx_t* get_connection_compression(connection_t *conn) {
+    return conn ? conn->compression : NULL;
+}
+
+/* Route sends through an I/O backend */
+void set_connection_send_hook(connection_t *conn, connection_send_hook_t hook, void *ctx) {
+    if (!conn) return;
     
-    /* Set receive timeout */
-    struct timeval tv;
-    tv.tv_sec = RECV_TIMEOUT_SEC;
-    tv.tv_usec = 0;
+    conn->send_hook = hook;
+    conn->send_hook_ctx = ctx;
+}
+
+/* Switch reads between recv() and staged input */
+void set_connection_staged_input(connection_t *conn, int enabled) {
+    if (conn) {
+        drop_frame(conn);
+        conn->rx_staged = enabled ? RX_STAGED_BACKEND
+                                  : conn->seqpacket ? RX_STAGED_PACKETS
+                                  : conn->rx_ring.len ? RX_STAGED_CARRIED : 0;
+    }
+}
+
+/* Append input read off the socket by an I/O backend */
+int stage_connection_input(connection_t *conn, const unsigned char *data, size_t len) {
+    unsigned char *span;
     
-    if (setsockopt(sockfd, SOL_SOCKET, SO_RCVTIMEO, (char*)&tv, sizeof(tv)) < 0) {
-        LOG_WARNING("setsockopt(SO_RCVTIMEO) failed: %s", strerror(errno));
+    if (!conn || (!data && len > 0)) {
+        return NETWORK_ERROR_PARAM;
     }
     
-    /* Set send timeout */
-    tv.tv_sec = SEND_TIMEOUT_SEC;
-    if (setsockopt(sockfd, SOL_SOCKET, SO_SNDTIMEO, (char*)&tv, sizeof(tv)) < 0) {
-        LOG_WARNING("setsockopt(SO_SNDTIMEO) failed: %s", strerror(errno));
+    if (len == 0) {
+        return NETWORK_SUCCESS;
     }
     
-    /* Enable TCP keepalive */
-    opt = 1;
-    if (setsockopt(sockfd, SOL_SOCKET, SO_KEEPALIVE, (char*)&opt, sizeof(opt)) < 0) {
-        LOG_WARNING("setsockopt(SO_KEEPALIVE) failed: %s", strerror(errno));
+    drop_frame(conn);
+    span = ring_reserve(&conn->rx_ring, len, 1);
+    if (!span) {
+        LOG_ERROR("Memory allocation failed");
+        return NETWORK_ERROR_MEMORY;
     }
     
+    memcpy(span, data, len);
+    conn->rx_ring.len += len;
+    
     return NETWORK_SUCCESS;
 }
 
-/* Connect with retry logic */
-static int connect_with_retry(const char *host, int port, int max_retries) {
-    struct addrinfo hints, *res, *p;
-    char port_str[16];
-    int sockfd = -1;
-    int retries = 0;
+/* Bytes staged but not yet received */
+size_t connection_input_pending(connection_t *conn) {
+    return conn ? conn->rx_ring.len - conn->rx_frame : 0;
+}
+
+/* Room to assemble one outgoing message */
+unsigned char* connection_send_buffer(connection_t *conn, size_t len) {
+    unsigned char *buffer;
     
-    snprintf(port_str, sizeof(port_str), "%d", port);
+    if (!conn || len == 0) {
+        return NULL;
+    }
     
-    memset(&hints, 0, sizeof(hints));
-    hints.ai_family = AF_UNSPEC;
-    hints.ai_socktype = SOCK_STREAM;
+    conn->tx_ring.len = 0;
+    buffer = ring_reserve(&conn->tx_ring, len, 0);
+    if (buffer) {
+        conn->tx_ring.len = len;
+    }
     
-    while (retries < max_retries) {
-        if (getaddrinfo(host, port_str, &hints, &res) != 0) {
-            LOG_ERROR("getaddrinfo failed for %s:%s", host, port_str);
-            return -1;
+    return buffer;
+}
+
+/* Leave output queued for the caller to flush */
+void set_connection_async_send(connection_t *conn, int enabled) {
+    if (conn) {
+        conn->tx_async = enabled ? 1 : 0;
+    }
+}
+
+/* Set output queue watermarks */
+void set_connection_watermarks(connection_t *conn, size_t high, size_t low) {
+    if (!conn) return;
+    
+    conn->tx_high_watermark = high;
+    conn->tx_low_watermark = (low && (!high || low < high)) ? low : high / 4;
+}
+
+/* Hold sealed records for the owner to flush */
+void set_connection_cork(connection_t *conn, int enabled,
+                         connection_output_hook_t notify, void *ctx) {
+    if (!conn) return;
+    
+    conn->tx_corked = enabled ? 1 : 0;
+    conn->tx_notify = enabled ? notify : NULL;
+    conn->tx_notify_ctx = enabled ? ctx : NULL;
+}
+
+/* Choose when large records are sent with MSG_ZEROCOPY */
+void set_connection_zerocopy(connection_t *conn, int enabled) {
+    if (!conn || !conn->cold) return;
+    
+    if (enabled < 0) {
+        conn->cold->zc_mode = ZEROCOPY_AUTO;
+    } else {
+        conn->cold->zc_mode = enabled ? ZEROCOPY_FORCED : ZEROCOPY_OFF;
+    }
+    conn->cold->zc_copied_run = 0;
+}
+
+/* Write queued output until the socket would block */
+int flush_connection(connection_t *conn) {
+    size_t low;
+    int result;
+    
+    if (!conn) {
+        return NETWORK_ERROR_PARAM;
+    }
+    
+    /* Completed zerocopy sends free their segments */
+    if (conn->cold && conn->cold->zc.done != conn->cold->zc.next && reap_zerocopy(conn) < 0) {
+        conn->state = STATE_ERROR;
+        return NETWORK_ERROR_IO;
+    }
+    
+    if (conn->tx_head) {
+        result = write_queue(conn);
+        if (result != NETWORK_SUCCESS) {
+            return result;
         }
+    }
+    
+    /* Hysteresis: stay blocked until well below the high watermark */
+    low = conn->tx_low_watermark ? conn->tx_low_watermark : NETWORK_SEND_LOW_WATERMARK;
+    if (conn->tx_blocked && conn->tx_pending <= low) {
+        conn->tx_blocked = 0;
+    }
+    
+    return (int)conn->tx_pending;
+}
+
+/* Descriptor an event loop watches for reap list work */
+int network_reap_fd(void) {
+    return reap_epfd;
+}
+
+/* Collect completions for closed sockets and close those released */
+int network_reap_closed(void) {
+#ifdef NETWORK_ZEROCOPY
+    struct epoll_event events[REAP_EVENTS];
+    pinned_socket_t **link, *pinned;
+    uint64_t now;
+    int remaining;
+    
+    if (!reap_lock || reap_epfd < 0) {
+        return 0;
+    }
+    
+    platform_mutex_lock(reap_lock);
+    
+    /* Consume the wakeups; every listed socket is checked below, since
+     * the deadline needs no event */
+    while (epoll_wait(reap_epfd, events, REAP_EVENTS, 0) == REAP_EVENTS) {
+    }
+    
+    now = platform_get_time_ms();
+    link = &reap_list;
+    while ((pinned = *link) != NULL) {
+        int result = reap_pins(pinned->sockfd, &pinned->pins, NULL);
         
-        /* Try each address */
-        for (p = res; p != NULL; p = p->ai_next) {
-            sockfd = socket(p->ai_family, p->ai_socktype, p->ai_protocol);
-            if (sockfd < 0) {
-                continue;
-            }
-            
-            if (connect(sockfd, p->ai_addr, p->ai_addrlen) == 0) {
-                /* Success */
-                break;
-            }
-            
-            close_socket(sockfd);
-            sockfd = -1;
+        if (result >= 0 && pinned->pins.done != pinned->pins.next &&
+            now < pinned->deadline_ms) {
+            link = &pinned->next;
+            continue;
         }
         
-        freeaddrinfo(res);
-        
-        if (sockfd >= 0) {
-            /* Connection successful */
-            return sockfd;
+        if (pinned->pins.done != pinned->pins.next) {
+            LOG_WARNING("Closed socket %d still pinned after %d ms; resetting it",
+                        pinned->sockfd, ZEROCOPY_LINGER_MS);
+            reset_socket(pinned->sockfd);
         }
         
-        /* Retry after delay */
-        retries++;
-        if (retries < max_retries) {
-            LOG_WARNING("Connection attempt %d/%d failed, retrying in %dms...",
-                       retries, max_retries, BACKOFF_DELAY_MS);
-            platform_sleep_ms(BACKOFF_DELAY_MS);
-        }
+        /* A passed socket lives on elsewhere, so leave the set explicitly */
+        *link = pinned->next;
+        reap_count--;
+        epoll_ctl(reap_epfd, EPOLL_CTL_DEL, pinned->sockfd, NULL);
+        close_socket(pinned->sockfd);
+        free_pins(&pinned->pins);
+        free(pinned);
     }
     
-    LOG_ERROR("Failed to connect after %d attempts", max_retries);
-    return -1;
+    remaining = reap_count;
+    platform_mutex_unlock(reap_lock);
+    return remaining;
+#else
+    return 0;
+#endif
 }
 
-/* Update connection statistics */
-static void update_connection_stats(connection_t *conn, int is_send, size_t bytes) {
+/* Bytes queued but not yet written */
+size_t connection_output_pending(connection_t *conn) {
+    return conn ? conn->tx_pending : 0;
+}
+
+/* Whether producers should hold off */
+int connection_send_blocked(connection_t *conn) {
+    return conn ? conn->tx_blocked : 0;
+}
+
+/* Whether no I/O backend sits between the connection and its socket */
+int connection_owns_socket(connection_t *conn) {
+    return conn && !conn->send_hook && !conn->rx_staged &&
+           conn->rx_ring.len == conn->rx_frame;
+}
+
+/* Hand record sealing for some directions to the kernel */
+void set_connection_kernel_crypto(connection_t *conn, int directions) {
     if (!conn) return;
     
-    conn->last_activity = time(NULL);
+    conn->kernel_crypto = directions & (NETWORK_KERNEL_CRYPTO_TX | NETWORK_KERNEL_CRYPTO_RX);
+}
+
+/* Directions the kernel seals */
+int connection_kernel_crypto(connection_t *conn) {
+    return conn ? conn->kernel_crypto : 0;
+}
+
+/* Attach a datagram channel */
+void set_connection_datagram(connection_t *conn, datagram_t *dg) {
+    if (!conn || !conn->cold) return;
+    
+    if (conn->cold->datagram != dg) {
+        datagram_close(conn->cold->datagram);
+    }
+    conn->cold->datagram = dg;
+}
+
+/* Attach state for messages sent before the peer took the keys */
+void set_connection_early_data(connection_t *conn, void *early, void (*release)(void *early)) {
+    if (!conn || !conn->cold) return;
+    
+    if (conn->early_data && conn->early_data != early && conn->cold->early_release) {
+        conn->cold->early_release(conn->early_data);
+    }
+    conn->early_data = early;
+    conn->cold->early_release = early ? release : NULL;
+}
+
+/* Get the early data state */
+void* get_connection_early_data(connection_t *conn) {
+    return conn ? conn->early_data : NULL;
+}
+
+/* Get the datagram channel */
+datagram_t* get_connection_datagram(connection_t *conn) {
+    return conn && conn->cold ? conn->cold->datagram : NULL;
+}
+
+/* Write a file range with sendfile() */
+int send_file_range(connection_t *conn, int file_fd, uint64_t offset, size_t len) {
+    if (!conn || conn->state != STATE_READY) {
+        return NETWORK_ERROR_STATE;
+    }
+    
+    /* File bytes never pass through user space, so nothing could seal them */
+    if (conn->is_encrypted && !(conn->kernel_crypto & NETWORK_KERNEL_CRYPTO_TX)) {
+        return NETWORK_ERROR_STATE;
+    }
+    
+    return write_file_range(conn, file_fd, offset, len);
+}
+
+/* Write a file range unsealed, whatever the connection's encryption */
+int send_file_range_clear(connection_t *conn, int file_fd, uint64_t offset, size_t len) {
+    if (!conn || conn->state != STATE_READY) {
+        return NETWORK_ERROR_STATE;
+    }
+    
+    return write_file_range(conn, file_fd, offset, len);
+}
+
+/* Read unsealed bytes off the socket into a file */
+int receive_file_range_clear(connection_t *conn, int file_fd, uint64_t offset, size_t len) {
+    size_t moved = 0;
+    int result;
+    
+    if (!conn || conn->state != STATE_READY) {
+        return NETWORK_ERROR_STATE;
+    }
+    
+    if (file_fd < 0 || len == 0) {
+        return NETWORK_ERROR_PARAM;
+    }
+    
+    /* Staged input may already hold some of the bytes, out of order */
+    if (!connection_owns_socket(conn)) {
+        return NETWORK_ERROR_STATE;
+    }
+    
+    /* Socket to pipe to file without a user-space copy; files or kernels
+     * that refuse splice() take the rest through a buffer */
+    result = splice_file_range(conn, file_fd, offset, len, &moved);
+    if (result == NETWORK_ERROR_STATE) {
+        result = copy_file_range_in(conn, file_fd, offset + moved, len - moved);
+    }
+    
+    if (result == NETWORK_SUCCESS) {
+        update_connection_stats(conn, 0, len);
+    }
+    
+    return result;
+}
+
+/* Choose the profile for new sockets */
+void network_set_default_profile(network_profile_t profile) {
+    if ((int)profile < 0 || (int)profile >= PROFILE_COUNT) {
+        LOG_ERROR("Invalid socket profile: %d", (int)profile);
+        return;
+    }
+    
+    default_profile = profile;
+    LOG_DEBUG("Socket profile: %s", socket_profiles[profile].name);
+}
+
+/* Profile applied to new sockets */
+network_profile_t network_get_default_profile(void) {
+    return default_profile;
+}
+
+/* Retune an established connection */
+int set_connection_profile(connection_t *conn, network_profile_t profile) {
+    if (!conn || conn->sockfd < 0 || (int)profile < 0 || (int)profile >= PROFILE_COUNT) {
+        return NETWORK_ERROR_PARAM;
+    }
+    
+    apply_socket_profile(conn->sockfd, profile);
+    conn->rx_quickack = (uint8_t)socket_profiles[profile].quickack;
+    return NETWORK_SUCCESS;
+}
+
+/* Look up a profile by name */
+int network_profile_parse(const char *name, network_profile_t *profile) {
+    int i;
+    
+    if (!name || !profile) {
+        return NETWORK_ERROR_PARAM;
+    }
+    
+    for (i = 0; i < PROFILE_COUNT; i++) {
+        if (strcmp(name, socket_profiles[i].name) == 0) {
+            *profile = (network_profile_t)i;
+            return NETWORK_SUCCESS;
+        }
+    }
+    
+    return NETWORK_ERROR_PARAM;
+}
+
+/* Profile name */
+const char* network_profile_name(network_profile_t profile) {
+    if ((int)profile < 0 || (int)profile >= PROFILE_COUNT) {
+        return "unknown";
+    }
+    return socket_profiles[profile].name;
+}
+
+/* Create a connected pair of Unix-domain stream sockets */
+int create_socket_pair(int sv[2]) {
+    if (!sv) {
+        return NETWORK_ERROR_PARAM;
+    }
+    
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) < 0) {
+        LOG_ERROR("socketpair failed: %s", strerror(errno));
+        return NETWORK_ERROR_IO;
+    }
+    
+    return NETWORK_SUCCESS;
+}
+
+/* Set socket non-blocking mode */
+int set_nonblocking(int sockfd) {
+    if (platform_set_nonblocking(sockfd) != PLATFORM_SUCCESS) {
+        LOG_ERROR("Failed to make socket %d non-blocking", sockfd);
+        return NETWORK_ERROR_IO;
+    }
+    
+    return NETWORK_SUCCESS;
+}
+
+/* Hand a connection to another process */
+int pass_connection(int channel_fd, connection_t *conn, int timeout_ms) {
+    unsigned char crypto_state[CRYPTO_STATE_SIZE];
+    unsigned char *message, *p;
+    size_t host_len, password_len, crypto_len = 0, staged_len = 0, body_len;
+    uint8_t flags = 0;
+    int result;
+    
+    if (channel_fd < 0 || !conn || conn->sockfd < 0) {
+        return NETWORK_ERROR_PARAM;
+    }
+    
+    /* Only state this layer owns can travel: compression contexts,
+     * datagram channels and I/O backends stay behind (input a detached
+     * backend had already read is carried) */
+    if (conn->compression || conn->cold->datagram || conn->send_hook ||
+        conn->rx_staged == RX_STAGED_BACKEND ||
+        (!conn->is_listening && conn->state != STATE_CONNECTED &&
+         conn->state != STATE_AUTHENTICATING && conn->state != STATE_READY)) {
+        LOG_ERROR("Connection to %s cannot be passed in its state", conn->cold->remote_host);
+        return NETWORK_ERROR_STATE;
+    }
+    
+    /* Sealed output belongs to the sequence numbers being exported */
+    if (conn->tx_pending > 0) {
+        result = drain_output(conn, timeout_ms);
+        if (result != NETWORK_SUCCESS) {
+            return result;
+        }
+    }
+    
+    if (conn->crypto) {
+        result = crypto_session_export_state(conn->crypto, crypto_state, sizeof(crypto_state));
+        if (result != CRYPTO_SUCCESS) {
+            LOG_ERROR("Failed to export crypto state");
+            return NETWORK_ERROR_CRYPTO;
+        }
+        crypto_len = sizeof(crypto_state);
+        flags |= HANDOFF_CRYPTO;
+    }
+    
+    /* Input read but not yet received travels with the socket */
+    drop_frame(conn);
+    staged_len = conn->rx_ring.len;
+    
+    host_len = strlen(conn->cold->remote_host);
+    password_len = conn->cold->password ? strlen(conn->cold->password) : 0;
+    if (password_len > 0xFFFF) {
+        memset(crypto_state, 0, sizeof(crypto_state));
+        return NETWORK_ERROR_PARAM;
+    }
+    
+    if (conn->is_encrypted) flags |= HANDOFF_ENCRYPTED;
+    if (conn->is_listening) flags |= HANDOFF_LISTENING;
+    if (conn->seqpacket) flags |= HANDOFF_SEQPACKET;
+    
+    /* flags | state | kernel crypto | send seq(8) | recv seq(8) |
+     * connected at(8) | port(2) | host | password | crypto | staged input */
+    body_len = 3 + 8 + 8 + 8 + 2 + 1 + host_len + 2 + password_len +
+               2 + crypto_len + 4 + staged_len;
+    message = (unsigned char*)malloc(HANDOFF_PREFIX_SIZE + body_len);
+    if (!message) {
+        LOG_ERROR("Memory allocation failed");
+        memset(crypto_state, 0, sizeof(crypto_state));
+        return NETWORK_ERROR_MEMORY;
+    }
+    
+    p = put_field(message, HANDOFF_MAGIC, 4);
+    p = put_field(p, HANDOFF_VERSION, 1);
+    p = put_field(p, 0, 3);
+    p = put_field(p, body_len, 4);
+    p = put_field(p, flags, 1);
+    p = put_field(p, (uint64_t)conn->state, 1);
+    p = put_field(p, conn->kernel_crypto, 1);
+    p = put_field(p, conn->send_sequence, 8);
+    p = put_field(p, conn->recv_sequence, 8);
+    p = put_field(p, (uint64_t)conn->cold->connected_at, 8);
+    p = put_field(p, (uint64_t)conn->cold->remote_port, 2);
+    p = put_field(p, host_len, 1);
+    memcpy(p, conn->cold->remote_host, host_len);
+    p = put_field(p + host_len, password_len, 2);
+    if (password_len) memcpy(p, conn->cold->password, password_len);
+    p = put_field(p + password_len, crypto_len, 2);
+    if (crypto_len) memcpy(p, crypto_state, crypto_len);
+    p = put_field(p + crypto_len, staged_len, 4);
+    if (staged_len) memcpy(p, conn->rx_ring.data + conn->rx_ring.head, staged_len);
+    
+    result = handoff_write(channel_fd, message, HANDOFF_PREFIX_SIZE + body_len,
+                           conn->sockfd, timeout_ms);
+    
+    /* The message carries keys */
+    memset(message, 0, HANDOFF_PREFIX_SIZE + body_len);
+    memset(crypto_state, 0, sizeof(crypto_state));
+    free(message);
+    
+    if (result != NETWORK_SUCCESS) {
+        return result;
+    }
+    
+    LOG_INFO("Passed connection to %s:%d", conn->cold->remote_host, conn->cold->remote_port);
+    
+    /* The other process holds the socket now: drop this descriptor
+     * without shutting the connection down (once pinned output is
+     * released, if any) */
+    if (!defer_close(conn, conn->sockfd)) {
+        close_socket(conn->sockfd);
+    }
+    conn->sockfd = -1;
+    close_connection(conn);
+    return NETWORK_SUCCESS;
+}
+
+/* Take over a connection passed by another process */
+connection_t* accept_passed_connection(int channel_fd, int timeout_ms) {
+    unsigned char prefix[HANDOFF_PREFIX_SIZE];
+    unsigned char *body = NULL;
+    const unsigned char *p, *host, *password, *crypto_state, *staged;
+    size_t body_len = 0, host_len, password_len, crypto_len, staged_len;
+    connection_t *conn = NULL;
+    uint64_t send_sequence, recv_sequence, connected_at;
+    uint8_t flags, state, kernel_crypto;
+    int sockfd = -1, extra_fd = -1, port;
+    
+    if (channel_fd < 0) {
+        return NULL;
+    }
+    
+    if (handoff_read(channel_fd, prefix, sizeof(prefix), &sockfd, timeout_ms) != NETWORK_SUCCESS) {
+        goto fail;
+    }
+    
+    if (get_field(prefix, 4) != HANDOFF_MAGIC || prefix[4] != HANDOFF_VERSION) {
+        LOG_ERROR("Not a connection handoff");
+        goto fail;
+    }
+    
+    body_len = (size_t)get_field(prefix + 8, 4);
+    if (body_len > HANDOFF_MAX_BODY || body_len < 33 ||
+        !(body = (unsigned char*)malloc(body_len))) {
+        LOG_ERROR("Bad connection handoff length %zu", body_len);
+        goto fail;
+    }
+    
+    if (handoff_read(channel_fd, body, body_len, &extra_fd, timeout_ms) != NETWORK_SUCCESS) {
+        goto fail;
+    }
+    if (extra_fd >= 0) {
+        close(extra_fd);
+    }
+    if (sockfd < 0) {
+        LOG_ERROR("Connection handoff carried no socket");
+        goto fail;
+    }
+    
+    /* Fixed fields, then length-prefixed ones, each checked against the body */
+    p = body;
+    flags = p[0];
+    state = p[1];
+    kernel_crypto = p[2];
+    send_sequence = get_field(p + 3, 8);
+    recv_sequence = get_field(p + 11, 8);
+    connected_at = get_field(p + 19, 8);
+    port = (int)get_field(p + 27, 2);
+    host_len = p[29];
+    p += 30;
+    
+    if ((size_t)(p - body) + host_len + 2 > body_len) goto malformed;
+    host = p;
+    password_len = (size_t)get_field(p + host_len, 2);
+    p += host_len + 2;
+    if ((size_t)(p - body) + password_len + 2 > body_len) goto malformed;
+    password = p;
+    crypto_len = (size_t)get_field(p + password_len, 2);
+    p += password_len + 2;
+    if ((size_t)(p - body) + crypto_len + 4 > body_len) goto malformed;
+    crypto_state = p;
+    staged_len = (size_t)get_field(p + crypto_len, 4);
+    p += crypto_len + 4;
+    if ((size_t)(p - body) + staged_len != body_len) goto malformed;
+    staged = p;
+    
+    if ((flags & HANDOFF_LISTENING) ? state != STATE_READY :
+        (state != STATE_CONNECTED && state != STATE_AUTHENTICATING && state != STATE_READY)) {
+        goto malformed;
+    }
+    if (!(flags & HANDOFF_CRYPTO) != !crypto_len || (crypto_len && crypto_len != CRYPTO_STATE_SIZE)) {
+        goto malformed;
+    }
+    
+    /* Create connection structure */
+    conn = alloc_connection();
+    if (!conn || (!(flags & HANDOFF_LISTENING) && !(conn->send_lock = platform_mutex_create()))) {
+        LOG_ERROR("Memory allocation failed");
+        free_connection(conn);
+        conn = NULL;
+        goto fail;
+    }
+    
+    conn->sockfd = sockfd;
+    sockfd = -1;
+    conn->state = (connection_state_t)state;
+    conn->is_encrypted = (flags & HANDOFF_ENCRYPTED) ? 1 : 0;
+    conn->is_listening = (flags & HANDOFF_LISTENING) ? 1 : 0;
+    conn->kernel_crypto = kernel_crypto;
+    conn->send_sequence = send_sequence;
+    conn->recv_sequence = recv_sequence;
+    conn->cold->connected_at = (time_t)connected_at;
+    conn->last_activity = time(NULL);
+    conn->cold->remote_port = port;
+    memcpy(conn->cold->remote_host, host, host_len);
+    
+    if (password_len) {
+        conn->cold->password = (char*)malloc(password_len + 1);
+        if (!conn->cold->password) {
+            LOG_ERROR("Memory allocation failed");
+            goto discard;
+        }
+        memcpy(conn->cold->password, password, password_len);
+        conn->cold->password[password_len] = '\0';
+    }
+    
+    if (crypto_len) {
+        conn->crypto = crypto_session_import_state(crypto_state, crypto_len);
+        if (!conn->crypto) {
+            LOG_ERROR("Failed to import crypto state");
+            goto discard;
+        }
+    }
+    
+    /* Address and options follow the socket itself */
+    conn->cold->addr_len = sizeof(conn->cold->addr);
+    if ((conn->is_listening ?
+         getsockname(conn->sockfd, (struct sockaddr*)&conn->cold->addr, &conn->cold->addr_len) :
+         getpeername(conn->sockfd, (struct sockaddr*)&conn->cold->addr, &conn->cold->addr_len)) < 0) {
+        LOG_ERROR("Passed socket is not usable: %s", strerror(errno));
+        goto discard;
+    }
+    if (set_socket_options(conn->sockfd, conn->cold->addr.ss_family) != NETWORK_SUCCESS) {
+        goto discard;
+    }
+    
+    if (flags & HANDOFF_SEQPACKET) {
+        conn->seqpacket = 1;
+        if (!conn->is_listening) {
+            set_packet_mode(conn);
+        }
+    } else if (conn->cold->addr.ss_family != AF_UNIX) {
+        conn->rx_quickack = (uint8_t)socket_profiles[default_profile].quickack;
+    }
+    
+    /* Input read before the handoff comes first */
+    if (staged_len) {
+        unsigned char *span = ring_reserve(&conn->rx_ring, staged_len, 1);
+        
+        if (!span) {
+            LOG_ERROR("Memory allocation failed");
+            goto discard;
+        }
+        memcpy(span, staged, staged_len);
+        conn->rx_ring.len += staged_len;
+        if (!conn->seqpacket) {
+            conn->rx_staged = RX_STAGED_CARRIED;
+        }
+    }
+    
+    memset(body, 0, body_len);
+    free(body);
+    
+    LOG_INFO("Took over connection to %s:%d%s", conn->cold->remote_host, conn->cold->remote_port,
+             conn->is_encrypted ? " (encrypted)" : "");
+    
+    return conn;
+    
+malformed:
+    LOG_ERROR("Malformed connection handoff");
+    goto fail;
+    
+discard:
+    close_connection(conn);
+    free(conn);
+    
+fail:
+    if (sockfd >= 0) {
+        close_socket(sockfd);
+    }
+    if (body) {
+        memset(body, 0, body_len);
+        free(body);
+    }
+    return NULL;
+}
+
+/* Wait for socket readiness */
+int wait_for_socket(int sockfd, int timeout_ms, int wait_for_read, int wait_for_write) {
+    struct pollfd pfd;
+    int ready;
+    
+    if (sockfd < 0 || (!wait_for_read && !wait_for_write)) {
+        return -1;
+    }
+    
+    pfd.fd = sockfd;
+    pfd.events = 0;
+    pfd.revents = 0;
+    if (wait_for_read) pfd.events |= POLLIN;
+    if (wait_for_write) pfd.events |= POLLOUT;
+    
+    do {
+#ifdef _WIN32
+        ready = WSAPoll(&pfd, 1, timeout_ms);
+#else
+        ready = poll(&pfd, 1, timeout_ms);
+#endif
+    } while (ready < 0 && errno == EINTR);
+    
+    if (ready < 0) {
+        LOG_ERROR("poll failed: %s", strerror(errno));
+        return -1;
+    }
+    
+    if (ready > 0 && (pfd.revents & (POLLERR | POLLNVAL))) {
+        return -1;
+    }
+    
+    return ready > 0 ? 1 : 0;
+}
+
+/* Wait for a connection, collecting zerocopy completions on the way */
+int wait_for_connection(connection_t *conn, int timeout_ms, int wait_for_read,
+                        int wait_for_write) {
+    uint64_t deadline;
+    int ready;
+    
+    if (!conn) {
+        return -1;
+    }
+    
+    deadline = platform_get_time_ms() + (uint64_t)(timeout_ms > 0 ? timeout_ms : 0);
+    for (;;) {
+        uint64_t now;
+        
+        ready = wait_for_socket(conn->sockfd, timeout_ms, wait_for_read, wait_for_write);
+        
+        /* Completions wake poll as errors; a real error stays behind */
+        if (ready >= 0 || !conn->cold || conn->cold->zc.done == conn->cold->zc.next ||
+            reap_zerocopy(conn) <= 0) {
+            return ready;
+        }
+        
+        if (timeout_ms > 0) {
+            now = platform_get_time_ms();
+            timeout_ms = now >= deadline ? 0 : (int)(deadline - now);
+        }
+    }
+}
+
+/* Set socket options (keepalive and profiles are for TCP only) */
+static int set_socket_options(int sockfd, int family) {
+    int opt;
+    
+    /* Set non-blocking mode */
+    opt = fcntl(sockfd, F_GETFL, 0);
+    if (opt < 0) {
+        LOG_ERROR("fcntl(F_GETFL) failed: %s", strerror(errno));
+        return NETWORK_ERROR_IO;
+    }
+    
+    if (fcntl(sockfd, F_SETFL, opt | O_NONBLOCK) < 0) {
+        LOG_ERROR("fcntl(F_SETFL) failed: %s", strerror(errno));
+        return NETWORK_ERROR_IO;
+    }
+    
+    /* Set receive timeout */
+    struct timeval tv;
+    tv.tv_sec = RECV_TIMEOUT_SEC;
+    tv.tv_usec = 0;
+    
+    if (setsockopt(sockfd, SOL_SOCKET, SO_RCVTIMEO, (char*)&tv, sizeof(tv)) < 0) {
+        LOG_WARNING("setsockopt(SO_RCVTIMEO) failed: %s", strerror(errno));
+    }
+    
+    /* Set send timeout */
+    tv.tv_sec = SEND_TIMEOUT_SEC;
+    if (setsockopt(sockfd, SOL_SOCKET, SO_SNDTIMEO, (char*)&tv, sizeof(tv)) < 0) {
+        LOG_WARNING("setsockopt(SO_SNDTIMEO) failed: %s", strerror(errno));
+    }
+    
+    if (family == AF_UNIX) {
+        return NETWORK_SUCCESS;
+    }
+    
+    /* Enable TCP keepalive */
+    opt = 1;
+    if (setsockopt(sockfd, SOL_SOCKET, SO_KEEPALIVE, (char*)&opt, sizeof(opt)) < 0) {
+        LOG_WARNING("setsockopt(SO_KEEPALIVE) failed: %s", strerror(errno));
+    }
+    
+    apply_socket_profile(sockfd, default_profile);
+    return NETWORK_SUCCESS;
+}
+
+/* Internal: Set a profile's options. Each is best effort: an option the
+ * kernel lacks or refuses costs the profile that option only */
+static void apply_socket_profile(int sockfd, network_profile_t profile) {
+    const socket_profile_t *p = &socket_profiles[profile];
+    int opt;
+    
+    if (profile == NETWORK_PROFILE_DEFAULT) {
+        return;
+    }
+    
+    opt = p->nodelay;
+    if (setsockopt(sockfd, IPPROTO_TCP, TCP_NODELAY, (char*)&opt, sizeof(opt)) < 0) {
+        LOG_DEBUG("setsockopt(TCP_NODELAY) failed: %s", strerror(errno));
+    }
+    
+#ifdef TCP_QUICKACK
+    if (p->quickack) {
+        opt = 1;
+        if (setsockopt(sockfd, IPPROTO_TCP, TCP_QUICKACK, &opt, sizeof(opt)) < 0) {
+            LOG_DEBUG("setsockopt(TCP_QUICKACK) failed: %s", strerror(errno));
+        }
+    }
+#endif
+    
+#ifdef TCP_NOTSENT_LOWAT
+    /* Unsent data beyond this stays in user space, where it can still be
+     * coalesced, instead of queueing behind the congestion window */
+    if (p->notsent_lowat) {
+        opt = p->notsent_lowat;
+        if (setsockopt(sockfd, IPPROTO_TCP, TCP_NOTSENT_LOWAT, &opt, sizeof(opt)) < 0) {
+            LOG_DEBUG("setsockopt(TCP_NOTSENT_LOWAT) failed: %s", strerror(errno));
+        }
+    }
+#endif
+    
+#ifdef SO_BUSY_POLL
+    /* Raising it above net.core.busy_read needs CAP_NET_ADMIN */
+    if (p->busy_poll_us) {
+        opt = p->busy_poll_us;
+        if (setsockopt(sockfd, SOL_SOCKET, SO_BUSY_POLL, &opt, sizeof(opt)) < 0) {
+            LOG_DEBUG("setsockopt(SO_BUSY_POLL) failed: %s", strerror(errno));
+        }
+    }
+#endif
+    
+#ifdef TCP_CONGESTION
+    /* Unprivileged processes get net.ipv4.tcp_allowed_congestion_control only */
+    if (p->congestion &&
+        setsockopt(sockfd, IPPROTO_TCP, TCP_CONGESTION, p->congestion,
+                   (socklen_t)strlen(p->congestion)) < 0) {
+        LOG_DEBUG("setsockopt(TCP_CONGESTION, %s) failed: %s", p->congestion, strerror(errno));
+    }
+#endif
+    
+    if (p->buffer_hint) {
+        set_buffer_hint(sockfd, 0, p->buffer_hint);
+        set_buffer_hint(sockfd, 1, p->buffer_hint);
+    }
+}
+
+/* Internal: Fixing SO_SNDBUF/SO_RCVBUF turns autotuning off for that
+ * direction, so only do it when autotuning could not reach the hint but
+ * an explicit size gets closer. Otherwise say once which sysctl caps it */
+static void set_buffer_hint(int sockfd, int direction, int hint) {
+    static const char *const sysctls[2] = { "net.ipv4.tcp_wmem", "net.ipv4.tcp_rmem" };
+    static int hinted[2];
+    int size;
+    
+    if (autotune_max[direction] == 0 || autotune_max[direction] >= hint) {
+        return;
+    }
+    
+    if (buffer_max[direction] > autotune_max[direction]) {
+        /* The kernel doubles the size asked for to cover its overhead */
+        size = (hint < buffer_max[direction] ? hint : buffer_max[direction]) / 2;
+        if (setsockopt(sockfd, SOL_SOCKET, direction ? SO_RCVBUF : SO_SNDBUF,
+                       (char*)&size, sizeof(size)) < 0) {
+            LOG_DEBUG("setsockopt(%s) failed: %s", direction ? "SO_RCVBUF" : "SO_SNDBUF",
+                      strerror(errno));
+        }
+    } else if (!hinted[direction]) {
+        hinted[direction] = 1;
+        LOG_INFO("%s caps %s buffers at %d bytes; raise its maximum to %d for this profile",
+                 sysctls[direction], direction ? "receive" : "send",
+                 autotune_max[direction], hint);
+    }
+}
+
+/* Internal: Read the buffer sysctls (left 0 where unreadable, which
+ * leaves buffer sizing to the kernel) */
+static void load_buffer_limits(void) {
+#ifdef __linux__
+    static const char *const tcp_mem[2] = {
+        "/proc/sys/net/ipv4/tcp_wmem", "/proc/sys/net/ipv4/tcp_rmem"
+    };
+    static const char *const core_max[2] = {
+        "/proc/sys/net/core/wmem_max", "/proc/sys/net/core/rmem_max"
+    };
+    int direction, low, initial;
+    FILE *f;
+    
+    for (direction = 0; direction < 2; direction++) {
+        if ((f = fopen(tcp_mem[direction], "r"))) {
+            if (fscanf(f, "%d %d %d", &low, &initial, &autotune_max[direction]) != 3) {
+                autotune_max[direction] = 0;
+            }
+            fclose(f);
+        }
+        if ((f = fopen(core_max[direction], "r"))) {
+            if (fscanf(f, "%d", &buffer_max[direction]) != 1) {
+                buffer_max[direction] = 0;
+            }
+            fclose(f);
+        }
+    }
+#endif
+}
+
+/* Connect with retry logic: race the host's addresses each round, with
+ * capped exponential backoff and full jitter between rounds. Names come
+ * from the shared resolver cache, so only the first round (or an expired
+ * answer) waits for DNS */
+static int connect_with_retry(const char *host, int port, int max_retries,
+                              struct sockaddr_storage *addr, socklen_t *addr_len) {
+    resolver_addresses_t addresses;
+    int sockfd = -1;
+    int retries = 0;
+    int status;
+    
+    while (retries < max_retries) {
+        status = resolver_resolve(host, port, &addresses);
+        if (status == RESOLVER_SUCCESS) {
+            sockfd = race_connect(&addresses, addr, addr_len);
+        } else if (status != RESOLVER_ERROR_TEMPORARY) {
+            LOG_ERROR("Cannot resolve %s: %s", host, resolver_strerror(status));
+            return -1;
+        }
+        
+        if (sockfd >= 0) {
+            /* Connection successful */
+            return sockfd;
+        }
+        
+        /* Retry after delay */
+        retries++;
+        if (retries < max_retries) {
+            int delay_ms = backoff_delay_ms(retries - 1);
+            
+            LOG_WARNING("Connection attempt %d/%d failed, retrying in %dms...",
+                       retries, max_retries, delay_ms);
+            platform_sleep_ms(delay_ms);
+        }
+    }
+    
+    LOG_ERROR("Failed to connect after %d attempts", max_retries);
+    return -1;
+}
+
+/* Internal: Happy eyeballs (RFC 8305). Start a non-blocking connect to
+ * the next address every CONNECT_ATTEMPT_DELAY_MS, or as soon as one
+ * fails, keep the first to complete and close the rest. The winner is
+ * returned in blocking mode */
+static int race_connect(const resolver_addresses_t *addresses, struct sockaddr_storage *addr,
+                        socklen_t *addr_len) {
+    const resolver_address_t *order[MAX_CONNECT_ATTEMPTS];
+    const resolver_address_t *pending_ai[MAX_CONNECT_ATTEMPTS];
+    struct pollfd pending[MAX_CONNECT_ATTEMPTS];
+    const resolver_address_t *winner_ai = NULL;
+    int count = order_addresses(addresses, order, MAX_CONNECT_ATTEMPTS);
+    int next = 0, active = 0, winner = -1;
+    uint64_t start = platform_get_time_ms();
+    uint64_t next_start = start;
+    
+    while (winner < 0) {
+        uint64_t now = platform_get_time_ms();
+        int timeout_ms, ready;
+        
+        if (now - start >= CONNECT_TIMEOUT_MS) {
+            break;
+        }
+        
+        /* Next attempt: stagger elapsed, or nothing left in flight */
+        if (next < count && (active == 0 || now >= next_start)) {
+            int connected = 0;
+            int fd = start_connect_attempt(order[next], &connected);
+            
+            if (connected) {
+                winner = fd;
+                winner_ai = order[next];
+            } else if (fd >= 0) {
+                pending[active].fd = fd;
+                pending[active].events = POLLOUT;
+                pending[active].revents = 0;
+                pending_ai[active] = order[next];
+                active++;
+            }
+            next++;
+            next_start = now + CONNECT_ATTEMPT_DELAY_MS;
+            continue;
+        }
+        
+        if (active == 0) {
+            break;                  /* Every address failed */
+        }
+        
+        timeout_ms = (int)(CONNECT_TIMEOUT_MS - (now - start));
+        if (next < count && next_start - now < (uint64_t)timeout_ms) {
+            timeout_ms = (int)(next_start - now);
+        }
+        
+        ready = poll(pending, (nfds_t)active, timeout_ms);
+        if (ready < 0) {
+            if (errno == EINTR) continue;
+            LOG_ERROR("poll failed: %s", strerror(errno));
+            break;
+        }
+        
+        for (int i = 0; i < active && ready > 0; i++) {
+            int err = 0;
+            socklen_t err_len = sizeof(err);
+            
+            if (!pending[i].revents) {
+                continue;
+            }
+            ready--;
+            
+            if (getsockopt(pending[i].fd, SOL_SOCKET, SO_ERROR, &err, &err_len) == 0 &&
+                err == 0 && !(pending[i].revents & (POLLERR | POLLNVAL))) {
+                winner = pending[i].fd;
+                winner_ai = pending_ai[i];
+                pending[i] = pending[--active];
+                pending_ai[i] = pending_ai[active];
+                break;
+            }
+            
+            /* Failed: drop it and start the next address right away */
+            LOG_DEBUG("Connect attempt (%s) failed: %s",
+                      pending_ai[i]->family == AF_INET6 ? "IPv6" : "IPv4",
+                      strerror(err ? err : ECONNREFUSED));
+            close_socket(pending[i].fd);
+            pending[i] = pending[--active];
+            pending_ai[i] = pending_ai[active];
+            next_start = platform_get_time_ms();
+            i--;
+        }
+    }
+    
+    /* Cancel the attempts that lost */
+    for (int i = 0; i < active; i++) {
+        close_socket(pending[i].fd);
+    }
+    
+    if (winner < 0) {
+        return -1;
+    }
+    
+    fcntl(winner, F_SETFL, fcntl(winner, F_GETFL, 0) & ~O_NONBLOCK);
+    
+    memset(addr, 0, sizeof(*addr));
+    memcpy(addr, &winner_ai->addr, winner_ai->addr_len);
+    *addr_len = winner_ai->addr_len;
+    
+    LOG_DEBUG("Connected over %s after %llu ms",
+              winner_ai->family == AF_INET6 ? "IPv6" : "IPv4",
+              (unsigned long long)(platform_get_time_ms() - start));
+    
+    return winner;
+}
+
+/* Internal: Interleave address families, starting with the resolver's
+ * first choice (RFC 8305 section 4) */
+static int order_addresses(const resolver_addresses_t *addresses,
+                           const resolver_address_t **order, int max) {
+    int family = addresses->count > 0 ? addresses->addrs[0].family : AF_UNSPEC;
+    int primary = 0, secondary = 0;
+    int count = 0;
+    
+    while (count < max && (primary < addresses->count || secondary < addresses->count)) {
+        while (primary < addresses->count && addresses->addrs[primary].family != family) {
+            primary++;
+        }
+        if (primary < addresses->count) {
+            order[count++] = &addresses->addrs[primary++];
+        }
+        
+        while (secondary < addresses->count && addresses->addrs[secondary].family == family) {
+            secondary++;
+        }
+        if (secondary < addresses->count && count < max) {
+            order[count++] = &addresses->addrs[secondary++];
+        }
+    }
+    
+    return count;
+}
+
+/* Internal: Start a non-blocking connect (-1 if it failed outright) */
+static int start_connect_attempt(const resolver_address_t *target, int *connected) {
+    int fd = socket(target->family, SOCK_STREAM, IPPROTO_TCP);
+    
+    *connected = 0;
+    if (fd < 0) {
+        return -1;
+    }
+    
+    if (fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK) < 0) {
+        close_socket(fd);
+        return -1;
+    }
+    
+    /* Before connect(), so buffer sizes shape the window scale in the SYN */
+    apply_socket_profile(fd, default_profile);
+    
+    if (connect(fd, (const struct sockaddr*)&target->addr, target->addr_len) == 0) {
+        *connected = 1;
+        return fd;
+    }
+    
+    if (errno != EINPROGRESS) {
+        LOG_DEBUG("Connect attempt (%s) failed: %s",
+                  target->family == AF_INET6 ? "IPv6" : "IPv4", strerror(errno));
+        close_socket(fd);
+        return -1;
+    }
+    
+    return fd;
+}
+
+/* Internal: Full-jitter backoff: uniform in [0, min(max, base * 2^round)] */
+static int backoff_delay_ms(int round) {
+    uint32_t cap = BACKOFF_MAX_MS;
+    uint32_t r;
+    
+    if (round < 16 && ((uint32_t)BACKOFF_BASE_MS << round) < cap) {
+        cap = (uint32_t)BACKOFF_BASE_MS << round;
+    }
+    
+    if (platform_random_bytes((unsigned char*)&r, sizeof(r)) != PLATFORM_SUCCESS) {
+        r = (uint32_t)rand();
+    }
+    
+    return (int)(r % (cap + 1));
+}
+
+/* Internal: Read off the socket into the receive ring until it holds
+ * want bytes or the socket would block. Stream reads stop at want, so
+ * bytes behind a frame stay in the socket for whoever reads next (kernel
+ * TLS, splice()); sequenced packets are read whole, since a read shorter
+ * than the packet would drop its tail */
+static int fill_input(connection_t *conn, size_t want) {
+    while (conn->rx_ring.len < want && conn->rx_staged != RX_STAGED_BACKEND) {
+        size_t room = conn->seqpacket ? SEQPACKET_READ_MAX : want - conn->rx_ring.len;
+        unsigned char *span = ring_reserve(&conn->rx_ring, room, 1);
+        ssize_t got;
+        
+        if (!span) {
+            LOG_ERROR("Memory allocation failed");
+            return NETWORK_ERROR_MEMORY;
+        }
+        
+        if (conn->seqpacket) {
+            struct iovec iov;
+            struct msghdr msg;
+            
+            iov.iov_base = span;
+            iov.iov_len = room;
+            memset(&msg, 0, sizeof(msg));
+            msg.msg_iov = &iov;
+            msg.msg_iovlen = 1;
+            
+            got = recvmsg(conn->sockfd, &msg, 0);
+            if (got > 0 && (msg.msg_flags & MSG_TRUNC)) {
+                LOG_ERROR("Packet larger than %d bytes", SEQPACKET_READ_MAX);
+                return NETWORK_ERROR_BUFFER;
+            }
+        } else {
+            got = recv(conn->sockfd, span, room, 0);
+        }
+        
+        if (got < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                return NETWORK_SUCCESS;
+            }
+            LOG_ERROR("recv failed: %s", strerror(errno));
+            return NETWORK_ERROR_IO;
+        }
+        
+        if (got == 0) {
+            return NETWORK_ERROR_CLOSED;
+        }
+        
+        conn->rx_ring.len += (size_t)got;
+        
+#ifdef TCP_QUICKACK
+        /* The kernel drops back to delayed ACKs on its own; keep answering
+         * promptly so the peer's next small write is not held by Nagle */
+        if (conn->rx_quickack) {
+            int on = 1;
+            setsockopt(conn->sockfd, IPPROTO_TCP, TCP_QUICKACK, &on, sizeof(on));
+        }
+#endif
+    }
+    
+    return NETWORK_SUCCESS;
+}
+
+/* Internal: Gather one frame at the head of the receive ring: a
+ * header_len-byte header with the big-endian body length at
+ * length_offset, then the body. Returns the frame length once it is
+ * all there and 0 until then; what has arrived stays in the ring */
+static int assemble_frame(connection_t *conn, size_t header_len, size_t length_offset,
+                          size_t max_len) {
+    uint32_t body_len;
+    int result;
+    
+    result = fill_input(conn, header_len);
+    if (result != NETWORK_SUCCESS) {
+        return input_failed(conn, result);
+    }
+    if (conn->rx_ring.len < header_len) {
+        return 0;
+    }
+    
+    memcpy(&body_len, conn->rx_ring.data + conn->rx_ring.head + length_offset, sizeof(body_len));
+    body_len = ntohl(body_len);
+    if (body_len > max_len - header_len) {
+        LOG_ERROR("Frame too large: %lu bytes", (unsigned long)(header_len + body_len));
+        return input_failed(conn, NETWORK_ERROR_BUFFER);
+    }
+    
+    result = fill_input(conn, header_len + body_len);
+    if (result != NETWORK_SUCCESS) {
+        return input_failed(conn, result);
+    }
+    if (conn->rx_ring.len < header_len + body_len) {
+        return 0;
+    }
+    
+    return (int)(header_len + body_len);
+}
+
+/* Internal: Open the sealed record at the head of the receive ring in
+ * place; the plaintext stays there until the next receive */
+static int open_record(connection_t *conn, size_t wire_len, unsigned char **plain,
+                       size_t *plain_len) {
+    unsigned char *record = conn->rx_ring.data + conn->rx_ring.head + RECORD_LENGTH_SIZE;
+    
+    conn->rx_frame = wire_len;
+    update_connection_stats(conn, 0, wire_len);
+    
+    if (crypto_decrypt(conn->crypto, record, wire_len - RECORD_LENGTH_SIZE,
+                       record + CRYPTO_SEQUENCE_SIZE, plain_len) != CRYPTO_SUCCESS) {
+        LOG_ERROR("Decryption failed");
+        return NETWORK_ERROR_CRYPTO;
+    }
+    
+    *plain = record + CRYPTO_SEQUENCE_SIZE;
+    return (int)wire_len;
+}
+
+/* Internal: Release the frame the last receive returned. Carried input
+ * comes before the socket; once it runs out, the socket is read again */
+static void drop_frame(connection_t *conn) {
+    if (conn->rx_frame) {
+        ring_consume(&conn->rx_ring, conn->rx_frame);
+        conn->rx_frame = 0;
+    }
+    
+    if (conn->rx_staged == RX_STAGED_CARRIED && conn->rx_ring.len == 0) {
+        conn->rx_staged = 0;
+    }
+}
+
+/* Internal: Record why input stopped */
+static int input_failed(connection_t *conn, int status) {
+    if (status == NETWORK_ERROR_CLOSED) {
+        LOG_INFO("Connection closed by peer");
+        conn->state = STATE_CLOSING;
+    } else {
+        conn->state = STATE_ERROR;
+    }
+    
+    return status;
+}
+
+/* Internal: Seal into the send ring and hand the record to the send hook */
+static int send_via_hook(connection_t *conn, const unsigned char *data, size_t len) {
+    byte_ring_t *ring = &conn->tx_ring;
+    size_t sealed_len = len;
+    uint32_t length_be;
+    
+    /* Encrypt data if encryption is enabled; the record goes after any
+     * message assembled in the ring with connection_send_buffer() */
+    if (conn->is_encrypted && conn->crypto) {
+        int assembled = ring->data && data >= ring->data && data < ring->data + ring->size;
+        size_t offset = assembled ? (size_t)(data - ring->data) : 0;
+        unsigned char *sealed = ring_reserve(ring, len + RECORD_OVERHEAD, 0);
+        
+        if (!sealed) {
+            LOG_ERROR("Memory allocation failed");
+            return NETWORK_ERROR_MEMORY;
+        }
+        if (assembled) {
+            data = ring->data + offset;  /* The ring may have grown */
+        }
+        
+        if (crypto_encrypt(conn->crypto, data, len, sealed + RECORD_LENGTH_SIZE, &sealed_len)
+            != CRYPTO_SUCCESS) {
+            LOG_ERROR("Encryption failed");
+            return NETWORK_ERROR_CRYPTO;
+        }
+        length_be = htonl((uint32_t)sealed_len);
+        memcpy(sealed, &length_be, RECORD_LENGTH_SIZE);
+        sealed_len += RECORD_LENGTH_SIZE;
+        data = sealed;
+    }
+    
+    if (conn->send_hook(conn->send_hook_ctx, conn, data, sealed_len) < 0) {
+        LOG_ERROR("Send hook failed");
+        conn->state = STATE_ERROR;
+        return NETWORK_ERROR_IO;
+    }
+    
+    update_connection_stats(conn, 1, sealed_len);
+    return (int)sealed_len;
+}
+
+/* Internal: Return room for need bytes after the ring's readable data.
+ * The ring starts at RING_MIN_SIZE and grows to fit the largest record
+ * seen, so idle and small-message connections stay small while
+ * steady-state I/O allocates nothing */
+static unsigned char* ring_reserve(byte_ring_t *ring, size_t need, int mirror) {
+    if (!ring->data || ring->len + need > ring->size) {
+        byte_ring_t grown = { NULL, 0, 0, ring->len, 0 };
+        
+        /* Whole pages, so the ring can be mirrored */
+        grown.size = (ring->len + need + RING_MIN_SIZE - 1) / RING_MIN_SIZE * RING_MIN_SIZE;
+        
+        if (mirror) {
+            grown.data = allocate_mirrored_memory(grown.size);
+            grown.mirrored = grown.data != NULL;
+        }
+        if (!grown.data) {
+            grown.data = aligned_alloc(CACHE_LINE_SIZE, grown.size);
+            if (!grown.data) {
+                return NULL;
+            }
+        }
+        
+        if (ring->len > 0) {
+            memcpy(grown.data, ring->data + ring->head, ring->len);
+        }
+        ring_free(ring);
+        *ring = grown;
+    }
+    
+    /* Without the mirror, readable bytes move to the front when the
+     * free space would wrap */
+    if (!ring->mirrored && ring->head + ring->len + need > ring->size) {
+        memmove(ring->data, ring->data + ring->head, ring->len);
+        ring->head = 0;
+    }
+    
+    return ring->data + ring->head + ring->len;
+}
+
+/* Internal: Drop n readable bytes */
+static void ring_consume(byte_ring_t *ring, size_t n) {
+    ring->head += n;
+    ring->len -= n;
+    
+    if (ring->len == 0) {
+        ring->head = 0;
+    } else if (ring->head >= ring->size) {
+        ring->head -= ring->size;   /* Mirrored: same bytes in the first copy */
+    }
+}
+
+/* Internal: Wipe and release a ring */
+static void ring_free(byte_ring_t *ring) {
+    if (ring->data) {
+        memset(ring->data, 0, ring->size);
+        if (ring->mirrored) {
+            free_mirrored_memory(ring->data, ring->size);
+        } else {
+            free(ring->data);
+        }
+    }
+    memset(ring, 0, sizeof(*ring));
+}
+
+/* Internal: Encrypt a record into the tail of the output queue */
+static int seal_record(connection_t *conn, const unsigned char *data, size_t len,
+                       size_t *sealed_len) {
+    int encrypt = conn->is_encrypted && conn->crypto &&
+                  !(conn->kernel_crypto & NETWORK_KERNEL_CRYPTO_TX);
+    size_t need = encrypt ? len + RECORD_OVERHEAD : len;
+    int zerocopy = need >= NETWORK_ZEROCOPY_THRESHOLD && zerocopy_usable(conn);
+    int was_empty = conn->tx_pending == 0;
+    tx_segment_t *seg = conn->tx_tail;
+    int fresh = 0;
+    size_t high;
+    
+    if (conn->tx_pending + need > SEND_QUEUE_LIMIT) {
+        LOG_ERROR("Send queue limit reached (%zu bytes pending)", conn->tx_pending);
+        conn->state = STATE_ERROR;
+        return NETWORK_ERROR_BUFFER;
+    }
+    
+    /* Small records share a segment so one write carries many of them;
+     * a zerocopy record gets its own, since the kernel pins it until sent */
+    if (zerocopy || !seg || seg->zerocopy || seg->cap - seg->len < need) {
+        size_t cap = (zerocopy || need > TX_SEGMENT_SIZE) ? need : TX_SEGMENT_SIZE;
+        
+        seg = malloc(sizeof(tx_segment_t) + cap);
+        if (!seg) {
+            LOG_ERROR("Memory allocation failed");
+            conn->state = STATE_ERROR;
+            return NETWORK_ERROR_MEMORY;
+        }
+        memset(seg, 0, sizeof(tx_segment_t));
+        seg->cap = cap;
+        seg->zerocopy = zerocopy;
+        fresh = 1;
+    }
+    
+    /* The receiver finds record boundaries by the length in front */
+    if (encrypt) {
+        unsigned char *record = seg->data + seg->len;
+        uint32_t length_be;
+        
+        if (crypto_encrypt(conn->crypto, data, len, record + RECORD_LENGTH_SIZE, sealed_len)
+            != CRYPTO_SUCCESS) {
+            LOG_ERROR("Encryption failed");
+            if (fresh) free(seg);
+            return NETWORK_ERROR_CRYPTO;
+        }
+        length_be = htonl((uint32_t)*sealed_len);
+        memcpy(record, &length_be, RECORD_LENGTH_SIZE);
+        *sealed_len += RECORD_LENGTH_SIZE;
+    } else {
+        memcpy(seg->data + seg->len, data, len);
+        *sealed_len = len;
+    }
+    
+    seg->len += *sealed_len;
+    conn->tx_pending += *sealed_len;
+    
+    if (fresh) {
+        if (conn->tx_tail) {
+            conn->tx_tail->next = seg;
+        } else {
+            conn->tx_head = seg;
+        }
+        conn->tx_tail = seg;
+    }
+    
+    high = conn->tx_high_watermark ? conn->tx_high_watermark : NETWORK_SEND_HIGH_WATERMARK;
+    if (conn->tx_pending >= high) {
+        conn->tx_blocked = 1;
+    }
+    
+    /* A corked owner only needs telling once per flush */
+    if (was_empty && conn->tx_notify) {
+        conn->tx_notify(conn->tx_notify_ctx, conn);
+    }
+    
+    return NETWORK_SUCCESS;
+}
+
+/* Internal: Gather queued segments into sendmsg() calls until the queue
+ * is empty or the socket would block */
+static int write_queue(connection_t *conn) {
+    int copy_only = 0;
+    
+    while (conn->tx_head) {
+        struct iovec iov[MAX_GATHER_SEGMENTS];
+        struct msghdr msg;
+        int zerocopy = !copy_only && conn->tx_head->zerocopy && zerocopy_usable(conn);
+        int flags = 0;
+        size_t count = 0;
+        size_t room = conn->seqpacket ? SEQPACKET_WRITE_MAX : SIZE_MAX;
+        ssize_t sent;
+        
+        /* A zerocopy call carries only segments that may be pinned; on a
+         * packet socket each call is one packet, so it is kept small
+         * enough for any reader to take whole */
+        for (tx_segment_t *seg = conn->tx_head; seg && count < MAX_GATHER_SEGMENTS && room > 0;
+             seg = seg->next) {
+            if (zerocopy && !seg->zerocopy) break;
+            
+            iov[count].iov_base = seg->data + seg->sent;
+            iov[count].iov_len = seg->len - seg->sent;
+            if (iov[count].iov_len > room) {
+                iov[count].iov_len = room;
+            }
+            room -= iov[count].iov_len;
+            count++;
+        }
+        
+#ifdef NETWORK_ZEROCOPY
+        if (zerocopy) flags |= MSG_ZEROCOPY;
+#endif
+        
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = iov;
+        msg.msg_iovlen = count;
+        
+        sent = sendmsg(conn->sockfd, &msg, flags);
+        conn->send_calls++;
+        
+        if (sent < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                /* Full; the rest goes out on writability */
+                return NETWORK_SUCCESS;
+            }
+            if (zerocopy && errno == ENOBUFS) {
+                /* Out of pinned-page budget; copy until completions return it */
+                copy_only = 1;
+                continue;
+            }
+            LOG_ERROR("sendmsg failed: %s", strerror(errno));
+            conn->state = STATE_ERROR;
+            return NETWORK_ERROR_IO;
+        } else if (sent == 0) {
+            LOG_WARNING("Connection closed by peer during send");
+            conn->state = STATE_CLOSING;
+            return NETWORK_ERROR_CLOSED;
+        }
+        
+        consume_queue(conn, (size_t)sent, zerocopy);
+    }
+    
+    return NETWORK_SUCCESS;
+}
+
+/* Internal: Retire what one write took off the front of the queue */
+static void consume_queue(connection_t *conn, size_t sent, int zerocopy) {
+    uint32_t id = conn->cold->zc.next;
+    
+    /* The kernel numbers successful zerocopy calls from 0 */
+    if (zerocopy) {
+        conn->cold->zc.next++;
+        conn->cold->zc_sends++;
+    }
+    conn->tx_pending -= sent;
+    
+    while (sent > 0) {
+        tx_segment_t *seg = conn->tx_head;
+        size_t take = seg->len - seg->sent;
+        
+        if (take > sent) take = sent;
+        seg->sent += take;
+        sent -= take;
+        
+        if (zerocopy) {
+            seg->pinned = 1;
+            seg->zc_id = id;
+        }
+        
+        if (seg->sent < seg->len) {
+            break;
+        }
+        
+        conn->tx_head = seg->next;
+        if (!conn->tx_head) conn->tx_tail = NULL;
+        seg->next = NULL;
+        
+        /* Copied output is done with; pinned output waits for completion */
+        if (seg->pinned) {
+            if (conn->cold->zc.tail) {
+                conn->cold->zc.tail->next = seg;
+            } else {
+                conn->cold->zc.head = seg;
+            }
+            conn->cold->zc.tail = seg;
+        } else {
+            free(seg);
+        }
+    }
+}
+
+/* Internal: Sleep on writability until the output queue is empty */
+static int drain_output(connection_t *conn, int timeout_ms) {
+    while (conn->tx_pending > 0) {
+        int ready = wait_for_socket(conn->sockfd, timeout_ms, 0, 1);
+        int result;
+        
+        /* Zerocopy completions wake poll as errors; collect them and retry */
+        if (ready < 0 && conn->cold->zc.done != conn->cold->zc.next && reap_zerocopy(conn) > 0) {
+            continue;
+        }
+        
+        if (ready < 0) {
+            conn->state = STATE_ERROR;
+            return NETWORK_ERROR_IO;
+        }
+        if (ready == 0) {
+            LOG_ERROR("Send timed out with %zu bytes queued", conn->tx_pending);
+            conn->state = STATE_ERROR;
+            return NETWORK_ERROR_TIMEOUT;
+        }
+        
+        result = flush_connection(conn);
+        if (result < 0) {
+            return result;
+        }
+    }
+    
+    return NETWORK_SUCCESS;
+}
+
+/* Internal: Whether the next large record may go out with MSG_ZEROCOPY */
+static int zerocopy_usable(connection_t *conn) {
+#ifdef NETWORK_ZEROCOPY
+    /* Kernel TLS refuses MSG_ZEROCOPY and copies into its records anyway */
+    if (conn->cold->zc_mode == ZEROCOPY_OFF || (conn->kernel_crypto & NETWORK_KERNEL_CRYPTO_TX)) {
+        return 0;
+    }
+    
+    /* Opt the socket in on first use; older kernels refuse */
+    if (conn->cold->zc_socket == 0) {
+        int one = 1;
+        
+        if (setsockopt(conn->sockfd, SOL_SOCKET, SO_ZEROCOPY, &one, sizeof(one)) == 0) {
+            conn->cold->zc_socket = 1;
+        } else {
+            LOG_DEBUG("SO_ZEROCOPY unavailable: %s", strerror(errno));
+            conn->cold->zc_socket = -1;
+        }
+    }
+    
+    return conn->cold->zc_socket > 0;
+#else
+    (void)conn;
+    return 0;
+#endif
+}
+
+/* Internal: Collect zerocopy completions from the socket error queue and
+ * free the segments they release (count collected, or -1 on error) */
+static int reap_zerocopy(connection_t *conn) {
+    return reap_pins(conn->sockfd, &conn->cold->zc, conn);
+}
+
+/* Internal: reap_zerocopy() for any pin set; conn, if given, also
+ * tracks whether the kernel copied */
+static int reap_pins(int sockfd, zerocopy_pins_t *pins, connection_t *conn) {
+#ifdef NETWORK_ZEROCOPY
+    int reaped = 0;
+    
+    while (pins->done != pins->next) {
+        union {
+            char buf[CMSG_SPACE(sizeof(struct sock_extended_err) +
+                                sizeof(struct sockaddr_storage))];
+            struct cmsghdr align;
+        } control;
+        struct msghdr msg;
+        struct cmsghdr *cmsg;
+        
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_control = control.buf;
+        msg.msg_controllen = sizeof(control.buf);
+        
+        /* The error queue never blocks; EAGAIN means nothing is left */
+        if (recvmsg(sockfd, &msg, MSG_ERRQUEUE) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                break;
+            }
+            LOG_ERROR("recvmsg(MSG_ERRQUEUE) failed: %s", strerror(errno));
+            return -1;
+        }
+        
+        for (cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+            struct sock_extended_err *err = (struct sock_extended_err*)CMSG_DATA(cmsg);
+            
+            if (err->ee_errno != 0 || err->ee_origin != SO_EE_ORIGIN_ZEROCOPY) {
+                continue;
+            }
+            
+            if (conn) {
+                account_zerocopy(conn, err->ee_info, err->ee_data,
+                                 err->ee_code & SO_EE_CODE_ZEROCOPY_COPIED);
+            }
+            if (complete_pins(pins, err->ee_info, err->ee_data) < 0) {
+                LOG_ERROR("Zerocopy completions out of order and no memory to hold them");
+                return -1;
+            }
+            reaped++;
+        }
+    }
+    
+    /* Segments were pinned in id order; free those now fully released */
+    while (pins->head && (int32_t)(pins->head->zc_id - pins->done) < 0) {
+        tx_segment_t *seg = pins->head;
+        
+        pins->head = seg->next;
+        if (!pins->head) pins->tail = NULL;
+        free(seg);
+    }
+    
+    return reaped;
+#else
+    (void)sockfd;
+    (void)pins;
+    (void)conn;
+    return 0;
+#endif
+}
+
+/* Internal: Free pinned output and forget its completions */
+static void free_pins(zerocopy_pins_t *pins) {
+    free_segments(pins->head);
+    free(pins->parked);
+    pins->head = pins->tail = NULL;
+    pins->parked = NULL;
+    pins->parked_count = pins->parked_cap = 0;
+    pins->done = pins->next;
+}
+
+#ifdef NETWORK_ZEROCOPY
+/* Internal: Count completions the kernel served by copying */
+static void account_zerocopy(connection_t *conn, uint32_t lo, uint32_t hi, int copied) {
+    if (copied) {
+        conn->cold->zc_copied += hi - lo + 1;
+        
+        /* Loopback and devices without scatter-gather copy anyway, and
+         * then pinning only adds notification work */
+        if (++conn->cold->zc_copied_run >= ZEROCOPY_COPIED_LIMIT &&
+            conn->cold->zc_mode == ZEROCOPY_AUTO) {
+            LOG_DEBUG("Zerocopy sends are being copied by the kernel; sending by copy");
+            conn->cold->zc_mode = ZEROCOPY_OFF;
+        }
+    } else {
+        conn->cold->zc_copied_run = 0;
+    }
+}
+
+/* Internal: Record a completed id range. Ranges normally arrive in order;
+ * one past a gap is parked until the gap fills, however many there are */
+static int complete_pins(zerocopy_pins_t *pins, uint32_t lo, uint32_t hi) {
+    if ((int32_t)(lo - pins->done) > 0) {
+        if (pins->parked_count == pins->parked_cap) {
+            int cap = pins->parked_cap ? pins->parked_cap * 2 : ZEROCOPY_PARKED_INITIAL;
+            uint32_t (*parked)[2] = realloc(pins->parked, (size_t)cap * sizeof(*parked));
+            
+            if (!parked) {
+                return -1;
+            }
+            pins->parked = parked;
+            pins->parked_cap = cap;
+        }
+        pins->parked[pins->parked_count][0] = lo;
+        pins->parked[pins->parked_count][1] = hi;
+        pins->parked_count++;
+        return 0;
+    }
+    
+    if ((int32_t)(hi + 1 - pins->done) > 0) {
+        pins->done = hi + 1;
+    }
+    
+    /* The new edge may reach parked ranges */
+    for (int i = 0; i < pins->parked_count; ) {
+        if ((int32_t)(pins->parked[i][0] - pins->done) > 0) {
+            i++;
+            continue;
+        }
+        
+        if ((int32_t)(pins->parked[i][1] + 1 - pins->done) > 0) {
+            pins->done = pins->parked[i][1] + 1;
+        }
+        pins->parked_count--;
+        pins->parked[i][0] = pins->parked[pins->parked_count][0];
+        pins->parked[i][1] = pins->parked[pins->parked_count][1];
+        i = 0;
+    }
+    
+    return 0;
+}
+#endif
+
+/* Internal: Free a list of output segments */
+static void free_segments(tx_segment_t *seg) {
+    while (seg) {
+        tx_segment_t *next = seg->next;
+        free(seg);
+        seg = next;
+    }
+}
+
+/* Internal: sendfile() a range after any queued output */
+static int write_file_range(connection_t *conn, int file_fd, uint64_t offset, size_t len) {
+#ifdef __linux__
+    off_t pos = (off_t)offset;
+    size_t left = len;
+    int result;
+    
+    if (file_fd < 0 || len == 0) {
+        return NETWORK_ERROR_PARAM;
+    }
+    
+    if (!connection_owns_socket(conn)) {
+        return NETWORK_ERROR_STATE;
+    }
+    
+    /* The file data goes after every record already queued */
+    result = drain_output(conn, SEND_TIMEOUT_SEC * 1000);
+    if (result != NETWORK_SUCCESS) {
+        return result;
+    }
+    
+    while (left > 0) {
+        ssize_t sent = sendfile(conn->sockfd, file_fd, &pos, left);
+        
+        if (sent > 0) {
+            left -= (size_t)sent;
+            conn->send_calls++;
+            continue;
+        }
+        
+        if (sent == 0) {
+            LOG_ERROR("File ended %zu bytes short of the requested range", left);
+            conn->state = STATE_ERROR;
+            return NETWORK_ERROR_IO;
+        }
+        
+        if (errno == EINTR) {
+            continue;
+        }
+        
+        if (errno != EAGAIN && errno != EWOULDBLOCK) {
+            LOG_ERROR("sendfile failed: %s", strerror(errno));
+            conn->state = STATE_ERROR;
+            return NETWORK_ERROR_IO;
+        }
+        
+        result = wait_for_socket(conn->sockfd, SEND_TIMEOUT_SEC * 1000, 0, 1);
+        if (result <= 0) {
+            LOG_ERROR("sendfile stalled with %zu bytes left", left);
+            conn->state = STATE_ERROR;
+            return result == 0 ? NETWORK_ERROR_TIMEOUT : NETWORK_ERROR_IO;
+        }
+    }
+    
+    update_connection_stats(conn, 1, len);
+    return NETWORK_SUCCESS;
+#else
+    (void)conn;
+    (void)file_fd;
+    (void)offset;
+    (void)len;
+    return NETWORK_ERROR_STATE;
+#endif
+}
+
+/* Internal: splice() socket -> pipe -> file; NETWORK_ERROR_STATE with
+ * *moved set when splicing is refused partway */
+static int splice_file_range(connection_t *conn, int file_fd, uint64_t offset, size_t len,
+                             size_t *moved) {
+#ifdef __linux__
+    loff_t pos = (loff_t)offset;
+    
+    if (!conn->rx_pipe_open) {
+        if (pipe2(conn->cold->rx_pipe, O_CLOEXEC) < 0) {
+            return NETWORK_ERROR_STATE;
+        }
+        conn->rx_pipe_open = 1;
+    }
+    
+    while (*moved < len) {
+        size_t want = len - *moved < SPLICE_CHUNK ? len - *moved : SPLICE_CHUNK;
+        ssize_t in = splice(conn->sockfd, NULL, conn->cold->rx_pipe[1], NULL, want,
+                            SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+        
+        if (in == 0) {
+            LOG_INFO("Connection closed by peer");
+            conn->state = STATE_CLOSING;
+            return NETWORK_ERROR_CLOSED;
+        }
+        
+        if (in < 0) {
+            int ready;
+            
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EINVAL || errno == ENOSYS) {
+                return NETWORK_ERROR_STATE;
+            }
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                LOG_ERROR("splice from socket failed: %s", strerror(errno));
+                conn->state = STATE_ERROR;
+                return NETWORK_ERROR_IO;
+            }
+            
+            ready = wait_for_socket(conn->sockfd, RECV_TIMEOUT_SEC * 1000, 1, 0);
+            if (ready <= 0) {
+                conn->state = STATE_ERROR;
+                return ready == 0 ? NETWORK_ERROR_TIMEOUT : NETWORK_ERROR_IO;
+            }
+            continue;
+        }
+        
+        /* Whatever entered the pipe must reach the file before falling back */
+        while (in > 0) {
+            ssize_t out = splice(conn->cold->rx_pipe[0], NULL, file_fd, &pos, (size_t)in,
+                                 SPLICE_F_MOVE);
+            
+            if (out < 0 && errno == EINTR) {
+                continue;
+            }
+            if (out <= 0) {
+                LOG_ERROR("splice to file failed: %s", out < 0 ? strerror(errno) : "no progress");
+                conn->state = STATE_ERROR;
+                return NETWORK_ERROR_IO;
+            }
+            
+            in -= out;
+            *moved += (size_t)out;
+        }
+    }
+    
+    return NETWORK_SUCCESS;
+#else
+    (void)conn;
+    (void)file_fd;
+    (void)offset;
+    (void)len;
+    (void)moved;
+    return NETWORK_ERROR_STATE;
+#endif
+}
+
+/* Internal: recv() into the receive ring's free space and pwrite() it
+ * out; the bytes are never committed to the ring */
+static int copy_file_range_in(connection_t *conn, int file_fd, uint64_t offset, size_t len) {
+#ifndef _WIN32
+    while (len > 0) {
+        size_t want = len < FILE_COPY_CHUNK ? len : FILE_COPY_CHUNK;
+        unsigned char *buffer = ring_reserve(&conn->rx_ring, want, 1);
+        ssize_t received;
+        
+        if (!buffer) {
+            LOG_ERROR("Memory allocation failed");
+            conn->state = STATE_ERROR;
+            return NETWORK_ERROR_MEMORY;
+        }
+        
+        received = recv(conn->sockfd, buffer, want, 0);
+        
+        if (received == 0) {
+            LOG_INFO("Connection closed by peer");
+            conn->state = STATE_CLOSING;
+            return NETWORK_ERROR_CLOSED;
+        }
+        
+        if (received < 0) {
+            int ready;
+            
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                LOG_ERROR("recv failed: %s", strerror(errno));
+                conn->state = STATE_ERROR;
+                return NETWORK_ERROR_IO;
+            }
+            
+            ready = wait_for_socket(conn->sockfd, RECV_TIMEOUT_SEC * 1000, 1, 0);
+            if (ready <= 0) {
+                conn->state = STATE_ERROR;
+                return ready == 0 ? NETWORK_ERROR_TIMEOUT : NETWORK_ERROR_IO;
+            }
+            continue;
+        }
+        
+        if (pwrite(file_fd, buffer, (size_t)received, (off_t)offset) != received) {
+            LOG_ERROR("File write failed: %s", strerror(errno));
+            conn->state = STATE_ERROR;
+            return NETWORK_ERROR_IO;
+        }
+        
+        offset += (uint64_t)received;
+        len -= (size_t)received;
+    }
+    
+    return NETWORK_SUCCESS;
+#else
+    (void)conn;
+    (void)file_fd;
+    (void)offset;
+    (void)len;
+    return NETWORK_ERROR_STATE;
+#endif
+}
+
+/* Internal: Move a closing socket whose output the kernel still
+ * references to the reap list, so the caller never waits for
+ * completions. Returns 1 if the list now owns sockfd */
+static int defer_close(connection_t *conn, int sockfd) {
+#ifdef NETWORK_ZEROCOPY
+    pinned_socket_t *pinned;
+    struct epoll_event ev;
+    
+    if (conn->cold->zc.done == conn->cold->zc.next ||
+        (reap_zerocopy(conn) >= 0 && conn->cold->zc.done == conn->cold->zc.next)) {
+        return 0;
+    }
+    
+    /* Nowhere to wait: a reset socket drops its references at once */
+    pinned = (reap_lock && reap_epfd >= 0) ? calloc(1, sizeof(*pinned)) : NULL;
+    if (!pinned) {
+        reset_socket(sockfd);
+        return 0;
+    }
+    
+    pinned->sockfd = sockfd;
+    pinned->deadline_ms = platform_get_time_ms() + ZEROCOPY_LINGER_MS;
+    pinned->pins = conn->cold->zc;
+    memset(&conn->cold->zc, 0, sizeof(conn->cold->zc));
+    conn->cold->zc.next = conn->cold->zc.done = pinned->pins.next;
+    
+    /* Edge-triggered: each batch of completions wakes the list once */
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLET;
+    ev.data.ptr = pinned;
+    
+    platform_mutex_lock(reap_lock);
+    if (epoll_ctl(reap_epfd, EPOLL_CTL_ADD, sockfd, &ev) < 0) {
+        platform_mutex_unlock(reap_lock);
+        LOG_WARNING("Cannot watch closed socket for completions: %s", strerror(errno));
+        conn->cold->zc = pinned->pins;
+        free(pinned);
+        reset_socket(sockfd);
+        return 0;
+    }
+    pinned->next = reap_list;
+    reap_list = pinned;
+    reap_count++;
+    platform_mutex_unlock(reap_lock);
+    
+    LOG_DEBUG("Socket %d closes once its pinned output is released", sockfd);
+    
+    /* Without an event loop watching, closes drive the list */
+    network_reap_closed();
+    return 1;
+#else
+    (void)conn;
+    (void)sockfd;
+    return 0;
+#endif
+}
+
+/* Internal: Make close() abort the connection, discarding unsent data */
+static void reset_socket(int sockfd) {
+    struct linger abort_close = { 1, 0 };
+    
+    setsockopt(sockfd, SOL_SOCKET, SO_LINGER, &abort_close, sizeof(abort_close));
+}
+
+/* Internal: Read a sequenced packet socket through the receive ring */
+static void set_packet_mode(connection_t *conn) {
+    conn->seqpacket = 1;
+    conn->rx_staged = RX_STAGED_PACKETS;
+}
+
+/* Internal: Big-endian handoff fields */
+static unsigned char* put_field(unsigned char *p, uint64_t value, int bytes) {
+    for (int i = bytes - 1; i >= 0; i--) {
+        p[i] = (unsigned char)value;
+        value >>= 8;
+    }
+    return p + bytes;
+}
+
+static uint64_t get_field(const unsigned char *p, int bytes) {
+    uint64_t value = 0;
+    
+    for (int i = 0; i < bytes; i++) {
+        value = (value << 8) | p[i];
+    }
+    return value;
+}
+
+/* Internal: Write a handoff message; the descriptor rides on its first
+ * byte, so a short first write still delivers it */
+static int handoff_write(int channel_fd, const unsigned char *data, size_t len, int fd,
+                         int timeout_ms) {
+    union {
+        struct cmsghdr align;
+        char buf[CMSG_SPACE(sizeof(int))];
+    } control;
+    size_t done = 0;
+    
+    while (done < len) {
+        struct iovec iov;
+        struct msghdr msg;
+        ssize_t sent;
+        
+        iov.iov_base = (void*)(data + done);
+        iov.iov_len = len - done;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        
+        if (done == 0) {
+            struct cmsghdr *cmsg;
+            
+            memset(&control, 0, sizeof(control));
+            msg.msg_control = control.buf;
+            msg.msg_controllen = sizeof(control.buf);
+            cmsg = CMSG_FIRSTHDR(&msg);
+            cmsg->cmsg_level = SOL_SOCKET;
+            cmsg->cmsg_type = SCM_RIGHTS;
+            cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+            memcpy(CMSG_DATA(cmsg), &fd, sizeof(int));
+        }
+        
+        sent = sendmsg(channel_fd, &msg, MSG_NOSIGNAL);
+        if (sent > 0) {
+            done += (size_t)sent;
+        } else if (sent < 0 && errno == EINTR) {
+            continue;
+        } else if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            int ready = wait_for_socket(channel_fd, timeout_ms, 0, 1);
+            
+            if (ready <= 0) {
+                return ready == 0 ? NETWORK_ERROR_TIMEOUT : NETWORK_ERROR_IO;
+            }
+        } else {
+            LOG_ERROR("Connection handoff failed: %s", strerror(errno));
+            return NETWORK_ERROR_IO;
+        }
+    }
+    
+    return NETWORK_SUCCESS;
+}
+
+/* Internal: Read exactly len handoff bytes, keeping the first descriptor
+ * that arrives in *fd and closing any others */
+static int handoff_read(int channel_fd, unsigned char *data, size_t len, int *fd,
+                        int timeout_ms) {
+    union {
+        struct cmsghdr align;
+        char buf[CMSG_SPACE(sizeof(int) * 4)];
+    } control;
+    size_t done = 0;
+    
+    while (done < len) {
+        struct cmsghdr *cmsg;
+        struct iovec iov;
+        struct msghdr msg;
+        ssize_t got;
+        int ready;
+        
+        ready = wait_for_socket(channel_fd, timeout_ms, 1, 0);
+        if (ready <= 0) {
+            return ready == 0 ? NETWORK_ERROR_TIMEOUT : NETWORK_ERROR_IO;
+        }
+        
+        iov.iov_base = data + done;
+        iov.iov_len = len - done;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = control.buf;
+        msg.msg_controllen = sizeof(control.buf);
+        
+        got = recvmsg(channel_fd, &msg, HANDOFF_RECV_FLAGS);
+        if (got < 0) {
+            if (errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK) {
+                continue;
+            }
+            LOG_ERROR("Connection handoff failed: %s", strerror(errno));
+            return NETWORK_ERROR_IO;
+        }
+        
+        for (cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+            size_t count, i;
+            
+            if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS) {
+                continue;
+            }
+            count = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+            for (i = 0; i < count; i++) {
+                int passed;
+                
+                memcpy(&passed, CMSG_DATA(cmsg) + i * sizeof(int), sizeof(int));
+                if (*fd < 0) {
+                    *fd = passed;
+                } else {
+                    close(passed);
+                }
+            }
+        }
+        
+        if (got == 0) {
+            return NETWORK_ERROR_CLOSED;
+        }
+        done += (size_t)got;
+    }
+    
+    return NETWORK_SUCCESS;
+}
+
+/* Internal: Zeroed connection starting on a cache line boundary, with
+ * its cold part */
+static connection_t* alloc_connection(void) {
+    connection_t *conn = aligned_alloc(CACHE_LINE_SIZE, sizeof(connection_t));
+
+    if (!conn) {
+        return NULL;
+    }
+    memset(conn, 0, sizeof(connection_t));
+
+    conn->cold = calloc(1, sizeof(connection_cold_t));
+    if (!conn->cold) {
+        free(conn);
+        return NULL;
+    }
+    return conn;
+}
+
+/* Internal: Release a connection that never got as far as opening */
+static void free_connection(connection_t *conn) {
+    if (conn) {
+        free(conn->cold);
+        free(conn);
+    }
+}
+
+/* Update connection statistics */
+static void update_connection_stats(connection_t *conn, int is_send, size_t bytes) {
+    if (!conn) return;
+    
+    conn->last_activity = platform_coarse_time();
     
     if (is_send) {
         conn->bytes_sent += bytes;
@@ -7,30 +7,54 @@
 
 #include "protocol.h"
 #include "crypto.h"
+#include "compression.h"
 #include "network.h"
+#include "session_ticket.h"
+#include "ktls.h"
+#include "datagram.h"
+#include "platform.h"
 #include "utils/logger.h"
 #include <stdio.h>
 #include <stdlib.h>
+#include <stddef.h>
 #include <string.h>
 #include <time.h>
+#include <stdatomic.h>
+#include <errno.h>
+#include <pthread.h>
 #include <openssl/sha.h>
 
 /* Protocol constants */
-#define PROTOCOL_VERSION "1.0"
+#define PROTOCOL_VERSION "2.0"
+#define PROTOCOL_VERSION_MAJOR 2    /* 2.0: sealed records carry their length in front */
+#define PROTOCOL_VERSION_MINOR 0
 #define PROTOCOL_MAGIC "CRYPTCAT"
 #define HANDSHAKE_TIMEOUT 10  /* seconds */
 #define MAX_PACKET_SIZE 65536
+#define MAX_WIRE_PAYLOAD (MAX_PACKET_SIZE + COMPRESSION_HEADER_SIZE + COMPRESSION_MAX_EXPANSION)
 #define CHALLENGE_SIZE 32
+#define KDF_MAX_THREADS 8           /* Key derivations run in parallel, at most */
+#define EARLY_DATA_MAX (256 * 1024) /* Early data kept for a replay, at most */
+#define EARLY_DATA_ENTRY_HEADER (1 + sizeof(uint32_t))
 
 /* Message types */
 typedef enum {
     MSG_HANDSHAKE_INIT = 0x01,
     MSG_HANDSHAKE_RESPONSE = 0x02,
     MSG_HANDSHAKE_COMPLETE = 0x03,
+    MSG_SESSION_TICKET = 0x04,
+    MSG_KTLS_REQUEST = 0x05,
+    MSG_KTLS_RESPONSE = 0x06,
+    MSG_DGRAM_REQUEST = 0x07,
+    MSG_DGRAM_RESPONSE = 0x08,
     MSG_DATA = 0x10,
     MSG_FILE_START = 0x20,
     MSG_FILE_CHUNK = 0x21,
     MSG_FILE_END = 0x22,
+    MSG_WINDOW_UPDATE = 0x23,
+    MSG_FILE_BULK = 0x24,
+    MSG_FILE_STRIPE = 0x25,
+    MSG_STRIPE_JOIN = 0x26,
     MSG_KEEPALIVE = 0x30,
     MSG_DISCONNECT = 0x40,
     MSG_ERROR = 0xFF
@@ -54,15 +78,129 @@ typedef struct {
     uint8_t response[CHALLENGE_SIZE];
     uint32_t supported_ciphers;
     uint16_t max_packet_size;
-    uint8_t compression;        /* 0 = none, 1 = zlib, 2 = lz4 */
+    uint8_t compression;        /* 0 = none, 1 = zlib, 2 = lz4, 3 = zstd */
 } handshake_data_t;
 
+/* Handshake init flags (byte 3) */
+#define HANDSHAKE_FLAG_RESUME 0x01
+
+/* Handshake response status (byte 3) */
+#define HANDSHAKE_STATUS_FULL 0
+#define HANDSHAKE_STATUS_RESUMED 1
+#define HANDSHAKE_STATUS_REJECTED 2
+
+/* Handshake phases */
+typedef enum {
+    HANDSHAKE_PHASE_SEND_INIT = 0,   /* Client: nothing sent yet */
+    HANDSHAKE_PHASE_WAIT_INIT,       /* Server: waiting for init */
+    HANDSHAKE_PHASE_WAIT_RESPONSE,   /* Client: init sent, KDF running */
+    HANDSHAKE_PHASE_SKIP_EARLY_DATA, /* Server: ticket refused, dropping records sealed under it */
+    HANDSHAKE_PHASE_WAIT_KEYS,       /* Network done, KDF may still be running */
+    HANDSHAKE_PHASE_WAIT_COMPLETE,   /* Server: keys ready, waiting for complete */
+    HANDSHAKE_PHASE_DONE,
+    HANDSHAKE_PHASE_FAILED
+} handshake_phase_t;
+
+/* Key derivation job state (guarded by kdf_lock) */
+typedef enum {
+    KDF_IDLE = 0,                    /* Not started */
+    KDF_QUEUED,
+    KDF_RUNNING,
+    KDF_FINISHED
+} kdf_state_t;
+
+/* Handshake state machine */
+struct handshake_s {
+    connection_t *conn;
+    int is_server;
+    handshake_phase_t phase;
+    char *password;                 /* Copy used by the KDF worker */
+    compression_codec_t codec;      /* Negotiated codec */
+    int ticket_aware;               /* Peer understands codec/ticket bytes */
+    kdf_state_t kdf_state;
+    struct handshake_s *kdf_next;   /* Pool queue link */
+    int kdf_inline;                 /* Caller blocks; keys derived on its thread */
+    int send_locked;                /* Caller holds the send lock */
+    atomic_int kdf_done;            /* Set by the pool when finished */
+    crypto_session_t *kdf_session;  /* Pool result */
+    handshake_notify_t notify;      /* Told when the keys are ready */
+    void *notify_ctx;
+    uint64_t start_us;
+    uint64_t kdf_start_us;
+    uint64_t kdf_end_us;
+    uint64_t kdf_wait_us;           /* First time the keys were asked for */
+    uint64_t keys_ready_us;
+    handshake_timing_t timing;
+};
+
+/* Messages a resuming client sent before the server took the ticket.
+ * Kept until the server confirms, and sent again after a full handshake
+ * if it refuses (guarded by the send lock) */
+typedef struct {
+    char *password;                 /* For the full handshake */
+    uint64_t first_sequence;        /* Sequence number after the init */
+    unsigned char *data;            /* Entries: type(1) | length(4) | payload */
+    size_t len;
+    size_t cap;
+    int overflow;                   /* Something was not kept; no replay */
+    int replaying;                  /* Fallback running; keep nothing new */
+} early_data_t;
+
+/* Resuming init: version(2) | codecs(1) | flags(1) | nonce | ticket */
+#define RESUME_INIT_HEADER (4 + SESSION_TICKET_NONCE_SIZE)
+
+/* Bulk message types that go through record compression */
+#define IS_COMPRESSED_TYPE(t) ((t) == MSG_DATA || (t) == MSG_FILE_CHUNK)
+
+/* Key derivation pool shared by every handshake. Threads start on
+ * demand, up to one per CPU, and live for the rest of the process */
+static pthread_mutex_t kdf_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t kdf_work = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t kdf_finished = PTHREAD_COND_INITIALIZER;
+static handshake_t *kdf_queue_head = NULL;  /* Waiting jobs, oldest first */
+static handshake_t *kdf_queue_tail = NULL;
+static int kdf_thread_count = 0;
+static int kdf_idle_count = 0;              /* Threads waiting for a job */
+
 /* Internal function prototypes */
 static int validate_header(const message_header_t *header);
+static int send_message_locked(connection_t *conn, message_type_t type,
+                               const unsigned char *payload, size_t payload_len);
+static int send_prefixed_message(connection_t *conn, message_type_t type,
+                                 const void *prefix, size_t prefix_len,
+                                 const unsigned char *data, size_t data_len);
+static void fill_header(connection_t *conn, message_header_t *header,
+                        message_type_t type, size_t payload_len, uint32_t checksum);
 static uint32_t calculate_checksum(const unsigned char *data, size_t length);
-static int perform_client_handshake(connection_t *conn, const char *password);
-static int perform_server_handshake(connection_t *conn, const char *password);
 static int send_handshake_challenge(connection_t *conn);
+static uint64_t handshake_now_us(void);
+static void kdf_unlink(handshake_t *hs);
+static void kdf_run(handshake_t *hs);
+static void* kdf_thread_main(void *arg);
+static int handshake_start_kdf(handshake_t *hs);
+static void handshake_derive_inline(handshake_t *hs);
+static int handshake_collect_keys(handshake_t *hs, int timeout_ms);
+static int handshake_receive(handshake_t *hs, int timeout_ms, message_type_t expected,
+                             unsigned char *buffer, size_t *buffer_len);
+static int client_send_init(handshake_t *hs);
+static int client_wait_response(handshake_t *hs, int timeout_ms);
+static int server_wait_init(handshake_t *hs, int timeout_ms);
+static int server_skip_early_data(handshake_t *hs, int timeout_ms);
+static int handshake_run(handshake_t *hs);
+static int attach_early_data(connection_t *conn, const char *password);
+static void release_early_data(void *ptr);
+static void retain_early_data(early_data_t *early, message_type_t type,
+                              const unsigned char *payload, size_t payload_len);
+static int resume_fallback(connection_t *conn);
+static int attach_compression(connection_t *conn, compression_codec_t codec);
+static int accept_resumption(connection_t *conn, const unsigned char *init,
+                             size_t init_len);
+static int install_resumed_session(connection_t *conn,
+                                   const session_resumption_t *resumption,
+                                   const unsigned char *nonce);
+static int send_session_ticket(connection_t *conn, compression_codec_t codec);
+static void store_session_ticket(connection_t *conn, const unsigned char *payload,
+                                 size_t payload_len);
 static int verify_handshake_response(connection_t *conn, 
                                      const unsigned char *challenge,
                                      const unsigned char *response,
@@ -70,8 +208,8 @@ static int verify_handshake_response(connection_t *conn,
 
 /* Perform protocol handshake */
 int perform_handshake(connection_t *conn, int is_server, const char *password) {
+    handshake_t *hs;
     int result;
-    time_t start_time = time(NULL);
     
     if (!conn || !password) {
         LOG_ERROR("Invalid parameters for handshake");
@@ -86,31 +224,48 @@ int perform_handshake(connection_t *conn, int is_server, const char *password) {
     LOG_INFO("Starting %s handshake (v%s)", 
              is_server ? "server" : "client", PROTOCOL_VERSION);
     
-    /* Set handshake timeout */
-    struct timeval tv;
-    tv.tv_sec = HANDSHAKE_TIMEOUT;
-    tv.tv_usec = 0;
+    hs = handshake_begin(conn, is_server, password);
+    if (!hs) {
+        LOG_ERROR("Failed to allocate handshake state");
+        return PROTOCOL_ERROR_STATE;
+    }
+    hs->kdf_inline = 1;
     
-    setsockopt(conn->sockfd, SOL_SOCKET, SO_RCVTIMEO, (char*)&tv, sizeof(tv));
+    result = handshake_run(hs);
+    handshake_free(hs);
     
-    /* Perform handshake based on role */
-    if (is_server) {
-        result = perform_server_handshake(conn, password);
-    } else {
-        result = perform_client_handshake(conn, password);
+    if (result != PROTOCOL_SUCCESS) {
+        conn->state = STATE_ERROR;
     }
     
-    /* Restore original timeout */
-    tv.tv_sec = RECV_TIMEOUT_SEC;
-    setsockopt(conn->sockfd, SOL_SOCKET, SO_RCVTIMEO, (char*)&tv, sizeof(tv));
+    return result;
+}
+
+/* Internal: Drive a blocking handshake against one overall deadline */
+static int handshake_run(handshake_t *hs) {
+    handshake_timing_t timing;
+    uint64_t deadline_us;
+    int result;
+    
+    deadline_us = handshake_now_us() + (uint64_t)HANDSHAKE_TIMEOUT * 1000000ULL;
+    do {
+        uint64_t now_us = handshake_now_us();
+        if (now_us >= deadline_us) {
+            result = PROTOCOL_ERROR_TIMEOUT;
+            break;
+        }
+        result = handshake_step(hs, (int)((deadline_us - now_us + 999) / 1000));
+    } while (result == PROTOCOL_IN_PROGRESS);
     
+    timing = handshake_get_timing(hs);
     if (result == PROTOCOL_SUCCESS) {
-        conn->state = STATE_READY;
-        LOG_INFO("Handshake completed successfully in %ld seconds", 
-                 time(NULL) - start_time);
+        LOG_INFO("Handshake completed in %u us (%s): init %u, response %u, "
+                 "kdf %u (stall %u), complete %u",
+                 timing.total_us, timing.resumed ? "resumed" : "full",
+                 timing.init_us, timing.response_us, timing.kdf_us,
+                 timing.kdf_stall_us, timing.complete_us);
     } else {
         LOG_ERROR("Handshake failed: %s", protocol_strerror(result));
-        conn->state = STATE_ERROR;
     }
     
     return result;
@@ -119,9 +274,7 @@ int perform_handshake(connection_t *conn, int is_server, const char *password) {
 /* Send a protocol message */
 int send_message(connection_t *conn, message_type_t type, 
                 const unsigned char *payload, size_t payload_len) {
-    message_header_t header;
-    unsigned char packet[sizeof(header) + payload_len];
-    size_t packet_len;
+    int result;
     
     if (!conn || conn->state != STATE_READY) {
         return PROTOCOL_ERROR_STATE;
@@ -132,26 +285,56 @@ int send_message(connection_t *conn, message_type_t type,
         return PROTOCOL_ERROR_SIZE;
     }
     
-    /* Prepare header */
-    memcpy(header.magic, PROTOCOL_MAGIC, 8);
-    header.version_major = 1;
-    header.version_minor = 0;
-    header.type = type;
-    header.length = htonl(payload_len);
-    header.timestamp = htobe64(time(NULL));
-    static uint64_t sequence = 0;
-    header.sequence = htobe64(sequence++);
+    /* Compression, sequencing, sealing and the socket write all use
+     * per-connection state, so concurrent senders take turns */
+    lock_connection_send(conn);
+    result = send_message_locked(conn, type, payload, payload_len);
+    unlock_connection_send(conn);
     
-    /* Calculate checksum over payload */
-    header.checksum = htonl(calculate_checksum(payload, payload_len));
+    return result;
+}
+
+/* Internal: Build and send one message (send lock held) */
+static int send_message_locked(connection_t *conn, message_type_t type,
+                               const unsigned char *payload, size_t payload_len) {
+    message_header_t header;
+    compression_ctx_t *compression;
+    early_data_t *early;
+    size_t packet_len;
     
-    /* Build packet */
-    memcpy(packet, &header, sizeof(header));
-    if (payload_len > 0) {
-        memcpy(packet + sizeof(header), payload, payload_len);
+    /* Sealed under a ticket the server may still refuse */
+    early = get_connection_early_data(conn);
+    if (early) {
+        retain_early_data(early, type, payload, payload_len);
+    }
+    
+    /* Compress before the record is sealed by the network layer */
+    compression = get_connection_compression(conn);
+    if (compression && IS_COMPRESSED_TYPE(type) && payload_len > 0) {
+        int result = compression_compress_record(compression, payload, payload_len,
+                                                 &payload, &payload_len);
+        if (result != COMPRESSION_SUCCESS) {
+            LOG_ERROR("Compression failed: %s", compression_strerror(result));
+            return PROTOCOL_ERROR_CORRUPT;
+        }
     }
     
+    /* Assemble in the connection's send ring, where the record is sealed */
     packet_len = sizeof(header) + payload_len;
+    unsigned char *packet = connection_send_buffer(conn, packet_len);
+    if (!packet) {
+        LOG_ERROR("Cannot allocate send buffer");
+        return PROTOCOL_ERROR_BUFFER;
+    }
+    
+    /* Prepare header, with the checksum calculated over the payload */
+    fill_header(conn, &header, type, payload_len, calculate_checksum(payload, payload_len));
+    
+    /* Build packet; a payload assembled in place is already there */
+    memcpy(packet, &header, sizeof(header));
+    if (payload_len > 0 && payload != packet + sizeof(header)) {
+        memmove(packet + sizeof(header), payload, payload_len);
+    }
     
     /* Send through network layer */
     int sent = send_data(conn, packet, packet_len);
@@ -164,197 +347,1370 @@ int send_message(connection_t *conn, message_type_t type,
     return PROTOCOL_SUCCESS;
 }
 
+/* Internal: Send a small prefix and the caller's data as one message,
+ * assembled in place in the send ring rather than in a stack copy */
+static int send_prefixed_message(connection_t *conn, message_type_t type,
+                                 const void *prefix, size_t prefix_len,
+                                 const unsigned char *data, size_t data_len) {
+    unsigned char *payload;
+    int result;
+    
+    if (!conn || conn->state != STATE_READY) {
+        return PROTOCOL_ERROR_STATE;
+    }
+    
+    lock_connection_send(conn);
+    
+    payload = connection_send_buffer(conn, sizeof(message_header_t) + prefix_len + data_len);
+    if (!payload) {
+        unlock_connection_send(conn);
+        LOG_ERROR("Cannot allocate send buffer");
+        return PROTOCOL_ERROR_BUFFER;
+    }
+    
+    payload += sizeof(message_header_t);
+    memcpy(payload, prefix, prefix_len);
+    memcpy(payload + prefix_len, data, data_len);
+    result = send_message_locked(conn, type, payload, prefix_len + data_len);
+    
+    unlock_connection_send(conn);
+    return result;
+}
+
+/* Internal: Fill in a message header (send lock held) */
+static void fill_header(connection_t *conn, message_header_t *header,
+                        message_type_t type, size_t payload_len, uint32_t checksum) {
+    memcpy(header->magic, PROTOCOL_MAGIC, 8);
+    header->version_major = PROTOCOL_VERSION_MAJOR;
+    header->version_minor = PROTOCOL_VERSION_MINOR;
+    header->type = type;
+    header->length = htonl(payload_len);
+    header->checksum = htonl(checksum);
+    header->timestamp = htobe64((uint64_t)platform_coarse_time());
+    header->sequence = htobe64(next_send_sequence(conn));
+}
+
 /* Receive a protocol message */
 int receive_message(connection_t *conn, message_type_t *type,
                    unsigned char *buffer, size_t *buffer_len) {
     message_header_t header;
-    unsigned char header_buf[sizeof(header)];
+    compression_ctx_t *compression;
+    unsigned char *frame;
+    unsigned char *payload;
+    size_t frame_len;
+    size_t max_payload;
     int received;
     
     if (!conn || conn->state != STATE_READY) {
         return PROTOCOL_ERROR_STATE;
     }
     
-    /* Receive header */
-    received = receive_data(conn, header_buf, sizeof(header));
-    if (received != sizeof(header)) {
-        if (received == 0) {
-            LOG_DEBUG("Connection closed during header receive");
+    /* Messages consumed here are skipped in this frame, not by recursing */
+    for (;;) {
+        /* Receive a whole message; a partial one stays staged in the
+         * connection until the rest arrives */
+        received = receive_frame(conn, sizeof(header), offsetof(message_header_t, length),
+                                 sizeof(header) + MAX_WIRE_PAYLOAD, &frame, &frame_len);
+        if (received == NETWORK_ERROR_REFUSED) {
+            /* The server refused our ticket and skipped what we sealed under it */
+            int result = resume_fallback(conn);
+            if (result != PROTOCOL_SUCCESS) {
+                return result;
+            }
+            continue;
+        } else if (received == 0) {
+            /* Non-blocking socket with no complete message queued */
+            return PROTOCOL_IN_PROGRESS;
+        } else if (received == NETWORK_ERROR_CLOSED) {
+            LOG_DEBUG("Connection closed during receive");
             return PROTOCOL_ERROR_CLOSED;
+        } else if (received == NETWORK_ERROR_BUFFER) {
+            LOG_ERROR("Message too large");
+            return PROTOCOL_ERROR_SIZE;
         } else if (received < 0) {
-            LOG_ERROR("Failed to receive header: %s", 
-                     network_strerror(received));
+            LOG_ERROR("Failed to receive message: %s", network_strerror(received));
             return PROTOCOL_ERROR_NETWORK;
-        } else {
-            LOG_ERROR("Incomplete header received: %d bytes", received);
+        }
+    
+        if (frame_len < sizeof(header)) {
+            LOG_ERROR("Incomplete header received: %zu bytes", frame_len);
+            return PROTOCOL_ERROR_MALFORMED;
+        }
+    
+        /* Parse header */
+        memcpy(&header, frame, sizeof(header));
+    
+        /* Validate header */
+        if (validate_header(&header) != PROTOCOL_SUCCESS) {
+            LOG_ERROR("Invalid message header");
             return PROTOCOL_ERROR_MALFORMED;
         }
+    
+        /* Convert network byte order */
+        uint32_t payload_len = ntohl(header.length);
+        uint32_t checksum = ntohl(header.checksum);
+        uint64_t timestamp = be64toh(header.timestamp);
+        uint64_t sequence = be64toh(header.sequence);
+    
+        /* Messages must arrive in the order the peer sent them */
+        if (!check_receive_sequence(conn, sequence)) {
+            LOG_ERROR("Out-of-order message: sequence %lu", sequence);
+            return PROTOCOL_ERROR_CORRUPT;
+        }
+    
+        /* A sealed record must hold exactly the message its header describes */
+        if (payload_len != frame_len - sizeof(header)) {
+            LOG_ERROR("Record of %zu bytes carries a %u-byte payload", frame_len, payload_len);
+            return PROTOCOL_ERROR_MALFORMED;
+        }
+        payload = frame + sizeof(header);
+    
+        /* Verify checksum; chunks sent with sendfile() over kernel TLS
+         * carry none, the kernel's AES-GCM tag has authenticated them */
+        if (payload_len > 0 &&
+            (checksum != 0 || !(connection_kernel_crypto(conn) & NETWORK_KERNEL_CRYPTO_RX))) {
+            uint32_t calculated = calculate_checksum(payload, payload_len);
+            if (calculated != checksum) {
+                LOG_ERROR("Checksum mismatch: expected 0x%08x, got 0x%08x", 
+                         checksum, calculated);
+                return PROTOCOL_ERROR_CORRUPT;
+            }
+        }
+    
+        LOG_DEBUG("Received message type 0x%02x, %u bytes (seq %lu)", 
+                  header.type, payload_len, sequence);
+    
+        /* Messages consumed here are read where they were received, so
+         * they need no room in the caller's buffer; the caller sees the
+         * next message */
+        switch (header.type) {
+            case MSG_SESSION_TICKET:
+                store_session_ticket(conn, payload, payload_len);
+                continue;
+            
+            case MSG_KTLS_REQUEST:
+                if (ktls_accept(conn, payload, payload_len) != KTLS_SUCCESS) {
+                    return PROTOCOL_ERROR_NETWORK;
+                }
+                continue;
+            
+            case MSG_DGRAM_REQUEST:
+                if (datagram_accept(conn, payload, payload_len) != DATAGRAM_SUCCESS) {
+                    return PROTOCOL_ERROR_NETWORK;
+                }
+                continue;
+            
+            case MSG_HANDSHAKE_RESPONSE:
+                /* Late confirmation of a 0-RTT resumption */
+                if (payload_len >= 4 && payload[3] == HANDSHAKE_STATUS_RESUMED) {
+                    LOG_DEBUG("Server confirmed session resumption");
+                    
+                    /* Everything sent so far has been read; nothing to replay */
+                    lock_connection_send(conn);
+                    set_connection_early_data(conn, NULL, NULL);
+                    unlock_connection_send(conn);
+                    continue;
+                }
+                break;
+            
+            default:
+                break;
+        }
+    
+        /* Compressed records are decoded from the receive ring, so they may exceed the caller's buffer */
+        compression = get_connection_compression(conn);
+        if (compression && IS_COMPRESSED_TYPE(header.type)) {
+            max_payload = MAX_WIRE_PAYLOAD;
+        } else {
+            compression = NULL;
+            max_payload = MAX_PACKET_SIZE;
+        }
+    
+        /* Check payload size */
+        if (payload_len > max_payload) {
+            LOG_ERROR("Payload too large: %u bytes", payload_len);
+            return PROTOCOL_ERROR_SIZE;
+        }
+    
+        if (!compression && payload_len > *buffer_len) {
+            LOG_ERROR("Buffer too small: need %u, have %zu", payload_len, *buffer_len);
+            return PROTOCOL_ERROR_BUFFER;
+        }
+    
+        /* Decompress after the record has been opened and verified */
+        if (compression && payload_len > 0) {
+            const unsigned char *plain = NULL;
+            size_t plain_len = 0;
+            int result;
+            
+            result = compression_decompress_record(compression, payload, payload_len,
+                                                   &plain, &plain_len);
+            if (result != COMPRESSION_SUCCESS) {
+                LOG_ERROR("Decompression failed: %s", compression_strerror(result));
+                return PROTOCOL_ERROR_CORRUPT;
+            }
+        
+            if (plain_len > *buffer_len) {
+                LOG_ERROR("Buffer too small: need %zu, have %zu", plain_len, *buffer_len);
+                return PROTOCOL_ERROR_BUFFER;
+            }
+        
+            memcpy(buffer, plain, plain_len);
+            payload_len = (uint32_t)plain_len;
+        } else if (payload_len > 0) {
+            memcpy(buffer, payload, payload_len);
+        }
+    
+        /* Return message details */
+        if (type) *type = header.type;
+        if (buffer_len) *buffer_len = payload_len;
+    
+        /* Handle special message types */
+        switch (header.type) {
+            case MSG_KEEPALIVE:
+                LOG_DEBUG("Keepalive received");
+                break;
+            
+            case MSG_DISCONNECT:
+                LOG_INFO("Disconnect message received");
+                conn->state = STATE_CLOSING;
+                return PROTOCOL_ERROR_CLOSED;
+            
+            case MSG_ERROR:
+                LOG_ERROR("Error message received from peer");
+                return PROTOCOL_ERROR_PEER;
+        }
+    
+        return PROTOCOL_SUCCESS;
+    }
+}
+
+/* Send file chunk message */
+int send_file_chunk(connection_t *conn, const unsigned char *chunk_data,
+                   size_t chunk_size, uint32_t chunk_number) {
+    uint32_t chunk_be;
+
+    if (!chunk_data || chunk_size == 0 ||
+        chunk_size > MAX_PACKET_SIZE - sizeof(uint32_t)) {
+        return PROTOCOL_ERROR_PARAM;
+    }
+
+    /* Format: chunk_number(4) | data */
+    chunk_be = htonl(chunk_number);
+    return send_prefixed_message(conn, MSG_FILE_CHUNK, &chunk_be, sizeof(chunk_be),
+                                 chunk_data, chunk_size);
+}
+
+/* Send a file chunk whose data is written with sendfile() */
+int send_file_chunk_from_fd(connection_t *conn, int file_fd, uint64_t offset,
+                            size_t chunk_size, uint32_t chunk_number) {
+    message_header_t header;
+    unsigned char packet[sizeof(header) + sizeof(uint32_t)];
+    uint32_t chunk_be;
+    int result;
+    
+    if (!conn || conn->state != STATE_READY) {
+        return PROTOCOL_ERROR_STATE;
+    }
+    
+    if (file_fd < 0 || chunk_size == 0 ||
+        chunk_size > MAX_PACKET_SIZE - sizeof(uint32_t)) {
+        return PROTOCOL_ERROR_PARAM;
+    }
+    
+    /* The data never reaches user space: only kernel TLS can seal it, and
+     * neither compression nor the header checksum can be applied */
+    if (!(connection_kernel_crypto(conn) & NETWORK_KERNEL_CRYPTO_TX) ||
+        get_connection_compression(conn)) {
+        return PROTOCOL_ERROR_STATE;
+    }
+    
+    lock_connection_send(conn);
+    
+    /* Format: header | chunk_number(4), then the file data */
+    fill_header(conn, &header, MSG_FILE_CHUNK, sizeof(chunk_be) + chunk_size, 0);
+    chunk_be = htonl(chunk_number);
+    memcpy(packet, &header, sizeof(header));
+    memcpy(packet + sizeof(header), &chunk_be, sizeof(chunk_be));
+    
+    result = send_data(conn, packet, sizeof(packet));
+    if (result >= 0) {
+        result = send_file_range(conn, file_fd, offset, chunk_size);
+    }
+    
+    unlock_connection_send(conn);
+    
+    if (result < 0) {
+        LOG_ERROR("Failed to send file chunk %u: %s", chunk_number, network_strerror(result));
+        return PROTOCOL_ERROR_NETWORK;
     }
     
-    /* Parse header */
-    memcpy(&header, header_buf, sizeof(header));
+    return PROTOCOL_SUCCESS;
+}
+
+/* Send a file range unsealed behind a sealed bulk header */
+int send_file_bulk(connection_t *conn, int file_fd, uint64_t offset,
+                   size_t length, uint32_t chunk_number) {
+    unsigned char payload[2 * sizeof(uint32_t)];
+    early_data_t *early;
+    uint32_t value_be;
+    int result;
     
-    /* Validate header */
-    if (validate_header(&header) != PROTOCOL_SUCCESS) {
-        LOG_ERROR("Invalid message header");
+    if (!conn || conn->state != STATE_READY) {
+        return PROTOCOL_ERROR_STATE;
+    }
+    
+    if (file_fd < 0 || length == 0 || length > UINT32_MAX) {
+        return PROTOCOL_ERROR_PARAM;
+    }
+    
+    /* Format: chunk_number(4) | length(4), then length raw file bytes */
+    value_be = htonl(chunk_number);
+    memcpy(payload, &value_be, sizeof(value_be));
+    value_be = htonl((uint32_t)length);
+    memcpy(payload + sizeof(value_be), &value_be, sizeof(value_be));
+    
+    /* Header and data must not be split by another sender's message */
+    lock_connection_send(conn);
+    result = send_message_locked(conn, MSG_FILE_BULK, payload, sizeof(payload));
+    
+    /* Raw file bytes are not kept, so a refused resumption cannot replay them */
+    early = get_connection_early_data(conn);
+    if (early) {
+        early->overflow = 1;
+    }
+    if (result == PROTOCOL_SUCCESS &&
+        send_file_range_clear(conn, file_fd, offset, length) != NETWORK_SUCCESS) {
+        LOG_ERROR("Failed to send bulk chunk %u", chunk_number);
+        result = PROTOCOL_ERROR_NETWORK;
+    }
+    unlock_connection_send(conn);
+    
+    return result;
+}
+
+/* Parse bulk header payload */
+int parse_file_bulk(const unsigned char *payload, size_t payload_len,
+                    uint32_t *chunk_number, uint32_t *length) {
+    uint32_t value_be;
+    
+    if (!payload || !chunk_number || !length) {
+        return PROTOCOL_ERROR_PARAM;
+    }
+    
+    if (payload_len != 2 * sizeof(uint32_t)) {
+        LOG_ERROR("Invalid bulk header size: %zu bytes", payload_len);
         return PROTOCOL_ERROR_MALFORMED;
     }
     
-    /* Convert network byte order */
-    uint32_t payload_len = ntohl(header.length);
-    uint32_t checksum = ntohl(header.checksum);
-    uint64_t timestamp = be64toh(header.timestamp);
-    uint64_t sequence = be64toh(header.sequence);
+    memcpy(&value_be, payload, sizeof(value_be));
+    *chunk_number = ntohl(value_be);
+    memcpy(&value_be, payload + sizeof(value_be), sizeof(value_be));
+    *length = ntohl(value_be);
     
-    /* Check payload size */
-    if (payload_len > MAX_PACKET_SIZE) {
-        LOG_ERROR("Payload too large: %u bytes", payload_len);
-        return PROTOCOL_ERROR_SIZE;
+    if (*length == 0) {
+        LOG_ERROR("Empty bulk chunk");
+        return PROTOCOL_ERROR_MALFORMED;
     }
     
-    if (payload_len > *buffer_len) {
-        LOG_ERROR("Buffer too small: need %u, have %zu", payload_len, *buffer_len);
-        return PROTOCOL_ERROR_BUFFER;
+    return PROTOCOL_SUCCESS;
+}
+
+/* Send a striped chunk placed by offset */
+int send_file_stripe(connection_t *conn, uint64_t offset,
+                     const unsigned char *chunk_data, size_t chunk_size) {
+    uint64_t offset_be;
+
+    if (!chunk_data || chunk_size == 0 ||
+        chunk_size > MAX_PACKET_SIZE - sizeof(uint64_t)) {
+        return PROTOCOL_ERROR_PARAM;
+    }
+
+    /* Format: offset(8) | data */
+    offset_be = htobe64(offset);
+    return send_prefixed_message(conn, MSG_FILE_STRIPE, &offset_be, sizeof(offset_be),
+                                 chunk_data, chunk_size);
+}
+
+/* Parse striped chunk payload */
+int parse_file_stripe(const unsigned char *payload, size_t payload_len,
+                      uint64_t *offset, const unsigned char **chunk_data,
+                      size_t *chunk_size) {
+    uint64_t offset_be;
+
+    if (!payload || !offset || !chunk_data || !chunk_size) {
+        return PROTOCOL_ERROR_PARAM;
+    }
+
+    if (payload_len <= sizeof(uint64_t)) {
+        LOG_ERROR("Invalid stripe chunk size: %zu bytes", payload_len);
+        return PROTOCOL_ERROR_MALFORMED;
     }
+
+    memcpy(&offset_be, payload, sizeof(offset_be));
+    *offset = be64toh(offset_be);
+    *chunk_data = payload + sizeof(offset_be);
+    *chunk_size = payload_len - sizeof(offset_be);
+
+    return PROTOCOL_SUCCESS;
+}
+
+/* Send file transfer window update */
+int send_window_update(connection_t *conn, uint64_t bytes_consumed,
+                      uint64_t credit_limit) {
+    unsigned char payload[2 * sizeof(uint64_t)];
+    uint64_t value_be;
+
+    if (credit_limit < bytes_consumed) {
+        return PROTOCOL_ERROR_PARAM;
+    }
+
+    /* Format: bytes_consumed(8) | credit_limit(8) */
+    value_be = htobe64(bytes_consumed);
+    memcpy(payload, &value_be, sizeof(value_be));
+    value_be = htobe64(credit_limit);
+    memcpy(payload + sizeof(value_be), &value_be, sizeof(value_be));
+
+    return send_message(conn, MSG_WINDOW_UPDATE, payload, sizeof(payload));
+}
+
+/* Parse window update payload */
+int parse_window_update(const unsigned char *payload, size_t payload_len,
+                       uint64_t *bytes_consumed, uint64_t *credit_limit) {
+    uint64_t value_be;
+
+    if (!payload || !bytes_consumed || !credit_limit) {
+        return PROTOCOL_ERROR_PARAM;
+    }
+
+    if (payload_len != 2 * sizeof(uint64_t)) {
+        LOG_ERROR("Invalid window update size: %zu bytes", payload_len);
+        return PROTOCOL_ERROR_MALFORMED;
+    }
+
+    memcpy(&value_be, payload, sizeof(value_be));
+    *bytes_consumed = be64toh(value_be);
+    memcpy(&value_be, payload + sizeof(value_be), sizeof(value_be));
+    *credit_limit = be64toh(value_be);
+
+    if (*credit_limit < *bytes_consumed) {
+        LOG_ERROR("Window update credit below consumed offset");
+        return PROTOCOL_ERROR_MALFORMED;
+    }
+
+    return PROTOCOL_SUCCESS;
+}
+
+/* Send keepalive message */
+int send_keepalive(connection_t *conn) {
+    return send_message(conn, MSG_KEEPALIVE, NULL, 0);
+}
+
+/* Send disconnect message */
+int send_disconnect(connection_t *conn, const char *reason) {
+    const char *text = reason ? reason : "";
+
+    return send_message(conn, MSG_DISCONNECT, (const unsigned char*)text, strlen(text));
+}
+
+/* Internal: Monotonic clock in microseconds */
+static uint64_t handshake_now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000ULL + (uint64_t)ts.tv_nsec / 1000ULL;
+}
+
+/* Internal: Take a queued job off the pool queue (kdf_lock held) */
+static void kdf_unlink(handshake_t *hs) {
+    handshake_t **link = &kdf_queue_head;
+    handshake_t *prev = NULL;
     
-    /* Receive payload if present */
-    if (payload_len > 0) {
-        received = receive_data(conn, buffer, payload_len);
-        if (received != payload_len) {
-            LOG_ERROR("Incomplete payload: expected %u, got %d", payload_len, received);
-            return PROTOCOL_ERROR_MALFORMED;
-        }
+    while (*link != hs) {
+        prev = *link;
+        link = &(*link)->kdf_next;
+    }
+    *link = hs->kdf_next;
+    if (kdf_queue_tail == hs) {
+        kdf_queue_tail = prev;
+    }
+    hs->kdf_next = NULL;
+}
+
+/* Internal: Run an unlinked job and post its result back to the
+ * handshake. Called with kdf_lock held; drops it while deriving */
+static void kdf_run(handshake_t *hs) {
+    crypto_session_t *session;
+    uint64_t start_us, end_us;
+    
+    hs->kdf_state = KDF_RUNNING;
+    pthread_mutex_unlock(&kdf_lock);
+    
+    start_us = handshake_now_us();
+    session = crypto_session_create(hs->password);
+    end_us = handshake_now_us();
+    
+    /* handshake_free() waits for this, so hs outlives the notify */
+    pthread_mutex_lock(&kdf_lock);
+    hs->kdf_session = session;
+    hs->kdf_start_us = start_us;
+    hs->kdf_end_us = end_us;
+    hs->kdf_state = KDF_FINISHED;
+    atomic_store(&hs->kdf_done, 1);
+    if (hs->notify) {
+        hs->notify(hs->notify_ctx, hs->conn);
+    }
+    pthread_cond_broadcast(&kdf_finished);
+}
+
+/* Internal: Key derivation pool thread; runs queued jobs in order */
+static void* kdf_thread_main(void *arg) {
+    (void)arg;
+    
+    pthread_mutex_lock(&kdf_lock);
+    for (;;) {
+        handshake_t *hs;
         
-        /* Verify checksum */
-        uint32_t calculated = calculate_checksum(buffer, payload_len);
-        if (calculated != checksum) {
-            LOG_ERROR("Checksum mismatch: expected 0x%08x, got 0x%08x", 
-                     checksum, calculated);
-            return PROTOCOL_ERROR_CORRUPT;
+        while (!kdf_queue_head) {
+            kdf_idle_count++;
+            pthread_cond_wait(&kdf_work, &kdf_lock);
+            kdf_idle_count--;
         }
+        
+        hs = kdf_queue_head;
+        kdf_unlink(hs);
+        kdf_run(hs);
     }
     
-    /* Return message details */
-    if (type) *type = header.type;
-    if (buffer_len) *buffer_len = payload_len;
+    return NULL;
+}
+
+/* Internal: Queue key derivation so it overlaps the next round trip */
+static int handshake_start_kdf(handshake_t *hs) {
+    int max_threads = platform_get_system_info().num_cpus;
     
-    LOG_DEBUG("Received message type 0x%02x, %u bytes (seq %lu)", 
-              header.type, payload_len, sequence);
+    /* Blocking callers derive on their own thread once the message is
+     * out (handshake_derive_inline()) */
+    if (hs->kdf_inline) {
+        return PROTOCOL_SUCCESS;
+    }
     
-    /* Handle special message types */
-    switch (header.type) {
-        case MSG_KEEPALIVE:
-            LOG_DEBUG("Keepalive received");
-            break;
-            
-        case MSG_DISCONNECT:
-            LOG_INFO("Disconnect message received");
-            conn->state = STATE_CLOSING;
-            return PROTOCOL_ERROR_CLOSED;
-            
-        case MSG_ERROR:
-            LOG_ERROR("Error message received from peer");
-            return PROTOCOL_ERROR_PEER;
+    if (max_threads < 1) {
+        max_threads = 1;
+    } else if (max_threads > KDF_MAX_THREADS) {
+        max_threads = KDF_MAX_THREADS;
+    }
+    
+    pthread_mutex_lock(&kdf_lock);
+    
+    /* Grow the pool only when nothing is free to take the job */
+    if (kdf_idle_count == 0 && kdf_thread_count < max_threads) {
+        platform_thread_t thread = platform_thread_create(kdf_thread_main, NULL);
+        
+        if (thread) {
+            platform_thread_detach(thread);
+            kdf_thread_count++;
+        } else if (kdf_thread_count == 0) {
+            pthread_mutex_unlock(&kdf_lock);
+            LOG_ERROR("Failed to start key derivation worker");
+            return PROTOCOL_ERROR_STATE;
+        }
     }
     
+    hs->kdf_state = KDF_QUEUED;
+    if (kdf_queue_tail) {
+        kdf_queue_tail->kdf_next = hs;
+    } else {
+        kdf_queue_head = hs;
+    }
+    kdf_queue_tail = hs;
+    pthread_cond_signal(&kdf_work);
+    
+    pthread_mutex_unlock(&kdf_lock);
     return PROTOCOL_SUCCESS;
 }
 
-/* Internal: Server-side handshake */
-static int perform_server_handshake(connection_t *conn, const char *password) {
-    unsigned char buffer[256];
+/* Internal: Derive a blocking caller's keys on its own thread, so it
+ * neither queues behind the pool nor holds a pool thread while it sleeps */
+static void handshake_derive_inline(handshake_t *hs) {
+    if (!hs->kdf_inline) {
+        return;
+    }
+    
+    pthread_mutex_lock(&kdf_lock);
+    kdf_run(hs);
+    pthread_mutex_unlock(&kdf_lock);
+}
+
+/* Internal: Collect derived keys, waiting at most timeout_ms for the
+ * pool (negative waits as long as it takes) */
+static int handshake_collect_keys(handshake_t *hs, int timeout_ms) {
+    uint64_t now_us = handshake_now_us();
+    
+    if (!hs->kdf_wait_us) {
+        hs->kdf_wait_us = now_us;
+    }
+    
+    if (!atomic_load(&hs->kdf_done)) {
+        struct timespec deadline;
+        
+        if (timeout_ms == 0) {
+            return PROTOCOL_IN_PROGRESS;
+        }
+        
+        /* Condition variables time out against the realtime clock */
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        if (timeout_ms > 0) {
+            deadline.tv_sec += timeout_ms / 1000;
+            deadline.tv_nsec += (long)(timeout_ms % 1000) * 1000000L;
+            if (deadline.tv_nsec >= 1000000000L) {
+                deadline.tv_sec++;
+                deadline.tv_nsec -= 1000000000L;
+            }
+        }
+        
+        pthread_mutex_lock(&kdf_lock);
+        while (hs->kdf_state != KDF_FINISHED) {
+            if (timeout_ms < 0) {
+                pthread_cond_wait(&kdf_finished, &kdf_lock);
+            } else if (pthread_cond_timedwait(&kdf_finished, &kdf_lock,
+                                              &deadline) == ETIMEDOUT) {
+                break;
+            }
+        }
+        pthread_mutex_unlock(&kdf_lock);
+        
+        if (!atomic_load(&hs->kdf_done)) {
+            return PROTOCOL_IN_PROGRESS;
+        }
+    }
+    
+    hs->timing.kdf_stall_us = (uint32_t)(handshake_now_us() - hs->kdf_wait_us);
+    hs->timing.kdf_us = (uint32_t)(hs->kdf_end_us - hs->kdf_start_us);
+    
+    if (!hs->kdf_session) {
+        LOG_ERROR("Key derivation failed");
+        return PROTOCOL_ERROR_AUTH;
+    }
+    
+    set_connection_crypto(hs->conn, hs->kdf_session);
+    hs->kdf_session = NULL;
+    
+    return attach_compression(hs->conn, hs->codec);
+}
+
+/* Internal: Wait for the next handshake message within timeout_ms */
+static int handshake_receive(handshake_t *hs, int timeout_ms, message_type_t expected,
+                             unsigned char *buffer, size_t *buffer_len) {
     message_type_t msg_type;
-    size_t msg_len;
+    size_t buffer_cap = *buffer_len;
+    int ready, result = PROTOCOL_IN_PROGRESS;
+    
+    /* Input staged by an I/O backend never shows up as socket readiness,
+     * and may already hold the message */
+    if (connection_input_pending(hs->conn) > 0) {
+        result = receive_message(hs->conn, &msg_type, buffer, buffer_len);
+    }
     
-    LOG_DEBUG("Waiting for client handshake...");
+    /* Nothing staged, or only part of the message */
+    if (result == PROTOCOL_IN_PROGRESS) {
+        ready = wait_for_socket(get_connection_socket(hs->conn), timeout_ms, 1, 0);
+        if (ready == 0) {
+            return PROTOCOL_IN_PROGRESS;
+        } else if (ready < 0) {
+            return PROTOCOL_ERROR_NETWORK;
+        }
+        *buffer_len = buffer_cap;
+        result = receive_message(hs->conn, &msg_type, buffer, buffer_len);
+    }
     
-    /* Receive handshake init from client */
-    int result = receive_message(conn, &msg_type, buffer, &msg_len);
     if (result != PROTOCOL_SUCCESS) {
-        LOG_ERROR("Failed to receive handshake init");
         return result;
     }
     
-    if (msg_type != MSG_HANDSHAKE_INIT) {
-        LOG_ERROR("Expected handshake init (0x%02x), got 0x%02x", 
-                 MSG_HANDSHAKE_INIT, msg_type);
+    if (msg_type != expected) {
+        LOG_ERROR("Expected handshake message 0x%02x, got 0x%02x", expected, msg_type);
         return PROTOCOL_ERROR_MALFORMED;
     }
     
+    return PROTOCOL_SUCCESS;
+}
+
+/* Internal: Client phase: send init (resuming or starting the KDF) */
+static int client_send_init(handshake_t *hs) {
+    uint8_t codec_mask = compression_supported_mask();
+    connection_info_t info = get_connection_info(hs->conn);
+    session_resumption_t resumption;
+    size_t ticket_len = SESSION_TICKET_MAX_SIZE;
+    unsigned char init[RESUME_INIT_HEADER + SESSION_TICKET_MAX_SIZE] = {
+        PROTOCOL_VERSION_MAJOR, PROTOCOL_VERSION_MINOR, codec_mask
+    };
+    size_t init_len = 3;
+    int resuming = 0, result;
+    
+    if (session_ticket_store_take(info.remote_host, info.remote_port,
+                                  init + RESUME_INIT_HEADER, &ticket_len,
+                                  &resumption) == TICKET_SUCCESS &&
+        crypto_random_bytes(init + 4, SESSION_TICKET_NONCE_SIZE) == CRYPTO_SUCCESS) {
+        init[3] = HANDSHAKE_FLAG_RESUME;
+        init_len = RESUME_INIT_HEADER + ticket_len;
+        resuming = 1;
+    } else {
+        /* Full handshake: derive keys while the init is in flight */
+        result = handshake_start_kdf(hs);
+        if (result != PROTOCOL_SUCCESS) {
+            return result;
+        }
+    }
+    
+    result = send_message(hs->conn, MSG_HANDSHAKE_INIT, init, init_len);
+    hs->timing.init_us = (uint32_t)(handshake_now_us() - hs->start_us);
+    if (result != PROTOCOL_SUCCESS) {
+        LOG_ERROR("Failed to send handshake init");
+        crypto_memzero(&resumption, sizeof(resumption));
+        return result;
+    }
+    
+    /* 0-RTT: data may follow immediately; the server's confirmation is
+     * consumed by receive_message. If the server refuses the ticket,
+     * receive_message finishes a full handshake and sends what was
+     * sent meanwhile again. */
+    if (resuming) {
+        result = install_resumed_session(hs->conn, &resumption, init + 4);
+        if (result == PROTOCOL_SUCCESS) {
+            result = attach_compression(hs->conn, (compression_codec_t)resumption.codec);
+        }
+        if (result == PROTOCOL_SUCCESS) {
+            result = attach_early_data(hs->conn, hs->password);
+        }
+        crypto_memzero(&resumption, sizeof(resumption));
+        
+        if (result == PROTOCOL_SUCCESS) {
+            LOG_INFO("Resumed session with %s:%d", info.remote_host, info.remote_port);
+            hs->timing.resumed = 1;
+            hs->phase = HANDSHAKE_PHASE_DONE;
+        }
+        return result;
+    }
+    
+    handshake_derive_inline(hs);
+    hs->phase = HANDSHAKE_PHASE_WAIT_RESPONSE;
+    return PROTOCOL_SUCCESS;
+}
+
+/* Internal: Client phase: response carries the server's codec choice */
+static int client_wait_response(handshake_t *hs, int timeout_ms) {
+    unsigned char buffer[256];
+    size_t msg_len = sizeof(buffer);
+    uint8_t codec_mask = compression_supported_mask();
+    int result;
+    
+    result = handshake_receive(hs, timeout_ms, MSG_HANDSHAKE_RESPONSE, buffer, &msg_len);
+    if (result != PROTOCOL_SUCCESS) {
+        return result;
+    }
+    
+    hs->timing.response_us = (uint32_t)(handshake_now_us() - hs->start_us) -
+                             hs->timing.init_us;
+    
+    /* Server picks the codec; it must be one we offered */
+    if (msg_len >= 3 && buffer[2] != COMPRESSION_NONE) {
+        if (buffer[2] > COMPRESSION_ZSTD || !(codec_mask & (1u << buffer[2]))) {
+            LOG_ERROR("Server selected unsupported codec %u", buffer[2]);
+            return PROTOCOL_ERROR_MALFORMED;
+        }
+        hs->codec = (compression_codec_t)buffer[2];
+    }
+    
+    hs->phase = HANDSHAKE_PHASE_WAIT_KEYS;
+    return PROTOCOL_SUCCESS;
+}
+
+/* Internal: Server phase: init decides between resumption and full handshake */
+static int server_wait_init(handshake_t *hs, int timeout_ms) {
+    unsigned char buffer[256];
+    size_t msg_len = sizeof(buffer);
+    int status = HANDSHAKE_STATUS_FULL;
+    int result;
+    
+    result = handshake_receive(hs, timeout_ms, MSG_HANDSHAKE_INIT, buffer, &msg_len);
+    if (result != PROTOCOL_SUCCESS) {
+        return result;
+    }
+    
+    hs->timing.init_us = (uint32_t)(handshake_now_us() - hs->start_us);
+    
     /* Parse client version */
     if (msg_len >= 2) {
-        uint8_t client_major = buffer[0];
-        uint8_t client_minor = buffer[1];
-        
-        if (client_major != 1) {
-            LOG_ERROR("Unsupported protocol version: %d.%d", 
-                     client_major, client_minor);
+        if (buffer[0] != PROTOCOL_VERSION_MAJOR) {
+            LOG_ERROR("Unsupported protocol version: %d.%d", buffer[0], buffer[1]);
             return PROTOCOL_ERROR_VERSION;
         }
+        LOG_DEBUG("Client protocol version: %d.%d", buffer[0], buffer[1]);
+    }
+    
+    /* Older clients send no codec mask and get no compression byte back */
+    if (msg_len >= 3) {
+        hs->codec = compression_select(buffer[2]);
+        hs->ticket_aware = 1;
+        LOG_DEBUG("Client codecs 0x%02x, selected %s",
+                  buffer[2], compression_codec_name(hs->codec));
+    }
+    
+    /* Returning client: no COMPLETE round trip and no key derivation */
+    if (msg_len > RESUME_INIT_HEADER && (buffer[3] & HANDSHAKE_FLAG_RESUME)) {
+        result = accept_resumption(hs->conn, buffer, msg_len);
+        if (result == PROTOCOL_SUCCESS) {
+            hs->timing.resumed = 1;
+            hs->phase = HANDSHAKE_PHASE_DONE;
+        }
+        if (result != PROTOCOL_ERROR_AUTH) {
+            return result;
+        }
         
-        LOG_DEBUG("Client protocol version: %d.%d", client_major, client_minor);
+        /* Ticket refused: the client's init stands for a full one */
+        status = HANDSHAKE_STATUS_REJECTED;
     }
     
-    /* Send handshake response */
-    unsigned char response[2] = {1, 0};  /* Version 1.0 */
-    result = send_message(conn, MSG_HANDSHAKE_RESPONSE, response, sizeof(response));
+    /* Derive keys while the response and complete are on the wire */
+    result = handshake_start_kdf(hs);
     if (result != PROTOCOL_SUCCESS) {
-        LOG_ERROR("Failed to send handshake response");
         return result;
     }
     
-    /* Wait for handshake complete */
-    result = receive_message(conn, &msg_type, buffer, &msg_len);
+    /* An empty record ahead of the response tells the client its early
+     * data was skipped, before it tries to open the response */
+    if (status == HANDSHAKE_STATUS_REJECTED) {
+        lock_connection_send(hs->conn);
+        result = send_empty_record(hs->conn);
+        unlock_connection_send(hs->conn);
+        if (result < 0) {
+            LOG_ERROR("Failed to refuse early data: %s", network_strerror(result));
+            return PROTOCOL_ERROR_NETWORK;
+        }
+    }
+    
+    unsigned char response[4] = {
+        PROTOCOL_VERSION_MAJOR, PROTOCOL_VERSION_MINOR, (unsigned char)hs->codec,
+        (unsigned char)status
+    };
+    result = send_message(hs->conn, MSG_HANDSHAKE_RESPONSE, response,
+                          hs->ticket_aware ? sizeof(response) : 2);
     if (result != PROTOCOL_SUCCESS) {
-        LOG_ERROR("Failed to receive handshake complete");
+        LOG_ERROR("Failed to send handshake response");
         return result;
     }
     
-    if (msg_type != MSG_HANDSHAKE_COMPLETE) {
-        LOG_ERROR("Expected handshake complete (0x%02x), got 0x%02x",
-                 MSG_HANDSHAKE_COMPLETE, msg_type);
-        return PROTOCOL_ERROR_MALFORMED;
+    hs->timing.response_us = (uint32_t)(handshake_now_us() - hs->start_us) -
+                             hs->timing.init_us;
+    handshake_derive_inline(hs);
+    hs->phase = status == HANDSHAKE_STATUS_REJECTED ? HANDSHAKE_PHASE_SKIP_EARLY_DATA
+                                                    : HANDSHAKE_PHASE_WAIT_KEYS;
+    return PROTOCOL_SUCCESS;
+}
+
+/* Internal: Server phase: drop the records a refused client sealed
+ * under its ticket, up to the empty record that ends them */
+static int server_skip_early_data(handshake_t *hs, int timeout_ms) {
+    size_t max_len = sizeof(message_header_t) + MAX_WIRE_PAYLOAD;
+    int ready, result;
+    
+    result = discard_sealed_records(hs->conn, max_len);
+    if (result == 0) {
+        ready = wait_for_socket(get_connection_socket(hs->conn), timeout_ms, 1, 0);
+        if (ready == 0) {
+            return PROTOCOL_IN_PROGRESS;
+        } else if (ready < 0) {
+            return PROTOCOL_ERROR_NETWORK;
+        }
+        result = discard_sealed_records(hs->conn, max_len);
+    }
+    
+    if (result == 0) {
+        return PROTOCOL_IN_PROGRESS;
+    } else if (result == NETWORK_ERROR_CLOSED) {
+        return PROTOCOL_ERROR_CLOSED;
+    } else if (result < 0) {
+        LOG_ERROR("Failed to skip early data: %s", network_strerror(result));
+        return PROTOCOL_ERROR_NETWORK;
     }
     
+    hs->phase = HANDSHAKE_PHASE_WAIT_KEYS;
     return PROTOCOL_SUCCESS;
 }
 
-/* Internal: Client-side handshake */
-static int perform_client_handshake(connection_t *conn, const char *password) {
-    unsigned char buffer[256];
-    message_type_t msg_type;
-    size_t msg_len;
+/* Start a handshake state machine */
+handshake_t* handshake_begin(connection_t *conn, int is_server, const char *password) {
+    handshake_t *hs;
+    
+    if (!conn || !password) {
+        return NULL;
+    }
+    
+    hs = calloc(1, sizeof(handshake_t));
+    if (!hs) {
+        return NULL;
+    }
+    
+    hs->password = strdup(password);
+    if (!hs->password) {
+        free(hs);
+        return NULL;
+    }
+    
+    hs->conn = conn;
+    hs->is_server = is_server;
+    hs->phase = is_server ? HANDSHAKE_PHASE_WAIT_INIT : HANDSHAKE_PHASE_SEND_INIT;
+    hs->codec = COMPRESSION_NONE;
+    hs->start_us = handshake_now_us();
+    atomic_init(&hs->kdf_done, 0);
+    
+    return hs;
+}
+
+/* Advance a handshake state machine */
+int handshake_step(handshake_t *hs, int timeout_ms) {
+    int result = PROTOCOL_SUCCESS;
+    
+    if (!hs) {
+        return PROTOCOL_ERROR_PARAM;
+    }
     
-    LOG_DEBUG("Initiating client handshake...");
+    if (hs->phase == HANDSHAKE_PHASE_DONE) {
+        return PROTOCOL_SUCCESS;
+    }
+    
+    /* Run phases back to back until one has to wait */
+    while (result == PROTOCOL_SUCCESS && hs->phase != HANDSHAKE_PHASE_DONE) {
+        unsigned char buffer[256];
+        size_t msg_len = sizeof(buffer);
+        
+        switch (hs->phase) {
+            case HANDSHAKE_PHASE_SEND_INIT:
+                result = client_send_init(hs);
+                break;
+                
+            case HANDSHAKE_PHASE_WAIT_RESPONSE:
+                result = client_wait_response(hs, timeout_ms);
+                break;
+                
+            case HANDSHAKE_PHASE_WAIT_INIT:
+                result = server_wait_init(hs, timeout_ms);
+                break;
+                
+            case HANDSHAKE_PHASE_SKIP_EARLY_DATA:
+                result = server_skip_early_data(hs, timeout_ms);
+                break;
+                
+            case HANDSHAKE_PHASE_WAIT_KEYS:
+                result = handshake_collect_keys(hs, timeout_ms);
+                if (result != PROTOCOL_SUCCESS) {
+                    break;
+                }
+                hs->keys_ready_us = handshake_now_us();
+                
+                if (hs->is_server) {
+                    hs->phase = HANDSHAKE_PHASE_WAIT_COMPLETE;
+                    break;
+                }
+                
+                result = hs->send_locked
+                         ? send_message_locked(hs->conn, MSG_HANDSHAKE_COMPLETE, NULL, 0)
+                         : send_message(hs->conn, MSG_HANDSHAKE_COMPLETE, NULL, 0);
+                if (result != PROTOCOL_SUCCESS) {
+                    LOG_ERROR("Failed to send handshake complete");
+                    break;
+                }
+                hs->phase = HANDSHAKE_PHASE_DONE;
+                break;
+                
+            case HANDSHAKE_PHASE_WAIT_COMPLETE:
+                result = handshake_receive(hs, timeout_ms, MSG_HANDSHAKE_COMPLETE,
+                                           buffer, &msg_len);
+                if (result != PROTOCOL_SUCCESS) {
+                    break;
+                }
+                
+                /* Ticket-aware clients get a ticket for their next connection */
+                if (hs->ticket_aware && send_session_ticket(hs->conn, hs->codec) != PROTOCOL_SUCCESS) {
+                    LOG_WARNING("Failed to issue session ticket");
+                }
+                hs->phase = HANDSHAKE_PHASE_DONE;
+                break;
+                
+            case HANDSHAKE_PHASE_FAILED:
+            default:
+                return PROTOCOL_ERROR_STATE;
+        }
+    }
+    
+    if (result == PROTOCOL_IN_PROGRESS) {
+        return result;
+    }
     
-    /* Send handshake init */
-    unsigned char init[2] = {1, 0};  /* Version 1.0 */
-    int result = send_message(conn, MSG_HANDSHAKE_INIT, init, sizeof(init));
     if (result != PROTOCOL_SUCCESS) {
-        LOG_ERROR("Failed to send handshake init");
+        hs->phase = HANDSHAKE_PHASE_FAILED;
+        hs->conn->state = STATE_ERROR;
         return result;
     }
     
-    /* Wait for handshake response */
-    result = receive_message(conn, &msg_type, buffer, &msg_len);
+    /* Finished: record the tail of the timeline */
+    uint64_t done_us = handshake_now_us();
+    hs->conn->state = STATE_READY;
+    hs->timing.total_us = (uint32_t)(done_us - hs->start_us);
+    if (hs->keys_ready_us) {
+        hs->timing.complete_us = (uint32_t)(done_us - hs->keys_ready_us);
+    }
+    
+    return PROTOCOL_SUCCESS;
+}
+
+/* Check whether only key derivation is holding the handshake up */
+int handshake_waiting_for_keys(const handshake_t *hs) {
+    return hs && hs->phase == HANDSHAKE_PHASE_WAIT_KEYS && !atomic_load(&hs->kdf_done);
+}
+
+/* Ask for a callback when key derivation finishes */
+void handshake_set_notify(handshake_t *hs, handshake_notify_t notify, void *ctx) {
+    if (!hs) return;
+    
+    pthread_mutex_lock(&kdf_lock);
+    hs->notify = notify;
+    hs->notify_ctx = ctx;
+    pthread_mutex_unlock(&kdf_lock);
+}
+
+/* Get per-phase handshake latency */
+handshake_timing_t handshake_get_timing(const handshake_t *hs) {
+    handshake_timing_t timing = {0};
+    
+    if (hs) {
+        timing = hs->timing;
+    }
+    
+    return timing;
+}
+
+/* Release a handshake state machine */
+void handshake_free(handshake_t *hs) {
+    if (!hs) return;
+    
+    /* A queued job is dropped; a running one has to finish before its
+     * state can go */
+    pthread_mutex_lock(&kdf_lock);
+    if (hs->kdf_state == KDF_QUEUED) {
+        kdf_unlink(hs);
+    }
+    while (hs->kdf_state == KDF_RUNNING) {
+        pthread_cond_wait(&kdf_finished, &kdf_lock);
+    }
+    pthread_mutex_unlock(&kdf_lock);
+    
+    if (hs->kdf_session) {
+        crypto_session_destroy(hs->kdf_session);
+    }
+    
+    crypto_memzero(hs->password, strlen(hs->password));
+    free(hs->password);
+    free(hs);
+}
+
+/* Internal: Server side of a resumed handshake */
+static int accept_resumption(connection_t *conn, const unsigned char *init,
+                             size_t init_len) {
+    session_resumption_t resumption;
+    compression_codec_t codec;
+    int result;
+    
+    result = session_ticket_redeem(init + RESUME_INIT_HEADER,
+                                   init_len - RESUME_INIT_HEADER, &resumption);
+    
+    if (result == TICKET_SUCCESS && resumption.codec != COMPRESSION_NONE &&
+        !(compression_supported_mask() & (1u << resumption.codec))) {
+        result = TICKET_ERROR_MALFORMED;
+    }
+    
+    if (result != TICKET_SUCCESS) {
+        /* Early data is unreadable without the ticket; the caller falls
+         * back to a full handshake */
+        LOG_WARNING("Session resumption rejected: %s", session_ticket_strerror(result));
+        crypto_memzero(&resumption, sizeof(resumption));
+        return PROTOCOL_ERROR_AUTH;
+    }
+    
+    codec = (compression_codec_t)resumption.codec;
+    result = install_resumed_session(conn, &resumption, init + 4);
+    crypto_memzero(&resumption, sizeof(resumption));
     if (result != PROTOCOL_SUCCESS) {
-        LOG_ERROR("Failed to receive handshake response");
         return result;
     }
     
-    if (msg_type != MSG_HANDSHAKE_RESPONSE) {
-        LOG_ERROR("Expected handshake response (0x%02x), got 0x%02x",
-                 MSG_HANDSHAKE_RESPONSE, msg_type);
-        return PROTOCOL_ERROR_MALFORMED;
+    result = attach_compression(conn, codec);
+    if (result != PROTOCOL_SUCCESS) {
+        return result;
     }
     
-    /* Send handshake complete */
-    result = send_message(conn, MSG_HANDSHAKE_COMPLETE, NULL, 0);
+    /* Confirmation travels under the resumed keys */
+    unsigned char response[4] = {
+        PROTOCOL_VERSION_MAJOR, PROTOCOL_VERSION_MINOR, (unsigned char)codec,
+        HANDSHAKE_STATUS_RESUMED
+    };
+    result = send_message(conn, MSG_HANDSHAKE_RESPONSE, response, sizeof(response));
     if (result != PROTOCOL_SUCCESS) {
-        LOG_ERROR("Failed to send handshake complete");
+        LOG_ERROR("Failed to send resumption response");
         return result;
     }
     
+    if (send_session_ticket(conn, codec) != PROTOCOL_SUCCESS) {
+        LOG_WARNING("Failed to issue session ticket");
+    }
+    
+    LOG_INFO("Resumed session for client");
+    return PROTOCOL_SUCCESS;
+}
+
+/* Internal: Start keeping what a resuming client sends until the
+ * server confirms or refuses the ticket */
+static int attach_early_data(connection_t *conn, const char *password) {
+    early_data_t *early = calloc(1, sizeof(early_data_t));
+    
+    if (!early) {
+        return PROTOCOL_ERROR_STATE;
+    }
+    
+    early->password = strdup(password);
+    if (!early->password) {
+        free(early);
+        return PROTOCOL_ERROR_STATE;
+    }
+    
+    early->first_sequence = get_send_sequence(conn);
+    set_connection_early_data(conn, early, release_early_data);
+    return PROTOCOL_SUCCESS;
+}
+
+/* Internal: Free early data, wiping what it kept */
+static void release_early_data(void *ptr) {
+    early_data_t *early = ptr;
+    
+    crypto_memzero(early->password, strlen(early->password));
+    free(early->password);
+    if (early->data) {
+        crypto_memzero(early->data, early->len);
+        free(early->data);
+    }
+    free(early);
+}
+
+/* Internal: Keep a copy of a message for a replay (send lock held) */
+static void retain_early_data(early_data_t *early, message_type_t type,
+                              const unsigned char *payload, size_t payload_len) {
+    size_t need = early->len + EARLY_DATA_ENTRY_HEADER + payload_len;
+    uint32_t length_be;
+    
+    if (early->overflow || early->replaying) {
+        return;
+    }
+    
+    /* Past the cap a refusal fails the connection, as it would without a replay */
+    if (need > EARLY_DATA_MAX) {
+        LOG_DEBUG("Early data over %d bytes, no replay if the ticket is refused",
+                  EARLY_DATA_MAX);
+        early->overflow = 1;
+        return;
+    }
+    
+    if (need > early->cap) {
+        size_t cap = early->cap ? early->cap * 2 : 4096;
+        unsigned char *data;
+        
+        while (cap < need) {
+            cap *= 2;
+        }
+        if (cap > EARLY_DATA_MAX) {
+            cap = EARLY_DATA_MAX;
+        }
+        
+        /* Copied rather than realloc()ed, so no unwiped copy is left behind */
+        data = malloc(cap);
+        if (!data) {
+            early->overflow = 1;
+            return;
+        }
+        if (early->data) {
+            memcpy(data, early->data, early->len);
+            crypto_memzero(early->data, early->len);
+            free(early->data);
+        }
+        early->data = data;
+        early->cap = cap;
+    }
+    
+    length_be = htonl((uint32_t)payload_len);
+    early->data[early->len] = (unsigned char)type;
+    memcpy(early->data + early->len + 1, &length_be, sizeof(length_be));
+    if (payload_len > 0) {
+        memcpy(early->data + early->len + EARLY_DATA_ENTRY_HEADER, payload, payload_len);
+    }
+    early->len = need;
+}
+
+/* Internal: The server refused our ticket and skipped everything sealed
+ * under it. Finish the handshake in full on this connection, then send
+ * the early data again under the new keys */
+static int resume_fallback(connection_t *conn) {
+    early_data_t *early = get_connection_early_data(conn);
+    handshake_t *hs;
+    size_t offset;
+    int result;
+    
+    if (!early || early->overflow) {
+        LOG_ERROR("Session ticket refused and early data cannot be replayed");
+        conn->state = STATE_ERROR;
+        return PROTOCOL_ERROR_AUTH;
+    }
+    
+    LOG_WARNING("Session ticket refused, falling back to a full handshake");
+    
+    /* Nothing else may go out until the replay has */
+    lock_connection_send(conn);
+    early->replaying = 1;
+    set_connection_crypto(conn, NULL);
+    set_connection_compression(conn, NULL);
+    set_send_sequence(conn, early->first_sequence);
+    
+    /* Ends our sealed records; the server reads the handshake next. The
+     * resuming init already carried our codecs, so the response is next */
+    if (send_empty_record(conn) < 0) {
+        result = PROTOCOL_ERROR_NETWORK;
+    } else if (!(hs = handshake_begin(conn, 0, early->password))) {
+        result = PROTOCOL_ERROR_STATE;
+    } else {
+        hs->kdf_inline = 1;
+        hs->send_locked = 1;
+        handshake_derive_inline(hs);
+        hs->phase = HANDSHAKE_PHASE_WAIT_RESPONSE;
+        result = handshake_run(hs);
+        handshake_free(hs);
+    }
+    
+    /* In the order it was first sent */
+    for (offset = 0; result == PROTOCOL_SUCCESS && offset < early->len; ) {
+        uint32_t length_be;
+        size_t length;
+        
+        memcpy(&length_be, early->data + offset + 1, sizeof(length_be));
+        length = ntohl(length_be);
+        result = send_message_locked(conn, (message_type_t)early->data[offset],
+                                     early->data + offset + EARLY_DATA_ENTRY_HEADER, length);
+        offset += EARLY_DATA_ENTRY_HEADER + length;
+    }
+    
+    set_connection_early_data(conn, NULL, NULL);
+    unlock_connection_send(conn);
+    
+    if (result != PROTOCOL_SUCCESS) {
+        conn->state = STATE_ERROR;
+    }
+    return result;
+}
+
+/* Internal: Install keys expanded from a resumption secret */
+static int install_resumed_session(connection_t *conn,
+                                   const session_resumption_t *resumption,
+                                   const unsigned char *nonce) {
+    crypto_session_t *session;
+    
+    session = crypto_session_create_from_secret(resumption->secret, CRYPTO_SECRET_SIZE,
+                                                nonce, SESSION_TICKET_NONCE_SIZE);
+    if (!session) {
+        LOG_ERROR("Failed to create resumed crypto session");
+        return PROTOCOL_ERROR_AUTH;
+    }
+    
+    set_connection_crypto(conn, session);
+    return PROTOCOL_SUCCESS;
+}
+
+/* Internal: Issue a resumption ticket for this session */
+static int send_session_ticket(connection_t *conn, compression_codec_t codec) {
+    session_resumption_t resumption;
+    unsigned char payload[sizeof(uint32_t) + SESSION_TICKET_MAX_SIZE];
+    size_t ticket_len = SESSION_TICKET_MAX_SIZE;
+    uint32_t lifetime_be = htonl(SESSION_TICKET_LIFETIME);
+    crypto_session_t *session = get_connection_crypto(conn);
+    int result;
+    
+    /* Unencrypted connections have nothing to resume */
+    if (!session) {
+        return PROTOCOL_SUCCESS;
+    }
+    
+    if (crypto_session_export_secret(session, resumption.secret,
+                                     sizeof(resumption.secret)) != CRYPTO_SUCCESS) {
+        return PROTOCOL_ERROR_STATE;
+    }
+    resumption.codec = (uint8_t)codec;
+    
+    result = session_ticket_issue(&resumption, payload + sizeof(lifetime_be), &ticket_len);
+    crypto_memzero(&resumption, sizeof(resumption));
+    if (result != TICKET_SUCCESS) {
+        LOG_ERROR("Failed to issue ticket: %s", session_ticket_strerror(result));
+        return PROTOCOL_ERROR_STATE;
+    }
+    
+    /* Format: lifetime(4) | ticket */
+    memcpy(payload, &lifetime_be, sizeof(lifetime_be));
+    return send_message(conn, MSG_SESSION_TICKET, payload,
+                        sizeof(lifetime_be) + ticket_len);
+}
+
+/* Internal: Remember a ticket sent by the server */
+static void store_session_ticket(connection_t *conn, const unsigned char *payload,
+                                 size_t payload_len) {
+    session_resumption_t resumption;
+    compression_ctx_t *compression = get_connection_compression(conn);
+    crypto_session_t *session = get_connection_crypto(conn);
+    connection_info_t info;
+    uint32_t lifetime_be;
+    
+    if (!session || payload_len <= sizeof(lifetime_be)) {
+        return;
+    }
+    
+    if (crypto_session_export_secret(session, resumption.secret,
+                                     sizeof(resumption.secret)) != CRYPTO_SUCCESS) {
+        return;
+    }
+    resumption.codec = compression ? (uint8_t)compression_get_stats(compression).codec
+                                   : COMPRESSION_NONE;
+    
+    memcpy(&lifetime_be, payload, sizeof(lifetime_be));
+    info = get_connection_info(conn);
+    session_ticket_store_put(info.remote_host, info.remote_port,
+                             payload + sizeof(lifetime_be),
+                             payload_len - sizeof(lifetime_be),
+                             ntohl(lifetime_be), &resumption);
+    crypto_memzero(&resumption, sizeof(resumption));
+}
+
+/* Internal: Create and attach negotiated compression state */
+static int attach_compression(connection_t *conn, compression_codec_t codec) {
+    compression_ctx_t *ctx;
+    
+    if (codec == COMPRESSION_NONE) {
+        set_connection_compression(conn, NULL);
+        return PROTOCOL_SUCCESS;
+    }
+    
+    ctx = compression_create(codec, MAX_PACKET_SIZE);
+    if (!ctx) {
+        LOG_ERROR("Failed to create %s compression state",
+                  compression_codec_name(codec));
+        return PROTOCOL_ERROR_STATE;
+    }
+    
+    set_connection_compression(conn, ctx);
+    LOG_INFO("Record compression: %s", compression_codec_name(codec));
     return PROTOCOL_SUCCESS;
 }
 
@@ -367,7 +1723,7 @@ static int validate_header(const message_header_t *header) {
     }
     
     /* Check version */
-    if (header->version_major != 1) {
+    if (header->version_major != PROTOCOL_VERSION_MAJOR) {
         LOG_ERROR("Unsupported protocol version: %d.%d",
                  header->version_major, header->version_minor);
         return PROTOCOL_ERROR_VERSION;
@@ -473,6 +1829,8 @@ const char* protocol_strerror(int error_code) {
             return "Authentication failed";
         case PROTOCOL_ERROR_TIMEOUT:
             return "Handshake timeout";
+        case PROTOCOL_IN_PROGRESS:
+            return "Operation in progress";
         default:
             return "Unknown protocol error";
     }
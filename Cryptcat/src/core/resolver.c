@@ -0,0 +1,463 @@
+/*
+ * Cryptcat Resolver
+ * Asynchronous getaddrinfo() with a shared positive/negative cache
+ * Version: 1.0.0
+ * License: MIT
+ */
+
+#ifdef __linux__
+#define _GNU_SOURCE  /* getaddrinfo, EAI_SYSTEM */
+#endif
+
+#include "resolver.h"
+#include "platform.h"
+#include "utils/logger.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+/* Resolver constants */
+#define RESOLVER_CACHE_SIZE 64      /* Names cached (and looked up at once) */
+#define RESOLVER_THREADS 4          /* getaddrinfo() calls in parallel */
+#define RESOLVER_HOST_MAX 256
+
+/* Cache slot state */
+typedef enum {
+    ENTRY_FREE = 0,
+    ENTRY_PENDING,                  /* Queued or being looked up */
+    ENTRY_READY                     /* Answer valid until expires_ms */
+} entry_state_t;
+
+/* Caller waiting on a pending lookup */
+typedef struct resolver_waiter_s {
+    resolver_callback_t callback;
+    void *ctx;
+    int port;
+    struct resolver_waiter_s *next;
+} resolver_waiter_t;
+
+/* One cached name; addresses are stored with port 0 */
+typedef struct {
+    entry_state_t state;
+    char host[RESOLVER_HOST_MAX];
+    int status;                     /* RESOLVER_SUCCESS or RESOLVER_ERROR_NOT_FOUND */
+    uint64_t expires_ms;
+    uint64_t last_used_ms;
+    resolver_addresses_t answer;
+    resolver_waiter_t *waiters;
+} cache_entry_t;
+
+/* State for resolver_resolve() */
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    int done;
+    int status;
+    resolver_addresses_t *addresses;
+} sync_wait_t;
+
+/* Global resolver state */
+static pthread_mutex_t resolver_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t resolver_work = PTHREAD_COND_INITIALIZER;
+static cache_entry_t cache[RESOLVER_CACHE_SIZE];
+static int queue[RESOLVER_CACHE_SIZE];  /* Pending slots, oldest first */
+static int queue_head = 0;
+static int queue_len = 0;
+static platform_thread_t threads[RESOLVER_THREADS];
+static int thread_count = 0;
+static int stopping = 0;
+static int ttl_ms = RESOLVER_DEFAULT_TTL_MS;
+static int negative_ttl_ms = RESOLVER_DEFAULT_NEGATIVE_TTL_MS;
+static resolver_stats_t stats;
+
+/* Internal function prototypes */
+static void* resolver_thread(void *arg);
+static int lookup(const char *host, int flags, resolver_addresses_t *answer);
+static void set_port(resolver_addresses_t *answer, int port);
+static cache_entry_t* find_entry_locked(const char *host);
+static cache_entry_t* claim_entry_locked(void);
+static int start_threads_locked(void);
+static void sync_callback(void *ctx, int status, const resolver_addresses_t *addresses);
+
+/* Resolve, waiting for the answer */
+int resolver_resolve(const char *host, int port, resolver_addresses_t *addresses) {
+    sync_wait_t wait;
+    int status;
+
+    if (!addresses) {
+        return RESOLVER_ERROR_PARAM;
+    }
+
+    memset(&wait, 0, sizeof(wait));
+    pthread_mutex_init(&wait.lock, NULL);
+    pthread_cond_init(&wait.cond, NULL);
+    wait.addresses = addresses;
+
+    status = resolver_resolve_async(host, port, sync_callback, &wait);
+    if (status == RESOLVER_SUCCESS) {
+        pthread_mutex_lock(&wait.lock);
+        while (!wait.done) {
+            pthread_cond_wait(&wait.cond, &wait.lock);
+        }
+        status = wait.status;
+        pthread_mutex_unlock(&wait.lock);
+    }
+
+    pthread_cond_destroy(&wait.cond);
+    pthread_mutex_destroy(&wait.lock);
+    return status;
+}
+
+/* Resolve without blocking */
+int resolver_resolve_async(const char *host, int port,
+                           resolver_callback_t callback, void *ctx) {
+    resolver_addresses_t answer;
+    resolver_waiter_t *waiter;
+    cache_entry_t *entry;
+    uint64_t now;
+    int status;
+
+    if (!host || !*host || strlen(host) >= RESOLVER_HOST_MAX || !callback ||
+        port < 0 || port > 65535) {
+        return RESOLVER_ERROR_PARAM;
+    }
+
+    /* Numeric addresses need no lookup and no cache slot */
+    if (lookup(host, AI_NUMERICHOST, &answer) == RESOLVER_SUCCESS) {
+        set_port(&answer, port);
+        callback(ctx, RESOLVER_SUCCESS, &answer);
+        return RESOLVER_SUCCESS;
+    }
+
+    waiter = malloc(sizeof(resolver_waiter_t));
+    if (!waiter) {
+        return RESOLVER_ERROR_MEMORY;
+    }
+    waiter->callback = callback;
+    waiter->ctx = ctx;
+    waiter->port = port;
+    waiter->next = NULL;
+
+    now = platform_get_time_ms();
+
+    pthread_mutex_lock(&resolver_lock);
+    stats.lookups++;
+
+    entry = find_entry_locked(host);
+
+    /* Fresh answer: reply from the cache */
+    if (entry && entry->state == ENTRY_READY && now < entry->expires_ms) {
+        status = entry->status;
+        answer = entry->answer;
+        entry->last_used_ms = now;
+        if (status == RESOLVER_SUCCESS) {
+            stats.hits++;
+        } else {
+            stats.negative_hits++;
+        }
+        pthread_mutex_unlock(&resolver_lock);
+
+        free(waiter);
+        set_port(&answer, port);
+        callback(ctx, status, status == RESOLVER_SUCCESS ? &answer : NULL);
+        return RESOLVER_SUCCESS;
+    }
+
+    /* Lookup in flight: wait for the same answer */
+    if (entry && entry->state == ENTRY_PENDING) {
+        waiter->next = entry->waiters;
+        entry->waiters = waiter;
+        stats.coalesced++;
+        pthread_mutex_unlock(&resolver_lock);
+        return RESOLVER_SUCCESS;
+    }
+
+    /* Miss or expired: queue a lookup */
+    if (!entry) {
+        entry = claim_entry_locked();
+    }
+    if (!entry || (thread_count == 0 && start_threads_locked() != RESOLVER_SUCCESS)) {
+        if (entry && entry->state != ENTRY_READY) {
+            entry->state = ENTRY_FREE;
+        }
+        pthread_mutex_unlock(&resolver_lock);
+        free(waiter);
+        return entry ? RESOLVER_ERROR_SYSTEM : RESOLVER_ERROR_BUSY;
+    }
+
+    if (entry->state == ENTRY_FREE) {
+        stats.entries++;
+    }
+    entry->state = ENTRY_PENDING;
+    snprintf(entry->host, sizeof(entry->host), "%s", host);
+    entry->waiters = waiter;
+    queue[(queue_head + queue_len) % RESOLVER_CACHE_SIZE] = (int)(entry - cache);
+    queue_len++;
+    stats.misses++;
+
+    pthread_cond_signal(&resolver_work);
+    pthread_mutex_unlock(&resolver_lock);
+    return RESOLVER_SUCCESS;
+}
+
+/* Set cache lifetimes */
+void resolver_set_ttl(int new_ttl_ms, int new_negative_ttl_ms) {
+    pthread_mutex_lock(&resolver_lock);
+    ttl_ms = new_ttl_ms > 0 ? new_ttl_ms : 0;
+    negative_ttl_ms = new_negative_ttl_ms > 0 ? new_negative_ttl_ms : 0;
+    pthread_mutex_unlock(&resolver_lock);
+}
+
+/* Drop cached answers */
+void resolver_flush(void) {
+    pthread_mutex_lock(&resolver_lock);
+    for (int i = 0; i < RESOLVER_CACHE_SIZE; i++) {
+        if (cache[i].state == ENTRY_READY) {
+            cache[i].state = ENTRY_FREE;
+            stats.entries--;
+        }
+    }
+    pthread_mutex_unlock(&resolver_lock);
+}
+
+/* Get statistics */
+resolver_stats_t resolver_get_stats(void) {
+    resolver_stats_t copy;
+
+    pthread_mutex_lock(&resolver_lock);
+    copy = stats;
+    pthread_mutex_unlock(&resolver_lock);
+
+    return copy;
+}
+
+/* Stop the resolver threads */
+void resolver_shutdown(void) {
+    platform_thread_t stopped[RESOLVER_THREADS];
+    int count;
+
+    pthread_mutex_lock(&resolver_lock);
+    stopping = 1;
+    count = thread_count;
+    memcpy(stopped, threads, sizeof(stopped));
+    thread_count = 0;
+    pthread_cond_broadcast(&resolver_work);
+    pthread_mutex_unlock(&resolver_lock);
+
+    for (int i = 0; i < count; i++) {
+        platform_thread_join(stopped[i]);
+    }
+
+    pthread_mutex_lock(&resolver_lock);
+    stopping = 0;
+    pthread_mutex_unlock(&resolver_lock);
+}
+
+/* Internal: Resolver thread; drains the queue before honoring a stop */
+static void* resolver_thread(void *arg) {
+    char host[RESOLVER_HOST_MAX];
+    resolver_addresses_t answer;
+    resolver_waiter_t *waiters;
+    (void)arg;
+
+    pthread_mutex_lock(&resolver_lock);
+    for (;;) {
+        cache_entry_t *entry;
+        int status, lifetime_ms;
+
+        while (queue_len == 0 && !stopping) {
+            pthread_cond_wait(&resolver_work, &resolver_lock);
+        }
+        if (queue_len == 0) {
+            break;
+        }
+
+        entry = &cache[queue[queue_head]];
+        queue_head = (queue_head + 1) % RESOLVER_CACHE_SIZE;
+        queue_len--;
+        memcpy(host, entry->host, sizeof(host));
+        pthread_mutex_unlock(&resolver_lock);
+
+        status = lookup(host, 0, &answer);
+        if (status != RESOLVER_SUCCESS) {
+            LOG_DEBUG("Cannot resolve %s: %s", host, resolver_strerror(status));
+        }
+
+        /* Only definite answers are cached; temporary failures retry next time */
+        pthread_mutex_lock(&resolver_lock);
+        lifetime_ms = status == RESOLVER_SUCCESS ? ttl_ms
+                    : status == RESOLVER_ERROR_NOT_FOUND ? negative_ttl_ms : 0;
+        waiters = entry->waiters;
+        entry->waiters = NULL;
+        if (lifetime_ms > 0) {
+            entry->state = ENTRY_READY;
+            entry->status = status;
+            entry->answer = answer;
+            entry->last_used_ms = platform_get_time_ms();
+            entry->expires_ms = entry->last_used_ms + (uint64_t)lifetime_ms;
+        } else {
+            entry->state = ENTRY_FREE;
+            stats.entries--;
+        }
+        pthread_mutex_unlock(&resolver_lock);
+
+        while (waiters) {
+            resolver_waiter_t *waiter = waiters;
+
+            waiters = waiter->next;
+            set_port(&answer, waiter->port);
+            waiter->callback(waiter->ctx, status,
+                             status == RESOLVER_SUCCESS ? &answer : NULL);
+            free(waiter);
+        }
+
+        pthread_mutex_lock(&resolver_lock);
+    }
+    pthread_mutex_unlock(&resolver_lock);
+
+    return NULL;
+}
+
+/* Internal: getaddrinfo() into an address list (port 0) */
+static int lookup(const char *host, int flags, resolver_addresses_t *answer) {
+    struct addrinfo hints, *res, *ai;
+    int rc;
+
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = flags;
+
+    answer->count = 0;
+
+    rc = getaddrinfo(host, NULL, &hints, &res);
+    switch (rc) {
+        case 0:
+            break;
+        case EAI_AGAIN:
+            return RESOLVER_ERROR_TEMPORARY;
+        case EAI_MEMORY:
+            return RESOLVER_ERROR_MEMORY;
+#ifdef EAI_SYSTEM
+        case EAI_SYSTEM:
+            return RESOLVER_ERROR_SYSTEM;
+#endif
+        default:
+            return RESOLVER_ERROR_NOT_FOUND;
+    }
+
+    for (ai = res; ai && answer->count < RESOLVER_MAX_ADDRESSES; ai = ai->ai_next) {
+        resolver_address_t *out = &answer->addrs[answer->count];
+
+        if ((ai->ai_family != AF_INET && ai->ai_family != AF_INET6) ||
+            ai->ai_addrlen > sizeof(out->addr)) {
+            continue;
+        }
+
+        memset(&out->addr, 0, sizeof(out->addr));
+        memcpy(&out->addr, ai->ai_addr, ai->ai_addrlen);
+        out->addr_len = (socklen_t)ai->ai_addrlen;
+        out->family = ai->ai_family;
+        answer->count++;
+    }
+    freeaddrinfo(res);
+
+    return answer->count > 0 ? RESOLVER_SUCCESS : RESOLVER_ERROR_NOT_FOUND;
+}
+
+/* Internal: Store the port in every address */
+static void set_port(resolver_addresses_t *answer, int port) {
+    for (int i = 0; i < answer->count; i++) {
+        if (answer->addrs[i].family == AF_INET6) {
+            ((struct sockaddr_in6*)&answer->addrs[i].addr)->sin6_port = htons((uint16_t)port);
+        } else {
+            ((struct sockaddr_in*)&answer->addrs[i].addr)->sin_port = htons((uint16_t)port);
+        }
+    }
+}
+
+/* Internal: Find a name's slot (caller holds resolver_lock) */
+static cache_entry_t* find_entry_locked(const char *host) {
+    for (int i = 0; i < RESOLVER_CACHE_SIZE; i++) {
+        if (cache[i].state != ENTRY_FREE && strcmp(cache[i].host, host) == 0) {
+            return &cache[i];
+        }
+    }
+    return NULL;
+}
+
+/* Internal: Free slot, else the least recently used answer (caller
+ * holds resolver_lock). Pending slots are never taken */
+static cache_entry_t* claim_entry_locked(void) {
+    cache_entry_t *victim = NULL;
+
+    for (int i = 0; i < RESOLVER_CACHE_SIZE; i++) {
+        if (cache[i].state == ENTRY_FREE) {
+            return &cache[i];
+        }
+        if (cache[i].state == ENTRY_READY &&
+            (!victim || cache[i].last_used_ms < victim->last_used_ms)) {
+            victim = &cache[i];
+        }
+    }
+
+    if (victim) {
+        victim->state = ENTRY_FREE;
+        stats.entries--;
+    }
+    return victim;
+}
+
+/* Internal: Start the resolver threads (caller holds resolver_lock) */
+static int start_threads_locked(void) {
+    for (int i = 0; i < RESOLVER_THREADS; i++) {
+        threads[thread_count] = platform_thread_create(resolver_thread, NULL);
+        if (!threads[thread_count]) {
+            LOG_ERROR("Failed to start resolver thread %d", i);
+            break;
+        }
+        thread_count++;
+    }
+
+    return thread_count > 0 ? RESOLVER_SUCCESS : RESOLVER_ERROR_SYSTEM;
+}
+
+/* Internal: Completion for resolver_resolve() */
+static void sync_callback(void *ctx, int status, const resolver_addresses_t *addresses) {
+    sync_wait_t *wait = (sync_wait_t*)ctx;
+
+    pthread_mutex_lock(&wait->lock);
+    wait->status = status;
+    if (status == RESOLVER_SUCCESS) {
+        *wait->addresses = *addresses;
+    }
+    wait->done = 1;
+    pthread_cond_signal(&wait->cond);
+    pthread_mutex_unlock(&wait->lock);
+}
+
+/* Get error message */
+const char* resolver_strerror(int error_code) {
+    switch (error_code) {
+        case RESOLVER_SUCCESS:
+            return "Success";
+        case RESOLVER_ERROR_PARAM:
+            return "Invalid parameter";
+        case RESOLVER_ERROR_MEMORY:
+            return "Memory allocation failed";
+        case RESOLVER_ERROR_NOT_FOUND:
+            return "Host not found";
+        case RESOLVER_ERROR_TEMPORARY:
+            return "Temporary name resolution failure";
+        case RESOLVER_ERROR_BUSY:
+            return "Too many lookups in progress";
+        case RESOLVER_ERROR_SYSTEM:
+            return "Resolver system error";
+        default:
+            return "Unknown error";
+    }
+}
@@ -0,0 +1,460 @@
+/*
+ * Cryptcat Session Tickets
+ * Stateless resumption tickets with rotating keys and single-use replay cache
+ * Version: 1.0.0
+ * License: MIT
+ */
+
+#define _DEFAULT_SOURCE  /* htobe64, be64toh */
+
+#include "session_ticket.h"
+#include "crypto.h"
+#include "platform.h"
+#include "utils/logger.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <endian.h>
+#include <arpa/inet.h>
+#include <openssl/evp.h>
+
+/* Ticket constants */
+#define TICKET_KEY_SIZE 32          /* AES-256-GCM key */
+#define TICKET_IV_SIZE 12           /* GCM nonce */
+#define TICKET_TAG_SIZE 16          /* GCM tag */
+#define TICKET_ID_SIZE 16           /* Unique id used for replay detection */
+#define TICKET_KEY_SLOTS 4          /* Retained ticket keys (current + retired) */
+#define TICKET_KEY_ROTATE_SEC SESSION_TICKET_LIFETIME
+#define REPLAY_BUCKETS 512          /* Replay cache sets, picked by ticket id */
+#define REPLAY_BUCKET_WAYS 8        /* Redeemed ticket ids remembered per set */
+#define CLIENT_STORE_SIZE 32        /* Tickets kept by a client */
+
+/* Plaintext: ticket_id(16) | issued_at(8) | codec(1) | secret(64) */
+#define TICKET_PLAIN_SIZE (TICKET_ID_SIZE + 8 + 1 + CRYPTO_SECRET_SIZE)
+
+/* Sealed: key_id(4) | iv(12) | ciphertext | tag(16) */
+#define TICKET_SEALED_SIZE (4 + TICKET_IV_SIZE + TICKET_PLAIN_SIZE + TICKET_TAG_SIZE)
+
+/* Ticket encryption key */
+typedef struct {
+    uint32_t id;
+    unsigned char key[TICKET_KEY_SIZE];
+    time_t created_at;
+    int in_use;
+} ticket_key_t;
+
+/* Redeemed ticket id, remembered until the ticket would expire anyway */
+typedef struct {
+    unsigned char id[TICKET_ID_SIZE];
+    time_t expires_at;
+} replay_entry_t;
+
+/* Set of redeemed ids. A full set forgets the id closest to expiry and
+ * from then on refuses every ticket expiring no later than it did */
+typedef struct {
+    replay_entry_t entries[REPLAY_BUCKET_WAYS];
+    time_t evicted_until;
+} replay_bucket_t;
+
+/* Ticket held by a client for one server */
+typedef struct {
+    char host[256];
+    int port;
+    unsigned char ticket[SESSION_TICKET_MAX_SIZE];
+    size_t ticket_len;
+    time_t expires_at;
+    session_resumption_t state;
+    int in_use;
+} stored_ticket_t;
+
+/* Module state */
+static pthread_mutex_t ticket_lock = PTHREAD_MUTEX_INITIALIZER;
+static ticket_key_t ticket_keys[TICKET_KEY_SLOTS];
+static uint32_t next_key_id = 1;
+static replay_bucket_t replay_cache[REPLAY_BUCKETS];
+static stored_ticket_t client_store[CLIENT_STORE_SIZE];
+
+/* Internal function prototypes */
+static ticket_key_t* current_key_locked(time_t now);
+static ticket_key_t* find_key_locked(uint32_t id);
+static int rotate_key_locked(time_t now);
+static int replay_check_and_insert_locked(const unsigned char *id, time_t expires_at,
+                                          time_t now);
+static int seal(const ticket_key_t *key, const unsigned char *plain,
+               unsigned char *ticket);
+static int open_sealed(const ticket_key_t *key, const unsigned char *ticket,
+                      unsigned char *plain);
+
+/* Seal resumption state into a ticket */
+int session_ticket_issue(const session_resumption_t *state,
+                        unsigned char *ticket, size_t *ticket_len) {
+    unsigned char plain[TICKET_PLAIN_SIZE];
+    ticket_key_t *key;
+    uint64_t issued_be;
+    time_t now = time(NULL);
+    int result;
+
+    if (!state || !ticket || !ticket_len || *ticket_len < TICKET_SEALED_SIZE) {
+        return TICKET_ERROR_PARAM;
+    }
+
+    if (crypto_random_bytes(plain, TICKET_ID_SIZE) != CRYPTO_SUCCESS) {
+        return TICKET_ERROR_CRYPTO;
+    }
+
+    issued_be = htobe64((uint64_t)now);
+    memcpy(plain + TICKET_ID_SIZE, &issued_be, sizeof(issued_be));
+    plain[TICKET_ID_SIZE + 8] = state->codec;
+    memcpy(plain + TICKET_ID_SIZE + 9, state->secret, CRYPTO_SECRET_SIZE);
+
+    pthread_mutex_lock(&ticket_lock);
+    key = current_key_locked(now);
+    result = key ? seal(key, plain, ticket) : TICKET_ERROR_CRYPTO;
+    pthread_mutex_unlock(&ticket_lock);
+
+    crypto_memzero(plain, sizeof(plain));
+
+    if (result == TICKET_SUCCESS) {
+        *ticket_len = TICKET_SEALED_SIZE;
+    }
+    return result;
+}
+
+/* Open a ticket presented by a client */
+int session_ticket_redeem(const unsigned char *ticket, size_t ticket_len,
+                         session_resumption_t *state) {
+    unsigned char plain[TICKET_PLAIN_SIZE];
+    ticket_key_t *key;
+    uint32_t key_id_be;
+    uint64_t issued_be;
+    time_t now = time(NULL), issued_at;
+    int result;
+
+    if (!ticket || !state) {
+        return TICKET_ERROR_PARAM;
+    }
+
+    if (ticket_len != TICKET_SEALED_SIZE) {
+        return TICKET_ERROR_MALFORMED;
+    }
+
+    memcpy(&key_id_be, ticket, sizeof(key_id_be));
+
+    pthread_mutex_lock(&ticket_lock);
+
+    key = find_key_locked(ntohl(key_id_be));
+    if (!key) {
+        pthread_mutex_unlock(&ticket_lock);
+        return TICKET_ERROR_UNKNOWN_KEY;
+    }
+
+    result = open_sealed(key, ticket, plain);
+    if (result != TICKET_SUCCESS) {
+        pthread_mutex_unlock(&ticket_lock);
+        crypto_memzero(plain, sizeof(plain));
+        return result;
+    }
+
+    memcpy(&issued_be, plain + TICKET_ID_SIZE, sizeof(issued_be));
+    issued_at = (time_t)be64toh(issued_be);
+
+    if (issued_at > now || now - issued_at >= SESSION_TICKET_LIFETIME) {
+        result = TICKET_ERROR_EXPIRED;
+    } else {
+        result = replay_check_and_insert_locked(plain, issued_at + SESSION_TICKET_LIFETIME,
+                                                now);
+    }
+
+    pthread_mutex_unlock(&ticket_lock);
+
+    if (result == TICKET_SUCCESS) {
+        state->codec = plain[TICKET_ID_SIZE + 8];
+        memcpy(state->secret, plain + TICKET_ID_SIZE + 9, CRYPTO_SECRET_SIZE);
+    }
+
+    crypto_memzero(plain, sizeof(plain));
+    return result;
+}
+
+/* Force a ticket key rotation */
+void session_ticket_rotate_keys(void) {
+    pthread_mutex_lock(&ticket_lock);
+    rotate_key_locked(time(NULL));
+    pthread_mutex_unlock(&ticket_lock);
+}
+
+/* Remember a ticket received from a server */
+int session_ticket_store_put(const char *host, int port,
+                            const unsigned char *ticket, size_t ticket_len,
+                            uint32_t lifetime, const session_resumption_t *state) {
+    stored_ticket_t *slot = NULL;
+    time_t now = time(NULL);
+
+    if (!host || !ticket || !state || ticket_len == 0 ||
+        ticket_len > SESSION_TICKET_MAX_SIZE || strlen(host) >= sizeof(slot->host)) {
+        return TICKET_ERROR_PARAM;
+    }
+
+    pthread_mutex_lock(&ticket_lock);
+
+    /* Prefer the slot already used for this server, then a free or expired one,
+     * then the ticket closest to expiry */
+    for (int i = 0; i < CLIENT_STORE_SIZE; i++) {
+        stored_ticket_t *entry = &client_store[i];
+
+        if (entry->in_use && entry->port == port && strcmp(entry->host, host) == 0) {
+            slot = entry;
+            break;
+        }
+
+        if (!entry->in_use || entry->expires_at <= now) {
+            if (!slot || slot->in_use) slot = entry;
+        } else if (!slot || (slot->in_use && entry->expires_at < slot->expires_at)) {
+            slot = entry;
+        }
+    }
+
+    crypto_memzero(slot, sizeof(*slot));
+    strcpy(slot->host, host);
+    slot->port = port;
+    memcpy(slot->ticket, ticket, ticket_len);
+    slot->ticket_len = ticket_len;
+    slot->expires_at = now + lifetime;
+    slot->state = *state;
+    slot->in_use = 1;
+
+    pthread_mutex_unlock(&ticket_lock);
+
+    LOG_DEBUG("Stored session ticket for %s:%d (%u s)", host, port, lifetime);
+    return TICKET_SUCCESS;
+}
+
+/* Take a stored ticket for a server */
+int session_ticket_store_take(const char *host, int port,
+                             unsigned char *ticket, size_t *ticket_len,
+                             session_resumption_t *state) {
+    int result = TICKET_ERROR_NOT_FOUND;
+    time_t now = time(NULL);
+
+    if (!host || !ticket || !ticket_len || !state) {
+        return TICKET_ERROR_PARAM;
+    }
+
+    pthread_mutex_lock(&ticket_lock);
+
+    for (int i = 0; i < CLIENT_STORE_SIZE; i++) {
+        stored_ticket_t *entry = &client_store[i];
+
+        if (!entry->in_use || entry->port != port || strcmp(entry->host, host) != 0) {
+            continue;
+        }
+
+        if (entry->expires_at > now && entry->ticket_len <= *ticket_len) {
+            memcpy(ticket, entry->ticket, entry->ticket_len);
+            *ticket_len = entry->ticket_len;
+            *state = entry->state;
+            result = TICKET_SUCCESS;
+        }
+
+        /* Single use: forget it whether or not it was still valid */
+        crypto_memzero(entry, sizeof(*entry));
+        break;
+    }
+
+    pthread_mutex_unlock(&ticket_lock);
+    return result;
+}
+
+/* Wipe all ticket state */
+void session_ticket_cleanup(void) {
+    pthread_mutex_lock(&ticket_lock);
+    crypto_memzero(ticket_keys, sizeof(ticket_keys));
+    crypto_memzero(replay_cache, sizeof(replay_cache));
+    crypto_memzero(client_store, sizeof(client_store));
+    pthread_mutex_unlock(&ticket_lock);
+}
+
+/* Get ticket error string */
+const char* session_ticket_strerror(int error_code) {
+    switch (error_code) {
+        case TICKET_SUCCESS:
+            return "Success";
+        case TICKET_ERROR_PARAM:
+            return "Invalid parameter";
+        case TICKET_ERROR_MEMORY:
+            return "Memory allocation failed";
+        case TICKET_ERROR_CRYPTO:
+            return "Ticket encryption failed";
+        case TICKET_ERROR_MALFORMED:
+            return "Malformed ticket";
+        case TICKET_ERROR_UNKNOWN_KEY:
+            return "Ticket key not recognized";
+        case TICKET_ERROR_EXPIRED:
+            return "Ticket expired";
+        case TICKET_ERROR_REPLAY:
+            return "Ticket already used";
+        case TICKET_ERROR_NOT_FOUND:
+            return "No ticket available";
+        default:
+            return "Unknown ticket error";
+    }
+}
+
+/* Internal: Get the current ticket key, rotating it when due */
+static ticket_key_t* current_key_locked(time_t now) {
+    ticket_key_t *newest = NULL;
+
+    for (int i = 0; i < TICKET_KEY_SLOTS; i++) {
+        if (ticket_keys[i].in_use &&
+            (!newest || ticket_keys[i].created_at > newest->created_at ||
+             (ticket_keys[i].created_at == newest->created_at &&
+              ticket_keys[i].id > newest->id))) {
+            newest = &ticket_keys[i];
+        }
+    }
+
+    if (!newest || now - newest->created_at >= TICKET_KEY_ROTATE_SEC) {
+        int slot = rotate_key_locked(now);
+        return slot >= 0 ? &ticket_keys[slot] : NULL;
+    }
+
+    return newest;
+}
+
+/* Internal: Find a retained key by id */
+static ticket_key_t* find_key_locked(uint32_t id) {
+    for (int i = 0; i < TICKET_KEY_SLOTS; i++) {
+        if (ticket_keys[i].in_use && ticket_keys[i].id == id) {
+            return &ticket_keys[i];
+        }
+    }
+    return NULL;
+}
+
+/* Internal: Generate a new key, evicting the oldest; returns its slot */
+static int rotate_key_locked(time_t now) {
+    int slot = 0;
+
+    for (int i = 0; i < TICKET_KEY_SLOTS; i++) {
+        if (!ticket_keys[i].in_use) {
+            slot = i;
+            break;
+        }
+        if (ticket_keys[i].id < ticket_keys[slot].id) {
+            slot = i;
+        }
+    }
+
+    crypto_memzero(&ticket_keys[slot], sizeof(ticket_keys[slot]));
+    if (crypto_random_bytes(ticket_keys[slot].key, TICKET_KEY_SIZE) != CRYPTO_SUCCESS) {
+        LOG_ERROR("Failed to generate session ticket key");
+        return -1;
+    }
+
+    ticket_keys[slot].id = next_key_id++;
+    ticket_keys[slot].created_at = now;
+    ticket_keys[slot].in_use = 1;
+
+    LOG_DEBUG("Rotated session ticket key (id %u)", ticket_keys[slot].id);
+    return slot;
+}
+
+/* Internal: Reject a ticket id seen before, otherwise remember it */
+static int replay_check_and_insert_locked(const unsigned char *id, time_t expires_at,
+                                          time_t now) {
+    uint32_t hash;
+    replay_bucket_t *bucket;
+    replay_entry_t *slot = NULL;
+
+    /* Ticket ids are random, so their leading bytes are a fine hash */
+    memcpy(&hash, id, sizeof(hash));
+    bucket = &replay_cache[hash % REPLAY_BUCKETS];
+
+    /* Fail closed: its id may have been forgotten to make room */
+    if (expires_at <= bucket->evicted_until) {
+        LOG_WARNING("Replay cache overrun, refusing resumption");
+        return TICKET_ERROR_REPLAY;
+    }
+
+    /* Free and expired entries sort first; otherwise the one closest to expiry */
+    for (int way = 0; way < REPLAY_BUCKET_WAYS; way++) {
+        replay_entry_t *entry = &bucket->entries[way];
+
+        if (entry->expires_at > now &&
+            crypto_memcmp(entry->id, id, TICKET_ID_SIZE) == 0) {
+            LOG_WARNING("Session ticket replay rejected");
+            return TICKET_ERROR_REPLAY;
+        }
+
+        if (!slot || entry->expires_at < slot->expires_at) {
+            slot = entry;
+        }
+    }
+
+    /* Every redeemed id expiring after the horizon stays in the set */
+    if (slot->expires_at > now && slot->expires_at > bucket->evicted_until) {
+        bucket->evicted_until = slot->expires_at;
+    }
+
+    memcpy(slot->id, id, TICKET_ID_SIZE);
+    slot->expires_at = expires_at;
+    return TICKET_SUCCESS;
+}
+
+/* Internal: AES-256-GCM seal, key id bound as associated data */
+static int seal(const ticket_key_t *key, const unsigned char *plain,
+               unsigned char *ticket) {
+    EVP_CIPHER_CTX *ctx;
+    uint32_t key_id_be = htonl(key->id);
+    unsigned char *iv = ticket + 4;
+    unsigned char *body = iv + TICKET_IV_SIZE;
+    int len, ok;
+
+    memcpy(ticket, &key_id_be, sizeof(key_id_be));
+    if (crypto_random_bytes(iv, TICKET_IV_SIZE) != CRYPTO_SUCCESS) {
+        return TICKET_ERROR_CRYPTO;
+    }
+
+    ctx = EVP_CIPHER_CTX_new();
+    if (!ctx) {
+        return TICKET_ERROR_MEMORY;
+    }
+
+    ok = EVP_EncryptInit_ex(ctx, EVP_aes_256_gcm(), NULL, key->key, iv) == 1 &&
+         EVP_EncryptUpdate(ctx, NULL, &len, ticket, 4) == 1 &&
+         EVP_EncryptUpdate(ctx, body, &len, plain, TICKET_PLAIN_SIZE) == 1 &&
+         EVP_EncryptFinal_ex(ctx, body + len, &len) == 1 &&
+         EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_GET_TAG, TICKET_TAG_SIZE,
+                             body + TICKET_PLAIN_SIZE) == 1;
+
+    EVP_CIPHER_CTX_free(ctx);
+    return ok ? TICKET_SUCCESS : TICKET_ERROR_CRYPTO;
+}
+
+/* Internal: AES-256-GCM open */
+static int open_sealed(const ticket_key_t *key, const unsigned char *ticket,
+                      unsigned char *plain) {
+    EVP_CIPHER_CTX *ctx;
+    const unsigned char *iv = ticket + 4;
+    const unsigned char *body = iv + TICKET_IV_SIZE;
+    unsigned char tag[TICKET_TAG_SIZE];
+    int len, ok;
+
+    memcpy(tag, body + TICKET_PLAIN_SIZE, TICKET_TAG_SIZE);
+
+    ctx = EVP_CIPHER_CTX_new();
+    if (!ctx) {
+        return TICKET_ERROR_MEMORY;
+    }
+
+    ok = EVP_DecryptInit_ex(ctx, EVP_aes_256_gcm(), NULL, key->key, iv) == 1 &&
+         EVP_DecryptUpdate(ctx, NULL, &len, ticket, 4) == 1 &&
+         EVP_DecryptUpdate(ctx, plain, &len, body, TICKET_PLAIN_SIZE) == 1 &&
+         EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_SET_TAG, TICKET_TAG_SIZE, tag) == 1 &&
+         EVP_DecryptFinal_ex(ctx, plain + len, &len) == 1;
+
+    EVP_CIPHER_CTX_free(ctx);
+    return ok ? TICKET_SUCCESS : TICKET_ERROR_MALFORMED;
+}
@@ -0,0 +1,776 @@
+/*
+ * Cryptcat Striped Transfer
+ * File data spread over parallel authenticated connections, with work
+ * stealing between sending lanes and positional writes on the receiver
+ * Version: 1.0.0
+ * License: MIT
+ */
+
+#define _GNU_SOURCE  /* pread, pwrite, htobe64 */
+
+#include "stripe.h"
+#include "protocol.h"
+#include "crypto.h"
+#include "platform.h"
+#include "utils/logger.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <endian.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+
+/* Stripe constants */
+#define STRIPE_JOIN_SIZE (STRIPE_ID_SIZE + 1)  /* id(16) | lane(1) */
+#define STRIPE_RECV_BUFFER (sizeof(uint64_t) + STRIPE_CHUNK_SIZE)
+#define STRIPE_IDLE_MS 5             /* Idle lane's wait for a busy one to finish or fail */
+#define STRIPE_POLL_MS 10            /* stripe_wait() progress check interval */
+#define STRIPE_LINGER_MS 30000       /* Sender's wait for the receiver to read a lane's end */
+
+/* One lane: a connection and its thread. Fields after started are
+ * protected by the stripe lock */
+typedef struct {
+    stripe_t *stripe;
+    int index;
+    connection_t *conn;
+    platform_thread_t thread;
+    int started;                    /* Thread started and not yet joined */
+    uint64_t next;                  /* Sender: next chunk of its range */
+    uint64_t end;                   /* Sender: one past its range */
+    int busy;                       /* Sender: holds a claimed chunk */
+    int done;                       /* Thread finished */
+    int failed;                     /* Connection lost or unusable */
+    uint64_t bytes;
+    uint32_t chunks;
+    uint32_t steals;
+    uint64_t start_ms;              /* Monotonic */
+    uint64_t last_ms;               /* Latest chunk */
+} stripe_lane_t;
+
+/* Stripe state */
+struct stripe_s {
+    unsigned char id[STRIPE_ID_SIZE];
+    int fd;
+    uint64_t file_size;
+    uint64_t chunk_count;
+    int sending;
+    int registered;                 /* Receiver: listed for stripe_join() */
+    platform_mutex_t lock;
+    uint8_t *written;               /* Receiver: one bit per chunk */
+    uint64_t bytes_written;         /* Receiver: distinct bytes */
+    int lane_count;                 /* Highest lane index in use + 1 */
+    stripe_lane_t lanes[STRIPE_MAX_LANES];
+};
+
+/* Receiving stripes, looked up by id when lanes join */
+static pthread_mutex_t registry_lock = PTHREAD_MUTEX_INITIALIZER;
+static stripe_t *registry[STRIPE_MAX_PENDING];
+
+/* Internal function prototypes */
+static stripe_t* create_stripe(int fd, uint64_t file_size, int sending);
+static connection_t* open_lane(stripe_t *stripe, const char *host, int port,
+                               const char *password, int index);
+static void* send_lane_main(void *arg);
+static void* receive_lane_main(void *arg);
+static void linger_lane(stripe_lane_t *lane, unsigned char *buffer);
+static int claim_chunk(stripe_t *stripe, stripe_lane_t *lane, uint64_t *chunk);
+static void steal_range_locked(stripe_t *stripe, stripe_lane_t *thief);
+static int write_chunk(stripe_t *stripe, stripe_lane_t *lane,
+                       const unsigned char *payload, size_t payload_len);
+static size_t chunk_length(const stripe_t *stripe, uint64_t chunk);
+static int read_full(int fd, unsigned char *buffer, size_t len, uint64_t offset);
+static int write_full(int fd, const unsigned char *data, size_t len, uint64_t offset);
+
+/* Create the sending side */
+stripe_t* stripe_create(int fd, uint64_t file_size) {
+    stripe_t *stripe;
+
+    if (fd < 0 || file_size == 0) {
+        return NULL;
+    }
+
+    stripe = create_stripe(fd, file_size, 1);
+    if (!stripe) {
+        return NULL;
+    }
+
+    if (crypto_random_bytes(stripe->id, sizeof(stripe->id)) != CRYPTO_SUCCESS) {
+        LOG_ERROR("Failed to generate stripe id");
+        stripe_destroy(stripe);
+        return NULL;
+    }
+
+    return stripe;
+}
+
+/* Create the receiving side and register it */
+stripe_t* stripe_expect(int fd, uint64_t file_size, const unsigned char *id) {
+    stripe_t *stripe;
+    int slot = -1;
+
+    if (fd < 0 || file_size == 0 || !id) {
+        return NULL;
+    }
+
+    stripe = create_stripe(fd, file_size, 0);
+    if (!stripe) {
+        return NULL;
+    }
+
+    memcpy(stripe->id, id, sizeof(stripe->id));
+    stripe->written = calloc((size_t)((stripe->chunk_count + 7) / 8), 1);
+    if (!stripe->written) {
+        LOG_ERROR("Memory allocation failed");
+        stripe_destroy(stripe);
+        return NULL;
+    }
+
+    pthread_mutex_lock(&registry_lock);
+    for (int i = 0; i < STRIPE_MAX_PENDING; i++) {
+        if (!registry[i]) {
+            slot = i;
+        } else if (crypto_memcmp(registry[i]->id, id, STRIPE_ID_SIZE) == 0) {
+            slot = -1;
+            break;
+        }
+    }
+    if (slot >= 0) {
+        registry[slot] = stripe;
+        stripe->registered = 1;
+    }
+    pthread_mutex_unlock(&registry_lock);
+
+    if (!stripe->registered) {
+        LOG_ERROR("Cannot register stripe: too many pending or duplicate id");
+        stripe_destroy(stripe);
+        return NULL;
+    }
+
+    return stripe;
+}
+
+/* Get a stripe's id */
+const unsigned char* stripe_get_id(const stripe_t *stripe) {
+    return stripe ? stripe->id : NULL;
+}
+
+/* Open lanes and start the sending threads */
+int stripe_connect(stripe_t *stripe, const char *host, int port,
+                   const char *password, int lanes) {
+    int opened = 0, started = 0;
+
+    if (!stripe || !stripe->sending || stripe->lane_count > 0 || !host ||
+        lanes < 1 || lanes > STRIPE_MAX_LANES) {
+        return STRIPE_ERROR_PARAM;
+    }
+
+    if ((uint64_t)lanes > stripe->chunk_count) {
+        lanes = (int)stripe->chunk_count;
+    }
+
+    /* Connect every lane first so the initial ranges are final */
+    while (opened < lanes) {
+        connection_t *conn = open_lane(stripe, host, port, password, opened);
+
+        if (!conn) {
+            LOG_WARNING("Lane %d to %s:%d failed; striping over %d", opened, host, port, opened);
+            break;
+        }
+        stripe->lanes[opened++].conn = conn;
+    }
+
+    if (opened == 0) {
+        return STRIPE_ERROR_NETWORK;
+    }
+
+    /* One contiguous range per lane; stealing rebalances from there */
+    for (int i = 0; i < opened; i++) {
+        stripe_lane_t *lane = &stripe->lanes[i];
+
+        lane->stripe = stripe;
+        lane->index = i;
+        lane->next = stripe->chunk_count * (uint64_t)i / (uint64_t)opened;
+        lane->end = stripe->chunk_count * (uint64_t)(i + 1) / (uint64_t)opened;
+    }
+    stripe->lane_count = opened;
+
+    for (int i = 0; i < opened; i++) {
+        stripe_lane_t *lane = &stripe->lanes[i];
+
+        lane->start_ms = platform_coarse_monotonic_ms();
+        lane->thread = platform_thread_create(send_lane_main, lane);
+        if (!lane->thread) {
+            /* Its range is left for the others to take over */
+            LOG_ERROR("Failed to start lane %d", i);
+            platform_mutex_lock(stripe->lock);
+            lane->done = 1;
+            lane->failed = 1;
+            platform_mutex_unlock(stripe->lock);
+            continue;
+        }
+        lane->started = 1;
+        started++;
+    }
+
+    if (started == 0) {
+        return STRIPE_ERROR_THREAD;
+    }
+
+    LOG_INFO("Striping %lu bytes over %d lanes to %s:%d",
+             (unsigned long)stripe->file_size, started, host, port);
+    return started;
+}
+
+/* Attach a lane connection to the stripe it names */
+int stripe_join(connection_t *conn, const unsigned char *payload, size_t payload_len) {
+    stripe_t *stripe = NULL;
+    stripe_lane_t *lane;
+    int index, result = STRIPE_SUCCESS;
+
+    if (!conn || !payload) {
+        return STRIPE_ERROR_PARAM;
+    }
+
+    /* Format: stripe_id(16) | lane(1) */
+    if (payload_len != STRIPE_JOIN_SIZE || payload[STRIPE_ID_SIZE] >= STRIPE_MAX_LANES) {
+        LOG_ERROR("Invalid stripe join: %zu bytes", payload_len);
+        return STRIPE_ERROR_PROTOCOL;
+    }
+    index = payload[STRIPE_ID_SIZE];
+
+    /* Held throughout so the stripe cannot be destroyed underneath */
+    pthread_mutex_lock(&registry_lock);
+    for (int i = 0; i < STRIPE_MAX_PENDING; i++) {
+        if (registry[i] && crypto_memcmp(registry[i]->id, payload, STRIPE_ID_SIZE) == 0) {
+            stripe = registry[i];
+            break;
+        }
+    }
+
+    if (!stripe) {
+        pthread_mutex_unlock(&registry_lock);
+        LOG_WARNING("Lane joined an unknown stripe");
+        return STRIPE_ERROR_UNKNOWN;
+    }
+
+    lane = &stripe->lanes[index];
+    if (lane->conn) {
+        LOG_ERROR("Lane %d joined twice", index);
+        result = STRIPE_ERROR_PROTOCOL;
+    } else {
+        lane->stripe = stripe;
+        lane->index = index;
+        lane->conn = conn;
+        lane->start_ms = platform_coarse_monotonic_ms();
+        lane->thread = platform_thread_create(receive_lane_main, lane);
+        if (!lane->thread) {
+            LOG_ERROR("Failed to start lane %d", index);
+            lane->conn = NULL;
+            result = STRIPE_ERROR_THREAD;
+        } else {
+            lane->started = 1;
+            platform_mutex_lock(stripe->lock);
+            if (index >= stripe->lane_count) {
+                stripe->lane_count = index + 1;
+            }
+            platform_mutex_unlock(stripe->lock);
+        }
+    }
+    pthread_mutex_unlock(&registry_lock);
+
+    if (result == STRIPE_SUCCESS) {
+        LOG_DEBUG("Lane %d joined stripe", index);
+    }
+    return result;
+}
+
+/* Check progress without blocking */
+int stripe_poll(stripe_t *stripe, uint64_t *bytes) {
+    uint64_t total = 0;
+    int remaining = 0, running = 0;
+
+    if (!stripe) {
+        return STRIPE_ERROR_PARAM;
+    }
+
+    platform_mutex_lock(stripe->lock);
+    if (!stripe->sending) {
+        total = stripe->bytes_written;
+    } else {
+        for (int i = 0; i < stripe->lane_count; i++) {
+            const stripe_lane_t *lane = &stripe->lanes[i];
+
+            total += lane->bytes;
+            remaining |= lane->next < lane->end || lane->busy;
+            running |= !lane->done;
+        }
+    }
+    platform_mutex_unlock(stripe->lock);
+
+    if (bytes) {
+        *bytes = total;
+    }
+
+    /* The receiver cannot know whether more lanes are coming */
+    if (!stripe->sending) {
+        return total == stripe->file_size ? STRIPE_SUCCESS : STRIPE_IN_PROGRESS;
+    }
+
+    if (stripe->lane_count == 0 || running) {
+        return STRIPE_IN_PROGRESS;
+    }
+
+    return remaining ? STRIPE_ERROR_NETWORK : STRIPE_SUCCESS;
+}
+
+/* Wait while progress continues */
+int stripe_wait(stripe_t *stripe, int idle_timeout_ms) {
+    uint64_t bytes = 0, last_bytes = 0;
+    uint64_t idle_since = platform_coarse_monotonic_ms();
+
+    for (;;) {
+        int result = stripe_poll(stripe, &bytes);
+        uint64_t now;
+
+        if (result != STRIPE_IN_PROGRESS) {
+            return result;
+        }
+
+        now = platform_coarse_monotonic_ms();
+        if (bytes != last_bytes) {
+            last_bytes = bytes;
+            idle_since = now;
+        } else if (now - idle_since > (uint64_t)idle_timeout_ms) {
+            return STRIPE_ERROR_TIMEOUT;
+        }
+
+        platform_sleep_ms(STRIPE_POLL_MS);
+    }
+}
+
+/* Get per-lane statistics */
+int stripe_get_lanes(stripe_t *stripe, stripe_lane_stats_t *lanes, int max_lanes) {
+    int count;
+
+    if (!stripe || !lanes || max_lanes <= 0) {
+        return 0;
+    }
+
+    platform_mutex_lock(stripe->lock);
+    count = stripe->lane_count < max_lanes ? stripe->lane_count : max_lanes;
+    for (int i = 0; i < count; i++) {
+        const stripe_lane_t *lane = &stripe->lanes[i];
+        uint64_t elapsed = lane->last_ms > lane->start_ms ? lane->last_ms - lane->start_ms : 1;
+
+        lanes[i].bytes = lane->bytes;
+        lanes[i].chunks = lane->chunks;
+        lanes[i].rate = lane->bytes * 1000 / elapsed;
+        lanes[i].steals = lane->steals;
+        lanes[i].active = lane->started && !lane->done;
+        lanes[i].failed = lane->failed;
+    }
+    platform_mutex_unlock(stripe->lock);
+
+    return count;
+}
+
+/* Stop lanes and free the stripe */
+void stripe_destroy(stripe_t *stripe) {
+    if (!stripe) return;
+
+    /* No lane can join once the stripe is off the list */
+    if (stripe->registered) {
+        pthread_mutex_lock(&registry_lock);
+        for (int i = 0; i < STRIPE_MAX_PENDING; i++) {
+            if (registry[i] == stripe) {
+                registry[i] = NULL;
+            }
+        }
+        pthread_mutex_unlock(&registry_lock);
+        stripe->registered = 0;
+    }
+
+    for (int i = 0; i < STRIPE_MAX_LANES; i++) {
+        stripe_lane_t *lane = &stripe->lanes[i];
+
+        if (lane->started) {
+            int done;
+
+            /* Threads blocked in send or receive return once the socket is shut */
+            platform_mutex_lock(stripe->lock);
+            done = lane->done;
+            platform_mutex_unlock(stripe->lock);
+            if (!done) {
+                shutdown(get_connection_socket(lane->conn), SHUT_RDWR);
+            }
+            platform_thread_join(lane->thread);
+            lane->started = 0;
+        }
+
+        if (lane->conn) {
+            close_connection(lane->conn);
+            free(lane->conn);
+            lane->conn = NULL;
+        }
+    }
+
+    if (stripe->lock) {
+        platform_mutex_destroy(stripe->lock);
+    }
+    free(stripe->written);
+    free(stripe);
+}
+
+/* Internal: Allocate common state */
+static stripe_t* create_stripe(int fd, uint64_t file_size, int sending) {
+    stripe_t *stripe = calloc(1, sizeof(stripe_t));
+
+    if (!stripe) {
+        LOG_ERROR("Memory allocation failed");
+        return NULL;
+    }
+
+    stripe->fd = fd;
+    stripe->file_size = file_size;
+    stripe->chunk_count = (file_size + STRIPE_CHUNK_SIZE - 1) / STRIPE_CHUNK_SIZE;
+    stripe->sending = sending;
+    stripe->lock = platform_mutex_create();
+    if (!stripe->lock) {
+        LOG_ERROR("Failed to create stripe lock");
+        free(stripe);
+        return NULL;
+    }
+
+    return stripe;
+}
+
+/* Internal: Connect, authenticate and name the stripe on a new lane */
+static connection_t* open_lane(stripe_t *stripe, const char *host, int port,
+                               const char *password, int index) {
+    unsigned char join[STRIPE_JOIN_SIZE];
+    connection_t *conn = connect_to_host(host, port, password);
+
+    if (!conn) {
+        return NULL;
+    }
+
+    memcpy(join, stripe->id, STRIPE_ID_SIZE);
+    join[STRIPE_ID_SIZE] = (unsigned char)index;
+
+    if (perform_handshake(conn, 0, password) != PROTOCOL_SUCCESS ||
+        send_message(conn, MSG_STRIPE_JOIN, join, sizeof(join)) != PROTOCOL_SUCCESS) {
+        close_connection(conn);
+        free(conn);
+        return NULL;
+    }
+
+    return conn;
+}
+
+/* Internal: Sending lane; claim chunks until none are left anywhere */
+static void* send_lane_main(void *arg) {
+    stripe_lane_t *lane = (stripe_lane_t*)arg;
+    stripe_t *stripe = lane->stripe;
+    unsigned char *buffer = malloc(STRIPE_CHUNK_SIZE);
+    int failed = !buffer;
+
+    while (!failed) {
+        uint64_t chunk, offset;
+        size_t len;
+        int claim = claim_chunk(stripe, lane, &chunk);
+
+        if (claim < 0) {
+            break;
+        }
+
+        /* Another lane may yet fail and leave chunks behind */
+        if (claim == 0) {
+            platform_sleep_ms(STRIPE_IDLE_MS);
+            continue;
+        }
+
+        offset = chunk * STRIPE_CHUNK_SIZE;
+        len = chunk_length(stripe, chunk);
+
+        if (read_full(stripe->fd, buffer, len, offset) != 0 ||
+            send_file_stripe(lane->conn, offset, buffer, len) != PROTOCOL_SUCCESS) {
+            LOG_WARNING("Lane %d failed at offset %lu; others take over its range",
+                        lane->index, (unsigned long)offset);
+
+            /* Hand the chunk back at the front of the range */
+            platform_mutex_lock(stripe->lock);
+            lane->next = chunk;
+            lane->busy = 0;
+            lane->failed = 1;
+            platform_mutex_unlock(stripe->lock);
+            failed = 1;
+            break;
+        }
+
+        platform_mutex_lock(stripe->lock);
+        lane->busy = 0;
+        lane->bytes += len;
+        lane->chunks++;
+        lane->last_ms = platform_coarse_monotonic_ms();
+        platform_mutex_unlock(stripe->lock);
+    }
+
+    /* Lane end: bytes(8), so the receiver knows nothing more follows */
+    if (!failed) {
+        uint64_t bytes_be = htobe64(lane->bytes);
+
+        if (send_message(lane->conn, MSG_FILE_END, (const unsigned char*)&bytes_be,
+                         sizeof(bytes_be)) != PROTOCOL_SUCCESS) {
+            LOG_DEBUG("Lane %d end not sent", lane->index);
+        } else {
+            linger_lane(lane, buffer);
+        }
+    }
+
+    platform_mutex_lock(stripe->lock);
+    lane->failed |= failed;
+    lane->done = 1;
+    platform_mutex_unlock(stripe->lock);
+
+    free(buffer);
+    return NULL;
+}
+
+/* Internal: Receiving lane; write chunks until the lane ends */
+static void* receive_lane_main(void *arg) {
+    stripe_lane_t *lane = (stripe_lane_t*)arg;
+    stripe_t *stripe = lane->stripe;
+    unsigned char *buffer = malloc(STRIPE_RECV_BUFFER);
+    int sockfd = get_connection_socket(lane->conn);
+    int failed = !buffer;
+
+    while (!failed) {
+        message_type_t msg_type;
+        size_t payload_len = STRIPE_RECV_BUFFER;
+        int result = receive_message(lane->conn, &msg_type, buffer, &payload_len);
+
+        if (result == PROTOCOL_IN_PROGRESS) {
+            if (wait_for_socket(sockfd, -1, 1, 0) < 0) {
+                failed = 1;
+            }
+            continue;
+        }
+
+        if (result != PROTOCOL_SUCCESS) {
+            failed = 1;
+        } else if (msg_type == MSG_FILE_STRIPE) {
+            failed = write_chunk(stripe, lane, buffer, payload_len) != STRIPE_SUCCESS;
+        } else if (msg_type == MSG_FILE_END) {
+            /* Half-close: tells the sender every byte of the lane was read */
+            shutdown(sockfd, SHUT_WR);
+            break;
+        } else if (msg_type != MSG_KEEPALIVE) {
+            LOG_WARNING("Unexpected message type 0x%02x on lane %d", msg_type, lane->index);
+            failed = 1;
+        }
+    }
+
+    platform_mutex_lock(stripe->lock);
+    lane->failed = failed;
+    lane->done = 1;
+    platform_mutex_unlock(stripe->lock);
+
+    free(buffer);
+    return NULL;
+}
+
+/* Internal: After a lane's end, wait for the receiver to half-close.
+ * Closing with its bytes (a late session ticket, say) still unread would
+ * reset the connection and discard lane data it has not read yet */
+static void linger_lane(stripe_lane_t *lane, unsigned char *buffer) {
+    uint64_t deadline = platform_coarse_monotonic_ms() + STRIPE_LINGER_MS;
+
+    shutdown(get_connection_socket(lane->conn), SHUT_WR);
+    for (;;) {
+        message_type_t msg_type;
+        size_t payload_len = STRIPE_CHUNK_SIZE;
+        int result = receive_message(lane->conn, &msg_type, buffer, &payload_len);
+        uint64_t now = platform_coarse_monotonic_ms();
+
+        if (result == PROTOCOL_SUCCESS) {
+            continue;
+        }
+        if (result != PROTOCOL_IN_PROGRESS || now >= deadline ||
+            wait_for_connection(lane->conn, (int)(deadline - now), 1, 0) <= 0) {
+            break;
+        }
+    }
+}
+
+/* Internal: Take the next chunk of the lane's range, stealing when empty.
+ * Returns 1 with a chunk, 0 if busy lanes may still hand work back, -1
+ * when nothing is left */
+static int claim_chunk(stripe_t *stripe, stripe_lane_t *lane, uint64_t *chunk) {
+    int result = -1;
+
+    platform_mutex_lock(stripe->lock);
+
+    if (lane->next >= lane->end) {
+        steal_range_locked(stripe, lane);
+    }
+
+    if (lane->next < lane->end) {
+        *chunk = lane->next++;
+        lane->busy = 1;
+        result = 1;
+    } else {
+        for (int i = 0; i < stripe->lane_count; i++) {
+            if (stripe->lanes[i].busy) {
+                result = 0;
+                break;
+            }
+        }
+    }
+
+    platform_mutex_unlock(stripe->lock);
+    return result;
+}
+
+/* Internal: Move the back half of the largest range left to an idle
+ * lane; a failed lane's range moves whole */
+static void steal_range_locked(stripe_t *stripe, stripe_lane_t *thief) {
+    stripe_lane_t *victim = NULL;
+    uint64_t most = 0, take;
+
+    for (int i = 0; i < stripe->lane_count; i++) {
+        stripe_lane_t *lane = &stripe->lanes[i];
+
+        if (lane != thief && lane->end - lane->next > most) {
+            most = lane->end - lane->next;
+            victim = lane;
+        }
+    }
+
+    if (!victim) {
+        return;
+    }
+
+    take = victim->failed ? most : (most + 1) / 2;
+    thief->next = victim->end - take;
+    thief->end = victim->end;
+    victim->end -= take;
+    thief->steals++;
+}
+
+/* Internal: Write one received chunk at its offset */
+static int write_chunk(stripe_t *stripe, stripe_lane_t *lane,
+                       const unsigned char *payload, size_t payload_len) {
+    const unsigned char *data;
+    uint64_t offset, chunk;
+    size_t len;
+    uint8_t bit;
+    int fresh;
+
+    if (parse_file_stripe(payload, payload_len, &offset, &data, &len) != PROTOCOL_SUCCESS) {
+        return STRIPE_ERROR_PROTOCOL;
+    }
+
+    chunk = offset / STRIPE_CHUNK_SIZE;
+    if (offset % STRIPE_CHUNK_SIZE != 0 || chunk >= stripe->chunk_count ||
+        len != chunk_length(stripe, chunk)) {
+        LOG_ERROR("Stripe chunk at offset %lu does not fit the file", (unsigned long)offset);
+        return STRIPE_ERROR_PROTOCOL;
+    }
+
+    /* A chunk resent after a lane failed may already be here */
+    bit = (uint8_t)(1u << (chunk % 8));
+    platform_mutex_lock(stripe->lock);
+    fresh = !(stripe->written[chunk / 8] & bit);
+    platform_mutex_unlock(stripe->lock);
+
+    if (fresh && write_full(stripe->fd, data, len, offset) != 0) {
+        LOG_ERROR("Error writing to file: %s", strerror(errno));
+        return STRIPE_ERROR_IO;
+    }
+
+    platform_mutex_lock(stripe->lock);
+    if (!(stripe->written[chunk / 8] & bit)) {
+        stripe->written[chunk / 8] |= bit;
+        stripe->bytes_written += len;
+    }
+    lane->bytes += len;
+    lane->chunks++;
+    lane->last_ms = platform_coarse_monotonic_ms();
+    platform_mutex_unlock(stripe->lock);
+
+    return STRIPE_SUCCESS;
+}
+
+/* Internal: Size of a chunk; only the last may be short */
+static size_t chunk_length(const stripe_t *stripe, uint64_t chunk) {
+    uint64_t offset = chunk * STRIPE_CHUNK_SIZE;
+
+    return stripe->file_size - offset < STRIPE_CHUNK_SIZE ?
+           (size_t)(stripe->file_size - offset) : STRIPE_CHUNK_SIZE;
+}
+
+/* Internal: pread() exactly len bytes */
+static int read_full(int fd, unsigned char *buffer, size_t len, uint64_t offset) {
+    while (len > 0) {
+        ssize_t n = pread(fd, buffer, len, (off_t)offset);
+
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) {
+            LOG_ERROR("Error reading file at offset %lu: %s", (unsigned long)offset,
+                      n == 0 ? "file shrank" : strerror(errno));
+            return -1;
+        }
+        buffer += n;
+        offset += (uint64_t)n;
+        len -= (size_t)n;
+    }
+
+    return 0;
+}
+
+/* Internal: pwrite() exactly len bytes */
+static int write_full(int fd, const unsigned char *data, size_t len, uint64_t offset) {
+    while (len > 0) {
+        ssize_t n = pwrite(fd, data, len, (off_t)offset);
+
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) {
+            return -1;
+        }
+        data += n;
+        offset += (uint64_t)n;
+        len -= (size_t)n;
+    }
+
+    return 0;
+}
+
+/* Get error message */
+const char* stripe_strerror(int error_code) {
+    switch (error_code) {
+        case STRIPE_SUCCESS:
+            return "Success";
+        case STRIPE_IN_PROGRESS:
+            return "In progress";
+        case STRIPE_ERROR_PARAM:
+            return "Invalid parameter";
+        case STRIPE_ERROR_MEMORY:
+            return "Memory allocation failed";
+        case STRIPE_ERROR_NETWORK:
+            return "No lane left to carry the data";
+        case STRIPE_ERROR_IO:
+            return "File I/O error";
+        case STRIPE_ERROR_PROTOCOL:
+            return "Malformed lane message";
+        case STRIPE_ERROR_THREAD:
+            return "Failed to start lane thread";
+        case STRIPE_ERROR_TIMEOUT:
+            return "Lanes stopped making progress";
+        case STRIPE_ERROR_UNKNOWN:
+            return "No transfer expects this stripe";
+        default:
+            return "Unknown error";
+    }
+}
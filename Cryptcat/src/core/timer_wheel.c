@@ -0,0 +1,338 @@
+/*
+ * Cryptcat Timer Wheel
+ * Hierarchical timing wheel for connection timeouts
+ * Version: 1.0.0
+ * License: MIT
+ */
+
+#include "timer_wheel.h"
+#include "utils/logger.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Wheel constants */
+#define SLOTS (1u << TIMER_WHEEL_SLOT_BITS)
+#define SLOT_MASK (SLOTS - 1)
+#define TOTAL_SLOTS (TIMER_WHEEL_LEVELS * SLOTS)
+#define MAX_DELTA ((1ull << (TIMER_WHEEL_LEVELS * TIMER_WHEEL_SLOT_BITS)) - 1)
+#define NIL UINT32_MAX
+#define INITIAL_NODES 1024
+
+/* One timer, linked into a slot by index so the table can grow */
+typedef struct {
+    uint32_t next;
+    uint32_t prev;
+    uint64_t expires;               /* Tick */
+    int32_t slot;                   /* level * SLOTS + index, -1 when disarmed */
+} timer_node_t;
+
+/* Wheel state */
+struct timer_wheel_s {
+    uint32_t tick_ms;
+    uint64_t origin_ms;             /* Time of tick 0 */
+    uint64_t current;               /* Next tick to process; earlier ones have fired */
+    int firing;                     /* Inside timer_wheel_advance() callbacks */
+    uint32_t count;
+    uint32_t level_count[TIMER_WHEEL_LEVELS];
+    uint32_t heads[TOTAL_SLOTS];
+    timer_node_t *nodes;
+    uint32_t nodes_cap;
+};
+
+/* Internal function prototypes */
+static int ensure_node(timer_wheel_t *wheel, uint32_t id);
+static void link_node(timer_wheel_t *wheel, uint32_t id);
+static void unlink_node(timer_wheel_t *wheel, uint32_t id);
+static void cascade(timer_wheel_t *wheel);
+static int cascade_pending(const timer_wheel_t *wheel);
+
+/* Create a wheel */
+timer_wheel_t* timer_wheel_create(uint32_t tick_ms, uint64_t now_ms) {
+    timer_wheel_t *wheel;
+
+    if (tick_ms == 0) {
+        return NULL;
+    }
+
+    wheel = calloc(1, sizeof(timer_wheel_t));
+    if (!wheel) {
+        LOG_ERROR("Memory allocation failed");
+        return NULL;
+    }
+
+    wheel->tick_ms = tick_ms;
+    wheel->origin_ms = now_ms;
+    for (uint32_t i = 0; i < TOTAL_SLOTS; i++) {
+        wheel->heads[i] = NIL;
+    }
+
+    return wheel;
+}
+
+/* Destroy a wheel */
+void timer_wheel_destroy(timer_wheel_t *wheel) {
+    if (!wheel) return;
+
+    free(wheel->nodes);
+    free(wheel);
+}
+
+/* Arm or re-arm a timer */
+int timer_wheel_schedule(timer_wheel_t *wheel, uint32_t id, uint64_t expires_ms) {
+    uint64_t expires, delta_ms;
+
+    if (!wheel || id == NIL) {
+        return TIMER_WHEEL_ERROR_PARAM;
+    }
+
+    if (ensure_node(wheel, id) != TIMER_WHEEL_SUCCESS) {
+        return TIMER_WHEEL_ERROR_MEMORY;
+    }
+
+    if (wheel->nodes[id].slot >= 0) {
+        unlink_node(wheel, id);
+        wheel->count--;
+    }
+
+    /* Round up so a timer never fires early. Inside a callback the
+     * current tick's slot is being drained, so the earliest is the next */
+    delta_ms = expires_ms > wheel->origin_ms ? expires_ms - wheel->origin_ms : 0;
+    expires = delta_ms / wheel->tick_ms + (delta_ms % wheel->tick_ms != 0);
+    if (expires < wheel->current + (wheel->firing ? 1 : 0)) {
+        expires = wheel->current + (wheel->firing ? 1 : 0);
+    }
+
+    wheel->nodes[id].expires = expires;
+    link_node(wheel, id);
+    wheel->count++;
+
+    return TIMER_WHEEL_SUCCESS;
+}
+
+/* Disarm a timer */
+void timer_wheel_cancel(timer_wheel_t *wheel, uint32_t id) {
+    if (!wheel || id >= wheel->nodes_cap || wheel->nodes[id].slot < 0) {
+        return;
+    }
+
+    unlink_node(wheel, id);
+    wheel->count--;
+}
+
+/* Is a timer armed */
+int timer_wheel_pending(const timer_wheel_t *wheel, uint32_t id) {
+    return wheel && id < wheel->nodes_cap && wheel->nodes[id].slot >= 0;
+}
+
+/* Fire due timers */
+int timer_wheel_advance(timer_wheel_t *wheel, uint64_t now_ms,
+                        timer_wheel_callback_t callback, void *ctx) {
+    uint64_t target;
+    int fired = 0;
+
+    if (!wheel || !callback || now_ms < wheel->origin_ms) {
+        return 0;
+    }
+
+    target = (now_ms - wheel->origin_ms) / wheel->tick_ms;
+
+    while (wheel->current <= target) {
+        uint32_t slot;
+
+        /* Nothing armed: jump straight to now */
+        if (wheel->count == 0) {
+            wheel->current = target + 1;
+            break;
+        }
+
+        /* Level 0 empty: nothing fires before the next cascade */
+        if (wheel->level_count[0] == 0 && (wheel->current & SLOT_MASK) != 0) {
+            uint64_t boundary = (wheel->current | SLOT_MASK) + 1;
+
+            wheel->current = boundary <= target ? boundary : target + 1;
+            continue;
+        }
+
+        if ((wheel->current & SLOT_MASK) == 0) {
+            cascade(wheel);
+        }
+
+        /* Pop one at a time: callbacks may cancel other timers here */
+        slot = (uint32_t)(wheel->current & SLOT_MASK);
+        wheel->firing = 1;
+        while (wheel->heads[slot] != NIL) {
+            uint32_t id = wheel->heads[slot];
+
+            unlink_node(wheel, id);
+            wheel->count--;
+            callback(ctx, id);
+            fired++;
+        }
+        wheel->firing = 0;
+
+        wheel->current++;
+    }
+
+    return fired;
+}
+
+/* Time until the wheel next has work */
+int timer_wheel_next_timeout(const timer_wheel_t *wheel, uint64_t now_ms) {
+    uint64_t due, due_ms;
+    int higher = 0;
+
+    if (!wheel || wheel->count == 0) {
+        return -1;
+    }
+
+    for (int level = 1; level < TIMER_WHEEL_LEVELS; level++) {
+        higher |= wheel->level_count[level] > 0;
+    }
+
+    /* Higher levels cascade at the next wrap of level 0, which may be
+     * the current tick when it sits on a wrap not yet processed */
+    due = UINT64_MAX;
+    if (higher) {
+        due = (wheel->current & SLOT_MASK) == 0 && cascade_pending(wheel)
+                  ? wheel->current
+                  : (wheel->current | SLOT_MASK) + 1;
+    }
+
+    if (wheel->level_count[0] > 0) {
+        for (uint64_t tick = wheel->current; tick < wheel->current + SLOTS && tick < due; tick++) {
+            if (wheel->heads[tick & SLOT_MASK] != NIL) {
+                due = tick;
+                break;
+            }
+        }
+    }
+
+    due_ms = wheel->origin_ms + due * wheel->tick_ms;
+    if (due_ms <= now_ms) {
+        return 0;
+    }
+    return due_ms - now_ms > (uint64_t)INT32_MAX ? INT32_MAX : (int)(due_ms - now_ms);
+}
+
+/* Armed timers */
+uint32_t timer_wheel_count(const timer_wheel_t *wheel) {
+    return wheel ? wheel->count : 0;
+}
+
+/* Internal: Grow the node table to cover id */
+static int ensure_node(timer_wheel_t *wheel, uint32_t id) {
+    uint32_t new_cap;
+    timer_node_t *nodes;
+
+    if (id < wheel->nodes_cap) {
+        return TIMER_WHEEL_SUCCESS;
+    }
+
+    new_cap = wheel->nodes_cap ? wheel->nodes_cap : INITIAL_NODES;
+    while (new_cap <= id) new_cap *= 2;
+
+    nodes = realloc(wheel->nodes, (size_t)new_cap * sizeof(timer_node_t));
+    if (!nodes) {
+        LOG_ERROR("Memory allocation failed");
+        return TIMER_WHEEL_ERROR_MEMORY;
+    }
+
+    for (uint32_t i = wheel->nodes_cap; i < new_cap; i++) {
+        nodes[i].next = nodes[i].prev = NIL;
+        nodes[i].slot = -1;
+    }
+    wheel->nodes = nodes;
+    wheel->nodes_cap = new_cap;
+
+    return TIMER_WHEEL_SUCCESS;
+}
+
+/* Internal: Put a timer in the slot for its distance from now. Beyond
+ * the wheel's span it waits in the top level and is placed again each
+ * time that slot cascades */
+static void link_node(timer_wheel_t *wheel, uint32_t id) {
+    timer_node_t *node = &wheel->nodes[id];
+    uint64_t delta = node->expires - wheel->current;
+    uint64_t expires = node->expires;
+    int level = 0;
+    uint32_t slot;
+
+    if (delta > MAX_DELTA) {
+        delta = MAX_DELTA;
+        expires = wheel->current + MAX_DELTA;
+    }
+
+    while (level < TIMER_WHEEL_LEVELS - 1 &&
+           delta >> (TIMER_WHEEL_SLOT_BITS * (level + 1)) != 0) {
+        level++;
+    }
+
+    slot = (uint32_t)level * SLOTS +
+           (uint32_t)((expires >> (TIMER_WHEEL_SLOT_BITS * level)) & SLOT_MASK);
+
+    node->slot = (int32_t)slot;
+    node->prev = NIL;
+    node->next = wheel->heads[slot];
+    if (node->next != NIL) {
+        wheel->nodes[node->next].prev = id;
+    }
+    wheel->heads[slot] = id;
+    wheel->level_count[level]++;
+}
+
+/* Internal: Take a timer out of its slot */
+static void unlink_node(timer_wheel_t *wheel, uint32_t id) {
+    timer_node_t *node = &wheel->nodes[id];
+
+    if (node->prev != NIL) {
+        wheel->nodes[node->prev].next = node->next;
+    } else {
+        wheel->heads[node->slot] = node->next;
+    }
+    if (node->next != NIL) {
+        wheel->nodes[node->next].prev = node->prev;
+    }
+
+    wheel->level_count[node->slot / SLOTS]--;
+    node->next = node->prev = NIL;
+    node->slot = -1;
+}
+
+/* Internal: Whether cascade() at the current tick has timers to move */
+static int cascade_pending(const timer_wheel_t *wheel) {
+    for (int level = 1; level < TIMER_WHEEL_LEVELS; level++) {
+        uint32_t index = (uint32_t)((wheel->current >> (TIMER_WHEEL_SLOT_BITS * level)) & SLOT_MASK);
+
+        if (wheel->heads[(uint32_t)level * SLOTS + index] != NIL) {
+            return 1;
+        }
+        if (index != 0) {
+            break;
+        }
+    }
+
+    return 0;
+}
+
+/* Internal: Level 0 wrapped; redistribute the next slot of each level
+ * above it that wrapped too */
+static void cascade(timer_wheel_t *wheel) {
+    for (int level = 1; level < TIMER_WHEEL_LEVELS; level++) {
+        uint32_t index = (uint32_t)((wheel->current >> (TIMER_WHEEL_SLOT_BITS * level)) & SLOT_MASK);
+        uint32_t slot = (uint32_t)level * SLOTS + index;
+        uint32_t id = wheel->heads[slot];
+
+        while (id != NIL) {
+            uint32_t next = wheel->nodes[id].next;
+
+            unlink_node(wheel, id);
+            link_node(wheel, id);
+            id = next;
+        }
+
+        if (index != 0) {
+            break;
+        }
+    }
+}
@@ -0,0 +1,330 @@
+/*
+ * Cryptcat io_uring I/O
+ * Backend probe and read-ahead file reader on registered buffers
+ * Version: 1.0.0
+ * License: MIT
+ */
+
+#include "uring_io.h"
+#include "utils/logger.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#ifdef HAVE_LIBURING
+#include <liburing.h>
+#include <sys/uio.h>
+#endif
+
+/* Reader constants */
+#define MAX_READ_DEPTH 64
+
+#ifdef HAVE_LIBURING
+
+/* One registered buffer and the read that fills it */
+typedef struct {
+    uint64_t offset;                /* File offset of this chunk */
+    size_t length;                  /* Bytes the chunk should hold */
+    size_t filled;                  /* Bytes read so far */
+    int result;                     /* Bytes read, or -errno */
+    int in_flight;
+    int done;
+} read_slot_t;
+
+/* Read-ahead reader state */
+struct uring_file_reader_s {
+    struct io_uring ring;
+    int fd;
+    uint64_t file_size;
+    uint64_t next_read;             /* Offset of the next read to submit */
+    size_t chunk_size;
+    unsigned depth;
+    unsigned head;                  /* Slot holding the next chunk in order */
+    int head_held;                  /* Caller still owns the head slot */
+    unsigned char *buffers;         /* depth * chunk_size, registered */
+    read_slot_t slots[MAX_READ_DEPTH];
+};
+
+/* Internal function prototypes */
+static int submit_read(uring_file_reader_t *reader, unsigned slot);
+static int queue_read(uring_file_reader_t *reader, unsigned slot);
+static int reap_until_done(uring_file_reader_t *reader, unsigned slot);
+
+/* Probe io_uring once */
+int uring_io_available(void) {
+    static int available = -1;
+    const char *forced = getenv("CRYPTCAT_IO_BACKEND");
+    struct io_uring ring;
+
+    if (forced && strcmp(forced, "epoll") == 0) {
+        return 0;
+    }
+
+    if (available < 0) {
+        int ret = io_uring_queue_init(4, &ring, 0);
+        available = ret == 0;
+        if (available) {
+            io_uring_queue_exit(&ring);
+        } else {
+            LOG_INFO("io_uring unavailable (%s), using epoll", strerror(-ret));
+        }
+    }
+
+    return available;
+}
+
+/* Create a read-ahead reader */
+uring_file_reader_t* uring_file_reader_create(int fd, uint64_t offset, uint64_t file_size,
+                                              size_t chunk_size, unsigned depth) {
+    uring_file_reader_t *reader;
+    struct iovec iov[MAX_READ_DEPTH];
+
+    if (fd < 0 || chunk_size == 0 || depth == 0 || !uring_io_available()) {
+        return NULL;
+    }
+
+    if (depth > MAX_READ_DEPTH) {
+        depth = MAX_READ_DEPTH;
+    }
+
+    reader = calloc(1, sizeof(uring_file_reader_t));
+    if (!reader) {
+        return NULL;
+    }
+
+    reader->buffers = malloc(chunk_size * depth);
+    if (!reader->buffers || io_uring_queue_init(depth, &reader->ring, 0) < 0) {
+        free(reader->buffers);
+        free(reader);
+        return NULL;
+    }
+
+    /* Pin the read buffers once instead of mapping them on every read */
+    for (unsigned i = 0; i < depth; i++) {
+        iov[i].iov_base = reader->buffers + i * chunk_size;
+        iov[i].iov_len = chunk_size;
+    }
+
+    if (io_uring_register_buffers(&reader->ring, iov, depth) < 0) {
+        LOG_DEBUG("io_uring buffer registration refused");
+        io_uring_queue_exit(&reader->ring);
+        free(reader->buffers);
+        free(reader);
+        return NULL;
+    }
+
+    reader->fd = fd;
+    reader->file_size = file_size;
+    reader->next_read = offset;
+    reader->chunk_size = chunk_size;
+    reader->depth = depth;
+
+    /* Fill the pipeline; one submission covers every slot */
+    for (unsigned i = 0; i < depth; i++) {
+        if (submit_read(reader, i) < 0) break;
+    }
+    io_uring_submit(&reader->ring);
+
+    return reader;
+}
+
+/* Get the next chunk in file order */
+int uring_file_reader_next(uring_file_reader_t *reader,
+                           const unsigned char **data, size_t *len) {
+    read_slot_t *slot;
+    int result;
+
+    if (!reader || !data || !len) {
+        return URING_IO_ERROR_PARAM;
+    }
+
+    /* Recycle the chunk handed out last time for a further read-ahead */
+    if (reader->head_held) {
+        unsigned prev = reader->head;
+
+        reader->head_held = 0;
+        reader->head = (reader->head + 1) % reader->depth;
+        if (submit_read(reader, prev) == 0) {
+            io_uring_submit(&reader->ring);
+        }
+    }
+
+    slot = &reader->slots[reader->head];
+    if (!slot->in_flight && !slot->done) {
+        return URING_IO_EOF;
+    }
+
+    result = reap_until_done(reader, reader->head);
+    if (result != URING_IO_SUCCESS) {
+        return result;
+    }
+
+    if (slot->result < 0) {
+        LOG_ERROR("File read failed: %s", strerror(-slot->result));
+        return URING_IO_ERROR_IO;
+    }
+
+    if (slot->result == 0) {
+        return URING_IO_EOF;
+    }
+
+    *data = reader->buffers + (size_t)reader->head * reader->chunk_size;
+    *len = (size_t)slot->result;
+    slot->done = 0;
+    reader->head_held = 1;
+
+    return URING_IO_SUCCESS;
+}
+
+/* Destroy a reader */
+void uring_file_reader_destroy(uring_file_reader_t *reader) {
+    if (!reader) return;
+
+    /* The kernel may still be writing into the registered buffers */
+    for (unsigned i = 0; i < reader->depth; i++) {
+        if (reader->slots[i].in_flight) {
+            reap_until_done(reader, i);
+        }
+    }
+
+    io_uring_unregister_buffers(&reader->ring);
+    io_uring_queue_exit(&reader->ring);
+    free(reader->buffers);
+    free(reader);
+}
+
+/* Internal: Queue the read for the next file offset into a slot */
+static int submit_read(uring_file_reader_t *reader, unsigned slot) {
+    read_slot_t *s = &reader->slots[slot];
+    size_t want;
+
+    if (reader->next_read >= reader->file_size) {
+        return -1;
+    }
+
+    want = reader->chunk_size;
+    if (reader->file_size - reader->next_read < want) {
+        want = (size_t)(reader->file_size - reader->next_read);
+    }
+
+    s->offset = reader->next_read;
+    s->length = want;
+    s->filled = 0;
+    s->done = 0;
+    if (queue_read(reader, slot) < 0) {
+        return -1;
+    }
+    reader->next_read += want;
+
+    return 0;
+}
+
+/* Internal: Queue a read for the part of a slot's chunk not yet filled */
+static int queue_read(uring_file_reader_t *reader, unsigned slot) {
+    read_slot_t *s = &reader->slots[slot];
+    struct io_uring_sqe *sqe = io_uring_get_sqe(&reader->ring);
+
+    if (!sqe) {
+        return -1;
+    }
+
+    io_uring_prep_read_fixed(sqe, reader->fd,
+                             reader->buffers + (size_t)slot * reader->chunk_size + s->filled,
+                             (unsigned)(s->length - s->filled), s->offset + s->filled,
+                             (int)slot);
+    io_uring_sqe_set_data64(sqe, slot);
+    s->in_flight = 1;
+
+    return 0;
+}
+
+/* Internal: Collect completions until the given slot has finished */
+static int reap_until_done(uring_file_reader_t *reader, unsigned slot) {
+    while (!reader->slots[slot].done) {
+        struct io_uring_cqe *cqe;
+        int ret = io_uring_wait_cqe(&reader->ring, &cqe);
+
+        if (ret == -EINTR) continue;
+        if (ret < 0) {
+            LOG_ERROR("io_uring_wait_cqe failed: %s", strerror(-ret));
+            return URING_IO_ERROR_IO;
+        }
+
+        /* Completions arrive in any order; park them in their slot */
+        unsigned index = (unsigned)io_uring_cqe_get_data64(cqe);
+        read_slot_t *done = &reader->slots[index];
+        int res = cqe->res;
+        io_uring_cqe_seen(&reader->ring, cqe);
+
+        /* A short read leaves a hole in the chunk; read the rest before
+         * it is handed out. Only EOF ends a chunk early */
+        if (res > 0) {
+            done->filled += (size_t)res;
+            if (done->filled < done->length) {
+                if (queue_read(reader, index) == 0) {
+                    io_uring_submit(&reader->ring);
+                    continue;
+                }
+                res = -EBUSY;
+            }
+        }
+
+        done->result = res < 0 ? res : (int)done->filled;
+        done->in_flight = 0;
+        done->done = 1;
+    }
+
+    return URING_IO_SUCCESS;
+}
+
+#else /* !HAVE_LIBURING */
+
+/* Built without liburing: callers take their synchronous paths */
+int uring_io_available(void) {
+    return 0;
+}
+
+uring_file_reader_t* uring_file_reader_create(int fd, uint64_t offset, uint64_t file_size,
+                                              size_t chunk_size, unsigned depth) {
+    (void)fd;
+    (void)offset;
+    (void)file_size;
+    (void)chunk_size;
+    (void)depth;
+    return NULL;
+}
+
+int uring_file_reader_next(uring_file_reader_t *reader,
+                           const unsigned char **data, size_t *len) {
+    (void)reader;
+    (void)data;
+    (void)len;
+    return URING_IO_ERROR_UNSUPPORTED;
+}
+
+void uring_file_reader_destroy(uring_file_reader_t *reader) {
+    (void)reader;
+}
+
+#endif /* HAVE_LIBURING */
+
+/* Get error message */
+const char* uring_io_strerror(int error_code) {
+    switch (error_code) {
+        case URING_IO_SUCCESS:
+            return "Success";
+        case URING_IO_ERROR_PARAM:
+            return "Invalid parameter";
+        case URING_IO_ERROR_MEMORY:
+            return "Memory allocation failed";
+        case URING_IO_ERROR_UNSUPPORTED:
+            return "io_uring not supported";
+        case URING_IO_ERROR_IO:
+            return "I/O error";
+        case URING_IO_EOF:
+            return "End of file";
+        default:
+            return "Unknown error";
+    }
+}
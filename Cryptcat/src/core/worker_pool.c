@@ -0,0 +1,572 @@
+/*
+ * Cryptcat Worker Pool
+ * One SO_REUSEPORT listener and event loop per worker thread, optionally
+ * pinned to a CPU with BPF steering of new connections
+ * Version: 1.0.0
+ * License: MIT
+ */
+
+#include "worker_pool.h"
+#include "event_loop.h"
+#include "network.h"
+#include "platform.h"
+#include "utils/logger.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdatomic.h>
+
+#ifdef __linux__
+#include <sys/socket.h>
+#include <linux/filter.h>
+#endif
+
+/* Pool constants */
+#define STATS_PUBLISH_MS 250        /* Longest wait between stats snapshots */
+
+/* One worker: listener, loop and thread */
+typedef struct {
+    worker_pool_t *pool;
+    int index;
+    int cpu;                        /* Pinned CPU, -1 if unpinned */
+    event_loop_t *loop;
+    connection_t *listener;         /* Owned by the loop until handed off */
+    platform_thread_t thread;
+    int running;                    /* Thread started and not yet joined */
+    int result;                     /* Last run_once error, 0 if none */
+    platform_mutex_t stats_lock;
+    event_loop_stats_t stats;       /* Published by the worker thread */
+} worker_t;
+
+/* Pool state */
+struct worker_pool_s {
+    worker_t *workers;
+    int count;
+    atomic_int stopping;
+};
+
+/* State of worker_pool_hand_off() */
+typedef struct {
+    int channel_fd;
+    int timeout_ms;
+    int passed;
+    int failed;
+} hand_off_t;
+
+/* Internal function prototypes */
+static worker_pool_t* create_workers(int count, const char *password,
+                                     const event_loop_callbacks_t *callbacks,
+                                     const worker_pool_options_t *options);
+static int add_listener(worker_t *worker, connection_t *listener);
+static worker_pool_t* adopt_listeners(connection_t **listeners, int count,
+                                      const char *password,
+                                      const event_loop_callbacks_t *callbacks,
+                                      const worker_pool_options_t *options);
+static void hand_off_session(event_loop_t *loop, connection_t *conn, void *ctx);
+static void* worker_main(void *arg);
+static void publish_stats(worker_t *worker);
+static int attach_cpu_steering(connection_t *listener, int workers);
+
+/* Create a worker pool */
+worker_pool_t* worker_pool_create(int port, const char *password,
+                                  const event_loop_callbacks_t *callbacks,
+                                  const worker_pool_options_t *options) {
+    worker_pool_options_t defaults = {0};
+    worker_pool_t *pool;
+    int num_cpus = platform_get_system_info().num_cpus;
+
+    if (!password || !callbacks) {
+        LOG_ERROR("Invalid worker pool parameters");
+        return NULL;
+    }
+
+    if (!options) {
+        options = &defaults;
+    }
+
+    pool = create_workers(options->workers > 0 ? options->workers : num_cpus,
+                          password, callbacks, options);
+    if (!pool) {
+        return NULL;
+    }
+
+    for (int i = 0; i < pool->count; i++) {
+        connection_t *listener;
+
+        /* Listeners join one reuseport group in index order, which is the
+         * socket index the steering program returns */
+        listener = create_listener(port, password);
+        if (!listener) {
+            LOG_ERROR("Worker %d could not bind port %d%s", i, port,
+                      i > 0 ? " (SO_REUSEPORT unavailable?)" : "");
+            worker_pool_destroy(pool);
+            return NULL;
+        }
+
+        if (add_listener(&pool->workers[i], listener) != WORKER_POOL_SUCCESS) {
+            worker_pool_destroy(pool);
+            return NULL;
+        }
+
+        /* Steering is a group-wide program; attaching it once is enough */
+        if (options->cpu_steering && i == pool->count - 1 &&
+            attach_cpu_steering(listener, pool->count) != WORKER_POOL_SUCCESS) {
+            LOG_WARNING("CPU steering unavailable, using the kernel's hash balancing");
+        }
+    }
+
+    LOG_INFO("Worker pool created: %d workers on port %d%s", pool->count, port,
+             options->pin_cpus ? " (pinned)" : "");
+    return pool;
+}
+
+/* Build a pool from a predecessor's listeners and sessions */
+worker_pool_t* worker_pool_take_over(int channel_fd, const char *password,
+                                     const event_loop_callbacks_t *callbacks,
+                                     const worker_pool_options_t *options,
+                                     int timeout_ms) {
+    worker_pool_options_t defaults = {0};
+    connection_t *listeners[WORKER_POOL_MAX_WORKERS];
+    connection_t *conn;
+    worker_pool_t *pool = NULL;
+    int count = 0, sessions = 0, failed = 0, next = 0;
+
+    if (channel_fd < 0 || !password || !callbacks) {
+        LOG_ERROR("Invalid worker pool parameters");
+        return NULL;
+    }
+
+    if (!options) {
+        options = &defaults;
+    }
+
+    /* Listeners come first, one per worker of the old pool; sessions
+     * follow until the predecessor closes the channel */
+    while ((conn = accept_passed_connection(channel_fd, timeout_ms)) != NULL) {
+        int result;
+
+        if (get_connection_info(conn).is_listening) {
+            if (pool || count == WORKER_POOL_MAX_WORKERS) {
+                LOG_WARNING("Unexpected listener in handoff, closing it");
+                close_connection(conn);
+                free(conn);
+            } else {
+                listeners[count++] = conn;
+            }
+            continue;
+        }
+
+        if (!pool) {
+            pool = adopt_listeners(listeners, count, password, callbacks, options);
+            count = 0;
+            if (!pool) {
+                close_connection(conn);
+                free(conn);
+                break;
+            }
+        }
+
+        /* Sessions are dealt out in turn; the kernel no longer decides */
+        result = event_loop_adopt_connection(pool->workers[next++ % pool->count].loop, conn);
+        if (result != EVENT_LOOP_SUCCESS) {
+            LOG_WARNING("Could not take over a session: %s", event_loop_strerror(result));
+            close_connection(conn);
+            free(conn);
+            failed++;
+        } else {
+            sessions++;
+        }
+    }
+
+    /* No session was handed over */
+    if (!pool) {
+        pool = adopt_listeners(listeners, count, password, callbacks, options);
+    }
+
+    if (!pool) {
+        LOG_ERROR("No listeners were handed over");
+        return NULL;
+    }
+
+    LOG_INFO("Worker pool took over %d listeners and %d sessions (%d failed)",
+             pool->count, sessions, failed);
+    return pool;
+}
+
+/* Start every worker thread */
+int worker_pool_start(worker_pool_t *pool) {
+    if (!pool) {
+        return WORKER_POOL_ERROR_PARAM;
+    }
+
+    for (int i = 0; i < pool->count; i++) {
+        worker_t *worker = &pool->workers[i];
+
+        worker->thread = platform_thread_create(worker_main, worker);
+        if (!worker->thread) {
+            LOG_ERROR("Failed to start worker %d", i);
+            worker_pool_stop(pool);
+            worker_pool_wait(pool);
+            return WORKER_POOL_ERROR_SYSTEM;
+        }
+        worker->running = 1;
+
+        if (worker->cpu >= 0 &&
+            platform_thread_set_affinity(worker->thread, worker->cpu) != PLATFORM_SUCCESS) {
+            LOG_WARNING("Could not pin worker %d to CPU %d", i, worker->cpu);
+            worker->cpu = -1;
+        }
+    }
+
+    return WORKER_POOL_SUCCESS;
+}
+
+/* Ask every worker to return (async-signal-safe) */
+void worker_pool_stop(worker_pool_t *pool) {
+    if (!pool) return;
+
+    atomic_store(&pool->stopping, 1);
+    for (int i = 0; i < pool->count; i++) {
+        event_loop_stop(pool->workers[i].loop);
+    }
+}
+
+/* Join every worker thread */
+int worker_pool_wait(worker_pool_t *pool) {
+    int result = WORKER_POOL_SUCCESS;
+
+    if (!pool) {
+        return WORKER_POOL_ERROR_PARAM;
+    }
+
+    for (int i = 0; i < pool->count; i++) {
+        worker_t *worker = &pool->workers[i];
+
+        if (!worker->running) continue;
+
+        platform_thread_join(worker->thread);
+        worker->running = 0;
+        if (worker->result != 0) {
+            result = WORKER_POOL_ERROR_SYSTEM;
+        }
+    }
+
+    return result;
+}
+
+/* Hand listeners and sessions to a successor process */
+int worker_pool_hand_off(worker_pool_t *pool, int channel_fd, int timeout_ms) {
+    hand_off_t handoff = { channel_fd, timeout_ms, 0, 0 };
+    int listeners = 0;
+
+    if (!pool || channel_fd < 0) {
+        return WORKER_POOL_ERROR_PARAM;
+    }
+
+    /* The loops are driven from this thread from here on */
+    for (int i = 0; i < pool->count; i++) {
+        if (pool->workers[i].running) {
+            return WORKER_POOL_ERROR_PARAM;
+        }
+    }
+
+    /* Listeners first. They are never closed, so clients arriving during
+     * the handoff wait in the accept queue for the successor's workers */
+    for (int i = 0; i < pool->count; i++) {
+        worker_t *worker = &pool->workers[i];
+        connection_t *listener = worker->listener;
+        int result;
+
+        if (!listener) continue;
+
+        result = event_loop_detach_connection(worker->loop, listener, timeout_ms);
+        if (result == EVENT_LOOP_ERROR_PARAM) continue;
+        worker->listener = NULL;
+        if (result != EVENT_LOOP_SUCCESS) {
+            return WORKER_POOL_ERROR_SYSTEM;
+        }
+
+        result = pass_connection(channel_fd, listener, timeout_ms);
+        if (result != NETWORK_SUCCESS) {
+            LOG_ERROR("Failed to hand over worker %d's listener: %s", i,
+                      network_strerror(result));
+            close_connection(listener);
+            free(listener);
+            return WORKER_POOL_ERROR_SYSTEM;
+        }
+        free(listener);
+        listeners++;
+    }
+
+    /* Then every established session; handshakes still running are
+     * closed with the pool and their clients connect again */
+    for (int i = 0; i < pool->count; i++) {
+        event_loop_for_each(pool->workers[i].loop, hand_off_session, &handoff);
+    }
+
+    LOG_INFO("Handed over %d listeners and %d sessions (%d failed)",
+             listeners, handoff.passed, handoff.failed);
+    return handoff.passed;
+}
+
+/* Destroy a pool */
+void worker_pool_destroy(worker_pool_t *pool) {
+    if (!pool) return;
+
+    for (int i = 0; i < pool->count && pool->workers; i++) {
+        worker_t *worker = &pool->workers[i];
+
+        event_loop_destroy(worker->loop);
+        if (worker->stats_lock) {
+            platform_mutex_destroy(worker->stats_lock);
+        }
+    }
+
+    free(pool->workers);
+    free(pool);
+}
+
+/* Get worker count */
+int worker_pool_size(const worker_pool_t *pool) {
+    return pool ? pool->count : 0;
+}
+
+/* Get one worker's load */
+int worker_pool_get_worker_stats(worker_pool_t *pool, int index, worker_stats_t *stats) {
+    worker_t *worker;
+
+    if (!pool || !stats || index < 0 || index >= pool->count) {
+        return WORKER_POOL_ERROR_PARAM;
+    }
+
+    worker = &pool->workers[index];
+
+    /* Joined workers no longer publish; read the loop directly */
+    if (!worker->running) {
+        publish_stats(worker);
+    }
+
+    platform_mutex_lock(worker->stats_lock);
+    stats->loop = worker->stats;
+    platform_mutex_unlock(worker->stats_lock);
+    stats->cpu = worker->cpu;
+
+    return WORKER_POOL_SUCCESS;
+}
+
+/* Sum statistics over every worker */
+event_loop_stats_t worker_pool_get_stats(worker_pool_t *pool) {
+    event_loop_stats_t total = {0};
+    worker_stats_t stats;
+
+    for (int i = 0; pool && i < pool->count; i++) {
+        if (worker_pool_get_worker_stats(pool, i, &stats) != WORKER_POOL_SUCCESS) {
+            continue;
+        }
+
+        total.connections += stats.loop.connections;
+        total.peak_connections += stats.loop.peak_connections;
+        total.handshaking += stats.loop.handshaking;
+        total.established += stats.loop.established;
+        total.accepted += stats.loop.accepted;
+        total.rejected += stats.loop.rejected;
+        total.handshakes_completed += stats.loop.handshakes_completed;
+        total.handshakes_failed += stats.loop.handshakes_failed;
+        total.messages += stats.loop.messages;
+        total.wakeups += stats.loop.wakeups;
+        total.events += stats.loop.events;
+        total.sends += stats.loop.sends;
+        total.send_batches += stats.loop.send_batches;
+        total.send_stalls += stats.loop.send_stalls;
+        total.idle_evictions += stats.loop.idle_evictions;
+        total.keepalives_sent += stats.loop.keepalives_sent;
+        total.adopted += stats.loop.adopted;
+        total.detached += stats.loop.detached;
+    }
+
+    return total;
+}
+
+/* Internal: Allocate a pool of workers with event loops but no listeners */
+static worker_pool_t* create_workers(int count, const char *password,
+                                     const event_loop_callbacks_t *callbacks,
+                                     const worker_pool_options_t *options) {
+    worker_pool_t *pool;
+    int num_cpus = platform_get_system_info().num_cpus;
+
+    if (num_cpus < 1) {
+        num_cpus = 1;
+    }
+
+    pool = calloc(1, sizeof(worker_pool_t));
+    if (!pool) {
+        LOG_ERROR("Memory allocation failed");
+        return NULL;
+    }
+
+    pool->count = count > 0 ? count : 1;
+    if (pool->count > WORKER_POOL_MAX_WORKERS) {
+        pool->count = WORKER_POOL_MAX_WORKERS;
+    }
+    atomic_init(&pool->stopping, 0);
+
+    pool->workers = calloc((size_t)pool->count, sizeof(worker_t));
+    if (!pool->workers) {
+        LOG_ERROR("Memory allocation failed");
+        free(pool);
+        return NULL;
+    }
+
+    for (int i = 0; i < pool->count; i++) {
+        worker_t *worker = &pool->workers[i];
+
+        worker->pool = pool;
+        worker->index = i;
+        worker->cpu = options->pin_cpus ? i % num_cpus : -1;
+        worker->stats_lock = platform_mutex_create();
+        worker->loop = event_loop_create_backend(password, callbacks,
+                                                 options->max_connections,
+                                                 options->backend);
+        if (!worker->stats_lock || !worker->loop ||
+            event_loop_set_timeouts(worker->loop, options->idle_timeout_ms,
+                                    options->keepalive_ms) != EVENT_LOOP_SUCCESS) {
+            worker_pool_destroy(pool);
+            return NULL;
+        }
+    }
+
+    return pool;
+}
+
+/* Internal: Give a worker its listener; closed on failure */
+static int add_listener(worker_t *worker, connection_t *listener) {
+    if (event_loop_add_listener(worker->loop, listener) != EVENT_LOOP_SUCCESS) {
+        close_connection(listener);
+        free(listener);
+        return WORKER_POOL_ERROR_SYSTEM;
+    }
+
+    worker->listener = listener;
+    return WORKER_POOL_SUCCESS;
+}
+
+/* Internal: One worker per listener taken over; the listeners are
+ * consumed either way */
+static worker_pool_t* adopt_listeners(connection_t **listeners, int count,
+                                      const char *password,
+                                      const event_loop_callbacks_t *callbacks,
+                                      const worker_pool_options_t *options) {
+    worker_pool_t *pool = count > 0 ? create_workers(count, password, callbacks, options)
+                                    : NULL;
+
+    for (int i = 0; i < count; i++) {
+        if (!pool) {
+            close_connection(listeners[i]);
+            free(listeners[i]);
+        } else if (add_listener(&pool->workers[i], listeners[i]) != WORKER_POOL_SUCCESS) {
+            worker_pool_destroy(pool);
+            pool = NULL;
+        }
+        listeners[i] = NULL;
+    }
+
+    return pool;
+}
+
+/* Internal: Visitor passing one session to the successor */
+static void hand_off_session(event_loop_t *loop, connection_t *conn, void *ctx) {
+    hand_off_t *handoff = (hand_off_t*)ctx;
+    connection_info_t info = get_connection_info(conn);
+    int result;
+
+    result = event_loop_detach_connection(loop, conn, handoff->timeout_ms);
+    if (result != EVENT_LOOP_SUCCESS) {
+        handoff->failed++;
+        return;
+    }
+
+    result = pass_connection(handoff->channel_fd, conn, handoff->timeout_ms);
+    if (result != NETWORK_SUCCESS) {
+        LOG_WARNING("Session with %s:%d not handed over: %s", info.remote_host,
+                    info.remote_port, network_strerror(result));
+        close_connection(conn);
+        handoff->failed++;
+    } else {
+        handoff->passed++;
+    }
+
+    free(conn);
+}
+
+/* Internal: Worker thread; dispatch until the pool stops */
+static void* worker_main(void *arg) {
+    worker_t *worker = (worker_t*)arg;
+
+    while (!atomic_load(&worker->pool->stopping)) {
+        int result = event_loop_run_once(worker->loop, STATS_PUBLISH_MS);
+
+        if (result < 0) {
+            LOG_ERROR("Worker %d stopped: %s", worker->index, event_loop_strerror(result));
+            worker->result = result;
+            break;
+        }
+
+        publish_stats(worker);
+    }
+
+    publish_stats(worker);
+    return NULL;
+}
+
+/* Internal: Copy the loop's counters where other threads can read them */
+static void publish_stats(worker_t *worker) {
+    event_loop_stats_t stats = event_loop_get_stats(worker->loop);
+
+    platform_mutex_lock(worker->stats_lock);
+    worker->stats = stats;
+    platform_mutex_unlock(worker->stats_lock);
+}
+
+/* Internal: Steer each connection to the socket of the receiving CPU */
+static int attach_cpu_steering(connection_t *listener, int workers) {
+#if defined(__linux__) && defined(SO_ATTACH_REUSEPORT_CBPF)
+    /* A = current CPU; return A % workers as the reuseport socket index */
+    struct sock_filter code[] = {
+        { BPF_LD | BPF_W | BPF_ABS, 0, 0, (uint32_t)(SKF_AD_OFF + SKF_AD_CPU) },
+        { BPF_ALU | BPF_MOD | BPF_K, 0, 0, (uint32_t)workers },
+        { BPF_RET | BPF_A, 0, 0, 0 }
+    };
+    struct sock_fprog program = { (unsigned short)(sizeof(code) / sizeof(code[0])), code };
+
+    if (setsockopt(get_connection_socket(listener), SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF,
+                   &program, sizeof(program)) < 0) {
+        LOG_DEBUG("SO_ATTACH_REUSEPORT_CBPF failed: %s", strerror(errno));
+        return WORKER_POOL_ERROR_SYSTEM;
+    }
+
+    return WORKER_POOL_SUCCESS;
+#else
+    (void)listener;
+    (void)workers;
+    return WORKER_POOL_ERROR_UNSUPPORTED;
+#endif
+}
+
+/* Get error message */
+const char* worker_pool_strerror(int error_code) {
+    switch (error_code) {
+        case WORKER_POOL_SUCCESS:
+            return "Success";
+        case WORKER_POOL_ERROR_PARAM:
+            return "Invalid parameter";
+        case WORKER_POOL_ERROR_MEMORY:
+            return "Memory allocation failed";
+        case WORKER_POOL_ERROR_SYSTEM:
+            return "System call failed";
+        case WORKER_POOL_ERROR_UNSUPPORTED:
+            return "Not supported on this platform";
+        default:
+            return "Unknown error";
+    }
+}
@@ -0,0 +1,173 @@
+/*
+ * Cryptcat Agent API
+ * Header file for agent.c
+ */
+
+#ifndef AGENT_H
+#define AGENT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "network.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Pool defaults */
+#define AGENT_DEFAULT_IDLE_TIMEOUT_MS 300000
+#define AGENT_DEFAULT_KEEPALIVE_MS 30000
+#define AGENT_DEFAULT_MAX_IDLE_PER_PEER 4
+
+/* Longest request line a client may send */
+#define AGENT_MAX_REQUEST 1100
+
+/* Error codes */
+typedef enum {
+    AGENT_SUCCESS = 0,
+    AGENT_ERROR_PARAM = -1,
+    AGENT_ERROR_MEMORY = -2,
+    AGENT_ERROR_SYSTEM = -3,
+    AGENT_ERROR_UNAVAILABLE = -4,
+    AGENT_ERROR_PEER = -5,
+    AGENT_ERROR_PROTOCOL = -6
+} agent_error_t;
+
+/* Opaque agent */
+typedef struct agent_s agent_t;
+
+/* Agent options (0 = default) */
+typedef struct {
+    int idle_timeout_ms;            /* Close sessions unused for this long */
+    int keepalive_ms;               /* Keepalive interval on idle sessions */
+    int max_idle_per_peer;          /* Warm sessions kept per host:port */
+} agent_options_t;
+
+/* Agent statistics */
+typedef struct {
+    uint64_t requests;              /* Client requests accepted */
+    uint64_t sessions_opened;       /* Connect + handshake */
+    uint64_t sessions_reused;       /* Served from the warm pool */
+    uint64_t sessions_expired;      /* Idle timeout, failed keepalive or dead at reuse */
+    uint64_t sessions_passed;       /* Handed over to clients (agent_take_session) */
+    uint32_t idle_sessions;         /* Warm sessions now */
+    uint32_t active_streams;        /* Client requests in progress now */
+} agent_stats_t;
+
+/**
+ * Get the default agent socket path:
+ * $CRYPTCAT_AGENT_SOCK, else $XDG_RUNTIME_DIR/cryptcat-agent.sock,
+ * else /tmp/cryptcat-agent-<uid>.sock.
+ *
+ * @param path Output buffer
+ * @param path_len Buffer size
+ * @return AGENT_SUCCESS on success, error code on failure
+ */
+int agent_default_socket_path(char *path, size_t path_len);
+
+/**
+ * Create an agent listening on a Unix-domain socket.
+ * The agent keeps authenticated sessions to the peers its clients use
+ * and lends them out, so repeated short-lived client processes skip
+ * name resolution, connect and handshake. The socket is created with
+ * mode 0600 and, where the kernel reports peer credentials, only
+ * processes of the agent's user are served.
+ *
+ * @param socket_path Socket path (replaced if a stale socket exists)
+ * @param password Password used for every peer handshake
+ * @param options Pool options (NULL = defaults)
+ * @return Pointer to new agent, or NULL on failure
+ */
+agent_t* agent_create(const char *socket_path, const char *password,
+                      const agent_options_t *options);
+
+/**
+ * Serve clients until agent_stop() is called. Idle sessions are kept
+ * alive and expired from this thread; each client runs on its own.
+ *
+ * @param agent Agent
+ * @return AGENT_SUCCESS on clean stop, error code on failure
+ */
+int agent_run(agent_t *agent);
+
+/**
+ * Ask agent_run() to return. Safe to call from other threads and from
+ * signal handlers.
+ *
+ * @param agent Agent
+ */
+void agent_stop(agent_t *agent);
+
+/**
+ * Destroy an agent: waits for client requests to finish, closes every
+ * pooled session and removes the socket.
+ *
+ * @param agent Agent
+ */
+void agent_destroy(agent_t *agent);
+
+/**
+ * Get agent statistics.
+ *
+ * @param agent Agent
+ * @return Statistics structure
+ */
+agent_stats_t agent_get_stats(agent_t *agent);
+
+/**
+ * Open a stream to a peer through an agent. On success the returned
+ * descriptor carries raw bytes: what is written is sent as MSG_DATA and
+ * MSG_DATA payloads from the peer can be read back. Shut down the write
+ * side to finish; the agent closes the stream once the peer has been
+ * quiet for a moment and returns the session to its pool.
+ *
+ * @param socket_path Agent socket path (NULL = default)
+ * @param host Peer host
+ * @param port Peer port
+ * @param fd Output: stream descriptor
+ * @return AGENT_SUCCESS on success, error code on failure
+ */
+int agent_open_stream(const char *socket_path, const char *host, int port, int *fd);
+
+/**
+ * Send a file to a peer through an agent and wait for the transfer.
+ *
+ * @param socket_path Agent socket path (NULL = default)
+ * @param host Peer host
+ * @param port Peer port
+ * @param path Absolute path of the file (opened by the agent)
+ * @param bytes_sent Output: bytes transferred (may be NULL)
+ * @return AGENT_SUCCESS on success, error code on failure
+ */
+int agent_send_file(const char *socket_path, const char *host, int port,
+                    const char *path, uint64_t *bytes_sent);
+
+/**
+ * Take a session to a peer out of an agent. The agent passes the
+ * connection itself over its socket (see pass_connection()), keys and
+ * sequence numbers included, so the caller talks to the peer directly
+ * with no relay and no handshake. The session does not go back to the
+ * pool. Sessions with compression or a datagram channel cannot be taken.
+ *
+ * @param socket_path Agent socket path (NULL = default)
+ * @param host Peer host
+ * @param port Peer port
+ * @param conn Output: ready connection, closed and freed by the caller
+ * @return AGENT_SUCCESS on success, error code on failure
+ */
+int agent_take_session(const char *socket_path, const char *host, int port,
+                       connection_t **conn);
+
+/**
+ * Get human-readable error message for agent error.
+ *
+ * @param error_code Error code
+ * @return Error message string
+ */
+const char* agent_strerror(int error_code);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* AGENT_H */
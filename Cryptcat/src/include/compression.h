@@ -0,0 +1,156 @@
+/*
+ * Cryptcat Compression API
+ * Header file for compression.c
+ */
+
+#ifndef COMPRESSION_H
+#define COMPRESSION_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Per-record header: one byte naming the codec used (0 = stored) */
+#define COMPRESSION_HEADER_SIZE 1
+
+/* Worst-case growth of a compressed record over its input */
+#define COMPRESSION_MAX_EXPANSION 512
+
+/* Error codes */
+typedef enum {
+    COMPRESSION_SUCCESS = 0,
+    COMPRESSION_ERROR_PARAM = -1,
+    COMPRESSION_ERROR_MEMORY = -2,
+    COMPRESSION_ERROR_CODEC = -3,
+    COMPRESSION_ERROR_CORRUPT = -4,
+    COMPRESSION_ERROR_BUFFER = -5
+} compression_error_t;
+
+/* Codec identifiers (wire values, negotiated in the handshake) */
+typedef enum {
+    COMPRESSION_NONE = 0,
+    COMPRESSION_ZLIB = 1,
+    COMPRESSION_LZ4 = 2,
+    COMPRESSION_ZSTD = 3
+} compression_codec_t;
+
+/* Opaque per-connection compression state */
+typedef struct compression_ctx_s compression_ctx_t;
+
+/* Compression statistics */
+typedef struct {
+    compression_codec_t codec;
+    uint64_t bytes_in;              /* Plaintext bytes offered */
+    uint64_t bytes_out;             /* Bytes after compression stage */
+    uint32_t records_compressed;
+    uint32_t records_stored;        /* Skipped by the entropy probe */
+} compression_stats_t;
+
+/**
+ * Get bitmask of codecs compiled into this build.
+ * Bit n is set when codec n is available.
+ *
+ * @return Supported codec mask
+ */
+uint8_t compression_supported_mask(void);
+
+/**
+ * Pick the preferred codec both sides support (zstd > lz4 > zlib).
+ *
+ * @param peer_mask Codec mask advertised by the peer
+ * @return Selected codec, or COMPRESSION_NONE
+ */
+compression_codec_t compression_select(uint8_t peer_mask);
+
+/**
+ * Create compression state for one connection.
+ * Compressor and decompressor dictionaries persist across records.
+ *
+ * @param codec Negotiated codec
+ * @param max_record Largest plaintext record that will be processed
+ * @return Pointer to new context, or NULL on failure
+ */
+compression_ctx_t* compression_create(compression_codec_t codec, size_t max_record);
+
+/**
+ * Destroy compression state.
+ *
+ * @param ctx Compression context
+ */
+void compression_destroy(compression_ctx_t *ctx);
+
+/**
+ * Compress one record.
+ * Output is header byte + body and points into the context's scratch
+ * buffer; it stays valid until the next call on this context.
+ *
+ * @param ctx Compression context
+ * @param input Plaintext record
+ * @param input_len Plaintext length
+ * @param output Output: pointer to encoded record
+ * @param output_len Output: encoded record length
+ * @return COMPRESSION_SUCCESS on success, error code on failure
+ */
+int compression_compress_record(compression_ctx_t *ctx,
+                               const unsigned char *input, size_t input_len,
+                               const unsigned char **output, size_t *output_len);
+
+/**
+ * Decompress one record produced by compression_compress_record().
+ * Output points into the context's scratch buffer, or into the record
+ * itself if it was stored uncompressed; it stays valid until the next
+ * call on this context.
+ *
+ * @param ctx Compression context
+ * @param record Encoded record (header byte + body)
+ * @param record_len Encoded record length
+ * @param output Output: pointer to plaintext
+ * @param output_len Output: plaintext length
+ * @return COMPRESSION_SUCCESS on success, error code on failure
+ */
+int compression_decompress_record(compression_ctx_t *ctx, const unsigned char *record,
+                                 size_t record_len, const unsigned char **output,
+                                 size_t *output_len);
+
+/**
+ * Estimate whether data is worth compressing (entropy probe over the
+ * first kilobyte).
+ *
+ * @param data Input data
+ * @param len Data length
+ * @return 1 if compressible, 0 otherwise
+ */
+int compression_is_compressible(const unsigned char *data, size_t len);
+
+/**
+ * Get compression statistics.
+ *
+ * @param ctx Compression context
+ * @return Statistics structure
+ */
+compression_stats_t compression_get_stats(const compression_ctx_t *ctx);
+
+/**
+ * Get codec name.
+ *
+ * @param codec Codec identifier
+ * @return Codec name string
+ */
+const char* compression_codec_name(compression_codec_t codec);
+
+/**
+ * Get human-readable error message for compression error.
+ *
+ * @param error_code Error code
+ * @return Error message string
+ */
+const char* compression_strerror(int error_code);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* COMPRESSION_H */
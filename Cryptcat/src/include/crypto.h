@@ -17,6 +17,16 @@ extern "C" {
 /* Opaque session handle */
 typedef struct crypto_session_s crypto_session_t;
 
+/* Size of exported session secret (encryption key + HMAC key) */
+#define CRYPTO_SECRET_SIZE 64
+
+/* Size of exported live session state (see crypto_session_export_state) */
+#define CRYPTO_STATE_SIZE 120
+
+/* A sealed record is sequence(8) | ciphertext | HMAC(32); the
+ * ciphertext is as long as the plaintext */
+#define CRYPTO_SEQUENCE_SIZE 8
+
 /* Error codes */
 typedef enum {
     CRYPTO_SUCCESS = 0,
@@ -61,6 +71,73 @@ int crypto_global_init(void);
  */
 crypto_session_t* crypto_session_create(const char *password);
 
+/**
+ * Create a session from a previously exported secret (session resumption).
+ * Fresh keys and IV are expanded from the secret and a per-connection
+ * nonce with HMAC-SHA256, so no password-based key derivation is done.
+ * 
+ * @param secret Session secret from crypto_session_export_secret()
+ * @param secret_len Secret length (CRYPTO_SECRET_SIZE)
+ * @param nonce Per-connection nonce chosen by the client
+ * @param nonce_len Nonce length
+ * @return Pointer to new session, or NULL on failure
+ */
+crypto_session_t* crypto_session_create_from_secret(const unsigned char *secret,
+                                                    size_t secret_len,
+                                                    const unsigned char *nonce,
+                                                    size_t nonce_len);
+
+/**
+ * Export the session secret for resumption tickets.
+ * 
+ * @param session Cryptographic session
+ * @param secret Output buffer
+ * @param secret_len Buffer size (at least CRYPTO_SECRET_SIZE)
+ * @return CRYPTO_SUCCESS on success, error code on failure
+ */
+int crypto_session_export_secret(crypto_session_t *session, unsigned char *secret,
+                                 size_t secret_len);
+
+/**
+ * Export a session's live state: keys, both cipher stream positions and
+ * sequence numbers. A session imported from it carries on exactly where
+ * this one stopped, so the export must be the last use of this session.
+ * The state holds the keys in the clear; only hand it to a trusted
+ * process.
+ * 
+ * @param session Cryptographic session
+ * @param state Output buffer
+ * @param state_len Buffer size (at least CRYPTO_STATE_SIZE)
+ * @return CRYPTO_SUCCESS on success, error code on failure
+ */
+int crypto_session_export_state(crypto_session_t *session, unsigned char *state,
+                                size_t state_len);
+
+/**
+ * Recreate a session from crypto_session_export_state() output.
+ * 
+ * @param state Exported state
+ * @param state_len State length (CRYPTO_STATE_SIZE)
+ * @return Pointer to new session, or NULL on failure
+ */
+crypto_session_t* crypto_session_import_state(const unsigned char *state, size_t state_len);
+
+/**
+ * Derive key material for another layer (such as kernel TLS) from the
+ * session secret. Different labels and nonces give independent keys.
+ * 
+ * @param session Cryptographic session
+ * @param label Purpose label
+ * @param nonce Per-use nonce
+ * @param nonce_len Nonce length
+ * @param out Output buffer
+ * @param out_len Bytes to derive (at most 32)
+ * @return CRYPTO_SUCCESS on success, error code on failure
+ */
+int crypto_session_derive_key(crypto_session_t *session, const char *label,
+                              const unsigned char *nonce, size_t nonce_len,
+                              unsigned char *out, size_t out_len);
+
 /**
  * Encrypt data with authentication.
  * 
@@ -76,7 +153,8 @@ int crypto_encrypt(crypto_session_t *session, const unsigned char *plaintext,
                    size_t *ciphertext_len);
 
 /**
- * Decrypt and verify data.
+ * Decrypt and verify data. The record may be opened in place, with
+ * plaintext at ciphertext + CRYPTO_SEQUENCE_SIZE.
  * 
  * @param session Cryptographic session
  * @param ciphertext Data to decrypt
@@ -0,0 +1,190 @@
+/*
+ * Cryptcat Datagram Transport API
+ * Header file for datagram.c
+ */
+
+#ifndef DATAGRAM_H
+#define DATAGRAM_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "network.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Default wait for the peer's answer in datagram_open() */
+#define DATAGRAM_DEFAULT_TIMEOUT_MS 5000
+
+/* Largest packet on the wire; stays under the IPv6 minimum MTU path */
+#define DATAGRAM_MAX_PACKET 1280
+
+/* Packet overhead: version(1) | type(1) | sequence(8) ... tag(16) */
+#define DATAGRAM_OVERHEAD 26
+
+/* Largest message datagram_send() takes; reliable ones carry a 4-byte id */
+#define DATAGRAM_MAX_PAYLOAD (DATAGRAM_MAX_PACKET - DATAGRAM_OVERHEAD - 4)
+
+/* Packets moved per sendmmsg()/recvmmsg() call */
+#define DATAGRAM_BATCH 32
+
+/* Sequence numbers accepted behind the highest one seen */
+#define DATAGRAM_REPLAY_WINDOW 960
+
+/* Unacknowledged reliable messages per direction */
+#define DATAGRAM_MAX_INFLIGHT 256
+
+/* datagram_send() flags */
+#define DATAGRAM_SEND_RELIABLE 0x01 /* Retransmit until acknowledged, deliver in order */
+#define DATAGRAM_SEND_MORE 0x02     /* Queue only; flushed by a later send or datagram_flush() */
+
+/* Error codes */
+typedef enum {
+    DATAGRAM_SUCCESS = 0,
+    DATAGRAM_IN_PROGRESS = 1,
+    DATAGRAM_ERROR_PARAM = -1,
+    DATAGRAM_ERROR_UNSUPPORTED = -2,
+    DATAGRAM_ERROR_REJECTED = -3,
+    DATAGRAM_ERROR_TIMEOUT = -4,
+    DATAGRAM_ERROR_KEY = -5,
+    DATAGRAM_ERROR_PROTOCOL = -6,
+    DATAGRAM_ERROR_SYSTEM = -7,
+    DATAGRAM_ERROR_MEMORY = -8,
+    DATAGRAM_ERROR_SIZE = -9,
+    DATAGRAM_ERROR_UNREACHABLE = -10
+} datagram_error_t;
+
+/* Channel statistics */
+typedef struct {
+    uint64_t packets_sent;
+    uint64_t packets_received;
+    uint64_t send_calls;            /* sendmmsg()/sendmsg() calls */
+    uint64_t recv_calls;            /* recvmmsg()/recvmsg() calls */
+    uint64_t gso_sends;             /* Messages the kernel segmented (UDP_SEGMENT) */
+    uint64_t gro_receives;          /* Buffers the kernel coalesced (UDP_GRO) */
+    uint64_t retransmits;
+    uint64_t replays_dropped;       /* Duplicate or too old */
+    uint64_t auth_failures;         /* Failed to open */
+    uint32_t inflight;              /* Reliable messages not yet acknowledged */
+    uint32_t rto_ms;                /* Current retransmission timeout */
+} datagram_stats_t;
+
+/**
+ * Open a datagram channel next to an established session. The peers
+ * agree on a UDP port and fresh nonces over the connection, and derive
+ * per-direction AES-256-GCM keys from the session secret. Every UDP
+ * packet is then a self-contained sealed record with an explicit
+ * sequence number, so loss or reordering delays nothing but the packet
+ * itself; a sliding window rejects replays.
+ *
+ * Call while the peer is idle: it sends a request and blocks for the
+ * answer. On success the channel is attached to the connection (see
+ * get_connection_datagram()) and closed with it. DATAGRAM_ERROR_UNSUPPORTED,
+ * DATAGRAM_ERROR_REJECTED and DATAGRAM_ERROR_TIMEOUT leave the
+ * connection usable without a channel.
+ *
+ * @param conn Connection after a completed handshake
+ * @param timeout_ms Wait for the peer's answer
+ * @return DATAGRAM_SUCCESS on success, error code on failure
+ */
+int datagram_open(connection_t *conn, int timeout_ms);
+
+/**
+ * Answer a peer's datagram request, attaching the channel to the
+ * connection on acceptance. Called by receive_message(), which
+ * consumes the request.
+ *
+ * @param conn Connection the request arrived on
+ * @param request Request payload
+ * @param request_len Payload length
+ * @return DATAGRAM_SUCCESS if answered (accepted or refused), error
+ *         code if the connection is no longer usable
+ */
+int datagram_accept(connection_t *conn, const unsigned char *request, size_t request_len);
+
+/**
+ * Seal one message into a packet. Unreliable messages may be lost or
+ * arrive out of order. Reliable ones are delivered once and in order,
+ * with lost packets resent selectively from the peer's acknowledgements.
+ * Packets are batched: queued ones go out together, with UDP segmentation
+ * offload where runs have equal sizes, unless DATAGRAM_SEND_MORE is given.
+ *
+ * @param dg Datagram channel
+ * @param data Message
+ * @param len Message length (at most DATAGRAM_MAX_PAYLOAD)
+ * @param flags DATAGRAM_SEND_* bits
+ * @return DATAGRAM_SUCCESS on success, DATAGRAM_IN_PROGRESS if the
+ *         reliable window is full, error code on failure
+ */
+int datagram_send(datagram_t *dg, const unsigned char *data, size_t len, int flags);
+
+/**
+ * Write out queued packets.
+ *
+ * @param dg Datagram channel
+ * @return DATAGRAM_SUCCESS when the queue is empty, DATAGRAM_IN_PROGRESS
+ *         if the socket is full or the peer's address is not known yet
+ */
+int datagram_flush(datagram_t *dg);
+
+/**
+ * Receive the next message without blocking. Reliable messages wait
+ * for those before them; unreliable ones are returned as they arrive.
+ *
+ * @param dg Datagram channel
+ * @param buffer Output buffer (DATAGRAM_MAX_PAYLOAD bytes holds any message)
+ * @param len In: buffer size; out: message length
+ * @param flags Output: DATAGRAM_SEND_RELIABLE if the message was sent reliably (may be NULL)
+ * @return DATAGRAM_SUCCESS with a message, DATAGRAM_IN_PROGRESS if none
+ *         is ready, error code on failure
+ */
+int datagram_receive(datagram_t *dg, unsigned char *buffer, size_t *len, int *flags);
+
+/**
+ * Resend reliable messages whose timeout has passed and send pending
+ * acknowledgements. Call when datagram_service()'s last answer expires
+ * and after receiving.
+ *
+ * @param dg Datagram channel
+ * @return Milliseconds until the next call is needed, -1 if nothing is
+ *         outstanding, or DATAGRAM_ERROR_UNREACHABLE if a message ran out of retries
+ */
+int datagram_service(datagram_t *dg);
+
+/**
+ * Get the channel's UDP socket, for polling readability.
+ *
+ * @param dg Datagram channel
+ * @return Socket file descriptor, or -1
+ */
+int datagram_get_socket(datagram_t *dg);
+
+/**
+ * Get channel statistics.
+ *
+ * @param dg Datagram channel
+ * @return Statistics structure
+ */
+datagram_stats_t datagram_get_stats(datagram_t *dg);
+
+/**
+ * Close a channel. Unacknowledged messages are dropped.
+ *
+ * @param dg Datagram channel
+ */
+void datagram_close(datagram_t *dg);
+
+/**
+ * Get human-readable error message for datagram error.
+ *
+ * @param error_code Error code
+ * @return Error message string
+ */
+const char* datagram_strerror(int error_code);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* DATAGRAM_H */
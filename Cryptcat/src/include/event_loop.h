@@ -0,0 +1,330 @@
+/*
+ * Cryptcat Event Loop API
+ * Header file for event_loop.c
+ */
+
+#ifndef EVENT_LOOP_H
+#define EVENT_LOOP_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "network.h"
+#include "protocol.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Default cap on concurrently served connections */
+#define EVENT_LOOP_DEFAULT_MAX_CONNECTIONS 10240
+
+/* Suggested keepalive interval for event_loop_set_timeouts() */
+#define EVENT_LOOP_DEFAULT_KEEPALIVE_MS 60000
+
+/* Error codes */
+typedef enum {
+    EVENT_LOOP_SUCCESS = 0,
+    EVENT_LOOP_ERROR_PARAM = -1,
+    EVENT_LOOP_ERROR_MEMORY = -2,
+    EVENT_LOOP_ERROR_SYSTEM = -3,
+    EVENT_LOOP_ERROR_UNSUPPORTED = -4,
+    EVENT_LOOP_ERROR_LIMIT = -5
+} event_loop_error_t;
+
+/* I/O backends */
+typedef enum {
+    EVENT_LOOP_BACKEND_AUTO = 0,    /* io_uring when usable, else epoll */
+    EVENT_LOOP_BACKEND_EPOLL,
+    EVENT_LOOP_BACKEND_IO_URING
+} event_loop_backend_t;
+
+/* Opaque reactor */
+typedef struct event_loop_s event_loop_t;
+
+/* Generation-tagged reference to a loop's connection; goes stale, rather
+ * than pointing at a stranger, once the connection closes */
+typedef uint64_t event_loop_handle_t;
+#define EVENT_LOOP_INVALID_HANDLE 0
+
+/* Visitor for event_loop_for_each() */
+typedef void (*event_loop_visit_t)(event_loop_t *loop, connection_t *conn, void *ctx);
+
+/* Application callbacks, all invoked on the loop thread */
+typedef struct {
+    /* Handshake finished; the connection is ready for send_message() */
+    void (*on_connect)(event_loop_t *loop, connection_t *conn, void *ctx);
+
+    /* One decrypted message; payload is only valid during the call */
+    void (*on_message)(event_loop_t *loop, connection_t *conn, message_type_t type,
+                       const unsigned char *payload, size_t payload_len, void *ctx);
+
+    /* Connection is about to be closed and freed (reason is a protocol
+     * error code, PROTOCOL_SUCCESS for a local close) */
+    void (*on_close)(event_loop_t *loop, connection_t *conn, int reason, void *ctx);
+
+    /* Output queue drained to the low watermark after send_message()
+     * pushed it past the high one (see connection_send_blocked()) */
+    void (*on_writable)(event_loop_t *loop, connection_t *conn, void *ctx);
+
+    void *ctx;
+} event_loop_callbacks_t;
+
+/* Event loop statistics */
+typedef struct {
+    uint32_t connections;           /* Currently registered connections */
+    uint32_t peak_connections;
+    uint32_t handshaking;           /* Connections still in the handshake */
+    uint32_t established;           /* Connections past the handshake */
+    uint64_t accepted;
+    uint64_t rejected;              /* Closed unhandshaked at the connection limit */
+    uint64_t handshakes_completed;
+    uint64_t handshakes_failed;
+    uint64_t messages;              /* Messages delivered to on_message */
+    uint64_t wakeups;               /* Returns from the readiness wait */
+    uint64_t events;                /* Readiness events or completions dispatched */
+    uint64_t sends;                 /* Records submitted as sends (io_uring) */
+    uint64_t send_batches;          /* Linked send chains submitted (io_uring) or
+                                     * corked connections flushed (epoll) */
+    uint64_t send_stalls;           /* Reads paused behind a full output queue */
+    uint64_t idle_evictions;        /* Closed after the idle timeout */
+    uint64_t keepalives_sent;
+    uint64_t adopted;               /* Registered past their handshake */
+    uint64_t detached;              /* Handed back without closing */
+} event_loop_stats_t;
+
+/**
+ * Create an event loop.
+ * Readiness is edge-triggered; every registered socket is drained until
+ * it would block, so one thread can serve thousands of sessions.
+ *
+ * @param password Password used for every handshake the loop runs
+ * @param callbacks Application callbacks (copied)
+ * @param max_connections Connection limit (0 = default)
+ * @return Pointer to new event loop, or NULL on failure
+ */
+event_loop_t* event_loop_create(const char *password,
+                                const event_loop_callbacks_t *callbacks,
+                                int max_connections);
+
+/**
+ * Create an event loop on a specific I/O backend.
+ * The io_uring backend receives through multishot recv into a provided
+ * buffer ring and queues each connection's records as one linked send
+ * chain, so a loop iteration costs a single io_uring_enter. It falls back
+ * to epoll when the build or the kernel lacks io_uring support;
+ * CRYPTCAT_IO_BACKEND=epoll forces the fallback for AUTO.
+ *
+ * @param password Password used for every handshake the loop runs
+ * @param callbacks Application callbacks (copied)
+ * @param max_connections Connection limit (0 = default)
+ * @param backend Requested backend
+ * @return Pointer to new event loop, or NULL on failure
+ */
+event_loop_t* event_loop_create_backend(const char *password,
+                                        const event_loop_callbacks_t *callbacks,
+                                        int max_connections,
+                                        event_loop_backend_t backend);
+
+/**
+ * Destroy an event loop, closing and freeing every connection it owns.
+ * on_close is not invoked.
+ *
+ * @param loop Event loop
+ */
+void event_loop_destroy(event_loop_t *loop);
+
+/**
+ * Register a listener. Incoming connections are accepted, handshaked as
+ * the server side and reported through on_connect.
+ * The loop takes ownership of the listener.
+ *
+ * @param loop Event loop
+ * @param listener Listening connection
+ * @return EVENT_LOOP_SUCCESS on success, error code on failure
+ */
+int event_loop_add_listener(event_loop_t *loop, connection_t *listener);
+
+/**
+ * Register an established connection and start its handshake.
+ * The socket is switched to non-blocking mode and the loop takes
+ * ownership of the connection.
+ *
+ * @param loop Event loop
+ * @param conn Connection handle
+ * @param is_server 1 to run the server side of the handshake, 0 for client
+ * @return EVENT_LOOP_SUCCESS on success, error code on failure
+ */
+int event_loop_add_connection(event_loop_t *loop, connection_t *conn, int is_server);
+
+/**
+ * Register a connection that completed its handshake elsewhere, e.g.
+ * one taken over with accept_passed_connection(). It is established at
+ * once: on_connect runs, so the application can set up its state, and
+ * input the connection carries is delivered. The socket is switched to
+ * non-blocking mode and the loop takes ownership of the connection.
+ *
+ * @param loop Event loop
+ * @param conn Connection past its handshake
+ * @return EVENT_LOOP_SUCCESS on success, error code on failure
+ */
+int event_loop_adopt_connection(event_loop_t *loop, connection_t *conn);
+
+/**
+ * Take a listener or established connection out of the loop without
+ * closing it, e.g. to hand it to another process with pass_connection().
+ * Output queued for the backend is sent first; output still queued in
+ * the connection is left for flush_connection(). Input the backend has
+ * read but not delivered stays with the connection and is received
+ * before the socket. on_close does not run. Connections still in their
+ * handshake cannot be detached.
+ * Call on the loop thread outside callbacks, or while the loop is not
+ * running; with io_uring, other connections' completions are dispatched
+ * while waiting.
+ *
+ * @param loop Event loop
+ * @param conn Listener or connection owned by the loop
+ * @param timeout_ms Longest wait for sends and reads in flight (io_uring)
+ * @return EVENT_LOOP_SUCCESS if the caller owns conn again,
+ *         EVENT_LOOP_ERROR_PARAM if it cannot be detached (the loop
+ *         keeps it), other error codes if it failed and the loop closed it
+ */
+int event_loop_detach_connection(event_loop_t *loop, connection_t *conn, int timeout_ms);
+
+/**
+ * Close and free a connection owned by the loop. Safe to call from
+ * callbacks, including for the connection being dispatched.
+ *
+ * @param loop Event loop
+ * @param conn Connection handle
+ */
+void event_loop_close_connection(event_loop_t *loop, connection_t *conn);
+
+/**
+ * Get a handle for a connection owned by the loop. Unlike the pointer,
+ * a handle can be kept after the connection closes: event_loop_lookup()
+ * then returns NULL, even if its descriptor has been reused.
+ *
+ * @param loop Event loop
+ * @param conn Connection handle
+ * @return Handle, or EVENT_LOOP_INVALID_HANDLE if the loop does not own conn
+ */
+event_loop_handle_t event_loop_get_handle(const event_loop_t *loop, connection_t *conn);
+
+/**
+ * Resolve a handle in O(1).
+ *
+ * @param loop Event loop
+ * @param handle Handle from event_loop_get_handle()
+ * @return Connection, or NULL if it has closed
+ */
+connection_t* event_loop_lookup(const event_loop_t *loop, event_loop_handle_t handle);
+
+/**
+ * Call visit for every connection past its handshake. Established
+ * connections are kept in a dense list, so this costs nothing for idle
+ * descriptors or handshakes. The visitor may close connections.
+ * Call on the loop thread.
+ *
+ * @param loop Event loop
+ * @param visit Visitor
+ * @param ctx Visitor context
+ * @return Number of connections visited, or error code on failure
+ */
+int event_loop_for_each(event_loop_t *loop, event_loop_visit_t visit, void *ctx);
+
+/**
+ * Send one message to every connection past its handshake, e.g. for
+ * chat fan-out. Each copy is sealed under its connection's keys and
+ * leaves with the loop's next flush; a connection whose send fails is
+ * closed. Call on the loop thread, typically from on_message.
+ *
+ * @param loop Event loop
+ * @param type Message type
+ * @param payload Payload
+ * @param payload_len Payload length
+ * @param except Connection to skip (the sender), or NULL
+ * @return Number of connections sent to, or error code on failure
+ */
+int event_loop_broadcast(event_loop_t *loop, message_type_t type,
+                         const unsigned char *payload, size_t payload_len,
+                         connection_t *except);
+
+/**
+ * Wait for readiness once and dispatch every event.
+ *
+ * @param loop Event loop
+ * @param timeout_ms Maximum wait in milliseconds (-1 = no limit)
+ * @return Number of events dispatched, or error code on failure
+ */
+int event_loop_run_once(event_loop_t *loop, int timeout_ms);
+
+/**
+ * Dispatch events until event_loop_stop() is called.
+ *
+ * @param loop Event loop
+ * @return EVENT_LOOP_SUCCESS on success, error code on failure
+ */
+int event_loop_run(event_loop_t *loop);
+
+/**
+ * Ask a running loop to return. Safe to call from other threads and
+ * from signal handlers.
+ *
+ * @param loop Event loop
+ */
+void event_loop_stop(event_loop_t *loop);
+
+/**
+ * Set the idle timeout and keepalive interval for established
+ * connections; both are off when a loop is created. A connection that
+ * delivers no message for idle_timeout_ms is closed with
+ * PROTOCOL_ERROR_TIMEOUT, and one that has queued nothing for
+ * keepalive_ms is sent MSG_KEEPALIVE. Received keepalives refresh the
+ * idle clock and are not passed to on_message. Deadlines, including
+ * the handshake timeout, run on one hierarchical timer wheel, so the
+ * loop sleeps until the next is due rather than sweeping.
+ *
+ * @param loop Event loop
+ * @param idle_timeout_ms Idle timeout in milliseconds (0 = off)
+ * @param keepalive_ms Keepalive interval in milliseconds (0 = off)
+ * @return EVENT_LOOP_SUCCESS on success, error code on failure
+ */
+int event_loop_set_timeouts(event_loop_t *loop, int idle_timeout_ms, int keepalive_ms);
+
+/**
+ * Get event loop statistics.
+ *
+ * @param loop Event loop
+ * @return Statistics structure
+ */
+event_loop_stats_t event_loop_get_stats(const event_loop_t *loop);
+
+/**
+ * Get the backend a loop actually runs on.
+ *
+ * @param loop Event loop
+ * @return EVENT_LOOP_BACKEND_EPOLL or EVENT_LOOP_BACKEND_IO_URING
+ */
+event_loop_backend_t event_loop_get_backend(const event_loop_t *loop);
+
+/**
+ * Get the name of a backend.
+ *
+ * @param backend Backend
+ * @return Backend name string
+ */
+const char* event_loop_backend_name(event_loop_backend_t backend);
+
+/**
+ * Get human-readable error message for event loop error.
+ *
+ * @param error_code Error code
+ * @return Error message string
+ */
+const char* event_loop_strerror(int error_code);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* EVENT_LOOP_H */
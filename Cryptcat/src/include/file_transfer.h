@@ -7,6 +7,8 @@
 #define FILE_TRANSFER_H
 
 #include "network.h"
+#include "protocol.h"
+#include "stripe.h"
 #include <stdint.h>
 #include <time.h>
 #include <sys/stat.h>
@@ -41,6 +43,13 @@ typedef enum {
     TRANSFER_CANCELLED
 } transfer_state_t;
 
+/* How file data is protected on the wire */
+typedef enum {
+    FILE_TRANSFER_SEALED = 0,       /* Chunks sealed like any other message */
+    FILE_TRANSFER_INTEGRITY_ONLY    /* Data sent in the clear with sendfile(),
+                                     * authenticated by an HMAC tag trailer */
+} file_transfer_mode_t;
+
 /* Forward declaration */
 typedef struct file_transfer_s file_transfer_t;
 
@@ -55,6 +64,10 @@ typedef struct {
     uint8_t progress_percent;
     time_t elapsed_time;
     uint32_t transfer_rate; /* bytes per second */
+    uint32_t window_size;   /* Autotuned send window in bytes */
+    uint32_t rtt_ms;        /* Smoothed round-trip time */
+    uint64_t bytes_in_flight; /* Sent but not yet consumed by receiver */
+    uint32_t lanes;         /* Striped: connections carrying the data */
 } file_transfer_info_t;
 
 /* ========== File Transfer Functions ========== */
@@ -75,6 +88,47 @@ int file_transfer_init(void);
  */
 file_transfer_t* start_file_send(connection_t *conn, const char *filename);
 
+/**
+ * Start sending a file in the given mode.
+ * FILE_TRANSFER_INTEGRITY_ONLY is for trusted networks where
+ * confidentiality is handled elsewhere: file bytes go from the page cache
+ * to the socket with sendfile() and are never encrypted, while threads
+ * tag the memory-mapped file with an HMAC-SHA256 tree keyed from the
+ * session. The tag is sent sealed in MSG_FILE_END and checked by the
+ * receiver before the file is renamed into place.
+ * 
+ * @param conn Connection handle (with an established session)
+ * @param filename Path to file to send
+ * @param mode Wire protection mode
+ * @return File transfer handle, or NULL on failure
+ */
+file_transfer_t* start_file_send_mode(connection_t *conn, const char *filename,
+                                      file_transfer_mode_t mode);
+
+/**
+ * Start sending a file striped over several connections. A long-fat
+ * path that one TCP flow cannot fill (its congestion window grows too
+ * slowly) is filled by several: after the receiver has accepted the
+ * transfer on conn, lanes further authenticated connections are opened
+ * to the same peer and address, each naming the transfer with
+ * MSG_STRIPE_JOIN. Chunks go out in parallel from per-lane ranges of
+ * the file; a lane that finishes early takes over half of the largest
+ * range left, and a failed lane's range is taken over whole. The
+ * receiver writes each chunk at its offset and verifies the whole file
+ * when MSG_FILE_END arrives on conn.
+ *
+ * The receiving application must hand each accepted connection whose
+ * first message is MSG_STRIPE_JOIN to stripe_join().
+ * 
+ * @param conn Connection handle (with an established session)
+ * @param filename Path to file to send
+ * @param password Session password for the lanes
+ * @param lanes Connections to stripe over (1 to STRIPE_MAX_LANES)
+ * @return File transfer handle, or NULL on failure
+ */
+file_transfer_t* start_file_send_striped(connection_t *conn, const char *filename,
+                                         const char *password, int lanes);
+
 /**
  * Start receiving a file.
  * 
@@ -88,7 +142,12 @@ file_transfer_t* start_file_receive(connection_t *conn,
                                    size_t info_len);
 
 /**
- * Process file transfer (non-blocking).
+ * Process file transfer.
+ * When sending, chunks are written until the receiver's credit is used
+ * up; the call then waits at most a few tens of milliseconds for a
+ * window update before returning FILE_TRANSFER_IN_PROGRESS. Other
+ * messages read meanwhile are queued for file_transfer_next_message();
+ * a disconnect from the peer returns FILE_TRANSFER_CANCELLED.
  * 
  * @param transfer File transfer handle
  * @return Transfer status code
@@ -108,6 +167,64 @@ int receive_file_chunk(file_transfer_t *transfer,
                       const unsigned char *chunk_data,
                       size_t chunk_size, uint32_t chunk_num);
 
+/**
+ * Receive a bulk chunk of an integrity-only transfer: reads the clear
+ * bytes announced by a MSG_FILE_BULK header straight into the file.
+ * Must be called before the next receive_message().
+ * 
+ * @param transfer File transfer handle
+ * @param payload MSG_FILE_BULK payload
+ * @param payload_len Payload length
+ * @return Transfer status code
+ */
+int receive_file_bulk(file_transfer_t *transfer,
+                      const unsigned char *payload, size_t payload_len);
+
+/**
+ * Handle MSG_FILE_END. Integrity-only transfers are verified against
+ * the tag it carries and completed here, as are striped transfers once
+ * their lanes have written every chunk; other sealed transfers were
+ * already verified by their last chunk.
+ * 
+ * @param transfer File transfer handle
+ * @param payload MSG_FILE_END payload
+ * @param payload_len Payload length
+ * @return FILE_TRANSFER_SUCCESS when complete, error code otherwise
+ */
+int receive_file_end(file_transfer_t *transfer,
+                     const unsigned char *payload, size_t payload_len);
+
+/**
+ * Apply a window update (MSG_WINDOW_UPDATE) to a sending transfer.
+ * process_file_transfer() drains updates itself; this is for callers
+ * that own the connection's receive loop.
+ * 
+ * @param transfer File transfer handle
+ * @param payload Window update payload
+ * @param payload_len Payload length
+ * @return FILE_TRANSFER_SUCCESS on success, error code on failure
+ */
+int file_transfer_window_update(file_transfer_t *transfer,
+                               const unsigned char *payload,
+                               size_t payload_len);
+
+/**
+ * Take the next message that arrived while process_file_transfer() was
+ * reading window updates (data, file or other messages the transfer
+ * does not consume), oldest first. Drain these before calling
+ * receive_message() on the connection to keep the peer's order. Reading
+ * pauses while 1 MB is queued.
+ * 
+ * @param transfer File transfer handle
+ * @param type Output message type
+ * @param buffer Output buffer
+ * @param buffer_len Input: buffer size, Output: payload length
+ * @return FILE_TRANSFER_SUCCESS if a message was returned,
+ *         FILE_TRANSFER_IN_PROGRESS if none is queued, error code on failure
+ */
+int file_transfer_next_message(file_transfer_t *transfer, message_type_t *type,
+                               unsigned char *buffer, size_t *buffer_len);
+
 /**
  * Cancel file transfer.
  * 
@@ -124,6 +241,18 @@ int cancel_file_transfer(file_transfer_t *transfer);
  */
 file_transfer_info_t get_file_transfer_info(file_transfer_t *transfer);
 
+/**
+ * Get per-lane statistics of a striped transfer, indexed by lane
+ * number. Kept after the transfer completes.
+ * 
+ * @param transfer File transfer handle
+ * @param lanes Output array
+ * @param max_lanes Array size
+ * @return Number of lanes filled in (0 if the transfer is not striped)
+ */
+int get_file_transfer_lanes(file_transfer_t *transfer, stripe_lane_stats_t *lanes,
+                            int max_lanes);
+
 /**
  * Clean up file transfer resources.
  * 
@@ -0,0 +1,90 @@
+/*
+ * Cryptcat File Integrity API
+ * Header file for integrity.c
+ */
+
+#ifndef INTEGRITY_H
+#define INTEGRITY_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Size of a file tag (HMAC-SHA256) */
+#define INTEGRITY_TAG_SIZE 32
+
+/* Leaf size of the tag tree; part of the tag format */
+#define INTEGRITY_BLOCK_SIZE (1024 * 1024)
+
+/* Upper bound on hashing threads per job */
+#define INTEGRITY_MAX_THREADS 16
+
+/* Error codes */
+typedef enum {
+    INTEGRITY_SUCCESS = 0,
+    INTEGRITY_ERROR_PARAM = -1,
+    INTEGRITY_ERROR_MEMORY = -2,
+    INTEGRITY_ERROR_IO = -3,
+    INTEGRITY_ERROR_CRYPTO = -4,
+    INTEGRITY_ERROR_THREAD = -5
+} integrity_error_t;
+
+/* Opaque tagging job */
+typedef struct integrity_job_s integrity_job_t;
+
+/**
+ * Start tagging a file in the background.
+ * The file is mapped and split into INTEGRITY_BLOCK_SIZE leaves, each
+ * tagged with HMAC-SHA256 over its index and data by a pool of threads;
+ * the file tag is an HMAC over the file size and every leaf tag. The
+ * file must not change until the job is finished.
+ *
+ * @param fd File descriptor (not owned)
+ * @param file_size Bytes to tag from offset 0
+ * @param key HMAC key
+ * @param key_len Key length
+ * @param threads Hashing threads (0 = one per CPU)
+ * @return Pointer to new job, or NULL on failure
+ */
+integrity_job_t* integrity_start(int fd, uint64_t file_size,
+                                 const unsigned char *key, size_t key_len, int threads);
+
+/**
+ * Wait for a job, return its tag and destroy it.
+ *
+ * @param job Tagging job
+ * @param tag Output: INTEGRITY_TAG_SIZE byte file tag (may be NULL to cancel)
+ * @return INTEGRITY_SUCCESS on success, error code on failure
+ */
+int integrity_finish(integrity_job_t *job, unsigned char *tag);
+
+/**
+ * Tag a file and wait for the result.
+ *
+ * @param fd File descriptor (not owned)
+ * @param file_size Bytes to tag from offset 0
+ * @param key HMAC key
+ * @param key_len Key length
+ * @param threads Hashing threads (0 = one per CPU)
+ * @param tag Output: INTEGRITY_TAG_SIZE byte file tag
+ * @return INTEGRITY_SUCCESS on success, error code on failure
+ */
+int integrity_tag_file(int fd, uint64_t file_size, const unsigned char *key,
+                       size_t key_len, int threads, unsigned char *tag);
+
+/**
+ * Get human-readable error message for integrity error.
+ *
+ * @param error_code Error code
+ * @return Error message string
+ */
+const char* integrity_strerror(int error_code);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* INTEGRITY_H */
@@ -0,0 +1,83 @@
+/*
+ * Cryptcat Kernel TLS API
+ * Header file for ktls.c
+ */
+
+#ifndef KTLS_H
+#define KTLS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "network.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Default wait for the peer's answer in ktls_enable() */
+#define KTLS_DEFAULT_TIMEOUT_MS 5000
+
+/* Error codes */
+typedef enum {
+    KTLS_SUCCESS = 0,
+    KTLS_ERROR_PARAM = -1,
+    KTLS_ERROR_UNSUPPORTED = -2,
+    KTLS_ERROR_REJECTED = -3,
+    KTLS_ERROR_TIMEOUT = -4,
+    KTLS_ERROR_KEY = -5,
+    KTLS_ERROR_PROTOCOL = -6,
+    KTLS_ERROR_SYSTEM = -7
+} ktls_error_t;
+
+/**
+ * Check whether the kernel offers TLS offload (Linux "tls" ULP).
+ * The answer is probed once. Setting CRYPTCAT_KTLS=off forces it off.
+ *
+ * @return 1 if available, 0 otherwise
+ */
+int ktls_available(void);
+
+/**
+ * Move an established session's record crypto into the kernel.
+ * Both peers derive per-direction AES-256-GCM keys from the session
+ * secret and fresh nonces, then install them with setsockopt(SOL_TLS)
+ * in TLS 1.3 record framing, so records are sealed by the kernel and
+ * file data can be sent with sendfile().
+ *
+ * Call while the peer is idle (e.g. before a file transfer starts): it
+ * sends a request and blocks for the answer. KTLS_ERROR_UNSUPPORTED,
+ * KTLS_ERROR_REJECTED and KTLS_ERROR_TIMEOUT leave the session on
+ * user-space crypto and usable; any other error means the peers may
+ * disagree on framing and the connection must be closed.
+ *
+ * @param conn Connection after a completed handshake
+ * @param timeout_ms Wait for the peer's answer
+ * @return KTLS_SUCCESS on success, error code on failure
+ */
+int ktls_enable(connection_t *conn, int timeout_ms);
+
+/**
+ * Answer a peer's kernel TLS request. Called by receive_message(),
+ * which consumes the request.
+ *
+ * @param conn Connection the request arrived on
+ * @param request Request payload
+ * @param request_len Payload length
+ * @return KTLS_SUCCESS if answered (accepted or refused), error code if
+ *         the connection is no longer usable
+ */
+int ktls_accept(connection_t *conn, const unsigned char *request, size_t request_len);
+
+/**
+ * Get human-readable error message for kernel TLS error.
+ *
+ * @param error_code Error code
+ * @return Error message string
+ */
+const char* ktls_strerror(int error_code);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* KTLS_H */
@@ -14,6 +14,27 @@ extern "C" {
 /* Forward declarations */
 typedef struct connection_s connection_t;
 typedef struct crypto_session_s crypto_session_t;
+typedef struct compression_ctx_s compression_ctx_t;
+typedef struct datagram_s datagram_t;
+
+/* Replacement for send(): queue or write len bytes (0 or more on success,
+ * negative on failure); the data is only valid during the call */
+typedef int (*connection_send_hook_t)(void *ctx, connection_t *conn,
+                                      const unsigned char *data, size_t len);
+
+/* Called when a corked connection's output queue stops being empty */
+typedef void (*connection_output_hook_t)(void *ctx, connection_t *conn);
+
+/* Default output queue watermarks (see set_connection_watermarks) */
+#define NETWORK_SEND_HIGH_WATERMARK (1024 * 1024)
+#define NETWORK_SEND_LOW_WATERMARK (256 * 1024)
+
+/* Sealed records at least this large are sent with MSG_ZEROCOPY (Linux) */
+#define NETWORK_ZEROCOPY_THRESHOLD (16 * 1024)
+
+/* Directions whose records the kernel seals (see set_connection_kernel_crypto) */
+#define NETWORK_KERNEL_CRYPTO_TX 0x01
+#define NETWORK_KERNEL_CRYPTO_RX 0x02
 
 /* Error codes */
 typedef enum {
@@ -31,7 +52,8 @@ typedef enum {
     NETWORK_ERROR_BUFFER = -11,
     NETWORK_ERROR_CRYPTO = -12,
     NETWORK_ERROR_STATE = -13,
-    NETWORK_ERROR_MEMORY = -14
+    NETWORK_ERROR_MEMORY = -14,
+    NETWORK_ERROR_REFUSED = -15     /* Peer could not take the keys early data used */
 } network_error_t;
 
 /* Connection states */
@@ -45,6 +67,14 @@ typedef enum {
     STATE_ERROR
 } connection_state_t;
 
+/* Socket tuning profiles (see network_set_default_profile) */
+typedef enum {
+    NETWORK_PROFILE_DEFAULT = 0,    /* Kernel defaults */
+    NETWORK_PROFILE_INTERACTIVE,    /* Small messages: no Nagle, quick ACKs, busy polling */
+    NETWORK_PROFILE_BULK,           /* Throughput: large autotuned buffers */
+    NETWORK_PROFILE_WAN             /* Long fat paths: BBR, bounded unsent data */
+} network_profile_t;
+
 /* Connection information */
 typedef struct {
     connection_state_t state;
@@ -56,6 +86,10 @@ typedef struct {
     uint64_t bytes_received;
     uint32_t packets_sent;
     uint32_t packets_received;
+    uint64_t send_calls;            /* Write syscalls issued */
+    uint64_t zerocopy_sends;        /* Of which used MSG_ZEROCOPY */
+    uint64_t zerocopy_copied;       /* Zerocopy sends the kernel copied anyway */
+    int kernel_crypto;              /* NETWORK_KERNEL_CRYPTO_* offloaded directions */
     time_t connection_time;
     time_t idle_time;
 } connection_info_t;
@@ -97,6 +131,42 @@ connection_t* accept_connection(connection_t *listener);
  */
 connection_t* connect_to_host(const char *host, int port, const char *password);
 
+/**
+ * Create a listening Unix-domain socket at a filesystem path. Local
+ * peers speak the same protocol and handshake as over TCP without the
+ * TCP/IP stack. A socket file left by a listener that has died is
+ * replaced; the path is not removed on close. Who may connect is
+ * decided by the permissions of the path's directory.
+ * 
+ * @param path Socket path
+ * @param seqpacket Use SOCK_SEQPACKET instead of SOCK_STREAM
+ * @param password Optional encryption password
+ * @return Pointer to listener connection, or NULL on failure
+ */
+connection_t* create_unix_listener(const char *path, int seqpacket, const char *password);
+
+/**
+ * Connect to a Unix-domain socket.
+ * 
+ * @param path Socket path
+ * @param seqpacket Use SOCK_SEQPACKET; must match the listener
+ * @param password Optional encryption password
+ * @return Pointer to new connection, or NULL on failure
+ */
+connection_t* connect_to_unix(const char *path, int seqpacket, const char *password);
+
+/**
+ * Wrap an already connected stream or seqpacket socket, such as one end
+ * of create_socket_pair() or a socket inherited from a parent process,
+ * in a connection. Encrypted connections perform the handshake next,
+ * as after connect_to_host().
+ * 
+ * @param sockfd Connected socket (owned by the connection on success)
+ * @param password Optional encryption password
+ * @return Pointer to new connection, or NULL on failure
+ */
+connection_t* connection_from_socket(int sockfd, const char *password);
+
 /**
  * Send data through a connection.
  * 
@@ -108,17 +178,76 @@ connection_t* connect_to_host(const char *host, int port, const char *password);
 int send_data(connection_t *conn, const unsigned char *data, size_t len);
 
 /**
- * Receive data from a connection.
+ * Get room to assemble one outgoing message in the connection's send
+ * ring, so it can be passed to send_data() without a stack or heap copy.
+ * The buffer is valid until the next send on the connection; call with
+ * the send lock held.
+ * 
+ * @param conn Connection handle
+ * @param len Message length
+ * @return Buffer of len bytes, or NULL on allocation failure
+ */
+unsigned char* connection_send_buffer(connection_t *conn, size_t len);
+
+/**
+ * Receive data from a connection. On an encrypted connection each call
+ * returns one whole record, which must fit the buffer.
  * 
  * @param conn Connection handle
  * @param buffer Buffer to store received data
  * @param max_len Maximum bytes to receive
- * @return Number of bytes received, or error code on failure
+ * @return Number of bytes received, 0 if none are ready, or error code
+ *         on failure
  */
 int receive_data(connection_t *conn, unsigned char *buffer, size_t max_len);
 
 /**
- * Close a connection and free all resources.
+ * Receive one complete frame. A clear frame is a header_len-byte header
+ * holding its body length as a big-endian 32-bit value at length_offset,
+ * then the body; an encrypted connection's frame is one record, opened
+ * in place. Bytes of a partial frame stay staged in the connection
+ * across calls, and no byte past the frame is read off the socket. The
+ * frame is valid until the next receive on the connection.
+ * 
+ * @param conn Connection handle
+ * @param header_len Clear frame header length
+ * @param length_offset Offset of the body length within the header
+ * @param max_len Largest frame accepted, header included
+ * @param frame Output: the frame, in the connection's input buffer
+ * @param frame_len Output: frame length
+ * @return Bytes taken off the connection once a frame is complete, 0
+ *         while it is still arriving, or error code on failure
+ */
+int receive_frame(connection_t *conn, size_t header_len, size_t length_offset,
+                  size_t max_len, unsigned char **frame, size_t *frame_len);
+
+/**
+ * Send an empty record: the length prefix of a sealed record with no
+ * body. It tells a peer sealing under keys this side turned down that
+ * its sealed records have been skipped, and, sent back, ends them. The
+ * connection must have no session attached. Caller must hold the send lock.
+ * 
+ * @param conn Connection handle
+ * @return Bytes sent, or error code on failure
+ */
+int send_empty_record(connection_t *conn);
+
+/**
+ * Skip sealed records the peer sent under keys this side turned down,
+ * up to and including the empty record that ends them. Nothing is
+ * opened; records larger than max_len plus overhead fail the connection.
+ * 
+ * @param conn Connection handle
+ * @param max_len Largest record payload accepted
+ * @return 1 once the empty record is consumed, 0 while records are
+ *         still arriving, or error code on failure
+ */
+int discard_sealed_records(connection_t *conn, size_t max_len);
+
+/**
+ * Close a connection and free all resources but the handle itself,
+ * which the caller then free()s. get_connection_info() on a closed
+ * connection reports no peer address or zerocopy counters.
  * 
  * @param conn Connection to close
  */
@@ -180,10 +309,397 @@ void set_connection_user_data(connection_t *conn, void *user_data);
  */
 void* get_connection_user_data(connection_t *conn);
 
+/**
+ * Get the underlying socket descriptor of a connection.
+ * 
+ * @param conn Connection handle
+ * @return Socket file descriptor, or -1 if the connection is closed
+ */
+int get_connection_socket(connection_t *conn);
+
+/**
+ * Acquire the per-connection send lock.
+ * Held across sequence allocation and the socket write so that messages
+ * from concurrent senders reach the wire in sequence order.
+ * 
+ * @param conn Connection handle
+ */
+void lock_connection_send(connection_t *conn);
+
+/**
+ * Release the per-connection send lock.
+ * 
+ * @param conn Connection handle
+ */
+void unlock_connection_send(connection_t *conn);
+
+/**
+ * Allocate the next outgoing message sequence number.
+ * Caller must hold the send lock.
+ * 
+ * @param conn Connection handle
+ * @return Sequence number
+ */
+uint64_t next_send_sequence(connection_t *conn);
+
+/**
+ * Get the next outgoing message sequence number without allocating it.
+ * 
+ * @param conn Connection handle
+ * @return Sequence number
+ */
+uint64_t get_send_sequence(connection_t *conn);
+
+/**
+ * Restart outgoing message sequence numbers, for a peer that dropped
+ * messages it could not open. Caller must hold the send lock.
+ * 
+ * @param conn Connection handle
+ * @param sequence Sequence number the next message gets
+ */
+void set_send_sequence(connection_t *conn, uint64_t sequence);
+
+/**
+ * Check an incoming message sequence number and advance the expected one.
+ * Only one thread may receive on a connection at a time.
+ * 
+ * @param conn Connection handle
+ * @param sequence Sequence number from the message header
+ * @return 1 if it is the expected sequence, 0 otherwise
+ */
+int check_receive_sequence(connection_t *conn, uint64_t sequence);
+
+/**
+ * Install a crypto session on a connection (e.g. a resumed session).
+ * The connection takes ownership and destroys it on close.
+ * 
+ * @param conn Connection handle
+ * @param session Crypto session
+ */
+void set_connection_crypto(connection_t *conn, crypto_session_t *session);
+
+/**
+ * Get the crypto session of a connection.
+ * 
+ * @param conn Connection handle
+ * @return Crypto session, or NULL if keys are not established
+ */
+crypto_session_t* get_connection_crypto(connection_t *conn);
+
+/**
+ * Attach negotiated compression state to a connection.
+ * The connection takes ownership and destroys it on close.
+ * 
+ * @param conn Connection handle
+ * @param ctx Compression context (NULL to disable compression)
+ */
+void set_connection_compression(connection_t *conn, compression_ctx_t *ctx);
+
+/**
+ * Get compression state attached to a connection.
+ * 
+ * @param conn Connection handle
+ * @return Compression context, or NULL if compression is off
+ */
+compression_ctx_t* get_connection_compression(connection_t *conn);
+
+/**
+ * Route a connection's socket writes through an I/O backend.
+ * send_data() still encrypts, then hands the record to the hook.
+ * 
+ * @param conn Connection handle
+ * @param hook Send hook (NULL to restore send())
+ * @param ctx Hook context
+ */
+void set_connection_send_hook(connection_t *conn, connection_send_hook_t hook, void *ctx);
+
+/**
+ * Make receive_data() read from staged input instead of the socket.
+ * Used when an I/O backend reads the socket itself. Input still staged
+ * when it is switched off is read before the socket.
+ * 
+ * @param conn Connection handle
+ * @param enabled 1 to read staged input, 0 to read the socket
+ */
+void set_connection_staged_input(connection_t *conn, int enabled);
+
+/**
+ * Append bytes an I/O backend read off the connection's socket.
+ * 
+ * @param conn Connection handle
+ * @param data Received bytes
+ * @param len Number of bytes
+ * @return NETWORK_SUCCESS on success, error code on failure
+ */
+int stage_connection_input(connection_t *conn, const unsigned char *data, size_t len);
+
+/**
+ * Get the number of staged bytes not yet consumed by receive_data() or
+ * receive_frame(), including a partial frame.
+ * 
+ * @param conn Connection handle
+ * @return Pending byte count
+ */
+size_t connection_input_pending(connection_t *conn);
+
+/**
+ * Let send_data() return with output still queued.
+ * By default a record the socket cannot take at once is queued and
+ * send_data() sleeps on writability until it has drained. Event-driven
+ * callers enable this, flush on writability with flush_connection() and
+ * hold producers back while connection_send_blocked() is set.
+ * 
+ * @param conn Connection handle
+ * @param enabled 1 to leave output queued, 0 to wait for it
+ */
+void set_connection_async_send(connection_t *conn, int enabled);
+
+/**
+ * Set the output queue watermarks. Crossing high marks the connection
+ * blocked; it is released once the queue drains to low.
+ * 
+ * @param conn Connection handle
+ * @param high High watermark in bytes (0 = NETWORK_SEND_HIGH_WATERMARK)
+ * @param low Low watermark in bytes (0 = NETWORK_SEND_LOW_WATERMARK)
+ */
+void set_connection_watermarks(connection_t *conn, size_t high, size_t low);
+
+/**
+ * Hold sealed records in the output queue instead of writing each one.
+ * The owner flushes with flush_connection(), so every record sealed in
+ * between leaves in one gather write. notify runs when the queue goes
+ * from empty to non-empty, so the owner knows to schedule that flush.
+ * 
+ * @param conn Connection handle
+ * @param enabled 1 to cork, 0 to write on every send_data()
+ * @param notify Queue-nonempty hook (may be NULL)
+ * @param ctx Hook context
+ */
+void set_connection_cork(connection_t *conn, int enabled,
+                         connection_output_hook_t notify, void *ctx);
+
+/**
+ * Choose when records of NETWORK_ZEROCOPY_THRESHOLD bytes or more are
+ * sent with MSG_ZEROCOPY. Such records are sealed into buffers of their
+ * own that stay allocated until the kernel reports completion on the
+ * socket error queue. By default (-1) zerocopy turns itself off once the
+ * kernel keeps copying anyway, as it does on loopback.
+ * 
+ * @param conn Connection handle
+ * @param enabled 1 to always use it, 0 to never use it, -1 for automatic
+ */
+void set_connection_zerocopy(connection_t *conn, int enabled);
+
+/**
+ * Write queued output until it is gone or the socket would block.
+ * Queued records are gathered into as few sendmsg() calls as possible,
+ * partially written records resume where they stopped, and finished
+ * zerocopy sends are collected.
+ * 
+ * @param conn Connection handle
+ * @return Bytes still queued (0 when drained), or error code on failure
+ */
+int flush_connection(connection_t *conn);
+
+/**
+ * Get the descriptor that becomes readable when closed connections have
+ * zerocopy completions to collect. close_connection() does not wait for
+ * output the kernel still references: the socket stays open on a reap
+ * list until its completions free that output (or it is reset after 10
+ * seconds). Event loops watch this descriptor and call
+ * network_reap_closed() when it fires; without one, each
+ * close_connection() sweeps the list.
+ * 
+ * @return Descriptor to poll for input, or -1 if there is no reap list
+ */
+int network_reap_fd(void);
+
+/**
+ * Collect completions for sockets on the reap list and close those the
+ * kernel has released. Never blocks.
+ * 
+ * @return Number of closed sockets still waiting
+ */
+int network_reap_closed(void);
+
+/**
+ * Get the number of bytes queued but not yet written to the socket.
+ * 
+ * @param conn Connection handle
+ * @return Pending byte count
+ */
+size_t connection_output_pending(connection_t *conn);
+
+/**
+ * Check whether producers should stop sending: set when the output queue
+ * crosses the high watermark, cleared when it drains to the low one.
+ * 
+ * @param conn Connection handle
+ * @return 1 if blocked, 0 otherwise
+ */
+int connection_send_blocked(connection_t *conn);
+
+/**
+ * Check whether send_data() and receive_data() use the socket directly,
+ * i.e. no I/O backend owns its reads or writes. Socket-level offloads
+ * such as kernel TLS are only possible then.
+ * 
+ * @param conn Connection handle
+ * @return 1 if the connection owns its socket, 0 otherwise
+ */
+int connection_owns_socket(connection_t *conn);
+
+/**
+ * Mark directions whose records the kernel now encrypts and decrypts
+ * (kernel TLS), so send_data() and receive_data() pass them through
+ * without sealing in user space. Large records also stop using
+ * MSG_ZEROCOPY once TX is offloaded.
+ * 
+ * @param conn Connection handle
+ * @param directions NETWORK_KERNEL_CRYPTO_TX and/or NETWORK_KERNEL_CRYPTO_RX
+ */
+void set_connection_kernel_crypto(connection_t *conn, int directions);
+
+/**
+ * Get the directions offloaded with set_connection_kernel_crypto().
+ * 
+ * @param conn Connection handle
+ * @return NETWORK_KERNEL_CRYPTO_* bits
+ */
+int connection_kernel_crypto(connection_t *conn);
+
+/**
+ * Attach a datagram channel (see datagram_open()). The connection owns
+ * it from then on and closes it in close_connection().
+ * 
+ * @param conn Connection handle
+ * @param dg Datagram channel, or NULL to close the current one
+ */
+void set_connection_datagram(connection_t *conn, datagram_t *dg);
+
+/**
+ * Attach protocol state for messages sent before the peer has taken the
+ * session keys (0-RTT early data). While it is attached, an empty record
+ * from the peer makes receive_frame() return NETWORK_ERROR_REFUSED:
+ * the peer turned the keys down and its input continues in the clear.
+ * 
+ * @param conn Connection handle
+ * @param early Early data state, or NULL to release the current one
+ * @param release Frees early when it is replaced or the connection closes
+ */
+void set_connection_early_data(connection_t *conn, void *early, void (*release)(void *early));
+
+/**
+ * Get the early data state.
+ * 
+ * @param conn Connection handle
+ * @return Early data state, or NULL if none is attached
+ */
+void* get_connection_early_data(connection_t *conn);
+
+/**
+ * Get the connection's datagram channel, opened by either peer.
+ * 
+ * @param conn Connection handle
+ * @return Datagram channel, or NULL if none is open
+ */
+datagram_t* get_connection_datagram(connection_t *conn);
+
+/**
+ * Write part of a file straight from the page cache with sendfile(),
+ * after any queued output. Only allowed where records are not sealed in
+ * user space: unencrypted connections or kernel TLS TX. Blocks until the
+ * range is written.
+ * 
+ * @param conn Connection handle
+ * @param file_fd File descriptor to read from
+ * @param offset File offset of the first byte
+ * @param len Number of bytes
+ * @return NETWORK_SUCCESS on success, error code on failure
+ */
+int send_file_range(connection_t *conn, int file_fd, uint64_t offset, size_t len);
+
+/**
+ * Write part of a file with sendfile() without sealing it, even on an
+ * encrypted connection. For integrity-only bulk transfers that
+ * authenticate the data by other means; the peer reads it with
+ * receive_file_range_clear().
+ * 
+ * @param conn Connection handle
+ * @param file_fd File descriptor to read from
+ * @param offset File offset of the first byte
+ * @param len Number of bytes
+ * @return NETWORK_SUCCESS on success, error code on failure
+ */
+int send_file_range_clear(connection_t *conn, int file_fd, uint64_t offset, size_t len);
+
+/**
+ * Read len unsealed bytes off the socket into a file at offset, with
+ * splice() through a pipe where the file allows it. Must be called
+ * before the next receive_data(), and not on connections whose input an
+ * I/O backend stages. Blocks until the range is written.
+ * 
+ * @param conn Connection handle
+ * @param file_fd File descriptor to write to
+ * @param offset File offset of the first byte
+ * @param len Number of bytes
+ * @return NETWORK_SUCCESS on success, error code on failure
+ */
+int receive_file_range_clear(connection_t *conn, int file_fd, uint64_t offset, size_t len);
+
+/**
+ * Choose the tuning profile applied to sockets created from now on:
+ * listeners (and so the connections they accept) and outgoing connects.
+ * Options the kernel refuses, such as SO_BUSY_POLL without
+ * CAP_NET_ADMIN or a congestion control that is not allowed, are
+ * skipped. Buffer sizes are left to autotuning when its ceiling covers
+ * the profile's hint. network_init() reads CRYPTCAT_SOCKET_PROFILE.
+ * 
+ * @param profile Profile for new sockets
+ */
+void network_set_default_profile(network_profile_t profile);
+
+/**
+ * Get the profile applied to new sockets.
+ * 
+ * @return Current default profile
+ */
+network_profile_t network_get_default_profile(void);
+
+/**
+ * Apply a tuning profile to an established connection. Buffer sizes
+ * set after the handshake do not change the negotiated window scale,
+ * so prefer network_set_default_profile() before connecting.
+ * 
+ * @param conn Connection handle
+ * @param profile Profile to apply
+ * @return NETWORK_SUCCESS on success, error code on failure
+ */
+int set_connection_profile(connection_t *conn, network_profile_t profile);
+
+/**
+ * Look up a profile by name ("default", "interactive", "bulk", "wan").
+ * 
+ * @param name Profile name
+ * @param profile Output: profile
+ * @return NETWORK_SUCCESS on success, NETWORK_ERROR_PARAM if unknown
+ */
+int network_profile_parse(const char *name, network_profile_t *profile);
+
+/**
+ * Get a profile's name.
+ * 
+ * @param profile Profile
+ * @return Profile name
+ */
+const char* network_profile_name(network_profile_t profile);
+
 /* ========== Advanced Network Functions ========== */
 
 /**
- * Create a socket pair for inter-process communication.
+ * Create a socket pair for inter-process communication: connected
+ * Unix-domain stream sockets, usable as a channel for pass_connection()
+ * or wrapped with connection_from_socket().
  * 
  * @param sv Array of two socket file descriptors
  * @return NETWORK_SUCCESS on success, error code on failure
@@ -198,6 +714,40 @@ int create_socket_pair(int sv[2]);
  */
 int set_nonblocking(int sockfd);
 
+/**
+ * Hand a connection to another process over a Unix-domain stream
+ * socket. The socket travels as SCM_RIGHTS and the session state (keys,
+ * cipher stream positions, sequence numbers, packets read but not yet
+ * received) travels with it, so the receiver resumes without a new
+ * handshake. Queued output is written first. Connections with
+ * compression, a datagram channel or an I/O backend attached cannot be
+ * passed; input staged by a backend that has since been detached is
+ * carried. Listeners may be passed too.
+ * 
+ * The message holds session keys in the clear: use a socketpair or a
+ * socket whose peer is trusted (e.g. checked with SO_PEERCRED).
+ * 
+ * On success the connection is closed without shutting the socket down;
+ * the caller still frees the structure.
+ * 
+ * @param channel_fd Unix-domain stream socket to the receiving process
+ * @param conn Connection to pass
+ * @param timeout_ms Longest wait for queued output and the channel
+ * @return NETWORK_SUCCESS on success, error code on failure (the
+ *         connection is left usable unless the error came from its socket)
+ */
+int pass_connection(int channel_fd, connection_t *conn, int timeout_ms);
+
+/**
+ * Take over a connection sent with pass_connection().
+ * 
+ * @param channel_fd Unix-domain stream socket from the passing process
+ * @param timeout_ms Longest wait for the message
+ * @return Pointer to the connection in the state it was passed in, or
+ *         NULL on failure
+ */
+connection_t* accept_passed_connection(int channel_fd, int timeout_ms);
+
 /**
  * Wait for socket to become ready for I/O.
  * 
@@ -209,6 +759,20 @@ int set_nonblocking(int sockfd);
  */
 int wait_for_socket(int sockfd, int timeout_ms, int wait_for_read, int wait_for_write);
 
+/**
+ * Wait for a connection's socket to become ready for I/O. Unlike
+ * wait_for_socket(), zerocopy completions (which wake poll() as errors)
+ * are collected and the wait continues.
+ * 
+ * @param conn Connection handle
+ * @param timeout_ms Timeout in milliseconds
+ * @param wait_for_read Wait for read readiness
+ * @param wait_for_write Wait for write readiness
+ * @return 1 if ready, 0 if timeout, -1 on error
+ */
+int wait_for_connection(connection_t *conn, int timeout_ms, int wait_for_read,
+                        int wait_for_write);
+
 #ifdef __cplusplus
 }
 #endif
@@ -8,6 +8,8 @@
 
 #include <stddef.h>
 #include <stdint.h>
+#include <stdio.h>
+#include <time.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -26,6 +28,9 @@ typedef enum {
     PLATFORM_ERROR_TIMEOUT = -8
 } platform_error_t;
 
+/* Coarse clock refresh period */
+#define PLATFORM_COARSE_CLOCK_TICK_MS 10
+
 /* Thread and mutex types */
 typedef void* platform_thread_t;
 typedef void* platform_mutex_t;
@@ -103,12 +108,37 @@ int platform_random_seed(void);
 void platform_sleep_ms(int milliseconds);
 
 /**
- * Get current time in milliseconds.
+ * Get monotonic time in milliseconds, for timeouts and intervals.
+ * Unaffected by wall-clock steps; unrelated to the time of day.
  * 
- * @return Current time in milliseconds
+ * @return Milliseconds since an arbitrary fixed point
  */
 uint64_t platform_get_time_ms(void);
 
+/**
+ * Get coarse monotonic time in milliseconds, for per-record timestamps
+ * and stall checks. The value is cached process-wide and refreshed
+ * every PLATFORM_COARSE_CLOCK_TICK_MS by a ticker thread started on
+ * first use, so a read is one relaxed atomic load instead of a
+ * clock_gettime() call.
+ * 
+ * @return Monotonic time in milliseconds, about one tick behind
+ */
+uint64_t platform_coarse_monotonic_ms(void);
+
+/**
+ * Get coarse wall-clock time; a cheap replacement for time(NULL) on
+ * hot paths, read from the same cache as platform_coarse_monotonic_ms().
+ * 
+ * @return Seconds since the epoch
+ */
+time_t platform_coarse_time(void);
+
+/**
+ * Refresh the coarse clock now, e.g. after a long sleep.
+ */
+void platform_coarse_clock_update(void);
+
 /* ========== Network Utilities ========== */
 
 /**
@@ -171,6 +201,15 @@ void platform_thread_join(platform_thread_t thread);
  */
 void platform_thread_detach(platform_thread_t thread);
 
+/**
+ * Restrict a thread to one CPU.
+ * 
+ * @param thread Thread handle
+ * @param cpu CPU index
+ * @return PLATFORM_SUCCESS on success, error code on failure
+ */
+int platform_thread_set_affinity(platform_thread_t thread, int cpu);
+
 /**
  * Create a mutex.
  * 
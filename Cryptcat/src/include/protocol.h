@@ -15,6 +15,7 @@ extern "C" {
 /* Error codes */
 typedef enum {
     PROTOCOL_SUCCESS = 0,
+    PROTOCOL_IN_PROGRESS = 1,
     PROTOCOL_ERROR_PARAM = -1,
     PROTOCOL_ERROR_STATE = -2,
     PROTOCOL_ERROR_NETWORK = -3,
@@ -34,20 +35,49 @@ typedef enum {
     MSG_HANDSHAKE_INIT = 0x01,
     MSG_HANDSHAKE_RESPONSE = 0x02,
     MSG_HANDSHAKE_COMPLETE = 0x03,
+    MSG_SESSION_TICKET = 0x04,
+    MSG_KTLS_REQUEST = 0x05,
+    MSG_KTLS_RESPONSE = 0x06,
+    MSG_DGRAM_REQUEST = 0x07,
+    MSG_DGRAM_RESPONSE = 0x08,
     MSG_DATA = 0x10,
     MSG_FILE_START = 0x20,
     MSG_FILE_CHUNK = 0x21,
     MSG_FILE_END = 0x22,
+    MSG_WINDOW_UPDATE = 0x23,
+    MSG_FILE_BULK = 0x24,
+    MSG_FILE_STRIPE = 0x25,
+    MSG_STRIPE_JOIN = 0x26,
     MSG_KEEPALIVE = 0x30,
     MSG_DISCONNECT = 0x40,
     MSG_ERROR = 0xFF
 } message_type_t;
 
+/* Opaque handshake state machine */
+typedef struct handshake_s handshake_t;
+
+/* Told on a key derivation thread that a handshake's keys are ready */
+typedef void (*handshake_notify_t)(void *ctx, connection_t *conn);
+
+/* Handshake latency by phase (microseconds) */
+typedef struct {
+    uint32_t init_us;           /* Start until init sent (client) / received (server) */
+    uint32_t response_us;       /* Init until response received (client) / sent (server) */
+    uint32_t kdf_us;            /* Key derivation time on the worker */
+    uint32_t kdf_stall_us;      /* Time spent waiting for the KDF after the network was done */
+    uint32_t complete_us;       /* Keys ready until handshake finished */
+    uint32_t total_us;          /* Whole handshake */
+    int resumed;                /* Session resumed from a ticket (no KDF) */
+} handshake_timing_t;
+
 /* ========== Protocol Functions ========== */
 
 /**
  * Perform protocol handshake.
  * 
+ * Blocks the calling thread, which derives its own keys rather than
+ * waiting on the shared pool.
+ * 
  * @param conn Connection handle
  * @param is_server 1 if server, 0 if client
  * @param password Encryption password
@@ -55,6 +85,68 @@ typedef enum {
  */
 int perform_handshake(connection_t *conn, int is_server, const char *password);
 
+/**
+ * Start a non-blocking handshake.
+ * Password key derivation runs on a shared pool of at most one thread
+ * per CPU, so it overlaps the init/response round trip instead of
+ * preceding it. Handshakes beyond the pool's size queue for a thread.
+ * 
+ * @param conn Connection handle
+ * @param is_server 1 if server, 0 if client
+ * @param password Encryption password
+ * @return Handshake state, or NULL on failure
+ */
+handshake_t* handshake_begin(connection_t *conn, int is_server, const char *password);
+
+/**
+ * Advance a handshake as far as possible without waiting longer than
+ * timeout_ms for the peer or for key derivation (0 = never block).
+ * 
+ * @param hs Handshake state
+ * @param timeout_ms Maximum time to wait for network or key derivation
+ * @return PROTOCOL_SUCCESS when done, PROTOCOL_IN_PROGRESS to call again,
+ *         error code on failure
+ */
+int handshake_step(handshake_t *hs, int timeout_ms);
+
+/**
+ * Check whether a pending handshake is blocked on key derivation rather
+ * than on the peer. Such a handshake makes progress without any socket
+ * becoming readable, so event loops re-step it when this turns 0.
+ * 
+ * @param hs Handshake state
+ * @return 1 if waiting for the KDF worker, 0 otherwise
+ */
+int handshake_waiting_for_keys(const handshake_t *hs);
+
+/**
+ * Be told when key derivation finishes instead of polling
+ * handshake_waiting_for_keys(). The callback runs on a pool thread with
+ * the pool locked, so it should only queue the connection and wake its
+ * owner. It is never called once handshake_free() has returned.
+ * 
+ * @param hs Handshake state
+ * @param notify Callback, or NULL for none
+ * @param ctx Passed to the callback
+ */
+void handshake_set_notify(handshake_t *hs, handshake_notify_t notify, void *ctx);
+
+/**
+ * Get handshake latency broken down by phase.
+ * 
+ * @param hs Handshake state
+ * @return Timing structure
+ */
+handshake_timing_t handshake_get_timing(const handshake_t *hs);
+
+/**
+ * Release handshake state (drops a queued key derivation and waits for
+ * a running one).
+ * 
+ * @param hs Handshake state
+ */
+void handshake_free(handshake_t *hs);
+
 /**
  * Send a protocol message.
  * 
@@ -70,11 +162,16 @@ int send_message(connection_t *conn, message_type_t type,
 /**
  * Receive a protocol message.
  * 
+ * On a connection resumed from a ticket the server has not confirmed
+ * yet, this may block for a full handshake: the server refused the
+ * ticket, and the messages sent since are sent again under the new keys.
+ * 
  * @param conn Connection handle
  * @param type Output: Message type
  * @param buffer Output buffer for payload
  * @param buffer_len Input: buffer size, Output: payload length
- * @return PROTOCOL_SUCCESS on success, error code on failure
+ * @return PROTOCOL_SUCCESS on success, PROTOCOL_IN_PROGRESS if a
+ *         non-blocking socket has nothing queued, error code on failure
  */
 int receive_message(connection_t *conn, message_type_t *type,
                    unsigned char *buffer, size_t *buffer_len);
@@ -111,6 +208,22 @@ int send_file_start(connection_t *conn, const char *filename, uint64_t file_size
 int send_file_chunk(connection_t *conn, const unsigned char *chunk_data,
                    size_t chunk_size, uint32_t chunk_number);
 
+/**
+ * Send a file chunk message whose data is written from the page cache
+ * with sendfile(). Requires kernel TLS for the send direction and no
+ * record compression; the header carries no checksum, since the data
+ * is never read in user space.
+ * 
+ * @param conn Connection handle
+ * @param file_fd File descriptor to read from
+ * @param offset File offset of the chunk
+ * @param chunk_size Chunk size
+ * @param chunk_number Chunk sequence number
+ * @return PROTOCOL_SUCCESS on success, error code on failure
+ */
+int send_file_chunk_from_fd(connection_t *conn, int file_fd, uint64_t offset,
+                            size_t chunk_size, uint32_t chunk_number);
+
 /**
  * Send file transfer complete message.
  * 
@@ -120,6 +233,85 @@ int send_file_chunk(connection_t *conn, const unsigned char *chunk_data,
  */
 int send_file_end(connection_t *conn, const unsigned char *checksum);
 
+/**
+ * Send file transfer window update (receiver-advertised credit).
+ *
+ * @param conn Connection handle
+ * @param bytes_consumed Bytes written to disk by the receiver so far
+ * @param credit_limit Absolute file offset the sender may send up to
+ * @return PROTOCOL_SUCCESS on success, error code on failure
+ */
+int send_window_update(connection_t *conn, uint64_t bytes_consumed,
+                      uint64_t credit_limit);
+
+/**
+ * Send a bulk file chunk for an integrity-only transfer: a sealed
+ * MSG_FILE_BULK header, then length file bytes written unsealed with
+ * sendfile(). The data is authenticated by the transfer's integrity tag,
+ * not per message.
+ * 
+ * @param conn Connection handle
+ * @param file_fd File descriptor to read from
+ * @param offset File offset of the chunk
+ * @param length Chunk size
+ * @param chunk_number Chunk sequence number
+ * @return PROTOCOL_SUCCESS on success, error code on failure
+ */
+int send_file_bulk(connection_t *conn, int file_fd, uint64_t offset,
+                   size_t length, uint32_t chunk_number);
+
+/**
+ * Parse a MSG_FILE_BULK payload. The length raw bytes that follow it
+ * must be read with receive_file_range_clear() before the next message.
+ *
+ * @param payload Message payload
+ * @param payload_len Payload length
+ * @param chunk_number Output: chunk sequence number
+ * @param length Output: raw bytes following the message
+ * @return PROTOCOL_SUCCESS on success, error code on failure
+ */
+int parse_file_bulk(const unsigned char *payload, size_t payload_len,
+                    uint32_t *chunk_number, uint32_t *length);
+
+/**
+ * Send a chunk of a striped transfer. Lanes carry chunks in any order,
+ * so each is placed by its file offset rather than numbered.
+ * 
+ * @param conn Lane connection
+ * @param offset File offset of the chunk
+ * @param chunk_data File chunk data
+ * @param chunk_size Chunk size
+ * @return PROTOCOL_SUCCESS on success, error code on failure
+ */
+int send_file_stripe(connection_t *conn, uint64_t offset,
+                     const unsigned char *chunk_data, size_t chunk_size);
+
+/**
+ * Parse a MSG_FILE_STRIPE payload.
+ *
+ * @param payload Message payload
+ * @param payload_len Payload length
+ * @param offset Output: file offset of the chunk
+ * @param chunk_data Output: chunk data within the payload
+ * @param chunk_size Output: chunk size
+ * @return PROTOCOL_SUCCESS on success, error code on failure
+ */
+int parse_file_stripe(const unsigned char *payload, size_t payload_len,
+                      uint64_t *offset, const unsigned char **chunk_data,
+                      size_t *chunk_size);
+
+/**
+ * Parse a window update payload.
+ *
+ * @param payload Message payload
+ * @param payload_len Payload length
+ * @param bytes_consumed Output: bytes consumed by the receiver
+ * @param credit_limit Output: absolute offset the sender may send up to
+ * @return PROTOCOL_SUCCESS on success, error code on failure
+ */
+int parse_window_update(const unsigned char *payload, size_t payload_len,
+                       uint64_t *bytes_consumed, uint64_t *credit_limit);
+
 /**
  * Send keepalive message.
  * 
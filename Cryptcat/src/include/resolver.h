@@ -0,0 +1,140 @@
+/*
+ * Cryptcat Resolver API
+ * Header file for resolver.c
+ */
+
+#ifndef RESOLVER_H
+#define RESOLVER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <sys/socket.h>
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Addresses kept per name */
+#define RESOLVER_MAX_ADDRESSES 16
+
+/* Default cache lifetimes */
+#define RESOLVER_DEFAULT_TTL_MS 60000
+#define RESOLVER_DEFAULT_NEGATIVE_TTL_MS 5000
+
+/* Error codes */
+typedef enum {
+    RESOLVER_SUCCESS = 0,
+    RESOLVER_ERROR_PARAM = -1,
+    RESOLVER_ERROR_MEMORY = -2,
+    RESOLVER_ERROR_NOT_FOUND = -3,
+    RESOLVER_ERROR_TEMPORARY = -4,
+    RESOLVER_ERROR_BUSY = -5,
+    RESOLVER_ERROR_SYSTEM = -6
+} resolver_error_t;
+
+/* One resolved address, port included */
+typedef struct {
+    struct sockaddr_storage addr;
+    socklen_t addr_len;
+    int family;
+} resolver_address_t;
+
+/* Every address of a name, in the system resolver's preference order */
+typedef struct {
+    int count;
+    resolver_address_t addrs[RESOLVER_MAX_ADDRESSES];
+} resolver_addresses_t;
+
+/* Resolver statistics */
+typedef struct {
+    uint64_t lookups;               /* Names asked for */
+    uint64_t hits;                  /* Answered from the cache */
+    uint64_t negative_hits;         /* Answered "no such name" from the cache */
+    uint64_t misses;                /* Sent to getaddrinfo() */
+    uint64_t coalesced;             /* Joined a lookup already in flight */
+    uint32_t entries;               /* Names cached now */
+} resolver_stats_t;
+
+/**
+ * Completion callback for resolver_resolve_async(). Runs on a resolver
+ * thread, or on the calling thread when the answer was cached.
+ *
+ * @param ctx Caller context
+ * @param status RESOLVER_SUCCESS or error code
+ * @param addresses Addresses on success (valid during the call only)
+ */
+typedef void (*resolver_callback_t)(void *ctx, int status,
+                                    const resolver_addresses_t *addresses);
+
+/**
+ * Resolve a host name, waiting for the answer.
+ * Answers are cached process-wide: successes for the positive TTL and
+ * "no such name" for the negative TTL. Concurrent lookups of one name
+ * share a single getaddrinfo() call. Numeric addresses bypass the cache.
+ *
+ * @param host Host name or numeric address
+ * @param port Port stored in every address
+ * @param addresses Output: resolved addresses
+ * @return RESOLVER_SUCCESS on success, error code on failure
+ */
+int resolver_resolve(const char *host, int port, resolver_addresses_t *addresses);
+
+/**
+ * Resolve a host name without blocking the caller. getaddrinfo() runs
+ * on a small pool of resolver threads, started on first use.
+ *
+ * @param host Host name or numeric address
+ * @param port Port stored in every address
+ * @param callback Completion callback (called exactly once on success)
+ * @param ctx Callback context
+ * @return RESOLVER_SUCCESS if the callback was or will be called, error
+ *         code otherwise
+ */
+int resolver_resolve_async(const char *host, int port,
+                           resolver_callback_t callback, void *ctx);
+
+/**
+ * Set cache lifetimes. getaddrinfo() does not report record TTLs, so
+ * these cap how long an answer is trusted.
+ *
+ * @param ttl_ms Lifetime of a successful answer (0 = no caching)
+ * @param negative_ttl_ms Lifetime of a "no such name" answer (0 = no caching)
+ */
+void resolver_set_ttl(int ttl_ms, int negative_ttl_ms);
+
+/**
+ * Drop every cached answer. Lookups in flight are not affected.
+ */
+void resolver_flush(void);
+
+/**
+ * Get resolver statistics.
+ *
+ * @return Statistics structure
+ */
+resolver_stats_t resolver_get_stats(void);
+
+/**
+ * Stop the resolver threads once queued lookups have finished.
+ */
+void resolver_shutdown(void);
+
+/**
+ * Get human-readable error message for resolver error.
+ *
+ * @param error_code Error code
+ * @return Error message string
+ */
+const char* resolver_strerror(int error_code);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* RESOLVER_H */
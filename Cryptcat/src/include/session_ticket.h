@@ -0,0 +1,128 @@
+/*
+ * Cryptcat Session Ticket API
+ * Header file for session_ticket.c
+ */
+
+#ifndef SESSION_TICKET_H
+#define SESSION_TICKET_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "crypto.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Client nonce carried in a resuming MSG_HANDSHAKE_INIT */
+#define SESSION_TICKET_NONCE_SIZE 16
+
+/* Largest sealed ticket on the wire */
+#define SESSION_TICKET_MAX_SIZE 160
+
+/* Ticket lifetime advertised to clients (seconds) */
+#define SESSION_TICKET_LIFETIME 3600
+
+/* Error codes */
+typedef enum {
+    TICKET_SUCCESS = 0,
+    TICKET_ERROR_PARAM = -1,
+    TICKET_ERROR_MEMORY = -2,
+    TICKET_ERROR_CRYPTO = -3,
+    TICKET_ERROR_MALFORMED = -4,
+    TICKET_ERROR_UNKNOWN_KEY = -5,
+    TICKET_ERROR_EXPIRED = -6,
+    TICKET_ERROR_REPLAY = -7,
+    TICKET_ERROR_NOT_FOUND = -8
+} ticket_error_t;
+
+/* Resumption state sealed inside a ticket */
+typedef struct {
+    unsigned char secret[CRYPTO_SECRET_SIZE];  /* Session secret */
+    uint8_t codec;                             /* Negotiated compression codec */
+} session_resumption_t;
+
+/* ========== Server Side ========== */
+
+/**
+ * Seal resumption state into a ticket under the current ticket key.
+ * Ticket keys rotate automatically; only a bounded number are retained.
+ *
+ * @param state Resumption state
+ * @param ticket Output buffer (at least SESSION_TICKET_MAX_SIZE)
+ * @param ticket_len Input: buffer size, Output: ticket length
+ * @return TICKET_SUCCESS on success, error code on failure
+ */
+int session_ticket_issue(const session_resumption_t *state,
+                        unsigned char *ticket, size_t *ticket_len);
+
+/**
+ * Open a ticket presented by a client.
+ * Each ticket is accepted at most once; a second presentation is
+ * reported as TICKET_ERROR_REPLAY. Once more tickets have been redeemed
+ * than the server can remember, the oldest are refused the same way.
+ *
+ * @param ticket Sealed ticket
+ * @param ticket_len Ticket length
+ * @param state Output: resumption state
+ * @return TICKET_SUCCESS on success, error code on failure
+ */
+int session_ticket_redeem(const unsigned char *ticket, size_t ticket_len,
+                         session_resumption_t *state);
+
+/**
+ * Force a ticket key rotation.
+ * Tickets sealed under retired keys stay valid until their key is evicted.
+ */
+void session_ticket_rotate_keys(void);
+
+/* ========== Client Side ========== */
+
+/**
+ * Remember a ticket received from a server.
+ *
+ * @param host Server host
+ * @param port Server port
+ * @param ticket Sealed ticket
+ * @param ticket_len Ticket length
+ * @param lifetime Ticket lifetime in seconds
+ * @param state Resumption state for the ticket
+ * @return TICKET_SUCCESS on success, error code on failure
+ */
+int session_ticket_store_put(const char *host, int port,
+                            const unsigned char *ticket, size_t ticket_len,
+                            uint32_t lifetime, const session_resumption_t *state);
+
+/**
+ * Take (and forget) a stored ticket for a server.
+ * Tickets are single use, so a ticket is never presented twice.
+ *
+ * @param host Server host
+ * @param port Server port
+ * @param ticket Output buffer (at least SESSION_TICKET_MAX_SIZE)
+ * @param ticket_len Input: buffer size, Output: ticket length
+ * @param state Output: resumption state
+ * @return TICKET_SUCCESS on success, TICKET_ERROR_NOT_FOUND if none
+ */
+int session_ticket_store_take(const char *host, int port,
+                             unsigned char *ticket, size_t *ticket_len,
+                             session_resumption_t *state);
+
+/**
+ * Wipe all ticket keys, replay history and stored tickets.
+ */
+void session_ticket_cleanup(void);
+
+/**
+ * Get human-readable error message for ticket error.
+ *
+ * @param error_code Error code
+ * @return Error message string
+ */
+const char* session_ticket_strerror(int error_code);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SESSION_TICKET_H */
@@ -0,0 +1,165 @@
+/*
+ * Cryptcat Striped Transfer API
+ * Header file for stripe.c
+ */
+
+#ifndef STRIPE_H
+#define STRIPE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "network.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Upper bound on parallel connections per transfer */
+#define STRIPE_MAX_LANES 16
+
+/* Random identifier tying lanes to their transfer */
+#define STRIPE_ID_SIZE 16
+
+/* File bytes per MSG_FILE_STRIPE; also the unit of work stealing */
+#define STRIPE_CHUNK_SIZE (32 * 1024)
+
+/* Receiving stripes waiting for lanes, process-wide */
+#define STRIPE_MAX_PENDING 16
+
+/* Error codes */
+typedef enum {
+    STRIPE_SUCCESS = 0,
+    STRIPE_IN_PROGRESS = 1,
+    STRIPE_ERROR_PARAM = -1,
+    STRIPE_ERROR_MEMORY = -2,
+    STRIPE_ERROR_NETWORK = -3,
+    STRIPE_ERROR_IO = -4,
+    STRIPE_ERROR_PROTOCOL = -5,
+    STRIPE_ERROR_THREAD = -6,
+    STRIPE_ERROR_TIMEOUT = -7,
+    STRIPE_ERROR_UNKNOWN = -8
+} stripe_error_t;
+
+/* Per-lane statistics */
+typedef struct {
+    uint64_t bytes;                 /* File bytes carried */
+    uint32_t chunks;
+    uint64_t rate;                  /* Bytes per second while the lane ran */
+    uint32_t steals;                /* Ranges taken over from other lanes */
+    int active;                     /* Thread still running */
+    int failed;                     /* Lane lost its connection */
+} stripe_lane_stats_t;
+
+/* Opaque striped transfer */
+typedef struct stripe_s stripe_t;
+
+/**
+ * Create the sending side of a striped transfer with a fresh random id.
+ * The id is announced to the receiver over the control connection
+ * before stripe_connect() opens the lanes.
+ *
+ * @param fd File descriptor to read with pread() (not owned)
+ * @param file_size Bytes to send from offset 0
+ * @return Pointer to new stripe, or NULL on failure
+ */
+stripe_t* stripe_create(int fd, uint64_t file_size);
+
+/**
+ * Create the receiving side of a striped transfer and register its id,
+ * so lanes presenting it with stripe_join() write into the file.
+ *
+ * @param fd File descriptor to write with pwrite() (not owned)
+ * @param file_size Expected file size
+ * @param id STRIPE_ID_SIZE byte id announced by the sender
+ * @return Pointer to new stripe, or NULL on failure
+ */
+stripe_t* stripe_expect(int fd, uint64_t file_size, const unsigned char *id);
+
+/**
+ * Get a stripe's id.
+ *
+ * @param stripe Striped transfer
+ * @return STRIPE_ID_SIZE bytes, valid for the stripe's lifetime
+ */
+const unsigned char* stripe_get_id(const stripe_t *stripe);
+
+/**
+ * Open lanes to the receiver and start sending. Each lane is its own
+ * authenticated connection with a sending thread. The file is split
+ * into one contiguous range of chunks per lane; a lane that runs out
+ * takes over the back half of the largest range left, so slow or
+ * failed lanes hand their work to fast ones.
+ *
+ * @param stripe Sending stripe
+ * @param host Receiver host
+ * @param port Receiver port
+ * @param password Session password
+ * @param lanes Connections to open (1 to STRIPE_MAX_LANES)
+ * @return Lanes started (at least one), or error code on failure
+ */
+int stripe_connect(stripe_t *stripe, const char *host, int port,
+                   const char *password, int lanes);
+
+/**
+ * Hand a connection that sent MSG_STRIPE_JOIN to its receiving stripe.
+ * On success the stripe owns the connection and a thread writes the
+ * chunks it carries; on failure the caller still owns it.
+ *
+ * @param conn Lane connection after a completed handshake
+ * @param payload MSG_STRIPE_JOIN payload
+ * @param payload_len Payload length
+ * @return STRIPE_SUCCESS on success, STRIPE_ERROR_UNKNOWN if no stripe
+ *         expects the id, error code on failure
+ */
+int stripe_join(connection_t *conn, const unsigned char *payload, size_t payload_len);
+
+/**
+ * Check a stripe without blocking.
+ *
+ * @param stripe Striped transfer
+ * @param bytes Output: distinct file bytes sent or written so far (may be NULL)
+ * @return STRIPE_SUCCESS when every chunk has been sent (sender) or
+ *         written (receiver), STRIPE_IN_PROGRESS while lanes work,
+ *         error code if no lane is left to finish
+ */
+int stripe_poll(stripe_t *stripe, uint64_t *bytes);
+
+/**
+ * Wait for a stripe to finish.
+ *
+ * @param stripe Striped transfer
+ * @param idle_timeout_ms Longest wait without progress
+ * @return STRIPE_SUCCESS when done, error code on failure or timeout
+ */
+int stripe_wait(stripe_t *stripe, int idle_timeout_ms);
+
+/**
+ * Get per-lane statistics, indexed by lane number.
+ *
+ * @param stripe Striped transfer
+ * @param lanes Output array
+ * @param max_lanes Array size
+ * @return Number of lanes filled in
+ */
+int stripe_get_lanes(stripe_t *stripe, stripe_lane_stats_t *lanes, int max_lanes);
+
+/**
+ * Stop lane threads, close their connections and destroy the stripe.
+ *
+ * @param stripe Striped transfer
+ */
+void stripe_destroy(stripe_t *stripe);
+
+/**
+ * Get human-readable error message for stripe error.
+ *
+ * @param error_code Error code
+ * @return Error message string
+ */
+const char* stripe_strerror(int error_code);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* STRIPE_H */
@@ -0,0 +1,119 @@
+/*
+ * Cryptcat Timer Wheel API
+ * Header file for timer_wheel.c
+ */
+
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Wheel geometry: 4 levels of 64 slots cover 2^24 ticks; later
+ * deadlines are carried over by the top level */
+#define TIMER_WHEEL_LEVELS 4
+#define TIMER_WHEEL_SLOT_BITS 6
+
+/* Error codes */
+typedef enum {
+    TIMER_WHEEL_SUCCESS = 0,
+    TIMER_WHEEL_ERROR_PARAM = -1,
+    TIMER_WHEEL_ERROR_MEMORY = -2
+} timer_wheel_error_t;
+
+/* Opaque wheel */
+typedef struct timer_wheel_s timer_wheel_t;
+
+/**
+ * Expiry callback for timer_wheel_advance(). The timer is disarmed
+ * before the call and may be scheduled again from it.
+ *
+ * @param ctx Context passed to timer_wheel_advance()
+ * @param id Timer that expired
+ */
+typedef void (*timer_wheel_callback_t)(void *ctx, uint32_t id);
+
+/**
+ * Create a hierarchical timing wheel. Timers are named by small dense
+ * integers (descriptors, table slots); arming, re-arming and cancelling
+ * are O(1), and expiry costs O(1) per timer plus one cascade per 64
+ * ticks. Timers never fire early and fire at most one tick late.
+ *
+ * @param tick_ms Resolution in milliseconds
+ * @param now_ms Current monotonic time in milliseconds
+ * @return Pointer to new wheel, or NULL on failure
+ */
+timer_wheel_t* timer_wheel_create(uint32_t tick_ms, uint64_t now_ms);
+
+/**
+ * Destroy a wheel.
+ *
+ * @param wheel Timer wheel
+ */
+void timer_wheel_destroy(timer_wheel_t *wheel);
+
+/**
+ * Arm a timer, replacing its previous expiry if it was armed.
+ *
+ * @param wheel Timer wheel
+ * @param id Timer id
+ * @param expires_ms Monotonic expiry time in milliseconds
+ * @return TIMER_WHEEL_SUCCESS on success, error code on failure
+ */
+int timer_wheel_schedule(timer_wheel_t *wheel, uint32_t id, uint64_t expires_ms);
+
+/**
+ * Disarm a timer. Does nothing if it is not armed.
+ *
+ * @param wheel Timer wheel
+ * @param id Timer id
+ */
+void timer_wheel_cancel(timer_wheel_t *wheel, uint32_t id);
+
+/**
+ * Check whether a timer is armed.
+ *
+ * @param wheel Timer wheel
+ * @param id Timer id
+ * @return 1 if armed, 0 otherwise
+ */
+int timer_wheel_pending(const timer_wheel_t *wheel, uint32_t id);
+
+/**
+ * Fire every timer due at now_ms.
+ *
+ * @param wheel Timer wheel
+ * @param now_ms Current monotonic time in milliseconds
+ * @param callback Called once per expired timer
+ * @param ctx Callback context
+ * @return Number of timers fired
+ */
+int timer_wheel_advance(timer_wheel_t *wheel, uint64_t now_ms,
+                        timer_wheel_callback_t callback, void *ctx);
+
+/**
+ * Get how long a poll may sleep before the wheel needs advancing.
+ *
+ * @param wheel Timer wheel
+ * @param now_ms Current monotonic time in milliseconds
+ * @return Milliseconds until the next expiry or cascade, -1 if no timer is armed
+ */
+int timer_wheel_next_timeout(const timer_wheel_t *wheel, uint64_t now_ms);
+
+/**
+ * Get the number of armed timers.
+ *
+ * @param wheel Timer wheel
+ * @return Armed timer count
+ */
+uint32_t timer_wheel_count(const timer_wheel_t *wheel);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TIMER_WHEEL_H */
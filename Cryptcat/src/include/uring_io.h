@@ -0,0 +1,87 @@
+/*
+ * Cryptcat io_uring I/O API
+ * Header file for uring_io.c
+ */
+
+#ifndef URING_IO_H
+#define URING_IO_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Error codes */
+typedef enum {
+    URING_IO_SUCCESS = 0,
+    URING_IO_ERROR_PARAM = -1,
+    URING_IO_ERROR_MEMORY = -2,
+    URING_IO_ERROR_UNSUPPORTED = -3,
+    URING_IO_ERROR_IO = -4,
+    URING_IO_EOF = -5
+} uring_io_error_t;
+
+/* Opaque read-ahead file reader */
+typedef struct uring_file_reader_s uring_file_reader_t;
+
+/**
+ * Check whether io_uring can be used by this process.
+ * The answer is probed once (the kernel or a seccomp policy may refuse
+ * ring setup even where the build supports it). Setting
+ * CRYPTCAT_IO_BACKEND=epoll forces it off.
+ *
+ * @return 1 if available, 0 otherwise
+ */
+int uring_io_available(void);
+
+/**
+ * Create a read-ahead reader over a file descriptor.
+ * Up to depth chunks are read ahead with READ_FIXED into registered
+ * buffers, so the caller encrypts and sends one chunk while the next
+ * ones are already being read.
+ *
+ * @param fd File descriptor (not owned)
+ * @param offset File offset of the first chunk
+ * @param file_size Total file size
+ * @param chunk_size Size of each chunk
+ * @param depth Number of chunks kept in flight
+ * @return Pointer to new reader, or NULL if io_uring is unavailable
+ */
+uring_file_reader_t* uring_file_reader_create(int fd, uint64_t offset, uint64_t file_size,
+                                              size_t chunk_size, unsigned depth);
+
+/**
+ * Get the next chunk in file order.
+ * The data stays valid until the next call; the slot is then reused for
+ * a further read-ahead.
+ *
+ * @param reader File reader
+ * @param data Output: pointer to chunk data
+ * @param len Output: chunk length
+ * @return URING_IO_SUCCESS, URING_IO_EOF at end of file, or error code
+ */
+int uring_file_reader_next(uring_file_reader_t *reader,
+                           const unsigned char **data, size_t *len);
+
+/**
+ * Destroy a reader, waiting for reads still in flight.
+ *
+ * @param reader File reader
+ */
+void uring_file_reader_destroy(uring_file_reader_t *reader);
+
+/**
+ * Get human-readable error message for io_uring I/O error.
+ *
+ * @param error_code Error code
+ * @return Error message string
+ */
+const char* uring_io_strerror(int error_code);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* URING_IO_H */
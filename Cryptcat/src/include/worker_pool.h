@@ -0,0 +1,177 @@
+/*
+ * Cryptcat Worker Pool API
+ * Header file for worker_pool.c
+ */
+
+#ifndef WORKER_POOL_H
+#define WORKER_POOL_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "event_loop.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Upper bound on workers in one pool */
+#define WORKER_POOL_MAX_WORKERS 256
+
+/* Error codes */
+typedef enum {
+    WORKER_POOL_SUCCESS = 0,
+    WORKER_POOL_ERROR_PARAM = -1,
+    WORKER_POOL_ERROR_MEMORY = -2,
+    WORKER_POOL_ERROR_SYSTEM = -3,
+    WORKER_POOL_ERROR_UNSUPPORTED = -4
+} worker_pool_error_t;
+
+/* Opaque pool of listener workers */
+typedef struct worker_pool_s worker_pool_t;
+
+/* Pool options */
+typedef struct {
+    int workers;                    /* 0 = one per online CPU */
+    int pin_cpus;                   /* Pin worker i to CPU i */
+    int cpu_steering;               /* Hand each connection to the worker of
+                                     * the CPU that received it (Linux BPF) */
+    int max_connections;            /* Per worker (0 = event loop default) */
+    int idle_timeout_ms;            /* See event_loop_set_timeouts() (0 = off) */
+    int keepalive_ms;               /* 0 = off */
+    event_loop_backend_t backend;
+} worker_pool_options_t;
+
+/* Per-worker load */
+typedef struct {
+    int cpu;                        /* Pinned CPU, -1 if unpinned */
+    event_loop_stats_t loop;        /* Snapshot of the worker's event loop */
+} worker_stats_t;
+
+/**
+ * Create a pool of listener workers on one port.
+ * Every worker owns a SO_REUSEPORT listener, an event loop and the
+ * crypto state of its sessions, so accept, handshakes and traffic are
+ * spread across threads without shared locks. Callbacks run on the
+ * worker threads and must be thread-safe.
+ *
+ * @param port Port to listen on
+ * @param password Password used for every handshake
+ * @param callbacks Application callbacks (copied)
+ * @param options Pool options (NULL = defaults)
+ * @return Pointer to new pool, or NULL on failure
+ */
+worker_pool_t* worker_pool_create(int port, const char *password,
+                                  const event_loop_callbacks_t *callbacks,
+                                  const worker_pool_options_t *options);
+
+/**
+ * Create a pool from the listeners and sessions of a process handing
+ * over with worker_pool_hand_off(), for restarts that drop nothing.
+ * Each listener gets a worker (options->workers is ignored) and the
+ * sessions are dealt out among them; they resume without a handshake
+ * and on_connect runs for each. Returns once the old process closes the
+ * channel; the pool is not started.
+ *
+ * @param channel_fd Unix-domain stream socket to the old process
+ * @param password Password for handshakes of new connections
+ * @param callbacks Application callbacks (copied by every worker)
+ * @param options Pool options (NULL for defaults)
+ * @param timeout_ms Longest wait for each listener or session
+ * @return Pointer to new pool, or NULL if no listener was handed over
+ */
+worker_pool_t* worker_pool_take_over(int channel_fd, const char *password,
+                                     const event_loop_callbacks_t *callbacks,
+                                     const worker_pool_options_t *options,
+                                     int timeout_ms);
+
+/**
+ * Start the worker threads.
+ *
+ * @param pool Worker pool
+ * @return WORKER_POOL_SUCCESS on success, error code on failure
+ */
+int worker_pool_start(worker_pool_t *pool);
+
+/**
+ * Ask every worker to return. Safe to call from other threads and from
+ * signal handlers.
+ *
+ * @param pool Worker pool
+ */
+void worker_pool_stop(worker_pool_t *pool);
+
+/**
+ * Wait for every worker thread to return.
+ *
+ * @param pool Worker pool
+ * @return WORKER_POOL_SUCCESS if every worker stopped cleanly, error code otherwise
+ */
+int worker_pool_wait(worker_pool_t *pool);
+
+/**
+ * Hand every listener, then every established session, to another
+ * process with pass_connection(); it builds its pool with
+ * worker_pool_take_over(). Listeners are never closed, so clients that
+ * connect meanwhile wait in the accept queue rather than being refused.
+ * Sessions carry their keys, sequence numbers and unread input.
+ * Sessions that cannot be passed (compression, datagram channel) and
+ * handshakes still running stay in the pool and close with it.
+ * Workers must have been stopped and waited for.
+ *
+ * @param pool Worker pool
+ * @param channel_fd Unix-domain stream socket to the new process
+ *                   (check its peer, the sessions' keys travel over it)
+ * @param timeout_ms Longest wait for each listener or session
+ * @return Number of sessions handed over, or error code on failure
+ */
+int worker_pool_hand_off(worker_pool_t *pool, int channel_fd, int timeout_ms);
+
+/**
+ * Destroy a pool, closing every listener and connection it owns.
+ * Workers must have been stopped and waited for.
+ *
+ * @param pool Worker pool
+ */
+void worker_pool_destroy(worker_pool_t *pool);
+
+/**
+ * Get the number of workers.
+ *
+ * @param pool Worker pool
+ * @return Worker count
+ */
+int worker_pool_size(const worker_pool_t *pool);
+
+/**
+ * Get the load of one worker. The snapshot is refreshed by the worker
+ * after every dispatch, so it can be read while the pool runs.
+ *
+ * @param pool Worker pool
+ * @param index Worker index
+ * @param stats Output: worker statistics
+ * @return WORKER_POOL_SUCCESS on success, error code on failure
+ */
+int worker_pool_get_worker_stats(worker_pool_t *pool, int index, worker_stats_t *stats);
+
+/**
+ * Get statistics summed over every worker (peak_connections is the sum
+ * of per-worker peaks).
+ *
+ * @param pool Worker pool
+ * @return Statistics structure
+ */
+event_loop_stats_t worker_pool_get_stats(worker_pool_t *pool);
+
+/**
+ * Get human-readable error message for worker pool error.
+ *
+ * @param error_code Error code
+ * @return Error message string
+ */
+const char* worker_pool_strerror(int error_code);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* WORKER_POOL_H */
@@ -4,6 +4,10 @@
  * License: MIT
  */
 
+#ifdef __linux__
+#define _GNU_SOURCE  /* pthread_setaffinity_np */
+#endif
+
 #include "platform.h"
 #include <sys/socket.h>
 #include <netinet/in.h>
@@ -17,6 +21,23 @@
 #include <sys/stat.h>
 #include <dirent.h>
 #include <pthread.h>
+#include <stdatomic.h>
+#include <time.h>
+
+/* Coarse clock falls back to the precise ones where the kernel has none */
+#ifdef CLOCK_MONOTONIC_COARSE
+#define COARSE_MONOTONIC CLOCK_MONOTONIC_COARSE
+#define COARSE_REALTIME CLOCK_REALTIME_COARSE
+#else
+#define COARSE_MONOTONIC CLOCK_MONOTONIC
+#define COARSE_REALTIME CLOCK_REALTIME
+#endif
+
+/* Coarse clock cache; each value is read on its own, so relaxed loads do */
+static atomic_uint_least64_t coarse_monotonic_ms;
+static atomic_llong coarse_realtime_sec;
+static atomic_int coarse_ticking;
+static pthread_once_t coarse_once = PTHREAD_ONCE_INIT;
 
 /* Initialize Unix networking */
 int platform_network_init(void) {
@@ -73,11 +94,80 @@ void platform_sleep_ms(int milliseconds) {
     nanosleep(&ts, NULL);
 }
 
-/* Get system time in milliseconds */
+/* Get monotonic time in milliseconds */
 uint64_t platform_get_time_ms(void) {
-    struct timeval tv;
-    gettimeofday(&tv, NULL);
-    return (uint64_t)tv.tv_sec * 1000 + tv.tv_usec / 1000;
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+}
+
+/* Internal: Coarse clock ticker thread */
+static void* coarse_clock_ticker(void *arg) {
+    (void)arg;
+
+    while (atomic_load_explicit(&coarse_ticking, memory_order_relaxed)) {
+        platform_sleep_ms(PLATFORM_COARSE_CLOCK_TICK_MS);
+        platform_coarse_clock_update();
+    }
+
+    return NULL;
+}
+
+/* Internal: A forked child has no ticker; it reads the clocks directly */
+static void coarse_clock_atfork_child(void) {
+    atomic_store(&coarse_ticking, 0);
+}
+
+/* Internal: Seed the cache and start the ticker */
+static void coarse_clock_start(void) {
+    pthread_t thread;
+
+    platform_coarse_clock_update();
+
+    atomic_store(&coarse_ticking, 1);
+    if (pthread_create(&thread, NULL, coarse_clock_ticker, NULL) != 0) {
+        atomic_store(&coarse_ticking, 0);
+        return;
+    }
+    pthread_detach(thread);
+    pthread_atfork(NULL, NULL, coarse_clock_atfork_child);
+}
+
+/* Refresh the coarse clock */
+void platform_coarse_clock_update(void) {
+    struct timespec mono, real;
+
+    clock_gettime(COARSE_MONOTONIC, &mono);
+    clock_gettime(COARSE_REALTIME, &real);
+
+    atomic_store_explicit(&coarse_monotonic_ms,
+                          (uint64_t)mono.tv_sec * 1000 + (uint64_t)mono.tv_nsec / 1000000,
+                          memory_order_relaxed);
+    atomic_store_explicit(&coarse_realtime_sec, (long long)real.tv_sec, memory_order_relaxed);
+}
+
+/* Internal: No ticker yet (first use, failed start, forked child) */
+static void coarse_clock_refresh(void) {
+    pthread_once(&coarse_once, coarse_clock_start);
+    if (!atomic_load_explicit(&coarse_ticking, memory_order_relaxed)) {
+        platform_coarse_clock_update();
+    }
+}
+
+/* Get coarse monotonic time in milliseconds */
+uint64_t platform_coarse_monotonic_ms(void) {
+    if (!atomic_load_explicit(&coarse_ticking, memory_order_relaxed)) {
+        coarse_clock_refresh();
+    }
+    return atomic_load_explicit(&coarse_monotonic_ms, memory_order_relaxed);
+}
+
+/* Get coarse wall-clock time */
+time_t platform_coarse_time(void) {
+    if (!atomic_load_explicit(&coarse_ticking, memory_order_relaxed)) {
+        coarse_clock_refresh();
+    }
+    return (time_t)atomic_load_explicit(&coarse_realtime_sec, memory_order_relaxed);
 }
 
 /* Get local IP address */
@@ -144,6 +234,27 @@ void platform_thread_detach(platform_thread_t thread) {
     pthread_detach((pthread_t)thread);
 }
 
+int platform_thread_set_affinity(platform_thread_t thread, int cpu) {
+#ifdef __linux__
+    cpu_set_t set;
+    
+    if (cpu < 0 || cpu >= CPU_SETSIZE) {
+        return PLATFORM_ERROR_GENERIC;
+    }
+    
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    if (pthread_setaffinity_np((pthread_t)thread, sizeof(set), &set) != 0) {
+        return PLATFORM_ERROR_GENERIC;
+    }
+    return PLATFORM_SUCCESS;
+#else
+    (void)thread;
+    (void)cpu;
+    return PLATFORM_ERROR_GENERIC;
+#endif
+}
+
 /* Mutex functions */
 platform_mutex_t platform_mutex_create(void) {
     pthread_mutex_t *mutex = malloc(sizeof(pthread_mutex_t));
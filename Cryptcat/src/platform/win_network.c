@@ -73,16 +73,22 @@ void platform_sleep_ms(int milliseconds) {
     Sleep(milliseconds);
 }
 
-/* Get system time in milliseconds */
+/* Get monotonic time in milliseconds */
 uint64_t platform_get_time_ms(void) {
-    FILETIME ft;
-    GetSystemTimeAsFileTime(&ft);
-    
-    ULARGE_INTEGER uli;
-    uli.LowPart = ft.dwLowDateTime;
-    uli.HighPart = ft.dwHighDateTime;
-    
-    return (uli.QuadPart - 116444736000000000ULL) / 10000ULL;
+    return GetTickCount64();
+}
+
+/* Coarse clock: GetTickCount64() and time() are already tick-based on
+ * Windows, so there is no cache to maintain */
+uint64_t platform_coarse_monotonic_ms(void) {
+    return GetTickCount64();
+}
+
+time_t platform_coarse_time(void) {
+    return time(NULL);
+}
+
+void platform_coarse_clock_update(void) {
 }
 
 /* Get local IP address */
@@ -149,6 +155,17 @@ void platform_thread_detach(platform_thread_t thread) {
     CloseHandle((HANDLE)thread);
 }
 
+int platform_thread_set_affinity(platform_thread_t thread, int cpu) {
+    if (cpu < 0 || cpu >= (int)(sizeof(DWORD_PTR) * 8)) {
+        return PLATFORM_ERROR_GENERIC;
+    }
+    
+    if (SetThreadAffinityMask((HANDLE)thread, (DWORD_PTR)1 << cpu) == 0) {
+        return PLATFORM_ERROR_GENERIC;
+    }
+    return PLATFORM_SUCCESS;
+}
+
 /* Mutex functions */
 platform_mutex_t platform_mutex_create(void) {
     CRITICAL_SECTION *cs = malloc(sizeof(CRITICAL_SECTION));
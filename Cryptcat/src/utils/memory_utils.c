@@ -4,6 +4,10 @@
  * License: MIT
  */
 
+#ifdef __linux__
+#define _GNU_SOURCE  /* memfd_create */
+#endif
+
 #include "memory_utils.h"
 #include <stdio.h>
 #include <stdlib.h>
@@ -142,6 +146,54 @@ void free_locked_memory(void *ptr, size_t size) {
 #endif
 }
 
+/* Allocate a mirrored ring: reserve twice the size, then map one memfd
+ * over both halves */
+void* allocate_mirrored_memory(size_t size) {
+#if defined(__linux__) && defined(MFD_CLOEXEC)
+    unsigned char *base;
+    int fd;
+    
+    if (size == 0 || size % (size_t)sysconf(_SC_PAGESIZE) != 0) {
+        return NULL;
+    }
+    
+    fd = memfd_create("cryptcat-ring", MFD_CLOEXEC);
+    if (fd < 0) {
+        return NULL;
+    }
+    
+    base = mmap(NULL, size * 2, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (base == MAP_FAILED || ftruncate(fd, (off_t)size) != 0 ||
+        mmap(base, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED ||
+        mmap(base + size, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED) {
+        if (base != MAP_FAILED) {
+            munmap(base, size * 2);
+        }
+        close(fd);
+        return NULL;
+    }
+    
+    /* The mappings keep the memory alive */
+    close(fd);
+    return base;
+#else
+    (void)size;
+    return NULL;
+#endif
+}
+
+/* Free a mirrored ring */
+void free_mirrored_memory(void *ptr, size_t size) {
+#if defined(__linux__) && defined(MFD_CLOEXEC)
+    if (ptr) {
+        munmap(ptr, size * 2);
+    }
+#else
+    (void)ptr;
+    (void)size;
+#endif
+}
+
 /* Memory pool for secure allocations */
 memory_pool_t* create_memory_pool(size_t block_size, size_t num_blocks) {
     memory_pool_t *pool = malloc(sizeof(memory_pool_t));
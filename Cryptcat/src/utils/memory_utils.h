@@ -43,6 +43,12 @@ int unlock_memory(void *addr, size_t len);
 void* allocate_locked_memory(size_t size);
 void free_locked_memory(void *ptr, size_t size);
 
+/* Allocate a ring whose pages are mapped twice back to back, so
+ * ptr[i] and ptr[i + size] are the same byte (size: page multiple).
+ * Returns NULL where the platform cannot do it. */
+void* allocate_mirrored_memory(size_t size);
+void free_mirrored_memory(void *ptr, size_t size);
+
 /* Memory pool functions */
 memory_pool_t* create_memory_pool(size_t block_size, size_t num_blocks);
 void* pool_allocate(memory_pool_t *pool);
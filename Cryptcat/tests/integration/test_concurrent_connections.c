@@ -0,0 +1,1829 @@
+/*
+ * Integration Tests - Concurrent Connections
+ * Sends on many connections from several threads at once and checks that
+ * every connection delivers its messages in order
+ */
+
+#define _GNU_SOURCE  /* pthread barriers, usleep, RUSAGE_THREAD */
+
+#include "test_harness.h"
+#include "../../src/include/crypto.h"
+#include "../../src/include/network.h"
+#include "../../src/include/protocol.h"
+#include "../../src/include/event_loop.h"
+#include "../../src/include/worker_pool.h"
+#include "../../src/include/agent.h"
+#include "../../src/include/resolver.h"
+#include "../../src/include/datagram.h"
+#include "../../src/include/session_ticket.h"
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <unistd.h>
+#include <poll.h>
+#include <arpa/inet.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+
+#define STRESS_PORT 35000
+#define STRESS_CONNECTIONS 64
+#define SENDERS_PER_CONNECTION 2
+#define MESSAGES_PER_SENDER 200
+#define STRESS_PAYLOAD_SIZE 256
+#define STRESS_ACCEPT_TIMEOUT_MS 10000
+#define STRESS_RECEIVE_TIMEOUT_MS 5000
+#define KDF_WAIT_PORT 36200
+#define KDF_STEP_MS 20
+#define KDF_STEP_SLACK_MS 100
+#define KDF_TIMEOUT_MS 10000
+#define PIECES_PORT 36000
+#define PIECES_RELAY_PORT 36001
+#define PIECES_PAYLOAD_SIZE (64 * 1024 - 64) /* Header and payload fill one 64 KB record */
+#define PIECES_CHUNK 1024           /* Bytes per write once a read's first bytes are split */
+#define PIECES_TIMEOUT_MS 5000
+#define POOL_PORT 35100
+#define POOL_WORKERS 4
+#define POOL_CLIENTS 32
+#define SLOW_PORT 35200
+#define SLOW_MESSAGES 1024          /* 16 MB, far past the socket buffers */
+#define SLOW_PAYLOAD_SIZE 16384
+#define SLOW_READER_DELAY_US 1000000
+#define AGENT_PORT 35300
+#define AGENT_REQUESTS 4
+#define RACE_PORT 35400
+#define TIMER_PORT 35500
+#define TIMER_IDLE_MS 400
+#define TIMER_KEEPALIVE_MS 100
+#define FANOUT_PORT 35600
+#define FANOUT_CLIENTS 8
+#define DATAGRAM_PORT 35700
+#define DATAGRAM_MESSAGES 2000
+#define DATAGRAM_MESSAGE_SIZE 1000
+#define DATAGRAM_TIMEOUT_MS 10000
+#define UNIX_MESSAGES 64
+#define UNIX_PAYLOAD_SIZE 40000     /* Spans several seqpacket packets */
+#define UNIX_TIMEOUT_MS 5000
+#define HANDOFF_PORT 35800
+#define RESTART_PORT 35900
+#define RESTART_WORKERS 2
+#define RESTART_CLIENTS 8
+#define PINNED_PORT 36100
+#define PINNED_RECORDS 128          /* 7.5 MB, far past what a stalled peer takes */
+#define PINNED_PAYLOAD_SIZE 60000
+#define PINNED_CLOSE_MS 20          /* close_connection() must not wait for completions */
+#define PINNED_TIMEOUT_MS 5000
+#define REFUSED_PORT 36300
+#define REFUSED_CONNECTIONS 3       /* Full, refused resumption, resumed */
+#define REFUSED_TIMEOUT_MS 10000
+
+static const char *stress_password = "stress_test_pwd";
+
+/* ===== Fixtures ===== */
+
+/* Per-connection receive results */
+typedef struct {
+    connection_t *conn;
+    int received;
+    int out_of_order;
+    int errors;
+} receiver_slot_t;
+
+/* One sender thread on a shared client connection */
+typedef struct {
+    connection_t *conn;
+    uint32_t conn_index;
+    uint32_t sender_index;
+    pthread_barrier_t *start;
+    int errors;
+} sender_slot_t;
+
+static receiver_slot_t receivers[STRESS_CONNECTIONS];
+static volatile int listener_ready = 0;
+static atomic_int senders_released;
+
+/* Payload: conn_index(4) | sender_index(4) | counter(4) | filler */
+static void build_payload(unsigned char *payload, uint32_t conn_index,
+                          uint32_t sender_index, uint32_t counter) {
+    uint32_t fields[3] = { htonl(conn_index), htonl(sender_index), htonl(counter) };
+
+    memcpy(payload, fields, sizeof(fields));
+    memset(payload + sizeof(fields), (int)(counter & 0xFF),
+           STRESS_PAYLOAD_SIZE - sizeof(fields));
+}
+
+/* Milliseconds on the monotonic clock */
+static uint64_t monotonic_ms(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000ULL + (uint64_t)ts.tv_nsec / 1000000ULL;
+}
+
+/* Receive the next message, waiting for it on a non-blocking socket;
+ * input already staged needs no wait */
+static int receive_waiting(connection_t *conn, message_type_t *msg_type,
+                           unsigned char *buffer, size_t *len) {
+    size_t capacity = *len;
+    int result;
+
+    do {
+        if (connection_input_pending(conn) == 0 &&
+            wait_for_socket(get_connection_socket(conn), STRESS_RECEIVE_TIMEOUT_MS, 1, 0) <= 0) {
+            return PROTOCOL_ERROR_TIMEOUT;
+        }
+        *len = capacity;
+        result = receive_message(conn, msg_type, buffer, len);
+    } while (result == PROTOCOL_IN_PROGRESS);
+
+    return result;
+}
+
+/* Receive every message of one connection, tracking each sender's counter */
+static void* receiver_thread(void *arg) {
+    receiver_slot_t *slot = (receiver_slot_t*)arg;
+    uint32_t next_counter[SENDERS_PER_CONNECTION] = {0};
+    unsigned char buffer[STRESS_PAYLOAD_SIZE];
+    const int expected = SENDERS_PER_CONNECTION * MESSAGES_PER_SENDER;
+
+    if (perform_handshake(slot->conn, 1, stress_password) != PROTOCOL_SUCCESS) {
+        slot->errors++;
+        return NULL;
+    }
+
+    /* The other handshakes run first; only then is input due */
+    while (!atomic_load(&senders_released)) {
+        usleep(1000);
+    }
+
+    while (slot->received < expected) {
+        message_type_t msg_type;
+        size_t buffer_len = sizeof(buffer);
+        uint32_t fields[3];
+
+        /* receive_message rejects any header sequence gap itself */
+        if (receive_waiting(slot->conn, &msg_type, buffer, &buffer_len) != PROTOCOL_SUCCESS) {
+            slot->errors++;
+            break;
+        }
+
+        if (msg_type != MSG_DATA || buffer_len != STRESS_PAYLOAD_SIZE) {
+            slot->errors++;
+            continue;
+        }
+
+        memcpy(fields, buffer, sizeof(fields));
+        uint32_t sender = ntohl(fields[1]);
+        uint32_t counter = ntohl(fields[2]);
+
+        if (ntohl(fields[0]) != (uint32_t)(slot - receivers) ||
+            sender >= SENDERS_PER_CONNECTION || counter != next_counter[sender]) {
+            slot->out_of_order++;
+        } else {
+            next_counter[sender]++;
+        }
+
+        slot->received++;
+    }
+
+    return NULL;
+}
+
+/* Accept all connections and hand each to its own receiver */
+static void* acceptor_thread(void *arg) {
+    pthread_t *receiver_tids = (pthread_t*)arg;
+    connection_t *listener = create_listener(STRESS_PORT, stress_password);
+
+    if (!listener) {
+        listener_ready = -1;
+        return NULL;
+    }
+
+    listener_ready = 1;
+
+    /* Connections are accepted in connect order, which matches their index;
+     * the listener is non-blocking, so wait for each one to arrive */
+    for (int i = 0; i < STRESS_CONNECTIONS; i++) {
+        if (wait_for_connection(listener, STRESS_ACCEPT_TIMEOUT_MS, 1, 0) > 0) {
+            receivers[i].conn = accept_connection(listener);
+        }
+        if (!receivers[i].conn) {
+            receivers[i].errors++;
+            continue;
+        }
+        pthread_create(&receiver_tids[i], NULL, receiver_thread, &receivers[i]);
+    }
+
+    close_connection(listener);
+    return NULL;
+}
+
+/* Send this thread's share of messages once every sender is ready */
+static void* sender_thread(void *arg) {
+    sender_slot_t *slot = (sender_slot_t*)arg;
+    unsigned char payload[STRESS_PAYLOAD_SIZE];
+
+    pthread_barrier_wait(slot->start);
+
+    for (uint32_t counter = 0; counter < MESSAGES_PER_SENDER; counter++) {
+        build_payload(payload, slot->conn_index, slot->sender_index, counter);
+        if (send_message(slot->conn, MSG_DATA, payload, sizeof(payload)) != PROTOCOL_SUCCESS) {
+            slot->errors++;
+            break;
+        }
+    }
+
+    return NULL;
+}
+
+/* Relay that passes a client's bytes on to the loop in small writes */
+typedef struct {
+    connection_t *listener;
+    int writes;
+} trickle_relay_t;
+
+/* Write all of data to a socket, waiting out a full send buffer */
+static int write_all(int fd, const unsigned char *data, size_t len) {
+    while (len > 0) {
+        ssize_t sent = send(fd, data, len, MSG_NOSIGNAL);
+
+        if (sent < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) return -1;
+            wait_for_socket(fd, 100, 0, 1);
+            continue;
+        }
+        data += sent;
+        len -= (size_t)sent;
+    }
+
+    return 0;
+}
+
+/* Relay one client to the loop. Each read from the client goes out as
+ * 3 bytes, then 29, then PIECES_CHUNK at a time, so record lengths and
+ * message headers are split across edges; replies pass through whole */
+static void* trickle_relay_thread(void *arg) {
+    trickle_relay_t *relay = (trickle_relay_t*)arg;
+    static unsigned char buffer[16 * PIECES_CHUNK];
+    connection_t *client = NULL, *server = NULL;
+    struct pollfd fds[2];
+    int open = 1;
+
+    if (wait_for_socket(get_connection_socket(relay->listener), PIECES_TIMEOUT_MS, 1, 0) == 1) {
+        client = accept_connection(relay->listener);
+    }
+    if (client) {
+        server = connect_to_host("127.0.0.1", PIECES_PORT, stress_password);
+    }
+    if (!server) {
+        open = 0;
+    } else {
+        fds[0].fd = get_connection_socket(client);
+        fds[1].fd = get_connection_socket(server);
+        fds[0].events = fds[1].events = POLLIN;
+    }
+
+    while (open && poll(fds, 2, PIECES_TIMEOUT_MS) > 0) {
+        ssize_t got;
+
+        if (fds[0].revents) {
+            got = recv(fds[0].fd, buffer, sizeof(buffer), 0);
+            open = got > 0;
+            for (size_t offset = 0; open && offset < (size_t)got; ) {
+                size_t piece = offset == 0 ? 3 : offset == 3 ? 29 : PIECES_CHUNK;
+
+                if (piece > (size_t)got - offset) piece = (size_t)got - offset;
+                open = write_all(fds[1].fd, buffer + offset, piece) == 0;
+                offset += piece;
+                relay->writes++;
+                usleep(200);
+            }
+        }
+        if (open && fds[1].revents) {
+            got = recv(fds[1].fd, buffer, sizeof(buffer), 0);
+            open = got > 0 && write_all(fds[0].fd, buffer, (size_t)got) == 0;
+        }
+    }
+
+    if (server) {
+        close_connection(server);
+        free(server);
+    }
+    if (client) {
+        close_connection(client);
+        free(client);
+    }
+    return NULL;
+}
+
+/* Event loop: echo each message back on the loop thread */
+static void echo_on_message(event_loop_t *loop, connection_t *conn, message_type_t type,
+                            const unsigned char *payload, size_t payload_len, void *ctx) {
+    (void)loop;
+    (void)ctx;
+    send_message(conn, type, payload, payload_len);
+}
+
+/* Run a loop until it is stopped */
+static void* loop_thread(void *arg) {
+    event_loop_run((event_loop_t*)arg);
+    return NULL;
+}
+
+/* Slow receiver state */
+typedef struct {
+    connection_t *listener;
+    int received;
+    int errors;
+} slow_reader_t;
+
+/* Receiver that stalls before reading, so the sender's socket fills up */
+static void* slow_reader_thread(void *arg) {
+    slow_reader_t *reader = (slow_reader_t*)arg;
+    static unsigned char buffer[SLOW_PAYLOAD_SIZE];
+    connection_t *conn = NULL;
+
+    if (wait_for_socket(get_connection_socket(reader->listener), 5000, 1, 0) <= 0 ||
+        !(conn = accept_connection(reader->listener)) ||
+        perform_handshake(conn, 1, stress_password) != PROTOCOL_SUCCESS) {
+        reader->errors++;
+        if (conn) {
+            close_connection(conn);
+            free(conn);
+        }
+        return NULL;
+    }
+
+    usleep(SLOW_READER_DELAY_US);
+
+    while (reader->received < SLOW_MESSAGES) {
+        message_type_t msg_type;
+        size_t buffer_len = sizeof(buffer);
+        int result = receive_message(conn, &msg_type, buffer, &buffer_len);
+
+        /* Accepted sockets are non-blocking */
+        if (result == PROTOCOL_IN_PROGRESS) {
+            if (wait_for_socket(get_connection_socket(conn), 5000, 1, 0) <= 0) {
+                reader->errors++;
+                break;
+            }
+            continue;
+        }
+
+        if (result != PROTOCOL_SUCCESS) {
+            reader->errors++;
+            break;
+        }
+
+        if (msg_type != MSG_DATA || buffer_len != SLOW_PAYLOAD_SIZE ||
+            buffer[0] != (unsigned char)reader->received) {
+            reader->errors++;
+        }
+        reader->received++;
+    }
+
+    close_connection(conn);
+    free(conn);
+    return NULL;
+}
+
+/* CPU time consumed by the calling thread */
+static uint64_t thread_cpu_us(void) {
+    struct rusage usage;
+
+    getrusage(RUSAGE_THREAD, &usage);
+    return (uint64_t)(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000000ULL +
+           (uint64_t)(usage.ru_utime.tv_usec + usage.ru_stime.tv_usec);
+}
+
+/* Worker pool: echo every data message */
+static void pool_on_message(event_loop_t *loop, connection_t *conn, message_type_t type,
+                            const unsigned char *payload, size_t payload_len, void *ctx) {
+    (void)ctx;
+
+    if (type == MSG_DATA &&
+        send_message(conn, MSG_DATA, payload, payload_len) != PROTOCOL_SUCCESS) {
+        event_loop_close_connection(loop, conn);
+    }
+}
+
+/* Fan-out server: relay every data message to everyone else, checking
+ * that the sender's handle resolves back to it */
+static atomic_int fanout_bad_handles;
+
+static void fanout_on_message(event_loop_t *loop, connection_t *conn, message_type_t type,
+                              const unsigned char *payload, size_t payload_len, void *ctx) {
+    (void)ctx;
+
+    if (event_loop_lookup(loop, event_loop_get_handle(loop, conn)) != conn) {
+        atomic_fetch_add(&fanout_bad_handles, 1);
+    }
+    if (type == MSG_DATA) {
+        event_loop_broadcast(loop, MSG_DATA, payload, payload_len, conn);
+    }
+}
+
+/* Run an agent until it is stopped */
+static void* agent_thread(void *arg) {
+    agent_run((agent_t*)arg);
+    return NULL;
+}
+
+/* Datagram echo server state */
+typedef struct {
+    connection_t *listener;
+    atomic_int done;
+    int echoed;
+    int errors;
+} datagram_echo_t;
+
+/* Answer the channel request on the stream, then echo every reliable
+ * message back over the channel until told to stop or out of time.
+ * The connection is closed on every path, so a client waiting on it
+ * is never left blocked */
+static void* datagram_echo_thread(void *arg) {
+    datagram_echo_t *echo = (datagram_echo_t*)arg;
+    unsigned char buffer[DATAGRAM_MAX_PAYLOAD];
+    uint64_t deadline = monotonic_ms() + 2 * DATAGRAM_TIMEOUT_MS;
+    connection_t *conn = NULL;
+    message_type_t msg_type;
+    size_t len = sizeof(buffer);
+    datagram_t *dg;
+
+    /* The listener is non-blocking */
+    if (wait_for_connection(echo->listener, DATAGRAM_TIMEOUT_MS, 1, 0) > 0) {
+        conn = accept_connection(echo->listener);
+    }
+    if (!conn || perform_handshake(conn, 1, stress_password) != PROTOCOL_SUCCESS ||
+        receive_waiting(conn, &msg_type, buffer, &len) != PROTOCOL_SUCCESS ||
+        !(dg = get_connection_datagram(conn))) {
+        echo->errors++;
+        if (conn) {
+            close_connection(conn);
+            free(conn);
+        }
+        return NULL;
+    }
+
+    len = 0;
+    while (!atomic_load(&echo->done)) {
+        if (monotonic_ms() >= deadline) {
+            echo->errors++;
+            break;
+        }
+
+        struct pollfd pfd = { datagram_get_socket(dg), POLLIN, 0 };
+        int flags = 0, result = DATAGRAM_SUCCESS, wait = datagram_service(dg);
+
+        poll(&pfd, 1, wait < 0 || wait > 10 ? 10 : wait);
+
+        /* A message held back by a full window goes first */
+        for (;;) {
+            if (len == 0) {
+                len = sizeof(buffer);
+                result = datagram_receive(dg, buffer, &len, &flags);
+                if (result != DATAGRAM_SUCCESS) {
+                    len = 0;
+                    break;
+                }
+            }
+            result = datagram_send(dg, buffer, len, DATAGRAM_SEND_RELIABLE | DATAGRAM_SEND_MORE);
+            if (result != DATAGRAM_SUCCESS) break;
+            echo->echoed++;
+            len = 0;
+        }
+        if (result < 0) {
+            echo->errors++;
+            break;
+        }
+        datagram_flush(dg);
+    }
+
+    close_connection(conn);
+    free(conn);
+    return NULL;
+}
+
+/* Unix-domain echo server state */
+typedef struct {
+    connection_t *listener;
+    int echoed;
+    int errors;
+} unix_echo_t;
+
+/* Old side of a hot restart: hand the pool over, then hang up */
+typedef struct {
+    worker_pool_t *pool;
+    int channel_fd;
+    int passed;
+} hand_off_job_t;
+
+static void* hand_off_thread(void *arg) {
+    hand_off_job_t *job = (hand_off_job_t*)arg;
+
+    job->passed = worker_pool_hand_off(job->pool, job->channel_fd, UNIX_TIMEOUT_MS);
+    close(job->channel_fd);
+    return NULL;
+}
+
+/* Send one message and expect it echoed */
+static int echo_round_trip(connection_t *conn, const unsigned char *payload, size_t len) {
+    unsigned char echo[STRESS_PAYLOAD_SIZE];
+    message_type_t msg_type;
+    size_t echo_len = sizeof(echo);
+
+    return send_message(conn, MSG_DATA, payload, len) == PROTOCOL_SUCCESS &&
+           receive_message(conn, &msg_type, echo, &echo_len) == PROTOCOL_SUCCESS &&
+           msg_type == MSG_DATA && echo_len == len && memcmp(payload, echo, len) == 0;
+}
+
+/* Echo UNIX_MESSAGES messages back on the first connection accepted */
+static void* unix_echo_thread(void *arg) {
+    unix_echo_t *echo = (unix_echo_t*)arg;
+    static _Thread_local unsigned char buffer[UNIX_PAYLOAD_SIZE];
+    connection_t *conn = NULL;
+
+    for (int i = 0; i < UNIX_TIMEOUT_MS && !conn; i++) {
+        if (!(conn = accept_connection(echo->listener))) {
+            usleep(1000);
+        }
+    }
+    if (!conn || perform_handshake(conn, 1, stress_password) != PROTOCOL_SUCCESS) {
+        echo->errors++;
+        return NULL;
+    }
+
+    while (echo->echoed < UNIX_MESSAGES) {
+        message_type_t msg_type;
+        size_t len = sizeof(buffer);
+
+        if (receive_waiting(conn, &msg_type, buffer, &len) != PROTOCOL_SUCCESS ||
+            send_message(conn, MSG_DATA, buffer, len) != PROTOCOL_SUCCESS) {
+            echo->errors++;
+            break;
+        }
+        echo->echoed++;
+    }
+
+    close_connection(conn);
+    free(conn);
+    return NULL;
+}
+
+/* Echo server for the refused ticket test */
+typedef struct {
+    connection_t *listener;
+    int echoed;
+    int errors;
+} ticket_echo_t;
+
+/* Echo each connection's messages until its client hangs up */
+static void* ticket_echo_thread(void *arg) {
+    ticket_echo_t *echo = (ticket_echo_t*)arg;
+    unsigned char buffer[STRESS_PAYLOAD_SIZE];
+
+    for (int i = 0; i < REFUSED_CONNECTIONS; i++) {
+        connection_t *conn = NULL;
+
+        if (wait_for_connection(echo->listener, REFUSED_TIMEOUT_MS, 1, 0) > 0) {
+            conn = accept_connection(echo->listener);
+        }
+        if (!conn) {
+            echo->errors++;
+            return NULL;
+        }
+
+        if (perform_handshake(conn, 1, stress_password) != PROTOCOL_SUCCESS) {
+            echo->errors++;
+        } else {
+            for (;;) {
+                message_type_t msg_type;
+                size_t len = sizeof(buffer);
+                int result = receive_waiting(conn, &msg_type, buffer, &len);
+
+                if (result == PROTOCOL_ERROR_CLOSED) {
+                    break;
+                }
+                if (result != PROTOCOL_SUCCESS ||
+                    send_message(conn, MSG_DATA, buffer, len) != PROTOCOL_SUCCESS) {
+                    echo->errors++;
+                    break;
+                }
+                echo->echoed++;
+            }
+        }
+
+        close_connection(conn);
+        free(conn);
+    }
+
+    return NULL;
+}
+
+/* Client handshake through the state machine, reporting whether it
+ * went out on a ticket */
+static int client_handshake(connection_t *conn, int *resumed) {
+    handshake_t *hs = handshake_begin(conn, 0, stress_password);
+    uint64_t deadline = monotonic_ms() + REFUSED_TIMEOUT_MS;
+    int result;
+
+    if (!hs) {
+        return PROTOCOL_ERROR_STATE;
+    }
+
+    do {
+        result = handshake_step(hs, REFUSED_TIMEOUT_MS);
+    } while (result == PROTOCOL_IN_PROGRESS && monotonic_ms() < deadline);
+
+    *resumed = handshake_get_timing(hs).resumed;
+    handshake_free(hs);
+    return result;
+}
+
+/* Expect the next message to echo payload */
+static int receive_echo(connection_t *conn, const char *payload) {
+    unsigned char echo[STRESS_PAYLOAD_SIZE];
+    message_type_t msg_type;
+    size_t len = sizeof(echo);
+
+    return receive_waiting(conn, &msg_type, echo, &len) == PROTOCOL_SUCCESS &&
+           msg_type == MSG_DATA && len == strlen(payload) && memcmp(echo, payload, len) == 0;
+}
+
+/* ===== Test Cases ===== */
+
+/* Test: 64 connections, two concurrent senders each, per-connection ordering */
+TEST_CASE(test_concurrent_send_ordering) {
+    static connection_t *clients[STRESS_CONNECTIONS];
+    static sender_slot_t senders[STRESS_CONNECTIONS * SENDERS_PER_CONNECTION];
+    static pthread_t sender_tids[STRESS_CONNECTIONS * SENDERS_PER_CONNECTION];
+    static pthread_t receiver_tids[STRESS_CONNECTIONS];
+    pthread_barrier_t start;
+    pthread_t acceptor_tid;
+    int total_errors = 0, total_out_of_order = 0;
+
+    TEST_ASSERT_EQUAL(CRYPTO_SUCCESS, crypto_global_init());
+    network_init();
+    memset(receivers, 0, sizeof(receivers));
+    atomic_store(&senders_released, 0);
+
+    pthread_create(&acceptor_tid, NULL, acceptor_thread, receiver_tids);
+    while (listener_ready == 0) usleep(1000);
+    TEST_ASSERT_EQUAL(1, listener_ready);
+
+    for (int i = 0; i < STRESS_CONNECTIONS; i++) {
+        clients[i] = connect_to_host("127.0.0.1", STRESS_PORT, stress_password);
+        TEST_ASSERT_NOT_NULL(clients[i]);
+        TEST_ASSERT_EQUAL(PROTOCOL_SUCCESS,
+                          perform_handshake(clients[i], 0, stress_password));
+    }
+
+    pthread_join(acceptor_tid, NULL);
+
+    /* Release every sender at once to maximise contention */
+    pthread_barrier_init(&start, NULL, STRESS_CONNECTIONS * SENDERS_PER_CONNECTION);
+    atomic_store(&senders_released, 1);
+
+    for (int i = 0; i < STRESS_CONNECTIONS * SENDERS_PER_CONNECTION; i++) {
+        senders[i].conn = clients[i / SENDERS_PER_CONNECTION];
+        senders[i].conn_index = (uint32_t)(i / SENDERS_PER_CONNECTION);
+        senders[i].sender_index = (uint32_t)(i % SENDERS_PER_CONNECTION);
+        senders[i].start = &start;
+        senders[i].errors = 0;
+        pthread_create(&sender_tids[i], NULL, sender_thread, &senders[i]);
+    }
+
+    for (int i = 0; i < STRESS_CONNECTIONS * SENDERS_PER_CONNECTION; i++) {
+        pthread_join(sender_tids[i], NULL);
+        total_errors += senders[i].errors;
+    }
+
+    for (int i = 0; i < STRESS_CONNECTIONS; i++) {
+        if (receivers[i].conn) {
+            pthread_join(receiver_tids[i], NULL);
+        }
+        total_errors += receivers[i].errors;
+        total_out_of_order += receivers[i].out_of_order;
+        TEST_ASSERT_EQUAL(SENDERS_PER_CONNECTION * MESSAGES_PER_SENDER,
+                          receivers[i].received);
+    }
+
+    pthread_barrier_destroy(&start);
+
+    for (int i = 0; i < STRESS_CONNECTIONS; i++) {
+        close_connection(clients[i]);
+        close_connection(receivers[i].conn);
+    }
+
+    test_log("%d connections x %d senders x %d messages: %d errors, %d out of order",
+             STRESS_CONNECTIONS, SENDERS_PER_CONNECTION, MESSAGES_PER_SENDER,
+             total_errors, total_out_of_order);
+
+    TEST_ASSERT_EQUAL(0, total_errors);
+    TEST_ASSERT_EQUAL(0, total_out_of_order);
+    return TEST_PASS;
+}
+
+/* Test: reuseport workers share the clients of one port */
+TEST_CASE(test_worker_pool_sharding) {
+    static connection_t *clients[POOL_CLIENTS];
+    event_loop_callbacks_t callbacks = { .on_message = pool_on_message };
+    worker_pool_options_t options = { .workers = POOL_WORKERS };
+    unsigned char payload[STRESS_PAYLOAD_SIZE], echo[STRESS_PAYLOAD_SIZE];
+    event_loop_stats_t total;
+    worker_pool_t *pool;
+    int busy_workers = 0;
+
+    TEST_ASSERT_EQUAL(CRYPTO_SUCCESS, crypto_global_init());
+    network_init();
+
+    pool = worker_pool_create(POOL_PORT, stress_password, &callbacks, &options);
+    TEST_ASSERT_NOT_NULL(pool);
+    TEST_ASSERT_EQUAL(POOL_WORKERS, worker_pool_size(pool));
+    TEST_ASSERT_EQUAL(WORKER_POOL_SUCCESS, worker_pool_start(pool));
+
+    for (int i = 0; i < POOL_CLIENTS; i++) {
+        message_type_t msg_type;
+        size_t echo_len = sizeof(echo);
+
+        clients[i] = connect_to_host("127.0.0.1", POOL_PORT, stress_password);
+        TEST_ASSERT_NOT_NULL(clients[i]);
+        TEST_ASSERT_EQUAL(PROTOCOL_SUCCESS,
+                          perform_handshake(clients[i], 0, stress_password));
+
+        build_payload(payload, (uint32_t)i, 0, 0);
+        TEST_ASSERT_EQUAL(PROTOCOL_SUCCESS,
+                          send_message(clients[i], MSG_DATA, payload, sizeof(payload)));
+        TEST_ASSERT_EQUAL(PROTOCOL_SUCCESS,
+                          receive_message(clients[i], &msg_type, echo, &echo_len));
+        TEST_ASSERT_EQUAL(MSG_DATA, msg_type);
+        TEST_ASSERT_MEMORY_EQUAL(payload, echo, sizeof(payload));
+    }
+
+    worker_pool_stop(pool);
+    TEST_ASSERT_EQUAL(WORKER_POOL_SUCCESS, worker_pool_wait(pool));
+
+    for (int i = 0; i < POOL_WORKERS; i++) {
+        worker_stats_t load;
+
+        TEST_ASSERT_EQUAL(WORKER_POOL_SUCCESS, worker_pool_get_worker_stats(pool, i, &load));
+        test_log("Worker %d: %llu accepted, %llu messages", i,
+                 (unsigned long long)load.loop.accepted,
+                 (unsigned long long)load.loop.messages);
+        if (load.loop.accepted > 0) busy_workers++;
+    }
+
+    total = worker_pool_get_stats(pool);
+    worker_pool_destroy(pool);
+
+    for (int i = 0; i < POOL_CLIENTS; i++) {
+        close_connection(clients[i]);
+        free(clients[i]);
+    }
+
+    TEST_ASSERT_EQUAL((uint64_t)POOL_CLIENTS, total.accepted);
+    TEST_ASSERT_EQUAL((uint64_t)POOL_CLIENTS, total.messages);
+
+    /* The reuseport hash spreads 32 distinct source ports over 4 sockets */
+    TEST_ASSERT(busy_workers > 1);
+    return TEST_PASS;
+}
+
+/* Test: a stalled receiver blocks the sender without spinning a core */
+TEST_CASE(test_slow_receiver_backpressure) {
+    static unsigned char payload[SLOW_PAYLOAD_SIZE];
+    slow_reader_t reader = {0};
+    pthread_t reader_tid;
+    connection_t *client;
+    struct timespec start, end;
+    uint64_t cpu_start, cpu_us, wall_us;
+
+    TEST_ASSERT_EQUAL(CRYPTO_SUCCESS, crypto_global_init());
+    network_init();
+
+    reader.listener = create_listener(SLOW_PORT, stress_password);
+    TEST_ASSERT_NOT_NULL(reader.listener);
+    pthread_create(&reader_tid, NULL, slow_reader_thread, &reader);
+
+    client = connect_to_host("127.0.0.1", SLOW_PORT, stress_password);
+    TEST_ASSERT_NOT_NULL(client);
+    TEST_ASSERT_EQUAL(PROTOCOL_SUCCESS, perform_handshake(client, 0, stress_password));
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    cpu_start = thread_cpu_us();
+
+    for (int i = 0; i < SLOW_MESSAGES; i++) {
+        memset(payload, i & 0xFF, sizeof(payload));
+        TEST_ASSERT_EQUAL(PROTOCOL_SUCCESS,
+                          send_message(client, MSG_DATA, payload, sizeof(payload)));
+    }
+
+    cpu_us = thread_cpu_us() - cpu_start;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    wall_us = (uint64_t)(end.tv_sec - start.tv_sec) * 1000000ULL +
+              (uint64_t)(end.tv_nsec - start.tv_nsec) / 1000ULL;
+
+    pthread_join(reader_tid, NULL);
+    close_connection(client);
+    free(client);
+    close_connection(reader.listener);
+    free(reader.listener);
+
+    test_log("%d x %d bytes to a stalled reader: %.0f ms wall, %.0f ms CPU",
+             SLOW_MESSAGES, SLOW_PAYLOAD_SIZE, wall_us / 1e3, cpu_us / 1e3);
+
+    TEST_ASSERT_EQUAL(0, reader.errors);
+    TEST_ASSERT_EQUAL(SLOW_MESSAGES, reader.received);
+
+    /* Only meaningful if the sender actually had to wait for the reader */
+    if (wall_us >= SLOW_READER_DELAY_US / 2) {
+        TEST_ASSERT(cpu_us < wall_us / 2);
+    }
+    return TEST_PASS;
+}
+
+/* Test: repeated agent streams to one peer share a single session, which
+ * a client can then take out of the pool */
+TEST_CASE(test_agent_session_reuse) {
+    event_loop_callbacks_t callbacks = { .on_message = pool_on_message };
+    worker_pool_options_t options = { .workers = 1 };
+    char socket_path[64], message[32], echo[64];
+    worker_pool_t *pool;
+    agent_t *agent;
+    agent_stats_t stats;
+    pthread_t agent_tid;
+    connection_t *taken;
+    message_type_t taken_type;
+    size_t taken_len;
+
+    TEST_ASSERT_EQUAL(CRYPTO_SUCCESS, crypto_global_init());
+    network_init();
+
+    pool = worker_pool_create(AGENT_PORT, stress_password, &callbacks, &options);
+    TEST_ASSERT_NOT_NULL(pool);
+    TEST_ASSERT_EQUAL(WORKER_POOL_SUCCESS, worker_pool_start(pool));
+
+    snprintf(socket_path, sizeof(socket_path), "/tmp/cryptcat-test-agent-%d.sock",
+             (int)getpid());
+    agent = agent_create(socket_path, stress_password, NULL);
+    TEST_ASSERT_NOT_NULL(agent);
+    pthread_create(&agent_tid, NULL, agent_thread, agent);
+
+    for (int i = 0; i < AGENT_REQUESTS; i++) {
+        size_t received = 0;
+        ssize_t got;
+        int fd;
+
+        TEST_ASSERT_EQUAL(AGENT_SUCCESS,
+                          agent_open_stream(socket_path, "127.0.0.1", AGENT_PORT, &fd));
+
+        snprintf(message, sizeof(message), "request %d", i);
+        TEST_ASSERT_EQUAL((ssize_t)strlen(message), write(fd, message, strlen(message)));
+        shutdown(fd, SHUT_WR);
+
+        /* The agent ends the stream once the echo is through */
+        while ((got = read(fd, echo + received, sizeof(echo) - received)) > 0) {
+            received += (size_t)got;
+        }
+        close(fd);
+
+        TEST_ASSERT_EQUAL(strlen(message), received);
+        TEST_ASSERT_MEMORY_EQUAL(message, echo, received);
+    }
+
+    /* Take the warm session out and use it directly */
+    TEST_ASSERT_EQUAL(AGENT_SUCCESS,
+                      agent_take_session(socket_path, "127.0.0.1", AGENT_PORT, &taken));
+    TEST_ASSERT_EQUAL(PROTOCOL_SUCCESS,
+                      send_message(taken, MSG_DATA, (const unsigned char*)"taken", 5));
+    taken_len = sizeof(echo);
+    TEST_ASSERT_EQUAL(PROTOCOL_SUCCESS, receive_waiting(taken, &taken_type,
+                                                        (unsigned char*)echo, &taken_len));
+    TEST_ASSERT_EQUAL(5U, taken_len);
+    TEST_ASSERT_MEMORY_EQUAL("taken", echo, taken_len);
+    close_connection(taken);
+    free(taken);
+
+    stats = agent_get_stats(agent);
+    agent_stop(agent);
+    pthread_join(agent_tid, NULL);
+    agent_destroy(agent);
+
+    worker_pool_stop(pool);
+    worker_pool_wait(pool);
+    worker_pool_destroy(pool);
+
+    test_log("%d agent requests: %llu sessions opened, %llu reused, %llu passed",
+             AGENT_REQUESTS + 1, (unsigned long long)stats.sessions_opened,
+             (unsigned long long)stats.sessions_reused,
+             (unsigned long long)stats.sessions_passed);
+
+    TEST_ASSERT_EQUAL((uint64_t)(AGENT_REQUESTS + 1), stats.requests);
+    TEST_ASSERT_EQUAL(1ULL, stats.sessions_opened);
+    TEST_ASSERT_EQUAL((uint64_t)AGENT_REQUESTS, stats.sessions_reused);
+    TEST_ASSERT_EQUAL(1ULL, stats.sessions_passed);
+    TEST_ASSERT_EQUAL(0U, stats.idle_sessions);
+    return TEST_PASS;
+}
+
+/* Test: connects race a host's addresses and back off briefly on failure */
+TEST_CASE(test_connect_racing) {
+    connection_t *listener, *client;
+    uint64_t start, connect_ms, refused_ms;
+
+    TEST_ASSERT_EQUAL(CRYPTO_SUCCESS, crypto_global_init());
+    network_init();
+
+    /* The listener is IPv4 only, so a dual-stack "localhost" must not wait
+     * on ::1 */
+    listener = create_listener(RACE_PORT, stress_password);
+    TEST_ASSERT_NOT_NULL(listener);
+
+    start = monotonic_ms();
+    client = connect_to_host("localhost", RACE_PORT, stress_password);
+    connect_ms = monotonic_ms() - start;
+    TEST_ASSERT_NOT_NULL(client);
+
+    close_connection(client);
+    free(client);
+    close_connection(listener);
+    free(listener);
+
+    /* Nothing listens here any more: three rounds with jittered backoff */
+    start = monotonic_ms();
+    client = connect_to_host("127.0.0.1", RACE_PORT, stress_password);
+    refused_ms = monotonic_ms() - start;
+    TEST_ASSERT(client == NULL);
+
+    test_log("localhost connect: %llu ms, refused after retries: %llu ms",
+             (unsigned long long)connect_ms, (unsigned long long)refused_ms);
+
+    TEST_ASSERT(connect_ms < 250);
+    TEST_ASSERT(refused_ms < 1500);
+    return TEST_PASS;
+}
+
+/* Async completion: count callbacks */
+static void resolver_counter(void *ctx, int status, const resolver_addresses_t *addresses) {
+    (void)addresses;
+    if (status == RESOLVER_SUCCESS) {
+        __sync_fetch_and_add((int*)ctx, 1);
+    }
+}
+
+/* Test: lookups are cached, coalesced and expire with their TTL */
+TEST_CASE(test_resolver_cache) {
+    resolver_addresses_t addresses;
+    resolver_stats_t before, after;
+    int completed = 0;
+
+    resolver_set_ttl(RESOLVER_DEFAULT_TTL_MS, RESOLVER_DEFAULT_NEGATIVE_TTL_MS);
+    resolver_flush();
+    before = resolver_get_stats();
+
+    /* First lookup goes to getaddrinfo(), the second is served cached */
+    TEST_ASSERT_EQUAL(RESOLVER_SUCCESS, resolver_resolve("localhost", 80, &addresses));
+    TEST_ASSERT(addresses.count > 0);
+    TEST_ASSERT_EQUAL(RESOLVER_SUCCESS, resolver_resolve("localhost", 443, &addresses));
+    after = resolver_get_stats();
+    TEST_ASSERT_EQUAL(before.misses + 1, after.misses);
+    TEST_ASSERT_EQUAL(before.hits + 1, after.hits);
+    TEST_ASSERT_EQUAL(htons(443), addresses.addrs[0].family == AF_INET6
+                      ? ((struct sockaddr_in6*)&addresses.addrs[0].addr)->sin6_port
+                      : ((struct sockaddr_in*)&addresses.addrs[0].addr)->sin_port);
+
+    /* Concurrent lookups of an uncached name share one getaddrinfo() */
+    resolver_flush();
+    before = resolver_get_stats();
+    for (int i = 0; i < 8; i++) {
+        TEST_ASSERT_EQUAL(RESOLVER_SUCCESS,
+                          resolver_resolve_async("localhost", 80, resolver_counter, &completed));
+    }
+    for (int i = 0; i < 1000 && __sync_fetch_and_add(&completed, 0) < 8; i++) {
+        usleep(1000);
+    }
+    after = resolver_get_stats();
+    TEST_ASSERT_EQUAL(8, completed);
+    TEST_ASSERT_EQUAL(before.misses + 1, after.misses);
+    TEST_ASSERT_EQUAL(before.misses + before.hits + before.coalesced + 8,
+                      after.misses + after.hits + after.coalesced);
+
+    /* Expired answers are looked up again */
+    resolver_set_ttl(50, RESOLVER_DEFAULT_NEGATIVE_TTL_MS);
+    resolver_flush();
+    TEST_ASSERT_EQUAL(RESOLVER_SUCCESS, resolver_resolve("localhost", 80, &addresses));
+    usleep(100000);
+    before = resolver_get_stats();
+    TEST_ASSERT_EQUAL(RESOLVER_SUCCESS, resolver_resolve("localhost", 80, &addresses));
+    after = resolver_get_stats();
+    TEST_ASSERT_EQUAL(before.misses + 1, after.misses);
+
+    /* A missing name is remembered (a resolver that cannot answer at all
+     * reports a temporary failure, which is never cached) */
+    if (resolver_resolve("cryptcat-test.invalid", 80, &addresses) == RESOLVER_ERROR_NOT_FOUND) {
+        before = resolver_get_stats();
+        TEST_ASSERT_EQUAL(RESOLVER_ERROR_NOT_FOUND,
+                          resolver_resolve("cryptcat-test.invalid", 80, &addresses));
+        after = resolver_get_stats();
+        TEST_ASSERT_EQUAL(before.negative_hits + 1, after.negative_hits);
+    }
+
+    resolver_set_ttl(RESOLVER_DEFAULT_TTL_MS, RESOLVER_DEFAULT_NEGATIVE_TTL_MS);
+    return TEST_PASS;
+}
+
+/* Test: an idle client gets keepalives, then is evicted */
+TEST_CASE(test_idle_eviction_keepalive) {
+    event_loop_callbacks_t callbacks = { .on_message = pool_on_message };
+    worker_pool_options_t options = {
+        .workers = 1,
+        .idle_timeout_ms = TIMER_IDLE_MS,
+        .keepalive_ms = TIMER_KEEPALIVE_MS
+    };
+    unsigned char buffer[64];
+    worker_stats_t load;
+    worker_pool_t *pool;
+    connection_t *client;
+    uint64_t start, closed_ms;
+    int keepalives = 0;
+
+    TEST_ASSERT_EQUAL(CRYPTO_SUCCESS, crypto_global_init());
+    network_init();
+
+    pool = worker_pool_create(TIMER_PORT, stress_password, &callbacks, &options);
+    TEST_ASSERT_NOT_NULL(pool);
+    TEST_ASSERT_EQUAL(WORKER_POOL_SUCCESS, worker_pool_start(pool));
+
+    client = connect_to_host("127.0.0.1", TIMER_PORT, stress_password);
+    TEST_ASSERT_NOT_NULL(client);
+    TEST_ASSERT_EQUAL(PROTOCOL_SUCCESS, perform_handshake(client, 0, stress_password));
+
+    /* Say nothing; the server fills the silence until it gives up */
+    start = monotonic_ms();
+    for (;;) {
+        message_type_t msg_type;
+        size_t len = sizeof(buffer);
+
+        if (receive_message(client, &msg_type, buffer, &len) != PROTOCOL_SUCCESS) break;
+        if (msg_type == MSG_KEEPALIVE) keepalives++;
+    }
+    closed_ms = monotonic_ms() - start;
+
+    close_connection(client);
+    free(client);
+
+    worker_pool_stop(pool);
+    TEST_ASSERT_EQUAL(WORKER_POOL_SUCCESS, worker_pool_wait(pool));
+    TEST_ASSERT_EQUAL(WORKER_POOL_SUCCESS, worker_pool_get_worker_stats(pool, 0, &load));
+    worker_pool_destroy(pool);
+
+    TEST_ASSERT(keepalives >= 2);
+    TEST_ASSERT(closed_ms >= TIMER_IDLE_MS - 50 && closed_ms < TIMER_IDLE_MS * 3);
+    TEST_ASSERT_EQUAL(1ULL, load.loop.idle_evictions);
+    TEST_ASSERT_EQUAL((uint64_t)keepalives, load.loop.keepalives_sent);
+    return TEST_PASS;
+}
+
+/* Test: one client's message reaches every other client exactly once */
+TEST_CASE(test_broadcast_fanout) {
+    static connection_t *clients[FANOUT_CLIENTS];
+    event_loop_callbacks_t callbacks = { .on_message = fanout_on_message };
+    worker_pool_options_t options = { .workers = 1 };
+    const char *message = "hello, everyone";
+    unsigned char buffer[64];
+    event_loop_stats_t stats;
+    worker_pool_t *pool;
+
+    TEST_ASSERT_EQUAL(CRYPTO_SUCCESS, crypto_global_init());
+    network_init();
+    atomic_store(&fanout_bad_handles, 0);
+
+    pool = worker_pool_create(FANOUT_PORT, stress_password, &callbacks, &options);
+    TEST_ASSERT_NOT_NULL(pool);
+    TEST_ASSERT_EQUAL(WORKER_POOL_SUCCESS, worker_pool_start(pool));
+
+    for (int i = 0; i < FANOUT_CLIENTS; i++) {
+        clients[i] = connect_to_host("127.0.0.1", FANOUT_PORT, stress_password);
+        TEST_ASSERT_NOT_NULL(clients[i]);
+        TEST_ASSERT_EQUAL(PROTOCOL_SUCCESS,
+                          perform_handshake(clients[i], 0, stress_password));
+    }
+
+    /* The server counts a client as established once its handshake
+     * finishes on the loop, shortly after ours */
+    for (int tries = 0; tries < 100; tries++) {
+        stats = worker_pool_get_stats(pool);
+        if (stats.established == FANOUT_CLIENTS) break;
+        usleep(10000);
+    }
+    TEST_ASSERT_EQUAL((uint32_t)FANOUT_CLIENTS, stats.established);
+
+    TEST_ASSERT_EQUAL(PROTOCOL_SUCCESS,
+                      send_message(clients[0], MSG_DATA, (const unsigned char*)message,
+                                   strlen(message)));
+
+    for (int i = 1; i < FANOUT_CLIENTS; i++) {
+        message_type_t msg_type;
+        size_t len = sizeof(buffer);
+
+        TEST_ASSERT_EQUAL(PROTOCOL_SUCCESS,
+                          receive_message(clients[i], &msg_type, buffer, &len));
+        TEST_ASSERT_EQUAL(MSG_DATA, msg_type);
+        TEST_ASSERT_EQUAL(strlen(message), len);
+        TEST_ASSERT_MEMORY_EQUAL(message, buffer, len);
+    }
+
+    for (int i = 0; i < FANOUT_CLIENTS; i++) {
+        close_connection(clients[i]);
+        free(clients[i]);
+    }
+
+    worker_pool_stop(pool);
+    TEST_ASSERT_EQUAL(WORKER_POOL_SUCCESS, worker_pool_wait(pool));
+    stats = worker_pool_get_stats(pool);
+    worker_pool_destroy(pool);
+
+    TEST_ASSERT_EQUAL(1ULL, stats.messages);
+    TEST_ASSERT_EQUAL(0, atomic_load(&fanout_bad_handles));
+    return TEST_PASS;
+}
+
+/* Test: reliable messages over the datagram channel arrive once and in order */
+TEST_CASE(test_datagram_channel) {
+    static unsigned char payload[DATAGRAM_MESSAGE_SIZE];
+    unsigned char buffer[DATAGRAM_MAX_PAYLOAD];
+    datagram_echo_t echo = {0};
+    datagram_stats_t stats;
+    pthread_t echo_tid;
+    connection_t *client;
+    datagram_t *dg = NULL;
+    uint64_t deadline;
+    int sent = 0, received = 0, out_of_order = 0, unreachable = 0;
+
+    TEST_ASSERT_EQUAL(CRYPTO_SUCCESS, crypto_global_init());
+    network_init();
+
+    echo.listener = create_listener(DATAGRAM_PORT, stress_password);
+    TEST_ASSERT_NOT_NULL(echo.listener);
+    atomic_init(&echo.done, 0);
+    pthread_create(&echo_tid, NULL, datagram_echo_thread, &echo);
+
+    /* Results are collected first and checked once the echo thread is
+     * joined, so no failure leaves it running. The first stream message
+     * wakes the server once the channel is open */
+    client = connect_to_host("127.0.0.1", DATAGRAM_PORT, stress_password);
+    if (client && perform_handshake(client, 0, stress_password) == PROTOCOL_SUCCESS &&
+        datagram_open(client, DATAGRAM_DEFAULT_TIMEOUT_MS) == DATAGRAM_SUCCESS &&
+        send_message(client, MSG_DATA, (const unsigned char*)"go", 2) == PROTOCOL_SUCCESS) {
+        dg = get_connection_datagram(client);
+    }
+
+    deadline = monotonic_ms() + DATAGRAM_TIMEOUT_MS;
+    while (dg && !unreachable && received < DATAGRAM_MESSAGES && monotonic_ms() < deadline) {
+        struct pollfd pfd = { datagram_get_socket(dg), POLLIN, 0 };
+        int flags, wait;
+        size_t len;
+
+        /* Keep the window full, one flush per batch */
+        while (sent < DATAGRAM_MESSAGES) {
+            memset(payload, sent & 0xFF, sizeof(payload));
+            memcpy(payload, &sent, sizeof(sent));
+            if (datagram_send(dg, payload, sizeof(payload),
+                              DATAGRAM_SEND_RELIABLE | DATAGRAM_SEND_MORE) != DATAGRAM_SUCCESS) {
+                break;
+            }
+            sent++;
+        }
+        datagram_flush(dg);
+
+        wait = datagram_service(dg);
+        if (wait == DATAGRAM_ERROR_UNREACHABLE) {
+            unreachable = 1;
+            break;
+        }
+        poll(&pfd, 1, wait < 0 || wait > 10 ? 10 : wait);
+
+        len = sizeof(buffer);
+        while (datagram_receive(dg, buffer, &len, &flags) == DATAGRAM_SUCCESS) {
+            int index;
+
+            memcpy(&index, buffer, sizeof(index));
+            if (index != received || len != DATAGRAM_MESSAGE_SIZE ||
+                flags != DATAGRAM_SEND_RELIABLE || buffer[len - 1] != (index & 0xFF)) {
+                out_of_order++;
+            }
+            received++;
+            len = sizeof(buffer);
+        }
+    }
+
+    if (dg) {
+        stats = datagram_get_stats(dg);
+    } else {
+        memset(&stats, 0, sizeof(stats));
+    }
+    atomic_store(&echo.done, 1);
+    pthread_join(echo_tid, NULL);
+    if (client) {
+        close_connection(client);
+        free(client);
+    }
+    close_connection(echo.listener);
+    free(echo.listener);
+
+    test_log("%d x %d bytes echoed: %llu packets in %llu send calls (%llu GSO), "
+             "%llu retransmits, RTO %u ms",
+             received, DATAGRAM_MESSAGE_SIZE, (unsigned long long)stats.packets_sent,
+             (unsigned long long)stats.send_calls, (unsigned long long)stats.gso_sends,
+             (unsigned long long)stats.retransmits, stats.rto_ms);
+
+    TEST_ASSERT_NOT_NULL(dg);
+    TEST_ASSERT_EQUAL(0, unreachable);
+    TEST_ASSERT_EQUAL(0, echo.errors);
+    TEST_ASSERT_EQUAL(DATAGRAM_MESSAGES, received);
+    TEST_ASSERT_EQUAL(0, out_of_order);
+    TEST_ASSERT_EQUAL(0ULL, stats.replays_dropped + stats.auth_failures);
+    return TEST_PASS;
+}
+
+/* Test: the protocol runs unchanged over Unix-domain stream and seqpacket
+ * sockets, with messages larger than one packet */
+TEST_CASE(test_unix_transport) {
+    static unsigned char payload[UNIX_PAYLOAD_SIZE], echoed[UNIX_PAYLOAD_SIZE];
+    char socket_path[64];
+
+    TEST_ASSERT_EQUAL(CRYPTO_SUCCESS, crypto_global_init());
+    network_init();
+
+    for (int seqpacket = 0; seqpacket <= 1; seqpacket++) {
+        unix_echo_t echo = {0};
+        pthread_t echo_tid;
+        connection_t *client;
+        uint64_t started;
+        int matched = 0;
+
+        snprintf(socket_path, sizeof(socket_path), "/tmp/cryptcat-test-unix-%d.sock",
+                 (int)getpid());
+        echo.listener = create_unix_listener(socket_path, seqpacket, stress_password);
+        TEST_ASSERT_NOT_NULL(echo.listener);
+        pthread_create(&echo_tid, NULL, unix_echo_thread, &echo);
+
+        client = connect_to_unix(socket_path, seqpacket, stress_password);
+        TEST_ASSERT_NOT_NULL(client);
+        TEST_ASSERT_EQUAL(PROTOCOL_SUCCESS, perform_handshake(client, 0, stress_password));
+
+        started = monotonic_ms();
+        for (int i = 0; i < UNIX_MESSAGES; i++) {
+            message_type_t msg_type;
+            size_t len = sizeof(echoed);
+
+            memset(payload, i, sizeof(payload));
+            if (send_message(client, MSG_DATA, payload, sizeof(payload)) != PROTOCOL_SUCCESS ||
+                receive_waiting(client, &msg_type, echoed, &len) != PROTOCOL_SUCCESS) {
+                break;
+            }
+            matched += len == sizeof(payload) && memcmp(payload, echoed, len) == 0;
+        }
+
+        test_log("%s: %d x %d byte round trips in %llu ms",
+                 seqpacket ? "seqpacket" : "stream", matched, UNIX_PAYLOAD_SIZE,
+                 (unsigned long long)(monotonic_ms() - started));
+
+        pthread_join(echo_tid, NULL);
+        close_connection(client);
+        free(client);
+        close_connection(echo.listener);
+        free(echo.listener);
+        unlink(socket_path);
+
+        TEST_ASSERT_EQUAL(0, echo.errors);
+        TEST_ASSERT_EQUAL(UNIX_MESSAGES, matched);
+    }
+
+    return TEST_PASS;
+}
+
+/* Test: an authenticated session passed to another process continues
+ * there without a handshake, in both directions */
+TEST_CASE(test_connection_handoff) {
+    unsigned char buffer[64];
+    connection_t *listener, *client, *server = NULL;
+    handshake_t *client_hs, *server_hs;
+    int client_result = PROTOCOL_IN_PROGRESS, server_result = PROTOCOL_IN_PROGRESS;
+    message_type_t msg_type;
+    uint64_t deadline;
+    size_t len;
+    pid_t worker;
+    int channel[2], status;
+
+    TEST_ASSERT_EQUAL(CRYPTO_SUCCESS, crypto_global_init());
+    network_init();
+
+    listener = create_listener(HANDOFF_PORT, stress_password);
+    TEST_ASSERT_NOT_NULL(listener);
+    client = connect_to_host("127.0.0.1", HANDOFF_PORT, stress_password);
+    TEST_ASSERT_NOT_NULL(client);
+    for (int i = 0; i < UNIX_TIMEOUT_MS && !server; i++) {
+        if (!(server = accept_connection(listener))) {
+            usleep(1000);
+        }
+    }
+    TEST_ASSERT_NOT_NULL(server);
+
+    /* Both ends of the handshake from this thread */
+    client_hs = handshake_begin(client, 0, stress_password);
+    server_hs = handshake_begin(server, 1, stress_password);
+    TEST_ASSERT(client_hs && server_hs);
+    deadline = monotonic_ms() + UNIX_TIMEOUT_MS;
+    while ((client_result == PROTOCOL_IN_PROGRESS || server_result == PROTOCOL_IN_PROGRESS) &&
+           monotonic_ms() < deadline) {
+        if (client_result == PROTOCOL_IN_PROGRESS) {
+            client_result = handshake_step(client_hs, 10);
+        }
+        if (server_result == PROTOCOL_IN_PROGRESS) {
+            server_result = handshake_step(server_hs, 10);
+        }
+    }
+    handshake_free(client_hs);
+    handshake_free(server_hs);
+    TEST_ASSERT_EQUAL(PROTOCOL_SUCCESS, client_result);
+    TEST_ASSERT_EQUAL(PROTOCOL_SUCCESS, server_result);
+    TEST_ASSERT_EQUAL(PROTOCOL_SUCCESS,
+                      send_message(client, MSG_DATA, (const unsigned char*)"before", 6));
+    len = sizeof(buffer);
+    TEST_ASSERT_EQUAL(PROTOCOL_SUCCESS, receive_waiting(server, &msg_type, buffer, &len));
+
+    TEST_ASSERT_EQUAL(NETWORK_SUCCESS, create_socket_pair(channel));
+    worker = fork();
+    TEST_ASSERT(worker >= 0);
+    if (worker == 0) {
+        /* Worker: take the session and echo one message */
+        connection_t *taken = accept_passed_connection(channel[1], UNIX_TIMEOUT_MS);
+
+        len = sizeof(buffer);
+        _exit(taken && receive_waiting(taken, &msg_type, buffer, &len) == PROTOCOL_SUCCESS &&
+              send_message(taken, MSG_DATA, buffer, len) == PROTOCOL_SUCCESS ? 0 : 1);
+    }
+
+    TEST_ASSERT_EQUAL(NETWORK_SUCCESS, pass_connection(channel[0], server, UNIX_TIMEOUT_MS));
+    free(server);
+
+    TEST_ASSERT_EQUAL(PROTOCOL_SUCCESS,
+                      send_message(client, MSG_DATA, (const unsigned char*)"after", 5));
+    len = sizeof(buffer);
+    TEST_ASSERT_EQUAL(PROTOCOL_SUCCESS, receive_waiting(client, &msg_type, buffer, &len));
+    TEST_ASSERT_EQUAL(5U, len);
+    TEST_ASSERT_MEMORY_EQUAL("after", buffer, len);
+
+    waitpid(worker, &status, 0);
+    close(channel[0]);
+    close(channel[1]);
+    close_connection(client);
+    free(client);
+    close_connection(listener);
+    free(listener);
+
+    TEST_ASSERT(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+    return TEST_PASS;
+}
+
+/* Test: a new pool takes over listeners and sessions from a stopped
+ * one; nothing is refused and no session handshakes again */
+TEST_CASE(test_hot_restart) {
+    static connection_t *clients[RESTART_CLIENTS];
+    event_loop_callbacks_t callbacks = { .on_message = pool_on_message };
+    worker_pool_options_t options = { .workers = RESTART_WORKERS };
+    unsigned char payload[STRESS_PAYLOAD_SIZE], echo[STRESS_PAYLOAD_SIZE];
+    event_loop_stats_t old_stats, new_stats;
+    worker_pool_t *old_pool, *new_pool;
+    connection_t *late;
+    hand_off_job_t job;
+    message_type_t msg_type;
+    pthread_t thread;
+    int channel[2];
+    size_t len;
+
+    TEST_ASSERT_EQUAL(CRYPTO_SUCCESS, crypto_global_init());
+    network_init();
+
+    old_pool = worker_pool_create(RESTART_PORT, stress_password, &callbacks, &options);
+    TEST_ASSERT_NOT_NULL(old_pool);
+    TEST_ASSERT_EQUAL(WORKER_POOL_SUCCESS, worker_pool_start(old_pool));
+
+    for (int i = 0; i < RESTART_CLIENTS; i++) {
+        clients[i] = connect_to_host("127.0.0.1", RESTART_PORT, stress_password);
+        TEST_ASSERT_NOT_NULL(clients[i]);
+        TEST_ASSERT_EQUAL(PROTOCOL_SUCCESS,
+                          perform_handshake(clients[i], 0, stress_password));
+        build_payload(payload, (uint32_t)i, 0, 0);
+        TEST_ASSERT(echo_round_trip(clients[i], payload, sizeof(payload)));
+    }
+
+    worker_pool_stop(old_pool);
+    TEST_ASSERT_EQUAL(WORKER_POOL_SUCCESS, worker_pool_wait(old_pool));
+
+    /* In flight across the restart: a message the old pool never
+     * delivers and a client it never accepts */
+    build_payload(payload, 0, 1, 1);
+    TEST_ASSERT_EQUAL(PROTOCOL_SUCCESS,
+                      send_message(clients[0], MSG_DATA, payload, sizeof(payload)));
+    late = connect_to_host("127.0.0.1", RESTART_PORT, stress_password);
+    TEST_ASSERT_NOT_NULL(late);
+
+    TEST_ASSERT_EQUAL(NETWORK_SUCCESS, create_socket_pair(channel));
+    job.pool = old_pool;
+    job.channel_fd = channel[0];
+    job.passed = -1;
+    TEST_ASSERT_EQUAL(0, pthread_create(&thread, NULL, hand_off_thread, &job));
+    new_pool = worker_pool_take_over(channel[1], stress_password, &callbacks, &options,
+                                     UNIX_TIMEOUT_MS);
+    pthread_join(thread, NULL);
+    close(channel[1]);
+
+    old_stats = worker_pool_get_stats(old_pool);
+    worker_pool_destroy(old_pool);
+    TEST_ASSERT_NOT_NULL(new_pool);
+    TEST_ASSERT_EQUAL(RESTART_CLIENTS, job.passed);
+    TEST_ASSERT_EQUAL(RESTART_WORKERS, worker_pool_size(new_pool));
+    TEST_ASSERT_EQUAL(WORKER_POOL_SUCCESS, worker_pool_start(new_pool));
+
+    /* Same keys and sequence numbers: the pending message is answered */
+    len = sizeof(echo);
+    TEST_ASSERT_EQUAL(PROTOCOL_SUCCESS, receive_message(clients[0], &msg_type, echo, &len));
+    TEST_ASSERT_EQUAL(sizeof(payload), len);
+    TEST_ASSERT_MEMORY_EQUAL(payload, echo, len);
+
+    for (int i = 0; i < RESTART_CLIENTS; i++) {
+        build_payload(payload, (uint32_t)i, 2, 2);
+        TEST_ASSERT(echo_round_trip(clients[i], payload, sizeof(payload)));
+    }
+
+    /* The late client waited in the accept queue the new pool inherited */
+    TEST_ASSERT_EQUAL(PROTOCOL_SUCCESS, perform_handshake(late, 0, stress_password));
+    build_payload(payload, RESTART_CLIENTS, 0, 3);
+    TEST_ASSERT(echo_round_trip(late, payload, sizeof(payload)));
+
+    worker_pool_stop(new_pool);
+    TEST_ASSERT_EQUAL(WORKER_POOL_SUCCESS, worker_pool_wait(new_pool));
+    new_stats = worker_pool_get_stats(new_pool);
+    worker_pool_destroy(new_pool);
+
+    for (int i = 0; i < RESTART_CLIENTS; i++) {
+        close_connection(clients[i]);
+        free(clients[i]);
+    }
+    close_connection(late);
+    free(late);
+
+    test_log("Old pool: %llu detached; new pool: %llu adopted, %llu accepted",
+             (unsigned long long)old_stats.detached,
+             (unsigned long long)new_stats.adopted,
+             (unsigned long long)new_stats.accepted);
+    TEST_ASSERT_EQUAL((uint64_t)RESTART_CLIENTS, old_stats.detached);
+    TEST_ASSERT_EQUAL((uint64_t)RESTART_CLIENTS, new_stats.adopted);
+    TEST_ASSERT_EQUAL(1ULL, new_stats.accepted);
+    return TEST_PASS;
+}
+
+/* Test: closing a connection whose zerocopy output is still pinned
+ * returns at once; the socket is reaped when the peer drains it */
+TEST_CASE(test_close_with_pinned_output) {
+    static unsigned char payload[PINNED_PAYLOAD_SIZE];
+    static unsigned char buffer[PINNED_PAYLOAD_SIZE];
+    connection_t *listener, *client, *server = NULL;
+    handshake_t *client_hs, *server_hs;
+    int client_result = PROTOCOL_IN_PROGRESS, server_result = PROTOCOL_IN_PROGRESS;
+    connection_info_t info;
+    message_type_t msg_type;
+    uint64_t deadline, start, close_ms;
+    int waiting, result, received = 0;
+    size_t len;
+
+    TEST_ASSERT_EQUAL(CRYPTO_SUCCESS, crypto_global_init());
+    network_init();
+
+    listener = create_listener(PINNED_PORT, stress_password);
+    TEST_ASSERT_NOT_NULL(listener);
+    client = connect_to_host("127.0.0.1", PINNED_PORT, stress_password);
+    TEST_ASSERT_NOT_NULL(client);
+    for (int i = 0; i < PINNED_TIMEOUT_MS && !server; i++) {
+        if (!(server = accept_connection(listener))) {
+            usleep(1000);
+        }
+    }
+    TEST_ASSERT_NOT_NULL(server);
+
+    client_hs = handshake_begin(client, 0, stress_password);
+    server_hs = handshake_begin(server, 1, stress_password);
+    TEST_ASSERT(client_hs && server_hs);
+    deadline = monotonic_ms() + PINNED_TIMEOUT_MS;
+    while ((client_result == PROTOCOL_IN_PROGRESS || server_result == PROTOCOL_IN_PROGRESS) &&
+           monotonic_ms() < deadline) {
+        if (client_result == PROTOCOL_IN_PROGRESS) {
+            client_result = handshake_step(client_hs, 10);
+        }
+        if (server_result == PROTOCOL_IN_PROGRESS) {
+            server_result = handshake_step(server_hs, 10);
+        }
+    }
+    handshake_free(client_hs);
+    handshake_free(server_hs);
+    TEST_ASSERT_EQUAL(PROTOCOL_SUCCESS, client_result);
+    TEST_ASSERT_EQUAL(PROTOCOL_SUCCESS, server_result);
+
+    /* The client does not read yet, so the last records the socket took
+     * cannot complete */
+    set_connection_zerocopy(server, 1);
+    set_connection_async_send(server, 1);
+    for (int i = 0; i < PINNED_RECORDS; i++) {
+        memset(payload, i & 0xFF, sizeof(payload));
+        TEST_ASSERT_EQUAL(PROTOCOL_SUCCESS,
+                          send_message(server, MSG_DATA, payload, sizeof(payload)));
+    }
+    flush_connection(server);
+    info = get_connection_info(server);
+    if (info.zerocopy_sends == 0) {
+        test_log("Kernel refused SO_ZEROCOPY; nothing to pin");
+    }
+
+    start = monotonic_ms();
+    close_connection(server);
+    free(server);
+    close_ms = monotonic_ms() - start;
+    waiting = network_reap_closed();
+
+    /* Draining the client releases the pinned records */
+    for (;;) {
+        if (connection_input_pending(client) == 0 &&
+            wait_for_socket(get_connection_socket(client), PINNED_TIMEOUT_MS, 1, 0) <= 0) {
+            break;
+        }
+        len = sizeof(buffer);
+        result = receive_message(client, &msg_type, buffer, &len);
+        if (result == PROTOCOL_SUCCESS) {
+            received++;
+        } else if (result != PROTOCOL_IN_PROGRESS) {
+            break;
+        }
+    }
+
+    deadline = monotonic_ms() + PINNED_TIMEOUT_MS;
+    while (network_reap_closed() > 0 && monotonic_ms() < deadline) {
+        usleep(1000);
+    }
+
+    close_connection(client);
+    free(client);
+    close_connection(listener);
+    free(listener);
+
+    test_log("%llu zerocopy sends; close took %llu ms with %d socket(s) left to "
+             "reap; client read %d records",
+             (unsigned long long)info.zerocopy_sends, (unsigned long long)close_ms,
+             waiting, received);
+    TEST_ASSERT(close_ms < PINNED_CLOSE_MS);
+    TEST_ASSERT(info.zerocopy_sends == 0 || waiting == 1);
+    TEST_ASSERT(received > 0);
+    TEST_ASSERT_EQUAL(0, network_reap_closed());
+    return TEST_PASS;
+}
+
+/* Test: a handshake stepped while its keys are still being derived
+ * returns after its timeout instead of waiting for the KDF */
+TEST_CASE(test_handshake_kdf_timeout) {
+    connection_t *listener, *client, *server = NULL;
+    handshake_t *client_hs, *server_hs;
+    int client_result = PROTOCOL_IN_PROGRESS, server_result = PROTOCOL_IN_PROGRESS;
+    uint64_t deadline, start, elapsed, longest = 0;
+    int steps = 0;
+
+    TEST_ASSERT_EQUAL(CRYPTO_SUCCESS, crypto_global_init());
+    network_init();
+
+    listener = create_listener(KDF_WAIT_PORT, stress_password);
+    TEST_ASSERT_NOT_NULL(listener);
+    client = connect_to_host("127.0.0.1", KDF_WAIT_PORT, stress_password);
+    TEST_ASSERT_NOT_NULL(client);
+    for (int i = 0; i < KDF_TIMEOUT_MS && !server; i++) {
+        if (!(server = accept_connection(listener))) {
+            usleep(1000);
+        }
+    }
+    TEST_ASSERT_NOT_NULL(server);
+
+    /* No ticket for this port, so both sides derive keys. The client
+     * never blocks, so every wait below is the server's: for the init,
+     * for its keys, then for the client's complete */
+    client_hs = handshake_begin(client, 0, stress_password);
+    server_hs = handshake_begin(server, 1, stress_password);
+    TEST_ASSERT(client_hs && server_hs);
+    deadline = monotonic_ms() + KDF_TIMEOUT_MS;
+    while ((client_result == PROTOCOL_IN_PROGRESS || server_result == PROTOCOL_IN_PROGRESS) &&
+           monotonic_ms() < deadline) {
+        if (client_result == PROTOCOL_IN_PROGRESS) {
+            client_result = handshake_step(client_hs, 0);
+        }
+        if (server_result == PROTOCOL_IN_PROGRESS) {
+            start = monotonic_ms();
+            server_result = handshake_step(server_hs, KDF_STEP_MS);
+            elapsed = monotonic_ms() - start;
+            if (elapsed > longest) longest = elapsed;
+            steps++;
+        }
+    }
+    handshake_free(client_hs);
+    handshake_free(server_hs);
+    close_connection(client);
+    free(client);
+    close_connection(server);
+    free(server);
+    close_connection(listener);
+    free(listener);
+
+    test_log("%d server step(s) of %d ms, longest %llu ms",
+             steps, KDF_STEP_MS, (unsigned long long)longest);
+    TEST_ASSERT_EQUAL(PROTOCOL_SUCCESS, client_result);
+    TEST_ASSERT_EQUAL(PROTOCOL_SUCCESS, server_result);
+    TEST_ASSERT(longest < KDF_STEP_MS + KDF_STEP_SLACK_MS);
+    return TEST_PASS;
+}
+
+/* Test: records written a few bytes at a time reach the loop whole */
+TEST_CASE(test_loop_partial_records) {
+    static unsigned char payload[PIECES_PAYLOAD_SIZE], echo[PIECES_PAYLOAD_SIZE];
+    event_loop_callbacks_t callbacks = { .on_message = echo_on_message };
+    trickle_relay_t relay = { NULL, 0 };
+    message_type_t msg_type = MSG_ERROR;
+    size_t echo_len = sizeof(echo);
+    event_loop_stats_t stats;
+    event_loop_t *loop;
+    connection_t *listener, *client;
+    pthread_t loop_tid, relay_tid;
+    int handshake, sent, received;
+
+    TEST_ASSERT_EQUAL(CRYPTO_SUCCESS, crypto_global_init());
+    network_init();
+
+    loop = event_loop_create(stress_password, &callbacks, EVENT_LOOP_DEFAULT_MAX_CONNECTIONS);
+    TEST_ASSERT_NOT_NULL(loop);
+    listener = create_listener(PIECES_PORT, stress_password);
+    TEST_ASSERT_NOT_NULL(listener);
+    TEST_ASSERT_EQUAL(EVENT_LOOP_SUCCESS, event_loop_add_listener(loop, listener));
+    relay.listener = create_listener(PIECES_RELAY_PORT, stress_password);
+    TEST_ASSERT_NOT_NULL(relay.listener);
+
+    pthread_create(&loop_tid, NULL, loop_thread, loop);
+    pthread_create(&relay_tid, NULL, trickle_relay_thread, &relay);
+
+    for (size_t i = 0; i < sizeof(payload); i++) {
+        payload[i] = (unsigned char)(i * 31 + 7);
+    }
+
+    /* The handshake crosses the relay too, so it arrives in pieces */
+    client = connect_to_host("127.0.0.1", PIECES_RELAY_PORT, stress_password);
+    handshake = client ? perform_handshake(client, 0, stress_password) : PROTOCOL_ERROR_NETWORK;
+    sent = handshake == PROTOCOL_SUCCESS
+         ? send_message(client, MSG_DATA, payload, sizeof(payload)) : handshake;
+    received = sent == PROTOCOL_SUCCESS
+             ? receive_message(client, &msg_type, echo, &echo_len) : sent;
+
+    /* Closing the client ends the relay */
+    if (client) {
+        close_connection(client);
+        free(client);
+    }
+    pthread_join(relay_tid, NULL);
+    close_connection(relay.listener);
+    free(relay.listener);
+
+    event_loop_stop(loop);
+    pthread_join(loop_tid, NULL);
+    stats = event_loop_get_stats(loop);
+    event_loop_destroy(loop);
+
+    test_log("%zu-byte payload in %d relayed writes: %llu messages", sizeof(payload),
+             relay.writes, (unsigned long long)stats.messages);
+    TEST_ASSERT_EQUAL(PROTOCOL_SUCCESS, handshake);
+    TEST_ASSERT_EQUAL(PROTOCOL_SUCCESS, sent);
+    TEST_ASSERT_EQUAL(PROTOCOL_SUCCESS, received);
+    TEST_ASSERT_EQUAL(MSG_DATA, msg_type);
+    TEST_ASSERT_EQUAL(sizeof(payload), echo_len);
+    TEST_ASSERT_MEMORY_EQUAL(payload, echo, sizeof(payload));
+    TEST_ASSERT_EQUAL(1ULL, stats.messages);
+    return TEST_PASS;
+}
+
+/* Test: a ticket sealed under a retired key is refused; the client
+ * finishes a full handshake on the same connection and its early data
+ * arrives once, in order, under the new keys */
+TEST_CASE(test_refused_ticket_fallback) {
+    static const char *early[] = { "early one", "early two", "after fallback" };
+    ticket_echo_t echo = {0};
+    pthread_t echo_tid;
+    connection_t *client;
+    int resumed[REFUSED_CONNECTIONS] = {0};
+    int handshaken[REFUSED_CONNECTIONS] = {0};
+    int echoed[REFUSED_CONNECTIONS] = {0};
+
+    TEST_ASSERT_EQUAL(CRYPTO_SUCCESS, crypto_global_init());
+    network_init();
+
+    echo.listener = create_listener(REFUSED_PORT, stress_password);
+    TEST_ASSERT_NOT_NULL(echo.listener);
+    pthread_create(&echo_tid, NULL, ticket_echo_thread, &echo);
+
+    /* Results are checked once the echo thread is joined. A full
+     * handshake leaves the client a ticket for the next connection */
+    client = connect_to_host("127.0.0.1", REFUSED_PORT, stress_password);
+    if (client) {
+        handshaken[0] = client_handshake(client, &resumed[0]) == PROTOCOL_SUCCESS;
+        echoed[0] = handshaken[0] &&
+                    send_message(client, MSG_DATA, (const unsigned char*)"full", 4)
+                        == PROTOCOL_SUCCESS &&
+                    receive_echo(client, "full");
+        close_connection(client);
+        free(client);
+    }
+
+    /* Retire the key the ticket was sealed under */
+    for (int i = 0; i < 8; i++) {
+        session_ticket_rotate_keys();
+    }
+
+    /* 0-RTT data goes out before the server has seen the ticket */
+    client = connect_to_host("127.0.0.1", REFUSED_PORT, stress_password);
+    if (client) {
+        handshaken[1] = client_handshake(client, &resumed[1]) == PROTOCOL_SUCCESS;
+        echoed[1] = handshaken[1];
+        for (int i = 0; i < 2 && echoed[1]; i++) {
+            echoed[1] = send_message(client, MSG_DATA, (const unsigned char*)early[i],
+                                     strlen(early[i])) == PROTOCOL_SUCCESS;
+        }
+        for (int i = 0; i < 2 && echoed[1]; i++) {
+            echoed[1] = receive_echo(client, early[i]);
+        }
+        echoed[1] = echoed[1] &&
+                    send_message(client, MSG_DATA, (const unsigned char*)early[2],
+                                 strlen(early[2])) == PROTOCOL_SUCCESS &&
+                    receive_echo(client, early[2]);
+        close_connection(client);
+        free(client);
+    }
+
+    /* The fallback handshake left a fresh ticket, which is accepted */
+    client = connect_to_host("127.0.0.1", REFUSED_PORT, stress_password);
+    if (client) {
+        handshaken[2] = client_handshake(client, &resumed[2]) == PROTOCOL_SUCCESS;
+        echoed[2] = handshaken[2] &&
+                    send_message(client, MSG_DATA, (const unsigned char*)"resumed", 7)
+                        == PROTOCOL_SUCCESS &&
+                    receive_echo(client, "resumed");
+        close_connection(client);
+        free(client);
+    }
+
+    pthread_join(echo_tid, NULL);
+    close_connection(echo.listener);
+    free(echo.listener);
+
+    TEST_ASSERT_EQUAL(0, echo.errors);
+    for (int i = 0; i < REFUSED_CONNECTIONS; i++) {
+        TEST_ASSERT_EQUAL(1, handshaken[i]);
+        TEST_ASSERT_EQUAL(1, echoed[i]);
+    }
+    TEST_ASSERT_EQUAL(0, resumed[0]);
+    TEST_ASSERT_EQUAL(1, resumed[1]);
+    TEST_ASSERT_EQUAL(1, resumed[2]);
+    TEST_ASSERT_EQUAL(5, echo.echoed);
+    return TEST_PASS;
+}
+
+/* ===== Suite Registration ===== */
+
+__attribute__((constructor)) static void register_concurrency_tests(void) {
+    test_suite_t *suite = test_suite_create("Concurrent Connection Tests");
+    if (!suite) return;
+
+    test_suite_add_test(suite, "test_concurrent_send_ordering", test_concurrent_send_ordering);
+    test_suite_add_test(suite, "test_handshake_kdf_timeout", test_handshake_kdf_timeout);
+    test_suite_add_test(suite, "test_loop_partial_records", test_loop_partial_records);
+    test_suite_add_test(suite, "test_worker_pool_sharding", test_worker_pool_sharding);
+    test_suite_add_test(suite, "test_slow_receiver_backpressure",
+                        test_slow_receiver_backpressure);
+    test_suite_add_test(suite, "test_agent_session_reuse", test_agent_session_reuse);
+    test_suite_add_test(suite, "test_connect_racing", test_connect_racing);
+    test_suite_add_test(suite, "test_resolver_cache", test_resolver_cache);
+    test_suite_add_test(suite, "test_idle_eviction_keepalive", test_idle_eviction_keepalive);
+    test_suite_add_test(suite, "test_broadcast_fanout", test_broadcast_fanout);
+    test_suite_add_test(suite, "test_datagram_channel", test_datagram_channel);
+    test_suite_add_test(suite, "test_unix_transport", test_unix_transport);
+    test_suite_add_test(suite, "test_connection_handoff", test_connection_handoff);
+    test_suite_add_test(suite, "test_hot_restart", test_hot_restart);
+
+    test_suite_add_test(suite, "test_close_with_pinned_output",
+                        test_close_with_pinned_output);
+    test_suite_add_test(suite, "test_refused_ticket_fallback", test_refused_ticket_fallback);
+    test_register_suite(suite);
+}
@@ -13,13 +13,23 @@
 #include <string.h>
 #include <unistd.h>
 #include <pthread.h>
+#include <poll.h>
+#include <fcntl.h>
 #include <sys/stat.h>
 
+/* Integrity-only receiver tampering, applied once the data is in */
+#define TAMPER_NONE 0
+#define TAMPER_DATA 1               /* Flip a byte of the received file */
+#define TAMPER_TAG 2                /* Flip a byte of the tag in MSG_FILE_END */
+
 /* Test server thread */
 typedef struct {
     int port;
     const char *password;
     int running;
+    int result;
+    const char *filename;           /* Integrity-only: file being received */
+    int tamper;
 } server_context_t;
 
 static void* file_transfer_server(void *arg) {
@@ -45,9 +55,10 @@ static void* file_transfer_server(void *arg) {
                 printf("Server: Handshake successful\n");
                 
                 /* Receive file */
-                unsigned char buffer[1024];
+                static unsigned char buffer[65536 + 4];
                 size_t buffer_len = sizeof(buffer);
                 message_type_t msg_type;
+                uint64_t bytes_received = 0;
                 
                 /* Wait for file start message */
                 result = receive_message(client, &msg_type, buffer, &buffer_len);
@@ -64,8 +75,13 @@ static void* file_transfer_server(void *arg) {
                                 printf("Server: File transfer complete\n");
                                 break;
                             } else if (msg_type == MSG_FILE_CHUNK) {
-                                /* Process chunk */
+                                /* Process chunk (payload: chunk number + data) */
                                 printf("Server: Received chunk of %zu bytes\n", buffer_len);
+                                
+                                /* Return credit so the sender keeps going */
+                                bytes_received += buffer_len - 4;
+                                send_window_update(client, bytes_received,
+                                                   bytes_received + 256 * 1024);
                             }
                         } else {
                             printf("Server: Error receiving message: %d\n", result);
@@ -87,6 +103,322 @@ static void* file_transfer_server(void *arg) {
     return NULL;
 }
 
+/* Striped receiver: the control connection, plus lanes accepted as they join */
+static void* striped_server(void *arg) {
+    server_context_t *ctx = (server_context_t*)arg;
+    connection_t *listener = create_listener(ctx->port, ctx->password);
+    connection_t *client = NULL;
+    file_transfer_t *transfer = NULL;
+    static unsigned char buffer[65536 + 4];
+    message_type_t msg_type;
+    size_t buffer_len;
+    
+    ctx->result = FILE_TRANSFER_ERROR_STATE;
+    if (!listener) {
+        printf("Server: Failed to create listener\n");
+        return NULL;
+    }
+    
+    ctx->running = 1;
+    
+    /* The listener does not block; wait for the client to connect */
+    while (ctx->running && !(client = accept_connection(listener))) {
+        usleep(10000);
+    }
+    if (!client || perform_handshake(client, 1, ctx->password) != PROTOCOL_SUCCESS) {
+        printf("Server: Control connection failed\n");
+        ctx->running = 0;
+    }
+    
+    while (ctx->running) {
+        struct pollfd fds[2] = {
+            { get_connection_socket(listener), POLLIN, 0 },
+            { get_connection_socket(client), POLLIN, 0 }
+        };
+        
+        if (poll(fds, 2, 100) <= 0) {
+            continue;
+        }
+        
+        /* New lane: authenticate it and hand it to its transfer */
+        if (fds[0].revents & POLLIN) {
+            connection_t *lane = accept_connection(listener);
+            int result = PROTOCOL_ERROR_STATE;
+            
+            /* Lanes do not block either; the join may trail the handshake */
+            if (lane && perform_handshake(lane, 1, ctx->password) == PROTOCOL_SUCCESS) {
+                do {
+                    buffer_len = sizeof(buffer);
+                    result = receive_message(lane, &msg_type, buffer, &buffer_len);
+                } while (result == PROTOCOL_IN_PROGRESS &&
+                         wait_for_connection(lane, 5000, 1, 0) > 0);
+            }
+            if (result == PROTOCOL_SUCCESS &&
+                msg_type == MSG_STRIPE_JOIN &&
+                stripe_join(lane, buffer, buffer_len) == STRIPE_SUCCESS) {
+                printf("Server: Lane joined\n");
+            } else if (lane) {
+                close_connection(lane);
+                free(lane);
+            }
+        }
+        
+        if (fds[1].revents & POLLIN) {
+            int result;
+            
+            buffer_len = sizeof(buffer);
+            result = receive_message(client, &msg_type, buffer, &buffer_len);
+            if (result == PROTOCOL_IN_PROGRESS) {
+                continue;
+            } else if (result != PROTOCOL_SUCCESS) {
+                printf("Server: Control connection lost\n");
+                break;
+            }
+            
+            if (msg_type == MSG_FILE_START) {
+                transfer = start_file_receive(client, buffer, buffer_len);
+            } else if (msg_type == MSG_FILE_END && transfer) {
+                ctx->result = receive_file_end(transfer, buffer, buffer_len);
+                break;
+            }
+        }
+    }
+    
+    cleanup_file_transfer(transfer);
+    if (client) {
+        close_connection(client);
+        free(client);
+    }
+    close_connection(listener);
+    free(listener);
+    return NULL;
+}
+
+/* Receiver that talks back mid-transfer, then hangs up without granting credit */
+static void* talkative_server(void *arg) {
+    server_context_t *ctx = (server_context_t*)arg;
+    connection_t *listener = create_listener(ctx->port, ctx->password);
+    connection_t *client = NULL;
+    static unsigned char buffer[65536 + 4];
+    message_type_t msg_type;
+    size_t buffer_len;
+    int result = PROTOCOL_IN_PROGRESS;
+    
+    if (!listener) {
+        printf("Server: Failed to create listener\n");
+        return NULL;
+    }
+    
+    ctx->running = 1;
+    while (ctx->running && !client) {
+        client = accept_connection(listener);
+        usleep(10000);
+    }
+    if (!client || perform_handshake(client, 1, ctx->password) != PROTOCOL_SUCCESS) {
+        printf("Server: Connection failed\n");
+        ctx->running = 0;
+    }
+    
+    /* Wait for the file to be announced */
+    while (ctx->running && result != PROTOCOL_SUCCESS) {
+        wait_for_socket(get_connection_socket(client), 100, 1, 0);
+        buffer_len = sizeof(buffer);
+        result = receive_message(client, &msg_type, buffer, &buffer_len);
+        if (result == PROTOCOL_SUCCESS && msg_type != MSG_FILE_START) {
+            result = PROTOCOL_IN_PROGRESS;
+        } else if (result != PROTOCOL_SUCCESS && result != PROTOCOL_IN_PROGRESS) {
+            ctx->running = 0;
+        }
+    }
+    
+    if (ctx->running) {
+        send_message(client, MSG_DATA, (const unsigned char*)"status?", 7);
+        send_disconnect(client, "receiver going away");
+        
+        /* Keep reading so the sender sees the disconnect rather than a reset */
+        do {
+            wait_for_socket(get_connection_socket(client), 100, 1, 0);
+            buffer_len = sizeof(buffer);
+            result = receive_message(client, &msg_type, buffer, &buffer_len);
+        } while (ctx->running && (result == PROTOCOL_SUCCESS || result == PROTOCOL_IN_PROGRESS));
+    }
+    
+    if (client) {
+        close_connection(client);
+        free(client);
+    }
+    close_connection(listener);
+    free(listener);
+    return NULL;
+}
+
+/* Integrity-only receiver: clear bulk chunks, then the tag check */
+static void* integrity_server(void *arg) {
+    server_context_t *ctx = (server_context_t*)arg;
+    connection_t *listener = create_listener(ctx->port, ctx->password);
+    connection_t *client = NULL;
+    file_transfer_t *transfer = NULL;
+    static unsigned char buffer[65536 + 4];
+    message_type_t msg_type;
+    size_t buffer_len;
+    int result;
+    
+    ctx->result = FILE_TRANSFER_ERROR_STATE;
+    if (!listener) {
+        printf("Server: Failed to create listener\n");
+        return NULL;
+    }
+    
+    ctx->running = 1;
+    while (ctx->running && !(client = accept_connection(listener))) {
+        usleep(10000);
+    }
+    if (!client || perform_handshake(client, 1, ctx->password) != PROTOCOL_SUCCESS) {
+        printf("Server: Connection failed\n");
+        ctx->running = 0;
+    }
+    
+    while (ctx->running) {
+        wait_for_socket(get_connection_socket(client), 100, 1, 0);
+        buffer_len = sizeof(buffer);
+        result = receive_message(client, &msg_type, buffer, &buffer_len);
+        if (result == PROTOCOL_IN_PROGRESS) {
+            continue;
+        } else if (result != PROTOCOL_SUCCESS) {
+            printf("Server: Connection lost\n");
+            break;
+        }
+        
+        if (msg_type == MSG_FILE_START) {
+            transfer = start_file_receive(client, buffer, buffer_len);
+            if (!transfer) {
+                break;
+            }
+        } else if (msg_type == MSG_FILE_BULK && transfer) {
+            result = receive_file_bulk(transfer, buffer, buffer_len);
+            if (result != FILE_TRANSFER_IN_PROGRESS) {
+                ctx->result = result;
+                break;
+            }
+        } else if (msg_type == MSG_FILE_END && transfer) {
+            if (ctx->tamper == TAMPER_DATA) {
+                char part[512];
+                unsigned char byte = 0;
+                int fd;
+                
+                snprintf(part, sizeof(part), "%s.part", ctx->filename);
+                fd = open(part, O_RDWR);
+                if (fd >= 0 && pread(fd, &byte, 1, 4096) == 1) {
+                    byte ^= 0x01;
+                    if (pwrite(fd, &byte, 1, 4096) != 1) {
+                        printf("Server: Failed to tamper with '%s'\n", part);
+                    }
+                }
+                if (fd >= 0) {
+                    close(fd);
+                }
+            } else if (ctx->tamper == TAMPER_TAG) {
+                buffer[0] ^= 0x01;
+            }
+            ctx->result = receive_file_end(transfer, buffer, buffer_len);
+            break;
+        }
+    }
+    
+    cleanup_file_transfer(transfer);
+    if (client) {
+        close_connection(client);
+        free(client);
+    }
+    close_connection(listener);
+    free(listener);
+    return NULL;
+}
+
+/* Send filename integrity-only to a receiver on port, tampering as asked.
+ * Returns the receiver's result */
+static int run_integrity_transfer(const char *filename, int port, int tamper) {
+    int status;
+    
+    server_context_t server_ctx = {
+        .port = port,
+        .password = "integrity_only_test",
+        .running = 0,
+        .filename = filename,
+        .tamper = tamper
+    };
+    
+    pthread_t server_thread;
+    pthread_create(&server_thread, NULL, integrity_server, &server_ctx);
+    
+    while (!server_ctx.running) {
+        usleep(100000);
+    }
+    
+    connection_t *client = connect_to_host("127.0.0.1", server_ctx.port, server_ctx.password);
+    if (!client || perform_handshake(client, 0, server_ctx.password) != PROTOCOL_SUCCESS) {
+        printf("Client: Failed to connect\n");
+        server_ctx.running = 0;
+        pthread_join(server_thread, NULL);
+        if (client) {
+            close_connection(client);
+            free(client);
+        }
+        return FILE_TRANSFER_ERROR_NETWORK;
+    }
+    
+    file_transfer_t *transfer = start_file_send_mode(client, filename,
+                                                     FILE_TRANSFER_INTEGRITY_ONLY);
+    
+    /* The sender reads through its open descriptor; the name is left
+     * for the file the receiver renames into place */
+    remove(filename);
+    
+    if (!transfer) {
+        printf("Client: Failed to start integrity-only transfer\n");
+        server_ctx.running = 0;
+    } else {
+        do {
+            status = process_file_transfer(transfer);
+        } while (status == FILE_TRANSFER_IN_PROGRESS);
+        
+        if (status != FILE_TRANSFER_SUCCESS) {
+            printf("Client: Transfer ended with %d\n", status);
+            server_ctx.running = 0;
+        }
+        cleanup_file_transfer(transfer);
+    }
+    
+    /* A receiver left waiting on the stream sees the close */
+    if (!server_ctx.running) {
+        close_connection(client);
+        pthread_join(server_thread, NULL);
+    } else {
+        pthread_join(server_thread, NULL);
+        close_connection(client);
+    }
+    free(client);
+    
+    return server_ctx.result;
+}
+
+/* Create the integrity-only test file, returning its size */
+static size_t create_integrity_file(const char *filename) {
+    size_t file_size = 4 * 1024 * 1024 + 123;
+    FILE *file = fopen(filename, "wb");
+    
+    if (!file) {
+        printf("Failed to create integrity-only test file\n");
+        return 0;
+    }
+    for (size_t i = 0; i < file_size; i++) {
+        fputc((int)((i * 7) % 253), file);
+    }
+    fclose(file);
+    
+    return file_size;
+}
+
 /* Test file transfer */
 int test_basic_file_transfer(void) {
     printf("\n=== Basic File Transfer Test ===\n");
@@ -396,6 +728,237 @@ int test_encrypted_file_transfer(void) {
     return 0;
 }
 
+/* Test striped file transfer over several lanes */
+int test_striped_file_transfer(void) {
+    printf("\n=== Striped File Transfer Test ===\n");
+    
+    const char *filename = "test_striped_file.bin";
+    size_t file_size = 8 * 1024 * 1024 + 1000;
+    stripe_lane_stats_t lanes[STRIPE_MAX_LANES];
+    int status, lane_count;
+    
+    FILE *file = fopen(filename, "wb");
+    if (!file) {
+        printf("Failed to create striped test file\n");
+        return -1;
+    }
+    for (size_t i = 0; i < file_size; i++) {
+        fputc((int)((i * 31) % 251), file);
+    }
+    fclose(file);
+    
+    server_context_t server_ctx = {
+        .port = 32003,
+        .password = "striped_test",
+        .running = 0
+    };
+    
+    pthread_t server_thread;
+    pthread_create(&server_thread, NULL, striped_server, &server_ctx);
+    
+    while (!server_ctx.running) {
+        usleep(100000);
+    }
+    
+    connection_t *client = connect_to_host("127.0.0.1", server_ctx.port, server_ctx.password);
+    if (!client || perform_handshake(client, 0, server_ctx.password) != PROTOCOL_SUCCESS) {
+        printf("Client: Failed to connect\n");
+        server_ctx.running = 0;
+        pthread_join(server_thread, NULL);
+        remove(filename);
+        return -1;
+    }
+    
+    file_transfer_t *transfer = start_file_send_striped(client, filename,
+                                                        server_ctx.password, 4);
+    if (!transfer) {
+        printf("Client: Failed to start striped transfer\n");
+        close_connection(client);
+        server_ctx.running = 0;
+        pthread_join(server_thread, NULL);
+        remove(filename);
+        return -1;
+    }
+    
+    do {
+        status = process_file_transfer(transfer);
+    } while (status == FILE_TRANSFER_IN_PROGRESS);
+    
+    lane_count = get_file_transfer_lanes(transfer, lanes, STRIPE_MAX_LANES);
+    for (int i = 0; i < lane_count; i++) {
+        printf("Lane %d: %lu bytes, %u chunks, %lu bytes/s, %u steals\n", i,
+               (unsigned long)lanes[i].bytes, lanes[i].chunks,
+               (unsigned long)lanes[i].rate, lanes[i].steals);
+    }
+    
+    cleanup_file_transfer(transfer);
+    pthread_join(server_thread, NULL);
+    close_connection(client);
+    free(client);
+    remove(filename);
+    
+    if (status != FILE_TRANSFER_SUCCESS || server_ctx.result != FILE_TRANSFER_SUCCESS ||
+        lane_count != 4) {
+        printf("Striped transfer failed: sender %d, receiver %d\n",
+               status, server_ctx.result);
+        return -1;
+    }
+    
+    return 0;
+}
+
+/* Test that peer messages during a send are queued, and a disconnect ends it */
+int test_send_with_peer_messages(void) {
+    printf("\n=== File Send With Peer Messages Test ===\n");
+    
+    const char *filename = "test_peer_messages.bin";
+    size_t file_size = 1024 * 1024;
+    unsigned char buffer[64];
+    size_t buffer_len;
+    message_type_t msg_type;
+    int status, queued = 0;
+    
+    FILE *file = fopen(filename, "wb");
+    if (!file) {
+        printf("Failed to create test file\n");
+        return -1;
+    }
+    for (size_t i = 0; i < file_size; i++) {
+        fputc((int)(i % 256), file);
+    }
+    fclose(file);
+    
+    server_context_t server_ctx = {
+        .port = 32004,
+        .password = "peer_messages_test",
+        .running = 0
+    };
+    
+    pthread_t server_thread;
+    pthread_create(&server_thread, NULL, talkative_server, &server_ctx);
+    
+    while (!server_ctx.running) {
+        usleep(100000);
+    }
+    
+    connection_t *client = connect_to_host("127.0.0.1", server_ctx.port, server_ctx.password);
+    if (!client || perform_handshake(client, 0, server_ctx.password) != PROTOCOL_SUCCESS) {
+        printf("Client: Failed to connect\n");
+        server_ctx.running = 0;
+        pthread_join(server_thread, NULL);
+        remove(filename);
+        return -1;
+    }
+    
+    file_transfer_t *transfer = start_file_send(client, filename);
+    if (!transfer) {
+        printf("Client: Failed to start file transfer\n");
+        close_connection(client);
+        server_ctx.running = 0;
+        pthread_join(server_thread, NULL);
+        remove(filename);
+        return -1;
+    }
+    
+    /* The receiver never grants credit past the initial window */
+    do {
+        status = process_file_transfer(transfer);
+    } while (status == FILE_TRANSFER_IN_PROGRESS);
+    
+    buffer_len = sizeof(buffer);
+    if (file_transfer_next_message(transfer, &msg_type, buffer, &buffer_len)
+            == FILE_TRANSFER_SUCCESS &&
+        msg_type == MSG_DATA && buffer_len == 7 && memcmp(buffer, "status?", 7) == 0) {
+        queued = 1;
+    }
+    
+    cleanup_file_transfer(transfer);
+    close_connection(client);
+    free(client);
+    server_ctx.running = 0;
+    pthread_join(server_thread, NULL);
+    remove(filename);
+    
+    if (status != FILE_TRANSFER_CANCELLED || !queued) {
+        printf("Send ended with %d, data message %s\n", status,
+               queued ? "queued" : "lost");
+        return -1;
+    }
+    
+    return 0;
+}
+
+/* Test an integrity-only transfer arrives byte for byte */
+int test_integrity_only_transfer(void) {
+    printf("\n=== Integrity-Only File Transfer Test ===\n");
+    
+    const char *filename = "test_integrity_file.bin";
+    size_t file_size = create_integrity_file(filename);
+    size_t mismatches = 0, i = 0;
+    int result, c;
+    
+    if (file_size == 0) {
+        return -1;
+    }
+    
+    result = run_integrity_transfer(filename, 32005, TAMPER_NONE);
+    
+    /* The received file now carries the name */
+    FILE *file = fopen(filename, "rb");
+    if (file) {
+        while ((c = fgetc(file)) != EOF) {
+            if (i >= file_size || c != (int)((i * 7) % 253)) {
+                mismatches++;
+            }
+            i++;
+        }
+        fclose(file);
+    }
+    remove(filename);
+    
+    if (result != FILE_TRANSFER_SUCCESS || !file || i != file_size || mismatches != 0) {
+        printf("Integrity-only transfer failed: receiver %d, %zu of %zu bytes, "
+               "%zu mismatched\n", result, i, file_size, mismatches);
+        return -1;
+    }
+    
+    return 0;
+}
+
+/* Test tampered data or tag fails verification and is never renamed in */
+int test_integrity_only_tampered(void) {
+    printf("\n=== Integrity-Only Tampering Test ===\n");
+    
+    static const int tampers[] = { TAMPER_DATA, TAMPER_TAG };
+    const char *filename = "test_integrity_tampered.bin";
+    int failures = 0;
+    
+    for (int t = 0; t < 2; t++) {
+        char part[512];
+        int result, renamed;
+        
+        if (create_integrity_file(filename) == 0) {
+            return -1;
+        }
+        
+        result = run_integrity_transfer(filename, 32006 + t, tampers[t]);
+        renamed = access(filename, F_OK) == 0;
+        
+        snprintf(part, sizeof(part), "%s.part", filename);
+        remove(part);
+        remove(filename);
+        
+        if (result != FILE_TRANSFER_ERROR_VERIFY || renamed) {
+            printf("Tampered %s: receiver %d, file %s\n",
+                   tampers[t] == TAMPER_DATA ? "data" : "tag", result,
+                   renamed ? "renamed into place" : "not renamed");
+            failures++;
+        }
+    }
+    
+    return failures ? -1 : 0;
+}
+
 /* Main integration test */
 int main(void) {
     printf("========================================\n");
@@ -409,7 +972,7 @@ int main(void) {
     file_transfer_init();
     
     int passed = 0;
-    int total = 3;
+    int total = 7;
     
     /* Run tests */
     if (test_basic_file_transfer() == 0) {
@@ -433,6 +996,34 @@ int main(void) {
         printf("\n❌ Encrypted file transfer test FAILED\n");
     }
     
+    if (test_striped_file_transfer() == 0) {
+        printf("\n✅ Striped file transfer test PASSED\n");
+        passed++;
+    } else {
+        printf("\n❌ Striped file transfer test FAILED\n");
+    }
+    
+    if (test_send_with_peer_messages() == 0) {
+        printf("\n✅ Send with peer messages test PASSED\n");
+        passed++;
+    } else {
+        printf("\n❌ Send with peer messages test FAILED\n");
+    }
+    
+    if (test_integrity_only_transfer() == 0) {
+        printf("\n✅ Integrity-only transfer test PASSED\n");
+        passed++;
+    } else {
+        printf("\n❌ Integrity-only transfer test FAILED\n");
+    }
+    
+    if (test_integrity_only_tampered() == 0) {
+        printf("\n✅ Integrity-only tampering test PASSED\n");
+        passed++;
+    } else {
+        printf("\n❌ Integrity-only tampering test FAILED\n");
+    }
+    
     /* Print summary */
     printf("\n========================================\n");
     printf("INTEGRATION TEST SUMMARY:\n");
@@ -0,0 +1,195 @@
+/*
+ * Cryptcat Bulk Transfer Benchmarks
+ * Compares sealed file transfers with integrity-only ones (sendfile() on
+ * the sender, splice() into the file on the receiver, HMAC tag tree
+ * computed in parallel) over loopback.
+ */
+
+#define _GNU_SOURCE  /* usleep, clock_gettime */
+
+#include "test_harness.h"
+#include "../../src/include/crypto.h"
+#include "../../src/include/network.h"
+#include "../../src/include/protocol.h"
+#include "../../src/include/file_transfer.h"
+#include <pthread.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+
+#define BENCH_PASSWORD "bench_bulk_pwd"
+#define BENCH_PORT 36400
+#define BENCH_FILE "bench_bulk_src.bin"
+#define BENCH_FILE_SIZE (256 * 1024 * 1024)
+
+/* ===== Benchmark Utilities ===== */
+
+static uint64_t get_time_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000ULL;
+}
+
+/* Receiver configuration */
+typedef struct {
+    int port;
+    volatile int ready;
+    int result;
+} receiver_config_t;
+
+/* Receive one file in whichever mode the sender picked */
+static void* receiver_thread(void *arg) {
+    receiver_config_t *cfg = (receiver_config_t*)arg;
+    static unsigned char buffer[65536 + 4];
+    file_transfer_t *transfer = NULL;
+    message_type_t msg_type;
+    size_t buffer_len;
+    int status;
+
+    cfg->result = -1;
+    connection_t *listener = create_listener(cfg->port, BENCH_PASSWORD);
+    if (!listener) {
+        cfg->ready = -1;
+        return NULL;
+    }
+
+    cfg->ready = 1;
+    connection_t *conn = accept_connection(listener);
+    if (!conn || perform_handshake(conn, 1, BENCH_PASSWORD) != PROTOCOL_SUCCESS) {
+        goto done;
+    }
+
+    while (cfg->result != 0) {
+        if (wait_for_socket(get_connection_socket(conn), 1000, 1, 0) != 1) {
+            continue;
+        }
+
+        buffer_len = sizeof(buffer);
+        if (receive_message(conn, &msg_type, buffer, &buffer_len) != PROTOCOL_SUCCESS) {
+            break;
+        }
+
+        if (msg_type == MSG_FILE_START) {
+            transfer = start_file_receive(conn, buffer, buffer_len);
+            if (!transfer) break;
+            continue;
+        }
+
+        if (!transfer) {
+            continue;
+        }
+
+        if (msg_type == MSG_FILE_CHUNK && buffer_len > 4) {
+            uint32_t chunk_be;
+            memcpy(&chunk_be, buffer, sizeof(chunk_be));
+            status = receive_file_chunk(transfer, buffer + 4, buffer_len - 4,
+                                        ntohl(chunk_be));
+        } else if (msg_type == MSG_FILE_BULK) {
+            status = receive_file_bulk(transfer, buffer, buffer_len);
+        } else if (msg_type == MSG_FILE_END) {
+            status = receive_file_end(transfer, buffer, buffer_len);
+        } else {
+            continue;
+        }
+
+        if (status == FILE_TRANSFER_SUCCESS && msg_type == MSG_FILE_END) {
+            cfg->result = 0;
+        } else if (status != FILE_TRANSFER_SUCCESS && status != FILE_TRANSFER_IN_PROGRESS) {
+            break;
+        }
+    }
+
+done:
+    if (transfer) cleanup_file_transfer(transfer);
+    if (conn) close_connection(conn);
+    close_connection(listener);
+    return NULL;
+}
+
+/* Create the source file once */
+static int create_bench_file(void) {
+    FILE *file = fopen(BENCH_FILE, "wb");
+    unsigned char block[65536];
+    uint32_t seed = 2463534242u;
+
+    if (!file) return -1;
+
+    for (size_t written = 0; written < BENCH_FILE_SIZE; written += sizeof(block)) {
+        for (size_t i = 0; i < sizeof(block); i++) {
+            seed ^= seed << 13;
+            seed ^= seed >> 17;
+            seed ^= seed << 5;
+            block[i] = (unsigned char)seed;
+        }
+        fwrite(block, 1, sizeof(block), file);
+    }
+
+    fclose(file);
+    return 0;
+}
+
+/* Send the bench file in the given mode; returns MB/s */
+static double run_transfer(file_transfer_mode_t mode, int port) {
+    receiver_config_t receiver = { .port = port, .ready = 0, .result = -1 };
+    pthread_t receiver_tid;
+    double throughput = -1.0;
+
+    pthread_create(&receiver_tid, NULL, receiver_thread, &receiver);
+    while (!receiver.ready) usleep(1000);
+
+    connection_t *conn = connect_to_host("127.0.0.1", port, BENCH_PASSWORD);
+    if (conn && perform_handshake(conn, 0, BENCH_PASSWORD) == PROTOCOL_SUCCESS) {
+        uint64_t start_us = get_time_us();
+        file_transfer_t *transfer = start_file_send_mode(conn, BENCH_FILE, mode);
+        int status = FILE_TRANSFER_IN_PROGRESS;
+
+        while (transfer && status == FILE_TRANSFER_IN_PROGRESS) {
+            status = process_file_transfer(transfer);
+        }
+
+        if (status == FILE_TRANSFER_SUCCESS) {
+            double elapsed_s = (double)(get_time_us() - start_us) / 1e6;
+            throughput = (BENCH_FILE_SIZE / (1024.0 * 1024.0)) / elapsed_s;
+        }
+
+        if (transfer) cleanup_file_transfer(transfer);
+    }
+
+    if (conn) close_connection(conn);
+    pthread_join(receiver_tid, NULL);
+
+    return receiver.result == 0 ? throughput : -1.0;
+}
+
+/* ===== Benchmark Tests ===== */
+
+/* Benchmark: sealed vs integrity-only file transfer */
+TEST_CASE(bench_bulk_integrity_only) {
+    double sealed, integrity;
+
+    crypto_global_init();
+    network_init();
+    file_transfer_init();
+    TEST_ASSERT_EQUAL(0, create_bench_file());
+
+    sealed = run_transfer(FILE_TRANSFER_SEALED, BENCH_PORT);
+    integrity = run_transfer(FILE_TRANSFER_INTEGRITY_ONLY, BENCH_PORT + 1);
+    remove(BENCH_FILE);
+
+    TEST_ASSERT(sealed > 0);
+    TEST_ASSERT(integrity > 0);
+
+    test_log("sealed:         %8.2f MB/s", sealed);
+    test_log("integrity only: %8.2f MB/s (%.1fx)", integrity, integrity / sealed);
+    return TEST_PASS;
+}
+
+/* ===== Suite Registration ===== */
+
+__attribute__((constructor)) static void register_bulk_benchmarks(void) {
+    test_suite_t *suite = test_suite_create("bulk_benchmarks");
+    if (!suite) return;
+
+    test_suite_add_test(suite, "bench_bulk_integrity_only", bench_bulk_integrity_only);
+
+    test_register_suite(suite);
+}
@@ -0,0 +1,141 @@
+/*
+ * Cryptcat Clock Benchmarks
+ * Cost of the timestamp sources read on every record: time(), the
+ * vDSO and syscall paths of clock_gettime(), and the cached coarse clock.
+ */
+
+#define _GNU_SOURCE  /* syscall */
+
+#include "test_harness.h"
+#include "../../src/include/platform.h"
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+#define BENCH_READS 10000000
+#define BENCH_SYSCALL_READS 1000000
+#define TIMESTAMPS_PER_RECORD 4     /* Seal, open, connection stats, header */
+#define STALENESS_SLACK_MS 100      /* Ticker may be descheduled under load */
+
+/* Timestamp source under test */
+typedef enum {
+    SOURCE_TIME,                    /* time(NULL) */
+    SOURCE_MONOTONIC,               /* clock_gettime(), vDSO */
+    SOURCE_MONOTONIC_SYSCALL,       /* clock_gettime(), forced syscall */
+    SOURCE_COARSE_TIME,             /* platform_coarse_time() */
+    SOURCE_COARSE_MONOTONIC         /* platform_coarse_monotonic_ms() */
+} clock_source_t;
+
+/* ===== Benchmark Utilities ===== */
+
+static uint64_t get_time_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+/* Average nanoseconds per read of one source */
+static double time_reads(clock_source_t source, int reads) {
+    volatile uint64_t sink = 0;
+    struct timespec ts;
+    uint64_t start_ns = get_time_ns();
+
+    for (int i = 0; i < reads; i++) {
+        switch (source) {
+            case SOURCE_TIME:
+                sink += (uint64_t)time(NULL);
+                break;
+            case SOURCE_MONOTONIC:
+                clock_gettime(CLOCK_MONOTONIC, &ts);
+                sink += (uint64_t)ts.tv_nsec;
+                break;
+            case SOURCE_MONOTONIC_SYSCALL:
+                syscall(SYS_clock_gettime, CLOCK_MONOTONIC, &ts);
+                sink += (uint64_t)ts.tv_nsec;
+                break;
+            case SOURCE_COARSE_TIME:
+                sink += (uint64_t)platform_coarse_time();
+                break;
+            case SOURCE_COARSE_MONOTONIC:
+                sink += platform_coarse_monotonic_ms();
+                break;
+        }
+    }
+
+    (void)sink;
+    return (double)(get_time_ns() - start_ns) / reads;
+}
+
+/* ===== Benchmark Tests ===== */
+
+/* Benchmark: Per-read cost of each timestamp source */
+TEST_CASE(bench_timestamp_sources) {
+    double time_ns, mono_ns, syscall_ns, coarse_time_ns, coarse_mono_ns;
+
+    /* First use starts the ticker; keep it out of the measurement */
+    platform_coarse_monotonic_ms();
+
+    time_ns = time_reads(SOURCE_TIME, BENCH_READS);
+    mono_ns = time_reads(SOURCE_MONOTONIC, BENCH_READS);
+    syscall_ns = time_reads(SOURCE_MONOTONIC_SYSCALL, BENCH_SYSCALL_READS);
+    coarse_time_ns = time_reads(SOURCE_COARSE_TIME, BENCH_READS);
+    coarse_mono_ns = time_reads(SOURCE_COARSE_MONOTONIC, BENCH_READS);
+
+    test_log("time(NULL):                     %6.1f ns/read", time_ns);
+    test_log("clock_gettime (vDSO):           %6.1f ns/read", mono_ns);
+    test_log("clock_gettime (syscall):        %6.1f ns/read", syscall_ns);
+    test_log("platform_coarse_time:           %6.1f ns/read", coarse_time_ns);
+    test_log("platform_coarse_monotonic_ms:   %6.1f ns/read", coarse_mono_ns);
+
+    /* What the hot path saves per record. glibc's time() already reads a
+     * coarse vDSO value, so the win there is small; it is large against
+     * precise clock_gettime() and on hosts whose clocksource forces a
+     * syscall (some VMs) */
+    test_log("Per record (%d timestamps): %.1f ns saved vs time(), %.1f ns vs "
+             "clock_gettime, %.1f ns vs syscall",
+             TIMESTAMPS_PER_RECORD,
+             TIMESTAMPS_PER_RECORD * (time_ns - coarse_time_ns),
+             TIMESTAMPS_PER_RECORD * (mono_ns - coarse_mono_ns),
+             TIMESTAMPS_PER_RECORD * (syscall_ns - coarse_time_ns));
+
+    TEST_ASSERT(coarse_time_ns < syscall_ns);
+    return TEST_PASS;
+}
+
+/* Benchmark: The cache keeps up with the precise clock */
+TEST_CASE(bench_coarse_clock_staleness) {
+    uint64_t worst_ms = 0;
+
+    for (int i = 0; i < 50; i++) {
+        struct timespec ts;
+        uint64_t precise_ms, coarse_ms;
+
+        coarse_ms = platform_coarse_monotonic_ms();
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        precise_ms = (uint64_t)ts.tv_sec * 1000ULL + (uint64_t)ts.tv_nsec / 1000000ULL;
+
+        if (precise_ms > coarse_ms && precise_ms - coarse_ms > worst_ms) {
+            worst_ms = precise_ms - coarse_ms;
+        }
+        platform_sleep_ms(3);
+    }
+
+    test_log("Coarse clock worst lag: %llu ms (tick %d ms)",
+             (unsigned long long)worst_ms, PLATFORM_COARSE_CLOCK_TICK_MS);
+
+    TEST_ASSERT(worst_ms <= PLATFORM_COARSE_CLOCK_TICK_MS + STALENESS_SLACK_MS);
+    return TEST_PASS;
+}
+
+/* ===== Suite Registration ===== */
+
+__attribute__((constructor)) static void register_clock_benchmarks(void) {
+    test_suite_t *suite = test_suite_create("clock_benchmarks");
+    if (!suite) return;
+
+    test_suite_add_test(suite, "bench_timestamp_sources", bench_timestamp_sources);
+    test_suite_add_test(suite, "bench_coarse_clock_staleness", bench_coarse_clock_staleness);
+
+    test_register_suite(suite);
+}
@@ -0,0 +1,275 @@
+/*
+ * Cryptcat Event Loop Benchmarks
+ * Opens N loopback clients against one event loop thread, then measures
+ * echo throughput and round-trip latency with every session live.
+ * Set CRYPTCAT_BENCH_CONNECTIONS=10000 for the 10k-session target; the
+ * default keeps PBKDF2-bound setup short. Per-connection cache behaviour
+ * shows under
+ *   perf stat -e cache-misses,L1-dcache-load-misses ./benchmark_event_loop
+ */
+
+#define _GNU_SOURCE  /* usleep */
+
+#include "test_harness.h"
+#include "../../src/include/crypto.h"
+#include "../../src/include/network.h"
+#include "../../src/include/protocol.h"
+#include "../../src/include/event_loop.h"
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/resource.h>
+
+#define BENCH_PASSWORD "bench_loop_pwd"
+#define BENCH_PORT 36000
+#define BENCH_DEFAULT_CONNECTIONS 1000
+#define BENCH_HANDSHAKE_WINDOW 64   /* Client handshakes in flight */
+#define BENCH_ROUNDS 10             /* Echo round trips per session */
+#define BENCH_PAYLOAD_SIZE 64
+#define BENCH_SETUP_TIMEOUT_US (300ULL * 1000000ULL)
+
+/* ===== Benchmark Utilities ===== */
+
+static uint64_t get_time_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000ULL;
+}
+
+/* Per-session client state (freed with the connection as user data) */
+typedef struct {
+    int index;
+    int rounds_done;
+    uint64_t sent_us;
+} client_state_t;
+
+/* Client side of the benchmark */
+typedef struct {
+    connection_t **sessions;        /* Established sessions by index */
+    int established;
+    int completed;                  /* Sessions that finished every round */
+    int failed;
+    uint64_t rtt_total_us;
+    uint64_t rtt_max_us;
+    uint64_t round_trips;
+    unsigned char payload[BENCH_PAYLOAD_SIZE];
+} bench_clients_t;
+
+/* Server: echo every data message */
+static void server_on_message(event_loop_t *loop, connection_t *conn, message_type_t type,
+                              const unsigned char *payload, size_t payload_len, void *ctx) {
+    (void)ctx;
+
+    if (type == MSG_DATA &&
+        send_message(conn, MSG_DATA, payload, payload_len) != PROTOCOL_SUCCESS) {
+        event_loop_close_connection(loop, conn);
+    }
+}
+
+/* Client: remember the session; pings start once all are up */
+static void client_on_connect(event_loop_t *loop, connection_t *conn, void *ctx) {
+    bench_clients_t *clients = (bench_clients_t*)ctx;
+    client_state_t *state = (client_state_t*)get_connection_user_data(conn);
+
+    (void)loop;
+    clients->sessions[state->index] = conn;
+    clients->established++;
+}
+
+/* Client: time the round trip and send the next ping */
+static void client_on_message(event_loop_t *loop, connection_t *conn, message_type_t type,
+                              const unsigned char *payload, size_t payload_len, void *ctx) {
+    bench_clients_t *clients = (bench_clients_t*)ctx;
+    client_state_t *state = (client_state_t*)get_connection_user_data(conn);
+    uint64_t now = get_time_us();
+    uint64_t rtt = now - state->sent_us;
+
+    (void)loop;
+    (void)payload;
+
+    if (type != MSG_DATA || payload_len != BENCH_PAYLOAD_SIZE) {
+        return;
+    }
+
+    clients->rtt_total_us += rtt;
+    clients->round_trips++;
+    if (rtt > clients->rtt_max_us) clients->rtt_max_us = rtt;
+
+    if (++state->rounds_done == BENCH_ROUNDS) {
+        clients->completed++;
+        return;
+    }
+
+    state->sent_us = now;
+    if (send_message(conn, MSG_DATA, clients->payload, BENCH_PAYLOAD_SIZE) != PROTOCOL_SUCCESS) {
+        clients->failed++;
+    }
+}
+
+/* Client: a session that drops out counts as failed */
+static void client_on_close(event_loop_t *loop, connection_t *conn, int reason, void *ctx) {
+    bench_clients_t *clients = (bench_clients_t*)ctx;
+    client_state_t *state = (client_state_t*)get_connection_user_data(conn);
+
+    (void)loop;
+    (void)reason;
+
+    clients->sessions[state->index] = NULL;
+    if (state->rounds_done < BENCH_ROUNDS) {
+        clients->failed++;
+    }
+}
+
+/* Server loop thread */
+static void* server_thread(void *arg) {
+    event_loop_run((event_loop_t*)arg);
+    return NULL;
+}
+
+/* Number of sessions to open (CRYPTCAT_BENCH_CONNECTIONS overrides) */
+static int bench_connection_count(void) {
+    const char *env = getenv("CRYPTCAT_BENCH_CONNECTIONS");
+    int count = env ? atoi(env) : 0;
+
+    return count > 0 ? count : BENCH_DEFAULT_CONNECTIONS;
+}
+
+/* Both ends of every session live in this process */
+static void raise_descriptor_limit(int connections) {
+    struct rlimit limit;
+    rlim_t wanted = (rlim_t)connections * 3 + 64;
+
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < wanted) {
+        limit.rlim_cur = wanted < limit.rlim_max ? wanted : limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+}
+
+/* ===== Benchmark Tests ===== */
+
+/* Benchmark: N concurrent encrypted sessions on one server thread */
+TEST_CASE(bench_event_loop_sessions) {
+    const int connections = bench_connection_count();
+    event_loop_callbacks_t server_callbacks = { .on_message = server_on_message };
+    bench_clients_t clients;
+    event_loop_callbacks_t client_callbacks = {
+        .on_connect = client_on_connect,
+        .on_message = client_on_message,
+        .on_close = client_on_close,
+        .ctx = &clients
+    };
+    event_loop_t *server_loop, *client_loop;
+    event_loop_stats_t server_stats;
+    pthread_t server_tid;
+    uint64_t start_us, setup_us, echo_us;
+
+    crypto_global_init();
+    network_init();
+    raise_descriptor_limit(connections);
+
+    memset(&clients, 0, sizeof(clients));
+    memset(clients.payload, 'x', sizeof(clients.payload));
+    clients.sessions = calloc((size_t)connections, sizeof(connection_t*));
+    TEST_ASSERT_NOT_NULL(clients.sessions);
+
+    server_loop = event_loop_create(BENCH_PASSWORD, &server_callbacks, connections);
+    client_loop = event_loop_create(BENCH_PASSWORD, &client_callbacks, connections);
+    TEST_ASSERT_NOT_NULL(server_loop);
+    TEST_ASSERT_NOT_NULL(client_loop);
+
+    connection_t *listener = create_listener(BENCH_PORT, BENCH_PASSWORD);
+    TEST_ASSERT_NOT_NULL(listener);
+    TEST_ASSERT_EQUAL(EVENT_LOOP_SUCCESS, event_loop_add_listener(server_loop, listener));
+    pthread_create(&server_tid, NULL, server_thread, server_loop);
+
+    /* Phase 1: open every session, bounding handshakes in flight */
+    start_us = get_time_us();
+    for (int i = 0; i < connections; i++) {
+        while (event_loop_get_stats(client_loop).handshaking >= BENCH_HANDSHAKE_WINDOW) {
+            event_loop_run_once(client_loop, 1);
+        }
+
+        connection_t *conn = connect_to_host("127.0.0.1", BENCH_PORT, BENCH_PASSWORD);
+        client_state_t *state = calloc(1, sizeof(client_state_t));
+        if (!conn || !state) {
+            free(state);
+            if (conn) {
+                close_connection(conn);
+                free(conn);
+            }
+            clients.failed++;
+            continue;
+        }
+
+        state->index = i;
+        set_connection_user_data(conn, state);
+        if (event_loop_add_connection(client_loop, conn, 0) != EVENT_LOOP_SUCCESS) {
+            close_connection(conn);
+            free(conn);
+            clients.failed++;
+        }
+        event_loop_run_once(client_loop, 0);
+    }
+
+    while (event_loop_get_stats(client_loop).handshaking > 0 &&
+           get_time_us() - start_us < BENCH_SETUP_TIMEOUT_US) {
+        event_loop_run_once(client_loop, 10);
+    }
+    setup_us = get_time_us() - start_us;
+
+    /* Phase 2: every session pings at once */
+    start_us = get_time_us();
+    for (int i = 0; i < connections; i++) {
+        connection_t *conn = clients.sessions[i];
+        if (!conn) continue;
+
+        client_state_t *state = (client_state_t*)get_connection_user_data(conn);
+        state->sent_us = get_time_us();
+        if (send_message(conn, MSG_DATA, clients.payload, BENCH_PAYLOAD_SIZE) != PROTOCOL_SUCCESS) {
+            clients.failed++;
+        }
+    }
+
+    while (clients.completed + clients.failed < clients.established) {
+        if (event_loop_run_once(client_loop, 1000) == 0) break;
+    }
+    echo_us = get_time_us() - start_us;
+
+    event_loop_stop(server_loop);
+    pthread_join(server_tid, NULL);
+    server_stats = event_loop_get_stats(server_loop);
+
+    test_log("%d sessions: setup %.2f s (%.0f handshakes/s), server peak %u, "
+             "%llu handshakes failed",
+             clients.established, setup_us / 1e6,
+             clients.established / (setup_us / 1e6), server_stats.peak_connections,
+             (unsigned long long)server_stats.handshakes_failed);
+    test_log("Echo: %llu round trips in %.2f s (%.0f msgs/s), RTT mean %.1f us, max %llu us",
+             (unsigned long long)clients.round_trips, echo_us / 1e6,
+             2.0 * clients.round_trips / (echo_us / 1e6),
+             clients.round_trips ? (double)clients.rtt_total_us / clients.round_trips : 0.0,
+             (unsigned long long)clients.rtt_max_us);
+    test_log("Server loop: %llu wakeups, %llu events, %.1f events/wakeup",
+             (unsigned long long)server_stats.wakeups,
+             (unsigned long long)server_stats.events,
+             server_stats.wakeups ? (double)server_stats.events / server_stats.wakeups : 0.0);
+
+    event_loop_destroy(client_loop);
+    event_loop_destroy(server_loop);
+    free(clients.sessions);
+
+    TEST_ASSERT_EQUAL(connections, clients.established);
+    TEST_ASSERT_EQUAL(connections, clients.completed);
+    TEST_ASSERT_EQUAL((uint32_t)connections, server_stats.peak_connections);
+    return TEST_PASS;
+}
+
+/* ===== Suite Registration ===== */
+
+__attribute__((constructor)) static void register_event_loop_benchmarks(void) {
+    test_suite_t *suite = test_suite_create("event_loop_benchmarks");
+    if (!suite) return;
+
+    test_suite_add_test(suite, "bench_event_loop_sessions", bench_event_loop_sessions);
+
+    test_register_suite(suite);
+}
@@ -0,0 +1,340 @@
+/*
+ * Cryptcat Flow Control Benchmarks
+ * Measures file transfer throughput versus round-trip time through a
+ * local netem-style delay shim (loopback proxy that holds every segment
+ * for RTT/2 in each direction).
+ */
+
+#define _GNU_SOURCE  /* usleep, clock_gettime */
+
+#include "test_harness.h"
+#include "../../src/include/crypto.h"
+#include "../../src/include/network.h"
+#include "../../src/include/protocol.h"
+#include "../../src/include/file_transfer.h"
+#include <pthread.h>
+#include <poll.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#define BENCH_PASSWORD "bench_flow_pwd"
+#define BENCH_FILE "bench_flow_src.bin"
+#define BENCH_FILE_SIZE (8 * 1024 * 1024)
+#define SHIM_BUFFER_SIZE 65536
+
+/* ===== Benchmark Utilities ===== */
+
+static uint64_t get_time_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000ULL;
+}
+
+/* Segment held by the delay shim until its release time */
+typedef struct shim_segment_s {
+    uint64_t release_us;
+    size_t len;
+    struct shim_segment_s *next;
+    unsigned char data[];
+} shim_segment_t;
+
+/* One direction of the delay shim */
+typedef struct {
+    int src_fd;
+    int dst_fd;
+    uint64_t delay_us;
+} shim_pipe_t;
+
+/* Delay shim configuration */
+typedef struct {
+    int listen_port;
+    int target_port;
+    uint64_t one_way_delay_us;
+    volatile int ready;
+} shim_config_t;
+
+/* Receiver configuration */
+typedef struct {
+    int port;
+    volatile int ready;
+    int result;
+} receiver_config_t;
+
+/* Forward bytes from src to dst, delaying each segment by delay_us */
+static void* shim_forward(void *arg) {
+    shim_pipe_t *pipe_cfg = (shim_pipe_t*)arg;
+    shim_segment_t *head = NULL, *tail = NULL;
+    unsigned char buffer[SHIM_BUFFER_SIZE];
+    int src_open = 1;
+
+    while (src_open || head) {
+        uint64_t now = get_time_us();
+        int timeout_ms = -1;
+
+        /* Release every segment whose delay has elapsed */
+        while (head && head->release_us <= now) {
+            shim_segment_t *seg = head;
+            size_t off = 0;
+
+            while (off < seg->len) {
+                ssize_t n = send(pipe_cfg->dst_fd, seg->data + off, seg->len - off,
+                                 MSG_NOSIGNAL);
+                if (n <= 0) {
+                    src_open = 0;
+                    break;
+                }
+                off += n;
+            }
+
+            head = seg->next;
+            if (!head) tail = NULL;
+            free(seg);
+        }
+
+        if (head) {
+            timeout_ms = (int)((head->release_us - now + 999) / 1000);
+        }
+
+        if (!src_open) {
+            if (!head) break;
+            usleep((useconds_t)(head->release_us - now));
+            continue;
+        }
+
+        struct pollfd pfd = { .fd = pipe_cfg->src_fd, .events = POLLIN };
+        if (poll(&pfd, 1, timeout_ms) <= 0) {
+            continue;
+        }
+
+        ssize_t n = recv(pipe_cfg->src_fd, buffer, sizeof(buffer), 0);
+        if (n <= 0) {
+            src_open = 0;
+            continue;
+        }
+
+        shim_segment_t *seg = malloc(sizeof(*seg) + n);
+        if (!seg) break;
+
+        seg->release_us = get_time_us() + pipe_cfg->delay_us;
+        seg->len = n;
+        seg->next = NULL;
+        memcpy(seg->data, buffer, n);
+
+        if (tail) tail->next = seg; else head = seg;
+        tail = seg;
+    }
+
+    while (head) {
+        shim_segment_t *next = head->next;
+        free(head);
+        head = next;
+    }
+
+    shutdown(pipe_cfg->dst_fd, SHUT_WR);
+    return NULL;
+}
+
+/* Accept one client and proxy it to the target with the configured delay */
+static void* shim_thread(void *arg) {
+    shim_config_t *cfg = (shim_config_t*)arg;
+    struct sockaddr_in addr;
+    int listen_fd, client_fd, target_fd, opt = 1;
+
+    listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+    setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(cfg->listen_port);
+
+    if (bind(listen_fd, (struct sockaddr*)&addr, sizeof(addr)) < 0 ||
+        listen(listen_fd, 1) < 0) {
+        close(listen_fd);
+        cfg->ready = -1;
+        return NULL;
+    }
+
+    cfg->ready = 1;
+    client_fd = accept(listen_fd, NULL, NULL);
+    close(listen_fd);
+    if (client_fd < 0) return NULL;
+
+    target_fd = socket(AF_INET, SOCK_STREAM, 0);
+    addr.sin_port = htons(cfg->target_port);
+    if (connect(target_fd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+        close(client_fd);
+        close(target_fd);
+        return NULL;
+    }
+
+    shim_pipe_t upstream = { client_fd, target_fd, cfg->one_way_delay_us };
+    shim_pipe_t downstream = { target_fd, client_fd, cfg->one_way_delay_us };
+    pthread_t up_thread, down_thread;
+
+    pthread_create(&up_thread, NULL, shim_forward, &upstream);
+    pthread_create(&down_thread, NULL, shim_forward, &downstream);
+    pthread_join(up_thread, NULL);
+    pthread_join(down_thread, NULL);
+
+    close(client_fd);
+    close(target_fd);
+    return NULL;
+}
+
+/* Receive one file, advertising credit through the file transfer module */
+static void* receiver_thread(void *arg) {
+    receiver_config_t *cfg = (receiver_config_t*)arg;
+    static unsigned char buffer[65536 + 4];
+    file_transfer_t *transfer = NULL;
+    message_type_t msg_type;
+    size_t buffer_len;
+
+    cfg->result = -1;
+    connection_t *listener = create_listener(cfg->port, BENCH_PASSWORD);
+    if (!listener) {
+        cfg->ready = -1;
+        return NULL;
+    }
+
+    cfg->ready = 1;
+    connection_t *conn = accept_connection(listener);
+    if (!conn || perform_handshake(conn, 1, BENCH_PASSWORD) != PROTOCOL_SUCCESS) {
+        goto done;
+    }
+
+    while (1) {
+        if (wait_for_socket(get_connection_socket(conn), 1000, 1, 0) != 1) {
+            continue;
+        }
+
+        buffer_len = sizeof(buffer);
+        if (receive_message(conn, &msg_type, buffer, &buffer_len) != PROTOCOL_SUCCESS) {
+            break;
+        }
+
+        if (msg_type == MSG_FILE_START) {
+            transfer = start_file_receive(conn, buffer, buffer_len);
+            if (!transfer) break;
+        } else if (msg_type == MSG_FILE_CHUNK && transfer && buffer_len > 4) {
+            uint32_t chunk_be;
+            memcpy(&chunk_be, buffer, sizeof(chunk_be));
+            int status = receive_file_chunk(transfer, buffer + 4, buffer_len - 4,
+                                            ntohl(chunk_be));
+            if (status == FILE_TRANSFER_SUCCESS) {
+                cfg->result = 0;
+            } else if (status != FILE_TRANSFER_IN_PROGRESS) {
+                break;
+            }
+        } else if (msg_type == MSG_FILE_END) {
+            break;
+        }
+    }
+
+done:
+    if (transfer) cleanup_file_transfer(transfer);
+    if (conn) close_connection(conn);
+    close_connection(listener);
+    return NULL;
+}
+
+/* Create the source file once */
+static int create_bench_file(void) {
+    FILE *file = fopen(BENCH_FILE, "wb");
+    unsigned char block[65536];
+
+    if (!file) return -1;
+
+    for (size_t i = 0; i < sizeof(block); i++) {
+        block[i] = (unsigned char)(i * 31 + 7);
+    }
+
+    for (size_t written = 0; written < BENCH_FILE_SIZE; written += sizeof(block)) {
+        fwrite(block, 1, sizeof(block), file);
+    }
+
+    fclose(file);
+    return 0;
+}
+
+/* Send the bench file through a shim with the given RTT; returns MB/s */
+static double run_transfer_at_rtt(int rtt_ms, int base_port,
+                                  file_transfer_info_t *final_info) {
+    receiver_config_t receiver = { .port = base_port, .ready = 0, .result = -1 };
+    shim_config_t shim = {
+        .listen_port = base_port + 1,
+        .target_port = base_port,
+        .one_way_delay_us = (uint64_t)rtt_ms * 1000 / 2,
+        .ready = 0
+    };
+    pthread_t receiver_tid, shim_tid;
+    double throughput = -1.0;
+
+    pthread_create(&receiver_tid, NULL, receiver_thread, &receiver);
+    pthread_create(&shim_tid, NULL, shim_thread, &shim);
+    while (!receiver.ready || !shim.ready) usleep(1000);
+
+    connection_t *conn = connect_to_host("127.0.0.1", shim.listen_port, BENCH_PASSWORD);
+    if (conn && perform_handshake(conn, 0, BENCH_PASSWORD) == PROTOCOL_SUCCESS) {
+        uint64_t start_us = get_time_us();
+        file_transfer_t *transfer = start_file_send(conn, BENCH_FILE);
+        int status = FILE_TRANSFER_IN_PROGRESS;
+
+        while (transfer && status == FILE_TRANSFER_IN_PROGRESS) {
+            status = process_file_transfer(transfer);
+            *final_info = get_file_transfer_info(transfer);
+        }
+
+        if (status == FILE_TRANSFER_SUCCESS) {
+            double elapsed_s = (double)(get_time_us() - start_us) / 1e6;
+            throughput = (BENCH_FILE_SIZE / (1024.0 * 1024.0)) / elapsed_s;
+        }
+
+        if (transfer) cleanup_file_transfer(transfer);
+    }
+
+    if (conn) close_connection(conn);
+    pthread_join(receiver_tid, NULL);
+    pthread_join(shim_tid, NULL);
+
+    return receiver.result == 0 ? throughput : -1.0;
+}
+
+/* ===== Benchmark Tests ===== */
+
+/* Benchmark: Throughput versus RTT with receiver-advertised credit */
+TEST_CASE(bench_flow_throughput_vs_rtt) {
+    static const int rtts_ms[] = { 0, 10, 50, 100 };
+
+    crypto_global_init();
+    network_init();
+    file_transfer_init();
+    TEST_ASSERT_EQUAL(0, create_bench_file());
+
+    for (size_t i = 0; i < sizeof(rtts_ms) / sizeof(rtts_ms[0]); i++) {
+        file_transfer_info_t info;
+        memset(&info, 0, sizeof(info));
+
+        double mbps = run_transfer_at_rtt(rtts_ms[i], 34000 + (int)i * 10, &info);
+        TEST_ASSERT(mbps > 0);
+
+        test_log("RTT %3d ms: %8.2f MB/s (window %u KB, srtt %u ms)",
+                 rtts_ms[i], mbps, info.window_size / 1024, info.rtt_ms);
+    }
+
+    remove(BENCH_FILE);
+    return TEST_PASS;
+}
+
+/* ===== Suite Registration ===== */
+
+__attribute__((constructor)) static void register_flow_control_benchmarks(void) {
+    test_suite_t *suite = test_suite_create("flow_control_benchmarks");
+    if (!suite) return;
+
+    test_suite_add_test(suite, "bench_flow_throughput_vs_rtt", bench_flow_throughput_vs_rtt);
+
+    test_register_suite(suite);
+}
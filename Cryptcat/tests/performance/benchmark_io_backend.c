@@ -0,0 +1,306 @@
+/*
+ * Cryptcat I/O Backend Benchmarks
+ * Compares the epoll and io_uring event loop backends on the same echo
+ * workload, and buffered fread against io_uring read-ahead for file
+ * sends. io_uring cases are skipped when the build or kernel lacks it.
+ */
+
+#define _GNU_SOURCE  /* fileno */
+
+#include "test_harness.h"
+#include "../../src/include/crypto.h"
+#include "../../src/include/network.h"
+#include "../../src/include/protocol.h"
+#include "../../src/include/event_loop.h"
+#include "../../src/include/uring_io.h"
+#include <pthread.h>
+#include <stdio.h>
+
+#define BENCH_PASSWORD "bench_io_pwd"
+#define BENCH_PORT 36100
+#define BENCH_SESSIONS 64
+#define BENCH_ROUNDS 200            /* Echo round trips per session */
+#define BENCH_PAYLOAD_SIZE 1024
+#define BENCH_TIMEOUT_US (120ULL * 1000000ULL)
+#define BENCH_FILE_SIZE (64 * 1024 * 1024)
+#define BENCH_CHUNK_SIZE 16384
+#define BENCH_READ_AHEAD 8
+
+/* ===== Benchmark Utilities ===== */
+
+static uint64_t get_time_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000ULL;
+}
+
+/* Client side of one echo run */
+typedef struct {
+    int established;
+    int completed;
+    int failed;
+    uint64_t round_trips;
+    unsigned char payload[BENCH_PAYLOAD_SIZE];
+} echo_clients_t;
+
+/* Result of one echo run */
+typedef struct {
+    uint64_t round_trips;
+    uint64_t elapsed_us;
+    event_loop_stats_t server;
+} echo_result_t;
+
+/* Server: echo every data message */
+static void server_on_message(event_loop_t *loop, connection_t *conn, message_type_t type,
+                              const unsigned char *payload, size_t payload_len, void *ctx) {
+    (void)ctx;
+
+    if (type == MSG_DATA &&
+        send_message(conn, MSG_DATA, payload, payload_len) != PROTOCOL_SUCCESS) {
+        event_loop_close_connection(loop, conn);
+    }
+}
+
+/* Client: start pinging as soon as the session is up */
+static void client_on_connect(event_loop_t *loop, connection_t *conn, void *ctx) {
+    echo_clients_t *clients = (echo_clients_t*)ctx;
+
+    (void)loop;
+    clients->established++;
+    if (send_message(conn, MSG_DATA, clients->payload, BENCH_PAYLOAD_SIZE) != PROTOCOL_SUCCESS) {
+        clients->failed++;
+    }
+}
+
+/* Client: count the echo and send the next ping */
+static void client_on_message(event_loop_t *loop, connection_t *conn, message_type_t type,
+                              const unsigned char *payload, size_t payload_len, void *ctx) {
+    echo_clients_t *clients = (echo_clients_t*)ctx;
+    int *rounds = (int*)get_connection_user_data(conn);
+
+    (void)loop;
+    (void)payload;
+
+    if (type != MSG_DATA || payload_len != BENCH_PAYLOAD_SIZE) {
+        return;
+    }
+
+    clients->round_trips++;
+    if (++*rounds == BENCH_ROUNDS) {
+        clients->completed++;
+        return;
+    }
+
+    if (send_message(conn, MSG_DATA, clients->payload, BENCH_PAYLOAD_SIZE) != PROTOCOL_SUCCESS) {
+        clients->failed++;
+    }
+}
+
+/* Client: a session that drops out early counts as failed */
+static void client_on_close(event_loop_t *loop, connection_t *conn, int reason, void *ctx) {
+    echo_clients_t *clients = (echo_clients_t*)ctx;
+    int *rounds = (int*)get_connection_user_data(conn);
+
+    (void)loop;
+    (void)reason;
+
+    if (*rounds < BENCH_ROUNDS) {
+        clients->failed++;
+    }
+}
+
+/* Server loop thread */
+static void* server_thread(void *arg) {
+    event_loop_run((event_loop_t*)arg);
+    return NULL;
+}
+
+/* Run the echo workload against a server loop on the given backend */
+static int run_echo(event_loop_backend_t backend, int port, echo_result_t *result) {
+    event_loop_callbacks_t server_callbacks = { .on_message = server_on_message };
+    echo_clients_t clients;
+    event_loop_callbacks_t client_callbacks = {
+        .on_connect = client_on_connect,
+        .on_message = client_on_message,
+        .on_close = client_on_close,
+        .ctx = &clients
+    };
+    event_loop_t *server_loop, *client_loop;
+    connection_t *listener;
+    pthread_t server_tid;
+    uint64_t start_us;
+
+    memset(&clients, 0, sizeof(clients));
+    memset(clients.payload, 'x', sizeof(clients.payload));
+
+    server_loop = event_loop_create_backend(BENCH_PASSWORD, &server_callbacks,
+                                            BENCH_SESSIONS, backend);
+    client_loop = event_loop_create_backend(BENCH_PASSWORD, &client_callbacks,
+                                            BENCH_SESSIONS, EVENT_LOOP_BACKEND_EPOLL);
+    listener = create_listener(port, BENCH_PASSWORD);
+    if (!server_loop || !client_loop || !listener ||
+        event_loop_add_listener(server_loop, listener) != EVENT_LOOP_SUCCESS) {
+        event_loop_destroy(client_loop);
+        event_loop_destroy(server_loop);
+        return -1;
+    }
+    pthread_create(&server_tid, NULL, server_thread, server_loop);
+
+    start_us = get_time_us();
+    for (int i = 0; i < BENCH_SESSIONS; i++) {
+        connection_t *conn = connect_to_host("127.0.0.1", port, BENCH_PASSWORD);
+        int *rounds = calloc(1, sizeof(int));
+
+        if (!conn || !rounds) {
+            free(rounds);
+            if (conn) {
+                close_connection(conn);
+                free(conn);
+            }
+            clients.failed++;
+            continue;
+        }
+
+        set_connection_user_data(conn, rounds);
+        if (event_loop_add_connection(client_loop, conn, 0) != EVENT_LOOP_SUCCESS) {
+            close_connection(conn);
+            free(conn);
+            clients.failed++;
+        }
+    }
+
+    while (clients.completed + clients.failed < BENCH_SESSIONS &&
+           get_time_us() - start_us < BENCH_TIMEOUT_US) {
+        event_loop_run_once(client_loop, 100);
+    }
+    result->elapsed_us = get_time_us() - start_us;
+    result->round_trips = clients.round_trips;
+
+    event_loop_stop(server_loop);
+    pthread_join(server_tid, NULL);
+    result->server = event_loop_get_stats(server_loop);
+
+    event_loop_destroy(client_loop);
+    event_loop_destroy(server_loop);
+
+    return clients.completed == BENCH_SESSIONS ? 0 : -1;
+}
+
+/* Log one echo run */
+static void log_echo(const char *name, const echo_result_t *result) {
+    test_log("%-8s %llu round trips in %.2f s (%.0f msgs/s), server %llu wakeups, "
+             "%.1f completions/wakeup, %llu send chains",
+             name, (unsigned long long)result->round_trips, result->elapsed_us / 1e6,
+             2.0 * result->round_trips / (result->elapsed_us / 1e6),
+             (unsigned long long)result->server.wakeups,
+             result->server.wakeups
+                 ? (double)result->server.events / result->server.wakeups : 0.0,
+             (unsigned long long)result->server.send_batches);
+}
+
+/* Write a scratch file for the read benchmarks */
+static FILE* create_bench_file(void) {
+    FILE *file = tmpfile();
+    unsigned char block[BENCH_CHUNK_SIZE];
+
+    if (!file) return NULL;
+
+    for (size_t i = 0; i < sizeof(block); i++) {
+        block[i] = (unsigned char)(i * 31);
+    }
+    for (int i = 0; i < BENCH_FILE_SIZE / BENCH_CHUNK_SIZE; i++) {
+        if (fwrite(block, 1, sizeof(block), file) != sizeof(block)) {
+            fclose(file);
+            return NULL;
+        }
+    }
+    fflush(file);
+
+    return file;
+}
+
+/* ===== Benchmark Tests ===== */
+
+/* Benchmark: echo sessions served by epoll vs io_uring */
+TEST_CASE(bench_io_backend_echo) {
+    echo_result_t epoll_result, uring_result;
+
+    crypto_global_init();
+    network_init();
+
+    TEST_ASSERT_EQUAL(0, run_echo(EVENT_LOOP_BACKEND_EPOLL, BENCH_PORT, &epoll_result));
+    log_echo("epoll", &epoll_result);
+
+    if (!uring_io_available()) {
+        test_log("io_uring unavailable; skipping the io_uring run");
+        return TEST_SKIP;
+    }
+
+    TEST_ASSERT_EQUAL(0, run_echo(EVENT_LOOP_BACKEND_IO_URING, BENCH_PORT + 1, &uring_result));
+    log_echo("io_uring", &uring_result);
+
+    TEST_ASSERT_EQUAL(epoll_result.round_trips, uring_result.round_trips);
+    return TEST_PASS;
+}
+
+/* Benchmark: file chunk reads, fread vs io_uring read-ahead */
+TEST_CASE(bench_io_backend_file_read) {
+    FILE *file = create_bench_file();
+    unsigned char chunk[BENCH_CHUNK_SIZE];
+    uint64_t checksum_fread = 0, checksum_uring = 0;
+    uint64_t start_us, fread_us, uring_us;
+    uring_file_reader_t *reader;
+    size_t n;
+
+    TEST_ASSERT_NOT_NULL(file);
+
+    rewind(file);
+    start_us = get_time_us();
+    while ((n = fread(chunk, 1, sizeof(chunk), file)) > 0) {
+        checksum_fread += chunk[0] + chunk[n - 1];
+    }
+    fread_us = get_time_us() - start_us;
+
+    test_log("fread     %d MB in %.1f ms (%.0f MB/s)", BENCH_FILE_SIZE >> 20,
+             fread_us / 1e3, (BENCH_FILE_SIZE / 1048576.0) / (fread_us / 1e6));
+
+    start_us = get_time_us();
+    reader = uring_file_reader_create(fileno(file), 0, BENCH_FILE_SIZE,
+                                      BENCH_CHUNK_SIZE, BENCH_READ_AHEAD);
+    if (!reader) {
+        fclose(file);
+        test_log("io_uring unavailable; skipping the read-ahead run");
+        return TEST_SKIP;
+    }
+
+    for (;;) {
+        const unsigned char *data;
+        int result = uring_file_reader_next(reader, &data, &n);
+
+        if (result == URING_IO_EOF) break;
+        TEST_ASSERT_EQUAL(URING_IO_SUCCESS, result);
+        checksum_uring += data[0] + data[n - 1];
+    }
+    uring_us = get_time_us() - start_us;
+    uring_file_reader_destroy(reader);
+    fclose(file);
+
+    test_log("io_uring  %d MB in %.1f ms (%.0f MB/s), %d chunks read ahead",
+             BENCH_FILE_SIZE >> 20, uring_us / 1e3,
+             (BENCH_FILE_SIZE / 1048576.0) / (uring_us / 1e6), BENCH_READ_AHEAD);
+
+    TEST_ASSERT_EQUAL(checksum_fread, checksum_uring);
+    return TEST_PASS;
+}
+
+/* ===== Suite Registration ===== */
+
+__attribute__((constructor)) static void register_io_backend_benchmarks(void) {
+    test_suite_t *suite = test_suite_create("io_backend_benchmarks");
+    if (!suite) return;
+
+    test_suite_add_test(suite, "bench_io_backend_echo", bench_io_backend_echo);
+    test_suite_add_test(suite, "bench_io_backend_file_read", bench_io_backend_file_read);
+
+    test_register_suite(suite);
+}
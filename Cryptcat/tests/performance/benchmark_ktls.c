@@ -0,0 +1,287 @@
+/*
+ * Cryptcat Kernel TLS Benchmarks
+ * Compares user-space record crypto with kernel TLS offload over
+ * loopback, for sealed records and for file chunks sent with sendfile().
+ * Kernel TLS cases are skipped when the kernel lacks the tls module.
+ */
+
+#define _GNU_SOURCE  /* fileno */
+
+#include "test_harness.h"
+#include "../../src/include/crypto.h"
+#include "../../src/include/network.h"
+#include "../../src/include/protocol.h"
+#include "../../src/include/event_loop.h"
+#include "../../src/include/ktls.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#define BENCH_PASSWORD "bench_ktls_pwd"
+#define BENCH_PORT 36300
+#define BENCH_RECORD_SIZE 16384
+#define BENCH_RECORDS 16384         /* 256 MB */
+#define BENCH_TIMEOUT_US (120ULL * 1000000ULL)
+
+/* How one run sends */
+typedef enum {
+    SEND_USER_CRYPTO,               /* send_message(), sealed in user space */
+    SEND_KERNEL_TLS,                /* send_message() after ktls_enable() */
+    SEND_USER_FILE,                 /* pread() + send_file_chunk() */
+    SEND_KERNEL_FILE                /* send_file_chunk_from_fd() after ktls_enable() */
+} send_mode_t;
+
+/* ===== Benchmark Utilities ===== */
+
+static uint64_t get_time_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000ULL;
+}
+
+/* Receiving side: an event loop that counts and drops records */
+typedef struct {
+    event_loop_t *loop;
+    pthread_t tid;
+    atomic_ullong messages;
+} sink_t;
+
+/* Result of one sending run */
+typedef struct {
+    uint64_t records;
+    uint64_t bytes;
+    uint64_t elapsed_us;
+    int offloaded;                  /* ktls_enable() result */
+} send_result_t;
+
+static void sink_on_message(event_loop_t *loop, connection_t *conn, message_type_t type,
+                            const unsigned char *payload, size_t payload_len, void *ctx) {
+    sink_t *sink = (sink_t*)ctx;
+
+    (void)loop;
+    (void)conn;
+    (void)payload;
+    (void)payload_len;
+
+    if (type == MSG_DATA || type == MSG_FILE_CHUNK) {
+        atomic_fetch_add(&sink->messages, 1);
+    }
+}
+
+static void* sink_thread(void *arg) {
+    event_loop_run(((sink_t*)arg)->loop);
+    return NULL;
+}
+
+/* Start a sink listening on port */
+static int sink_start(sink_t *sink, int port) {
+    event_loop_callbacks_t callbacks = { .on_message = sink_on_message, .ctx = sink };
+    connection_t *listener;
+
+    atomic_init(&sink->messages, 0);
+    sink->loop = event_loop_create_backend(BENCH_PASSWORD, &callbacks, 4,
+                                           EVENT_LOOP_BACKEND_EPOLL);
+    listener = create_listener(port, BENCH_PASSWORD);
+    if (!sink->loop || !listener ||
+        event_loop_add_listener(sink->loop, listener) != EVENT_LOOP_SUCCESS) {
+        event_loop_destroy(sink->loop);
+        return -1;
+    }
+
+    pthread_create(&sink->tid, NULL, sink_thread, sink);
+    return 0;
+}
+
+static void sink_stop(sink_t *sink) {
+    event_loop_stop(sink->loop);
+    pthread_join(sink->tid, NULL);
+    event_loop_destroy(sink->loop);
+}
+
+/* Write a scratch file of incompressible data */
+static FILE* create_bench_file(void) {
+    FILE *file = tmpfile();
+    unsigned char block[BENCH_RECORD_SIZE];
+    uint32_t seed = 2463534242u;
+
+    if (!file) return NULL;
+
+    for (int i = 0; i < BENCH_RECORDS; i++) {
+        for (size_t j = 0; j < sizeof(block); j++) {
+            seed ^= seed << 13;
+            seed ^= seed >> 17;
+            seed ^= seed << 5;
+            block[j] = (unsigned char)seed;
+        }
+        if (fwrite(block, 1, sizeof(block), file) != sizeof(block)) {
+            fclose(file);
+            return NULL;
+        }
+    }
+    fflush(file);
+
+    return file;
+}
+
+/* Send every block of file to a fresh sink and wait until all have arrived */
+static int run_send(int port, send_mode_t mode, FILE *file, send_result_t *result) {
+    unsigned char block[BENCH_RECORD_SIZE];
+    connection_t *conn;
+    sink_t sink;
+    uint64_t start_us;
+    int fd = fileno(file);
+    int ok = 1;
+
+    memset(result, 0, sizeof(*result));
+
+    if (sink_start(&sink, port) != 0) {
+        return -1;
+    }
+
+    conn = connect_to_host("127.0.0.1", port, BENCH_PASSWORD);
+    if (!conn || perform_handshake(conn, 0, BENCH_PASSWORD) != PROTOCOL_SUCCESS) {
+        if (conn) {
+            close_connection(conn);
+            free(conn);
+        }
+        sink_stop(&sink);
+        return -1;
+    }
+
+    if (mode == SEND_KERNEL_TLS || mode == SEND_KERNEL_FILE) {
+        result->offloaded = ktls_enable(conn, KTLS_DEFAULT_TIMEOUT_MS);
+        ok = result->offloaded == KTLS_SUCCESS;
+    }
+
+    /* sendfile() data cannot pass through record compression */
+    if (ok && mode == SEND_KERNEL_FILE && get_connection_compression(conn)) {
+        result->offloaded = KTLS_ERROR_UNSUPPORTED;
+        ok = 0;
+    }
+
+    start_us = get_time_us();
+
+    for (int i = 0; i < BENCH_RECORDS && ok; i++) {
+        off_t offset = (off_t)i * BENCH_RECORD_SIZE;
+
+        switch (mode) {
+            case SEND_KERNEL_FILE:
+                ok = send_file_chunk_from_fd(conn, fd, (uint64_t)offset, BENCH_RECORD_SIZE,
+                                             (uint32_t)i) == PROTOCOL_SUCCESS;
+                break;
+            case SEND_USER_FILE:
+                ok = pread(fd, block, sizeof(block), offset) == (ssize_t)sizeof(block) &&
+                     send_file_chunk(conn, block, sizeof(block), (uint32_t)i) == PROTOCOL_SUCCESS;
+                break;
+            default:
+                ok = pread(fd, block, sizeof(block), offset) == (ssize_t)sizeof(block) &&
+                     send_message(conn, MSG_DATA, block, sizeof(block)) == PROTOCOL_SUCCESS;
+                break;
+        }
+    }
+
+    while (ok && atomic_load(&sink.messages) < (uint64_t)BENCH_RECORDS &&
+           get_time_us() - start_us < BENCH_TIMEOUT_US) {
+        usleep(1000);
+    }
+
+    result->elapsed_us = get_time_us() - start_us;
+    result->records = atomic_load(&sink.messages);
+    result->bytes = result->records * BENCH_RECORD_SIZE;
+
+    close_connection(conn);
+    free(conn);
+    sink_stop(&sink);
+
+    return ok && result->records == (uint64_t)BENCH_RECORDS ? 0 : -1;
+}
+
+/* Log one run */
+static void log_send(const char *name, const send_result_t *result) {
+    test_log("%-16s %llu records in %.2f s (%.0f MB/s)",
+             name, (unsigned long long)result->records, result->elapsed_us / 1e6,
+             (result->bytes / 1048576.0) / (result->elapsed_us / 1e6));
+}
+
+/* Whether a kernel TLS run was refused rather than failed */
+static int offload_refused(const send_result_t *result) {
+    return result->offloaded == KTLS_ERROR_UNSUPPORTED ||
+           result->offloaded == KTLS_ERROR_REJECTED;
+}
+
+/* ===== Benchmark Tests ===== */
+
+/* Benchmark: records sealed in user space vs by kernel TLS */
+TEST_CASE(bench_ktls_records) {
+    FILE *file = create_bench_file();
+    send_result_t user, kernel;
+
+    TEST_ASSERT_NOT_NULL(file);
+    crypto_global_init();
+    network_init();
+
+    TEST_ASSERT_EQUAL(0, run_send(BENCH_PORT, SEND_USER_CRYPTO, file, &user));
+    log_send("user-space", &user);
+
+    if (!ktls_available()) {
+        fclose(file);
+        test_log("Kernel TLS unavailable; skipping the offloaded run");
+        return TEST_SKIP;
+    }
+
+    if (run_send(BENCH_PORT + 1, SEND_KERNEL_TLS, file, &kernel) != 0 &&
+        offload_refused(&kernel)) {
+        fclose(file);
+        test_log("Kernel TLS refused: %s", ktls_strerror(kernel.offloaded));
+        return TEST_SKIP;
+    }
+    fclose(file);
+
+    log_send("kernel TLS", &kernel);
+    TEST_ASSERT_EQUAL(user.records, kernel.records);
+    return TEST_PASS;
+}
+
+/* Benchmark: file chunks read and sealed in user space vs sendfile() */
+TEST_CASE(bench_ktls_sendfile) {
+    FILE *file = create_bench_file();
+    send_result_t user, kernel;
+
+    TEST_ASSERT_NOT_NULL(file);
+    crypto_global_init();
+    network_init();
+
+    TEST_ASSERT_EQUAL(0, run_send(BENCH_PORT + 2, SEND_USER_FILE, file, &user));
+    log_send("pread + seal", &user);
+
+    if (!ktls_available()) {
+        fclose(file);
+        test_log("Kernel TLS unavailable; skipping the sendfile run");
+        return TEST_SKIP;
+    }
+
+    if (run_send(BENCH_PORT + 3, SEND_KERNEL_FILE, file, &kernel) != 0 &&
+        offload_refused(&kernel)) {
+        fclose(file);
+        test_log("Kernel TLS sendfile refused: %s", ktls_strerror(kernel.offloaded));
+        return TEST_SKIP;
+    }
+    fclose(file);
+
+    log_send("kTLS sendfile", &kernel);
+    TEST_ASSERT_EQUAL(user.records, kernel.records);
+    return TEST_PASS;
+}
+
+/* ===== Suite Registration ===== */
+
+__attribute__((constructor)) static void register_ktls_benchmarks(void) {
+    test_suite_t *suite = test_suite_create("ktls_benchmarks");
+    if (!suite) return;
+
+    test_suite_add_test(suite, "bench_ktls_records", bench_ktls_records);
+    test_suite_add_test(suite, "bench_ktls_sendfile", bench_ktls_sendfile);
+
+    test_register_suite(suite);
+}
@@ -0,0 +1,254 @@
+/*
+ * Cryptcat Send Path Benchmarks
+ * Counts write syscalls per record with one write per record against
+ * corked gather writes, and compares copied with MSG_ZEROCOPY sends of
+ * large records. Zerocopy is copied anyway on loopback, so the second
+ * case reports how the kernel treated the sends rather than a speedup.
+ */
+
+#define _GNU_SOURCE  /* usleep, clock_gettime */
+
+#include "test_harness.h"
+#include "../../src/include/crypto.h"
+#include "../../src/include/network.h"
+#include "../../src/include/protocol.h"
+#include "../../src/include/event_loop.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <unistd.h>
+
+#define BENCH_PASSWORD "bench_send_pwd"
+#define BENCH_PORT 36200
+#define BENCH_SMALL_RECORDS 100000
+#define BENCH_SMALL_SIZE 512
+#define BENCH_BURST 64              /* Records sealed per corked flush */
+#define BENCH_LARGE_SIZE 60000      /* Above NETWORK_ZEROCOPY_THRESHOLD */
+#define BENCH_LARGE_RECORDS 8192    /* ~470 MB */
+#define BENCH_TIMEOUT_US (120ULL * 1000000ULL)
+
+/* ===== Benchmark Utilities ===== */
+
+static uint64_t get_time_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000ULL;
+}
+
+/* Receiving side: an event loop that counts and drops data */
+typedef struct {
+    event_loop_t *loop;
+    pthread_t tid;
+    atomic_ullong messages;
+} sink_t;
+
+/* Result of one sending run */
+typedef struct {
+    uint64_t records;
+    uint64_t bytes;
+    uint64_t elapsed_us;
+    connection_info_t info;
+} send_result_t;
+
+static void sink_on_message(event_loop_t *loop, connection_t *conn, message_type_t type,
+                            const unsigned char *payload, size_t payload_len, void *ctx) {
+    sink_t *sink = (sink_t*)ctx;
+
+    (void)loop;
+    (void)conn;
+    (void)payload;
+    (void)payload_len;
+
+    if (type == MSG_DATA) {
+        atomic_fetch_add(&sink->messages, 1);
+    }
+}
+
+static void* sink_thread(void *arg) {
+    event_loop_run(((sink_t*)arg)->loop);
+    return NULL;
+}
+
+/* Start a sink listening on port */
+static int sink_start(sink_t *sink, int port) {
+    event_loop_callbacks_t callbacks = { .on_message = sink_on_message, .ctx = sink };
+    connection_t *listener;
+
+    atomic_init(&sink->messages, 0);
+    sink->loop = event_loop_create_backend(BENCH_PASSWORD, &callbacks, 4,
+                                           EVENT_LOOP_BACKEND_EPOLL);
+    listener = create_listener(port, BENCH_PASSWORD);
+    if (!sink->loop || !listener ||
+        event_loop_add_listener(sink->loop, listener) != EVENT_LOOP_SUCCESS) {
+        event_loop_destroy(sink->loop);
+        return -1;
+    }
+
+    pthread_create(&sink->tid, NULL, sink_thread, sink);
+    return 0;
+}
+
+static void sink_stop(sink_t *sink) {
+    event_loop_stop(sink->loop);
+    pthread_join(sink->tid, NULL);
+    event_loop_destroy(sink->loop);
+}
+
+/* Write a corked connection's queue out, sleeping while the socket is full */
+static int flush_all(connection_t *conn) {
+    int pending;
+
+    while ((pending = flush_connection(conn)) > 0) {
+        if (wait_for_socket(get_connection_socket(conn), 1000, 0, 1) < 0) {
+            /* Zerocopy completions also wake poll as errors */
+            continue;
+        }
+    }
+
+    return pending;
+}
+
+/* Send records to a fresh sink and wait until all have arrived */
+static int run_send(int port, size_t record_size, int records, int corked, int zerocopy,
+                    send_result_t *result) {
+    static unsigned char payload[BENCH_LARGE_SIZE];
+    connection_t *conn;
+    sink_t sink;
+    uint64_t start_us;
+    int ok = 1;
+    uint32_t seed = 2463534242u;
+
+    /* Incompressible, so negotiated compression leaves record sizes alone */
+    for (size_t i = 0; i < sizeof(payload); i++) {
+        seed ^= seed << 13;
+        seed ^= seed >> 17;
+        seed ^= seed << 5;
+        payload[i] = (unsigned char)seed;
+    }
+    memset(result, 0, sizeof(*result));
+
+    if (sink_start(&sink, port) != 0) {
+        return -1;
+    }
+
+    conn = connect_to_host("127.0.0.1", port, BENCH_PASSWORD);
+    if (!conn || perform_handshake(conn, 0, BENCH_PASSWORD) != PROTOCOL_SUCCESS) {
+        if (conn) {
+            close_connection(conn);
+            free(conn);
+        }
+        sink_stop(&sink);
+        return -1;
+    }
+
+    set_connection_zerocopy(conn, zerocopy);
+    if (corked) {
+        set_connection_cork(conn, 1, NULL, NULL);
+    }
+
+    /* The handshake's own writes are not part of the measurement */
+    result->info = get_connection_info(conn);
+    start_us = get_time_us();
+
+    for (int i = 0; i < records && ok; i++) {
+        ok = send_message(conn, MSG_DATA, payload, record_size) == PROTOCOL_SUCCESS;
+        if (ok && corked && (i + 1) % BENCH_BURST == 0) {
+            ok = flush_all(conn) == 0;
+        }
+    }
+    if (ok && corked) {
+        ok = flush_all(conn) == 0;
+    }
+
+    while (ok && atomic_load(&sink.messages) < (uint64_t)records &&
+           get_time_us() - start_us < BENCH_TIMEOUT_US) {
+        usleep(1000);
+    }
+
+    result->elapsed_us = get_time_us() - start_us;
+    result->records = atomic_load(&sink.messages);
+    result->bytes = result->records * record_size;
+    {
+        connection_info_t end = get_connection_info(conn);
+
+        result->info.send_calls = end.send_calls - result->info.send_calls;
+        result->info.zerocopy_sends = end.zerocopy_sends - result->info.zerocopy_sends;
+        result->info.zerocopy_copied = end.zerocopy_copied - result->info.zerocopy_copied;
+    }
+
+    close_connection(conn);
+    free(conn);
+    sink_stop(&sink);
+
+    return ok && result->records == (uint64_t)records ? 0 : -1;
+}
+
+/* Log one run */
+static void log_send(const char *name, const send_result_t *result) {
+    test_log("%-10s %llu records in %.2f s (%.0f MB/s), %llu write syscalls "
+             "(%.2f per record), %llu zerocopy, %llu copied by the kernel",
+             name, (unsigned long long)result->records, result->elapsed_us / 1e6,
+             (result->bytes / 1048576.0) / (result->elapsed_us / 1e6),
+             (unsigned long long)result->info.send_calls,
+             result->records ? (double)result->info.send_calls / result->records : 0.0,
+             (unsigned long long)result->info.zerocopy_sends,
+             (unsigned long long)result->info.zerocopy_copied);
+}
+
+/* ===== Benchmark Tests ===== */
+
+/* Benchmark: small records, one write each vs gathered per burst */
+TEST_CASE(bench_send_gather_syscalls) {
+    send_result_t single, gathered;
+
+    crypto_global_init();
+    network_init();
+
+    TEST_ASSERT_EQUAL(0, run_send(BENCH_PORT, BENCH_SMALL_SIZE, BENCH_SMALL_RECORDS,
+                                  0, 0, &single));
+    log_send("per-record", &single);
+
+    TEST_ASSERT_EQUAL(0, run_send(BENCH_PORT + 1, BENCH_SMALL_SIZE, BENCH_SMALL_RECORDS,
+                                  1, 0, &gathered));
+    log_send("corked", &gathered);
+
+    /* A burst of 64 records should cost a few writes, not 64 */
+    TEST_ASSERT(gathered.info.send_calls * 8 < single.info.send_calls);
+    return TEST_PASS;
+}
+
+/* Benchmark: large records, copied vs MSG_ZEROCOPY */
+TEST_CASE(bench_send_zerocopy_throughput) {
+    send_result_t copied, zerocopy;
+
+    crypto_global_init();
+    network_init();
+
+    TEST_ASSERT_EQUAL(0, run_send(BENCH_PORT + 2, BENCH_LARGE_SIZE, BENCH_LARGE_RECORDS,
+                                  0, 0, &copied));
+    log_send("copy", &copied);
+    TEST_ASSERT_EQUAL(0, copied.info.zerocopy_sends);
+
+    /* Forced on, so loopback's copying does not switch it back off */
+    TEST_ASSERT_EQUAL(0, run_send(BENCH_PORT + 3, BENCH_LARGE_SIZE, BENCH_LARGE_RECORDS,
+                                  0, 1, &zerocopy));
+    log_send("zerocopy", &zerocopy);
+
+    if (zerocopy.info.zerocopy_sends == 0) {
+        test_log("MSG_ZEROCOPY unavailable on this kernel or platform");
+        return TEST_SKIP;
+    }
+
+    return TEST_PASS;
+}
+
+/* ===== Suite Registration ===== */
+
+__attribute__((constructor)) static void register_send_path_benchmarks(void) {
+    test_suite_t *suite = test_suite_create("send_path_benchmarks");
+    if (!suite) return;
+
+    test_suite_add_test(suite, "bench_send_gather_syscalls", bench_send_gather_syscalls);
+    test_suite_add_test(suite, "bench_send_zerocopy_throughput", bench_send_zerocopy_throughput);
+
+    test_register_suite(suite);
+}
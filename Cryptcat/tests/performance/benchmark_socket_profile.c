@@ -0,0 +1,506 @@
+/*
+ * Cryptcat Socket Profile Benchmarks
+ * Compares round-trip latency and bulk throughput under each socket
+ * tuning profile across a path with added delay. By default the delay
+ * comes from an in-process relay that holds every chunk for
+ * BENCH_DELAY_MS each way. The relay ends each TCP connection itself, so
+ * its delay shows in Nagle and delayed-ACK stalls but not in the RTT the
+ * kernel measures. To exercise buffer sizing and BBR, put the delay in
+ * the kernel instead and connect directly:
+ *   tc qdisc add dev lo root netem delay 20ms
+ *   CRYPTCAT_BENCH_NETEM=1 ./benchmark_crypto
+ */
+
+#define _GNU_SOURCE  /* usleep */
+
+#include "test_harness.h"
+#include "../../src/include/crypto.h"
+#include "../../src/include/network.h"
+#include "../../src/include/protocol.h"
+#include "../../src/include/event_loop.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <unistd.h>
+#include <errno.h>
+#include <poll.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+
+#define BENCH_PASSWORD "bench_profile_pwd"
+#define BENCH_PORT 36500
+#define BENCH_RELAY_OFFSET 50       /* Relay for BENCH_PORT + n listens on + n + 50 */
+#define BENCH_DELAY_MS 20           /* Relay delay per direction */
+#define BENCH_ROUNDS 50             /* Round trips per latency measurement */
+#define BENCH_PING_SIZE 64
+#define BENCH_RECORD_SIZE 60000
+#define BENCH_BULK_RECORDS 1024     /* ~60 MB per profile */
+#define BENCH_TIMEOUT_US (120ULL * 1000000ULL)
+#define RELAY_CHUNK 65536
+#define RELAY_WINDOW (8 * 1024 * 1024) /* Bytes held per direction: the path's capacity */
+
+static const network_profile_t bench_profiles[] = {
+    NETWORK_PROFILE_DEFAULT, NETWORK_PROFILE_INTERACTIVE,
+    NETWORK_PROFILE_BULK, NETWORK_PROFILE_WAN
+};
+
+#define BENCH_PROFILE_COUNT ((int)(sizeof(bench_profiles) / sizeof(bench_profiles[0])))
+
+/* ===== Benchmark Utilities ===== */
+
+static uint64_t get_time_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000ULL;
+}
+
+/* Delay comes from a netem qdisc the caller set up, not the relay */
+static int bench_use_netem(void) {
+    const char *env = getenv("CRYPTCAT_BENCH_NETEM");
+
+    return env && atoi(env) > 0;
+}
+
+/* Data the relay holds until its due time */
+typedef struct relay_chunk_s {
+    struct relay_chunk_s *next;
+    uint64_t due_us;
+    size_t len;
+    size_t off;
+    unsigned char data[];
+} relay_chunk_t;
+
+/* One direction through the relay */
+typedef struct {
+    int from;
+    int to;
+    atomic_int *stop;
+} relay_pipe_t;
+
+/* Delay relay: accepts one client and forwards it to the server */
+typedef struct {
+    int listen_fd;
+    int upstream_port;
+    pthread_t tid;
+    atomic_int stop;
+} relay_t;
+
+/* Forward one direction, holding each chunk for BENCH_DELAY_MS */
+static void* relay_pipe_run(void *arg) {
+    relay_pipe_t *dir = (relay_pipe_t*)arg;
+    relay_chunk_t *head = NULL, *tail = NULL;
+    size_t held = 0;
+    int eof = 0;
+
+    while (!atomic_load(dir->stop) && !(eof && !head)) {
+        struct pollfd fds[2];
+        uint64_t now = get_time_us();
+        int nfds = 0, timeout = 100, in = -1, out = -1;
+
+        if (!eof && held < RELAY_WINDOW) {
+            fds[nfds].fd = dir->from;
+            fds[nfds].events = POLLIN;
+            in = nfds++;
+        }
+        if (head && head->due_us <= now) {
+            fds[nfds].fd = dir->to;
+            fds[nfds].events = POLLOUT;
+            out = nfds++;
+        } else if (head) {
+            timeout = (int)((head->due_us - now + 999) / 1000);
+        }
+
+        if (poll(fds, (nfds_t)nfds, timeout) < 0) {
+            break;
+        }
+
+        if (in >= 0 && (fds[in].revents & (POLLIN | POLLHUP | POLLERR))) {
+            relay_chunk_t *chunk = malloc(sizeof(relay_chunk_t) + RELAY_CHUNK);
+            ssize_t n;
+
+            if (!chunk) break;
+            n = recv(dir->from, chunk->data, RELAY_CHUNK, 0);
+            if (n > 0) {
+                chunk->next = NULL;
+                chunk->due_us = get_time_us() + BENCH_DELAY_MS * 1000ULL;
+                chunk->len = (size_t)n;
+                chunk->off = 0;
+                if (tail) tail->next = chunk; else head = chunk;
+                tail = chunk;
+                held += (size_t)n;
+            } else {
+                free(chunk);
+                if (n == 0 || (errno != EAGAIN && errno != EINTR)) {
+                    eof = 1;
+                }
+            }
+        }
+
+        if (out >= 0 && (fds[out].revents & POLLOUT)) {
+            ssize_t n = send(dir->to, head->data + head->off, head->len - head->off,
+                             MSG_NOSIGNAL);
+
+            if (n < 0 && errno != EAGAIN && errno != EINTR) {
+                break;
+            }
+            if (n > 0) {
+                head->off += (size_t)n;
+                held -= (size_t)n;
+                if (head->off == head->len) {
+                    relay_chunk_t *done = head;
+                    head = head->next;
+                    if (!head) tail = NULL;
+                    free(done);
+                }
+            }
+        } else if (out >= 0 && (fds[out].revents & (POLLHUP | POLLERR))) {
+            break;
+        }
+    }
+
+    shutdown(dir->to, SHUT_WR);
+    while (head) {
+        relay_chunk_t *next = head->next;
+        free(head);
+        head = next;
+    }
+    return NULL;
+}
+
+/* Relay thread: one client, both directions, then done */
+static void* relay_thread(void *arg) {
+    relay_t *relay = (relay_t*)arg;
+    struct sockaddr_in addr;
+    relay_pipe_t up, down;
+    pthread_t down_tid;
+    struct pollfd pfd = { .fd = relay->listen_fd, .events = POLLIN };
+    int client = -1, server, one = 1;
+
+    while (!atomic_load(&relay->stop) && client < 0) {
+        if (poll(&pfd, 1, 100) > 0) {
+            client = accept(relay->listen_fd, NULL, NULL);
+        }
+    }
+    if (client < 0) {
+        return NULL;
+    }
+
+    server = socket(AF_INET, SOCK_STREAM, 0);
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons((uint16_t)relay->upstream_port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (server < 0 || connect(server, (struct sockaddr*)&addr, sizeof(addr)) != 0) {
+        if (server >= 0) close(server);
+        close(client);
+        return NULL;
+    }
+
+    /* The relay stands in for the network: it forwards, it never waits */
+    setsockopt(client, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    setsockopt(server, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    set_nonblocking(client);
+    set_nonblocking(server);
+
+    up = (relay_pipe_t){ .from = client, .to = server, .stop = &relay->stop };
+    down = (relay_pipe_t){ .from = server, .to = client, .stop = &relay->stop };
+    pthread_create(&down_tid, NULL, relay_pipe_run, &down);
+    relay_pipe_run(&up);
+    pthread_join(down_tid, NULL);
+
+    close(client);
+    close(server);
+    return NULL;
+}
+
+/* Start a relay on port in front of upstream_port */
+static int relay_start(relay_t *relay, int port, int upstream_port) {
+    struct sockaddr_in addr;
+    int one = 1;
+
+    atomic_init(&relay->stop, 0);
+    relay->upstream_port = upstream_port;
+    relay->listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (relay->listen_fd < 0) {
+        return -1;
+    }
+
+    setsockopt(relay->listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons((uint16_t)port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (bind(relay->listen_fd, (struct sockaddr*)&addr, sizeof(addr)) != 0 ||
+        listen(relay->listen_fd, 4) != 0) {
+        close(relay->listen_fd);
+        return -1;
+    }
+
+    pthread_create(&relay->tid, NULL, relay_thread, relay);
+    return 0;
+}
+
+static void relay_stop(relay_t *relay) {
+    atomic_store(&relay->stop, 1);
+    pthread_join(relay->tid, NULL);
+    close(relay->listen_fd);
+}
+
+/* Server side: an event loop that echoes or counts data */
+typedef struct {
+    event_loop_t *loop;
+    pthread_t tid;
+    int echo;
+    atomic_ullong messages;
+} server_t;
+
+static void server_on_message(event_loop_t *loop, connection_t *conn, message_type_t type,
+                              const unsigned char *payload, size_t payload_len, void *ctx) {
+    server_t *server = (server_t*)ctx;
+
+    if (type != MSG_DATA) {
+        return;
+    }
+
+    atomic_fetch_add(&server->messages, 1);
+    if (server->echo &&
+        send_message(conn, MSG_DATA, payload, payload_len) != PROTOCOL_SUCCESS) {
+        event_loop_close_connection(loop, conn);
+    }
+}
+
+static void* server_thread(void *arg) {
+    event_loop_run(((server_t*)arg)->loop);
+    return NULL;
+}
+
+/* Start a server on port; its listener takes the current default profile */
+static int server_start(server_t *server, int port, int echo) {
+    event_loop_callbacks_t callbacks = { .on_message = server_on_message, .ctx = server };
+    connection_t *listener;
+
+    server->echo = echo;
+    atomic_init(&server->messages, 0);
+    server->loop = event_loop_create_backend(BENCH_PASSWORD, &callbacks, 4,
+                                             EVENT_LOOP_BACKEND_EPOLL);
+    listener = create_listener(port, BENCH_PASSWORD);
+    if (!server->loop || !listener ||
+        event_loop_add_listener(server->loop, listener) != EVENT_LOOP_SUCCESS) {
+        event_loop_destroy(server->loop);
+        return -1;
+    }
+
+    pthread_create(&server->tid, NULL, server_thread, server);
+    return 0;
+}
+
+static void server_stop(server_t *server) {
+    event_loop_stop(server->loop);
+    pthread_join(server->tid, NULL);
+    event_loop_destroy(server->loop);
+}
+
+/* One profile's path: server, relay unless netem delays instead, client */
+typedef struct {
+    server_t server;
+    relay_t relay;
+    int relayed;
+    connection_t *conn;
+} bench_path_t;
+
+static int path_open(bench_path_t *path, network_profile_t profile, int port, int echo) {
+    int client_port = port;
+
+    memset(path, 0, sizeof(*path));
+    network_set_default_profile(profile);
+
+    if (server_start(&path->server, port, echo) != 0) {
+        return -1;
+    }
+
+    if (!bench_use_netem()) {
+        client_port = port + BENCH_RELAY_OFFSET;
+        if (relay_start(&path->relay, client_port, port) != 0) {
+            server_stop(&path->server);
+            return -1;
+        }
+        path->relayed = 1;
+    }
+
+    path->conn = connect_to_host("127.0.0.1", client_port, BENCH_PASSWORD);
+    if (!path->conn || perform_handshake(path->conn, 0, BENCH_PASSWORD) != PROTOCOL_SUCCESS) {
+        if (path->conn) {
+            close_connection(path->conn);
+            free(path->conn);
+            path->conn = NULL;
+        }
+        if (path->relayed) relay_stop(&path->relay);
+        server_stop(&path->server);
+        return -1;
+    }
+
+    return 0;
+}
+
+static void path_close(bench_path_t *path) {
+    close_connection(path->conn);
+    free(path->conn);
+    if (path->relayed) {
+        relay_stop(&path->relay);
+    }
+    server_stop(&path->server);
+}
+
+/* Wait for count echoed data messages */
+static int await_echoes(connection_t *conn, int count) {
+    unsigned char buffer[BENCH_PING_SIZE * 4];
+    message_type_t type;
+    size_t len;
+    int status;
+
+    while (count > 0) {
+        len = sizeof(buffer);
+        status = receive_message(conn, &type, buffer, &len);
+        if (status == PROTOCOL_IN_PROGRESS) {
+            if (wait_for_socket(get_connection_socket(conn), 5000, 1, 0) <= 0) {
+                return -1;
+            }
+            continue;
+        }
+        if (status != PROTOCOL_SUCCESS) {
+            return -1;
+        }
+        if (type == MSG_DATA) {
+            count--;
+        }
+    }
+
+    return 0;
+}
+
+static int compare_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t*)a, y = *(const uint64_t*)b;
+    return x < y ? -1 : x > y;
+}
+
+/* Median round trip of messages sent burst at a time; a burst of two
+ * puts the second write behind Nagle until the first is acknowledged */
+static int measure_rtt(connection_t *conn, int burst, uint64_t *median_us, uint64_t *worst_us) {
+    static const unsigned char ping[BENCH_PING_SIZE];
+    uint64_t samples[BENCH_ROUNDS];
+
+    for (int i = 0; i < BENCH_ROUNDS; i++) {
+        uint64_t start_us = get_time_us();
+
+        for (int j = 0; j < burst; j++) {
+            if (send_message(conn, MSG_DATA, ping, sizeof(ping)) != PROTOCOL_SUCCESS) {
+                return -1;
+            }
+        }
+        if (await_echoes(conn, burst) != 0) {
+            return -1;
+        }
+        samples[i] = get_time_us() - start_us;
+    }
+
+    qsort(samples, BENCH_ROUNDS, sizeof(samples[0]), compare_u64);
+    *median_us = samples[BENCH_ROUNDS / 2];
+    *worst_us = samples[BENCH_ROUNDS - 1];
+    return 0;
+}
+
+/* ===== Benchmark Tests ===== */
+
+/* Benchmark: Round trips of single and paired small messages per profile */
+TEST_CASE(bench_profile_latency) {
+    crypto_global_init();
+    network_init();
+
+    if (bench_use_netem()) {
+        test_log("Delay: netem on loopback, direct connections");
+    } else {
+        test_log("Delay: relay, %d ms each way", BENCH_DELAY_MS);
+    }
+
+    for (int i = 0; i < BENCH_PROFILE_COUNT; i++) {
+        bench_path_t path;
+        uint64_t single_us, single_worst_us, pair_us, pair_worst_us;
+        int ok;
+
+        TEST_ASSERT_EQUAL(0, path_open(&path, bench_profiles[i], BENCH_PORT + i, 1));
+        ok = measure_rtt(path.conn, 1, &single_us, &single_worst_us) == 0 &&
+             measure_rtt(path.conn, 2, &pair_us, &pair_worst_us) == 0;
+        path_close(&path);
+        TEST_ASSERT(ok);
+
+        test_log("%-12s single %.2f ms (worst %.2f), pair %.2f ms (worst %.2f)",
+                 network_profile_name(bench_profiles[i]),
+                 single_us / 1000.0, single_worst_us / 1000.0,
+                 pair_us / 1000.0, pair_worst_us / 1000.0);
+    }
+
+    network_set_default_profile(NETWORK_PROFILE_DEFAULT);
+    return TEST_PASS;
+}
+
+/* Benchmark: Bulk records to a counting server per profile */
+TEST_CASE(bench_profile_throughput) {
+    static unsigned char payload[BENCH_RECORD_SIZE];
+    uint32_t seed = 2463534242u;
+
+    crypto_global_init();
+    network_init();
+
+    /* Incompressible, so negotiated compression leaves record sizes alone */
+    for (size_t i = 0; i < sizeof(payload); i++) {
+        seed ^= seed << 13;
+        seed ^= seed >> 17;
+        seed ^= seed << 5;
+        payload[i] = (unsigned char)seed;
+    }
+
+    for (int i = 0; i < BENCH_PROFILE_COUNT; i++) {
+        bench_path_t path;
+        uint64_t start_us, elapsed_us, received;
+        int ok = 1;
+
+        TEST_ASSERT_EQUAL(0, path_open(&path, bench_profiles[i],
+                                       BENCH_PORT + BENCH_PROFILE_COUNT + i, 0));
+        start_us = get_time_us();
+
+        for (int r = 0; r < BENCH_BULK_RECORDS && ok; r++) {
+            ok = send_message(path.conn, MSG_DATA, payload, sizeof(payload)) == PROTOCOL_SUCCESS;
+        }
+        while (ok && atomic_load(&path.server.messages) < BENCH_BULK_RECORDS &&
+               get_time_us() - start_us < BENCH_TIMEOUT_US) {
+            usleep(1000);
+        }
+
+        elapsed_us = get_time_us() - start_us;
+        received = atomic_load(&path.server.messages);
+        path_close(&path);
+        TEST_ASSERT(ok);
+        TEST_ASSERT_EQUAL(BENCH_BULK_RECORDS, (int)received);
+
+        test_log("%-12s %.1f MB in %.2f s (%.0f MB/s)",
+                 network_profile_name(bench_profiles[i]),
+                 received * sizeof(payload) / 1048576.0, elapsed_us / 1e6,
+                 (received * sizeof(payload) / 1048576.0) / (elapsed_us / 1e6));
+    }
+
+    network_set_default_profile(NETWORK_PROFILE_DEFAULT);
+    return TEST_PASS;
+}
+
+/* ===== Suite Registration ===== */
+
+__attribute__((constructor)) static void register_socket_profile_benchmarks(void) {
+    test_suite_t *suite = test_suite_create("socket_profile_benchmarks");
+    if (!suite) return;
+
+    test_suite_add_test(suite, "bench_profile_latency", bench_profile_latency);
+    test_suite_add_test(suite, "bench_profile_throughput", bench_profile_throughput);
+
+    test_register_suite(suite);
+}
@@ -0,0 +1,356 @@
+/*
+ * Compression Unit Tests
+ * Codec negotiation, per-record round trips, dictionary carry-over
+ * between records and the entropy-probe bypass. Each case runs over the
+ * codecs compiled into this build.
+ * Version: 1.0.0
+ * License: MIT
+ */
+
+#include "test_harness.h"
+#include "../../src/include/compression.h"
+#include <stdio.h>
+#include <string.h>
+
+#define TEST_MAX_RECORD 16384
+#define TEST_RECORD_SIZE 4096
+
+/* Codecs in wire order */
+static const compression_codec_t test_codecs[] = {
+    COMPRESSION_ZLIB, COMPRESSION_LZ4, COMPRESSION_ZSTD
+};
+#define TEST_CODEC_COUNT (sizeof(test_codecs) / sizeof(test_codecs[0]))
+
+/* Log lines: repetitive, compress well within one record */
+static void fill_text(unsigned char *buffer, size_t len, unsigned int seed) {
+    size_t pos = 0;
+    
+    while (pos < len) {
+        char line[96];
+        int n = snprintf(line, sizeof(line),
+                         "2026-10-18 12:%02u:%02u INFO conn %u sent %u bytes\n",
+                         (seed / 60) % 60, seed % 60, seed % 97, seed * 131 % 65536);
+        size_t take = (size_t)n < len - pos ? (size_t)n : len - pos;
+        
+        memcpy(buffer + pos, line, take);
+        pos += take;
+        seed++;
+    }
+}
+
+/* Letters from a 32-symbol alphabet: passes the entropy probe, but has
+ * little to match within a single record */
+static void fill_words(unsigned char *buffer, size_t len, uint32_t seed) {
+    for (size_t i = 0; i < len; i++) {
+        seed = seed * 1103515245u + 12345u;
+        buffer[i] = (unsigned char)('a' + ((seed >> 16) & 31));
+    }
+}
+
+/* xorshift32 output: looks like ciphertext to the probe */
+static void fill_noise(unsigned char *buffer, size_t len, uint32_t seed) {
+    for (size_t i = 0; i < len; i++) {
+        seed ^= seed << 13;
+        seed ^= seed >> 17;
+        seed ^= seed << 5;
+        buffer[i] = (unsigned char)seed;
+    }
+}
+
+/* Best codec this build can offer, by compression_select() preference */
+static compression_codec_t best_codec(uint8_t mask) {
+    if (mask & (1u << COMPRESSION_ZSTD)) return COMPRESSION_ZSTD;
+    if (mask & (1u << COMPRESSION_LZ4)) return COMPRESSION_LZ4;
+    if (mask & (1u << COMPRESSION_ZLIB)) return COMPRESSION_ZLIB;
+    return COMPRESSION_NONE;
+}
+
+/* Compress a record and decompress it on the peer's context */
+static int round_trip(compression_ctx_t *tx, compression_ctx_t *rx,
+                      const unsigned char *input, size_t input_len,
+                      unsigned char *record, size_t *record_len) {
+    const unsigned char *encoded, *decoded;
+    size_t encoded_len, decoded_len;
+    
+    if (compression_compress_record(tx, input, input_len, &encoded, &encoded_len) !=
+        COMPRESSION_SUCCESS) {
+        return -1;
+    }
+    
+    /* Output lives in the context's scratch buffer until the next call */
+    memcpy(record, encoded, encoded_len);
+    *record_len = encoded_len;
+    
+    if (compression_decompress_record(rx, record, encoded_len, &decoded, &decoded_len) !=
+        COMPRESSION_SUCCESS) {
+        return -1;
+    }
+    
+    return decoded_len == input_len && memcmp(decoded, input, input_len) == 0 ? 0 : -1;
+}
+
+/* Test: Codec negotiation */
+TEST_CASE(test_codec_negotiation) {
+    uint8_t mask = compression_supported_mask();
+    
+    /* Bit 0 is "none", which is never advertised */
+    TEST_ASSERT_EQUAL(0, mask & (1u << COMPRESSION_NONE));
+    
+    TEST_ASSERT_EQUAL(COMPRESSION_NONE, compression_select(0));
+    TEST_ASSERT_EQUAL(COMPRESSION_NONE, compression_select(1u << COMPRESSION_NONE));
+    TEST_ASSERT_EQUAL(best_codec(mask), compression_select(0xFF));
+    TEST_ASSERT_EQUAL(best_codec(mask), compression_select(mask));
+    
+    /* A single-codec peer gets that codec or nothing */
+    for (size_t i = 0; i < TEST_CODEC_COUNT; i++) {
+        compression_codec_t codec = test_codecs[i];
+        uint8_t bit = (uint8_t)(1u << codec);
+        
+        TEST_ASSERT_EQUAL((mask & bit) ? codec : COMPRESSION_NONE, compression_select(bit));
+        
+        if (mask & bit) {
+            compression_ctx_t *ctx = compression_create(codec, TEST_MAX_RECORD);
+            TEST_ASSERT_NOT_NULL(ctx);
+            
+            compression_stats_t stats = compression_get_stats(ctx);
+            TEST_ASSERT_EQUAL(codec, stats.codec);
+            TEST_ASSERT(stats.bytes_in == 0);
+            compression_destroy(ctx);
+            
+            TEST_ASSERT_NULL(compression_create(codec, 0));
+        } else {
+            TEST_ASSERT_NULL(compression_create(codec, TEST_MAX_RECORD));
+        }
+    }
+    
+    /* Lower-preference codecs lose to higher ones both sides support */
+    if ((mask & (1u << COMPRESSION_ZLIB)) && (mask & (1u << COMPRESSION_ZSTD))) {
+        TEST_ASSERT_EQUAL(COMPRESSION_ZSTD, compression_select((1u << COMPRESSION_ZLIB) |
+                                                               (1u << COMPRESSION_ZSTD)));
+    }
+    
+    TEST_ASSERT_NULL(compression_create(COMPRESSION_NONE, TEST_MAX_RECORD));
+    
+    TEST_ASSERT_STRING_EQUAL("none", compression_codec_name(COMPRESSION_NONE));
+    TEST_ASSERT_STRING_EQUAL("zlib", compression_codec_name(COMPRESSION_ZLIB));
+    TEST_ASSERT_STRING_EQUAL("lz4", compression_codec_name(COMPRESSION_LZ4));
+    TEST_ASSERT_STRING_EQUAL("zstd", compression_codec_name(COMPRESSION_ZSTD));
+    
+    return TEST_PASS;
+}
+
+/* Test: Records of several sizes survive each codec */
+TEST_CASE(test_codec_round_trip) {
+    static const size_t sizes[] = { 64, 100, 1000, TEST_RECORD_SIZE, TEST_MAX_RECORD };
+    static unsigned char input[TEST_MAX_RECORD];
+    static unsigned char record[COMPRESSION_HEADER_SIZE + TEST_MAX_RECORD +
+                                COMPRESSION_MAX_EXPANSION];
+    uint8_t mask = compression_supported_mask();
+    
+    if (!mask) {
+        test_log("No compression codecs compiled in; skipping");
+        return TEST_SKIP;
+    }
+    
+    for (size_t i = 0; i < TEST_CODEC_COUNT; i++) {
+        compression_codec_t codec = test_codecs[i];
+        size_t record_len, total = 0;
+        
+        if (!(mask & (1u << codec))) {
+            test_log("%s not compiled in; skipping", compression_codec_name(codec));
+            continue;
+        }
+        
+        compression_ctx_t *tx = compression_create(codec, TEST_MAX_RECORD);
+        compression_ctx_t *rx = compression_create(codec, TEST_MAX_RECORD);
+        TEST_ASSERT_NOT_NULL(tx);
+        TEST_ASSERT_NOT_NULL(rx);
+        
+        for (size_t j = 0; j < sizeof(sizes) / sizeof(sizes[0]); j++) {
+            fill_text(input, sizes[j], (unsigned int)(j * 1000));
+            TEST_ASSERT_EQUAL(0, round_trip(tx, rx, input, sizes[j], record, &record_len));
+            
+            /* Nothing here trips the probe, so every record is coded */
+            TEST_ASSERT_EQUAL(codec, record[0]);
+            total += sizes[j];
+        }
+        
+        compression_stats_t stats = compression_get_stats(tx);
+        TEST_ASSERT(stats.bytes_in == total);
+        TEST_ASSERT(stats.bytes_out < stats.bytes_in);
+        TEST_ASSERT_EQUAL(sizeof(sizes) / sizeof(sizes[0]), stats.records_compressed);
+        TEST_ASSERT_EQUAL(0, stats.records_stored);
+        
+        /* Larger than the negotiated record size */
+        const unsigned char *encoded;
+        size_t encoded_len;
+        TEST_ASSERT_EQUAL(COMPRESSION_ERROR_PARAM,
+                          compression_compress_record(tx, input, TEST_MAX_RECORD + 1,
+                                                      &encoded, &encoded_len));
+        
+        compression_destroy(tx);
+        compression_destroy(rx);
+    }
+    
+    return TEST_PASS;
+}
+
+/* Test: History carries over, so a repeated record costs little */
+TEST_CASE(test_dictionary_carry_over) {
+    static unsigned char input[TEST_RECORD_SIZE];
+    static unsigned char first[COMPRESSION_HEADER_SIZE + TEST_MAX_RECORD +
+                               COMPRESSION_MAX_EXPANSION];
+    static unsigned char second[sizeof(first)];
+    uint8_t mask = compression_supported_mask();
+    
+    if (!mask) {
+        test_log("No compression codecs compiled in; skipping");
+        return TEST_SKIP;
+    }
+    
+    fill_words(input, sizeof(input), 7);
+    
+    for (size_t i = 0; i < TEST_CODEC_COUNT; i++) {
+        compression_codec_t codec = test_codecs[i];
+        const unsigned char *decoded;
+        size_t first_len, second_len, decoded_len;
+        int result;
+        
+        if (!(mask & (1u << codec))) {
+            continue;
+        }
+        
+        compression_ctx_t *tx = compression_create(codec, TEST_MAX_RECORD);
+        compression_ctx_t *rx = compression_create(codec, TEST_MAX_RECORD);
+        compression_ctx_t *fresh = compression_create(codec, TEST_MAX_RECORD);
+        TEST_ASSERT_NOT_NULL(tx);
+        TEST_ASSERT_NOT_NULL(rx);
+        TEST_ASSERT_NOT_NULL(fresh);
+        
+        TEST_ASSERT_EQUAL(0, round_trip(tx, rx, input, sizeof(input), first, &first_len));
+        TEST_ASSERT_EQUAL(0, round_trip(tx, rx, input, sizeof(input), second, &second_len));
+        
+        /* The second record is mostly one match against the first */
+        test_log("%s: first record %zu bytes, repeat %zu bytes",
+                 compression_codec_name(codec), first_len, second_len);
+        TEST_ASSERT(first_len > sizeof(input) / 2);
+        TEST_ASSERT(second_len < first_len / 4);
+        
+        /* Without the first record's history the second cannot be decoded */
+        result = compression_decompress_record(fresh, second, second_len,
+                                               &decoded, &decoded_len);
+        TEST_ASSERT(result != COMPRESSION_SUCCESS || decoded_len != sizeof(input) ||
+                    memcmp(decoded, input, sizeof(input)) != 0);
+        
+        compression_destroy(tx);
+        compression_destroy(rx);
+        compression_destroy(fresh);
+    }
+    
+    return TEST_PASS;
+}
+
+/* Test: Incompressible and short records are stored, not coded */
+TEST_CASE(test_entropy_probe_bypass) {
+    static unsigned char text[TEST_RECORD_SIZE];
+    static unsigned char noise[TEST_RECORD_SIZE];
+    static unsigned char record[COMPRESSION_HEADER_SIZE + TEST_MAX_RECORD +
+                                COMPRESSION_MAX_EXPANSION];
+    uint8_t mask = compression_supported_mask();
+    
+    fill_text(text, sizeof(text), 0);
+    fill_noise(noise, sizeof(noise), 0x9E3779B9u);
+    
+    TEST_ASSERT_EQUAL(1, compression_is_compressible(text, sizeof(text)));
+    TEST_ASSERT_EQUAL(0, compression_is_compressible(noise, sizeof(noise)));
+    TEST_ASSERT_EQUAL(0, compression_is_compressible(text, 1));
+    TEST_ASSERT_EQUAL(0, compression_is_compressible(NULL, sizeof(text)));
+    
+    if (!mask) {
+        test_log("No compression codecs compiled in; skipping");
+        return TEST_SKIP;
+    }
+    
+    for (size_t i = 0; i < TEST_CODEC_COUNT; i++) {
+        compression_codec_t codec = test_codecs[i];
+        size_t record_len;
+        
+        if (!(mask & (1u << codec))) {
+            continue;
+        }
+        
+        compression_ctx_t *tx = compression_create(codec, TEST_MAX_RECORD);
+        compression_ctx_t *rx = compression_create(codec, TEST_MAX_RECORD);
+        TEST_ASSERT_NOT_NULL(tx);
+        TEST_ASSERT_NOT_NULL(rx);
+        
+        /* Stored records sit between coded ones without upsetting either history */
+        TEST_ASSERT_EQUAL(0, round_trip(tx, rx, text, sizeof(text), record, &record_len));
+        TEST_ASSERT_EQUAL(codec, record[0]);
+        
+        TEST_ASSERT_EQUAL(0, round_trip(tx, rx, noise, sizeof(noise), record, &record_len));
+        TEST_ASSERT_EQUAL(COMPRESSION_NONE, record[0]);
+        TEST_ASSERT_EQUAL(COMPRESSION_HEADER_SIZE + sizeof(noise), record_len);
+        
+        /* Below the minimum size even compressible data is stored */
+        TEST_ASSERT_EQUAL(0, round_trip(tx, rx, text, 63, record, &record_len));
+        TEST_ASSERT_EQUAL(COMPRESSION_NONE, record[0]);
+        
+        TEST_ASSERT_EQUAL(0, round_trip(tx, rx, text, sizeof(text), record, &record_len));
+        TEST_ASSERT_EQUAL(codec, record[0]);
+        
+        compression_stats_t stats = compression_get_stats(tx);
+        TEST_ASSERT_EQUAL(2, stats.records_compressed);
+        TEST_ASSERT_EQUAL(2, stats.records_stored);
+        TEST_ASSERT(stats.bytes_in == 2 * sizeof(text) + sizeof(noise) + 63);
+        
+        compression_destroy(tx);
+        compression_destroy(rx);
+    }
+    
+    return TEST_PASS;
+}
+
+/* Test: Records naming another codec are rejected */
+TEST_CASE(test_codec_mismatch) {
+    static unsigned char record[64];
+    uint8_t mask = compression_supported_mask();
+    compression_codec_t codec = best_codec(mask);
+    const unsigned char *decoded;
+    size_t decoded_len;
+    
+    if (codec == COMPRESSION_NONE) {
+        test_log("No compression codecs compiled in; skipping");
+        return TEST_SKIP;
+    }
+    
+    compression_ctx_t *rx = compression_create(codec, TEST_MAX_RECORD);
+    TEST_ASSERT_NOT_NULL(rx);
+    
+    fill_text(record + COMPRESSION_HEADER_SIZE, sizeof(record) - COMPRESSION_HEADER_SIZE, 0);
+    record[0] = codec == COMPRESSION_ZLIB ? COMPRESSION_ZSTD : COMPRESSION_ZLIB;
+    TEST_ASSERT_EQUAL(COMPRESSION_ERROR_CORRUPT,
+                      compression_decompress_record(rx, record, sizeof(record),
+                                                    &decoded, &decoded_len));
+    
+    /* An empty record lacks even the header byte */
+    TEST_ASSERT_EQUAL(COMPRESSION_ERROR_PARAM,
+                      compression_decompress_record(rx, record, 0, &decoded, &decoded_len));
+    
+    compression_destroy(rx);
+    return TEST_PASS;
+}
+
+/* Register compression tests */
+__attribute__((constructor)) static void register_compression_tests(void) {
+    test_suite_t *suite = test_suite_create("compression");
+    if (!suite) return;
+    
+    test_suite_add_test(suite, "test_codec_negotiation", test_codec_negotiation);
+    test_suite_add_test(suite, "test_codec_round_trip", test_codec_round_trip);
+    test_suite_add_test(suite, "test_dictionary_carry_over", test_dictionary_carry_over);
+    test_suite_add_test(suite, "test_entropy_probe_bypass", test_entropy_probe_bypass);
+    test_suite_add_test(suite, "test_codec_mismatch", test_codec_mismatch);
+    
+    test_register_suite(suite);
+}
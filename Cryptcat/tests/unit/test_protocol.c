@@ -7,12 +7,14 @@
 #include "../../src/include/protocol.h"
 #include "../../src/include/network.h"
 #include "../../src/include/crypto.h"
+#include "../../src/include/session_ticket.h"
 #include "../../src/utils/logger.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <assert.h>
 #include <pthread.h>
+#include <unistd.h>
 
 /* Test utilities */
 static int tests_passed = 0;
@@ -68,6 +70,11 @@ void test_protocol_errors(void) {
     connection_t conn_dummy = {0};
     result = perform_handshake(&conn_dummy, 0, NULL);
     TEST(result == PROTOCOL_ERROR_PARAM);
+    
+    /* Non-blocking handshake interface */
+    TEST(handshake_begin(NULL, 0, "password") == NULL);
+    TEST(handshake_step(NULL, 0) == PROTOCOL_ERROR_PARAM);
+    TEST(strcmp(protocol_strerror(PROTOCOL_IN_PROGRESS), "Operation in progress") == 0);
 }
 
 /* Test 2: Message sending/receiving simulation */
@@ -110,17 +117,29 @@ void test_handshake_simulation(void) {
     /* Create client connection */
     connection_t *client = connect_to_host("127.0.0.1", test_port, "test_password");
     if (client) {
-        /* Perform client handshake */
-        int result = perform_handshake(client, 0, "test_password");
+        /* Perform client handshake step by step */
+        handshake_t *hs = handshake_begin(client, 0, "test_password");
+        int result = PROTOCOL_ERROR_STATE;
+        
+        if (hs) {
+            do {
+                result = handshake_step(hs, 10);
+            } while (result == PROTOCOL_IN_PROGRESS);
+        }
         
         if (result == PROTOCOL_SUCCESS) {
+            handshake_timing_t timing = handshake_get_timing(hs);
             printf("  ✓ Handshake completed successfully\n");
+            printf("    init %u us, response %u us, kdf %u us (stall %u us), total %u us\n",
+                   timing.init_us, timing.response_us, timing.kdf_us,
+                   timing.kdf_stall_us, timing.total_us);
             tests_passed++;
         } else {
             printf("  ✗ Handshake failed: %s\n", protocol_strerror(result));
             tests_failed++;
         }
         
+        handshake_free(hs);
         close_connection(client);
     } else {
         printf("  ✗ Failed to connect to test server\n");
@@ -198,6 +217,90 @@ void test_message_integrity(void) {
     tests_passed += 2;
 }
 
+/* Test 8: Session resumption tickets */
+void test_session_tickets(void) {
+    printf("\n=== Test 8: Session Tickets ===\n");
+    
+    session_resumption_t state, opened;
+    unsigned char ticket[SESSION_TICKET_MAX_SIZE];
+    unsigned char taken[SESSION_TICKET_MAX_SIZE];
+    size_t ticket_len = sizeof(ticket);
+    size_t taken_len = sizeof(taken);
+    
+    crypto_global_init();
+    crypto_random_bytes(state.secret, sizeof(state.secret));
+    state.codec = 0;
+    
+    /* Issue and redeem once */
+    TEST(session_ticket_issue(&state, ticket, &ticket_len) == TICKET_SUCCESS);
+    TEST(ticket_len <= SESSION_TICKET_MAX_SIZE);
+    TEST(session_ticket_redeem(ticket, ticket_len, &opened) == TICKET_SUCCESS);
+    TEST(memcmp(opened.secret, state.secret, sizeof(state.secret)) == 0);
+    
+    /* Second presentation is a replay */
+    TEST(session_ticket_redeem(ticket, ticket_len, &opened) == TICKET_ERROR_REPLAY);
+    
+    /* Tampering breaks authentication */
+    ticket_len = sizeof(ticket);
+    session_ticket_issue(&state, ticket, &ticket_len);
+    ticket[ticket_len - 1] ^= 0x01;
+    TEST(session_ticket_redeem(ticket, ticket_len, &opened) == TICKET_ERROR_MALFORMED);
+    
+    /* Tickets survive one rotation, not an evicted key */
+    ticket_len = sizeof(ticket);
+    session_ticket_issue(&state, ticket, &ticket_len);
+    session_ticket_rotate_keys();
+    TEST(session_ticket_redeem(ticket, ticket_len, &opened) == TICKET_SUCCESS);
+    
+    ticket_len = sizeof(ticket);
+    session_ticket_issue(&state, ticket, &ticket_len);
+    for (int i = 0; i < 8; i++) {
+        session_ticket_rotate_keys();
+    }
+    TEST(session_ticket_redeem(ticket, ticket_len, &opened) == TICKET_ERROR_UNKNOWN_KEY);
+    
+    /* Client store hands a ticket out only once */
+    TEST(session_ticket_store_put("127.0.0.1", 4444, ticket, ticket_len,
+                                  SESSION_TICKET_LIFETIME, &state) == TICKET_SUCCESS);
+    TEST(session_ticket_store_take("127.0.0.1", 4444, taken, &taken_len,
+                                   &opened) == TICKET_SUCCESS);
+    TEST(taken_len == ticket_len && memcmp(taken, ticket, ticket_len) == 0);
+    taken_len = sizeof(taken);
+    TEST(session_ticket_store_take("127.0.0.1", 4444, taken, &taken_len,
+                                   &opened) == TICKET_ERROR_NOT_FOUND);
+    
+    /* Redeeming twice the replay cache's worth overruns it: no ticket is
+     * accepted twice, and tickets issued later are still accepted */
+    {
+        enum { BURST = 8192, LATER = 64 };
+        unsigned char (*burst)[SESSION_TICKET_MAX_SIZE] = malloc(BURST * sizeof(*burst));
+        size_t burst_len = SESSION_TICKET_MAX_SIZE;
+        int replayed = 0, accepted = 0;
+        
+        for (int i = 0; burst && i < BURST; i++) {
+            burst_len = SESSION_TICKET_MAX_SIZE;
+            session_ticket_issue(&state, burst[i], &burst_len);
+            session_ticket_redeem(burst[i], burst_len, &opened);
+        }
+        for (int i = 0; burst && i < BURST; i++) {
+            replayed += session_ticket_redeem(burst[i], burst_len, &opened) == TICKET_ERROR_REPLAY;
+        }
+        TEST(replayed == BURST);
+        
+        /* Issued a second later, so they expire after everything forgotten */
+        sleep(1);
+        for (int i = 0; burst && i < LATER; i++) {
+            burst_len = SESSION_TICKET_MAX_SIZE;
+            session_ticket_issue(&state, burst[i], &burst_len);
+            accepted += session_ticket_redeem(burst[i], burst_len, &opened) == TICKET_SUCCESS;
+        }
+        TEST(accepted == LATER);
+        free(burst);
+    }
+    
+    session_ticket_cleanup();
+}
+
 /* Main test runner */
 int main(void) {
     printf("========================================\n");
@@ -215,6 +318,7 @@ int main(void) {
     test_control_messages();
     test_protocol_version();
     test_message_integrity();
+    test_session_tickets();
     
     /* Print summary */
     printf("\n========================================\n");
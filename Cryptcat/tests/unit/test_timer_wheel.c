@@ -0,0 +1,212 @@
+/*
+ * Timer Wheel Unit Tests
+ * Expiry across every level's cascade, cancel and re-arm (including
+ * from inside a callback) and deadlines beyond the wheel's span. The
+ * wheel is driven the way the event loop drives it: advance, then
+ * sleep for whatever timer_wheel_next_timeout() reports.
+ * Version: 1.0.0
+ * License: MIT
+ */
+
+#include "test_harness.h"
+#include "../../src/include/timer_wheel.h"
+#include <stdio.h>
+#include <string.h>
+
+#define TEST_TIMER_IDS 16
+#define TEST_WHEEL_SPAN (1ull << (TIMER_WHEEL_LEVELS * TIMER_WHEEL_SLOT_BITS))
+
+/* What fired, and when */
+typedef struct {
+    timer_wheel_t *wheel;
+    uint64_t now_ms;
+    uint64_t fired_ms[TEST_TIMER_IDS];
+    int fired[TEST_TIMER_IDS];
+    uint32_t rearm_id;              /* Re-armed from its first callback... */
+    uint32_t rearm_after_ms;        /* ...this much later, when non-zero */
+    int cancel_pair;                /* Ids 6 and 7 cancel each other */
+} fire_log_t;
+
+static void record_fire(void *ctx, uint32_t id) {
+    fire_log_t *log = (fire_log_t*)ctx;
+    
+    if (id >= TEST_TIMER_IDS) return;
+    
+    log->fired[id]++;
+    log->fired_ms[id] = log->now_ms;
+    
+    if (log->rearm_after_ms && log->rearm_id == id && log->fired[id] == 1) {
+        timer_wheel_schedule(log->wheel, id, log->now_ms + log->rearm_after_ms);
+    }
+    
+    if (log->cancel_pair && (id == 6 || id == 7)) {
+        timer_wheel_cancel(log->wheel, 13 - id);
+    }
+}
+
+/* Advance, then sleep until the wheel next has work, up to end_ms */
+static void run_until(fire_log_t *log, uint64_t end_ms) {
+    for (;;) {
+        int wait;
+        
+        timer_wheel_advance(log->wheel, log->now_ms, record_fire, log);
+        if (log->now_ms >= end_ms) {
+            break;
+        }
+        
+        wait = timer_wheel_next_timeout(log->wheel, log->now_ms);
+        if (wait < 0 || log->now_ms + (uint64_t)wait > end_ms) {
+            log->now_ms = end_ms;
+        } else {
+            log->now_ms += wait > 0 ? (uint64_t)wait : 1;
+        }
+    }
+}
+
+/* Test: Deadlines on every level fire on time after cascading down */
+TEST_CASE(test_timer_cascade) {
+    /* Either side of each level boundary, in 4 ms ticks */
+    static const uint64_t deadlines[] = {
+        1, 4, 5, 252, 256, 257, 16380, 16384, 16385, 20000,
+        1048572, 1048576, 1048577, 1200003
+    };
+    const size_t count = sizeof(deadlines) / sizeof(deadlines[0]);
+    const uint64_t origin = 1000;
+    fire_log_t log;
+    
+    memset(&log, 0, sizeof(log));
+    log.now_ms = origin;
+    log.wheel = timer_wheel_create(4, origin);
+    TEST_ASSERT_NOT_NULL(log.wheel);
+    
+    for (size_t i = 0; i < count; i++) {
+        TEST_ASSERT_EQUAL(TIMER_WHEEL_SUCCESS,
+                          timer_wheel_schedule(log.wheel, (uint32_t)i, origin + deadlines[i]));
+    }
+    TEST_ASSERT_EQUAL(count, timer_wheel_count(log.wheel));
+    TEST_ASSERT_EQUAL(4, timer_wheel_next_timeout(log.wheel, origin));
+    
+    run_until(&log, origin + deadlines[count - 1] + 4);
+    
+    /* Never early, at most one tick late */
+    for (size_t i = 0; i < count; i++) {
+        TEST_ASSERT_EQUAL(1, log.fired[i]);
+        TEST_ASSERT_IN_RANGE(origin + deadlines[i], origin + deadlines[i] + 3,
+                             log.fired_ms[i]);
+    }
+    
+    TEST_ASSERT_EQUAL(0, timer_wheel_count(log.wheel));
+    TEST_ASSERT_EQUAL(-1, timer_wheel_next_timeout(log.wheel, log.now_ms));
+    
+    timer_wheel_destroy(log.wheel);
+    return TEST_PASS;
+}
+
+/* Test: Cancel and re-arm, across levels and from callbacks */
+TEST_CASE(test_timer_cancel_reschedule) {
+    fire_log_t log;
+    
+    memset(&log, 0, sizeof(log));
+    log.wheel = timer_wheel_create(1, 0);
+    TEST_ASSERT_NOT_NULL(log.wheel);
+    
+    TEST_ASSERT_EQUAL(TIMER_WHEEL_SUCCESS, timer_wheel_schedule(log.wheel, 1, 100));
+    TEST_ASSERT_EQUAL(TIMER_WHEEL_SUCCESS, timer_wheel_schedule(log.wheel, 2, 100));
+    TEST_ASSERT_EQUAL(TIMER_WHEEL_SUCCESS, timer_wheel_schedule(log.wheel, 3, 5000));
+    TEST_ASSERT_EQUAL(TIMER_WHEEL_SUCCESS, timer_wheel_schedule(log.wheel, 4, 200));
+    TEST_ASSERT_EQUAL(4, timer_wheel_count(log.wheel));
+    
+    /* Cancelling twice, or a timer never armed, changes nothing */
+    timer_wheel_cancel(log.wheel, 2);
+    timer_wheel_cancel(log.wheel, 2);
+    timer_wheel_cancel(log.wheel, 5);
+    timer_wheel_cancel(log.wheel, 1u << 20);
+    TEST_ASSERT_EQUAL(0, timer_wheel_pending(log.wheel, 2));
+    TEST_ASSERT_EQUAL(3, timer_wheel_count(log.wheel));
+    
+    /* Re-arming moves a timer rather than adding one: sooner on the same
+     * level, down from level 1, and up to level 2 */
+    TEST_ASSERT_EQUAL(TIMER_WHEEL_SUCCESS, timer_wheel_schedule(log.wheel, 1, 50));
+    TEST_ASSERT_EQUAL(TIMER_WHEEL_SUCCESS, timer_wheel_schedule(log.wheel, 3, 30));
+    TEST_ASSERT_EQUAL(TIMER_WHEEL_SUCCESS, timer_wheel_schedule(log.wheel, 4, 70000));
+    TEST_ASSERT_EQUAL(3, timer_wheel_count(log.wheel));
+    TEST_ASSERT_EQUAL(30, timer_wheel_next_timeout(log.wheel, 0));
+    
+    /* A callback may re-arm its own timer, or cancel one due the same tick */
+    log.rearm_id = 5;
+    log.rearm_after_ms = 10;
+    log.cancel_pair = 1;
+    TEST_ASSERT_EQUAL(TIMER_WHEEL_SUCCESS, timer_wheel_schedule(log.wheel, 5, 150));
+    TEST_ASSERT_EQUAL(TIMER_WHEEL_SUCCESS, timer_wheel_schedule(log.wheel, 6, 180));
+    TEST_ASSERT_EQUAL(TIMER_WHEEL_SUCCESS, timer_wheel_schedule(log.wheel, 7, 180));
+    
+    run_until(&log, 199);
+    TEST_ASSERT_EQUAL(1, log.fired[3]);
+    TEST_ASSERT_EQUAL(30, log.fired_ms[3]);
+    TEST_ASSERT_EQUAL(1, log.fired[1]);
+    TEST_ASSERT_EQUAL(50, log.fired_ms[1]);
+    TEST_ASSERT_EQUAL(0, log.fired[2]);
+    TEST_ASSERT_EQUAL(2, log.fired[5]);
+    TEST_ASSERT_EQUAL(160, log.fired_ms[5]);
+    TEST_ASSERT_EQUAL(1, log.fired[6] + log.fired[7]);
+    TEST_ASSERT_EQUAL(180, log.fired_ms[log.fired[6] ? 6 : 7]);
+    TEST_ASSERT_EQUAL(0, log.fired[4]);
+    
+    /* The timer moved up fires at its new deadline, not its old one */
+    TEST_ASSERT_EQUAL(1, timer_wheel_count(log.wheel));
+    run_until(&log, 70000);
+    TEST_ASSERT_EQUAL(1, log.fired[4]);
+    TEST_ASSERT_EQUAL(70000, log.fired_ms[4]);
+    TEST_ASSERT_EQUAL(0, timer_wheel_count(log.wheel));
+    
+    timer_wheel_destroy(log.wheel);
+    return TEST_PASS;
+}
+
+/* Test: Deadlines past the wheel's span wait rather than fire early */
+TEST_CASE(test_timer_far_future) {
+    const uint64_t origin = 1ull << 40;
+    fire_log_t log;
+    
+    memset(&log, 0, sizeof(log));
+    log.now_ms = origin;
+    log.wheel = timer_wheel_create(1, origin);
+    TEST_ASSERT_NOT_NULL(log.wheel);
+    
+    TEST_ASSERT_EQUAL(TIMER_WHEEL_SUCCESS,
+                      timer_wheel_schedule(log.wheel, 1, origin + TEST_WHEEL_SPAN + 5000));
+    TEST_ASSERT_EQUAL(TIMER_WHEEL_SUCCESS,
+                      timer_wheel_schedule(log.wheel, 2, origin + 3 * TEST_WHEEL_SPAN + 7));
+    TEST_ASSERT_EQUAL(TIMER_WHEEL_SUCCESS, timer_wheel_schedule(log.wheel, 3, UINT64_MAX));
+    
+    /* Past the point a clamped deadline would have fired */
+    run_until(&log, origin + TEST_WHEEL_SPAN);
+    TEST_ASSERT_EQUAL(0, log.fired[1]);
+    TEST_ASSERT_EQUAL(3, timer_wheel_count(log.wheel));
+    
+    run_until(&log, origin + 3 * TEST_WHEEL_SPAN + 7);
+    TEST_ASSERT_EQUAL(1, log.fired[1]);
+    TEST_ASSERT_EQUAL(origin + TEST_WHEEL_SPAN + 5000, log.fired_ms[1]);
+    TEST_ASSERT_EQUAL(1, log.fired[2]);
+    TEST_ASSERT_EQUAL(origin + 3 * TEST_WHEEL_SPAN + 7, log.fired_ms[2]);
+    
+    /* The furthest deadline there is stays armed */
+    TEST_ASSERT_EQUAL(0, log.fired[3]);
+    TEST_ASSERT_EQUAL(1, timer_wheel_pending(log.wheel, 3));
+    TEST_ASSERT(timer_wheel_next_timeout(log.wheel, log.now_ms) > 0);
+    
+    timer_wheel_destroy(log.wheel);
+    return TEST_PASS;
+}
+
+/* Register timer wheel tests */
+__attribute__((constructor)) static void register_timer_wheel_tests(void) {
+    test_suite_t *suite = test_suite_create("timer_wheel");
+    if (!suite) return;
+    
+    test_suite_add_test(suite, "test_timer_cascade", test_timer_cascade);
+    test_suite_add_test(suite, "test_timer_cancel_reschedule", test_timer_cancel_reschedule);
+    test_suite_add_test(suite, "test_timer_far_future", test_timer_far_future);
+    
+    test_register_suite(suite);
+}